@@ -28,6 +28,9 @@
 #if PIO_USE_ADIOS
   #define _ADIOS2 1
 #endif
+#if PIO_USE_HDF5
+  #define _HDF5 1
+#endif
 #if PIO_USE_MICRO_TIMING
   #define PIO_MICRO_TIMING 1
 #endif
@@ -51,6 +54,10 @@
 adios2_adios *get_adios2_adios();
 unsigned long get_adios2_io_cnt();
 #endif
+#ifdef _HDF5
+#include <hdf5.h>
+#include <hdf5_hl.h>
+#endif
 
 #ifndef MPI_OFFSET
 /** MPI_OFFSET is an integer type of size sufficient to represent the
@@ -303,6 +310,11 @@ unsigned long get_adios2_io_cnt();
 #define PIO_EADIOS2ERR (-301)
 #endif
 
+#ifdef _HDF5
+/** Define error codes for HDF5. */
+#define PIO_EHDF5ERR (-302)
+#endif
+
 #ifdef PIO_MICRO_TIMING
 /** Some fwd declarations to avoid including internal headers */
 typedef struct mtimer_info *mtimer_t;
@@ -375,7 +387,7 @@ typedef struct var_desc_t
 } var_desc_t;
 
 /**
- * IO region structure.
+ * IO region table.
  *
  * Each IO region is a unit of data which can be described using start
  * and count arrays. Each IO task may in general have multiple io
@@ -384,23 +396,41 @@ typedef struct var_desc_t
  *
  * The write from a particular IO task is divided into 1 or more
  * regions each of which can be described using start and count. The
- * io_region typedef is a linked list of those regions.
+ * io_region_table keeps all the regions of an IO task in one set of
+ * arrays, with a row of start/count values per region (see
+ * REGION_START() and REGION_COUNT()). Each row has a leading column
+ * for the record dimension, so the rows can be passed to the varn
+ * functions of PnetCDF as they are.
  */
-typedef struct io_region
+typedef struct io_region_table
 {
-    /** The offset from the beginning of the data buffer to the
-     * beginning of this region.  */
-    int loffset;
+    /** The number of regions in the table. */
+    int nregions;
+
+    /** The number of regions the arrays have room for. */
+    int size;
 
-    /** Start array for this region. */
+    /** The number of dimensions of the regions. */
+    int ndims;
+
+    /** Start arrays of the regions, size rows of ndims + 1 values. */
     PIO_Offset *start;
 
-    /** Count array for this region. */
+    /** Count arrays of the regions, size rows of ndims + 1 values. */
     PIO_Offset *count;
 
-    /** Pointer to the next io_region in the list. */
-    struct io_region *next;
-} io_region;
+    /** The offset from the beginning of the data buffer to the
+     * beginning of each region. */
+    PIO_Offset *loffset;
+
+    /** Room for size pointers to the start rows of the regions, used
+     * for the varn functions. */
+    PIO_Offset **startp;
+
+    /** Room for size pointers to the count rows of the regions, used
+     * for the varn functions. */
+    PIO_Offset **countp;
+} io_region_table;
 
 /**
  * Rearranger comm type. The rearranger option values must match the
@@ -437,6 +467,10 @@ enum PIO_REARR_COMM_FC_DIR
 /* Constant to indicate unlimited requests. */
 #define PIO_REARR_COMM_UNLIMITED_PEND_REQ -1
 
+/* Stripe size to indicate that the box rearranger aligns the data of
+ * the IO tasks to the "striping_unit" hint (see PIOc_set_stripesize). */
+#define PIO_STRIPESIZE_HINT -1
+
 /**
  * Rearranger comm flow control options.
  */
@@ -475,6 +509,29 @@ typedef struct rearr_opt
     rearr_comm_fc_opt_t io2comp;
 } rearr_opt_t;
 
+/**
+ * Pack list of a decomposition.
+ *
+ * When a decomposition is rearranged with packed messages (see
+ * PIOc_set_rearr_pack()), the data of each message is gathered into
+ * (or scattered from) a contiguous buffer along runs of consecutive
+ * elements, instead of being described by an MPI derived type.
+ */
+typedef struct pio_pack_list
+{
+    /** Number of messages. */
+    int nmsgs;
+
+    /** Index of the first run of each message (length nmsgs + 1). */
+    int *first;
+
+    /** Starting element of each run in the local buffer. */
+    int *start;
+
+    /** Number of elements in each run. */
+    int *len;
+} pio_pack_list;
+
 /**
  * IO descriptor structure.
  *
@@ -489,9 +546,19 @@ typedef struct io_desc_t
     /** The length of the decomposition map. */
     int maplen;
 
-    /** A 1-D array with iodesc->maplen elements, which are the
-     * 1-based mappings to the global array for that task. */
-    PIO_Offset *map;
+    /** The number of ranges of the decomposition map. The map is
+     * kept as ranges of consecutive 1-based mappings to the global
+     * array for that task (see expand_iodesc_map()). */
+    int map_nranges;
+
+    /** A 1-D array with iodesc->map_nranges elements, which are the
+     * first mapping of each range. Ranges of holes (mappings <= 0)
+     * repeat their first mapping. */
+    PIO_Offset *map_start;
+
+    /** A 1-D array with iodesc->map_nranges elements, which are the
+     * number of mappings in each range. */
+    int *map_count;
 
     /** Number of tasks involved in the communication between comp and
      * io tasks. */
@@ -513,9 +580,17 @@ typedef struct io_desc_t
     /** The rearranger in use for this variable. */
     int rearranger;
 
+    /** True if the rearranger was chosen by PIO_REARR_AUTO. */
+    bool rearr_auto;
+
     /** Maximum number of regions in the decomposition. */
     int maxregions;
 
+    /** True if, on any IO task, the union of the regions (in the
+     * row-major order of the file) is not in the order of the IO
+     * buffer, see coalesce_regions(). */
+    bool regions_unordered;
+
     /** Does this decomp leave holes in the field (true) or write
      * everywhere (false) */
     bool needsfill;
@@ -557,11 +632,15 @@ typedef struct io_desc_t
     int *scount;
 
     /** Array (length ndof) for the BOX rearranger with the index
-     * for computation taks (send side during writes). */
-    PIO_Offset *sindex;
+     * for computation taks (send side during writes). The indexes are
+     * offsets in the local buffers (< ndof), so they are stored as
+     * int. */
+    int *sindex;
 
-    /** Index for the IO tasks (receive side during writes). */
-    PIO_Offset *rindex;
+    /** Index for the IO tasks (receive side during writes). The
+     * indexes are offsets in the IO buffer (< llen, which is limited
+     * to INT_MAX), so they are stored as int. */
+    int *rindex;
 
     /** Array (of length nrecvs) of receive MPI types in pio_swapm() call. */
     MPI_Datatype *rtype;
@@ -572,6 +651,16 @@ typedef struct io_desc_t
     /** Number of send MPI types in pio_swapm() call. */
     int num_stypes;
 
+    /** True if messages are packed into contiguous buffers instead
+     * of using rtype/stype. */
+    bool packed;
+
+    /** Pack list of the messages received (IO tasks only). */
+    pio_pack_list *rpack;
+
+    /** Pack list of the messages sent. */
+    pio_pack_list *spack;
+
     /** Used when writing fill data. */
     int holegridsize;
 
@@ -581,11 +670,11 @@ typedef struct io_desc_t
     /** Used when writing fill data. */
     int maxfillregions;
 
-    /** Linked list of regions. */
-    io_region *firstregion;
+    /** Table of regions. */
+    io_region_table *regions;
 
-    /** Used when writing fill data. */
-    io_region *fillregion;
+    /** Table of regions used when writing fill data. */
+    io_region_table *fillregions;
 
     /** Rearranger flow control options
      *  (handshake, non-blocking sends, pending requests)
@@ -597,6 +686,22 @@ typedef struct io_desc_t
      * group. */
     MPI_Comm subset_comm;
 
+    /** The ID of the io_desc_t, with the same decomposition map and a
+     * narrower data type, used to cache and rearrange data that is
+     * converted to the type of the variable on the compute tasks
+     * (e.g. double data written to a float variable). -1 if not
+     * created. */
+    int conv_ioid;
+
+    /** Bytes of memory held by the rearranger on this task, as
+     * accounted in the memory statistics of the IO system. */
+    PIO_Offset rearr_mem;
+
+    /** Cache budget, in bytes, of the data cached for this
+     * decomposition in the write multi buffer of a file (see
+     * PIOc_set_decomp_cache_limit()). 0 if there is no budget. */
+    PIO_Offset cache_limit;
+
 #if PIO_SAVE_DECOMPS
     /* Indicates whether this iodesc has been saved to disk (the
      * decomposition is dumped to disk)
@@ -608,6 +713,330 @@ typedef struct io_desc_t
     struct io_desc_t *next;
 } io_desc_t;
 
+/** Index of the minimum in the arrays of pio_decomp_stats_t. */
+#define PIO_STAT_MIN 0
+
+/** Index of the maximum in the arrays of pio_decomp_stats_t. */
+#define PIO_STAT_MAX 1
+
+/** Index of the average in the arrays of pio_decomp_stats_t. */
+#define PIO_STAT_AVG 2
+
+/** Length of the arrays of pio_decomp_stats_t. */
+#define PIO_NSTATS 3
+
+/**
+ * Communication and layout statistics of a decomposition (see
+ * PIOc_get_decomp_stats()). The arrays hold the minimum, maximum and
+ * average (indexed by PIO_STAT_MIN, PIO_STAT_MAX and PIO_STAT_AVG)
+ * of a per task value, over the compute tasks for the send side of a
+ * write and over the IO tasks for the receive side. The byte counts
+ * are for a single variable, a flush of several variables moves
+ * that many times more data.
+ */
+typedef struct pio_decomp_stats_t
+{
+    /** The rearranger of the decomposition. */
+    int rearranger;
+
+    /** Number of IO tasks that hold data of the decomposition. */
+    int num_aiotasks;
+
+    /** Non-zero if the messages are packed (see
+     * PIOc_set_rearr_pack()). */
+    int packed;
+
+    /** Non-zero if the decomposition leaves holes in the field that
+     * are written with fill values. */
+    int needsfill;
+
+    /** Maximum number of regions of an IO task. */
+    int maxregions;
+
+    /** Maximum number of fill regions of an IO task. */
+    int maxfillregions;
+
+    /** Maximum number of fill elements of an IO task. */
+    int maxholegridsize;
+
+    /** Number of IO tasks each compute task sends data to. */
+    double nsend_peers[PIO_NSTATS];
+
+    /** Number of compute tasks each IO task receives data from. */
+    double nrecv_peers[PIO_NSTATS];
+
+    /** Bytes sent by each compute task. */
+    double send_bytes[PIO_NSTATS];
+
+    /** Bytes received by each IO task. */
+    double recv_bytes[PIO_NSTATS];
+
+    /** Length (in elements) of the IO buffer of each IO task. */
+    double llen[PIO_NSTATS];
+
+    /** Maximum over average llen, 1 for a perfect balance. */
+    double llen_imbalance;
+
+    /** Average number of consecutive elements in a block of the
+     * rearranger messages (the MPI datatypes or pack lists). */
+    double blocksize;
+
+    /** Bytes of memory held by the rearranger on each task. */
+    double rearr_mem[PIO_NSTATS];
+} pio_decomp_stats_t;
+
+/** Memory of the compute side write caches. */
+#define PIO_MEM_WMB 0
+
+/** Memory of the IO side buffers of rearranged data (and of the
+ * compute side buffers used to convert data read to the user type). */
+#define PIO_MEM_IOBUF 1
+
+/** Memory of the IO side buffers of fill values. */
+#define PIO_MEM_FILLBUF 2
+
+/** Memory of the buffers attached to PnetCDF files on the IO tasks
+ * for non-blocking writes. */
+#define PIO_MEM_ATTACH 3
+
+/** Memory held by the rearrangers of the decompositions. */
+#define PIO_MEM_REARR 4
+
+/** Memory of released buffers kept by the IO system for reuse. */
+#define PIO_MEM_ARENA 5
+
+/** Memory of all the categories. */
+#define PIO_MEM_TOTAL 6
+
+/** Number of memory categories of pio_mem_stats_t. */
+#define PIO_MEM_NCATS 7
+
+/**
+ * Memory used by the buffers of an IO system or a file (see
+ * PIOc_get_mem_stats()), per category (PIO_MEM_WMB, PIO_MEM_IOBUF,
+ * ...). The bytes held by this task are in all of PIO_STAT_MIN,
+ * PIO_STAT_MAX and PIO_STAT_AVG, unless the statistics are reduced
+ * over the tasks of the IO system.
+ */
+typedef struct pio_mem_stats_t
+{
+    /** Bytes currently held. */
+    double cur[PIO_MEM_NCATS][PIO_NSTATS];
+
+    /** Highest number of bytes held. */
+    double peak[PIO_MEM_NCATS][PIO_NSTATS];
+} pio_mem_stats_t;
+
+/**
+ * Log of distributed array data written by an IO task to a file
+ * that is staged in node-local storage (see PIOc_set_staging_dir()).
+ */
+typedef struct pio_stage_log_t
+{
+    /** Path of the log file. */
+    char path[PIO_MAX_NAME + 1];
+
+    /** MPI file handle of the log, MPI_FILE_NULL if not open. */
+    MPI_File fh;
+
+    /** Size of the log in bytes. */
+    PIO_Offset size;
+
+    /** Handle (returned by the underlying library) of the file the
+     * log is drained into. */
+    int ncfh;
+
+    /** Pointer to the next log waiting to be drained. */
+    struct pio_stage_log_t *next;
+} pio_stage_log_t;
+
+/**
+ * A set of boxes (hyperslabs of the non-record dimensions) written
+ * to the subfiles of a subfiled dataset (see PIOc_set_subfiling()),
+ * the boxes of the I/O regions (or fill regions) of one
+ * decomposition.
+ */
+typedef struct pio_subfile_set_t
+{
+    /** 2 * ioid of the decomposition, plus 1 for the fill
+     * regions. Only used while writing. */
+    int key;
+
+    /** Number of dimensions of the boxes. */
+    int ndims;
+
+    /** Number of boxes in the set. */
+    int nboxes;
+
+    /** The subfile that contains each box. */
+    int *subfile;
+
+    /** Start and count of the boxes, ndims values per box. */
+    PIO_Offset *start;
+    PIO_Offset *count;
+} pio_subfile_set_t;
+
+/**
+ * Info about a subfiled dataset (see PIOc_set_subfiling()). The data
+ * of the dataset is in several subfiles, the index of the dataset
+ * records the boxes of the distributed arrays written to each
+ * subfile.
+ */
+typedef struct pio_subfile_t
+{
+    /** Number of subfiles. */
+    int nsubfiles;
+
+    /** Subfile written by this IO task, the communicator of the IO
+     * tasks writing it, and the rank of this task in it. */
+    int subfile;
+    MPI_Comm comm;
+    int rank;
+
+    /** Handles of all the subfiles, opened (in independent data
+     * mode) to read the dataset, NULL when writing. */
+    int *fh;
+
+    /** The subfile used for the metadata and the variables not
+     * written with PIOc_write_darray() (the subfile with the most
+     * records) when reading. */
+    int meta;
+
+    /** Number of box sets and the sets. */
+    int nsets;
+    pio_subfile_set_t *sets;
+
+    /** Number of (variable, box set) pairs, the ids of the variables
+     * and the index, in sets, of the box sets written for them. */
+    int nvarsets;
+    int *var_id;
+    int *var_set;
+} pio_subfile_t;
+
+#ifdef _HDF5
+/**
+ * Attribute of a variable in a file written with PIO_IOTYPE_HDF5,
+ * cached until the dataset of the variable is created.
+ */
+typedef struct hdf5_att_desc_t
+{
+    /** Name of the attribute. */
+    char name[PIO_MAX_NAME + 1];
+
+    /** Type of the attribute. */
+    nc_type xtype;
+
+    /** Number of elements in the attribute. */
+    PIO_Offset len;
+
+    /** Type of the cached value of the attribute. */
+    nc_type memtype;
+
+    /** Value of the attribute (len elements of type memtype). */
+    void *value;
+
+    /** Pointer to the next cached attribute of the variable. */
+    struct hdf5_att_desc_t *next;
+} hdf5_att_desc_t;
+
+/**
+ * Dimension of a file written with PIO_IOTYPE_HDF5.
+ */
+typedef struct hdf5_dim_desc_t
+{
+    /** Name of the dimension. */
+    char name[PIO_MAX_NAME + 1];
+
+    /** Length of the dimension, PIO_UNLIMITED for unlimited dims. */
+    PIO_Offset len;
+
+    /** Dimension scale dataset of the dimension, -1 if not created. */
+    hid_t dsid;
+
+    /** Id of the coordinate variable of the dimension, -1 if there
+     * is none. */
+    int coord_varid;
+} hdf5_dim_desc_t;
+
+/**
+ * Variable of a file written with PIO_IOTYPE_HDF5.
+ */
+typedef struct hdf5_var_desc_t
+{
+    /** Name of the variable. */
+    char name[PIO_MAX_NAME + 1];
+
+    /** Type of the variable. */
+    nc_type xtype;
+
+    /** Number of dimensions of the variable. */
+    int ndims;
+
+    /** Dimension ids of the variable. */
+    int *dimids;
+
+    /** Number of attributes of the variable. */
+    int natts;
+
+    /** Non-zero if the fill value of the variable is set. */
+    int fill_set;
+
+    /** Fill mode (NC_FILL or NC_NOFILL) of the variable. */
+    int fill_mode;
+
+    /** Fill value of the variable (8 bytes is enough for all the
+     * supported types). */
+    char fill_value[8];
+
+    /** Dataset of the variable, -1 if not created. */
+    hid_t dsid;
+
+    /** Current length of the record dimension (the first dimension)
+     * of record variables. */
+    PIO_Offset nrecs;
+
+    /** Attributes cached until the dataset is created. */
+    hdf5_att_desc_t *atts;
+} hdf5_var_desc_t;
+
+/**
+ * Info about a file written with PIO_IOTYPE_HDF5. The HDF5 files are
+ * written in the netCDF-4 format (dimensions are stored as HDF5
+ * dimension scales) and can be read with the netCDF library.
+ */
+typedef struct hdf5_file_desc_t
+{
+    /** HDF5 file id. */
+    hid_t fid;
+
+    /** Dataset transfer property list for collective writes. */
+    hid_t dxplid_coll;
+
+    /** Number of dimensions defined. */
+    int ndims;
+
+    /** Dimensions, dims_sz entries allocated. */
+    hdf5_dim_desc_t *dims;
+    int dims_sz;
+
+    /** Number of variables defined. */
+    int nvars;
+
+    /** Variables, vars_sz entries allocated. */
+    hdf5_var_desc_t *vars;
+    int vars_sz;
+
+    /** Number of global attributes defined. */
+    int ngatts;
+
+    /** Fill mode (NC_FILL or NC_NOFILL) of the file. */
+    int fill_mode;
+
+    /** Non-zero if the file is in define mode. */
+    int in_define_mode;
+} hdf5_file_desc_t;
+#endif /* _HDF5 */
+
 /**
  * IO system descriptor structure.
  *
@@ -726,6 +1155,79 @@ typedef struct iosystem_desc_t
     /** Rearranger options. */
     rearr_opt_t rearr_opts;
 
+    /** Non-zero to tune the rearranger options of each decomposition
+     * when it is initialized (see PIOc_set_rearr_autotune()). */
+    int rearr_autotune;
+
+    /** Non-zero to rearrange the data of new decompositions with
+     * packed contiguous messages (see PIOc_set_rearr_pack()). */
+    int rearr_pack;
+
+    /** Number of OpenMP threads used on the IO tasks to rearrange,
+     * fill and convert data (see PIOc_set_io_nthreads()). */
+    int io_nthreads;
+
+    /** Bytes currently held by the buffers of the IO system, per
+     * memory category (see PIOc_get_mem_stats()). */
+    PIO_Offset mem_cur[PIO_MEM_NCATS];
+
+    /** Highest number of bytes held per memory category. */
+    PIO_Offset mem_peak[PIO_MEM_NCATS];
+
+    /** Bytes cached for the files of the IO system with their own
+     * cache budget (see PIOc_set_file_cache_limit()), which are not
+     * counted against pio_buffer_size_limit. */
+    PIO_Offset file_cache_alloc;
+
+    /** The arena of the buffers of the files of the IO system, NULL
+     * until it is first used. */
+    struct pio_arena_t *arena;
+
+    /** Communicator of the tasks in my_comm on this compute node,
+     * created on first use by PIOc_get_vars_node_shared(). */
+    MPI_Comm node_comm;
+
+    /** Communicator of the root tasks (rank 0 in node_comm) of all
+     * compute nodes, MPI_COMM_NULL on other tasks. */
+    MPI_Comm node_roots_comm;
+
+    /** Rank, in node_roots_comm, of the root of the compute node
+     * with the IO root task. */
+    int node_roots_ioroot;
+
+    /** Node-local directory used to stage data written to files,
+     * NULL if staging is disabled. */
+    char *stage_dir;
+
+    /** Number of files staged in this IO system (used to name the
+     * staging logs). */
+    int stage_nfiles;
+
+    /** Staging logs of closed files, waiting to be drained. */
+    pio_stage_log_t *stage_pending;
+
+    /** Number of subfiles the PnetCDF files created in this IO
+     * system are written to, 0 or 1 to write a single file (see
+     * PIOc_set_subfiling()). */
+    int num_subfiles;
+
+    /** HDF5 file properties for files created with PIO_IOTYPE_HDF5
+     * (see PIOc_set_hdf5_props() and PIOc_set_chunk_cache()), 0 to
+     * use the HDF5 defaults. Objects larger than hdf5_align_threshold
+     * bytes are aligned to hdf5_alignment bytes in the file. */
+    PIO_Offset hdf5_align_threshold;
+    PIO_Offset hdf5_alignment;
+
+    /** Size of the blocks, in bytes, used to aggregate the metadata
+     * in HDF5 files. */
+    PIO_Offset hdf5_meta_block_size;
+
+    /** Size in bytes, number of slots and preemption policy of the
+     * chunk cache of HDF5 files. */
+    PIO_Offset hdf5_chunk_cache_size;
+    PIO_Offset hdf5_chunk_cache_nelems;
+    float hdf5_chunk_cache_preemption;
+
 #ifdef _ADIOS2
     /* ADIOS handle */
     adios2_adios *adiosH;
@@ -757,6 +1259,10 @@ typedef struct wmulti_buffer
      * multi-buffer have the same size. */
     int arraylen;
 
+    /** Sequence number, in the file, of the first array cached in the
+     * multi-buffer. Used to find the oldest buffer of a file. */
+    PIO_Offset seq;
+
     /** Array of varids. */
     int *vid;
 
@@ -929,12 +1435,54 @@ typedef struct file_desc_t
     /** Data buffer per IO decomposition for this file. */
     void *iobuf[PIO_IODESC_MAX_IDS];
 
+    /** Bytes currently held by the buffers of this file, per memory
+     * category (see PIOc_get_mem_stats()). */
+    PIO_Offset mem_cur[PIO_MEM_NCATS];
+
+    /** Highest number of bytes held per memory category. */
+    PIO_Offset mem_peak[PIO_MEM_NCATS];
+
+    /** Cache budget, in bytes, of the data cached in the write multi
+     * buffers of this file (see PIOc_set_file_cache_limit()). 0 if
+     * the file shares the cache limited by pio_buffer_size_limit. */
+    PIO_Offset cache_limit;
+
+    /** The policy used to choose the buffers flushed when the cache
+     * budget of this file is exceeded (PIO_CACHE_EVICT_LARGEST or
+     * PIO_CACHE_EVICT_OLDEST). */
+    int cache_evict;
+
+    /** Sequence number of the next array cached in the write multi
+     * buffers of this file. */
+    PIO_Offset wmb_seq;
+
     /** Pointer to the next file_desc_t in the list of open files. */
     struct file_desc_t *next;
 
     /** True if this task should participate in IO (only true for one
      * task with netcdf serial files. */
     int do_io;
+
+    /** The first error recorded on this task with the PIO_DEFER_ERROR
+     * error handler, PIO_NOERR if there is no pending error. */
+    int deferred_err;
+
+    /** Source file and line where deferred_err was recorded. */
+    const char *deferred_err_fname;
+    int deferred_err_line;
+
+    /** Staging log for the data written by this IO task, NULL if the
+     * file is not staged. */
+    pio_stage_log_t *stage;
+
+    /** Info about the subfiles of the file, NULL if the file is not
+     * subfiled. */
+    pio_subfile_t *subfile;
+
+#ifdef _HDF5
+    /** Info about the file, if it is written with PIO_IOTYPE_HDF5. */
+    hdf5_file_desc_t *hdf5;
+#endif
 } file_desc_t;
 
 /**
@@ -956,7 +1504,17 @@ enum PIO_IOTYPE
     PIO_IOTYPE_NETCDF4P = 4,
 
     /** ADIOS parallel */
-    PIO_IOTYPE_ADIOS = 5
+    PIO_IOTYPE_ADIOS = 5,
+
+    /** In-memory, data is kept on the I/O tasks (not written to disk) */
+    PIO_IOTYPE_MEMORY = 6,
+
+    /** Data is discarded after rearrangement (not written to disk) */
+    PIO_IOTYPE_NULL = 7,
+
+    /** HDF5 parallel, netCDF-4 format files written directly with
+     * the HDF5 library (write only) */
+    PIO_IOTYPE_HDF5 = 8
 };
 
 /**
@@ -968,7 +1526,38 @@ enum PIO_REARRANGERS
     PIO_REARR_BOX = 1,
 
     /** Subset rearranger. */
-    PIO_REARR_SUBSET = 2
+    PIO_REARR_SUBSET = 2,
+
+    /** Box or subset rearranger, chosen for each decomposition from
+     * its map (see PIOc_InitDecomp()). */
+    PIO_REARR_AUTO = 3
+};
+
+/**
+ * These are the supported placements of I/O tasks (see
+ * PIOc_set_iotask_placement()).
+ */
+enum PIO_IOTASK_PLACEMENTS
+{
+    /** Place I/O tasks using a base rank and stride (default). */
+    PIO_IOTASK_PLACEMENT_STRIDE = 0,
+
+    /** Spread I/O tasks evenly across the compute nodes. */
+    PIO_IOTASK_PLACEMENT_NODE = 1
+};
+
+/**
+ * These are the supported policies to choose the write multi buffers
+ * flushed when the cache budget of a file is exceeded (see
+ * PIOc_set_file_cache_limit()).
+ */
+enum PIO_CACHE_EVICT_POLICIES
+{
+    /** Flush the buffer holding the most data first (default). */
+    PIO_CACHE_EVICT_LARGEST = 0,
+
+    /** Flush the buffer holding the oldest data first. */
+    PIO_CACHE_EVICT_OLDEST = 1
 };
 
 /**
@@ -987,7 +1576,13 @@ enum PIO_ERROR_HANDLERS
     PIO_REDUCE_ERROR = (-53),
 
     /** Errors are returned to caller with no internal action. */
-    PIO_RETURN_ERROR = (-54)
+    PIO_RETURN_ERROR = (-54),
+
+    /** Errors from calls that do not return any data (defining
+     * and writing) are recorded locally on each process, and
+     * reduced across all processes in PIOc_enddef(), PIOc_sync(),
+     * PIOc_closefile() and PIOc_check_errors(). */
+    PIO_DEFER_ERROR = (-55)
 };
 
 
@@ -1007,6 +1602,17 @@ extern "C" {
     int PIOc_InitDecomp_bc(int iosysid, int basetype, int ndims, const int *gdimlen,
                            const long int *start, const long int *count, int *ioidp);
 
+    /* Init decomposition with 1-based int compmap array. */
+    int PIOc_InitDecomp_i4(int iosysid, int pio_type, int ndims, const int *gdimlen, int maplen,
+                           const int *compmap, int *ioidp, const int *rearr,
+                           const PIO_Offset *iostart, const PIO_Offset *iocount);
+
+    /* Init decomposition with ranges of 1-based compmap values. */
+    int PIOc_InitDecomp_ranges(int iosysid, int pio_type, int ndims, const int *gdimlen,
+                               int nranges, const PIO_Offset *rstart, const PIO_Offset *rcount,
+                               int *ioidp, const int *rearr, const PIO_Offset *iostart,
+                               const PIO_Offset *iocount);
+
     /* Init decomposition with 0-based compmap array. */
     int PIOc_init_decomp(int iosysid, int pio_type, int ndims, const int *gdimlen, int maplen,
                          const PIO_Offset *compmap, int *ioidp, int rearranger,
@@ -1062,6 +1668,10 @@ extern "C" {
                             int max_pend_req_c2i,
                             bool enable_hs_i2c, bool enable_isend_i2c,
                             int max_pend_req_i2c);
+    int PIOc_set_rearr_autotune(int iosysid, int enable);
+    int PIOc_set_rearr_pack(int iosysid, int enable);
+    int PIOc_set_io_nthreads(int iosysid, int nthreads);
+    int PIOc_set_buffer_hugepages(int iosysid, int enable);
     /* Distributed data. */
     int PIOc_advanceframe(int ncid, int varid);
     int PIOc_setframe(int ncid, int varid, int frame);
@@ -1071,11 +1681,20 @@ extern "C" {
                                 void *array, const int *frame, void **fillvalue, bool flushtodisk);
     int PIOc_read_darray(int ncid, int varid, int ioid, PIO_Offset arraylen, void *array);
     int PIOc_get_local_array_size(int ioid);
+    int PIOc_get_decomp_stats(int iosysid, int ioid, pio_decomp_stats_t *stats);
+    int PIOc_get_mem_stats(int iosysid, int ncid, bool reduce, pio_mem_stats_t *stats);
 
     /* Handling files. */
     int PIOc_redef(int ncid);
     int PIOc_enddef(int ncid);
     int PIOc_sync(int ncid);
+    int PIOc_check_errors(int ncid);
+
+    /* Read data that is replicated on all tasks into node shared memory. */
+    int PIOc_get_vars_node_shared(int ncid, int varid, const PIO_Offset *start,
+                                  const PIO_Offset *count, const PIO_Offset *stride,
+                                  nc_type xtype, void **bufp, MPI_Win *winp);
+    int PIOc_free_node_shared(MPI_Win *winp);
     int PIOc_deletefile(int iosysid, const char *filename);
     int PIOc_createfile(int iosysid, int *ncidp,  int *iotype, const char *fname, int mode);
     int PIOc_create(int iosysid, const char *path, int cmode, int *ncidp);
@@ -1092,11 +1711,27 @@ extern "C" {
     int PIOc_inq_unlimdims(int ncid, int *nunlimdimsp, int *unlimdimidsp);
     int PIOc_inq_type(int ncid, nc_type xtype, char *name, PIO_Offset *sizep);
     int PIOc_set_blocksize(int newblocksize);
+    int PIOc_set_stripesize(int newstripesize);
     int PIOc_File_is_Open(int ncid);
 
     /* Set the IO node data buffer size limit. */
     PIO_Offset PIOc_set_buffer_size_limit(PIO_Offset limit);
 
+    /* Set the cache budget of a file, or of a decomposition. */
+    int PIOc_set_file_cache_limit(int ncid, PIO_Offset limit, int policy);
+    int PIOc_set_decomp_cache_limit(int iosysid, int ioid, PIO_Offset limit);
+
+    /* Set the placement of IO tasks for IO systems created later. */
+    int PIOc_set_iotask_placement(int placement, int niotasks_per_node);
+
+    /* Stage data written to files in node-local storage. */
+    int PIOc_set_staging_dir(int iosysid, const char *dir);
+    int PIOc_wait_staged(int iosysid);
+
+    /* Write files created later as several subfiles, merge subfiles. */
+    int PIOc_set_subfiling(int iosysid, int nsubfiles);
+    int PIOc_merge_subfiles(int iosysid, const char *filename, const char *outfilename);
+
     /* Set the error hanlding for a file. */
     int PIOc_Set_File_Error_Handling(int ncid, int method);
 
@@ -1105,6 +1740,8 @@ extern "C" {
                              float preemption);
     int PIOc_get_chunk_cache(int iosysid, int iotype, PIO_Offset *sizep, PIO_Offset *nelemsp,
                              float *preemptionp);
+    int PIOc_set_hdf5_props(int iosysid, PIO_Offset align_threshold, PIO_Offset alignment,
+                            PIO_Offset meta_block_size);
 
     /* Dimensions. */
     int PIOc_inq_dim(int ncid, int dimid, char *name, PIO_Offset *lenp);
@@ -1137,6 +1774,7 @@ extern "C" {
                              int *deflate_levelp);
     int PIOc_inq_var_szip(int ncid, int varid, int *options_maskp, int *pixels_per_blockp);
     int PIOc_def_var_chunking(int ncid, int varid, int storage, const PIO_Offset *chunksizesp);
+    int PIOc_def_var_chunking_auto(int ncid, int varid, int ioid);
     int PIOc_inq_var_chunking(int ncid, int varid, int *storagep, PIO_Offset *chunksizesp);
     int PIOc_def_var_endian(int ncid, int varid, int endian);
     int PIOc_inq_var_endian(int ncid, int varid, int *endianp);
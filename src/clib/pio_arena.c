@@ -0,0 +1,621 @@
+/**
+ * @file
+ * Size-class arena allocator for the buffers of an IO system.
+ *
+ * Each IO system has an arena, which holds the buffers of its files
+ * (see pio_mem_get()): the write multi buffers caching user data on
+ * the compute tasks, and the buffers of rearranged data and fill
+ * values on the IO tasks.
+ *
+ * Blocks of up to ARENA_MAX_CLASS_SZ bytes are rounded up to one of
+ * the size classes, four per power of two, and carved out of slabs
+ * of ARENA_SLAB_SZ bytes. A released block goes to the free list of
+ * its class, to be reused by the next block of the class, so getting
+ * and releasing a block never searches a free list and the arena does
+ * not fragment. A block resized within its class (e.g. a write multi
+ * buffer caching one more array) is resized in place. Larger blocks
+ * are rounded up to a multiple of ARENA_SLAB_SZ and allocated
+ * directly, on huge pages if enabled (see
+ * PIOc_set_buffer_hugepages()). The last ARENA_LARGE_CACHE_N large
+ * blocks released are kept to be reused by the next large blocks
+ * that fit in them, so that the buffers of the files flushed in turn
+ * are not returned to the system (and faulted in again) on each
+ * flush.
+ *
+ * The bytes the arena keeps for reuse (the released blocks, the
+ * unused parts of the slabs and the cached large blocks, see
+ * pio_arena_retained()) are limited by pio_buffer_size_limit (see
+ * PIOc_set_buffer_size_limit()): when a block is released beyond
+ * the limit, the cached large blocks and then the slabs of the size
+ * classes with no block in use are returned to the system. The rest
+ * is returned when the arena is freed.
+ *
+ * When the library is built with PIO_USE_MALLOC each block is
+ * allocated and freed with malloc() and free(), for its exact size.
+ *
+ * When the library is built with OpenMP the arena is locked, so that
+ * threads can get and release blocks.
+ */
+/* For MAP_ANONYMOUS, MAP_HUGETLB and MADV_HUGEPAGE with -std=c99. */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <pio_config.h>
+#include <pio.h>
+#include <pio_internal.h>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#endif
+
+/* Huge pages are mapped with mmap(). */
+#if defined(MAP_ANONYMOUS) && !PIO_USE_MALLOC
+#define ARENA_USE_MMAP 1
+#endif
+
+/* Smallest size class, 64 bytes. */
+#define ARENA_MIN_SHIFT 6
+
+/* Largest size class, 1 MB. */
+#define ARENA_MAX_SHIFT 20
+#define ARENA_MAX_CLASS_SZ ((size_t)1 << ARENA_MAX_SHIFT)
+
+/* Number of size classes, four per power of two. */
+#define ARENA_NCLASSES (4 * (ARENA_MAX_SHIFT - ARENA_MIN_SHIFT) + 1)
+
+/* Size of the slabs the blocks of a size class are carved out of. */
+#define ARENA_SLAB_SZ ((size_t)1 << 20)
+
+/* Size of a huge page, blocks of at least this size are allocated on
+ * huge pages if enabled. */
+#define ARENA_HUGEPAGE_SZ ((size_t)2 << 20)
+
+/* Bytes in front of each block (and slab), a multiple of 16 to keep
+ * the alignment of the data. */
+#define ARENA_HDR_SZ 16
+
+/* Number of released large blocks kept for reuse. */
+#define ARENA_LARGE_CACHE_N 8
+
+/* Kinds of blocks larger than the largest size class. */
+#define ARENA_LARGE_MALLOC (-1)
+#define ARENA_LARGE_MMAP (-2)
+
+#if PIO_USE_OPENMP
+#define ARENA_LOCK(arena) omp_set_lock(&(arena)->lock)
+#define ARENA_UNLOCK(arena) omp_unset_lock(&(arena)->lock)
+#else
+#define ARENA_LOCK(arena)
+#define ARENA_UNLOCK(arena)
+#endif
+
+/* Header in front of each slab. */
+typedef struct arena_slab_t
+{
+    /* Next slab of the size class. */
+    struct arena_slab_t *next;
+
+    /* Size of the slab in bytes, including the header. */
+    size_t size;
+} arena_slab_t;
+
+/* Header in front of each block. */
+typedef struct arena_hdr_t
+{
+    /* Size class of the block, or the kind of a large block. */
+    int cls;
+
+    /* Size of the block in bytes, including the header. */
+    size_t size;
+} arena_hdr_t;
+
+/* The blocks of one size class. */
+typedef struct arena_class_t
+{
+    /* List of released blocks, linked through their data. */
+    arena_hdr_t *free;
+
+    /* Number of blocks in the free list. */
+    long nfree;
+
+    /* Number of blocks in use. */
+    long nused;
+
+    /* List of the slabs of the class. */
+    arena_slab_t *slabs;
+
+    /* Unused part of the last slab of the class. */
+    char *next;
+    char *end;
+} arena_class_t;
+
+/** An arena of blocks (see pio_arena_create()). */
+struct pio_arena_t
+{
+    /* The size classes. */
+    arena_class_t classes[ARENA_NCLASSES];
+
+    /* Released large blocks kept for reuse. */
+    arena_hdr_t *large[ARENA_LARGE_CACHE_N];
+    int nlarge;
+
+    /* Non-zero to allocate large blocks on huge pages. */
+    int hugepages;
+
+    /* Bytes of the blocks in use, including headers. */
+    PIO_Offset curalloc;
+
+    /* Bytes of the slabs and cached large blocks that are not in
+     * use. */
+    PIO_Offset retained;
+
+    /* Number of blocks got and released. */
+    long nget;
+    long nrel;
+
+#if PIO_USE_OPENMP
+    /* Lock of the arena. */
+    omp_lock_t lock;
+#endif
+};
+
+/* Size class of a block of size bytes (including the header), at
+ * most ARENA_MAX_CLASS_SZ. */
+static int arena_class(size_t size)
+{
+    int e = 0;
+
+    if (size <= ((size_t)1 << ARENA_MIN_SHIFT))
+        return 0;
+
+    /* size is in (2^e, 2^(e + 1)], which holds four classes. */
+    for (size_t s = size - 1; s > 1; s >>= 1)
+        e++;
+
+    return 4 * (e - ARENA_MIN_SHIFT) + (int)(((size - 1) >> (e - 2)) & 3) + 1;
+}
+
+/* Size of the blocks of a size class. */
+static size_t arena_class_size(int cls)
+{
+    int e = ARENA_MIN_SHIFT + (cls - 1) / 4;
+
+    if (cls == 0)
+        return (size_t)1 << ARENA_MIN_SHIFT;
+
+    return ((size_t)1 << e) + (size_t)((cls - 1) % 4 + 1) * ((size_t)1 << (e - 2));
+}
+
+/**
+ * Create an arena.
+ *
+ * @param arenap pointer that gets the arena.
+ * @returns 0 for success, error code otherwise.
+ */
+int pio_arena_create(pio_arena_t **arenap)
+{
+    pio_arena_t *arena;
+
+    pioassert(arenap, "invalid input", __FILE__, __LINE__);
+
+    if (!(arena = calloc(1, sizeof(pio_arena_t))))
+        return PIO_ENOMEM;
+#if PIO_USE_OPENMP
+    omp_init_lock(&arena->lock);
+#endif
+    *arenap = arena;
+
+    return PIO_NOERR;
+}
+
+/* Return a large block to the system. */
+static void arena_free_large(arena_hdr_t *hdr)
+{
+#ifdef ARENA_USE_MMAP
+    if (hdr->cls == ARENA_LARGE_MMAP)
+    {
+        munmap(hdr, hdr->size);
+        return;
+    }
+#endif
+    free(hdr);
+}
+
+/* Return the slabs of a size class to the system. Must be called
+ * with the arena locked, when no block of the class is in use. */
+static void arena_free_slabs(pio_arena_t *arena, arena_class_t *c)
+{
+    while (c->slabs)
+    {
+        arena_slab_t *slab = c->slabs;
+
+        c->slabs = slab->next;
+        arena->retained -= slab->size;
+        free(slab);
+    }
+    c->free = NULL;
+    c->nfree = 0;
+    c->next = NULL;
+    c->end = NULL;
+}
+
+/* Return memory kept for reuse to the system until the arena keeps
+ * at most pio_buffer_size_limit bytes: the cached large blocks
+ * first, then the slabs of the size classes with no block in use.
+ * Must be called with the arena locked. */
+static void arena_trim(pio_arena_t *arena)
+{
+    while (arena->retained > pio_buffer_size_limit && arena->nlarge > 0)
+    {
+        arena_hdr_t *hdr = arena->large[--arena->nlarge];
+
+        arena->retained -= hdr->size;
+        arena_free_large(hdr);
+    }
+    for (int cls = ARENA_NCLASSES - 1; cls >= 0; cls--)
+    {
+        if (arena->retained <= pio_buffer_size_limit)
+            break;
+        if (!arena->classes[cls].nused)
+            arena_free_slabs(arena, &arena->classes[cls]);
+    }
+}
+
+/**
+ * Free an arena, its slabs and its cached large blocks. Blocks larger
+ * than the largest size class must be released before.
+ *
+ * @param arena pointer to the arena, may be NULL.
+ */
+void pio_arena_free(pio_arena_t *arena)
+{
+    if (!arena)
+        return;
+
+    LOG((2, "pio_arena_free curalloc = %lld retained = %lld nget = %ld nrel = %ld",
+         (long long)arena->curalloc, (long long)arena->retained, arena->nget, arena->nrel));
+
+    for (int i = 0; i < arena->nlarge; i++)
+        arena_free_large(arena->large[i]);
+    for (int cls = 0; cls < ARENA_NCLASSES; cls++)
+        arena_free_slabs(arena, &arena->classes[cls]);
+#if PIO_USE_OPENMP
+    omp_destroy_lock(&arena->lock);
+#endif
+    free(arena);
+}
+
+/**
+ * Allocate large blocks of an arena on huge pages, or not. Only
+ * blocks allocated later are affected.
+ *
+ * @param arena pointer to the arena.
+ * @param enable non-zero to use huge pages.
+ */
+void pio_arena_set_hugepages(pio_arena_t *arena, int enable)
+{
+    pioassert(arena, "invalid input", __FILE__, __LINE__);
+
+    arena->hugepages = enable;
+}
+
+/* Get a block larger than the largest size class, of size bytes
+ * including the header, from the cached large blocks. The smallest
+ * cached block that fits is used, unless it is more than twice as
+ * large. Must be called with the arena locked. */
+static arena_hdr_t *arena_reuse_large(pio_arena_t *arena, size_t size)
+{
+    int best = -1;
+    arena_hdr_t *hdr;
+
+    for (int i = 0; i < arena->nlarge; i++)
+    {
+        size_t lsize = arena->large[i]->size;
+
+        if (lsize >= size && lsize / 2 <= size &&
+            (best < 0 || lsize < arena->large[best]->size))
+            best = i;
+    }
+    if (best < 0)
+        return NULL;
+
+    hdr = arena->large[best];
+    arena->large[best] = arena->large[--arena->nlarge];
+    arena->retained -= hdr->size;
+
+    return hdr;
+}
+
+/* Allocate a block larger than the largest size class, of size bytes
+ * including the header, rounded up to a multiple of ARENA_SLAB_SZ.
+ * Huge pages are reserved pages if the system has some (MAP_HUGETLB),
+ * transparent huge pages otherwise. */
+static arena_hdr_t *arena_alloc_large(pio_arena_t *arena, size_t size)
+{
+    arena_hdr_t *hdr = NULL;
+    int kind = ARENA_LARGE_MALLOC;
+
+    size = (size + ARENA_SLAB_SZ - 1) / ARENA_SLAB_SZ * ARENA_SLAB_SZ;
+
+#ifdef ARENA_USE_MMAP
+    if (arena->hugepages && size >= ARENA_HUGEPAGE_SZ)
+    {
+        size_t msize = (size + ARENA_HUGEPAGE_SZ - 1) / ARENA_HUGEPAGE_SZ * ARENA_HUGEPAGE_SZ;
+        void *p = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+        p = mmap(NULL, msize, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+        if (p == MAP_FAILED)
+        {
+            p = mmap(NULL, msize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#ifdef MADV_HUGEPAGE
+            if (p != MAP_FAILED)
+                madvise(p, msize, MADV_HUGEPAGE);
+#endif
+        }
+        if (p != MAP_FAILED)
+        {
+            hdr = p;
+            size = msize;
+            kind = ARENA_LARGE_MMAP;
+        }
+    }
+#endif /* ARENA_USE_MMAP */
+
+    if (!hdr && !(hdr = malloc(size)))
+        return NULL;
+    hdr->cls = kind;
+    hdr->size = size;
+
+    return hdr;
+}
+
+/**
+ * Get a block from an arena.
+ *
+ * @param arena pointer to the arena.
+ * @param size the size of the block in bytes.
+ * @returns pointer to the block, NULL if out of memory.
+ */
+void *pio_arena_alloc(pio_arena_t *arena, size_t size)
+{
+    arena_hdr_t *hdr;
+    size_t bsize = size + ARENA_HDR_SZ;
+
+    pioassert(arena, "invalid input", __FILE__, __LINE__);
+
+    if (PIO_USE_MALLOC)
+    {
+        /* The block is allocated by the system, for its exact
+         * size. */
+        if (!(hdr = malloc(bsize)))
+            return NULL;
+        hdr->cls = ARENA_LARGE_MALLOC;
+        hdr->size = bsize;
+        ARENA_LOCK(arena);
+    }
+    else if (bsize > ARENA_MAX_CLASS_SZ)
+    {
+        ARENA_LOCK(arena);
+        if (!(hdr = arena_reuse_large(arena, bsize)))
+        {
+            ARENA_UNLOCK(arena);
+            if (!(hdr = arena_alloc_large(arena, bsize)))
+                return NULL;
+            ARENA_LOCK(arena);
+        }
+    }
+    else
+    {
+        int cls = arena_class(bsize);
+        size_t csize = arena_class_size(cls);
+        arena_class_t *c = &arena->classes[cls];
+
+        ARENA_LOCK(arena);
+        if (c->free)
+        {
+            /* Reuse a released block of the class. */
+            hdr = c->free;
+            c->free = *(arena_hdr_t **)((char *)hdr + ARENA_HDR_SZ);
+            c->nfree--;
+        }
+        else
+        {
+            /* Carve the block out of the last slab of the class, get
+             * a new slab if it is used up. */
+            if (c->next == c->end)
+            {
+                size_t nblocks = (ARENA_SLAB_SZ >= csize) ? ARENA_SLAB_SZ / csize : 1;
+                arena_slab_t *slab;
+
+                if (!(slab = malloc(ARENA_HDR_SZ + nblocks * csize)))
+                {
+                    ARENA_UNLOCK(arena);
+                    return NULL;
+                }
+                slab->next = c->slabs;
+                slab->size = ARENA_HDR_SZ + nblocks * csize;
+                c->slabs = slab;
+                c->next = (char *)slab + ARENA_HDR_SZ;
+                c->end = c->next + nblocks * csize;
+                arena->retained += slab->size;
+            }
+            hdr = (arena_hdr_t *)c->next;
+            c->next += csize;
+        }
+        c->nused++;
+        arena->retained -= csize;
+        hdr->cls = cls;
+        hdr->size = csize;
+    }
+    arena->curalloc += hdr->size;
+    arena->nget++;
+    ARENA_UNLOCK(arena);
+
+    return (char *)hdr + ARENA_HDR_SZ;
+}
+
+/**
+ * Release a block of an arena.
+ *
+ * @param arena pointer to the arena.
+ * @param buf pointer to the block, may be NULL.
+ */
+void pio_arena_release(pio_arena_t *arena, void *buf)
+{
+    arena_hdr_t *hdr;
+    int cls;
+
+    pioassert(arena, "invalid input", __FILE__, __LINE__);
+
+    if (!buf)
+        return;
+    hdr = (arena_hdr_t *)((char *)buf - ARENA_HDR_SZ);
+    cls = hdr->cls;
+
+    ARENA_LOCK(arena);
+    arena->curalloc -= hdr->size;
+    arena->nrel++;
+    /* Blocks allocated for their exact size (PIO_USE_MALLOC) are not
+     * kept. */
+    if (!PIO_USE_MALLOC && cls >= 0)
+    {
+        arena_class_t *c = &arena->classes[cls];
+
+        *(arena_hdr_t **)buf = c->free;
+        c->free = hdr;
+        c->nfree++;
+        c->nused--;
+        arena->retained += hdr->size;
+        hdr = NULL;
+    }
+    else if (!PIO_USE_MALLOC && arena->nlarge < ARENA_LARGE_CACHE_N)
+    {
+        arena->large[arena->nlarge++] = hdr;
+        arena->retained += hdr->size;
+        hdr = NULL;
+    }
+    if (arena->retained > pio_buffer_size_limit)
+        arena_trim(arena);
+    ARENA_UNLOCK(arena);
+
+    /* The cache of large blocks is full, or the block was allocated
+     * by the system. */
+    if (hdr)
+        arena_free_large(hdr);
+}
+
+/**
+ * Resize a block of an arena, or get a new block if buf is NULL. The
+ * block is resized in place if the new size fits in the block. A
+ * large block grows by at least half its size, so that a buffer
+ * growing by one array at a time is not copied for each array. If
+ * out of memory, the block is unchanged.
+ *
+ * @param arena pointer to the arena.
+ * @param buf pointer to the block, may be NULL.
+ * @param size the new size of the block in bytes.
+ * @returns pointer to the block, NULL if out of memory.
+ */
+void *pio_arena_realloc(pio_arena_t *arena, void *buf, size_t size)
+{
+    arena_hdr_t *hdr;
+    void *newbuf;
+    size_t oldsize;
+
+    if (!buf)
+        return pio_arena_alloc(arena, size);
+
+    hdr = (arena_hdr_t *)((char *)buf - ARENA_HDR_SZ);
+    oldsize = hdr->size - ARENA_HDR_SZ;
+
+    if (PIO_USE_MALLOC)
+    {
+        /* The block is resized by the system, for its exact size. */
+        if (!(hdr = realloc(hdr, size + ARENA_HDR_SZ)))
+            return NULL;
+        hdr->size = size + ARENA_HDR_SZ;
+        ARENA_LOCK(arena);
+        arena->curalloc += (PIO_Offset)size - (PIO_Offset)oldsize;
+        ARENA_UNLOCK(arena);
+
+        return (char *)hdr + ARENA_HDR_SZ;
+    }
+
+    if (size <= oldsize)
+        return buf;
+    if (size + ARENA_HDR_SZ > ARENA_MAX_CLASS_SZ)
+        size = max(size, oldsize + oldsize / 2);
+
+    if (!(newbuf = pio_arena_alloc(arena, size)))
+        return NULL;
+    memcpy(newbuf, buf, oldsize);
+    pio_arena_release(arena, buf);
+
+    return newbuf;
+}
+
+/**
+ * Get the number of bytes an arena keeps for reuse: the released
+ * blocks and the unused parts of the slabs of the size classes, and
+ * the cached large blocks. They are held by the process, but not by
+ * any buffer.
+ *
+ * @param arena pointer to the arena.
+ * @returns the number of bytes.
+ */
+PIO_Offset pio_arena_retained(pio_arena_t *arena)
+{
+    PIO_Offset retained;
+
+    pioassert(arena, "invalid input", __FILE__, __LINE__);
+
+    ARENA_LOCK(arena);
+    retained = arena->retained;
+    ARENA_UNLOCK(arena);
+
+    return retained;
+}
+
+/**
+ * Get the statistics of an arena, as bstats() of the bget package.
+ *
+ * @param arena pointer to the arena.
+ * @param curalloc pointer that gets the bytes of the blocks in use.
+ * @param totfree pointer that gets the bytes of the released blocks
+ * and of the unused parts of the slabs.
+ * @param maxfree pointer that gets the size of the largest free
+ * block.
+ * @param nget pointer that gets the number of blocks got.
+ * @param nrel pointer that gets the number of blocks released.
+ */
+void pio_arena_stats(pio_arena_t *arena, PIO_Offset *curalloc, PIO_Offset *totfree,
+                     PIO_Offset *maxfree, long *nget, long *nrel)
+{
+    pioassert(arena && curalloc && totfree && maxfree && nget && nrel, "invalid input",
+              __FILE__, __LINE__);
+
+    ARENA_LOCK(arena);
+    *curalloc = arena->curalloc;
+    *totfree = 0;
+    *maxfree = 0;
+    for (int cls = 0; cls < ARENA_NCLASSES; cls++)
+    {
+        arena_class_t *c = &arena->classes[cls];
+        PIO_Offset csize = arena_class_size(cls);
+        PIO_Offset nbytes = c->nfree * csize + (c->end - c->next);
+
+        *totfree += nbytes;
+        if (nbytes > 0)
+            *maxfree = csize - ARENA_HDR_SZ;
+    }
+    for (int i = 0; i < arena->nlarge; i++)
+    {
+        *totfree += arena->large[i]->size;
+        *maxfree = max(*maxfree, (PIO_Offset)(arena->large[i]->size - ARENA_HDR_SZ));
+    }
+    *nget = arena->nget;
+    *nrel = arena->nrel;
+    ARENA_UNLOCK(arena);
+}
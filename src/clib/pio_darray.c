@@ -38,6 +38,14 @@ PIO_Offset maxusage = 0;
  * The pio_buffer_size_limit will only apply to files opened after
  * the setting is changed.
  *
+ * The limit applies to each IO system separately: the data cached
+ * for the files of an IO system (that do not have their own budget,
+ * see PIOc_set_file_cache_limit()) is flushed when the buffers of
+ * the IO system exceed the limit, and each IO system keeps at most
+ * about limit bytes of released buffers for reuse (PIO_MEM_ARENA in
+ * PIOc_get_mem_stats()). A process with N IO systems may hold N
+ * times the limit.
+ *
  * @param limit the size of the buffer on the IO nodes
  * @return The previous limit setting.
  */
@@ -52,6 +60,99 @@ PIO_Offset PIOc_set_buffer_size_limit(PIO_Offset limit)
     return oldsize;
 }
 
+/**
+ * Set the cache budget of a file.
+ *
+ * By default the data cached by PIOc_write_darray() for all files
+ * shares one cache, limited by pio_buffer_size_limit (see
+ * PIOc_set_buffer_size_limit()), so the data cached for one file can
+ * force the data of another file to be flushed. The data cached for
+ * a file with its own budget is not counted in the shared cache. It
+ * is flushed when the budget is exceeded: the write multi buffers of
+ * the file are flushed, the buffer holding the most data (or the
+ * oldest data) first, until the new data fits in the budget.
+ *
+ * This is usually called right after the file is created, with the
+ * same values on all compute tasks.
+ *
+ * @param ncid the ncid of the open file.
+ * @param limit the cache budget on each task in bytes, 0 to use the
+ * shared cache again.
+ * @param policy the buffers flushed first, PIO_CACHE_EVICT_LARGEST
+ * or PIO_CACHE_EVICT_OLDEST.
+ * @returns 0 for success, error code otherwise.
+ * @ingroup PIO_write_darray
+ */
+int PIOc_set_file_cache_limit(int ncid, PIO_Offset limit, int policy)
+{
+    file_desc_t *file;
+    int ierr;
+
+    LOG((1, "PIOc_set_file_cache_limit ncid = %d limit = %lld policy = %d",
+         ncid, (long long)limit, policy));
+
+    /* Get the file info. */
+    if ((ierr = pio_get_file(ncid, &file)))
+        return pio_err(NULL, NULL, PIO_EBADID, __FILE__, __LINE__,
+                       "Setting the cache budget of file failed. Invalid file id (ncid=%d) provided", ncid);
+
+    if (limit < 0 || (policy != PIO_CACHE_EVICT_LARGEST && policy != PIO_CACHE_EVICT_OLDEST))
+        return pio_err(file->iosystem, file, PIO_EINVAL, __FILE__, __LINE__,
+                       "Setting the cache budget of file (%s, ncid=%d) failed. Invalid budget (%lld bytes) or eviction policy (%d) provided", pio_get_fname_from_file(file), ncid, (long long)limit, policy);
+
+    /* Move the data already cached for the file out of (or back
+     * into) the shared cache. */
+    if (file->cache_limit == 0 && limit > 0)
+        file->iosystem->file_cache_alloc += file->mem_cur[PIO_MEM_WMB];
+    else if (file->cache_limit > 0 && limit == 0)
+        file->iosystem->file_cache_alloc -= file->mem_cur[PIO_MEM_WMB];
+
+    file->cache_limit = limit;
+    file->cache_evict = policy;
+
+    return PIO_NOERR;
+}
+
+/**
+ * Set the cache budget of a decomposition. The data of each file
+ * cached for the decomposition by PIOc_write_darray() is flushed
+ * when it exceeds the budget, in addition to the limits of the cache
+ * of the file (see PIOc_set_file_cache_limit()).
+ *
+ * @param iosysid the IO system ID.
+ * @param ioid the ID of the decomposition.
+ * @param limit the cache budget on each task in bytes, 0 for no
+ * budget.
+ * @returns 0 for success, error code otherwise.
+ * @ingroup PIO_write_darray
+ */
+int PIOc_set_decomp_cache_limit(int iosysid, int ioid, PIO_Offset limit)
+{
+    iosystem_desc_t *ios;
+    io_desc_t *iodesc;
+
+    LOG((1, "PIOc_set_decomp_cache_limit iosysid = %d ioid = %d limit = %lld",
+         iosysid, ioid, (long long)limit));
+
+    /* Get the IO system info. */
+    if (!(ios = pio_get_iosystem_from_id(iosysid)))
+        return pio_err(NULL, NULL, PIO_EBADID, __FILE__, __LINE__,
+                       "Setting the cache budget of I/O decomposition (ioid=%d) failed. Invalid io system id (%d) provided", ioid, iosysid);
+
+    /* Get decomposition information. */
+    if (!(iodesc = pio_get_iodesc_from_id(ioid)))
+        return pio_err(ios, NULL, PIO_EBADID, __FILE__, __LINE__,
+                       "Setting the cache budget of I/O decomposition failed. Invalid I/O descriptor id (ioid=%d) provided", ioid);
+
+    if (limit < 0)
+        return pio_err(ios, NULL, PIO_EINVAL, __FILE__, __LINE__,
+                       "Setting the cache budget of I/O decomposition (ioid=%d) failed. Invalid budget (%lld bytes) provided", ioid, (long long)limit);
+
+    iodesc->cache_limit = limit;
+
+    return PIO_NOERR;
+}
+
 /**
  * Write one or more arrays with the same IO decomposition to the
  * file.
@@ -276,7 +377,7 @@ int PIOc_write_darray_multi(int ncid, const int *varids, int ioid, int nvars,
     if (rlen > 0)
     {
         /* Allocate memory for the buffer for all vars/records. */
-        if (!(file->iobuf[ioid - PIO_IODESC_START_ID] = bget(iodesc->mpitype_size * rlen)))
+        if (!(file->iobuf[ioid - PIO_IODESC_START_ID] = pio_mem_get(file, PIO_MEM_IOBUF, iodesc->mpitype_size * rlen)))
         {
             return pio_err(ios, file, PIO_ENOMEM, __FILE__, __LINE__,
                             "Writing multiple variables to file (%s, ncid=%d) failed. Out of memory (Trying to allocate %lld bytes for rearranged data for multiple variables with the same decomposition)", pio_get_fname_from_file(file), ncid, (unsigned long long)(iodesc->mpitype_size * rlen));
@@ -288,6 +389,10 @@ int PIOc_write_darray_multi(int ncid, const int *varids, int ioid, int nvars,
         if (iodesc->needsfill && iodesc->rearranger == PIO_REARR_BOX)
         {
             LOG((3, "inerting fill values iodesc->maxiobuflen = %d", iodesc->maxiobuflen));
+#if PIO_USE_OPENMP
+            int nthreads = pio_io_nthreads(ios);
+#pragma omp parallel for collapse(2) num_threads(nthreads) if (nthreads > 1)
+#endif
             for (int nv = 0; nv < nvars; nv++)
                 for (PIO_Offset i = 0; i < iodesc->maxiobuflen; i++)
                     memcpy(&((char *)file->iobuf[ioid - PIO_IODESC_START_ID])[iodesc->mpitype_size * (i + nv * iodesc->maxiobuflen)],
@@ -299,7 +404,7 @@ int PIOc_write_darray_multi(int ncid, const int *varids, int ioid, int nvars,
 	/* this assures that iobuf is allocated on all iotasks thus
 	 assuring that the flush_output_buffer call above is called
 	 collectively (from all iotasks) */
-        if (!(file->iobuf[ioid - PIO_IODESC_START_ID] = bget(1)))
+        if (!(file->iobuf[ioid - PIO_IODESC_START_ID] = pio_mem_get(file, PIO_MEM_IOBUF, 1)))
         {
             return pio_err(ios, file, PIO_ENOMEM, __FILE__, __LINE__,
                             "Writing multiple variables to file (%s, ncid=%d) failed. Out of memory (Trying to allocate 1 byte)", pio_get_fname_from_file(file), ncid);
@@ -394,6 +499,8 @@ int PIOc_write_darray_multi(int ncid, const int *varids, int ioid, int nvars,
     {
     case PIO_IOTYPE_NETCDF4P:
     case PIO_IOTYPE_PNETCDF:
+    case PIO_IOTYPE_MEMORY:
+    case PIO_IOTYPE_HDF5:
         if ((ierr = write_darray_multi_par(file, nvars, fndims, varids, iodesc,
                                            DARRAY_DATA, frame)))
             return pio_err(ios, file, ierr, __FILE__, __LINE__,
@@ -406,6 +513,9 @@ int PIOc_write_darray_multi(int ncid, const int *varids, int ioid, int nvars,
             return pio_err(ios, file, ierr, __FILE__, __LINE__,
                             "Writing multiple variables to file (%s, ncid=%d) failed. Internal error writing variable data serially (iotype = %s)", pio_get_fname_from_file(file), ncid, pio_iotype_to_string(file->iotype));
 
+        break;
+    case PIO_IOTYPE_NULL:
+        /* The rearranged data is discarded. */
         break;
     default:
         return pio_err(NULL, NULL, PIO_EBADIOTYPE, __FILE__, __LINE__,
@@ -419,7 +529,7 @@ int PIOc_write_darray_multi(int ncid, const int *varids, int ioid, int nvars,
         if (file->iobuf[ioid - PIO_IODESC_START_ID])
         {
 	    LOG((3,"freeing variable buffer in pio_darray"));
-            brel(file->iobuf[ioid - PIO_IODESC_START_ID]);
+            pio_mem_rel(file, file->iobuf[ioid - PIO_IODESC_START_ID]);
             file->iobuf[ioid - PIO_IODESC_START_ID] = NULL;
         }
     }
@@ -443,13 +553,19 @@ int PIOc_write_darray_multi(int ncid, const int *varids, int ioid, int nvars,
 
         /* Get a buffer. */
 	if (ios->io_rank == 0)
-	    vdesc0->fillbuf = bget(iodesc->maxholegridsize * iodesc->mpitype_size * nvars);
+	    vdesc0->fillbuf = pio_mem_get(file, PIO_MEM_FILLBUF,
+                                          iodesc->maxholegridsize * iodesc->mpitype_size * nvars);
 	else if (iodesc->holegridsize > 0)
-	    vdesc0->fillbuf = bget(iodesc->holegridsize * iodesc->mpitype_size * nvars);
+	    vdesc0->fillbuf = pio_mem_get(file, PIO_MEM_FILLBUF,
+                                          iodesc->holegridsize * iodesc->mpitype_size * nvars);
 
         /* copying the fill value into the data buffer for the box
          * rearranger. This will be overwritten with data where
          * provided. */
+#if PIO_USE_OPENMP
+        int nthreads = pio_io_nthreads(ios);
+#pragma omp parallel for collapse(2) num_threads(nthreads) if (nthreads > 1)
+#endif
         for (int nv = 0; nv < nvars; nv++)
             for (int i = 0; i < iodesc->holegridsize; i++)
                 memcpy(&((char *)vdesc0->fillbuf)[iodesc->mpitype_size * (i + nv * iodesc->holegridsize)],
@@ -460,6 +576,8 @@ int PIOc_write_darray_multi(int ncid, const int *varids, int ioid, int nvars,
         {
         case PIO_IOTYPE_PNETCDF:
         case PIO_IOTYPE_NETCDF4P:
+        case PIO_IOTYPE_MEMORY:
+        case PIO_IOTYPE_HDF5:
             if ((ierr = write_darray_multi_par(file, nvars, fndims, varids, iodesc,
                                                DARRAY_FILL, frame)))
                 return pio_err(ios, file, ierr, __FILE__, __LINE__,
@@ -472,6 +590,8 @@ int PIOc_write_darray_multi(int ncid, const int *varids, int ioid, int nvars,
                 return pio_err(ios, file, ierr, __FILE__, __LINE__,
                             "Writing multiple variables to file (%s, ncid=%d) failed. Internal error writing variable fillvalues serially (iotype = %s)", pio_get_fname_from_file(file), ncid, pio_iotype_to_string(file->iotype));
             break;
+        case PIO_IOTYPE_NULL:
+            break;
         default:
             return pio_err(ios, file, PIO_EBADIOTYPE, __FILE__, __LINE__,
                         "Writing fillvalues for multiple variables to file (%s, ncid=%d) failed. Unsupported iotype (%s) provided", pio_get_fname_from_file(file), ncid, pio_iotype_to_string(file->iotype));
@@ -483,7 +603,7 @@ int PIOc_write_darray_multi(int ncid, const int *varids, int ioid, int nvars,
             /* Free resources. */
             if (vdesc0->fillbuf)
             {
-                brel(vdesc0->fillbuf);
+                pio_mem_rel(file, vdesc0->fillbuf);
                 vdesc0->fillbuf = NULL;
             }
         }
@@ -580,10 +700,12 @@ int find_var_fillvalue(file_desc_t *file, int varid, var_desc_t *vdesc)
 }
 
 /* Check if the write multi buffer requires a flush
+ * file : The file that the data is written to
  * wmb : A write multi buffer that might already contain data
  * arraylen : The length of the new array that needs to be cached in this wmb
  *            (The array is not cached yet)
  * iodesc : io descriptor for the data cached in the write multi buffer
+ * ioid_cache_limit : cache budget of the decomposition of the data, 0 if none
  * A disk flush implies that data needs to be rearranged and write needs to be
  * completed. Rearranging and writing data frees up cache is compute and I/O
  * processes
@@ -593,28 +715,24 @@ int find_var_fillvalue(file_desc_t *file, int varid, var_desc_t *vdesc)
  * rearranged data until the write completes)
  * Returns 2 if a disk flush is required, 1 if an I/O flush is required, 0 otherwise
  */
-static int PIO_wmb_needs_flush(wmulti_buffer *wmb, int arraylen, io_desc_t *iodesc)
+static int PIO_wmb_needs_flush(file_desc_t *file, wmulti_buffer *wmb, int arraylen,
+                               io_desc_t *iodesc, PIO_Offset ioid_cache_limit)
 {
-    bufsize curalloc, totfree, maxfree;
-    long nget, nrel;
+    iosystem_desc_t *ios;
+    PIO_Offset curalloc;
     const int NEEDS_DISK_FLUSH=2, NEEDS_IO_FLUSH=1, NO_FLUSH=0;
 
-    assert(wmb && iodesc);
-    /* Find out how much free, contiguous space is available. */
-    bstats(&curalloc, &totfree, &maxfree, &nget, &nrel);
-
-    LOG((2, "maxfree = %ld wmb->num_arrays = %d (1 + wmb->num_arrays) *"
-         " arraylen * iodesc->mpitype_size = %ld totfree = %ld\n",
-          maxfree, wmb->num_arrays,
-         (1 + wmb->num_arrays) * arraylen * iodesc->mpitype_size, totfree));
+    assert(file && wmb && iodesc);
+    ios = file->iosystem;
+    /* Find out how much memory is used by the buffers of the files of
+     * the IO system, that share the cache */
+    curalloc = ios->mem_cur[PIO_MEM_WMB] + ios->mem_cur[PIO_MEM_IOBUF] +
+        ios->mem_cur[PIO_MEM_FILLBUF] - ios->file_cache_alloc;
 
-    /* We have exceeded the set buffer write cache limit, write data to
-     * disk
-     */
-    if(curalloc >= pio_buffer_size_limit)
-    {
-        return NEEDS_DISK_FLUSH;
-    }
+    LOG((2, "curalloc = %lld wmb->num_arrays = %d (1 + wmb->num_arrays) *"
+         " arraylen * iodesc->mpitype_size = %lld\n",
+         (long long)curalloc, wmb->num_arrays,
+         (long long)((1 + wmb->num_arrays) * arraylen * iodesc->mpitype_size)));
 
     PIO_Offset array_sz_bytes = arraylen * iodesc->mpitype_size;
     /* Total cache size required to cache this array
@@ -623,13 +741,21 @@ static int PIO_wmb_needs_flush(wmulti_buffer *wmb, int arraylen, io_desc_t *iode
      * contiguous block of memory.
      */
     PIO_Offset wmb_req_cache_sz = (1 + wmb->num_arrays) * array_sz_bytes;
-    /* maxfree is the maximum amount of contiguous memory available.
-     * if maxfree <= 110% of the current size of wmb cache, it is close
-     * to being exhausted/filled, flush so that we have enough space
-     * to satisfy future requests
-     * FIXME: What is the logic for using 110% here?
-     */ 
-    if(maxfree <= 1.1 * wmb_req_cache_sz)
+
+    /* We have exceeded the set buffer write cache limit, write data to
+     * disk. This is checked first, since a disk flush also frees the
+     * data cached for the decomposition. The cache of a file with its
+     * own budget is not limited by the data cached for other files,
+     * the budget is checked by the caller (see
+     * PIO_file_cache_exceeded())
+     */
+    if(file->cache_limit <= 0 && curalloc >= pio_buffer_size_limit)
+    {
+        return NEEDS_DISK_FLUSH;
+    }
+
+    /* The data cached for the decomposition exceeds its budget */
+    if(ioid_cache_limit > 0 && wmb->num_arrays > 0 && wmb_req_cache_sz > ioid_cache_limit)
     {
         return NEEDS_IO_FLUSH;
     }
@@ -637,6 +763,54 @@ static int PIO_wmb_needs_flush(wmulti_buffer *wmb, int arraylen, io_desc_t *iode
     return NO_FLUSH;
 }
 
+/* Check if caching nbytes more for a file would exceed the cache
+ * budget of the file (see PIOc_set_file_cache_limit())
+ * Returns 1 if the budget would be exceeded, 0 otherwise
+ */
+static int PIO_file_cache_exceeded(file_desc_t *file, PIO_Offset nbytes)
+{
+    assert(file);
+    return (file->cache_limit > 0 && file->mem_cur[PIO_MEM_WMB] + nbytes > file->cache_limit) ? 1 : 0;
+}
+
+/* Find the write multi buffer of a file to flush first when the cache
+ * budget of the file is exceeded, the buffer holding the most data
+ * (PIO_CACHE_EVICT_LARGEST) or the oldest data (PIO_CACHE_EVICT_OLDEST)
+ * The global size of the data, and the age of the buffers, are used so
+ * that all compute tasks choose the same buffer
+ * Returns NULL if no buffer holds data
+ */
+static wmulti_buffer *PIO_wmb_evict_victim(file_desc_t *file)
+{
+    wmulti_buffer *victim = NULL;
+    PIO_Offset victim_sz = 0;
+
+    assert(file);
+    for (wmulti_buffer *wmb = &file->buffer; wmb; wmb = wmb->next)
+    {
+        io_desc_t *iodesc;
+        PIO_Offset wmb_sz;
+
+        if (wmb->num_arrays == 0 || !(iodesc = pio_get_iodesc_from_id(wmb->ioid)))
+            continue;
+
+        wmb_sz = (PIO_Offset)wmb->num_arrays * iodesc->mpitype_size;
+        for (int d = 0; d < iodesc->ndims; d++)
+            wmb_sz *= iodesc->dimlen[d];
+
+        if (!victim ||
+            (file->cache_evict == PIO_CACHE_EVICT_LARGEST && wmb_sz > victim_sz) ||
+            (file->cache_evict == PIO_CACHE_EVICT_LARGEST && wmb_sz == victim_sz && wmb->seq < victim->seq) ||
+            (file->cache_evict == PIO_CACHE_EVICT_OLDEST && wmb->seq < victim->seq))
+        {
+            victim = wmb;
+            victim_sz = wmb_sz;
+        }
+    }
+
+    return victim;
+}
+
 #ifdef _ADIOS2
 static int needs_to_write_decomp(file_desc_t *file, int ioid)
 {
@@ -698,7 +872,15 @@ static int PIOc_write_decomp_adios(file_desc_t *file, int ioid)
             }
         }
 
-        adiosErr = adios2_put(file->engineH, variableH, iodesc->map, adios2_mode_sync);
+        PIO_Offset *map = NULL;
+        if (expand_iodesc_map(iodesc, &map))
+        {
+            return pio_err(NULL, file, PIO_ENOMEM, __FILE__, __LINE__,
+                            "Writing (ADIOS) I/O decomposition (id = %d) failed for file (%s, ncid=%d). Out of memory allocating %lld bytes for the decomposition map", ioid, pio_get_fname_from_file(file), file->pio_ncid, (long long)(iodesc->maplen * sizeof(PIO_Offset)));
+        }
+
+        adiosErr = adios2_put(file->engineH, variableH, map, adios2_mode_sync);
+        free(map);
         if (adiosErr != adios2_error_none)
         {
             return pio_err(NULL, file, PIO_EADIOS2ERR, __FILE__, __LINE__, "Putting (ADIOS) variable (name=%s) failed (adios2_error=%s) for file (%s, ncid=%d)", name, adios2_error_to_string(adiosErr), pio_get_fname_from_file(file), file->pio_ncid);
@@ -716,7 +898,7 @@ static int PIOc_write_decomp_adios(file_desc_t *file, int ioid)
                 return pio_err(NULL, NULL, PIO_ENOMEM, __FILE__, __LINE__,
                                 "Writing (ADIOS) I/O decomposition (id = %d) failed for file (%s, ncid=%d). Out of memory allocating %lld bytes for map buffer", ioid, pio_get_fname_from_file(file), file->pio_ncid, (long long)(maplen * sizeof(int)));
             }
-            ((int*)mapbuf)[0] = iodesc->map[0];
+            ((int*)mapbuf)[0] = iodesc->map_start[0];
             ((int*)mapbuf)[1] = 0;
         }
         else
@@ -727,7 +909,7 @@ static int PIOc_write_decomp_adios(file_desc_t *file, int ioid)
                 return pio_err(NULL, NULL, PIO_ENOMEM, __FILE__, __LINE__,
                                 "Writing (ADIOS) I/O decomposition (id = %d) failed for file (%s, ncid=%d). Out of memory allocating %lld bytes for map buffer", ioid, pio_get_fname_from_file(file), file->pio_ncid, (long long)(maplen * sizeof(long)));
             }
-            ((long*)mapbuf)[0] = iodesc->map[0];
+            ((long*)mapbuf)[0] = iodesc->map_start[0];
             ((long*)mapbuf)[1] = 0;
         }
 
@@ -1171,6 +1353,134 @@ static int PIOc_write_darray_adios(file_desc_t *file, int varid, int ioid,
 
 #endif
 
+/* Convert n doubles to floats. The loop is simple enough (no aliasing,
+ * unit stride) for the compiler to vectorize it, and is split across
+ * nthreads OpenMP threads */
+static void pio_convert_double_to_float(float *restrict to, const double *restrict from,
+                                        PIO_Offset n, int nthreads)
+{
+#if PIO_USE_OPENMP
+#pragma omp parallel for num_threads(nthreads) if (nthreads > 1)
+#endif
+    for (PIO_Offset i = 0; i < n; i++)
+        to[i] = (float)from[i];
+}
+
+/* Convert n floats to doubles */
+static void pio_convert_float_to_double(double *restrict to, const float *restrict from,
+                                        PIO_Offset n, int nthreads)
+{
+#if PIO_USE_OPENMP
+#pragma omp parallel for num_threads(nthreads) if (nthreads > 1)
+#endif
+    for (PIO_Offset i = 0; i < n; i++)
+        to[i] = (double)from[i];
+}
+
+/**
+ * Convert an array of user data from the type of the user data
+ * to the type of the data in an I/O decomposition (conversion
+ * of data to the type of the variable on the compute tasks).
+ *
+ * @param to pointer to the converted data (of type iodesc->piotype).
+ * @param to_piotype the PIO type of the converted data.
+ * @param from pointer to the data to convert.
+ * @param from_piotype the PIO type of the data to convert.
+ * @param n the number of elements to convert.
+ * @param nthreads the number of threads to use (see pio_io_nthreads()).
+ * @returns 0 for success, error code otherwise.
+ */
+static int pio_convert_darray_buf(void *to, int to_piotype, const void *from,
+                                  int from_piotype, PIO_Offset n, int nthreads)
+{
+    if ((from_piotype == PIO_DOUBLE) && (to_piotype == PIO_FLOAT))
+        pio_convert_double_to_float((float *)to, (const double *)from, n, nthreads);
+    else if ((from_piotype == PIO_FLOAT) && (to_piotype == PIO_DOUBLE))
+        pio_convert_float_to_double((double *)to, (const float *)from, n, nthreads);
+    else
+        return PIO_EBADTYPE;
+
+    return PIO_NOERR;
+}
+
+/**
+ * Get the I/O decomposition to use for converting user data, with
+ * the data type of an I/O decomposition, to the type of a variable
+ * on the compute tasks.
+ *
+ * User data that is wider than the type of the variable in the file
+ * (currently double data written to/read from float variables) is
+ * converted on the compute tasks (before caching and rearranging the
+ * data on writes, and after rearranging the data on reads). This
+ * halves the memory required to cache the data and the data
+ * rearranged between the compute and I/O tasks. Since the I/O
+ * decomposition determines the type of the data cached and
+ * rearranged, a decomposition with the same map and the variable
+ * type is created (once) and associated with the user decomposition.
+ *
+ * This function is collective across the compute tasks (on the first
+ * call for an I/O decomposition) and should only be called on the
+ * compute tasks.
+ *
+ * @param file pointer to the file info.
+ * @param var_piotype the PIO type of the variable.
+ * @param iodesc pointer to the user I/O decomposition.
+ * @param conv_iodescp pointer that gets the I/O decomposition to use
+ * for converting the data, set to NULL if no conversion is needed.
+ * @returns 0 for success, error code otherwise.
+ */
+static int pio_get_conv_iodesc(file_desc_t *file, int var_piotype, io_desc_t *iodesc,
+                               io_desc_t **conv_iodescp)
+{
+    iosystem_desc_t *ios = NULL;
+    int ierr = PIO_NOERR;
+
+    assert(file && iodesc && conv_iodescp);
+    ios = file->iosystem;
+    *conv_iodescp = NULL;
+
+    if ((iodesc->piotype != PIO_DOUBLE) || (var_piotype != PIO_FLOAT))
+        return PIO_NOERR;
+
+#ifdef _ADIOS2
+    /* ADIOS converts data (PIOc_convert_buffer_adios) before writing */
+    if (file->iotype == PIO_IOTYPE_ADIOS)
+        return PIO_NOERR;
+#endif
+
+    if (iodesc->conv_ioid == -1)
+    {
+        int conv_ioid = -1;
+        int rearr = iodesc->rearranger;
+        PIO_Offset *map = NULL;
+
+        LOG((2, "Creating I/O decomposition to convert data (ioid=%d) from type %d to type %d",
+             iodesc->ioid, iodesc->piotype, var_piotype));
+        if ((ierr = expand_iodesc_map(iodesc, &map)))
+        {
+            return pio_err(ios, file, ierr, __FILE__, __LINE__,
+                            "Creating I/O decomposition for converting data (ioid=%d) from type %d to type %d failed. Out of memory allocating the decomposition map", iodesc->ioid, iodesc->piotype, var_piotype);
+        }
+        ierr = PIOc_InitDecomp(ios->iosysid, var_piotype, iodesc->ndims, iodesc->dimlen,
+                               iodesc->maplen, map, &conv_ioid, &rearr, NULL, NULL);
+        free(map);
+        if (ierr != PIO_NOERR)
+        {
+            return pio_err(ios, file, ierr, __FILE__, __LINE__,
+                            "Creating I/O decomposition for converting data (ioid=%d) from type %d to type %d failed", iodesc->ioid, iodesc->piotype, var_piotype);
+        }
+        iodesc->conv_ioid = conv_ioid;
+    }
+
+    if (!(*conv_iodescp = pio_get_iodesc_from_id(iodesc->conv_ioid)))
+    {
+        return pio_err(ios, file, PIO_EBADID, __FILE__, __LINE__,
+                        "Finding I/O decomposition (ioid=%d) for converting data (ioid=%d) from type %d to type %d failed", iodesc->conv_ioid, iodesc->ioid, iodesc->piotype, var_piotype);
+    }
+
+    return PIO_NOERR;
+}
+
 /**
  * Write a distributed array to the output file.
  *
@@ -1226,11 +1536,17 @@ int PIOc_write_darray(int ncid, int varid, int ioid, PIO_Offset arraylen, void *
     file_desc_t *file;     /* Info about file we are writing to. */
     io_desc_t *iodesc;     /* The IO description. */
     var_desc_t *vdesc;     /* Info about the var being written. */
+    io_desc_t *conv_iodesc = NULL; /* The IO description used for converting user data. */
+    int user_piotype;      /* The PIO type of the user data. */
     void *bufptr;          /* A data buffer. */
     MPI_Datatype vtype;    /* The MPI type of the variable. */
     wmulti_buffer *wmb;    /* The write multi buffer for one or more vars. */
     int recordvar;         /* Non-zero if this is a record variable. */
     int needsflush = 0;    /* True if we need to flush buffer. */
+    int needsevict = 0;    /* True if we need to flush buffers to keep within the budget of the file. */
+    int flushinfo[2];      /* needsflush and needsevict, reduced over compute tasks. */
+    PIO_Offset ioid_cache_limit; /* Cache budget of the decomposition. */
+    PIO_Offset array_sz_bytes; /* Bytes of this array cached in the wmb. */
     PIO_Offset decomp_max_regions; /* Max non-contiguous regions in the IO decomposition */
     PIO_Offset io_max_regions; /* Max non-contiguous regions cached in a single IO process */
     int mpierr = MPI_SUCCESS;  /* Return code from MPI functions. */
@@ -1308,7 +1624,7 @@ int PIOc_write_darray(int ncid, int varid, int ioid, PIO_Offset arraylen, void *
                             "Writing variable (%s, varid=%d) to file (%s, ncid=%d) failed. Saving I/O decomposition (ioid=%d) failed. Unable to create a unique file name for saving the I/O decomposition", pio_get_vname_from_file(file, varid), varid, pio_get_fname_from_file(file), file->pio_ncid, ioid);
         }
         LOG((2, "Saving decomp map (write) to %s", filename));
-        PIOc_writemap(filename, ioid, iodesc->ndims, iodesc->dimlen, iodesc->maplen, iodesc->map, ios->my_comm);
+        PIOc_write_decomp(filename, ios->iosysid, ioid, ios->my_comm);
         iodesc->is_saved = true;
     }
 #endif
@@ -1330,6 +1646,25 @@ int PIOc_write_darray(int ncid, int varid, int ioid, PIO_Offset arraylen, void *
     recordvar = vdesc->record >= 0 ? 1 : 0;
     LOG((3, "recordvar = %d looking for multibuffer", recordvar));
 
+    /* If the user data is wider than the variable type, convert the
+     * data to the variable type on the compute tasks, the converted
+     * data is cached/rearranged using a decomposition with the
+     * variable type. */
+    user_piotype = iodesc->piotype;
+    ioid_cache_limit = iodesc->cache_limit;
+    if ((ierr = pio_get_conv_iodesc(file, vdesc->pio_type, iodesc, &conv_iodesc)))
+    {
+        return pio_err(ios, file, ierr, __FILE__, __LINE__,
+                        "Writing variable (%s, varid=%d) to file (%s, ncid=%d) failed. Unable to get the I/O decomposition for converting user data (ioid=%d) to the variable type", pio_get_vname_from_file(file, varid), varid, pio_get_fname_from_file(file), file->pio_ncid, ioid);
+    }
+    if (conv_iodesc)
+    {
+        LOG((2, "Converting user data from type %d to variable type %d (ioid = %d, conv ioid = %d)",
+             user_piotype, conv_iodesc->piotype, ioid, conv_iodesc->ioid));
+        iodesc = conv_iodesc;
+        ioid = conv_iodesc->ioid;
+    }
+
     /* Move to end of list or the entry that matches this ioid. */
     for (wmb = &file->buffer; wmb->next; wmb = wmb->next)
         if (wmb->ioid == ioid && wmb->recordvar == recordvar)
@@ -1375,9 +1710,13 @@ int PIOc_write_darray(int ncid, int varid, int ioid, PIO_Offset arraylen, void *
     LOG((2, "wmb->num_arrays = %d arraylen = %d iodesc->mpitype_size = %d\n",
          wmb->num_arrays, arraylen, iodesc->mpitype_size));
 
-    needsflush = PIO_wmb_needs_flush(wmb, arraylen, iodesc);
+    needsflush = PIO_wmb_needs_flush(file, wmb, arraylen, iodesc, ioid_cache_limit);
     assert(needsflush >= 0);
 
+    /* Does caching this array exceed the cache budget of the file? */
+    array_sz_bytes = arraylen * iodesc->mpitype_size + (iodesc->needsfill ? iodesc->mpitype_size : 0);
+    needsevict = PIO_file_cache_exceeded(file, array_sz_bytes);
+
     /* When using PIO with PnetCDF + SUBSET rearranger the number
        of non-contiguous regions cached in a single IO process can
        grow to a large number. PnetCDF is not efficient at handling
@@ -1396,10 +1735,14 @@ int PIOc_write_darray(int ncid, int varid, int ioid, PIO_Offset arraylen, void *
 
     /* Tell all tasks on the computation communicator whether we need
      * to flush data. */
-    if ((mpierr = MPI_Allreduce(MPI_IN_PLACE, &needsflush, 1,  MPI_INT,  MPI_MAX,
+    flushinfo[0] = needsflush;
+    flushinfo[1] = needsevict;
+    if ((mpierr = MPI_Allreduce(MPI_IN_PLACE, flushinfo, 2,  MPI_INT,  MPI_MAX,
                                 ios->comp_comm)))
         return check_mpi(NULL, file, mpierr, __FILE__, __LINE__);
-    LOG((2, "needsflush = %d", needsflush));
+    needsflush = flushinfo[0];
+    needsevict = flushinfo[1];
+    LOG((2, "needsflush = %d needsevict = %d", needsflush, needsevict));
 
     if(!ios->async || !ios->ioproc)
     {
@@ -1415,12 +1758,10 @@ int PIOc_write_darray(int ncid, int varid, int ioid, PIO_Offset arraylen, void *
     /* Flush data if needed. */
     if (needsflush > 0)
     {
-#if !PIO_USE_MALLOC
 #ifdef PIO_ENABLE_LOGGING
         /* Collect a debug report about buffer. */
         cn_buffer_report(ios, true);
 #endif /* PIO_ENABLE_LOGGING */
-#endif /* !PIO_USE_MALLOC */
 
         /* Flush buffer to I/O processes - rearrange data and
          * start writing data from the I/O processes
@@ -1435,6 +1776,30 @@ int PIOc_write_darray(int ncid, int varid, int ioid, PIO_Offset arraylen, void *
         }
     }
 
+    /* Flush the buffers of the file, the largest or the oldest first,
+     * until this array fits in the cache budget of the file. All
+     * compute tasks choose the same buffers. */
+    while (needsevict)
+    {
+        wmulti_buffer *victim;
+
+        if (!(victim = PIO_wmb_evict_victim(file)))
+            break;
+        LOG((2, "evicting multi-buffer ioid = %d num_arrays = %d seq = %lld",
+             victim->ioid, victim->num_arrays, (long long)victim->seq));
+
+        if ((ierr = flush_buffer(ncid, victim, false)))
+        {
+            return pio_err(ios, file, ierr, __FILE__, __LINE__,
+                            "Writing variable (%s, varid=%d) to file (%s, ncid=%d) failed. Flushing data cached for I/O decomposition (ioid=%d) from compute processes to I/O processes, to keep within the cache budget of the file (%lld bytes), failed", pio_get_vname_from_file(file, varid), varid, pio_get_fname_from_file(file), file->pio_ncid, victim->ioid, (long long)file->cache_limit);
+        }
+
+        needsevict = PIO_file_cache_exceeded(file, array_sz_bytes);
+        if ((mpierr = MPI_Allreduce(MPI_IN_PLACE, &needsevict, 1,  MPI_INT,  MPI_MAX,
+                                    ios->comp_comm)))
+            return check_mpi(NULL, file, mpierr, __FILE__, __LINE__);
+    }
+
     /* One record size (sum across all procs) of data is buffered */
     file->varlist[varid].wb_pend += file->varlist[varid].vrsize;
     file->wb_pend += file->varlist[varid].vrsize;
@@ -1450,10 +1815,15 @@ int PIOc_write_darray(int ncid, int varid, int ioid, PIO_Offset arraylen, void *
     mtimer_async_event_in_progress(file->varlist[varid].wr_mtimer, true);
 #endif
 
+    /* Remember when the first array of the wmb was cached. */
+    if (wmb->num_arrays == 0)
+        wmb->seq = file->wmb_seq++;
+
     /* Get memory for data. */
     if (arraylen > 0)
     {
-        if (!(wmb->data = bgetr(wmb->data, (1 + wmb->num_arrays) * arraylen * iodesc->mpitype_size)))
+        if (!(wmb->data = pio_mem_getr(file, PIO_MEM_WMB, wmb->data,
+                                      (1 + wmb->num_arrays) * arraylen * iodesc->mpitype_size)))
         {
             return pio_err(ios, file, PIO_ENOMEM, __FILE__, __LINE__,
                             "Writing variable (%s, varid=%d) to file (%s, ncid=%d) failed. Out of memory allocating space (realloc %lld bytes) to cache user data", pio_get_vname_from_file(file, varid), varid, pio_get_fname_from_file(file), file->pio_ncid, (long long int )((1 + wmb->num_arrays) * arraylen * iodesc->mpitype_size));
@@ -1485,7 +1855,8 @@ int PIOc_write_darray(int ncid, int varid, int ioid, PIO_Offset arraylen, void *
     if (iodesc->needsfill)
     {
         /* Get memory to hold fill value. */
-        if (!(wmb->fillvalue = bgetr(wmb->fillvalue, iodesc->mpitype_size * (1 + wmb->num_arrays))))
+        if (!(wmb->fillvalue = pio_mem_getr(file, PIO_MEM_WMB, wmb->fillvalue,
+                                           iodesc->mpitype_size * (1 + wmb->num_arrays))))
         {
             return pio_err(ios, file, PIO_ENOMEM, __FILE__, __LINE__,
                             "Writing variable (%s, varid=%d) to file (%s, ncid=%d) failed. Out of memory allocating space (realloc %lld bytes) for variable fillvalues in write multi buffer to cache user data", pio_get_vname_from_file(file, varid), varid, pio_get_fname_from_file(file), file->pio_ncid, (unsigned long long)(iodesc->mpitype_size * (1 + wmb->num_arrays)));
@@ -1496,8 +1867,20 @@ int PIOc_write_darray(int ncid, int varid, int ioid, PIO_Offset arraylen, void *
          * value to the buffer. */
         if (fillvalue)
         {
-            memcpy((char *)wmb->fillvalue + iodesc->mpitype_size * wmb->num_arrays,
-                   fillvalue, iodesc->mpitype_size);
+            if (conv_iodesc)
+            {
+                if ((ierr = pio_convert_darray_buf((char *)wmb->fillvalue + iodesc->mpitype_size * wmb->num_arrays,
+                                                   iodesc->piotype, fillvalue, user_piotype, 1, 1)))
+                {
+                    return pio_err(ios, file, ierr, __FILE__, __LINE__,
+                                    "Writing variable (%s, varid=%d) to file (%s, ncid=%d) failed. Converting the user-provided fill value to the variable type failed", pio_get_vname_from_file(file, varid), varid, pio_get_fname_from_file(file), file->pio_ncid);
+                }
+            }
+            else
+            {
+                memcpy((char *)wmb->fillvalue + iodesc->mpitype_size * wmb->num_arrays,
+                       fillvalue, iodesc->mpitype_size);
+            }
             LOG((3, "copied user-provided fill value iodesc->mpitype_size = %d",
                  iodesc->mpitype_size));
         }
@@ -1566,7 +1949,18 @@ int PIOc_write_darray(int ncid, int varid, int ioid, PIO_Offset arraylen, void *
     bufptr = (void *)((char *)wmb->data + arraylen * iodesc->mpitype_size * wmb->num_arrays);
     if (arraylen > 0)
     {
-        memcpy(bufptr, array, arraylen * iodesc->mpitype_size);
+        if (conv_iodesc)
+        {
+            /* Convert the user data to the variable type */
+            if ((ierr = pio_convert_darray_buf(bufptr, iodesc->piotype, array, user_piotype, arraylen,
+                                               pio_io_nthreads(ios))))
+            {
+                return pio_err(ios, file, ierr, __FILE__, __LINE__,
+                                "Writing variable (%s, varid=%d) to file (%s, ncid=%d) failed. Converting user data to the variable type failed", pio_get_vname_from_file(file, varid), varid, pio_get_fname_from_file(file), file->pio_ncid);
+            }
+        }
+        else
+            memcpy(bufptr, array, arraylen * iodesc->mpitype_size);
         LOG((3, "copied %ld bytes of user data", arraylen * iodesc->mpitype_size));
     }
 
@@ -1617,7 +2011,10 @@ int PIOc_read_darray(int ncid, int varid, int ioid, PIO_Offset arraylen,
     iosystem_desc_t *ios;  /* Pointer to io system information. */
     file_desc_t *file;     /* Pointer to file information. */
     io_desc_t *iodesc;     /* Pointer to IO description information. */
+    io_desc_t *conv_iodesc = NULL; /* The IO description used for converting data. */
+    int user_piotype = 0;  /* The PIO type of the user data. */
     void *iobuf = NULL;    /* holds the data as read on the io node. */
+    void *rbuf = array;    /* holds the data after rearrangement. */
     size_t rlen = 0;       /* the length of data in iobuf. */
     int ierr = PIO_NOERR, mpierr = MPI_SUCCESS;           /* Return code. */
     int fndims = 0;
@@ -1656,6 +2053,18 @@ int PIOc_read_darray(int ncid, int varid, int ioid, PIO_Offset arraylen,
     }
 #endif
 
+    if (file->iotype == PIO_IOTYPE_NULL)
+    {
+        return pio_err(ios, file, PIO_EBADIOTYPE, __FILE__, __LINE__,
+                        "Reading variable (%s, varid=%d) from file (%s, ncid=%d) failed. The data written to files with iotype %s is discarded, reading variables is not supported", pio_get_vname_from_file(file, varid), varid, pio_get_fname_from_file(file), file->pio_ncid, pio_iotype_to_string(file->iotype));
+    }
+
+    if (file->iotype == PIO_IOTYPE_HDF5)
+    {
+        return pio_err(ios, file, PIO_EBADIOTYPE, __FILE__, __LINE__,
+                        "Reading variable (%s, varid=%d) from file (%s, ncid=%d) failed. Files written with iotype %s are write only, reading variables is not supported", pio_get_vname_from_file(file, varid), varid, pio_get_fname_from_file(file), file->pio_ncid, pio_iotype_to_string(file->iotype));
+    }
+
     /* Run these on all tasks if async is not in use, but only on
      * non-IO tasks if async is in use. */
     if (!ios->async || !ios->ioproc)
@@ -1668,6 +2077,40 @@ int PIOc_read_darray(int ncid, int varid, int ioid, PIO_Offset arraylen,
                             "Reading variable (%s, varid=%d) from file (%s, ncid=%d) failed . Inquiring number of variable dimensions failed", pio_get_vname_from_file(file, varid), varid, pio_get_fname_from_file(file), file->pio_ncid);
         }
         LOG((3, "called PIOc_inq_varndims varid = %d fndims = %d", varid, fndims));
+
+        /* If the user data is wider than the variable type, the data
+         * is rearranged with the variable type and converted to the
+         * user data type on the compute tasks. */
+        if (!file->varlist[varid].pio_type)
+        {
+            ierr = PIOc_inq_vartype(file->pio_ncid, varid, &(file->varlist[varid].pio_type));
+            if(ierr != PIO_NOERR){
+                return pio_err(ios, file, ierr, __FILE__, __LINE__,
+                                "Reading variable (%s, varid=%d) from file (%s, ncid=%d) failed . Inquiring variable type failed", pio_get_vname_from_file(file, varid), varid, pio_get_fname_from_file(file), file->pio_ncid);
+            }
+        }
+        user_piotype = iodesc->piotype;
+        ierr = pio_get_conv_iodesc(file, file->varlist[varid].pio_type, iodesc, &conv_iodesc);
+        if(ierr != PIO_NOERR){
+            return pio_err(ios, file, ierr, __FILE__, __LINE__,
+                            "Reading variable (%s, varid=%d) from file (%s, ncid=%d) failed . Unable to get the I/O decomposition for converting data (ioid=%d) to the user data type", pio_get_vname_from_file(file, varid), varid, pio_get_fname_from_file(file), file->pio_ncid, ioid);
+        }
+        if (conv_iodesc)
+        {
+            LOG((2, "Converting variable data from type %d to user data type %d (ioid = %d, conv ioid = %d)",
+                 conv_iodesc->piotype, user_piotype, ioid, conv_iodesc->ioid));
+            iodesc = conv_iodesc;
+            ioid = conv_iodesc->ioid;
+            if (iodesc->ndof > 0)
+            {
+                if (!(rbuf = pio_mem_get(file, PIO_MEM_IOBUF, iodesc->mpitype_size * iodesc->ndof)))
+                {
+                    ierr = pio_err(ios, file, PIO_ENOMEM, __FILE__, __LINE__,
+                                    "Reading variable (%s, varid=%d) from file (%s, ncid=%d) failed . Out of memory allocating space (%lld bytes) in compute processes to rearrange data before converting it to the user data type", pio_get_vname_from_file(file, varid), varid, pio_get_fname_from_file(file), file->pio_ncid, (long long int) (iodesc->mpitype_size * iodesc->ndof));
+                    goto exit;
+                }
+            }
+        }
     }
     /* ??? */
     if (ios->iomaster == MPI_ROOT)
@@ -1692,10 +2135,11 @@ int PIOc_read_darray(int ncid, int varid, int ioid, PIO_Offset arraylen,
 
     /* Allocate a buffer for one record. */
     if (ios->ioproc && rlen > 0)
-        if (!(iobuf = bget(iodesc->mpitype_size * rlen)))
+        if (!(iobuf = pio_mem_get(file, PIO_MEM_IOBUF, iodesc->mpitype_size * rlen)))
         {
-            return pio_err(ios, file, PIO_ENOMEM, __FILE__, __LINE__,
+            ierr = pio_err(ios, file, PIO_ENOMEM, __FILE__, __LINE__,
                             "Reading variable (%s, varid=%d) from file (%s, ncid=%d) failed . Out of memory allocating space (%lld bytes) in I/O processes to read data from file (before rearrangement)", pio_get_vname_from_file(file, varid), varid, pio_get_fname_from_file(file), file->pio_ncid, (long long int) (iodesc->mpitype_size * rlen));
+            goto exit;
         }
 
     if(ios->async)
@@ -1706,8 +2150,9 @@ int PIOc_read_darray(int ncid, int varid, int ioid, PIO_Offset arraylen,
         PIO_SEND_ASYNC_MSG(ios, msg, &ierr, ncid, varid, ioid);
         if(ierr != PIO_NOERR)
         {
-            return pio_err(ios, file, ierr, __FILE__, __LINE__,
+            ierr = pio_err(ios, file, ierr, __FILE__, __LINE__,
                             "Reading variable (%s, varid=%d) from file (%s, ncid=%d) failed . Sending async message, PIO_MSG_READDARRAY, failed", pio_get_vname_from_file(file, varid), varid, pio_get_fname_from_file(file), file->pio_ncid);
+            goto exit;
         }
 
         /* Share results known only on computation tasks with IO tasks. */
@@ -1727,14 +2172,27 @@ int PIOc_read_darray(int ncid, int varid, int ioid, PIO_Offset arraylen,
         ierr = pio_create_uniq_str(ios, iodesc, filename, PIO_MAX_NAME, "piodecomp", ".dat");
         if(ierr != PIO_NOERR)
         {
-            return pio_err(ios, NULL, ierr, __FILE__, __LINE__,
+            ierr = pio_err(ios, NULL, ierr, __FILE__, __LINE__,
                             "Reading variable (%s, varid=%d) from file (%s, ncid=%d) failed . Saving the I/O decomposition (ioid=%d) failed, unable to create a unique file name for saving the decomposition", pio_get_vname_from_file(file, varid), varid, pio_get_fname_from_file(file), file->pio_ncid, ioid);
+            goto exit;
         }
         LOG((2, "Saving decomp map (read) to %s", filename));
-        PIOc_writemap(filename, ioid, iodesc->ndims, iodesc->dimlen, iodesc->maplen, iodesc->map, ios->my_comm);
+        PIOc_write_decomp(filename, ios->iosysid, ioid, ios->my_comm);
         iodesc->is_saved = true;
     }
 #endif
+    /* The data staged for the file is written to the file before
+     * reading from it. */
+    if (ios->ioproc && file->stage)
+    {
+        if ((ierr = pio_stage_drain_file(file)))
+        {
+            ierr = pio_err(ios, file, ierr, __FILE__, __LINE__,
+                            "Reading variable (%s, varid=%d) from file (%s, ncid=%d) failed . Draining the data staged for the file failed", pio_get_vname_from_file(file, varid), varid, pio_get_fname_from_file(file), file->pio_ncid);
+            goto exit;
+        }
+    }
+
     /* Call the correct darray read function based on iotype. */
     if(!ios->async || ios->ioproc)
     {
@@ -1744,21 +2202,25 @@ int PIOc_read_darray(int ncid, int varid, int ioid, PIO_Offset arraylen,
         case PIO_IOTYPE_NETCDF4C:
             if ((ierr = pio_read_darray_nc_serial(file, fndims, iodesc, varid, iobuf)))
             {
-                return pio_err(ios, file, ierr, __FILE__, __LINE__,
+                ierr = pio_err(ios, file, ierr, __FILE__, __LINE__,
                                 "Reading variable (%s, varid=%d) from file (%s, ncid=%d) failed . Reading variable in serial (iotype=%s) failed", pio_get_vname_from_file(file, varid), varid, pio_get_fname_from_file(file), file->pio_ncid, pio_iotype_to_string(file->iotype));
+                goto exit;
             }
             break;
         case PIO_IOTYPE_PNETCDF:
         case PIO_IOTYPE_NETCDF4P:
+        case PIO_IOTYPE_MEMORY:
             if ((ierr = pio_read_darray_nc(file, fndims, iodesc, varid, iobuf)))
             {
-                return pio_err(ios, file, ierr, __FILE__, __LINE__,
+                ierr = pio_err(ios, file, ierr, __FILE__, __LINE__,
                                 "Reading variable (%s, varid=%d) from file (%s, ncid=%d) failed . Reading variable in parallel (iotype=%s) failed", pio_get_vname_from_file(file, varid), varid, pio_get_fname_from_file(file), file->pio_ncid, pio_iotype_to_string(file->iotype));
+                goto exit;
             }
             break;
         default:
-            return pio_err(NULL, NULL, PIO_EBADIOTYPE, __FILE__, __LINE__,
+            ierr = pio_err(NULL, NULL, PIO_EBADIOTYPE, __FILE__, __LINE__,
                              "Reading variable (%s, varid=%d) from file (%s, ncid=%d) failed . Invalid iotype (%d) provided", pio_get_vname_from_file(file, varid), varid, pio_get_fname_from_file(file), file->pio_ncid, file->iotype);
+            goto exit;
         }
     }
 
@@ -1766,10 +2228,26 @@ int PIOc_read_darray(int ncid, int varid, int ioid, PIO_Offset arraylen,
     mtimer_start(file->varlist[varid].rd_rearr_mtimer);
 #endif
     /* Rearrange the data. */
-    if ((ierr = rearrange_io2comp(ios, iodesc, iobuf, array)))
+    if ((ierr = rearrange_io2comp(ios, iodesc, iobuf, rbuf)))
     {
-        return pio_err(ios, file, ierr, __FILE__, __LINE__,
+        ierr = pio_err(ios, file, ierr, __FILE__, __LINE__,
                          "Reading variable (%s, varid=%d) from file (%s, ncid=%d) failed . Rearranging data read in the I/O processes to compute processes failed", pio_get_vname_from_file(file, varid), varid, pio_get_fname_from_file(file), file->pio_ncid);
+        goto exit;
+    }
+
+    /* Convert the data to the user data type */
+    if (conv_iodesc)
+    {
+        if (iodesc->ndof > 0)
+        {
+            if ((ierr = pio_convert_darray_buf(array, user_piotype, rbuf, iodesc->piotype, iodesc->ndof,
+                                               pio_io_nthreads(ios))))
+            {
+                ierr = pio_err(ios, file, ierr, __FILE__, __LINE__,
+                                "Reading variable (%s, varid=%d) from file (%s, ncid=%d) failed . Converting data to the user data type failed", pio_get_vname_from_file(file, varid), varid, pio_get_fname_from_file(file), file->pio_ncid);
+                goto exit;
+            }
+        }
     }
 
 #ifdef PIO_MICRO_TIMING
@@ -1779,15 +2257,18 @@ int PIOc_read_darray(int ncid, int varid, int ioid, PIO_Offset arraylen,
     file->varlist[varid].rb_pend = 0;
     file->rb_pend = 0;
 
-    /* Free the buffer. */
-    if (rlen > 0)
-        brel(iobuf);
-
 #ifdef PIO_MICRO_TIMING
     mtimer_stop(file->varlist[varid].rd_mtimer, get_var_desc_str(ncid, varid, NULL));
 #endif
 #ifdef TIMING
     GPTLstop("PIO:PIOc_read_darray");
 #endif
-    return PIO_NOERR;
+
+exit:
+    /* Free the buffers, on success and on errors. */
+    if (rbuf != array)
+        pio_mem_rel(file, rbuf);
+    pio_mem_rel(file, iobuf);
+
+    return ierr;
 }
@@ -26,25 +26,11 @@ bufsize pio_cnbuffer_limit = 0;
 /* Maximum buffer usage. */
 extern PIO_Offset maxusage;
 
-/* handler for freeing the memory buffer pool */
-void bpool_free(void *p)
-{
-  free(p);
-}
-
-/* Handler for allocating more memory for the bget buffer pool */
-void *bpool_alloc(bufsize sz)
-{
-  void *p = malloc((size_t ) sz);
-  return p;
-}
-
 /**
  * Initialize the compute buffer to size pio_cnbuffer_limit.
  *
- * This routine initializes the compute buffer pool if the bget memory
- * management is used. If malloc is used (that is, PIO_USE_MALLOC is
- * non zero), this function does nothing.
+ * This routine creates the arena of the buffers of the IO system
+ * (see pio_arena.c), if it does not exist yet.
  *
  * @param ios pointer to the iosystem descriptor which will use the
  * new buffer.
@@ -58,25 +44,25 @@ int compute_buffer_init(iosystem_desc_t *ios)
     bufsize bpool_block_inc_sz = (bufsize )((pio_buffer_size_limit > 0) ? pio_buffer_size_limit : DEFAULT_BUF_INC_SZ);
     LOG((2, "Initializing buffer pool with block increment = %lld bytes", (long long int) bpool_block_inc_sz));
     pio_cnbuffer_limit = bpool_block_inc_sz;
-#if PIO_USE_MALLOC
-    bpool(NULL, pio_cnbuffer_limit);
-#else
-    bectl(NULL, bpool_alloc, bpool_free, pio_cnbuffer_limit);
-#endif /* PIO_USE_MALLOC */
+    if (!ios->arena && pio_arena_create(&ios->arena))
+        return PIO_ENOMEM;
     LOG((2, "compute_buffer_init complete"));
 
     return PIO_NOERR;
 }
 
 /** 
- * Fill start/count arrays for write_darray_multi_par(). This is an
+ * Fill start/count arrays for region r of a region table. This is an
  * internal function.
  * 
  * @param ndims the number of dims in the decomposition.
  * @param dimlen the lengths of dims in the decomposition.
  * @param fndims the number of dims in the file.
  * @param vdesc pointer to the var_desc_t info.
- * @param region pointer to a region.
+ * @param regions pointer to the region table. May be NULL, in which
+ * case start/count are zero.
+ * @param r the index of the region. If r is not less than the number
+ * of regions in the table, start/count are zero.
  * @param start an already-allocated array which gets the start
  * values.
  * @param count an already-allocated array which gets the count
@@ -86,7 +72,7 @@ int compute_buffer_init(iosystem_desc_t *ios)
  * @author Ed Hartnett
  */
 int find_start_count(int ndims, const int *dimlen, int fndims, var_desc_t *vdesc,
-                     io_region *region, size_t *start, size_t *count)
+                     io_region_table *regions, int r, size_t *start, size_t *count)
 {
     /* Init start/count arrays to zero. */
     for (int i = 0; i < fndims; i++)
@@ -95,8 +81,11 @@ int find_start_count(int ndims, const int *dimlen, int fndims, var_desc_t *vdesc
         count[i] = 0;
     }
 
-    if (region)
+    if (regions && r < regions->nregions)
     {
+        const PIO_Offset *rstart = REGION_START(regions, r);
+        const PIO_Offset *rcount = REGION_COUNT(regions, r);
+
         /* Allow extra outermost dimensions in the decomposition */
         int num_extra_dims = (vdesc->record >= 0 && fndims > 1)? (ndims - (fndims - 1)) : (ndims - fndims);
         pioassert(num_extra_dims >= 0, "Unexpected num_extra_dims", __FILE__, __LINE__);
@@ -114,8 +103,8 @@ int find_start_count(int ndims, const int *dimlen, int fndims, var_desc_t *vdesc
              * record dimension (dimid 0). */
             for (int i = 1; i < fndims; i++)
             {
-                start[i] = region->start[num_extra_dims + (i - 1)];
-                count[i] = region->count[num_extra_dims + (i - 1)];
+                start[i] = rstart[num_extra_dims + (i - 1)];
+                count[i] = rcount[num_extra_dims + (i - 1)];
             }
 
             /* Set count for record dimension (start cannot be determined so far). */
@@ -127,8 +116,8 @@ int find_start_count(int ndims, const int *dimlen, int fndims, var_desc_t *vdesc
             /* This is a non record variable. */
             for (int i = 0; i < fndims; i++)
             {
-                start[i] = region->start[num_extra_dims + i];
-                count[i] = region->count[num_extra_dims + i];
+                start[i] = rstart[num_extra_dims + i];
+                count[i] = rcount[num_extra_dims + i];
             }
         }
 
@@ -142,10 +131,88 @@ int find_start_count(int ndims, const int *dimlen, int fndims, var_desc_t *vdesc
     return PIO_NOERR;
 }
 
+/**
+ * Point the varn start/count lists of a region table (startp and
+ * countp members) at the non-empty regions of the table, for the
+ * ncmpi_iput_varn()/ncmpi_get_varn_all() calls. No memory is
+ * allocated: the lists point directly into the rows of the table.
+ *
+ * The lists are laid out for a variable with fndims dimensions in
+ * the file. For record variables the first element of each start
+ * list is the start of the record dimension, which must be set with
+ * set_region_frame() before the lists are used, and reset to 0
+ * afterwards.
+ *
+ * @param regions pointer to the region table. May be NULL, in which
+ * case there are no requests.
+ * @param fndims the number of dims in the file.
+ * @param record true if this is a record variable with more than one
+ * dimension in the file.
+ * @param nreqp pointer that gets the number of start/count lists.
+ * @return 0 for success, error code otherwise.
+ * @ingroup PIO_write_darray
+ */
+int get_region_varn_lists(io_region_table *regions, int fndims, bool record, int *nreqp)
+{
+    int nreq = 0;
+
+    pioassert(fndims > 0 && nreqp, "invalid input", __FILE__, __LINE__);
+
+    if (regions)
+    {
+        /* Allow extra outermost dimensions in the decomposition. The
+         * column before the first file dimension of a record variable
+         * holds the record start/count. */
+        int num_extra_dims = record ? regions->ndims - (fndims - 1) : regions->ndims - fndims;
+        int col = record ? num_extra_dims - 1 : num_extra_dims;
+        pioassert(num_extra_dims >= 0, "Unexpected num_extra_dims", __FILE__, __LINE__);
+
+        for (int r = 0; r < regions->nregions; r++)
+        {
+            PIO_Offset *start = REGION_START(regions, r) + col;
+            PIO_Offset *count = REGION_COUNT(regions, r) + col;
+            PIO_Offset dsize = 1;
+
+            /* Skip the regions with no data. */
+            for (int i = record ? 1 : 0; i < fndims; i++)
+                dsize *= count[i];
+            if (dsize <= 0)
+                continue;
+
+            /* Read/write one record. */
+            if (record)
+                count[0] = 1;
+
+            regions->startp[nreq] = start;
+            regions->countp[nreq] = count;
+            nreq++;
+        }
+    }
+
+    *nreqp = nreq;
+
+    return PIO_NOERR;
+}
+
+/**
+ * Set the start of the record dimension in the varn start lists of a
+ * region table, set up by get_region_varn_lists().
+ *
+ * @param regions pointer to the region table.
+ * @param nreq the number of start lists.
+ * @param frame the record to read/write, or 0 to restore the table.
+ * @ingroup PIO_write_darray
+ */
+void set_region_frame(io_region_table *regions, int nreq, PIO_Offset frame)
+{
+    for (int i = 0; i < nreq; i++)
+        regions->startp[i][0] = frame;
+}
+
 /**
  * Write a set of one or more aggregated arrays to output file. This
- * function is only used with parallel-netcdf and netcdf-4 parallel
- * iotypes. Serial io types use write_darray_multi_serial().
+ * function is only used with parallel-netcdf, netcdf-4 parallel and
+ * in-memory iotypes. Serial io types use write_darray_multi_serial().
  *
  * @param file a pointer to the open file descriptor for the file
  * that will be written to
@@ -165,7 +232,6 @@ int write_darray_multi_par(file_desc_t *file, int nvars, int fndims, const int *
 {
     iosystem_desc_t *ios;  /* Pointer to io system information. */
     var_desc_t *vdesc;     /* Pointer to var info struct. */
-    int dsize;             /* Data size (for one region). */
     int ierr = PIO_NOERR;
 
     /* Check inputs. */
@@ -189,19 +255,47 @@ int write_darray_multi_par(file_desc_t *file, int nvars, int fndims, const int *
 
     /* Set these differently for data and fill writing. */
     int num_regions = fill ? iodesc->maxfillregions: iodesc->maxregions;
-    io_region *region = fill ? iodesc->fillregion : iodesc->firstregion;
+    io_region_table *regions = fill ? iodesc->fillregions : iodesc->regions;
     PIO_Offset llen = fill ? iodesc->holegridsize : iodesc->llen;
     void *iobuf = fill ? vdesc->fillbuf : file->iobuf[iodesc->ioid - PIO_IODESC_START_ID];
 
+    /* Record the boxes written to the subfiles of subfiled files, for
+     * their index. The writes below are collective, so the IO tasks
+     * skip them together if this fails on any of them. */
+    if (ios->ioproc && file->subfile)
+    {
+        int mpierr;
+
+        ierr = pio_subfile_add_regions(file, iodesc, nvars, varids, fill);
+        if ((mpierr = MPI_Allreduce(MPI_IN_PLACE, &ierr, 1, MPI_INT, MPI_MIN, ios->io_comm)))
+            ierr = check_mpi(NULL, file, mpierr, __FILE__, __LINE__);
+    }
+
+    if (ierr != PIO_NOERR)
+    {
+        LOG((1, "Recording the regions written to the subfile failed, ierr = %d", ierr));
+    }
+    /* If the file is staged, write the data to the staging log. */
+    else if (ios->ioproc && file->stage)
+    {
+        ierr = pio_stage_write(file, nvars, fndims, varids, iodesc, fill, frame);
+    }
+#ifdef _HDF5
+    /* Write the regions of each variable with collective H5Dwrite() calls. */
+    else if (ios->ioproc && file->iotype == PIO_IOTYPE_HDF5)
+    {
+        ierr = pio_hdf5_write_darray(file, nvars, fndims, varids, iodesc, fill, frame);
+    }
+#endif
     /* If this is an IO task write the data. */
-    if (ios->ioproc)
+    else if (ios->ioproc)
     {
         int rrcnt = 0; /* Number of subarray requests (pnetcdf only). */
+        bool record = vdesc->record >= 0 && fndims > 1;
+        PIO_Offset *nolist[1] = {NULL}; /* Start/count list when there is no data. */
         void *bufptr = NULL;
         size_t start[fndims];
         size_t count[fndims];
-        PIO_Offset *startlist[num_regions]; /* Array of start arrays for ncmpi_iput_varn(). */
-        PIO_Offset *countlist[num_regions]; /* Array of count  arrays for ncmpi_iput_varn(). */
 
         LOG((3, "num_regions = %d", num_regions));
 
@@ -209,7 +303,8 @@ int write_darray_multi_par(file_desc_t *file, int nvars, int fndims, const int *
         for (int regioncnt = 0; regioncnt < num_regions; regioncnt++)
         {
             /* Fill the start/count arrays. */
-            if ((ierr = find_start_count(iodesc->ndims, iodesc->dimlen, fndims, vdesc, region, start, count)))
+            if ((ierr = find_start_count(iodesc->ndims, iodesc->dimlen, fndims, vdesc, regions,
+                                         regioncnt, start, count)))
             {
                 ierr = pio_err(ios, file, ierr, __FILE__, __LINE__,
                                 "Writing variables (number of variables = %d) to file (%s, ncid=%d) failed. Internal error, finding start/count for the I/O regions written out from the I/O process failed", nvars, pio_get_fname_from_file(file), file->pio_ncid);
@@ -219,8 +314,11 @@ int write_darray_multi_par(file_desc_t *file, int nvars, int fndims, const int *
             /* IO tasks will run the netCDF/pnetcdf functions to write the data. */
             switch (file->iotype)
             {
+#ifdef _NETCDF
 #ifdef _NETCDF4
             case PIO_IOTYPE_NETCDF4P:
+#endif
+            case PIO_IOTYPE_MEMORY:
                 /* For each variable to be written. */
                 for (int nv = 0; nv < nvars; nv++)
                 {
@@ -229,17 +327,23 @@ int write_darray_multi_par(file_desc_t *file, int nvars, int fndims, const int *
                         start[0] = frame[nv];
 
                     /* If there is data for this region, get a pointer to it. */
-                    if (region)
-                        bufptr = (void *)((char *)iobuf + iodesc->mpitype_size * (nv * llen + region->loffset));
+                    if (regions && regioncnt < regions->nregions)
+                        bufptr = (void *)((char *)iobuf + iodesc->mpitype_size * (nv * llen + regions->loffset[regioncnt]));
 
-                    /* Ensure collective access. */
-                    ierr = nc_var_par_access(file->fh, varids[nv], NC_COLLECTIVE);
-                    if(ierr != NC_NOERR)
+#ifdef _NETCDF4
+                    /* Ensure collective access. The I/O tasks write to
+                     * private files with PIO_IOTYPE_MEMORY. */
+                    if (file->iotype == PIO_IOTYPE_NETCDF4P)
                     {
-                        ierr = pio_err(ios, file, ierr, __FILE__, __LINE__,
-                                        "Writing variables (number of variables = %d) to file (%s, ncid=%d) using PIO_IOTYPE_NETCDF4P iotype failed. Changing parallel access for variable (%s, varid=%d) to collective failed", nvars, pio_get_fname_from_file(file), file->pio_ncid, pio_get_vname_from_file(file, varids[nv]), varids[nv]);
-                        break;
+                        ierr = nc_var_par_access(file->fh, varids[nv], NC_COLLECTIVE);
+                        if(ierr != NC_NOERR)
+                        {
+                            ierr = pio_err(ios, file, ierr, __FILE__, __LINE__,
+                                            "Writing variables (number of variables = %d) to file (%s, ncid=%d) using PIO_IOTYPE_NETCDF4P iotype failed. Changing parallel access for variable (%s, varid=%d) to collective failed", nvars, pio_get_fname_from_file(file), file->pio_ncid, pio_get_vname_from_file(file, varids[nv]), varids[nv]);
+                            break;
+                        }
                     }
+#endif
 
                     switch (iodesc->piotype)
                     {
@@ -281,13 +385,13 @@ int write_darray_multi_par(file_desc_t *file, int nvars, int fndims, const int *
                         break;
                     default:
                         ierr = pio_err(ios, file, PIO_EBADTYPE, __FILE__, __LINE__,
-                                        "Writing variables (number of variables = %d) to file (%s, ncid=%d) using PIO_IOTYPE_NETCDF4P iotype failed. Unsupported variable data type (type=%d)", nvars, pio_get_fname_from_file(file), file->pio_ncid, iodesc->piotype);
+                                        "Writing variables (number of variables = %d) to file (%s, ncid=%d) using %s iotype failed. Unsupported variable data type (type=%d)", nvars, pio_get_fname_from_file(file), file->pio_ncid, pio_iotype_to_string(file->iotype), iodesc->piotype);
                         break;
                     }
                     if(ierr != NC_NOERR)
                     {
                         ierr = pio_err(ios, file, ierr, __FILE__, __LINE__,
-                                        "Writing variables (number of variables = %d) to file (%s, ncid=%d) using PIO_IOTYPE_NETCDF4P iotype failed. Writing variable (%s, varid=%d) failed", nvars, pio_get_fname_from_file(file), file->pio_ncid, pio_get_vname_from_file(file, varids[nv]), varids[nv]);
+                                        "Writing variables (number of variables = %d) to file (%s, ncid=%d) using %s iotype failed. Writing variable (%s, varid=%d) failed", nvars, pio_get_fname_from_file(file), file->pio_ncid, pio_iotype_to_string(file->iotype), pio_get_vname_from_file(file, varids[nv]), varids[nv]);
                         break;
                     }
                 }
@@ -295,46 +399,16 @@ int write_darray_multi_par(file_desc_t *file, int nvars, int fndims, const int *
 #endif
 #ifdef _PNETCDF
             case PIO_IOTYPE_PNETCDF:
-                /* Get the total number of data elements we are
-                 * writing for this region. */
-                dsize = 1;
-                for (int i = 0; i < fndims; i++)
-                    dsize *= count[i];
-                LOG((3, "dsize = %d", dsize));
-
-                /* For pnetcdf's ncmpi_iput_varn() function, we need
-                 * to provide arrays of arrays for start/count. */
-                if (dsize > 0)
-                {
-                    /* Allocate storage for start/count arrays for
-                     * this region. */
-                    if (!(startlist[rrcnt] = calloc(fndims, sizeof(PIO_Offset))))
-                    {
-                        ierr = pio_err(ios, file, PIO_ENOMEM, __FILE__, __LINE__,
-                                          "Writing variables (number of variables = %d) to file (%s, ncid=%d) using PIO_IOTYPE_PNETCDF iotype failed. Out of memory allocating buffer (%lld bytes) for array to store starts of I/O regions written out to file", nvars, pio_get_fname_from_file(file), file->pio_ncid, (long long int) (fndims * sizeof(PIO_Offset)));
-                        break;
-                    }
-                    if (!(countlist[rrcnt] = calloc(fndims, sizeof(PIO_Offset))))
-                    {
-                        ierr = pio_err(ios, file, PIO_ENOMEM, __FILE__, __LINE__,
-                                          "Writing variables (number of variables = %d) to file (%s, ncid=%d) using PIO_IOTYPE_PNETCDF iotype failed. Out of memory allocating buffer (%lld bytes) for array to store counts of I/O regions written out to file", nvars, pio_get_fname_from_file(file), file->pio_ncid, (long long int) (fndims * sizeof(PIO_Offset)));
-                        break;
-                    }
-
-                    /* Copy the start/count arrays for this region. */
-                    for (int i = 0; i < fndims; i++)
-                    {
-                        startlist[rrcnt][i] = start[i];
-                        countlist[rrcnt][i] = count[i];
-                        LOG((3, "startlist[%d][%d] = %d countlist[%d][%d] = %d", rrcnt, i,
-                             startlist[rrcnt][i], rrcnt, i, countlist[rrcnt][i]));
-                    }
-                    rrcnt++;
-                }
-
                 /* Do this when we reach the last region. */
                 if (regioncnt == num_regions - 1)
                 {
+                    /* For pnetcdf's ncmpi_iput_varn() function, we
+                     * need to provide arrays of arrays for
+                     * start/count. They point into the region
+                     * table. */
+                    if ((ierr = get_region_varn_lists(regions, fndims, record, &rrcnt)))
+                        break;
+
                     /* For each variable to be written. */
                     for (int nv = 0; nv < nvars; nv++)
                     {
@@ -343,9 +417,8 @@ int write_darray_multi_par(file_desc_t *file, int nvars, int fndims, const int *
 
                         /* If this is a record (or quasi-record) var, set the start for
                          * the record dimension. */
-                        if (vdesc->record >= 0 && fndims > 1)
-                            for (int rc = 0; rc < rrcnt; rc++)
-                                startlist[rc][0] = frame[nv];
+                        if (record)
+                            set_region_frame(regions, rrcnt, frame[nv]);
 
                         /* Get a pointer to the data. */
                         bufptr = (void *)((char *)iobuf + nv * iodesc->mpitype_size * llen);
@@ -382,7 +455,9 @@ int write_darray_multi_par(file_desc_t *file, int nvars, int fndims, const int *
                         /* Write, in non-blocking fashion, a list of subarrays. */
                         LOG((3, "about to call ncmpi_iput_varn() varids[%d] = %d rrcnt = %d, llen = %d",
                              nv, varids[nv], rrcnt, llen));
-                        ierr = ncmpi_iput_varn(file->fh, varids[nv], rrcnt, startlist, countlist,
+                        ierr = ncmpi_iput_varn(file->fh, varids[nv], rrcnt,
+                                               rrcnt ? regions->startp : nolist,
+                                               rrcnt ? regions->countp : nolist,
                                                bufptr, llen, iodesc->mpitype, vdesc->request + vdesc->nreqs);
                         if (ierr != PIO_NOERR)
                         {
@@ -408,12 +483,11 @@ int write_darray_multi_par(file_desc_t *file, int nvars, int fndims, const int *
                         vdesc->nreqs++;
                     }
 
-                    /* Free resources. */
-                    for (int i = 0; i < rrcnt; i++)
-                    {
-                        free(startlist[i]);
-                        free(countlist[i]);
-                    }
+                    /* Restore the start of the record dimension in the
+                     * table (it may be the start of an extra outermost
+                     * dimension of the decomposition). */
+                    if (record)
+                        set_region_frame(regions, rrcnt, 0);
                 }
                 break;
 #endif
@@ -426,17 +500,14 @@ int write_darray_multi_par(file_desc_t *file, int nvars, int fndims, const int *
             if (ierr != PIO_NOERR)
             {
                 ierr = pio_err(ios, file, ierr, __FILE__, __LINE__,
-                                "Writing variables (number of variables = %d) to file (%s, ncid=%d) failed. Writing region of data at offset = %d failed", nvars, pio_get_fname_from_file(file), file->pio_ncid, region->loffset);
+                                "Writing variables (number of variables = %d) to file (%s, ncid=%d) failed. Writing region %d of data failed", nvars, pio_get_fname_from_file(file), file->pio_ncid, regioncnt);
                 break;
             }
-            /* Go to next region. */
-            if (region)
-                region = region->next;
         } /* next regioncnt */
     } /* endif (ios->ioproc) */
 
     /* Check the return code from the netCDF/pnetcdf call. */
-    ierr = check_netcdf(NULL, file, ierr, __FILE__,__LINE__);
+    ierr = check_netcdf_defer(file, ierr, __FILE__, __LINE__);
 
 #ifdef TIMING
     /* Stop timing this function. */
@@ -453,8 +524,9 @@ int write_darray_multi_par(file_desc_t *file, int nvars, int fndims, const int *
  * This is an internal function which is only called on io tasks. It
  * is called by write_darray_multi_serial().
  *
- * @param region pointer to the first in a linked list of regions.
- * @param maxregions the number of regions in the list.
+ * @param regions pointer to the region table. May be NULL.
+ * @param maxregions the number of regions to fill start/count arrays
+ * for. Regions beyond the end of the table get zero start/count.
  * @param fndims the number of dimensions in the file.
  * @param iodesc_ndims the number of dimensions in the decomposition.
  * @param dimlen the lengths of dimensions in the decomposition.
@@ -470,68 +542,28 @@ int write_darray_multi_par(file_desc_t *file, int nvars, int fndims, const int *
  * @ingroup PIO_read_darray
  * @author Jim Edwards, Ed Hartnett
  **/
-int find_all_start_count(io_region *region, int maxregions, int fndims,
+int find_all_start_count(io_region_table *regions, int maxregions, int fndims,
                          int iodesc_ndims, const int *dimlen, var_desc_t *vdesc,
                          size_t *tmp_start, size_t *tmp_count)
 {
+    int ierr;
+
     /* Check inputs. */
     pioassert(maxregions >= 0 && fndims > 0 && iodesc_ndims >= 0 && vdesc &&
               tmp_start && tmp_count, "invalid input", __FILE__, __LINE__);
 
-    /* Find the start/count arrays for each region in the list. */
+    /* Find the start/count arrays for each region in the table. */
     for (int r = 0; r < maxregions; r++)
     {
-        /* Initialize the start/count arrays for this region to 0. */
-        for (int d = 0; d < fndims; d++)
-        {
-            tmp_start[d + r * fndims] = 0;
-            tmp_count[d + r * fndims] = 0;
-        }
-
-        if (region)
-        {
-            /* Allow extra outermost dimensions in the decomposition */
-            int num_extra_dims = (vdesc->record >= 0 && fndims > 1)? (iodesc_ndims - (fndims - 1)) : (iodesc_ndims - fndims);
-            pioassert(num_extra_dims >= 0, "Unexpected num_extra_dims", __FILE__, __LINE__);
-            if (num_extra_dims > 0)
-            {
-                for (int d = 0; d < num_extra_dims; d++)
-                    pioassert(dimlen[d] == 1, "Extra outermost dimensions must have lengths of 1",
-                              __FILE__, __LINE__);
-            }
-
-            if (vdesc->record >= 0 && fndims > 1)
-            {
-                /* This is a record based multidimensional
-                 * array. Copy start/count for non-record
-                 * dimensions. */
-                for (int i = 1; i < fndims; i++)
-                {
-                    tmp_start[i + r * fndims] = region->start[num_extra_dims + (i - 1)];
-                    tmp_count[i + r * fndims] = region->count[num_extra_dims + (i - 1)];
-                    LOG((3, "tmp_start[%d] = %d tmp_count[%d] = %d", i + r * fndims,
-                         tmp_start[i + r * fndims], i + r * fndims,
-                         tmp_count[i + r * fndims]));
-                }
-            }
-            else
-            {
-                /* This is not a record based multidimensional array. */
-                for (int i = 0; i < fndims; i++)
-                {
-                    tmp_start[i + r * fndims] = region->start[num_extra_dims + i];
-                    tmp_count[i + r * fndims] = region->count[num_extra_dims + i];
-                    LOG((3, "tmp_start[%d] = %d tmp_count[%d] = %d", i + r * fndims,
-                         tmp_start[i + r * fndims], i + r * fndims,
-                         tmp_count[i + r * fndims]));
-                }
-            }
-
-            /* Move to next region. */
-            region = region->next;
+        if ((ierr = find_start_count(iodesc_ndims, dimlen, fndims, vdesc, regions, r,
+                                     &tmp_start[r * fndims], &tmp_count[r * fndims])))
+            return ierr;
 
-        } /* endif region */
-    } /* next r */
+        /* The count of the record dimension is set when the data is
+         * written. */
+        if (vdesc->record >= 0 && fndims > 1)
+            tmp_count[r * fndims] = 0;
+    }
 
     return PIO_NOERR;
 }
@@ -854,7 +886,7 @@ int write_darray_multi_serial(file_desc_t *file, int nvars, int fndims, const in
     /* Set these differently for data and fill writing. iobuf may be
      * null if array size < number of nodes. */
     int num_regions = fill ? iodesc->maxfillregions: iodesc->maxregions;
-    io_region *region = fill ? iodesc->fillregion : iodesc->firstregion;
+    io_region_table *regions = fill ? iodesc->fillregions : iodesc->regions;
     PIO_Offset llen = fill ? iodesc->holegridsize : iodesc->llen;
     void *iobuf = fill ? vdesc->fillbuf : file->iobuf[iodesc->ioid - PIO_IODESC_START_ID];
 
@@ -873,7 +905,7 @@ int write_darray_multi_serial(file_desc_t *file, int nvars, int fndims, const in
 
         /* Fill the tmp_start and tmp_count arrays, which contain the
          * start and count arrays for all regions. */
-        if ((ierr = find_all_start_count(region, num_regions, fndims, iodesc->ndims, iodesc->dimlen, vdesc,
+        if ((ierr = find_all_start_count(regions, num_regions, fndims, iodesc->ndims, iodesc->dimlen, vdesc,
                                          tmp_start, tmp_count)))
         {
             ierr = pio_err(ios, file, ierr, __FILE__, __LINE__,
@@ -908,7 +940,7 @@ int write_darray_multi_serial(file_desc_t *file, int nvars, int fndims, const in
         } /* if (ierr == PIO_NOERR) */
     } /* if (ios->ioproc) */
 
-    ierr = check_netcdf(ios, file, ierr, __FILE__, __LINE__);
+    ierr = check_netcdf_defer(file, ierr, __FILE__, __LINE__);
     if(ierr != PIO_NOERR){
         LOG((1, "nc_put_vara* or sending data to root failed, ierr = %d", ierr));
         return pio_err(ios, file, ierr, __FILE__, __LINE__,
@@ -970,19 +1002,14 @@ int pio_read_darray_nc(file_desc_t *file, int fndims, io_desc_t *iodesc, int vid
     /* IO procs will actially read the data. */
     if (ios->ioproc)
     {
-        io_region *region;
+        /* There are no regions to read if there is no data on this
+         * task. */
+        io_region_table *regions = iodesc->llen > 0 ? iodesc->regions : NULL;
+        bool record;
         size_t start[fndims];
         size_t count[fndims];
-        size_t tmp_bufsize = 1;
         void *bufptr;
         int rrlen = 0;
-        PIO_Offset *startlist[iodesc->maxregions];
-        PIO_Offset *countlist[iodesc->maxregions];
-
-        /* buffer is incremented by byte and loffset is in terms of
-           the iodessc->mpitype so we need to multiply by the size of
-           the mpitype. */
-        region = iodesc->firstregion;
 
         /* This is a record (or quasi-record) var. If the record
            number has not been set yet, set it to 0 by default */
@@ -991,73 +1018,49 @@ int pio_read_darray_nc(file_desc_t *file, int fndims, io_desc_t *iodesc, int vid
             if (vdesc->record < 0)
                 vdesc->record = 0;
         }
+        record = vdesc->record >= 0 && fndims > 1;
 
         /* For each regions, read the data. */
         for (int regioncnt = 0; regioncnt < iodesc->maxregions; regioncnt++)
         {
-            tmp_bufsize = 1;
-            if (region == NULL || iodesc->llen == 0)
+            /* Get the start/count arrays. */
+            if ((ierr = find_start_count(ndims, iodesc->dimlen, fndims, vdesc, regions, regioncnt,
+                                         start, count)))
+                break;
+
+            if (!regions || regioncnt >= regions->nregions)
             {
                 /* No data for this region. */
-                for (int i = 0; i < fndims; i++)
-                {
-                    start[i] = 0;
-                    count[i] = 0;
-                }
                 bufptr = NULL;
             }
             else
             {
-                /* Get a pointer where we should put the data we read. */
-                if (regioncnt == 0 || region == NULL)
+                /* Get a pointer where we should put the data we
+                   read. buffer is incremented by byte and loffset is
+                   in terms of the iodessc->mpitype so we need to
+                   multiply by the size of the mpitype. */
+                if (regioncnt == 0)
                     bufptr = iobuf;
                 else
-                    bufptr=(void *)((char *)iobuf + iodesc->mpitype_size * region->loffset);
+                    bufptr = (void *)((char *)iobuf + iodesc->mpitype_size * regions->loffset[regioncnt]);
 
-                LOG((2, "%d %d %d", iodesc->llen - region->loffset, iodesc->llen, region->loffset));
+                LOG((2, "%d %d %d", iodesc->llen - regions->loffset[regioncnt], iodesc->llen,
+                     regions->loffset[regioncnt]));
 
-                /* Allow extra outermost dimensions in the decomposition */
-                int num_extra_dims = (vdesc->record >= 0 && fndims > 1)? (ndims - (fndims - 1)) : (ndims - fndims);
-                pioassert(num_extra_dims >= 0, "Unexpected num_extra_dims", __FILE__, __LINE__);
-                if (num_extra_dims > 0)
-                {
-                    for (int d = 0; d < num_extra_dims; d++)
-                        pioassert(iodesc->dimlen[d] == 1, "Extra outermost dimensions must have lengths of 1",
-                                  __FILE__, __LINE__);
-                }
-
-                /* Get the start/count arrays. */
-                if (vdesc->record >= 0 && fndims > 1)
-                {
-                    /* This is a record (or quasi-record) var. The record dimension
-                     * (0) is handled specially. */
+                /* This is a record (or quasi-record) var. The record
+                 * dimension (0) is handled specially. */
+                if (record)
                     start[0] = vdesc->record;
-                    for (int i = 1; i < fndims; i++)
-                    {
-                        start[i] = region->start[num_extra_dims + (i - 1)];
-                        count[i] = region->count[num_extra_dims + (i - 1)];
-                    }
-
-                    /* Read one record. */
-                    if (count[1] > 0)
-                        count[0] = 1;
-                }
-                else
-                {
-                    /* Non-time dependent array */
-                    for (int i = 0; i < fndims; i++)
-                    {
-                        start[i] = region->start[num_extra_dims + i];
-                        count[i] = region->count[num_extra_dims + i];
-                    }
-                }
             }
 
             /* Do the read. */
             switch (file->iotype)
             {
+#ifdef _NETCDF
 #ifdef _NETCDF4
             case PIO_IOTYPE_NETCDF4P:
+#endif
+            case PIO_IOTYPE_MEMORY:
                 /* ierr = nc_get_vara(file->fh, vid, start, count, bufptr); */
                 switch (iodesc->piotype)
                 {
@@ -1099,7 +1102,7 @@ int pio_read_darray_nc(file_desc_t *file, int fndims, io_desc_t *iodesc, int vid
                     break;
                 default:
                     ierr = pio_err(ios, file, PIO_EBADTYPE, __FILE__, __LINE__,
-                                    "Reading variable (%s, varid=%d) from file (%s, ncid=%d) failed with iotype=PIO_IOTYPE_NETCDF4P. Unsupported variable type (type=%d)", pio_get_vname_from_file(file, vid), vid, pio_get_fname_from_file(file), file->pio_ncid, file->iotype);
+                                    "Reading variable (%s, varid=%d) from file (%s, ncid=%d) failed with iotype=%s. Unsupported variable type (type=%d)", pio_get_vname_from_file(file, vid), vid, pio_get_fname_from_file(file), file->pio_ncid, pio_iotype_to_string(file->iotype), iodesc->piotype);
                     break;
                 }
                 break;
@@ -1107,42 +1110,41 @@ int pio_read_darray_nc(file_desc_t *file, int fndims, io_desc_t *iodesc, int vid
 #ifdef _PNETCDF
             case PIO_IOTYPE_PNETCDF:
             {
-                tmp_bufsize = 1;
-                for (int j = 0; j < fndims; j++)
-                    tmp_bufsize *= count[j];
-
-                if (tmp_bufsize > 0)
-                {
-                    startlist[rrlen] = bget(fndims * sizeof(PIO_Offset));
-                    countlist[rrlen] = bget(fndims * sizeof(PIO_Offset));
-
-                    for (int j = 0; j < fndims; j++)
-                    {
-                        startlist[rrlen][j] = start[j];
-                        countlist[rrlen][j] = count[j];
-                    }
-                    rrlen++;
-                }
-
                 /* Is this is the last region to process? */
                 if (regioncnt == iodesc->maxregions - 1)
                 {
-                    /* Read a list of subarrays. */
-                    ierr = ncmpi_get_varn_all(file->fh, vid, rrlen, startlist,
-                                              countlist, iobuf, iodesc->llen, iodesc->mpitype);
+                    PIO_Offset *nolist[1] = {NULL}; /* Start/count list when there is no data. */
+                    PIO_Offset **startlist, **countlist;
+
+                    /* Point the start/count lists at the
+                     * regions, and set the record to read. */
+                    if ((ierr = get_region_varn_lists(regions, fndims, record, &rrlen)))
+                        break;
+                    if (record)
+                        set_region_frame(regions, rrlen, vdesc->record);
+                    startlist = rrlen ? regions->startp : nolist;
+                    countlist = rrlen ? regions->countp : nolist;
+
+                    /* Read a list of subarrays. The subarrays of
+                     * subfiled datasets are read from the subfiles
+                     * that contain them. */
+                    if (file->subfile)
+                        ierr = pio_subfile_get_varn(file, vid, fndims, rrlen, startlist,
+                                                    countlist, iobuf, iodesc->mpitype);
+                    else
+                        ierr = ncmpi_get_varn_all(file->fh, vid, rrlen, startlist,
+                                                  countlist, iobuf, iodesc->llen, iodesc->mpitype);
+
+                    /* Restore the start of the record dimension in
+                     * the table. */
+                    if (record)
+                        set_region_frame(regions, rrlen, 0);
                     if(ierr != PIO_NOERR)
                     {
                         ierr = pio_err(ios, file, ierr, __FILE__, __LINE__,
                                 "Reading variable (%s, varid=%d) from file (%s, ncid=%d) failed with PIO_IOTYPE_PNETCDF iotype. The low level (PnetCDF) I/O library call failed to read the variable (Number of regions = %d, iodesc id = %d, Bytes to read on this process = %llu)", pio_get_vname_from_file(file, vid), vid, pio_get_fname_from_file(file), file->pio_ncid, rrlen, iodesc->ioid, (unsigned long long int) iodesc->llen);
                         break;
                     }
-
-                    /* Release the start and count arrays. */
-                    for (int i = 0; i < rrlen; i++)
-                    {
-                        brel(startlist[i]);
-                        brel(countlist[i]);
-                    }
                 }
             }
             break;
@@ -1157,17 +1159,13 @@ int pio_read_darray_nc(file_desc_t *file, int fndims, io_desc_t *iodesc, int vid
             if(ierr != PIO_NOERR){
               break;
             }
-
-            /* Move to next region. */
-            if (region)
-                region = region->next;
         } /* next regioncnt */
     }
     ierr = check_netcdf(NULL, file, ierr, __FILE__,__LINE__);
     if(ierr != PIO_NOERR){
         LOG((1, "nc*_get_var* failed, ierr = %d", ierr));
         return pio_err(NULL, file, ierr, __FILE__, __LINE__,
-                        "Reading variable (%s, varid=%d) from file (%s, ncid=%d) failed with iotype=%s. The underlying I/O library (%s) call, nc*_get_var*, failed.", pio_get_vname_from_file(file, vid), vid, pio_get_fname_from_file(file), file->pio_ncid, pio_iotype_to_string(file->iotype), (file->iotype == PIO_IOTYPE_NETCDF4P) ? "NetCDF" : "PnetCDF");
+                        "Reading variable (%s, varid=%d) from file (%s, ncid=%d) failed with iotype=%s. The underlying I/O library (%s) call, nc*_get_var*, failed.", pio_get_vname_from_file(file, vid), vid, pio_get_fname_from_file(file), file->pio_ncid, pio_iotype_to_string(file->iotype), (file->iotype == PIO_IOTYPE_PNETCDF) ? "PnetCDF" : "NetCDF");
     }
 
 #ifdef TIMING
@@ -1227,7 +1225,9 @@ int pio_read_darray_nc_serial(file_desc_t *file, int fndims, io_desc_t *iodesc,
 
     if (ios->ioproc)
     {
-        io_region *region;
+        /* There are no regions to read if there is no data on this
+         * task. */
+        io_region_table *regions = iodesc->llen > 0 ? iodesc->regions : NULL;
         size_t start[fndims];
         size_t count[fndims];
         size_t tmp_start[fndims * iodesc->maxregions];
@@ -1235,11 +1235,6 @@ int pio_read_darray_nc_serial(file_desc_t *file, int fndims, io_desc_t *iodesc,
         size_t tmp_bufsize;
         void *bufptr;
 
-        /* buffer is incremented by byte and loffset is in terms of
-           the iodessc->mpitype so we need to multiply by the size of
-           the mpitype. */
-        region = iodesc->firstregion;
-
         /* This is a record (or quasi-record) var. If the record
            number has not been set yet, set it to 0 by default */
         if (fndims > ndims)
@@ -1251,66 +1246,22 @@ int pio_read_darray_nc_serial(file_desc_t *file, int fndims, io_desc_t *iodesc,
         /* Put together start/count arrays for all regions. */
         for (int regioncnt = 0; regioncnt < iodesc->maxregions; regioncnt++)
         {
-            if (!region || iodesc->llen == 0)
-            {
-                /* Nothing to write for this region. */
-                for (int i = 0; i < fndims; i++)
-                {
-                    tmp_start[i + regioncnt * fndims] = 0;
-                    tmp_count[i + regioncnt * fndims] = 0;
-                }
-                bufptr = NULL;
-            }
-            else
-            {
-                /* Allow extra outermost dimensions in the decomposition */
-                int num_extra_dims = (vdesc->record >= 0 && fndims > 1)? (ndims - (fndims - 1)) : (ndims - fndims);
-                pioassert(num_extra_dims >= 0, "Unexpected num_extra_dims", __FILE__, __LINE__);
-                if (num_extra_dims > 0)
-                {
-                    for (int d = 0; d < num_extra_dims; d++)
-                        pioassert(iodesc->dimlen[d] == 1, "Extra outermost dimensions must have lengths of 1",
-                                  __FILE__, __LINE__);
-                }
-
-                if (vdesc->record >= 0 && fndims > 1)
-                {
-                    /* This is a record (or quasi-record) var. Find start for record dims. */
-                    tmp_start[regioncnt * fndims] = vdesc->record;
+            if ((ierr = find_start_count(ndims, iodesc->dimlen, fndims, vdesc, regions, regioncnt,
+                                         &tmp_start[regioncnt * fndims], &tmp_count[regioncnt * fndims])))
+                return pio_err(ios, file, ierr, __FILE__, __LINE__,
+                                "Reading variable (%s, varid=%d) from file (%s, ncid=%d) failed. Internal error finding start/count of I/O regions", pio_get_vname_from_file(file, vid), vid, pio_get_fname_from_file(file), file->pio_ncid);
 
-                    /* Find start/count for all non-record dims. */
-                    for (int i = 1; i < fndims; i++)
-                    {
-                        tmp_start[i + regioncnt * fndims] = region->start[num_extra_dims + (i - 1)];
-                        tmp_count[i + regioncnt * fndims] = region->count[num_extra_dims + (i - 1)];
-                    }
-
-                    /* Set count for record dimension. */
-                    if (tmp_count[1 + regioncnt * fndims] > 0)
-                        tmp_count[regioncnt * fndims] = 1;
-                }
-                else
-                {
-                    /* Non-time dependent array */
-                    for (int i = 0; i < fndims; i++)
-                    {
-                        tmp_start[i + regioncnt * fndims] = region->start[num_extra_dims + i];
-                        tmp_count[i + regioncnt * fndims] = region->count[num_extra_dims + i];
-                    }
-                }
-            }
+            /* This is a record (or quasi-record) var. Find start for
+             * record dims. */
+            if (regions && regioncnt < regions->nregions && vdesc->record >= 0 && fndims > 1)
+                tmp_start[regioncnt * fndims] = vdesc->record;
 
 #if PIO_ENABLE_LOGGING
             /* Log arrays for debug purposes. */
-            LOG((3, "region = %d", region));
             for (int i = 0; i < fndims; i++)
                 LOG((3, "tmp_start[%d] = %d tmp_count[%d] = %d", i + regioncnt * fndims, tmp_start[i + regioncnt * fndims],
                      i + regioncnt * fndims, tmp_count[i + regioncnt * fndims]));
 #endif /* PIO_ENABLE_LOGGING */
-
-            /* Move to next region. */
-            if (region)
-                region = region->next;
         } /* next regioncnt */
 
         /* IO tasks other than 0 send their starts/counts and data to
@@ -2049,7 +2000,7 @@ int flush_output_buffer(file_desc_t *file, bool force, PIO_Offset addsize)
             if (file->iobuf[i])
             {
                 LOG((3,"freeing variable buffer in flush_output_buffer"));
-                brel(file->iobuf[i]);
+                pio_mem_rel(file, file->iobuf[i]);
                 file->iobuf[i] = NULL;
             }
         }
@@ -2070,7 +2021,7 @@ int flush_output_buffer(file_desc_t *file, bool force, PIO_Offset addsize)
   
             if (vdesc->fillbuf)
             {
-                brel(vdesc->fillbuf);
+                pio_mem_rel(file, vdesc->fillbuf);
                 vdesc->fillbuf = NULL;
             }
         }
@@ -2099,38 +2050,204 @@ void cn_buffer_report(iosystem_desc_t *ios, bool collective)
 
     LOG((2, "cn_buffer_report ios->iossysid = %d collective = %d",
          ios->iosysid, collective));
-    long bget_stats[5];
-    long bget_mins[5];
-    long bget_maxs[5];
+    long buf_stats[5] = {0};
+    long buf_mins[5];
+    long buf_maxs[5];
 
-    bstats(bget_stats, bget_stats+1,bget_stats+2,bget_stats+3,bget_stats+4);
+    if (ios->arena)
+    {
+        PIO_Offset curalloc, totfree, maxfree;
+
+        pio_arena_stats(ios->arena, &curalloc, &totfree, &maxfree, buf_stats+3, buf_stats+4);
+        buf_stats[0] = curalloc;
+        buf_stats[1] = totfree;
+        buf_stats[2] = maxfree;
+    }
     if (collective)
     {
         LOG((3, "cn_buffer_report calling MPI_Reduce ios->comp_comm = %d", ios->comp_comm));
-        if ((mpierr = MPI_Reduce(bget_stats, bget_maxs, 5, MPI_LONG, MPI_MAX, 0, ios->comp_comm)))
+        if ((mpierr = MPI_Reduce(buf_stats, buf_maxs, 5, MPI_LONG, MPI_MAX, 0, ios->comp_comm)))
             check_mpi(NULL, NULL, mpierr, __FILE__, __LINE__);
         LOG((3, "cn_buffer_report calling MPI_Reduce"));
-        if ((mpierr = MPI_Reduce(bget_stats, bget_mins, 5, MPI_LONG, MPI_MIN, 0, ios->comp_comm)))
+        if ((mpierr = MPI_Reduce(buf_stats, buf_mins, 5, MPI_LONG, MPI_MIN, 0, ios->comp_comm)))
             check_mpi(NULL, NULL, mpierr, __FILE__, __LINE__);
         if (ios->compmaster == MPI_ROOT)
         {
-            LOG((1, "Currently allocated buffer space %ld %ld", bget_mins[0], bget_maxs[0]));
-            LOG((1, "Currently available buffer space %ld %ld", bget_mins[1], bget_maxs[1]));
-            LOG((1, "Current largest free block %ld %ld", bget_mins[2], bget_maxs[2]));
-            LOG((1, "Number of successful bget calls %ld %ld", bget_mins[3], bget_maxs[3]));
-            LOG((1, "Number of successful brel calls  %ld %ld", bget_mins[4], bget_maxs[4]));
+            LOG((1, "Currently allocated buffer space %ld %ld", buf_mins[0], buf_maxs[0]));
+            LOG((1, "Currently available buffer space %ld %ld", buf_mins[1], buf_maxs[1]));
+            LOG((1, "Current largest free block %ld %ld", buf_mins[2], buf_maxs[2]));
+            LOG((1, "Number of successful get calls %ld %ld", buf_mins[3], buf_maxs[3]));
+            LOG((1, "Number of successful release calls  %ld %ld", buf_mins[4], buf_maxs[4]));
         }
     }
     else
     {
-        LOG((1, "Currently allocated buffer space %ld", bget_stats[0]));
-        LOG((1, "Currently available buffer space %ld", bget_stats[1]));
-        LOG((1, "Current largest free block %ld", bget_stats[2]));
-        LOG((1, "Number of successful bget calls %ld", bget_stats[3]));
-        LOG((1, "Number of successful brel calls  %ld", bget_stats[4]));
+        LOG((1, "Currently allocated buffer space %ld", buf_stats[0]));
+        LOG((1, "Currently available buffer space %ld", buf_stats[1]));
+        LOG((1, "Current largest free block %ld", buf_stats[2]));
+        LOG((1, "Number of successful get calls %ld", buf_stats[3]));
+        LOG((1, "Number of successful release calls  %ld", buf_stats[4]));
+    }
+}
+
+/** Bytes in front of each buffer tracked by the memory statistics,
+ * which hold the size and memory category of the buffer. A multiple
+ * of 16 to keep the alignment of the data. */
+#define PIO_MEM_HDR_SZ 16
+
+/**
+ * Add bytes to the current memory of a category, and to the total,
+ * and update their peaks.
+ *
+ * @param cur array (length PIO_MEM_NCATS) of current bytes.
+ * @param peak array (length PIO_MEM_NCATS) of peak bytes.
+ * @param cat the memory category.
+ * @param nbytes the number of bytes, negative if released.
+ */
+static void mem_add(PIO_Offset *cur, PIO_Offset *peak, int cat, PIO_Offset nbytes)
+{
+    cur[cat] += nbytes;
+    cur[PIO_MEM_TOTAL] += nbytes;
+    peak[cat] = max(peak[cat], cur[cat]);
+    peak[PIO_MEM_TOTAL] = max(peak[PIO_MEM_TOTAL], cur[PIO_MEM_TOTAL]);
+}
+
+/**
+ * Account memory acquired or released by an IO system, and by one
+ * of its files, in the memory statistics (see PIOc_get_mem_stats()).
+ *
+ * @param ios pointer to the IO system structure.
+ * @param file pointer to the file structure, NULL for memory that is
+ * not held for a file.
+ * @param cat the memory category (PIO_MEM_WMB, PIO_MEM_IOBUF, ...).
+ * @param nbytes the number of bytes, negative if released.
+ */
+void pio_mem_account(iosystem_desc_t *ios, file_desc_t *file, int cat, PIO_Offset nbytes)
+{
+    pioassert(ios && cat >= 0 && cat < PIO_MEM_TOTAL, "invalid input", __FILE__, __LINE__);
+
+    mem_add(ios->mem_cur, ios->mem_peak, cat, nbytes);
+    if (file)
+    {
+        mem_add(file->mem_cur, file->mem_peak, cat, nbytes);
+
+        /* The data cached for a file with its own cache budget is not
+         * counted against pio_buffer_size_limit. */
+        if (file->cache_limit > 0 && cat == PIO_MEM_WMB)
+            ios->file_cache_alloc += nbytes;
     }
 }
 
+/**
+ * Get the arena of the buffers of an IO system, creating it on first
+ * use (compute_buffer_init() is not called on all initialization
+ * paths).
+ *
+ * @param ios pointer to the IO system structure.
+ * @returns pointer to the arena, NULL if out of memory.
+ */
+static pio_arena_t *pio_mem_arena(iosystem_desc_t *ios)
+{
+    if (!ios->arena)
+        pio_arena_create(&ios->arena);
+
+    return ios->arena;
+}
+
+/**
+ * Account the bytes kept for reuse by the arena of an IO system in
+ * the memory statistics of the IO system (PIO_MEM_ARENA), after a
+ * buffer is got or released.
+ *
+ * @param ios pointer to the IO system structure.
+ */
+static void pio_mem_account_arena(iosystem_desc_t *ios)
+{
+    if (ios->arena)
+        mem_add(ios->mem_cur, ios->mem_peak, PIO_MEM_ARENA,
+                pio_arena_retained(ios->arena) - ios->mem_cur[PIO_MEM_ARENA]);
+}
+
+/**
+ * Get a buffer of a file from the arena of its IO system, and
+ * account it in the memory statistics.
+ *
+ * @param file pointer to the file structure.
+ * @param cat the memory category of the buffer.
+ * @param size the size of the buffer in bytes.
+ * @returns pointer to the buffer, NULL if out of memory.
+ */
+void *pio_mem_get(file_desc_t *file, int cat, PIO_Offset size)
+{
+    pio_arena_t *arena;
+    PIO_Offset *hdr;
+
+    pioassert(file && size >= 0, "invalid input", __FILE__, __LINE__);
+
+    if (!(arena = pio_mem_arena(file->iosystem)))
+        return NULL;
+    if (!(hdr = pio_arena_alloc(arena, size + PIO_MEM_HDR_SZ)))
+        return NULL;
+    hdr[0] = size;
+    hdr[1] = cat;
+    pio_mem_account(file->iosystem, file, cat, size);
+    pio_mem_account_arena(file->iosystem);
+
+    return (char *)hdr + PIO_MEM_HDR_SZ;
+}
+
+/**
+ * Resize a buffer of a file got with pio_mem_get() (or get a new one
+ * if buf is NULL), and account it in the memory statistics. If out
+ * of memory, the buffer is unchanged.
+ *
+ * @param file pointer to the file structure.
+ * @param cat the memory category of the buffer.
+ * @param buf pointer to the buffer, may be NULL.
+ * @param size the new size of the buffer in bytes.
+ * @returns pointer to the buffer, NULL if out of memory.
+ */
+void *pio_mem_getr(file_desc_t *file, int cat, void *buf, PIO_Offset size)
+{
+    PIO_Offset *hdr = buf ? (PIO_Offset *)((char *)buf - PIO_MEM_HDR_SZ) : NULL;
+    PIO_Offset old_size = hdr ? hdr[0] : 0;
+    pio_arena_t *arena;
+
+    pioassert(file && size >= 0 && (!hdr || hdr[1] == cat), "invalid input",
+              __FILE__, __LINE__);
+
+    if (!(arena = pio_mem_arena(file->iosystem)))
+        return NULL;
+    if (!(hdr = pio_arena_realloc(arena, hdr, size + PIO_MEM_HDR_SZ)))
+        return NULL;
+    hdr[0] = size;
+    hdr[1] = cat;
+    pio_mem_account(file->iosystem, file, cat, size - old_size);
+    pio_mem_account_arena(file->iosystem);
+
+    return (char *)hdr + PIO_MEM_HDR_SZ;
+}
+
+/**
+ * Release a buffer of a file got with pio_mem_get() or
+ * pio_mem_getr().
+ *
+ * @param file pointer to the file structure.
+ * @param buf pointer to the buffer, may be NULL.
+ */
+void pio_mem_rel(file_desc_t *file, void *buf)
+{
+    PIO_Offset *hdr;
+
+    if (!buf)
+        return;
+
+    hdr = (PIO_Offset *)((char *)buf - PIO_MEM_HDR_SZ);
+    pio_mem_account(file->iosystem, file, hdr[1], -hdr[0]);
+    pio_arena_release(file->iosystem->arena, hdr);
+    pio_mem_account_arena(file->iosystem);
+}
+
 /**
  * Flush the buffer.
  *
@@ -2177,12 +2294,12 @@ int flush_buffer(int ncid, wmulti_buffer *wmb, bool flushtodisk)
         wmb->vid = NULL;
 
         /* Release the data memory. */
-        brel(wmb->data);
+        pio_mem_rel(file, wmb->data);
         wmb->data = NULL;
 
         /* If there is a fill value, release it. */
         if (wmb->fillvalue)
-            brel(wmb->fillvalue);
+            pio_mem_rel(file, wmb->fillvalue);
         wmb->fillvalue = NULL;
 
         /* Release the record number. */
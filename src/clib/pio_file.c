@@ -5,6 +5,9 @@
 #include <pio_config.h>
 #include <pio.h>
 #include <pio_internal.h>
+#ifdef PIO_MICRO_TIMING
+#include "pio_timer.h"
+#endif
 
 #ifdef _ADIOS2
 #include "../../tools/adios2pio-nm/adios2pio-nm-lib-c.h"
@@ -329,24 +332,62 @@ static int sync_file(int ncid)
 #endif
 #ifdef _NETCDF
             case PIO_IOTYPE_NETCDF:
+            case PIO_IOTYPE_NULL:
                 if (ios->io_rank == 0)
                     ierr = nc_sync(file->fh);
                 break;
+            case PIO_IOTYPE_MEMORY:
+                ierr = nc_sync(file->fh);
+                break;
 #endif
 #ifdef _PNETCDF
             case PIO_IOTYPE_PNETCDF:
                 ierr = flush_output_buffer(file, true, 0);
+                if (ierr == PIO_NOERR)
+                    ierr = pio_stage_sync(file);
+                /* The index is written collectively, if the data was
+                 * flushed on all the IO tasks. */
+                if (file->subfile && (file->mode & PIO_WRITE))
+                {
+                    int mpierr;
+
+                    if ((mpierr = MPI_Allreduce(MPI_IN_PLACE, &ierr, 1, MPI_INT, MPI_MIN, ios->io_comm)))
+                        ierr = check_mpi(NULL, file, mpierr, __FILE__, __LINE__);
+                    if (ierr == PIO_NOERR)
+                        ierr = pio_subfile_write_index(file);
+                }
+                break;
+#endif
+#ifdef _HDF5
+            case PIO_IOTYPE_HDF5:
+                ierr = pio_hdf5_sync(file);
                 break;
 #endif
             default:
                 return pio_err(ios, file, PIO_EBADIOTYPE, __FILE__, __LINE__,
                                 "Syncing file %s (ncid=%d) failed. Invalid/Unsupported iotype (%s:%d) provided", pio_get_fname_from_file(file), ncid, pio_iotype_to_string(file->iotype), file->iotype);
             }
+
+            /* Drain the data staged for closed files. All the IO tasks
+             * have the same pending logs, and the draining is
+             * collective, so it is done even if syncing this file
+             * failed on some of the tasks. */
+            if (ios->stage_pending)
+            {
+                int ret = pio_stage_drain_pending(ios);
+                if (ierr == PIO_NOERR)
+                    ierr = ret;
+            }
         }
         LOG((2, "sync_file ierr = %d", ierr));
     }
 
-    ierr = check_netcdf(ios, NULL, ierr, __FILE__, __LINE__);
+    /* With PIO_DEFER_ERROR the errors recorded since the last sync
+     * point (e.g. when writing data) are checked here, using a single
+     * collective call */
+    ierr = check_netcdf_defer(file, ierr, __FILE__, __LINE__);
+    if (ierr == PIO_NOERR)
+        ierr = pio_check_deferred_errors(file);
     if (ierr != PIO_NOERR)
     {
         LOG((1, "nc*_sync failed, ierr = %d", ierr));
@@ -368,6 +409,7 @@ int PIOc_closefile(int ncid)
     iosystem_desc_t *ios;  /* Pointer to io system information. */
     file_desc_t *file;     /* Pointer to file information. */
     int ierr = PIO_NOERR;  /* Return code from function calls. */
+    int deferred_ierr = PIO_NOERR; /* Deferred errors found when syncing the file. */
 #ifdef _ADIOS2
     char outfilename[PIO_MAX_NAME + 1];
     size_t len = 0;
@@ -399,8 +441,18 @@ int PIOc_closefile(int ncid)
     /* Sync changes before closing on all tasks if async is not in
      * use, but only on non-IO tasks if async is in use. */
     if (!ios->async || !ios->ioproc)
+    {
         if (file->mode & PIO_WRITE)
-            sync_file(ncid);
+        {
+            /* With PIO_DEFER_ERROR syncing the file reports the errors
+             * recorded since the last sync point, the file is closed
+             * anyway */
+            ierr = sync_file(ncid);
+            if (ios->error_handler == PIO_DEFER_ERROR)
+                deferred_ierr = ierr;
+            ierr = PIO_NOERR;
+        }
+    }
 
     /* If async is in use and this is a comp tasks, then the compmaster
      * sends a msg to the pio_msg_handler running on the IO master and
@@ -513,6 +565,16 @@ int PIOc_closefile(int ncid)
         /* Delete file from our list of open files. */
         pio_delete_file_from_list(ncid);
 
+#ifdef PIO_MICRO_TIMING
+        /* Write out the micro timer logs, the logs include timing info
+         * on the variables in this file */
+        if(mtimer_flush_logs(ios->my_comm) != PIO_NOERR)
+        {
+            /* log and continue */
+            LOG((1, "Flushing micro timer logs failed"));
+        }
+#endif
+
 #ifdef TIMING
         GPTLstop("PIO:PIOc_closefile");
 #endif
@@ -534,16 +596,39 @@ int PIOc_closefile(int ncid)
 #endif
 #ifdef _NETCDF
         case PIO_IOTYPE_NETCDF:
+        case PIO_IOTYPE_NULL:
             if (ios->io_rank == 0)
                 ierr = nc_close(file->fh);
             break;
+        case PIO_IOTYPE_MEMORY:
+            ierr = nc_close(file->fh);
+            break;
 #endif
 #ifdef _PNETCDF
         case PIO_IOTYPE_PNETCDF:
+            /* The attached buffer is released from the memory
+             * statistics when the file is closed, even if the
+             * buffer of a staged file is detached later. */
+            pio_mem_account(ios, file, PIO_MEM_ATTACH, -file->mem_cur[PIO_MEM_ATTACH]);
+
+            /* Staged files are closed after draining the staged data. */
+            if (file->stage)
+            {
+                ierr = pio_stage_close(file);
+                break;
+            }
             if ((file->mode & PIO_WRITE)){
                 ierr = ncmpi_buffer_detach(file->fh);
             }
             ierr = ncmpi_close(file->fh);
+            /* Write the index of subfiled files. */
+            if (file->subfile)
+                ierr = pio_subfile_close(file, ierr);
+            break;
+#endif
+#ifdef _HDF5
+        case PIO_IOTYPE_HDF5:
+            ierr = pio_hdf5_close(file);
             break;
 #endif
         default:
@@ -567,10 +652,20 @@ int PIOc_closefile(int ncid)
     /* Delete file from our list of open files. */
     pio_delete_file_from_list(ncid);
 
+#ifdef PIO_MICRO_TIMING
+    /* Write out the micro timer logs, the logs include timing info
+     * on the variables in this file */
+    if(mtimer_flush_logs(ios->my_comm) != PIO_NOERR)
+    {
+        /* log and continue */
+        LOG((1, "Flushing micro timer logs failed"));
+    }
+#endif
+
 #ifdef TIMING
     GPTLstop("PIO:PIOc_closefile");
 #endif
-    return ierr;
+    return (ierr != PIO_NOERR) ? ierr : deferred_ierr;
 }
 
 /**
@@ -646,6 +741,56 @@ int PIOc_deletefile(int iosysid, const char *filename)
     return ierr;
 }
 
+/**
+ * Check the errors recorded with the PIO_DEFER_ERROR error handler
+ * on all tasks, since the last sync point (PIOc_enddef(),
+ * PIOc_sync(), or a previous call to this function). The recorded
+ * errors are cleared. For other error handlers errors are checked
+ * immediately and this function does nothing.
+ *
+ * This routine is called collectively by all tasks in the
+ * communicator ios.union_comm.
+ *
+ * @param ncid the ncid of the file to check.
+ * @returns PIO_NOERR if no task recorded an error, otherwise an error
+ * code recorded on one of the tasks.
+ */
+int PIOc_check_errors(int ncid)
+{
+    iosystem_desc_t *ios;  /* Pointer to io system information. */
+    file_desc_t *file;     /* Pointer to file information. */
+    int ierr = PIO_NOERR;  /* Return code from function calls. */
+
+    LOG((1, "PIOc_check_errors ncid = %d", ncid));
+
+    /* Get the file info from the ncid. */
+    if ((ierr = pio_get_file(ncid, &file)))
+    {
+        return pio_err(NULL, NULL, ierr, __FILE__, __LINE__,
+                        "Checking errors on file failed. Invalid file id (ncid=%d) provided", ncid);
+    }
+    ios = file->iosystem;
+
+    /* Nothing to check for other error handlers. */
+    if (ios->error_handler != PIO_DEFER_ERROR)
+        return PIO_NOERR;
+
+    /* If async is in use, send message to IO master tasks. */
+    if (ios->async)
+    {
+        int msg = PIO_MSG_CHECK_ERRORS;
+
+        PIO_SEND_ASYNC_MSG(ios, msg, &ierr, ncid);
+        if (ierr != PIO_NOERR)
+        {
+            return pio_err(ios, NULL, ierr, __FILE__, __LINE__,
+                            "Checking errors on file %s (ncid=%d) failed. Unable to send asynchronous message, PIO_MSG_CHECK_ERRORS, on iosystem (iosysid=%d)", pio_get_fname_from_file(file), ncid, ios->iosysid);
+        }
+    }
+
+    return pio_check_deferred_errors(file);
+}
+
 /**
  * PIO interface to nc_sync This routine is called collectively by all
  * tasks in the communicator ios.union_comm.
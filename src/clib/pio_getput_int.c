@@ -217,7 +217,13 @@ int PIOc_put_att_tc(int ncid, int varid, const char *name, nc_type atttype,
         }
 #endif /* _PNETCDF */
 
-        if (file->iotype != PIO_IOTYPE_PNETCDF && file->iotype != PIO_IOTYPE_ADIOS && file->do_io)
+#ifdef _HDF5
+        if (file->iotype == PIO_IOTYPE_HDF5)
+            ierr = pio_hdf5_put_att(file, varid, name, atttype, len, memtype, op);
+#endif /* _HDF5 */
+
+        if (file->iotype != PIO_IOTYPE_PNETCDF && file->iotype != PIO_IOTYPE_ADIOS &&
+            file->iotype != PIO_IOTYPE_HDF5 && file->do_io)
         {
             switch(memtype)
             {
@@ -272,7 +278,7 @@ int PIOc_put_att_tc(int ncid, int varid, const char *name, nc_type atttype,
         }
     }
 
-    ierr = check_netcdf(NULL, file, ierr, __FILE__, __LINE__);
+    ierr = check_netcdf_defer(file, ierr, __FILE__, __LINE__);
     if(ierr != PIO_NOERR){
         LOG((1, "nc*_put_att_* failed, ierr = %d", ierr));
         return pio_err(NULL, file, ierr, __FILE__, __LINE__,
@@ -332,6 +338,13 @@ int PIOc_get_att_tc(int ncid, int varid, const char *name, nc_type memtype, void
                         "Reading variable (%s, varid=%d) attribute (%s) failed. Invalid arguments provided, Attribute name is %s (expected not NULL), attribute data pointer is %s (expected not NULL), attribute name length = %lld (expected <= %d)", pio_get_vname_from_file(file, varid), varid, (name) ? name : "UNKNOWN", PIO_IS_NULL(name), PIO_IS_NULL(ip), (name) ? ((unsigned long long )strlen(name)) : 0, PIO_MAX_NAME);
     }
 
+    /* Files written with PIO_IOTYPE_HDF5 are write only. */
+    if (file->iotype == PIO_IOTYPE_HDF5)
+    {
+        return pio_err(ios, file, PIO_EBADIOTYPE, __FILE__, __LINE__,
+                        "Reading variable (%s, varid=%d) attribute (%s) failed. Files written with iotype %s are write only, reading attributes is not supported", pio_get_vname_from_file(file, varid), varid, name, pio_iotype_to_string(file->iotype));
+    }
+
     LOG((1, "PIOc_get_att_tc ncid %d varid %d name %s memtype %d",
          ncid, varid, name, memtype));
 
@@ -540,11 +553,13 @@ int PIOc_get_att_tc(int ncid, int varid, const char *name, nc_type memtype, void
  * read from to this type. If NC_NAT then the variable's file type
  * will be used. Use special PIO_LONG_INTERNAL for _long() functions.
  * @param buf pointer to the data to be written.
+ * @param bcast_data true to broadcast the data read to all tasks,
+ * false if the data is only required on the IO root task.
  * @return PIO_NOERR on success, error code otherwise.
  * @author Ed Hartnett
  */
-int PIOc_get_vars_tc(int ncid, int varid, const PIO_Offset *start, const PIO_Offset *count,
-                     const PIO_Offset *stride, nc_type xtype, void *buf)
+static int get_vars_tc_int(int ncid, int varid, const PIO_Offset *start, const PIO_Offset *count,
+                           const PIO_Offset *stride, nc_type xtype, void *buf, bool bcast_data)
 {
     iosystem_desc_t *ios;  /* Pointer to io system information. */
     file_desc_t *file;     /* Pointer to file information. */
@@ -580,6 +595,13 @@ int PIOc_get_vars_tc(int ncid, int varid, const PIO_Offset *start, const PIO_Off
                         "Reading variable (%s, varid=%d) from file (%s, ncid=%d) failed. The user buffer (buf) provided is NULL (expected a valid user buffer to read data)", pio_get_vname_from_file(file, varid), varid, pio_get_fname_from_file(file), ncid);
     }
 
+    /* Files written with PIO_IOTYPE_HDF5 are write only. */
+    if (file->iotype == PIO_IOTYPE_HDF5)
+    {
+        return pio_err(ios, file, PIO_EBADIOTYPE, __FILE__, __LINE__,
+                        "Reading variable (%s, varid=%d) from file (%s, ncid=%d) failed. Files written with iotype %s are write only, reading variables is not supported", pio_get_vname_from_file(file, varid), varid, pio_get_fname_from_file(file), ncid, pio_iotype_to_string(file->iotype));
+    }
+
     /* Run these on all tasks if async is not in use, but only on
      * non-IO tasks if async is in use. */
     if (!ios->async || !ios->ioproc)
@@ -699,8 +721,13 @@ int PIOc_get_vars_tc(int ncid, int varid, const PIO_Offset *start, const PIO_Off
             }
 
             /* Only the IO master does the IO, so we are not really
-             * getting parallel IO here. */
-            if (ios->iomaster == MPI_ROOT)
+             * getting parallel IO here. The data of distributed arrays
+             * in subfiled datasets is read from the subfiles. */
+            if (ios->iomaster == MPI_ROOT && pio_subfile_has_var(file, varid))
+            {
+                ierr = pio_subfile_get_vars(file, varid, start, count, stride, xtype, buf);
+            }
+            else if (ios->iomaster == MPI_ROOT)
             {
                 switch(xtype)
                 {
@@ -814,11 +841,14 @@ int PIOc_get_vars_tc(int ncid, int varid, const PIO_Offset *start, const PIO_Off
     }
 
     /* Send the data. */
-    LOG((2, "PIOc_get_vars_tc bcasting data num_elem = %d typelen = %d ios->ioroot = %d", num_elem,
-         typelen, ios->ioroot));
-    if ((mpierr = MPI_Bcast(buf, num_elem * typelen, MPI_BYTE, ios->ioroot, ios->my_comm)))
-        return check_mpi(NULL, file, mpierr, __FILE__, __LINE__);
-    LOG((2, "PIOc_get_vars_tc bcasting data complete"));
+    if (bcast_data)
+    {
+        LOG((2, "PIOc_get_vars_tc bcasting data num_elem = %d typelen = %d ios->ioroot = %d", num_elem,
+             typelen, ios->ioroot));
+        if ((mpierr = pio_bcast_large(buf, num_elem * typelen, ios->ioroot, ios->my_comm)))
+            return check_mpi(NULL, file, mpierr, __FILE__, __LINE__);
+        LOG((2, "PIOc_get_vars_tc bcasting data complete"));
+    }
 
 #ifdef TIMING
     GPTLstop("PIO:PIOc_get_vars_tc");
@@ -826,6 +856,271 @@ int PIOc_get_vars_tc(int ncid, int varid, const PIO_Offset *start, const PIO_Off
     return PIO_NOERR;
 }
 
+/**
+ * Internal PIO function which provides a type-neutral interface to
+ * nc_get_vars, the data read is broadcast to all tasks.
+ *
+ * Users should not call this function directly. Instead, call one of
+ * the derived functions, depending on the type of data you are
+ * reading, e.g. PIOc_get_vars_int().
+ *
+ * This routine is called collectively by all tasks in the
+ * communicator ios.union_comm.
+ *
+ * @param ncid identifies the netCDF file
+ * @param varid the variable ID number
+ * @param start an array of start indicies, or NULL.
+ * @param count an array of counts, or NULL.
+ * @param stride an array of strides, or NULL.
+ * @param xtype the netCDF type of the data being passed in buf.
+ * @param buf pointer to the data to be read.
+ * @return PIO_NOERR on success, error code otherwise.
+ */
+int PIOc_get_vars_tc(int ncid, int varid, const PIO_Offset *start, const PIO_Offset *count,
+                     const PIO_Offset *stride, nc_type xtype, void *buf)
+{
+    return get_vars_tc_int(ncid, varid, start, count, stride, xtype, buf, true);
+}
+
+/**
+ * Create the communicators used to share data across the tasks on
+ * each compute node, if not already created.
+ *
+ * This routine is called collectively by all tasks in the
+ * communicator ios.my_comm.
+ *
+ * @param ios pointer to the iosystem info.
+ * @return PIO_NOERR on success, error code otherwise.
+ */
+static int init_node_comms(iosystem_desc_t *ios)
+{
+    int rank, node_rank;
+    int is_ioroot, ioroot_in_node;
+    int mpierr = MPI_SUCCESS;
+
+    assert(ios);
+
+    if (ios->node_comm != MPI_COMM_NULL)
+        return PIO_NOERR;
+
+    if ((mpierr = MPI_Comm_rank(ios->my_comm, &rank)))
+        return check_mpi(ios, NULL, mpierr, __FILE__, __LINE__);
+    if ((mpierr = MPI_Comm_split_type(ios->my_comm, MPI_COMM_TYPE_SHARED, rank,
+                                      MPI_INFO_NULL, &ios->node_comm)))
+        return check_mpi(ios, NULL, mpierr, __FILE__, __LINE__);
+    if ((mpierr = MPI_Comm_rank(ios->node_comm, &node_rank)))
+        return check_mpi(ios, NULL, mpierr, __FILE__, __LINE__);
+
+    /* The roots of the nodes, in the order of the ranks in my_comm */
+    if ((mpierr = MPI_Comm_split(ios->my_comm, (node_rank == 0) ? 0 : MPI_UNDEFINED, rank,
+                                 &ios->node_roots_comm)))
+        return check_mpi(ios, NULL, mpierr, __FILE__, __LINE__);
+
+    /* Find the root of the node with the IO root */
+    is_ioroot = (rank == ios->ioroot) ? 1 : 0;
+    if ((mpierr = MPI_Allreduce(&is_ioroot, &ioroot_in_node, 1, MPI_INT, MPI_MAX, ios->node_comm)))
+        return check_mpi(ios, NULL, mpierr, __FILE__, __LINE__);
+    ios->node_roots_ioroot = -1;
+    if (ios->node_roots_comm != MPI_COMM_NULL)
+    {
+        int roots_rank;
+
+        if ((mpierr = MPI_Comm_rank(ios->node_roots_comm, &roots_rank)))
+            return check_mpi(ios, NULL, mpierr, __FILE__, __LINE__);
+        roots_rank = (ioroot_in_node) ? roots_rank : -1;
+        if ((mpierr = MPI_Allreduce(&roots_rank, &ios->node_roots_ioroot, 1, MPI_INT, MPI_MAX,
+                                    ios->node_roots_comm)))
+            return check_mpi(ios, NULL, mpierr, __FILE__, __LINE__);
+    }
+    LOG((2, "init_node_comms node_rank = %d node_roots_ioroot = %d", node_rank,
+         ios->node_roots_ioroot));
+
+    return PIO_NOERR;
+}
+
+/**
+ * Read data that is required (replicated) on all tasks into memory
+ * shared by the tasks on each compute node.
+ *
+ * PIOc_get_vars_tc() broadcasts the data read to every task, so
+ * each task holds a copy of the data. This function instead
+ * broadcasts the data once per compute node, into an MPI-3 shared
+ * memory window (MPI_Win_allocate_shared()) that is mapped by all the
+ * tasks on the node. The data is broadcast in chunks, so variables
+ * larger than 2 GB are supported.
+ *
+ * The data must not be modified by the tasks. The shared memory is
+ * freed with PIOc_free_node_shared(). This function is not supported
+ * with async I/O.
+ *
+ * This routine is called collectively by all tasks in the
+ * communicator ios.my_comm.
+ *
+ * @param ncid identifies the netCDF file
+ * @param varid the variable ID number
+ * @param start an array of start indicies (must have same number of
+ * entries as variable has dimensions). If NULL, indices of 0 will be
+ * used.
+ * @param count an array of counts (must have same number of entries
+ * as variable has dimensions). If NULL, counts matching the size of
+ * the variable will be used.
+ * @param stride an array of strides (must have same number of
+ * entries as variable has dimensions). If NULL, strides of 1 will be
+ * used.
+ * @param xtype the netCDF type of the data read. If NC_NAT then the
+ * variable's file type will be used.
+ * @param bufp pointer that gets the address of the data, in node
+ * shared memory.
+ * @param winp pointer that gets the MPI window of the shared memory.
+ * @return PIO_NOERR on success, error code otherwise.
+ */
+int PIOc_get_vars_node_shared(int ncid, int varid, const PIO_Offset *start,
+                              const PIO_Offset *count, const PIO_Offset *stride,
+                              nc_type xtype, void **bufp, MPI_Win *winp)
+{
+    iosystem_desc_t *ios;  /* Pointer to io system information. */
+    file_desc_t *file;     /* Pointer to file information. */
+    int ndims = 0;         /* The number of dimensions in the variable. */
+    PIO_Offset typelen = 0; /* Size (in bytes) of the data type of data in buf. */
+    PIO_Offset num_elem = 1; /* Number of data elements read. */
+    PIO_Offset nbytes;     /* Number of bytes read. */
+    PIO_Offset vstart[PIO_MAX_DIMS]; /* Start/count used if start/count are NULL */
+    PIO_Offset vcount[PIO_MAX_DIMS];
+    int node_rank;
+    void *baseptr;
+    MPI_Aint segsz;
+    int disp_unit;
+    int mpierr = MPI_SUCCESS;  /* Return code from MPI function codes. */
+    int ierr = PIO_NOERR;      /* Return code. */
+
+    LOG((1, "PIOc_get_vars_node_shared ncid = %d varid = %d xtype = %d", ncid, varid, xtype));
+
+    /* Find the info about this file. */
+    if ((ierr = pio_get_file(ncid, &file)))
+    {
+        return pio_err(NULL, NULL, ierr, __FILE__, __LINE__,
+                        "Reading variable (varid=%d) into node shared memory failed. Invalid file id (ncid=%d) provided", varid, ncid);
+    }
+    ios = file->iosystem;
+
+    if (!bufp || !winp)
+    {
+        return pio_err(ios, file, PIO_EINVAL, __FILE__, __LINE__,
+                        "Reading variable (%s, varid=%d) from file (%s, ncid=%d) into node shared memory failed. Invalid pointer to the shared buffer or window (NULL) provided", pio_get_vname_from_file(file, varid), varid, pio_get_fname_from_file(file), ncid);
+    }
+
+    /* The IO tasks and compute tasks do not share the same comm with async */
+    if (ios->async)
+    {
+        return pio_err(ios, file, PIO_EINVAL, __FILE__, __LINE__,
+                        "Reading variable (%s, varid=%d) from file (%s, ncid=%d) into node shared memory failed. This function is not supported with asynchronous I/O", pio_get_vname_from_file(file, varid), varid, pio_get_fname_from_file(file), ncid);
+    }
+
+    /* Find the type and size of the data. */
+    if (xtype == NC_NAT)
+    {
+        if ((ierr = PIOc_inq_vartype(ncid, varid, &xtype)))
+            return pio_err(ios, file, ierr, __FILE__, __LINE__,
+                            "Reading variable (%s, varid=%d) from file (%s, ncid=%d) into node shared memory failed. Inquiring the variable type failed", pio_get_vname_from_file(file, varid), varid, pio_get_fname_from_file(file), ncid);
+    }
+    if ((ierr = PIOc_inq_type(ncid, xtype, NULL, &typelen)))
+        return pio_err(ios, file, ierr, __FILE__, __LINE__,
+                        "Reading variable (%s, varid=%d) from file (%s, ncid=%d) into node shared memory failed. Inquiring the variable type length failed", pio_get_vname_from_file(file, varid), varid, pio_get_fname_from_file(file), ncid);
+    if ((ierr = PIOc_inq_varndims(ncid, varid, &ndims)))
+        return pio_err(ios, file, ierr, __FILE__, __LINE__,
+                        "Reading variable (%s, varid=%d) from file (%s, ncid=%d) into node shared memory failed. Inquiring the number of variable dimensions failed", pio_get_vname_from_file(file, varid), varid, pio_get_fname_from_file(file), ncid);
+
+    /* Read the whole variable if start/count is not specified. */
+    if ((ndims > 0) && (!start || !count))
+    {
+        int dimids[PIO_MAX_DIMS];
+
+        if ((ierr = PIOc_inq_vardimid(ncid, varid, dimids)))
+            return pio_err(ios, file, ierr, __FILE__, __LINE__,
+                            "Reading variable (%s, varid=%d) from file (%s, ncid=%d) into node shared memory failed. Inquiring the variable dimensions failed", pio_get_vname_from_file(file, varid), varid, pio_get_fname_from_file(file), ncid);
+        for (int d = 0; d < ndims; d++)
+        {
+            vstart[d] = (start) ? start[d] : 0;
+            if (count)
+                vcount[d] = count[d];
+            else if ((ierr = PIOc_inq_dimlen(ncid, dimids[d], &vcount[d])))
+                return pio_err(ios, file, ierr, __FILE__, __LINE__,
+                                "Reading variable (%s, varid=%d) from file (%s, ncid=%d) into node shared memory failed. Inquiring the dimension length failed", pio_get_vname_from_file(file, varid), varid, pio_get_fname_from_file(file), ncid);
+        }
+        start = vstart;
+        count = vcount;
+    }
+    for (int d = 0; d < ndims; d++)
+        num_elem *= count[d];
+    nbytes = num_elem * typelen;
+
+    if ((ierr = init_node_comms(ios)))
+        return pio_err(ios, file, ierr, __FILE__, __LINE__,
+                        "Reading variable (%s, varid=%d) from file (%s, ncid=%d) into node shared memory failed. Creating the node communicators failed", pio_get_vname_from_file(file, varid), varid, pio_get_fname_from_file(file), ncid);
+    if ((mpierr = MPI_Comm_rank(ios->node_comm, &node_rank)))
+        return check_mpi(NULL, file, mpierr, __FILE__, __LINE__);
+
+    /* The root of each node allocates the shared memory, the other
+     * tasks on the node map it. */
+    if ((mpierr = MPI_Win_allocate_shared((node_rank == 0) ? (MPI_Aint)((nbytes > 0) ? nbytes : 1) : 0,
+                                          1, MPI_INFO_NULL, ios->node_comm, &baseptr, winp)))
+        return check_mpi(NULL, file, mpierr, __FILE__, __LINE__);
+    if ((mpierr = MPI_Win_shared_query(*winp, 0, &segsz, &disp_unit, bufp)))
+        return check_mpi(NULL, file, mpierr, __FILE__, __LINE__);
+    if ((mpierr = MPI_Win_fence(0, *winp)))
+        return check_mpi(NULL, file, mpierr, __FILE__, __LINE__);
+
+    /* Read the data on the IO root, into the shared memory on its
+     * node. Other IO tasks taking part in a collective read store
+     * the same data in the shared memory on their nodes. */
+    if ((ierr = get_vars_tc_int(ncid, varid, start, count, stride, xtype, *bufp, false)))
+    {
+        MPI_Win_free(winp);
+        *bufp = NULL;
+        return pio_err(ios, file, ierr, __FILE__, __LINE__,
+                        "Reading variable (%s, varid=%d) from file (%s, ncid=%d) into node shared memory failed", pio_get_vname_from_file(file, varid), varid, pio_get_fname_from_file(file), ncid);
+    }
+    if ((mpierr = MPI_Win_fence(0, *winp)))
+        return check_mpi(NULL, file, mpierr, __FILE__, __LINE__);
+
+    /* Broadcast the data once per node */
+    if (ios->node_roots_comm != MPI_COMM_NULL)
+    {
+        LOG((2, "PIOc_get_vars_node_shared bcasting data nbytes = %lld root = %d",
+             (long long)nbytes, ios->node_roots_ioroot));
+        if ((mpierr = pio_bcast_large(*bufp, nbytes, ios->node_roots_ioroot, ios->node_roots_comm)))
+            return check_mpi(NULL, file, mpierr, __FILE__, __LINE__);
+    }
+    if ((mpierr = MPI_Win_fence(0, *winp)))
+        return check_mpi(NULL, file, mpierr, __FILE__, __LINE__);
+
+    return PIO_NOERR;
+}
+
+/**
+ * Free the node shared memory allocated by
+ * PIOc_get_vars_node_shared().
+ *
+ * This routine is called collectively by all tasks in the
+ * communicator ios.my_comm.
+ *
+ * @param winp pointer to the MPI window of the shared memory.
+ * @return PIO_NOERR on success, error code otherwise.
+ */
+int PIOc_free_node_shared(MPI_Win *winp)
+{
+    int mpierr = MPI_SUCCESS;
+
+    if (!winp)
+        return pio_err(NULL, NULL, PIO_EINVAL, __FILE__, __LINE__,
+                        "Freeing node shared memory failed. Invalid pointer to the window (NULL) provided");
+
+    if ((mpierr = MPI_Win_free(winp)))
+        return check_mpi(NULL, NULL, mpierr, __FILE__, __LINE__);
+
+    return PIO_NOERR;
+}
+
 /**
  * Get one value of a variable of any type. This is an internal
  * function.
@@ -1404,8 +1699,9 @@ int PIOc_put_vars_tc(int ncid, int varid, const PIO_Offset *start, const PIO_Off
                 pioassert(!start && !count && !stride, "expected NULLs", __FILE__, __LINE__);
 
                 /* Only the IO master does the IO, so we are not really
-                 * getting parallel IO here. */
-                if (ios->iomaster == MPI_ROOT)
+                 * getting parallel IO here. Each subfile of subfiled
+                 * files is written by the root of its group. */
+                if (file->subfile ? file->subfile->rank == 0 : ios->iomaster == MPI_ROOT)
                 {
                     switch(xtype)
                     {
@@ -1469,8 +1765,9 @@ int PIOc_put_vars_tc(int ncid, int varid, const PIO_Offset *start, const PIO_Off
                 else
                     fake_stride = (PIO_Offset *)stride;
 
-                /* Only the IO master actually does the call. */
-                if (ios->iomaster == MPI_ROOT)
+                /* Only the IO master actually does the call (the root
+                 * of each group for subfiled files). */
+                if (file->subfile ? file->subfile->rank == 0 : ios->iomaster == MPI_ROOT)
                 {
                     switch(xtype)
                     {
@@ -1522,7 +1819,16 @@ int PIOc_put_vars_tc(int ncid, int varid, const PIO_Offset *start, const PIO_Off
         }
 #endif /* _PNETCDF */
 
-        if (file->iotype != PIO_IOTYPE_PNETCDF && file->iotype != PIO_IOTYPE_ADIOS && file->do_io)
+#ifdef _HDF5
+        if (file->iotype == PIO_IOTYPE_HDF5)
+        {
+            LOG((2, "PIOc_put_vars_tc calling pio_hdf5_put_vars"));
+            ierr = pio_hdf5_put_vars(file, varid, start, count, stride, xtype, buf);
+        }
+#endif /* _HDF5 */
+
+        if (file->iotype != PIO_IOTYPE_PNETCDF && file->iotype != PIO_IOTYPE_ADIOS &&
+            file->iotype != PIO_IOTYPE_HDF5 && file->do_io)
         {
             LOG((2, "PIOc_put_vars_tc calling netcdf function file->iotype = %d",
                  file->iotype));
@@ -1592,7 +1898,7 @@ int PIOc_put_vars_tc(int ncid, int varid, const PIO_Offset *start, const PIO_Off
         }
     }
 
-    ierr = check_netcdf(NULL, file, ierr, __FILE__, __LINE__);
+    ierr = check_netcdf_defer(file, ierr, __FILE__, __LINE__);
     if(ierr != PIO_NOERR){
         LOG((1, "nc*_put_vars_* failed, ierr = %d", ierr));
         return pio_err(NULL, file, ierr, __FILE__, __LINE__,
@@ -0,0 +1,1447 @@
+/**
+ * @file
+ * Writing netCDF-4 files directly with the HDF5 library
+ * (PIO_IOTYPE_HDF5).
+ *
+ * The netCDF-4 library adds a noticeable overhead to each call when
+ * writing in parallel (every nc_put_vara() call is a separate
+ * collective H5Dwrite() and the metadata is updated on every
+ * call). With PIO_IOTYPE_HDF5 the IO tasks call the HDF5 library
+ * directly,
+ * - all the I/O regions of a variable written with
+ *   PIOc_write_darray() are combined into one hyperslab selection
+ *   and written with a single collective H5Dwrite().
+ * - the alignment, metadata block size and chunk cache of the files
+ *   can be set (PIOc_set_hdf5_props(), PIOc_set_chunk_cache()) and
+ *   the metadata is read and written collectively.
+ *
+ * The files are written in the netCDF-4 format (the dimensions are
+ * stored as HDF5 dimension scales, the _FillValue and the other
+ * attributes as HDF5 attributes) so they can be read with the
+ * netCDF library, and with the PIO_IOTYPE_NETCDF4P/NETCDF4C
+ * iotypes. The iotype is write only.
+ *
+ * The metadata (dims, vars, atts) of the file is kept in memory on
+ * the IO tasks, the datasets are created when the file leaves define
+ * mode. Attributes of variables are cached until the dataset of the
+ * variable is created.
+ */
+#include <pio_config.h>
+#include <pio.h>
+#include <pio_internal.h>
+
+#ifdef _HDF5
+
+/** Name of the attribute, used by netCDF-4, that stores the
+ * dimension id of a dimension scale. */
+#define HDF5_DIMID_ATT_NAME "_Netcdf4Dimid"
+
+/** Name used, by netCDF-4, for dimension scales of dimensions that
+ * are not netCDF variables. */
+#define HDF5_DIM_WITHOUT_VAR "This is a netCDF dimension but not a netCDF variable."
+
+/** Maximum size, in bytes, of the chunks of record variables. */
+#define HDF5_MAX_CHUNK_SIZE (4 * 1024 * 1024)
+
+/** Chunk size (number of elements) of dimension scales of
+ * unlimited dimensions. */
+#define HDF5_DIM_CHUNK_LEN 1024
+
+/**
+ * Get the HDF5 type for a netCDF type. The returned type is a copy
+ * that must be closed, with H5Tclose(), by the caller.
+ *
+ * @param xtype the netCDF type (or PIO_LONG_INTERNAL).
+ * @param len number of characters for strings (NC_CHAR), ignored
+ * for other types.
+ * @returns the HDF5 type id, a negative value on error.
+ */
+static hid_t hdf5_type(nc_type xtype, PIO_Offset len)
+{
+    hid_t tid;
+
+    switch (xtype)
+    {
+    case NC_BYTE:
+        return H5Tcopy(H5T_NATIVE_SCHAR);
+    case NC_UBYTE:
+        return H5Tcopy(H5T_NATIVE_UCHAR);
+    case NC_SHORT:
+        return H5Tcopy(H5T_NATIVE_SHORT);
+    case NC_USHORT:
+        return H5Tcopy(H5T_NATIVE_USHORT);
+    case NC_INT:
+        return H5Tcopy(H5T_NATIVE_INT);
+    case NC_UINT:
+        return H5Tcopy(H5T_NATIVE_UINT);
+    case NC_INT64:
+        return H5Tcopy(H5T_NATIVE_LLONG);
+    case NC_UINT64:
+        return H5Tcopy(H5T_NATIVE_ULLONG);
+    case NC_FLOAT:
+        return H5Tcopy(H5T_NATIVE_FLOAT);
+    case NC_DOUBLE:
+        return H5Tcopy(H5T_NATIVE_DOUBLE);
+    case PIO_LONG_INTERNAL:
+        return H5Tcopy(H5T_NATIVE_LONG);
+    case NC_CHAR:
+        /* netCDF-4 stores chars as null terminated strings. */
+        if ((tid = H5Tcopy(H5T_C_S1)) < 0)
+            return tid;
+        if (H5Tset_size(tid, (len > 0) ? (size_t)len : 1) < 0 ||
+            H5Tset_strpad(tid, H5T_STR_NULLTERM) < 0)
+        {
+            H5Tclose(tid);
+            return -1;
+        }
+        return tid;
+    default:
+        return -1;
+    }
+}
+
+/**
+ * Get the default (netCDF) fill value of a type.
+ *
+ * @param xtype the netCDF type.
+ * @param fillp pointer to a buffer (8 bytes) that gets the fill
+ * value.
+ * @returns 0 for success, error code otherwise.
+ */
+static int hdf5_default_fill(nc_type xtype, void *fillp)
+{
+    switch (xtype)
+    {
+    case NC_BYTE:
+        *(signed char *)fillp = PIO_FILL_BYTE;
+        break;
+    case NC_CHAR:
+        *(char *)fillp = PIO_FILL_CHAR;
+        break;
+    case NC_SHORT:
+        *(short *)fillp = PIO_FILL_SHORT;
+        break;
+    case NC_INT:
+        *(int *)fillp = PIO_FILL_INT;
+        break;
+    case NC_FLOAT:
+        *(float *)fillp = PIO_FILL_FLOAT;
+        break;
+    case NC_DOUBLE:
+        *(double *)fillp = PIO_FILL_DOUBLE;
+        break;
+    case NC_UBYTE:
+        *(unsigned char *)fillp = PIO_FILL_UBYTE;
+        break;
+    case NC_USHORT:
+        *(unsigned short *)fillp = PIO_FILL_USHORT;
+        break;
+    case NC_UINT:
+        *(unsigned int *)fillp = PIO_FILL_UINT;
+        break;
+    case NC_INT64:
+        *(long long *)fillp = PIO_FILL_INT64;
+        break;
+    case NC_UINT64:
+        *(unsigned long long *)fillp = PIO_FILL_UINT64;
+        break;
+    default:
+        return PIO_EBADTYPE;
+    }
+
+    return PIO_NOERR;
+}
+
+/**
+ * Write an attribute to an HDF5 object, replacing the attribute if
+ * it already exists.
+ *
+ * @param loc the HDF5 object (the file for global attributes).
+ * @param name the name of the attribute.
+ * @param atttype the netCDF type of the attribute.
+ * @param len the number of elements in the attribute.
+ * @param memtype the type of the value in memory.
+ * @param op pointer to the value.
+ * @returns 0 for success, error code otherwise.
+ */
+static int hdf5_write_att(hid_t loc, const char *name, nc_type atttype, PIO_Offset len,
+                          nc_type memtype, const void *op)
+{
+    hid_t ftid = -1, mtid = -1, sid = -1, aid = -1;
+    htri_t exists;
+    int ierr = PIO_EHDF5ERR;
+
+    /* Char attributes are scalar strings of len characters, like in
+     * netCDF-4. */
+    if (len == 0)
+        sid = H5Screate(H5S_NULL);
+    else if (atttype == NC_CHAR)
+        sid = H5Screate(H5S_SCALAR);
+    else
+    {
+        hsize_t dims[1] = {(hsize_t)len};
+        sid = H5Screate_simple(1, dims, NULL);
+    }
+
+    if (sid >= 0 && (ftid = hdf5_type(atttype, len)) >= 0 &&
+        (mtid = hdf5_type(memtype, len)) >= 0 &&
+        (exists = H5Aexists(loc, name)) >= 0 &&
+        (!exists || H5Adelete(loc, name) >= 0) &&
+        (aid = H5Acreate2(loc, name, ftid, sid, H5P_DEFAULT, H5P_DEFAULT)) >= 0 &&
+        (len == 0 || H5Awrite(aid, mtid, op) >= 0))
+        ierr = PIO_NOERR;
+
+    if (aid >= 0)
+        H5Aclose(aid);
+    if (mtid >= 0)
+        H5Tclose(mtid);
+    if (ftid >= 0)
+        H5Tclose(ftid);
+    if (sid >= 0)
+        H5Sclose(sid);
+
+    return ierr;
+}
+
+/**
+ * Write the id of a dimension, as netCDF-4 does, to its dimension
+ * scale.
+ *
+ * @param dsid the dimension scale dataset.
+ * @param dimid the dimension id.
+ * @returns 0 for success, error code otherwise.
+ */
+static int hdf5_write_dimid(hid_t dsid, int dimid)
+{
+    return hdf5_write_att(dsid, HDF5_DIMID_ATT_NAME, NC_INT, 1, NC_INT, &dimid);
+}
+
+/**
+ * Get the size, in bytes, of a netCDF type in memory.
+ *
+ * @param xtype the netCDF type (or PIO_LONG_INTERNAL).
+ * @returns the size of the type, 0 on error.
+ */
+static size_t hdf5_type_size(nc_type xtype)
+{
+    hid_t tid;
+    size_t size;
+
+    if ((tid = hdf5_type(xtype, 1)) < 0)
+        return 0;
+    size = H5Tget_size(tid);
+    H5Tclose(tid);
+
+    return size;
+}
+
+/**
+ * Make sure an array has room for one more element.
+ *
+ * @param arrp pointer to the array.
+ * @param szp pointer to the number of elements allocated.
+ * @param n the number of elements used.
+ * @param elsize the size of an element.
+ * @returns 0 for success, error code otherwise.
+ */
+static int hdf5_grow(void **arrp, int *szp, int n, size_t elsize)
+{
+    if (n >= *szp)
+    {
+        int sz = (*szp > 0) ? 2 * (*szp) : 16;
+        void *arr;
+
+        if (!(arr = realloc(*arrp, sz * elsize)))
+            return PIO_ENOMEM;
+        *arrp = arr;
+        *szp = sz;
+    }
+
+    return PIO_NOERR;
+}
+
+/**
+ * Get the current length of a dimension. The length of an unlimited
+ * dimension is the number of records written to the variables using
+ * it.
+ *
+ * @param h5 pointer to the HDF5 info of the file.
+ * @param dimid the dimension id.
+ * @returns the length of the dimension.
+ */
+static PIO_Offset hdf5_dim_len(hdf5_file_desc_t *h5, int dimid)
+{
+    PIO_Offset len = 0;
+
+    if (h5->dims[dimid].len != PIO_UNLIMITED)
+        return h5->dims[dimid].len;
+
+    for (int v = 0; v < h5->nvars; v++)
+        if (h5->vars[v].ndims > 0 && h5->vars[v].dimids[0] == dimid && h5->vars[v].nrecs > len)
+            len = h5->vars[v].nrecs;
+
+    return len;
+}
+
+/**
+ * Extend the record dimension of a record variable. Collective on
+ * the IO tasks.
+ *
+ * @param h5 pointer to the HDF5 info of the file.
+ * @param hvar pointer to the variable.
+ * @param nrecs the number of records needed.
+ * @returns 0 for success, error code otherwise.
+ */
+static int hdf5_extend_recs(hdf5_file_desc_t *h5, hdf5_var_desc_t *hvar, PIO_Offset nrecs)
+{
+    hsize_t dims[PIO_MAX_DIMS];
+
+    if (hvar->ndims == 0 || h5->dims[hvar->dimids[0]].len != PIO_UNLIMITED || nrecs <= hvar->nrecs)
+        return PIO_NOERR;
+
+    dims[0] = (hsize_t)nrecs;
+    for (int i = 1; i < hvar->ndims; i++)
+        dims[i] = (hsize_t)h5->dims[hvar->dimids[i]].len;
+    if (H5Dset_extent(hvar->dsid, dims) < 0)
+        return PIO_EHDF5ERR;
+    hvar->nrecs = nrecs;
+
+    return PIO_NOERR;
+}
+
+/**
+ * Set the extents of the dimension scales of unlimited dimensions,
+ * that are not variables, to the current lengths of the dimensions.
+ * Collective on the IO tasks.
+ *
+ * @param h5 pointer to the HDF5 info of the file.
+ * @returns 0 for success, error code otherwise.
+ */
+static int hdf5_sync_dim_lens(hdf5_file_desc_t *h5)
+{
+    for (int d = 0; d < h5->ndims; d++)
+    {
+        hdf5_dim_desc_t *hdim = &h5->dims[d];
+        hsize_t cur, len;
+        hid_t sid;
+        int ret;
+
+        if (hdim->len != PIO_UNLIMITED || hdim->coord_varid >= 0 || hdim->dsid < 0)
+            continue;
+
+        len = (hsize_t)hdf5_dim_len(h5, d);
+        if ((sid = H5Dget_space(hdim->dsid)) < 0)
+            return PIO_EHDF5ERR;
+        ret = H5Sget_simple_extent_dims(sid, &cur, NULL);
+        H5Sclose(sid);
+        if (ret < 0 || (cur != len && H5Dset_extent(hdim->dsid, &len) < 0))
+            return PIO_EHDF5ERR;
+    }
+
+    return PIO_NOERR;
+}
+
+/**
+ * Create a file with PIO_IOTYPE_HDF5. Called on all the IO tasks.
+ *
+ * @param file pointer to the file_desc_t of the file, the iosystem
+ * and mode must be set.
+ * @param filename the name of the file.
+ * @returns 0 for success, error code otherwise.
+ */
+int pio_hdf5_create(file_desc_t *file, const char *filename)
+{
+    iosystem_desc_t *ios;
+    hdf5_file_desc_t *h5;
+    hid_t fapl = -1, fcpl = -1;
+    unsigned flags = (file->mode & PIO_NOCLOBBER) ? H5F_ACC_EXCL : H5F_ACC_TRUNC;
+    int ierr = PIO_NOERR;
+
+    pioassert(file && file->iosystem && filename, "invalid input", __FILE__, __LINE__);
+    ios = file->iosystem;
+
+    if (!(h5 = calloc(1, sizeof(hdf5_file_desc_t))))
+        return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
+                        "Creating file (%s) using PIO_IOTYPE_HDF5 iotype failed. Out of memory allocating %lld bytes for the file info", filename, (long long int)sizeof(hdf5_file_desc_t));
+    h5->fid = -1;
+    h5->dxplid_coll = -1;
+    h5->in_define_mode = 1;
+    /* Like PnetCDF files, the variables are not filled by default. */
+    h5->fill_mode = NC_NOFILL;
+
+    /* File access properties: MPI-IO on the IO tasks, collective
+     * metadata operations, alignment, metadata aggregation and the
+     * chunk cache. */
+    if ((fapl = H5Pcreate(H5P_FILE_ACCESS)) < 0 ||
+        H5Pset_fapl_mpio(fapl, ios->io_comm, ios->info) < 0)
+        ierr = PIO_EHDF5ERR;
+#if H5_VERSION_GE(1, 10, 0)
+    if (!ierr && (H5Pset_all_coll_metadata_ops(fapl, 1) < 0 ||
+                  H5Pset_coll_metadata_write(fapl, 1) < 0))
+        ierr = PIO_EHDF5ERR;
+#endif
+    if (!ierr && ios->hdf5_alignment > 0 &&
+        H5Pset_alignment(fapl, (hsize_t)ios->hdf5_align_threshold, (hsize_t)ios->hdf5_alignment) < 0)
+        ierr = PIO_EHDF5ERR;
+    if (!ierr && ios->hdf5_meta_block_size > 0 &&
+        H5Pset_meta_block_size(fapl, (hsize_t)ios->hdf5_meta_block_size) < 0)
+        ierr = PIO_EHDF5ERR;
+    if (!ierr && ios->hdf5_chunk_cache_size > 0 &&
+        H5Pset_cache(fapl, 0, (size_t)ios->hdf5_chunk_cache_nelems, (size_t)ios->hdf5_chunk_cache_size,
+                     (double)ios->hdf5_chunk_cache_preemption) < 0)
+        ierr = PIO_EHDF5ERR;
+
+    /* netCDF-4 tracks the creation order of links and attributes. */
+    if (!ierr && ((fcpl = H5Pcreate(H5P_FILE_CREATE)) < 0 ||
+                  H5Pset_link_creation_order(fcpl, H5P_CRT_ORDER_TRACKED | H5P_CRT_ORDER_INDEXED) < 0 ||
+                  H5Pset_attr_creation_order(fcpl, H5P_CRT_ORDER_TRACKED | H5P_CRT_ORDER_INDEXED) < 0))
+        ierr = PIO_EHDF5ERR;
+
+    if (!ierr && (h5->fid = H5Fcreate(filename, flags, fcpl, fapl)) < 0)
+        ierr = PIO_EHDF5ERR;
+
+    if (!ierr && ((h5->dxplid_coll = H5Pcreate(H5P_DATASET_XFER)) < 0 ||
+                  H5Pset_dxpl_mpio(h5->dxplid_coll, H5FD_MPIO_COLLECTIVE) < 0))
+        ierr = PIO_EHDF5ERR;
+
+    if (fcpl >= 0)
+        H5Pclose(fcpl);
+    if (fapl >= 0)
+        H5Pclose(fapl);
+
+    if (ierr)
+    {
+        if (h5->dxplid_coll >= 0)
+            H5Pclose(h5->dxplid_coll);
+        if (h5->fid >= 0)
+            H5Fclose(h5->fid);
+        free(h5);
+        return pio_err(ios, NULL, ierr, __FILE__, __LINE__,
+                        "Creating file (%s) using PIO_IOTYPE_HDF5 iotype failed. Creating the file with the HDF5 library failed", filename);
+    }
+    file->hdf5 = h5;
+
+    return PIO_NOERR;
+}
+
+/**
+ * Define a dimension in a file written with PIO_IOTYPE_HDF5. Called
+ * on all the IO tasks.
+ *
+ * @param file pointer to the file_desc_t of the file.
+ * @param name the name of the dimension.
+ * @param len the length of the dimension, PIO_UNLIMITED for an
+ * unlimited dimension.
+ * @param idp pointer that gets the id of the dimension.
+ * @returns 0 for success, error code otherwise.
+ */
+int pio_hdf5_def_dim(file_desc_t *file, const char *name, PIO_Offset len, int *idp)
+{
+    hdf5_file_desc_t *h5 = file->hdf5;
+    hdf5_dim_desc_t *hdim;
+
+    if (!h5->in_define_mode)
+        return PIO_ENOTINDEFINE;
+    if (strlen(name) > PIO_MAX_NAME)
+        return PIO_EMAXNAME;
+    for (int d = 0; d < h5->ndims; d++)
+        if (!strcmp(h5->dims[d].name, name))
+            return PIO_ENAMEINUSE;
+    if (hdf5_grow((void **)&h5->dims, &h5->dims_sz, h5->ndims, sizeof(hdf5_dim_desc_t)))
+        return PIO_ENOMEM;
+
+    hdim = &h5->dims[h5->ndims];
+    strcpy(hdim->name, name);
+    hdim->len = len;
+    hdim->dsid = -1;
+    hdim->coord_varid = -1;
+    if (idp)
+        *idp = h5->ndims;
+    h5->ndims++;
+
+    return PIO_NOERR;
+}
+
+/**
+ * Define a variable in a file written with PIO_IOTYPE_HDF5. Called
+ * on all the IO tasks. The dataset of the variable is created when
+ * the file leaves define mode.
+ *
+ * @param file pointer to the file_desc_t of the file.
+ * @param name the name of the variable.
+ * @param xtype the type of the variable.
+ * @param ndims the number of dimensions of the variable.
+ * @param dimids the dimension ids of the variable.
+ * @param varidp pointer that gets the id of the variable.
+ * @returns 0 for success, error code otherwise.
+ */
+int pio_hdf5_def_var(file_desc_t *file, const char *name, nc_type xtype, int ndims,
+                     const int *dimids, int *varidp)
+{
+    hdf5_file_desc_t *h5 = file->hdf5;
+    hdf5_var_desc_t *hvar;
+    char fill[8];
+    int coord_dimid = -1;
+
+    if (!h5->in_define_mode)
+        return PIO_ENOTINDEFINE;
+    if (strlen(name) > PIO_MAX_NAME)
+        return PIO_EMAXNAME;
+    if (hdf5_default_fill(xtype, fill))
+        return PIO_EBADTYPE;
+    if (ndims < 0 || ndims > PIO_MAX_DIMS)
+        return PIO_EINVAL;
+    for (int i = 0; i < ndims; i++)
+    {
+        if (dimids[i] < 0 || dimids[i] >= h5->ndims)
+            return PIO_EBADDIM;
+        if (i > 0 && h5->dims[dimids[i]].len == PIO_UNLIMITED)
+            return PIO_EUNLIMPOS;
+    }
+    for (int v = 0; v < h5->nvars; v++)
+        if (!strcmp(h5->vars[v].name, name))
+            return PIO_ENAMEINUSE;
+
+    /* A variable with the name of a dimension must be the coordinate
+     * variable of the dimension, its dataset is the dimension
+     * scale. */
+    for (int d = 0; d < h5->ndims; d++)
+    {
+        if (!strcmp(h5->dims[d].name, name))
+        {
+            if (ndims != 1 || dimids[0] != d || h5->dims[d].dsid >= 0)
+                return PIO_ENAMEINUSE;
+            coord_dimid = d;
+        }
+    }
+
+    if (hdf5_grow((void **)&h5->vars, &h5->vars_sz, h5->nvars, sizeof(hdf5_var_desc_t)))
+        return PIO_ENOMEM;
+    hvar = &h5->vars[h5->nvars];
+    memset(hvar, 0, sizeof(hdf5_var_desc_t));
+    if (ndims > 0)
+    {
+        if (!(hvar->dimids = malloc(ndims * sizeof(int))))
+            return PIO_ENOMEM;
+        memcpy(hvar->dimids, dimids, ndims * sizeof(int));
+    }
+    strcpy(hvar->name, name);
+    hvar->xtype = xtype;
+    hvar->ndims = ndims;
+    hvar->fill_mode = h5->fill_mode;
+    hvar->dsid = -1;
+
+    if (coord_dimid >= 0)
+        h5->dims[coord_dimid].coord_varid = h5->nvars;
+    if (varidp)
+        *varidp = h5->nvars;
+    h5->nvars++;
+
+    return PIO_NOERR;
+}
+
+/**
+ * Set the fill mode of a file written with PIO_IOTYPE_HDF5. As with
+ * netCDF-4, the fill mode applies to the variables defined later.
+ *
+ * @param file pointer to the file_desc_t of the file.
+ * @param fillmode NC_FILL or NC_NOFILL.
+ * @param old_modep pointer that gets the old fill mode, ignored if
+ * NULL.
+ * @returns 0 for success, error code otherwise.
+ */
+int pio_hdf5_set_fill(file_desc_t *file, int fillmode, int *old_modep)
+{
+    hdf5_file_desc_t *h5 = file->hdf5;
+
+    if (fillmode != NC_FILL && fillmode != NC_NOFILL)
+        return PIO_EINVAL;
+    if (old_modep)
+        *old_modep = h5->fill_mode;
+    h5->fill_mode = fillmode;
+
+    return PIO_NOERR;
+}
+
+/**
+ * Write an attribute to a file written with PIO_IOTYPE_HDF5. Called
+ * on all the IO tasks. Attributes of variables are cached until the
+ * dataset of the variable is created. The _FillValue attribute also
+ * sets the fill value of the variable.
+ *
+ * @param file pointer to the file_desc_t of the file.
+ * @param varid the variable id, PIO_GLOBAL for global attributes.
+ * @param name the name of the attribute.
+ * @param atttype the type of the attribute.
+ * @param len the number of elements in the attribute.
+ * @param memtype the type of the value in op.
+ * @param op pointer to the value.
+ * @returns 0 for success, error code otherwise.
+ */
+int pio_hdf5_put_att(file_desc_t *file, int varid, const char *name, nc_type atttype,
+                     PIO_Offset len, nc_type memtype, const void *op)
+{
+    hdf5_file_desc_t *h5 = file->hdf5;
+    hdf5_var_desc_t *hvar;
+    hdf5_att_desc_t *att, **attp;
+    size_t msize;
+    htri_t exists;
+
+    if (varid != PIO_GLOBAL && (varid < 0 || varid >= h5->nvars))
+        return PIO_ENOTVAR;
+    if (strlen(name) > PIO_MAX_NAME)
+        return PIO_EMAXNAME;
+    if ((atttype == NC_CHAR) != (memtype == NC_CHAR))
+        return PIO_ECHAR;
+    if (!(msize = hdf5_type_size(memtype)) || !hdf5_type_size(atttype))
+        return PIO_EBADTYPE;
+
+    if (varid == PIO_GLOBAL)
+    {
+        if ((exists = H5Aexists(h5->fid, name)) < 0)
+            return PIO_EHDF5ERR;
+        if (!exists)
+            h5->ngatts++;
+        return hdf5_write_att(h5->fid, name, atttype, len, memtype, op);
+    }
+    hvar = &h5->vars[varid];
+
+    if (!strcmp(name, "_FillValue"))
+    {
+        char fill[8];
+
+        if (atttype != hvar->xtype)
+            return PIO_EBADTYPE;
+        if (len != 1)
+            return PIO_EINVAL;
+        if (hvar->dsid >= 0)
+            return PIO_ELATEFILL;
+
+        /* Keep the fill value in the type of the variable. */
+        memcpy(fill, op, msize);
+        if (memtype != atttype)
+        {
+            hid_t mtid = hdf5_type(memtype, 1);
+            hid_t ftid = hdf5_type(atttype, 1);
+            herr_t ret = H5Tconvert(mtid, ftid, 1, fill, NULL, H5P_DEFAULT);
+
+            H5Tclose(mtid);
+            H5Tclose(ftid);
+            if (ret < 0)
+                return PIO_ERANGE;
+        }
+        memcpy(hvar->fill_value, fill, sizeof(fill));
+        hvar->fill_set = 1;
+    }
+
+    if (hvar->dsid >= 0)
+    {
+        if ((exists = H5Aexists(hvar->dsid, name)) < 0)
+            return PIO_EHDF5ERR;
+        if (!exists)
+            hvar->natts++;
+        return hdf5_write_att(hvar->dsid, name, atttype, len, memtype, op);
+    }
+
+    /* Cache the attribute, replacing the value of an attribute
+     * written earlier. */
+    for (attp = &hvar->atts; *attp; attp = &(*attp)->next)
+        if (!strcmp((*attp)->name, name))
+            break;
+    if (!(att = *attp))
+    {
+        if (!(att = calloc(1, sizeof(hdf5_att_desc_t))))
+            return PIO_ENOMEM;
+        strcpy(att->name, name);
+        *attp = att;
+        hvar->natts++;
+    }
+    free(att->value);
+    att->value = NULL;
+    if (len > 0)
+    {
+        if (!(att->value = malloc(len * msize)))
+            return PIO_ENOMEM;
+        memcpy(att->value, op, len * msize);
+    }
+    att->xtype = atttype;
+    att->len = len;
+    att->memtype = memtype;
+
+    return PIO_NOERR;
+}
+
+/**
+ * Set the fill mode and fill value of a variable in a file written
+ * with PIO_IOTYPE_HDF5.
+ *
+ * @param file pointer to the file_desc_t of the file.
+ * @param varid the variable id.
+ * @param no_fill non-zero to turn off filling of the variable.
+ * @param fill_valuep pointer to the fill value, in the type of the
+ * variable, ignored if NULL.
+ * @returns 0 for success, error code otherwise.
+ */
+int pio_hdf5_def_var_fill(file_desc_t *file, int varid, int no_fill, const void *fill_valuep)
+{
+    hdf5_file_desc_t *h5 = file->hdf5;
+    hdf5_var_desc_t *hvar;
+
+    if (varid < 0 || varid >= h5->nvars)
+        return PIO_ENOTVAR;
+    hvar = &h5->vars[varid];
+    if (hvar->dsid >= 0)
+        return PIO_ELATEFILL;
+
+    hvar->fill_mode = no_fill ? NC_NOFILL : NC_FILL;
+    if (fill_valuep)
+        return pio_hdf5_put_att(file, varid, "_FillValue", hvar->xtype, 1, hvar->xtype, fill_valuep);
+
+    return PIO_NOERR;
+}
+
+/**
+ * Create the dataset of a variable. Collective on the IO tasks.
+ *
+ * Record variables are chunked, one record per chunk, the chunks
+ * are split along the largest dimensions until they are smaller
+ * than HDF5_MAX_CHUNK_SIZE bytes. Other variables are contiguous.
+ *
+ * @param h5 pointer to the HDF5 info of the file.
+ * @param varid the variable id.
+ * @returns 0 for success, error code otherwise.
+ */
+static int hdf5_create_var(hdf5_file_desc_t *h5, int varid)
+{
+    hdf5_var_desc_t *hvar = &h5->vars[varid];
+    hsize_t dims[PIO_MAX_DIMS], maxdims[PIO_MAX_DIMS], chunk[PIO_MAX_DIMS];
+    hid_t tid = -1, sid = -1, dcpl = -1;
+    char fill[8];
+    int is_rec = (hvar->ndims > 0 && h5->dims[hvar->dimids[0]].len == PIO_UNLIMITED);
+    int ierr = PIO_EHDF5ERR;
+
+    for (int i = 0; i < hvar->ndims; i++)
+    {
+        PIO_Offset len = h5->dims[hvar->dimids[i]].len;
+
+        dims[i] = (len == PIO_UNLIMITED) ? 0 : (hsize_t)len;
+        maxdims[i] = (len == PIO_UNLIMITED) ? H5S_UNLIMITED : (hsize_t)len;
+        chunk[i] = (len == PIO_UNLIMITED || len == 0) ? 1 : (hsize_t)len;
+    }
+
+    if (hvar->fill_set)
+        memcpy(fill, hvar->fill_value, sizeof(fill));
+    else
+        hdf5_default_fill(hvar->xtype, fill);
+
+    if ((tid = hdf5_type(hvar->xtype, 1)) >= 0 &&
+        (sid = (hvar->ndims > 0) ? H5Screate_simple(hvar->ndims, dims, maxdims) : H5Screate(H5S_SCALAR)) >= 0 &&
+        (dcpl = H5Pcreate(H5P_DATASET_CREATE)) >= 0 &&
+        H5Pset_attr_creation_order(dcpl, H5P_CRT_ORDER_TRACKED | H5P_CRT_ORDER_INDEXED) >= 0 &&
+        H5Pset_fill_value(dcpl, tid, fill) >= 0 &&
+        (hvar->fill_mode == NC_FILL || H5Pset_fill_time(dcpl, H5D_FILL_TIME_NEVER) >= 0))
+    {
+        ierr = PIO_NOERR;
+        if (is_rec)
+        {
+            size_t tsize = H5Tget_size(tid);
+
+            for (;;)
+            {
+                hsize_t nbytes = tsize;
+                int maxd = 0;
+
+                for (int i = 0; i < hvar->ndims; i++)
+                {
+                    nbytes *= chunk[i];
+                    if (chunk[i] > chunk[maxd])
+                        maxd = i;
+                }
+                if (nbytes <= HDF5_MAX_CHUNK_SIZE || chunk[maxd] == 1)
+                    break;
+                chunk[maxd] = (chunk[maxd] + 1) / 2;
+            }
+            if (H5Pset_chunk(dcpl, hvar->ndims, chunk) < 0)
+                ierr = PIO_EHDF5ERR;
+        }
+        if (!ierr && (hvar->dsid = H5Dcreate2(h5->fid, hvar->name, tid, sid, H5P_DEFAULT,
+                                              dcpl, H5P_DEFAULT)) < 0)
+            ierr = PIO_EHDF5ERR;
+    }
+
+    if (dcpl >= 0)
+        H5Pclose(dcpl);
+    if (sid >= 0)
+        H5Sclose(sid);
+    if (tid >= 0)
+        H5Tclose(tid);
+    if (ierr)
+        return ierr;
+
+    /* The dataset of a coordinate variable is the dimension scale. */
+    if (hvar->ndims == 1 && h5->dims[hvar->dimids[0]].coord_varid == varid)
+    {
+        h5->dims[hvar->dimids[0]].dsid = hvar->dsid;
+        if (H5DSset_scale(hvar->dsid, hvar->name) < 0 ||
+            hdf5_write_dimid(hvar->dsid, hvar->dimids[0]))
+            return PIO_EHDF5ERR;
+    }
+
+    /* Write the cached attributes. */
+    while (hvar->atts)
+    {
+        hdf5_att_desc_t *att = hvar->atts;
+
+        ierr = hdf5_write_att(hvar->dsid, att->name, att->xtype, att->len, att->memtype, att->value);
+        hvar->atts = att->next;
+        free(att->value);
+        free(att);
+        if (ierr)
+            return ierr;
+    }
+
+    return PIO_NOERR;
+}
+
+/**
+ * Create the dimension scale of a dimension that is not a
+ * variable, as netCDF-4 does. Collective on the IO tasks.
+ *
+ * @param h5 pointer to the HDF5 info of the file.
+ * @param dimid the dimension id.
+ * @returns 0 for success, error code otherwise.
+ */
+static int hdf5_create_dim(hdf5_file_desc_t *h5, int dimid)
+{
+    hdf5_dim_desc_t *hdim = &h5->dims[dimid];
+    int unlim = (hdim->len == PIO_UNLIMITED);
+    hsize_t dims[1] = {unlim ? 0 : (hsize_t)hdim->len};
+    hsize_t maxdims[1] = {unlim ? H5S_UNLIMITED : (hsize_t)hdim->len};
+    hsize_t chunk[1] = {HDF5_DIM_CHUNK_LEN};
+    char dimscale_name[PIO_MAX_NAME + 1];
+    hid_t sid = -1, dcpl = -1;
+    int ierr = PIO_EHDF5ERR;
+
+    snprintf(dimscale_name, sizeof(dimscale_name), "%s%10d", HDF5_DIM_WITHOUT_VAR,
+             unlim ? 0 : (int)hdim->len);
+
+    if ((sid = H5Screate_simple(1, dims, maxdims)) >= 0 &&
+        (dcpl = H5Pcreate(H5P_DATASET_CREATE)) >= 0 &&
+        H5Pset_attr_creation_order(dcpl, H5P_CRT_ORDER_TRACKED | H5P_CRT_ORDER_INDEXED) >= 0 &&
+        (!unlim || H5Pset_chunk(dcpl, 1, chunk) >= 0) &&
+        (hdim->dsid = H5Dcreate2(h5->fid, hdim->name, H5T_IEEE_F32BE, sid, H5P_DEFAULT,
+                                 dcpl, H5P_DEFAULT)) >= 0 &&
+        H5DSset_scale(hdim->dsid, dimscale_name) >= 0 &&
+        !hdf5_write_dimid(hdim->dsid, dimid))
+        ierr = PIO_NOERR;
+
+    if (dcpl >= 0)
+        H5Pclose(dcpl);
+    if (sid >= 0)
+        H5Sclose(sid);
+
+    return ierr;
+}
+
+/**
+ * End define mode of a file written with PIO_IOTYPE_HDF5: create
+ * the datasets of the variables and dimensions defined since the
+ * file entered define mode and attach the dimension scales to the
+ * variables. Called on all the IO tasks.
+ *
+ * @param file pointer to the file_desc_t of the file.
+ * @returns 0 for success, error code otherwise.
+ */
+int pio_hdf5_enddef(file_desc_t *file)
+{
+    hdf5_file_desc_t *h5 = file->hdf5;
+    int first_new = 0;
+    int ierr;
+
+    if (!h5->in_define_mode)
+        return PIO_ENOTINDEFINE;
+
+    /* The variables created earlier come first. */
+    while (first_new < h5->nvars && h5->vars[first_new].dsid >= 0)
+        first_new++;
+
+    for (int v = first_new; v < h5->nvars; v++)
+        if ((ierr = hdf5_create_var(h5, v)))
+            return ierr;
+
+    for (int d = 0; d < h5->ndims; d++)
+        if (h5->dims[d].dsid < 0 && (ierr = hdf5_create_dim(h5, d)))
+            return ierr;
+
+    for (int v = first_new; v < h5->nvars; v++)
+    {
+        hdf5_var_desc_t *hvar = &h5->vars[v];
+
+        if (hvar->ndims == 1 && h5->dims[hvar->dimids[0]].coord_varid == v)
+            continue;
+        for (int i = 0; i < hvar->ndims; i++)
+            if (H5DSattach_scale(hvar->dsid, h5->dims[hvar->dimids[i]].dsid, i) < 0)
+                return PIO_EHDF5ERR;
+    }
+
+    h5->in_define_mode = 0;
+
+    return PIO_NOERR;
+}
+
+/**
+ * Enter define mode in a file written with PIO_IOTYPE_HDF5.
+ *
+ * @param file pointer to the file_desc_t of the file.
+ * @returns 0 for success, error code otherwise.
+ */
+int pio_hdf5_redef(file_desc_t *file)
+{
+    if (file->hdf5->in_define_mode)
+        return PIO_EINDEFINE;
+    file->hdf5->in_define_mode = 1;
+
+    return PIO_NOERR;
+}
+
+/**
+ * Inquire about a file written with PIO_IOTYPE_HDF5.
+ *
+ * @param file pointer to the file_desc_t of the file.
+ * @param ndimsp pointer that gets the number of dimensions, ignored
+ * if NULL.
+ * @param nvarsp pointer that gets the number of variables, ignored
+ * if NULL.
+ * @param ngattsp pointer that gets the number of global attributes,
+ * ignored if NULL.
+ * @param unlimdimidp pointer that gets the id of the first
+ * unlimited dimension (-1 if there is none), ignored if NULL.
+ * @returns 0 for success, error code otherwise.
+ */
+int pio_hdf5_inq(file_desc_t *file, int *ndimsp, int *nvarsp, int *ngattsp, int *unlimdimidp)
+{
+    hdf5_file_desc_t *h5 = file->hdf5;
+
+    if (ndimsp)
+        *ndimsp = h5->ndims;
+    if (nvarsp)
+        *nvarsp = h5->nvars;
+    if (ngattsp)
+        *ngattsp = h5->ngatts;
+    if (unlimdimidp)
+    {
+        *unlimdimidp = -1;
+        for (int d = 0; d < h5->ndims && *unlimdimidp < 0; d++)
+            if (h5->dims[d].len == PIO_UNLIMITED)
+                *unlimdimidp = d;
+    }
+
+    return PIO_NOERR;
+}
+
+/**
+ * Get the unlimited dimensions of a file written with
+ * PIO_IOTYPE_HDF5.
+ *
+ * @param file pointer to the file_desc_t of the file.
+ * @param nunlimdimsp pointer that gets the number of unlimited
+ * dimensions, ignored if NULL.
+ * @param unlimdimidsp pointer that gets the ids of the unlimited
+ * dimensions, ignored if NULL.
+ * @returns 0 for success, error code otherwise.
+ */
+int pio_hdf5_inq_unlimdims(file_desc_t *file, int *nunlimdimsp, int *unlimdimidsp)
+{
+    hdf5_file_desc_t *h5 = file->hdf5;
+    int n = 0;
+
+    for (int d = 0; d < h5->ndims; d++)
+    {
+        if (h5->dims[d].len == PIO_UNLIMITED)
+        {
+            if (unlimdimidsp)
+                unlimdimidsp[n] = d;
+            n++;
+        }
+    }
+    if (nunlimdimsp)
+        *nunlimdimsp = n;
+
+    return PIO_NOERR;
+}
+
+/**
+ * Inquire about a dimension in a file written with PIO_IOTYPE_HDF5.
+ *
+ * @param file pointer to the file_desc_t of the file.
+ * @param dimid the dimension id.
+ * @param name pointer that gets the name, ignored if NULL.
+ * @param lenp pointer that gets the length, ignored if NULL.
+ * @returns 0 for success, error code otherwise.
+ */
+int pio_hdf5_inq_dim(file_desc_t *file, int dimid, char *name, PIO_Offset *lenp)
+{
+    hdf5_file_desc_t *h5 = file->hdf5;
+
+    if (dimid < 0 || dimid >= h5->ndims)
+        return PIO_EBADDIM;
+    if (name)
+        strcpy(name, h5->dims[dimid].name);
+    if (lenp)
+        *lenp = hdf5_dim_len(h5, dimid);
+
+    return PIO_NOERR;
+}
+
+/**
+ * Get the id of a dimension in a file written with PIO_IOTYPE_HDF5.
+ *
+ * @param file pointer to the file_desc_t of the file.
+ * @param name the name of the dimension.
+ * @param idp pointer that gets the dimension id, ignored if NULL.
+ * @returns 0 for success, error code otherwise.
+ */
+int pio_hdf5_inq_dimid(file_desc_t *file, const char *name, int *idp)
+{
+    hdf5_file_desc_t *h5 = file->hdf5;
+
+    for (int d = 0; d < h5->ndims; d++)
+    {
+        if (!strcmp(h5->dims[d].name, name))
+        {
+            if (idp)
+                *idp = d;
+            return PIO_NOERR;
+        }
+    }
+
+    return PIO_EBADDIM;
+}
+
+/**
+ * Inquire about a variable in a file written with PIO_IOTYPE_HDF5.
+ *
+ * @param file pointer to the file_desc_t of the file.
+ * @param varid the variable id.
+ * @param name pointer that gets the name, ignored if NULL.
+ * @param xtypep pointer that gets the type, ignored if NULL.
+ * @param ndimsp pointer that gets the number of dimensions, ignored
+ * if NULL.
+ * @param dimidsp pointer that gets the dimension ids, ignored if
+ * NULL.
+ * @param nattsp pointer that gets the number of attributes, ignored
+ * if NULL.
+ * @returns 0 for success, error code otherwise.
+ */
+int pio_hdf5_inq_var(file_desc_t *file, int varid, char *name, nc_type *xtypep, int *ndimsp,
+                     int *dimidsp, int *nattsp)
+{
+    hdf5_file_desc_t *h5 = file->hdf5;
+    hdf5_var_desc_t *hvar;
+
+    if (varid < 0 || varid >= h5->nvars)
+        return PIO_ENOTVAR;
+    hvar = &h5->vars[varid];
+
+    if (name)
+        strcpy(name, hvar->name);
+    if (xtypep)
+        *xtypep = hvar->xtype;
+    if (ndimsp)
+        *ndimsp = hvar->ndims;
+    if (dimidsp)
+        for (int i = 0; i < hvar->ndims; i++)
+            dimidsp[i] = hvar->dimids[i];
+    if (nattsp)
+        *nattsp = hvar->natts;
+
+    return PIO_NOERR;
+}
+
+/**
+ * Get the id of a variable in a file written with PIO_IOTYPE_HDF5.
+ *
+ * @param file pointer to the file_desc_t of the file.
+ * @param name the name of the variable.
+ * @param varidp pointer that gets the variable id, ignored if NULL.
+ * @returns 0 for success, error code otherwise.
+ */
+int pio_hdf5_inq_varid(file_desc_t *file, const char *name, int *varidp)
+{
+    hdf5_file_desc_t *h5 = file->hdf5;
+
+    for (int v = 0; v < h5->nvars; v++)
+    {
+        if (!strcmp(h5->vars[v].name, name))
+        {
+            if (varidp)
+                *varidp = v;
+            return PIO_NOERR;
+        }
+    }
+
+    return PIO_ENOTVAR;
+}
+
+/**
+ * Get the fill mode and fill value of a variable in a file written
+ * with PIO_IOTYPE_HDF5.
+ *
+ * @param file pointer to the file_desc_t of the file.
+ * @param varid the variable id.
+ * @param no_fillp pointer that gets 1 if filling is turned off for
+ * the variable, ignored if NULL.
+ * @param fill_valuep pointer that gets the fill value (the default
+ * fill value if no fill value is set), ignored if NULL.
+ * @returns 0 for success, error code otherwise.
+ */
+int pio_hdf5_inq_var_fill(file_desc_t *file, int varid, int *no_fillp, void *fill_valuep)
+{
+    hdf5_file_desc_t *h5 = file->hdf5;
+    hdf5_var_desc_t *hvar;
+
+    if (varid < 0 || varid >= h5->nvars)
+        return PIO_ENOTVAR;
+    hvar = &h5->vars[varid];
+
+    if (no_fillp)
+        *no_fillp = (hvar->fill_mode == NC_NOFILL);
+    if (fill_valuep)
+    {
+        if (hvar->fill_set)
+            memcpy(fill_valuep, hvar->fill_value, hdf5_type_size(hvar->xtype));
+        else
+            return hdf5_default_fill(hvar->xtype, fill_valuep);
+    }
+
+    return PIO_NOERR;
+}
+
+/**
+ * Write a hyperslab of a variable in a file written with
+ * PIO_IOTYPE_HDF5. Collective on the IO tasks, only the data on IO
+ * rank 0 is written.
+ *
+ * @param file pointer to the file_desc_t of the file.
+ * @param varid the variable id.
+ * @param start the start of the hyperslab, NULL for 0s.
+ * @param count the count of the hyperslab, NULL for the whole
+ * variable.
+ * @param stride the stride of the hyperslab, NULL for 1s.
+ * @param xtype the type of the data in buf.
+ * @param buf pointer to the data.
+ * @returns 0 for success, error code otherwise.
+ */
+int pio_hdf5_put_vars(file_desc_t *file, int varid, const PIO_Offset *start,
+                      const PIO_Offset *count, const PIO_Offset *stride, nc_type xtype,
+                      const void *buf)
+{
+    iosystem_desc_t *ios = file->iosystem;
+    hdf5_file_desc_t *h5 = file->hdf5;
+    hdf5_var_desc_t *hvar;
+    hsize_t hstart[PIO_MAX_DIMS], hcount[PIO_MAX_DIMS], hstride[PIO_MAX_DIMS];
+    hsize_t nelems = 1;
+    hid_t mtid = -1, fsid = -1, msid = -1;
+    int ierr = PIO_NOERR;
+
+    if (varid < 0 || varid >= h5->nvars)
+        return PIO_ENOTVAR;
+    hvar = &h5->vars[varid];
+
+    /* Leave define mode, as netCDF-4 does. */
+    if (h5->in_define_mode && (ierr = pio_hdf5_enddef(file)))
+        return ierr;
+
+    for (int i = 0; i < hvar->ndims; i++)
+    {
+        hstart[i] = start ? (hsize_t)start[i] : 0;
+        hstride[i] = stride ? (hsize_t)stride[i] : 1;
+        if (count)
+            hcount[i] = (hsize_t)count[i];
+        else
+            hcount[i] = (i == 0) ? (hsize_t)hdf5_dim_len(h5, hvar->dimids[0]) : (hsize_t)h5->dims[hvar->dimids[i]].len;
+        nelems *= hcount[i];
+    }
+
+    /* Extend the record dimension (the same on all the IO tasks). */
+    if (nelems > 0 && hvar->ndims > 0 && (ierr = hdf5_extend_recs(h5, hvar, (PIO_Offset)(hstart[0] + (hcount[0] - 1) * hstride[0] + 1))))
+        return ierr;
+
+    if ((mtid = hdf5_type(xtype, 1)) < 0 || (fsid = H5Dget_space(hvar->dsid)) < 0 ||
+        (msid = H5Screate_simple(1, &nelems, NULL)) < 0)
+        ierr = PIO_EHDF5ERR;
+
+    if (!ierr)
+    {
+        if (ios->io_rank == 0 && nelems > 0)
+        {
+            if (hvar->ndims > 0 &&
+                H5Sselect_hyperslab(fsid, H5S_SELECT_SET, hstart, hstride, hcount, NULL) < 0)
+                ierr = PIO_EHDF5ERR;
+        }
+        else if (H5Sselect_none(fsid) < 0 || H5Sselect_none(msid) < 0)
+            ierr = PIO_EHDF5ERR;
+    }
+
+    if (!ierr && H5Dwrite(hvar->dsid, mtid, msid, fsid, h5->dxplid_coll, buf) < 0)
+        ierr = PIO_EHDF5ERR;
+
+    if (msid >= 0)
+        H5Sclose(msid);
+    if (fsid >= 0)
+        H5Sclose(fsid);
+    if (mtid >= 0)
+        H5Tclose(mtid);
+
+    return ierr;
+}
+
+/**
+ * Write the data of variables rearranged to the IO tasks to a file
+ * written with PIO_IOTYPE_HDF5. Called on all the IO tasks.
+ *
+ * The I/O regions of each variable are combined into one hyperslab
+ * selection in the file and one in the IO buffer, and written with a
+ * single collective H5Dwrite(), which pairs the elements of the two
+ * selections in row-major order. This is right when the regions are
+ * created from the sorted map of the IO task, since the elements of
+ * their union in the file are then in the order of the IO buffer.
+ * If coalesce_regions() laid the IO buffer of an IO task out box by
+ * box, the boxes can overlap in the outer dimensions and their union
+ * is not in the order of the buffer (iodesc->regions_unordered). Each
+ * region is then written with its own H5Dwrite(), on all the IO
+ * tasks, with the offset of the region in the IO buffer.
+ *
+ * @param file pointer to the file_desc_t of the file.
+ * @param nvars the number of variables to be written.
+ * @param fndims the number of dimensions of the variables in the
+ * file.
+ * @param varids an array of the variable ids to be written.
+ * @param iodesc pointer to the io_desc_t info.
+ * @param fill Non-zero if this write is fill data.
+ * @param frame the record dimension for each of the nvars variables
+ * in iobuf. NULL if this iodesc contains non-record vars.
+ * @returns 0 for success, error code otherwise.
+ */
+int pio_hdf5_write_darray(file_desc_t *file, int nvars, int fndims, const int *varids,
+                          io_desc_t *iodesc, int fill, const int *frame)
+{
+    iosystem_desc_t *ios;
+    hdf5_file_desc_t *h5;
+    var_desc_t *vdesc;
+    size_t start[fndims];
+    size_t count[fndims];
+    hsize_t hstart[fndims], hcount[fndims];
+    hid_t mtid;
+    char dummy = 0;
+    int ierr = PIO_NOERR;
+
+    pioassert(file && file->iosystem && file->hdf5 && varids && iodesc,
+              "invalid input", __FILE__, __LINE__);
+    ios = file->iosystem;
+    h5 = file->hdf5;
+    vdesc = file->varlist + varids[0];
+
+    /* Set these differently for data and fill writing. */
+    int num_regions = fill ? iodesc->maxfillregions: iodesc->maxregions;
+    io_region_table *regions = fill ? iodesc->fillregions : iodesc->regions;
+    PIO_Offset llen = fill ? iodesc->holegridsize : iodesc->llen;
+    void *iobuf = fill ? vdesc->fillbuf : file->iobuf[iodesc->ioid - PIO_IODESC_START_ID];
+    hsize_t mlen = (llen > 0) ? (hsize_t)llen : 1;
+    /* The number of (collective) H5Dwrite() calls for each variable,
+     * the same on all the IO tasks. */
+    bool per_region = !fill && iodesc->regions_unordered;
+    int nwrites = per_region ? num_regions : 1;
+
+    if (h5->in_define_mode && (ierr = pio_hdf5_enddef(file)))
+        return pio_err(ios, file, ierr, __FILE__, __LINE__,
+                        "Writing variables (number of variables = %d) to file (%s, ncid=%d) using PIO_IOTYPE_HDF5 iotype failed. Ending define mode failed", nvars, pio_get_fname_from_file(file), file->pio_ncid);
+
+    if ((mtid = hdf5_type(iodesc->piotype, 1)) < 0)
+        return pio_err(ios, file, PIO_EBADTYPE, __FILE__, __LINE__,
+                        "Writing variables (number of variables = %d) to file (%s, ncid=%d) using PIO_IOTYPE_HDF5 iotype failed. Unsupported variable data type (type=%d)", nvars, pio_get_fname_from_file(file), file->pio_ncid, iodesc->piotype);
+
+    for (int nv = 0; nv < nvars && !ierr; nv++)
+    {
+        hdf5_var_desc_t *hvar;
+        hid_t fsid = -1, msid = -1;
+        void *bufptr;
+        int werr = PIO_NOERR;
+        int mpierr;
+
+        if (varids[nv] < 0 || varids[nv] >= h5->nvars)
+        {
+            ierr = pio_err(ios, file, PIO_ENOTVAR, __FILE__, __LINE__,
+                            "Writing variables (number of variables = %d) to file (%s, ncid=%d) using PIO_IOTYPE_HDF5 iotype failed. Invalid variable id (varid=%d)", nvars, pio_get_fname_from_file(file), file->pio_ncid, varids[nv]);
+            break;
+        }
+        hvar = &h5->vars[varids[nv]];
+
+        /* Extend the record dimension (the same on all the IO tasks). */
+        if (vdesc->record >= 0 && fndims > 1)
+            ierr = hdf5_extend_recs(h5, hvar, (PIO_Offset)frame[nv] + 1);
+
+        if (!ierr && ((fsid = H5Dget_space(hvar->dsid)) < 0 ||
+                      (msid = H5Screate_simple(1, &mlen, NULL)) < 0))
+            ierr = PIO_EHDF5ERR;
+
+        /* The writes below are collective, so the IO tasks skip them
+         * together if the dataspaces could not be set up on any of
+         * them. */
+        if ((mpierr = MPI_Allreduce(MPI_IN_PLACE, &ierr, 1, MPI_INT, MPI_MIN, ios->io_comm)))
+            ierr = check_mpi(NULL, file, mpierr, __FILE__, __LINE__);
+
+        /* Combine the regions into one selection in the file and in
+         * the IO buffer, or into one selection per region if the
+         * buffer is laid out box by box. An IO task that fails to
+         * select its regions records the error and still takes part
+         * in each H5Dwrite(), with an empty selection. */
+        bufptr = iobuf ? (void *)((char *)iobuf + iodesc->mpitype_size * nv * llen) : &dummy;
+        for (int w = 0; !ierr && w < nwrites; w++)
+        {
+            int first = per_region ? w : 0;
+            int last = per_region ? w + 1 : num_regions;
+            hsize_t nsel = 0;
+            int selerr = PIO_NOERR;
+
+            for (int regioncnt = first; !selerr && regions && regioncnt < last &&
+                     regioncnt < regions->nregions; regioncnt++)
+            {
+                hsize_t nelems = 1;
+
+                if ((selerr = find_start_count(iodesc->ndims, iodesc->dimlen, fndims, vdesc,
+                                               regions, regioncnt, start, count)))
+                    break;
+
+                /* Set the start of the record dimension. */
+                if (vdesc->record >= 0 && fndims > 1)
+                    start[0] = frame[nv];
+
+                for (int i = 0; i < fndims; i++)
+                {
+                    hstart[i] = start[i];
+                    hcount[i] = count[i];
+                    nelems *= count[i];
+                }
+
+                if (nelems > 0)
+                {
+                    hsize_t moff = (hsize_t)regions->loffset[regioncnt];
+                    H5S_seloper_t op = nsel ? H5S_SELECT_OR : H5S_SELECT_SET;
+
+                    if (H5Sselect_hyperslab(fsid, op, hstart, NULL, hcount, NULL) < 0 ||
+                        H5Sselect_hyperslab(msid, op, &moff, NULL, &nelems, NULL) < 0)
+                        selerr = PIO_EHDF5ERR;
+                    nsel += nelems;
+                }
+            }
+
+            if ((selerr || !nsel) &&
+                (H5Sselect_none(fsid) < 0 || H5Sselect_none(msid) < 0) && !selerr)
+                selerr = PIO_EHDF5ERR;
+
+            if (H5Dwrite(hvar->dsid, mtid, msid, fsid, h5->dxplid_coll, bufptr) < 0 && !selerr)
+                selerr = PIO_EHDF5ERR;
+
+            if (!werr)
+                werr = selerr;
+        }
+
+        /* Agree on the errors of the writes, so that the IO tasks
+         * stop at the same variable. */
+        if (!ierr)
+        {
+            ierr = werr;
+            if ((mpierr = MPI_Allreduce(MPI_IN_PLACE, &ierr, 1, MPI_INT, MPI_MIN, ios->io_comm)))
+                ierr = check_mpi(NULL, file, mpierr, __FILE__, __LINE__);
+        }
+
+        if (msid >= 0)
+            H5Sclose(msid);
+        if (fsid >= 0)
+            H5Sclose(fsid);
+
+        if (ierr)
+            ierr = pio_err(ios, file, ierr, __FILE__, __LINE__,
+                            "Writing variables (number of variables = %d) to file (%s, ncid=%d) using PIO_IOTYPE_HDF5 iotype failed. Writing variable (%s, varid=%d) failed", nvars, pio_get_fname_from_file(file), file->pio_ncid, hvar->name, varids[nv]);
+    }
+
+    H5Tclose(mtid);
+
+    return ierr;
+}
+
+/**
+ * Flush a file written with PIO_IOTYPE_HDF5. Called on all the IO
+ * tasks.
+ *
+ * @param file pointer to the file_desc_t of the file.
+ * @returns 0 for success, error code otherwise.
+ */
+int pio_hdf5_sync(file_desc_t *file)
+{
+    hdf5_file_desc_t *h5 = file->hdf5;
+    int ierr;
+
+    if (h5->in_define_mode && (ierr = pio_hdf5_enddef(file)))
+        return ierr;
+    if ((ierr = hdf5_sync_dim_lens(h5)))
+        return ierr;
+    if (H5Fflush(h5->fid, H5F_SCOPE_GLOBAL) < 0)
+        return PIO_EHDF5ERR;
+
+    return PIO_NOERR;
+}
+
+/**
+ * Close a file written with PIO_IOTYPE_HDF5 and free the HDF5 info
+ * of the file. Called on all the IO tasks.
+ *
+ * @param file pointer to the file_desc_t of the file.
+ * @returns 0 for success, error code otherwise.
+ */
+int pio_hdf5_close(file_desc_t *file)
+{
+    hdf5_file_desc_t *h5 = file->hdf5;
+    int ierr = PIO_NOERR;
+
+    if (h5->in_define_mode)
+        ierr = pio_hdf5_enddef(file);
+    if (!ierr)
+        ierr = hdf5_sync_dim_lens(h5);
+
+    for (int v = 0; v < h5->nvars; v++)
+    {
+        hdf5_var_desc_t *hvar = &h5->vars[v];
+
+        while (hvar->atts)
+        {
+            hdf5_att_desc_t *att = hvar->atts;
+
+            hvar->atts = att->next;
+            free(att->value);
+            free(att);
+        }
+        if (hvar->dsid >= 0 && H5Dclose(hvar->dsid) < 0 && !ierr)
+            ierr = PIO_EHDF5ERR;
+        free(hvar->dimids);
+    }
+    for (int d = 0; d < h5->ndims; d++)
+        if (h5->dims[d].coord_varid < 0 && h5->dims[d].dsid >= 0 &&
+            H5Dclose(h5->dims[d].dsid) < 0 && !ierr)
+            ierr = PIO_EHDF5ERR;
+
+    if (H5Pclose(h5->dxplid_coll) < 0 && !ierr)
+        ierr = PIO_EHDF5ERR;
+    if (H5Fclose(h5->fid) < 0 && !ierr)
+        ierr = PIO_EHDF5ERR;
+
+    free(h5->vars);
+    free(h5->dims);
+    free(h5);
+    file->hdf5 = NULL;
+
+    return ierr;
+}
+
+#endif /* _HDF5 */
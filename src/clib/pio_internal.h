@@ -47,6 +47,9 @@
 #include <gptl.h>
 #endif
 #include <assert.h>
+#if PIO_USE_OPENMP
+#include <omp.h>
+#endif
 
 #if PIO_ENABLE_LOGGING
 void pio_log(int severity, const char *fmt, ...);
@@ -66,8 +69,34 @@ void pio_log(int severity, const char *fmt, ...);
         _a < _b ? _a : _b; })
 
 #define MAX_GATHER_BLOCK_SIZE 0
+
+/* The start and count arrays (length ndims) of region r of an
+ * io_region_table. Index -1 of the arrays is the column for the
+ * record dimension. */
+#define REGION_START(t, r) ((t)->start + (size_t)(r) * ((t)->ndims + 1) + 1)
+#define REGION_COUNT(t, r) ((t)->count + (size_t)(r) * ((t)->ndims + 1) + 1)
+
+/* Maximum number of bytes sent in one MPI call by pio_bcast_large(). */
+#define PIO_BCAST_MAX_CHUNK_SIZE ((PIO_Offset)1 << 30)
+
 #define PIO_REQUEST_ALLOC_CHUNK 16
 
+/* Number of data exchanges timed for each set of rearranger options
+ * by performance_tune_rearranger(), and the limit on the pending
+ * requests of the limited point-to-point options it times. */
+#define PIO_REARR_TUNE_NTRIALS 2
+#define PIO_REARR_TUNE_MAX_PEND_REQ 64
+
+/* PIO_REARR_AUTO chooses the subset rearranger if the IO buffers of
+ * the box rearranger are this many times larger (see
+ * choose_rearranger()). */
+#define PIO_REARR_AUTO_MEM_RATIO 4
+
+/* Chunks chosen from a decomposition by PIOc_def_var_chunking_auto()
+ * smaller than this are not used, unless the data of each IO task is
+ * smaller (see pio_decomp_chunksizes()). */
+#define PIO_MIN_CHUNK_BYTES ((PIO_Offset)64 * 1024)
+
 /** This is needed to handle _long() functions. It may not be used as
  * a data type when creating attributes or varaibles, it is only used
  * internally. */
@@ -79,11 +108,13 @@ extern "C" {
 
     extern PIO_Offset pio_buffer_size_limit;
 
-    /** Used to sort map points in the subset rearranger. */
+    /** Used to sort runs of count consecutive map points in the subset
+     * rearranger. */
     typedef struct mapsort
     {
         int rfrom;
-        PIO_Offset soffset;
+        int soffset;
+        int count;
         PIO_Offset iomap;
     } mapsort;
 
@@ -163,6 +194,13 @@ extern "C" {
     int check_netcdf(iosystem_desc_t *ios, file_desc_t *file, int status,
                       const char *fname, int line);
 
+    /* Check the return code from a netCDF call that returns no data,
+     * errors may be deferred to the next sync point. */
+    int check_netcdf_defer(file_desc_t *file, int status, const char *fname, int line);
+
+    /* Reduce the deferred errors on a file across all tasks. */
+    int pio_check_deferred_errors(file_desc_t *file);
+
     /* Given PIO type, find MPI type and type size. */
     int find_mpi_type(int pio_type, MPI_Datatype *mpi_type, int *type_size);
 
@@ -190,8 +228,10 @@ extern "C" {
     void pioassert(bool exp, const char *msg, const char *fname, int line);
 
     /* Compute start and count values for each io task for a decomposition. */
+    int get_box_stripe_size(iosystem_desc_t *ios, PIO_Offset *stripe_sizep);
     int CalcStartandCount(int pio_type, int ndims, const int *gdims, int num_io_procs,
-                          int myiorank, PIO_Offset *start, PIO_Offset *count, int *num_aiotasks);
+                          int myiorank, PIO_Offset stripe_size, PIO_Offset *start,
+                          PIO_Offset *count, int *num_aiotasks);
 
     /* Completes the mapping for the box rearranger. */
     int compute_counts(iosystem_desc_t *ios, io_desc_t *iodesc, const int *dest_ioproc,
@@ -208,6 +248,9 @@ extern "C" {
                   void *recvbuf, int *recvcounts, int *rdispls, MPI_Datatype *recvtypes,
                   MPI_Comm comm, rearr_comm_fc_opt_t *fc);
 
+    /* Like MPI_Bcast() of bytes, but supports more than INT_MAX bytes. */
+    int pio_bcast_large(void *buf, PIO_Offset nbytes, int root, MPI_Comm comm);
+
     long long lgcd_array(int nain, long long* ain);
 
     void PIO_Offset_size(MPI_Datatype *dtype, int *tsize);
@@ -223,8 +266,7 @@ extern "C" {
     PIO_Offset coord_to_lindex(int ndims, const PIO_Offset *lcoord, const PIO_Offset *count);
 
     /* Determine whether fill values are needed. */
-    int determine_fill(iosystem_desc_t *ios, io_desc_t *iodesc, const int *gsize,
-                       const PIO_Offset *compmap);
+    int determine_fill(iosystem_desc_t *ios, io_desc_t *iodesc, const int *gsize);
 
     /* Set start and count so that they describe the first region in map.*/
     PIO_Offset find_region(int ndims, const int *gdims, int maplen, const PIO_Offset *map,
@@ -232,7 +274,11 @@ extern "C" {
 
     /* Calculate start and count regions for the subset rearranger. */
     int get_regions(int ndims, const int *gdimlen, int maplen, const PIO_Offset *map,
-                    int *maxregions, io_region *firstregion);
+                    int *maxregions, io_region_table *regions);
+
+    /* Reorder the IO buffer of a subset decomposition to merge its regions. */
+    int coalesce_regions(iosystem_desc_t *ios, io_desc_t *iodesc, const int *gdimlen,
+                         PIO_Offset *iomap);
 
     /* Expand a region along dimension dim, by incrementing count[i] as
      * much as possible, consistent with the map. */
@@ -251,13 +297,13 @@ extern "C" {
                                 const rearr_comm_fc_opt_t *exp_opt);
 
     /* Create a subset rearranger. */
-    int subset_rearrange_create(iosystem_desc_t *ios, int maplen, PIO_Offset *compmap, const int *gsize,
-                                int ndim, io_desc_t *iodesc);
+    int subset_rearrange_create(iosystem_desc_t *ios, const int *gsize, int ndim,
+                                io_desc_t *iodesc);
 
 
     /* Create a box rearranger. */
-    int box_rearrange_create(iosystem_desc_t *ios, int maplen, const PIO_Offset *compmap, const int *gsize,
-                             int ndim, io_desc_t *iodesc);
+    int box_rearrange_create(iosystem_desc_t *ios, const int *gsize, int ndim,
+                             io_desc_t *iodesc);
 
 
     /* Move data from IO tasks to compute tasks. */
@@ -269,7 +315,17 @@ extern "C" {
 
     /* Allocate and initialize storage for decomposition information. */
     int malloc_iodesc(iosystem_desc_t *ios, int piotype, int ndims, io_desc_t **iodesc);
-    void performance_tune_rearranger(iosystem_desc_t *ios, io_desc_t *iodesc);
+    int set_iodesc_map(iosystem_desc_t *ios, io_desc_t *iodesc, int maplen,
+                       const PIO_Offset *compmap);
+    int set_iodesc_ranges(iosystem_desc_t *ios, io_desc_t *iodesc, int nranges,
+                          const PIO_Offset *rstart, const PIO_Offset *rcount);
+    int expand_iodesc_map(io_desc_t *iodesc, PIO_Offset **mapp);
+    int performance_tune_rearranger(iosystem_desc_t *ios, io_desc_t *iodesc);
+
+    /* Choose the rearranger of a decomposition for PIO_REARR_AUTO. */
+    int choose_rearranger(iosystem_desc_t *ios, int pio_type, int ndims, const int *gdimlen,
+                          int nranges, const PIO_Offset *rstart, const int *rcount,
+                          const PIO_Offset *iostart, const PIO_Offset *iocount, int *rearrp);
 
     /* Flush contents of multi-buffer to disk. */
     int flush_output_buffer(file_desc_t *file, bool force, PIO_Offset addsize);
@@ -277,8 +333,11 @@ extern "C" {
     /* Compute the size that the IO tasks will need to hold the data. */
     int compute_maxIObuffersize(MPI_Comm io_comm, io_desc_t *iodesc);
 
-    /* Allocation memory for a data region. */
-    int alloc_region2(iosystem_desc_t *ios, int ndims, io_region **region);
+    /* Allocate a region table with one empty region. */
+    int alloc_region_table(iosystem_desc_t *ios, int ndims, io_region_table **regionsp);
+
+    /* Make room for more regions in a region table. */
+    int grow_region_table(iosystem_desc_t *ios, io_region_table *regions, int nregions);
 
     /* Delete an entry from the lost of open IO systems. */
     int pio_delete_iosystem_from_list(int piosysid);
@@ -292,7 +351,7 @@ extern "C" {
     /* Find greatest commond divisor in an array. */
     int gcd_array(int nain, int *ain);
 
-    void free_region_list(io_region *top);
+    void free_region_table(io_region_table *regions);
 
     /* Convert a global coordinate value into a local array index. */
     PIO_Offset coord_to_lindex(int ndims, const PIO_Offset *lcoord, const PIO_Offset *count);
@@ -305,8 +364,38 @@ extern "C" {
 
     /* Create the derived MPI datatypes used for comp2io and io2comp
      * transfers. */
-    int create_mpi_datatypes(MPI_Datatype basetype, int msgcnt, const PIO_Offset *mindex,
+    int create_mpi_datatypes(MPI_Datatype basetype, int msgcnt, const int *mindex,
                              const int *mcount, int *mfrom, MPI_Datatype *mtype);
+
+    /* Get/update the memory held by the rearranger of a decomposition. */
+    int get_rearr_mem(iosystem_desc_t *ios, io_desc_t *iodesc, double *nelems,
+                      double *nblocks, PIO_Offset *mem);
+    int update_rearr_mem(iosystem_desc_t *ios, io_desc_t *iodesc);
+
+    /* Find the runs of consecutive indexes of a rearranger message. */
+    int find_index_runs(int msg, int numinds, int pos, const int *mindex,
+                        int mcount, const int *mfrom, int *displace, int *blocklen);
+
+    /* Create/free the pack list used for packed rearranger messages. */
+    int create_pack_list(int msgcnt, const int *mindex, const int *mcount,
+                         const int *mfrom, pio_pack_list **listp);
+    void free_pack_list(pio_pack_list *list);
+
+    /* Gather/scatter the data of one packed rearranger message. */
+    void pack_data(const pio_pack_list *list, int msg, int elsize, int nvars,
+                   PIO_Offset stride, const void *src, void *dst);
+    void unpack_data(const pio_pack_list *list, int msg, int elsize, int nvars,
+                     PIO_Offset stride, const void *src, void *dst);
+
+    /* Number of threads used on the IO tasks. */
+    int pio_io_nthreads(const iosystem_desc_t *ios);
+
+    /* Rearrange data with packed messages. */
+    int rearrange_comp2io_packed(iosystem_desc_t *ios, io_desc_t *iodesc, void *sbuf,
+                                 void *rbuf, int nvars, MPI_Comm mycomm, int ntasks,
+                                 int niotasks);
+    int rearrange_io2comp_packed(iosystem_desc_t *ios, io_desc_t *iodesc, void *sbuf,
+                                 void *rbuf, MPI_Comm mycomm, int ntasks, int niotasks);
     int compare_offsets(const void *a, const void *b) ;
 
     /* Print a trace statement, for debugging. */
@@ -314,9 +403,27 @@ extern "C" {
 
     void cn_buffer_report(iosystem_desc_t *ios, bool collective);
 
+    /* Buffers tracked in the memory statistics (see PIOc_get_mem_stats()). */
+    void pio_mem_account(iosystem_desc_t *ios, file_desc_t *file, int cat, PIO_Offset nbytes);
+    void *pio_mem_get(file_desc_t *file, int cat, PIO_Offset size);
+    void *pio_mem_getr(file_desc_t *file, int cat, void *buf, PIO_Offset size);
+    void pio_mem_rel(file_desc_t *file, void *buf);
+
     /* Initialize the compute buffer. */
     int compute_buffer_init(iosystem_desc_t *ios);
 
+    /* Size-class arena of the buffers of an IO system. */
+    typedef struct pio_arena_t pio_arena_t;
+    int pio_arena_create(pio_arena_t **arenap);
+    void pio_arena_free(pio_arena_t *arena);
+    void pio_arena_set_hugepages(pio_arena_t *arena, int enable);
+    void *pio_arena_alloc(pio_arena_t *arena, size_t size);
+    void *pio_arena_realloc(pio_arena_t *arena, void *buf, size_t size);
+    void pio_arena_release(pio_arena_t *arena, void *buf);
+    void pio_arena_stats(pio_arena_t *arena, PIO_Offset *curalloc, PIO_Offset *totfree,
+                         PIO_Offset *maxfree, long *nget, long *nrel);
+    PIO_Offset pio_arena_retained(pio_arena_t *arena);
+
     /* Flush PIO's data buffer. */
     int flush_buffer(int ncid, wmulti_buffer *wmb, bool flushtodisk);
 
@@ -332,6 +439,16 @@ extern "C" {
 
     /* Darray support functions. */
 
+    /* Find the start/count of an I/O region of a variable. */
+    int find_start_count(int ndims, const int *dimlen, int fndims, var_desc_t *vdesc,
+                         io_region_table *regions, int r, size_t *start, size_t *count);
+
+    /* Point the varn start/count lists of a region table at its regions. */
+    int get_region_varn_lists(io_region_table *regions, int fndims, bool record, int *nreqp);
+
+    /* Set the start of the record dimension in the varn start lists. */
+    void set_region_frame(io_region_table *regions, int nreq, PIO_Offset frame);
+
     /* Write aggregated arrays to file using parallel I/O (netCDF-4 parallel/pnetcdf) */
     int write_darray_multi_par(file_desc_t *file, int nvars, int fndims, const int *vid,
                                io_desc_t *iodesc, int fill, const int *frame);
@@ -381,6 +498,64 @@ extern "C" {
     void pio_init_gptl(void);
     void pio_finalize_gptl(void );
 
+    /* Node topology aware placement of IO tasks. */
+    int pio_get_iotask_placement(int *placementp, int *niotasks_per_nodep);
+    int pio_get_node_ioranks(MPI_Comm comm, int num_iotasks, int niotasks_per_node,
+                             int *num_iotasksp, int **ioranksp);
+
+    /* Staging of data written to files in node-local storage. */
+    int pio_stage_create(file_desc_t *file, const char *filename);
+    int pio_stage_write(file_desc_t *file, int nvars, int fndims, const int *varids,
+                        io_desc_t *iodesc, int fill, const int *frame);
+    int pio_stage_sync(file_desc_t *file);
+    int pio_stage_drain_file(file_desc_t *file);
+    int pio_stage_close(file_desc_t *file);
+    int pio_stage_drain_pending(iosystem_desc_t *ios);
+
+    /* Subfiled datasets. */
+    int pio_subfile_create(file_desc_t *file, const char *filename);
+    int pio_subfile_add_regions(file_desc_t *file, io_desc_t *iodesc, int nvars,
+                                const int *varids, int fill);
+    int pio_subfile_write_index(file_desc_t *file);
+    int pio_subfile_open(file_desc_t *file, const char *filename, int *is_subfiledp);
+    int pio_subfile_has_var(file_desc_t *file, int varid);
+    int pio_subfile_get_varn(file_desc_t *file, int varid, int ndims, int nreqs,
+                             PIO_Offset *const *starts, PIO_Offset *const *counts,
+                             void *buf, MPI_Datatype mtype);
+    int pio_subfile_get_vars(file_desc_t *file, int varid, const PIO_Offset *start,
+                             const PIO_Offset *count, const PIO_Offset *stride,
+                             nc_type xtype, void *buf);
+    int pio_subfile_close(file_desc_t *file, int ierr);
+
+#ifdef _HDF5
+    /* Writing files with PIO_IOTYPE_HDF5. */
+    int pio_hdf5_create(file_desc_t *file, const char *filename);
+    int pio_hdf5_def_dim(file_desc_t *file, const char *name, PIO_Offset len, int *idp);
+    int pio_hdf5_def_var(file_desc_t *file, const char *name, nc_type xtype, int ndims,
+                         const int *dimids, int *varidp);
+    int pio_hdf5_set_fill(file_desc_t *file, int fillmode, int *old_modep);
+    int pio_hdf5_put_att(file_desc_t *file, int varid, const char *name, nc_type atttype,
+                         PIO_Offset len, nc_type memtype, const void *op);
+    int pio_hdf5_def_var_fill(file_desc_t *file, int varid, int no_fill, const void *fill_valuep);
+    int pio_hdf5_enddef(file_desc_t *file);
+    int pio_hdf5_redef(file_desc_t *file);
+    int pio_hdf5_inq(file_desc_t *file, int *ndimsp, int *nvarsp, int *ngattsp, int *unlimdimidp);
+    int pio_hdf5_inq_unlimdims(file_desc_t *file, int *nunlimdimsp, int *unlimdimidsp);
+    int pio_hdf5_inq_dim(file_desc_t *file, int dimid, char *name, PIO_Offset *lenp);
+    int pio_hdf5_inq_dimid(file_desc_t *file, const char *name, int *idp);
+    int pio_hdf5_inq_var(file_desc_t *file, int varid, char *name, nc_type *xtypep, int *ndimsp,
+                         int *dimidsp, int *nattsp);
+    int pio_hdf5_inq_varid(file_desc_t *file, const char *name, int *varidp);
+    int pio_hdf5_inq_var_fill(file_desc_t *file, int varid, int *no_fillp, void *fill_valuep);
+    int pio_hdf5_put_vars(file_desc_t *file, int varid, const PIO_Offset *start,
+                          const PIO_Offset *count, const PIO_Offset *stride, nc_type xtype,
+                          const void *buf);
+    int pio_hdf5_write_darray(file_desc_t *file, int nvars, int fndims, const int *varids,
+                              io_desc_t *iodesc, int fill, const int *frame);
+    int pio_hdf5_sync(file_desc_t *file);
+    int pio_hdf5_close(file_desc_t *file);
+#endif /* _HDF5 */
+
     /* Internal mpi timer impl functions */
     int mpi_mtimer_init(void );
     int mpi_mtimer_finalize(void );
@@ -631,6 +806,7 @@ enum PIO_MSG
     PIO_MSG_COPY_ATT,
     PIO_MSG_INQ_TYPE,
     PIO_MSG_INQ_UNLIMDIMS,
+    PIO_MSG_CHECK_ERRORS,
     PIO_MSG_EXIT,
     PIO_MAX_MSGS
 };
@@ -688,4 +864,11 @@ const char *pio_get_vnames_from_file_id(int pio_file_id,
 const char *pio_async_msg_to_string(int msg);
 #define PIO_IS_NULL(p) ((p) ? "not NULL" : "NULL")
 
+/* True for iotypes that use netCDF classic format files accessed
+ * with the netCDF library (the in-memory iotypes use diskless
+ * classic format files). */
+#define PIO_IOTYPE_IS_NC_CLASSIC(iotype) (((iotype) == PIO_IOTYPE_NETCDF) || \
+                                          ((iotype) == PIO_IOTYPE_MEMORY) || \
+                                          ((iotype) == PIO_IOTYPE_NULL))
+
 #endif /* __PIO_INTERNAL__ */
@@ -554,6 +554,8 @@ int init_async_msgs_sign(void )
      strncpy(pio_async_msg_sign[ PIO_MSG_INQ_TYPE ], "iibb", PIO_MAX_ASYNC_MSG_ARGS);
     /*  PIO_MSG_INQ_UNLIMDIMS  sends 1 int and 2 chars/bytes */
      strncpy(pio_async_msg_sign[ PIO_MSG_INQ_UNLIMDIMS ], "ibb", PIO_MAX_ASYNC_MSG_ARGS);
+    /*  PIO_MSG_CHECK_ERRORS  sends 1 int */
+     strncpy(pio_async_msg_sign[ PIO_MSG_CHECK_ERRORS ], "i", PIO_MAX_ASYNC_MSG_ARGS);
     /*  PIO_MSG_EXIT  is a local message, never sent between compute and I/O procs  */
      strncpy(pio_async_msg_sign[ PIO_MSG_EXIT ], "", PIO_MAX_ASYNC_MSG_ARGS);
     return PIO_NOERR;
@@ -2363,6 +2365,43 @@ int inq_varid_handler(iosystem_desc_t *ios)
     return PIO_NOERR;
 }
 
+/**
+ * This function is run on the IO tasks to check the deferred errors
+ * on a file.
+ *
+ * @param ios pointer to the iosystem_desc_t.
+ * @returns 0 for success, error code otherwise.
+ * @internal
+ */
+int check_errors_handler(iosystem_desc_t *ios)
+{
+    int ncid;
+    int ret;
+
+    LOG((1, "check_errors_handler"));
+    assert(ios);
+
+    /* Get the parameters for this function that the comp master
+     * task is broadcasting. */
+    PIO_RECV_ASYNC_MSG(ios, PIO_MSG_CHECK_ERRORS, &ret, &ncid);
+    if(ret != PIO_NOERR)
+    {
+        return pio_err(ios, NULL, ret, __FILE__, __LINE__,
+                        "Error receiving asynchronous message, PIO_MSG_CHECK_ERRORS, on iosystem (iosysid=%d)", ios->iosysid);
+    }
+    LOG((1, "check_errors_handler got parameter ncid = %d", ncid));
+
+    /* Call the check errors function. */
+    if ((ret = PIOc_check_errors(ncid)))
+    {
+        return pio_err(ios, NULL, ret, __FILE__, __LINE__,
+                        "Error processing asynchronous message, PIO_MSG_CHECK_ERRORS on iosystem (iosysid=%d). Errors were found on file %s (ncid=%d)", ios->iosysid, pio_get_fname_from_file_id(ncid), ncid);
+    }
+
+    LOG((2, "check_errors_handler succeeded!"));
+    return PIO_NOERR;
+}
+
 /** 
  * This function is run on the IO tasks to sync a netCDF file.
  *
@@ -3704,6 +3743,9 @@ int pio_msg_handler2(int io_rank, int component_count, iosystem_desc_t **iosys,
         case PIO_MSG_SYNC:
             ret = sync_file_handler(my_iosys);
             break;
+        case PIO_MSG_CHECK_ERRORS:
+            ret = check_errors_handler(my_iosys);
+            break;
         case PIO_MSG_ENDDEF:
         case PIO_MSG_REDEF:
             LOG((2, "calling change_def_file_handler"));
@@ -157,8 +157,13 @@ int PIOc_inq(int ncid, int *ndimsp, int *nvarsp, int *ngattsp, int *unlimdimidp)
         }
 #endif /* _PNETCDF */
 
+#ifdef _HDF5
+        if (file->iotype == PIO_IOTYPE_HDF5)
+            ierr = pio_hdf5_inq(file, ndimsp, nvarsp, ngattsp, unlimdimidp);
+#endif /* _HDF5 */
+
 #ifdef _NETCDF
-        if (file->iotype == PIO_IOTYPE_NETCDF && file->do_io)
+        if (PIO_IOTYPE_IS_NC_CLASSIC(file->iotype) && file->do_io)
         {
             LOG((2, "PIOc_inq calling classic nc_inq"));
             /* Should not be necessary to do this - nc_inq should
@@ -182,7 +187,8 @@ int PIOc_inq(int ncid, int *ndimsp, int *nvarsp, int *ngattsp, int *unlimdimidp)
                 LOG((2, "classic unlimdimid = %d", *unlimdimidp));
         }
 #ifdef _NETCDF4
-        else if (file->iotype != PIO_IOTYPE_PNETCDF && file->iotype != PIO_IOTYPE_ADIOS && file->do_io)
+        else if (file->iotype != PIO_IOTYPE_PNETCDF && file->iotype != PIO_IOTYPE_ADIOS &&
+            file->iotype != PIO_IOTYPE_HDF5 && file->do_io)
         {
             LOG((2, "PIOc_inq calling netcdf-4 nc_inq"));
             ierr = nc_inq(file->fh, ndimsp, nvarsp, ngattsp, unlimdimidp);
@@ -334,7 +340,7 @@ int PIOc_inq_unlimdims(int ncid, int *nunlimdimsp, int *unlimdimidsp)
     /* If this is an IO task, then call the netCDF function. */
     if (ios->ioproc)
     {
-        if (file->iotype == PIO_IOTYPE_NETCDF && file->do_io)
+        if (PIO_IOTYPE_IS_NC_CLASSIC(file->iotype) && file->do_io)
         {
 #ifdef _NETCDF
             LOG((2, "netcdf"));
@@ -362,6 +368,14 @@ int PIOc_inq_unlimdims(int ncid, int *nunlimdimsp, int *unlimdimidsp)
                 *unlimdimidsp = tmp_unlimdimid;
         }
 #endif /* _PNETCDF */
+#ifdef _HDF5
+        else if (file->iotype == PIO_IOTYPE_HDF5)
+        {
+            ierr = pio_hdf5_inq_unlimdims(file, &tmp_nunlimdims, unlimdimidsp);
+            if (nunlimdimsp)
+                *nunlimdimsp = tmp_nunlimdims;
+        }
+#endif /* _HDF5 */
 #ifdef _NETCDF4
         else if ((file->iotype == PIO_IOTYPE_NETCDF4C || file->iotype == PIO_IOTYPE_NETCDF4P) &&
                  file->do_io)
@@ -493,8 +507,14 @@ int PIOc_inq_type(int ncid, nc_type xtype, char *name, PIO_Offset *sizep)
             ierr = pioc_pnetcdf_inq_type(ncid, xtype, name, sizep);
 #endif /* _PNETCDF */
 
+#ifdef _HDF5
+        if (file->iotype == PIO_IOTYPE_HDF5)
+            ierr = pioc_pnetcdf_inq_type(ncid, xtype, name, sizep);
+#endif /* _HDF5 */
+
 #ifdef _NETCDF
-        if (file->iotype != PIO_IOTYPE_PNETCDF && file->iotype != PIO_IOTYPE_ADIOS && file->do_io)
+        if (file->iotype != PIO_IOTYPE_PNETCDF && file->iotype != PIO_IOTYPE_ADIOS &&
+            file->iotype != PIO_IOTYPE_HDF5 && file->do_io)
             ierr = nc_inq_type(file->fh, xtype, name, (size_t *)sizep);
 #endif /* _NETCDF */
         LOG((2, "PIOc_inq_type netcdf call returned %d", ierr));
@@ -591,8 +611,17 @@ int PIOc_inq_format(int ncid, int *formatp)
         }
 #endif
 
+#ifdef _HDF5
+        if (file->iotype == PIO_IOTYPE_HDF5)
+        {
+            if (formatp)
+                *formatp = NC_FORMAT_NETCDF4;
+        }
+#endif /* _HDF5 */
+
 #ifdef _NETCDF
-        if (file->iotype != PIO_IOTYPE_PNETCDF && file->iotype != PIO_IOTYPE_ADIOS && file->do_io)
+        if (file->iotype != PIO_IOTYPE_PNETCDF && file->iotype != PIO_IOTYPE_ADIOS &&
+            file->iotype != PIO_IOTYPE_HDF5 && file->do_io)
             ierr = nc_inq_format(file->fh, formatp);
 #endif /* _NETCDF */
         LOG((2, "PIOc_inq netcdf call returned %d", ierr));
@@ -709,8 +738,14 @@ int PIOc_inq_dim(int ncid, int dimid, char *name, PIO_Offset *lenp)
         }
 #endif /* _PNETCDF */
 
+#ifdef _HDF5
+        if (file->iotype == PIO_IOTYPE_HDF5)
+            ierr = pio_hdf5_inq_dim(file, dimid, name, lenp);
+#endif /* _HDF5 */
+
 #ifdef _NETCDF
-        if (file->iotype != PIO_IOTYPE_PNETCDF && file->iotype != PIO_IOTYPE_ADIOS && file->do_io)
+        if (file->iotype != PIO_IOTYPE_PNETCDF && file->iotype != PIO_IOTYPE_ADIOS &&
+            file->iotype != PIO_IOTYPE_HDF5 && file->do_io)
         {
             LOG((2, "calling nc_inq_dim"));
             ierr = nc_inq_dim(file->fh, dimid, name, (size_t *)lenp);;
@@ -880,8 +915,14 @@ int PIOc_inq_dimid(int ncid, const char *name, int *idp)
             ierr = ncmpi_inq_dimid(file->fh, name, idp);
 #endif /* _PNETCDF */
 
+#ifdef _HDF5
+        if (file->iotype == PIO_IOTYPE_HDF5)
+            ierr = pio_hdf5_inq_dimid(file, name, idp);
+#endif /* _HDF5 */
+
 #ifdef _NETCDF
-        if (file->iotype != PIO_IOTYPE_PNETCDF && file->iotype != PIO_IOTYPE_ADIOS && file->do_io)
+        if (file->iotype != PIO_IOTYPE_PNETCDF && file->iotype != PIO_IOTYPE_ADIOS &&
+            file->iotype != PIO_IOTYPE_HDF5 && file->do_io)
             ierr = nc_inq_dimid(file->fh, name, idp);
 #endif /* _NETCDF */
     }
@@ -1052,8 +1093,34 @@ int PIOc_inq_var(int ncid, int varid, char *name, int namelen, nc_type *xtypep,
         }
 #endif /* _PNETCDF */
 
+#ifdef _HDF5
+        if (file->iotype == PIO_IOTYPE_HDF5)
+        {
+            int my_dimids[PIO_MAX_DIMS];
+
+            ierr = pio_hdf5_inq_var(file, varid, my_name, xtypep, &ndims, my_dimids, nattsp);
+            if (!ierr)
+            {
+                if (name)
+                    strcpy(name, my_name);
+                if (ndimsp)
+                    *ndimsp = ndims;
+                if (dimidsp)
+                {
+                    for (int d = 0; d < ndims; d++)
+                        dimidsp[d] = my_dimids[d];
+                }
+                for (int i = 0; i < ndims; i++)
+                    for (int j = 0; j < file->num_unlim_dimids; j++)
+                        if (my_dimids[i] == file->unlim_dimids[j])
+                            file->varlist[varid].rec_var = 1;
+            }
+        }
+#endif /* _HDF5 */
+
 #ifdef _NETCDF
-        if (file->iotype != PIO_IOTYPE_PNETCDF && file->iotype != PIO_IOTYPE_ADIOS && file->do_io)
+        if (file->iotype != PIO_IOTYPE_PNETCDF && file->iotype != PIO_IOTYPE_ADIOS &&
+            file->iotype != PIO_IOTYPE_HDF5 && file->do_io)
         {
             ierr = nc_inq_varndims(file->fh, varid, &ndims);
             LOG((3, "nc_inq_varndims called ndims = %d", ndims));
@@ -1363,8 +1430,14 @@ int PIOc_inq_varid(int ncid, const char *name, int *varidp)
             ierr = ncmpi_inq_varid(file->fh, name, varidp);
 #endif /* _PNETCDF */
 
+#ifdef _HDF5
+        if (file->iotype == PIO_IOTYPE_HDF5)
+            ierr = pio_hdf5_inq_varid(file, name, varidp);
+#endif /* _HDF5 */
+
 #ifdef _NETCDF
-        if (file->iotype != PIO_IOTYPE_PNETCDF && file->iotype != PIO_IOTYPE_ADIOS && file->do_io)
+        if (file->iotype != PIO_IOTYPE_PNETCDF && file->iotype != PIO_IOTYPE_ADIOS &&
+            file->iotype != PIO_IOTYPE_HDF5 && file->do_io)
             ierr = nc_inq_varid(file->fh, name, varidp);
 #endif /* _NETCDF */
     }
@@ -1522,8 +1595,15 @@ int PIOc_inq_att(int ncid, int varid, const char *name, nc_type *xtypep,
             ierr = ncmpi_inq_att(file->fh, varid, name, xtypep, lenp);
 #endif /* _PNETCDF */
 
+#ifdef _HDF5
+        /* Files written with PIO_IOTYPE_HDF5 are write only. */
+        if (file->iotype == PIO_IOTYPE_HDF5)
+            ierr = PIO_EBADIOTYPE;
+#endif /* _HDF5 */
+
 #ifdef _NETCDF
-        if (file->iotype != PIO_IOTYPE_PNETCDF && file->iotype != PIO_IOTYPE_ADIOS && file->do_io)
+        if (file->iotype != PIO_IOTYPE_PNETCDF && file->iotype != PIO_IOTYPE_ADIOS &&
+            file->iotype != PIO_IOTYPE_HDF5 && file->do_io)
             ierr = nc_inq_att(file->fh, varid, name, xtypep, (size_t *)lenp);
 #endif /* _NETCDF */
         LOG((2, "PIOc_inq netcdf call returned %d", ierr));
@@ -1650,8 +1730,15 @@ int PIOc_inq_attname(int ncid, int varid, int attnum, char *name)
             ierr = ncmpi_inq_attname(file->fh, varid, attnum, name);
 #endif /* _PNETCDF */
 
+#ifdef _HDF5
+        /* Files written with PIO_IOTYPE_HDF5 are write only. */
+        if (file->iotype == PIO_IOTYPE_HDF5)
+            ierr = PIO_EBADIOTYPE;
+#endif /* _HDF5 */
+
 #ifdef _NETCDF
-        if (file->iotype != PIO_IOTYPE_PNETCDF && file->iotype != PIO_IOTYPE_ADIOS && file->do_io)
+        if (file->iotype != PIO_IOTYPE_PNETCDF && file->iotype != PIO_IOTYPE_ADIOS &&
+            file->iotype != PIO_IOTYPE_HDF5 && file->do_io)
             ierr = nc_inq_attname(file->fh, varid, attnum, name);
 #endif /* _NETCDF */
         LOG((2, "PIOc_inq_attname netcdf call returned %d", ierr));
@@ -1754,8 +1841,15 @@ int PIOc_inq_attid(int ncid, int varid, const char *name, int *idp)
             ierr = ncmpi_inq_attid(file->fh, varid, name, idp);
 #endif /* _PNETCDF */
 
+#ifdef _HDF5
+        /* Files written with PIO_IOTYPE_HDF5 are write only. */
+        if (file->iotype == PIO_IOTYPE_HDF5)
+            ierr = PIO_EBADIOTYPE;
+#endif /* _HDF5 */
+
 #ifdef _NETCDF
-        if (file->iotype != PIO_IOTYPE_PNETCDF && file->iotype != PIO_IOTYPE_ADIOS && file->do_io)
+        if (file->iotype != PIO_IOTYPE_PNETCDF && file->iotype != PIO_IOTYPE_ADIOS &&
+            file->iotype != PIO_IOTYPE_HDF5 && file->do_io)
             ierr = nc_inq_attid(file->fh, varid, name, idp);
 #endif /* _NETCDF */
         LOG((2, "PIOc_inq_attname netcdf call returned %d", ierr));
@@ -1852,14 +1946,21 @@ int PIOc_rename_dim(int ncid, int dimid, const char *name)
             ierr = ncmpi_rename_dim(file->fh, dimid, name);
 #endif /* _PNETCDF */
 
+#ifdef _HDF5
+        /* Files written with PIO_IOTYPE_HDF5 are write only. */
+        if (file->iotype == PIO_IOTYPE_HDF5)
+            ierr = PIO_EBADIOTYPE;
+#endif /* _HDF5 */
+
 #ifdef _NETCDF
-        if (file->iotype != PIO_IOTYPE_PNETCDF && file->iotype != PIO_IOTYPE_ADIOS && file->do_io)
+        if (file->iotype != PIO_IOTYPE_PNETCDF && file->iotype != PIO_IOTYPE_ADIOS &&
+            file->iotype != PIO_IOTYPE_HDF5 && file->do_io)
             ierr = nc_rename_dim(file->fh, dimid, name);
 #endif /* _NETCDF */
         LOG((2, "PIOc_inq netcdf call returned %d", ierr));
     }
 
-    ierr = check_netcdf(NULL, file, ierr, __FILE__, __LINE__);
+    ierr = check_netcdf_defer(file, ierr, __FILE__, __LINE__);
     if(ierr != PIO_NOERR){
         LOG((1, "nc*_rename_dim failed, ierr = %d", ierr));
         return ierr;
@@ -1941,14 +2042,21 @@ int PIOc_rename_var(int ncid, int varid, const char *name)
             ierr = ncmpi_rename_var(file->fh, varid, name);
 #endif /* _PNETCDF */
 
+#ifdef _HDF5
+        /* Files written with PIO_IOTYPE_HDF5 are write only. */
+        if (file->iotype == PIO_IOTYPE_HDF5)
+            ierr = PIO_EBADIOTYPE;
+#endif /* _HDF5 */
+
 #ifdef _NETCDF
-        if (file->iotype != PIO_IOTYPE_PNETCDF && file->iotype != PIO_IOTYPE_ADIOS && file->do_io)
+        if (file->iotype != PIO_IOTYPE_PNETCDF && file->iotype != PIO_IOTYPE_ADIOS &&
+            file->iotype != PIO_IOTYPE_HDF5 && file->do_io)
             ierr = nc_rename_var(file->fh, varid, name);
 #endif /* _NETCDF */
         LOG((2, "PIOc_inq netcdf call returned %d", ierr));
     }
 
-    ierr = check_netcdf(NULL, file, ierr, __FILE__, __LINE__);
+    ierr = check_netcdf_defer(file, ierr, __FILE__, __LINE__);
     if(ierr != PIO_NOERR){
         LOG((1, "nc*_rename_var failed, ierr = %d", ierr));
         return ierr;
@@ -2040,13 +2148,20 @@ int PIOc_rename_att(int ncid, int varid, const char *name,
             ierr = ncmpi_rename_att(file->fh, varid, name, newname);
 #endif /* _PNETCDF */
 
+#ifdef _HDF5
+        /* Files written with PIO_IOTYPE_HDF5 are write only. */
+        if (file->iotype == PIO_IOTYPE_HDF5)
+            ierr = PIO_EBADIOTYPE;
+#endif /* _HDF5 */
+
 #ifdef _NETCDF
-        if (file->iotype != PIO_IOTYPE_PNETCDF && file->iotype != PIO_IOTYPE_ADIOS && file->do_io)
+        if (file->iotype != PIO_IOTYPE_PNETCDF && file->iotype != PIO_IOTYPE_ADIOS &&
+            file->iotype != PIO_IOTYPE_HDF5 && file->do_io)
             ierr = nc_rename_att(file->fh, varid, name, newname);
 #endif /* _NETCDF */
     }
 
-    ierr = check_netcdf(NULL, file, ierr, __FILE__, __LINE__);
+    ierr = check_netcdf_defer(file, ierr, __FILE__, __LINE__);
     if(ierr != PIO_NOERR){
         LOG((1, "nc*_rename_att failed, ierr = %d", ierr));
         return ierr;
@@ -2130,13 +2245,20 @@ int PIOc_del_att(int ncid, int varid, const char *name)
             ierr = ncmpi_del_att(file->fh, varid, name);
 #endif /* _PNETCDF */
 
+#ifdef _HDF5
+        /* Files written with PIO_IOTYPE_HDF5 are write only. */
+        if (file->iotype == PIO_IOTYPE_HDF5)
+            ierr = PIO_EBADIOTYPE;
+#endif /* _HDF5 */
+
 #ifdef _NETCDF
-        if (file->iotype != PIO_IOTYPE_PNETCDF && file->iotype != PIO_IOTYPE_ADIOS && file->do_io)
+        if (file->iotype != PIO_IOTYPE_PNETCDF && file->iotype != PIO_IOTYPE_ADIOS &&
+            file->iotype != PIO_IOTYPE_HDF5 && file->do_io)
             ierr = nc_del_att(file->fh, varid, name);
 #endif /* _NETCDF */
     }
 
-    ierr = check_netcdf(NULL, file, ierr, __FILE__, __LINE__);
+    ierr = check_netcdf_defer(file, ierr, __FILE__, __LINE__);
     if(ierr != PIO_NOERR){
         LOG((1, "nc*_del_att failed, ierr = %d", ierr));
         return ierr;
@@ -2216,8 +2338,14 @@ int PIOc_set_fill(int ncid, int fillmode, int *old_modep)
         }
 #endif /* _PNETCDF */
 
+#ifdef _HDF5
+        if (file->iotype == PIO_IOTYPE_HDF5)
+            ierr = pio_hdf5_set_fill(file, fillmode, old_modep);
+#endif /* _HDF5 */
+
 #ifdef _NETCDF
-        if (file->iotype != PIO_IOTYPE_PNETCDF && file->iotype != PIO_IOTYPE_ADIOS && file->do_io)
+        if (file->iotype != PIO_IOTYPE_PNETCDF && file->iotype != PIO_IOTYPE_ADIOS &&
+            file->iotype != PIO_IOTYPE_HDF5 && file->do_io)
             ierr = nc_set_fill(file->fh, fillmode, old_modep);
 #endif /* _NETCDF */
     }
@@ -2401,13 +2529,24 @@ int PIOc_def_dim(int ncid, const char *name, PIO_Offset len, int *idp)
             ierr = ncmpi_def_dim(file->fh, name, len, idp);
 #endif /* _PNETCDF */
 
+#ifdef _HDF5
+        if (file->iotype == PIO_IOTYPE_HDF5)
+            ierr = pio_hdf5_def_dim(file, name, len, idp);
+#endif /* _HDF5 */
+
 #ifdef _NETCDF
-        if (file->iotype != PIO_IOTYPE_PNETCDF && file->iotype != PIO_IOTYPE_ADIOS && file->do_io)
+        if (file->iotype != PIO_IOTYPE_PNETCDF && file->iotype != PIO_IOTYPE_ADIOS &&
+            file->iotype != PIO_IOTYPE_HDF5 && file->do_io)
             ierr = nc_def_dim(file->fh, name, (size_t)len, idp);
 #endif /* _NETCDF */
     }
 
-    ierr = check_netcdf(NULL, file, ierr, __FILE__, __LINE__);
+    /* With PIO_DEFER_ERROR the error is only recorded here, a
+     * failure on the IO root is detected by all tasks from the
+     * invalid dimension id broadcast below. */
+    if ((ierr != PIO_NOERR) && idp)
+        *idp = -1;
+    ierr = check_netcdf_defer(file, ierr, __FILE__, __LINE__);
     if(ierr != PIO_NOERR){
         LOG((1, "nc*_def_dim failed, ierr = %d", ierr));
         return ierr;
@@ -2415,9 +2554,15 @@ int PIOc_def_dim(int ncid, const char *name, PIO_Offset len, int *idp)
 
     /* Broadcast results to all tasks. Ignore NULL parameters. */
     if (idp)
+    {
         if ((mpierr = MPI_Bcast(idp , 1, MPI_INT, ios->ioroot, ios->my_comm)))
             check_mpi(NULL, file, mpierr, __FILE__, __LINE__);
 
+        /* The error is recorded on the IO root */
+        if (*idp < 0)
+            return pio_check_deferred_errors(file);
+    }
+
     if(len == PIO_UNLIMITED)
     {
         file->num_unlim_dimids++;
@@ -2649,8 +2794,23 @@ int PIOc_def_var(int ncid, const char *name, nc_type xtype, int ndims,
         }
 #endif /* _PNETCDF */
 
+#ifdef _HDF5
+        if (file->iotype == PIO_IOTYPE_HDF5)
+        {
+            ierr = pio_hdf5_def_var(file, name, xtype, ndims, dimidsp, varidp);
+            if (ierr != PIO_NOERR)
+            {
+                char errmsg[PIO_MAX_NAME];
+                ierr2 = PIOc_strerror(ierr, errmsg);
+                ierr = pio_err(ios, file, ierr, __FILE__, __LINE__,
+                                "Defining variable %s (ndims = %d) in file %s (ncid=%d, iotype=%s) failed. %s", name, ndims, pio_get_fname_from_file(file), ncid, pio_iotype_to_string(file->iotype), ((ierr2 == PIO_NOERR) ? errmsg : ""));
+            }
+        }
+#endif /* _HDF5 */
+
 #ifdef _NETCDF
-        if (file->iotype != PIO_IOTYPE_PNETCDF && file->iotype != PIO_IOTYPE_ADIOS && file->do_io)
+        if (file->iotype != PIO_IOTYPE_PNETCDF && file->iotype != PIO_IOTYPE_ADIOS &&
+            file->iotype != PIO_IOTYPE_HDF5 && file->do_io)
         {
             ierr = nc_def_var(file->fh, name, xtype, ndims, dimidsp, varidp);
             if (ierr != PIO_NOERR)
@@ -2695,7 +2855,12 @@ int PIOc_def_var(int ncid, const char *name, nc_type xtype, int ndims,
 
     }
 
-    ierr = check_netcdf(NULL, file, ierr, __FILE__, __LINE__);
+    /* With PIO_DEFER_ERROR the error is only recorded here, a
+     * failure on the IO root is detected by all tasks from the
+     * invalid variable id broadcast below. */
+    if ((ierr != PIO_NOERR) && varidp)
+        *varidp = -1;
+    ierr = check_netcdf_defer(file, ierr, __FILE__, __LINE__);
     if(ierr != PIO_NOERR){
         LOG((1, "nc*_def_var_* failed, ierr = %d", ierr));
         return ierr;
@@ -2704,9 +2869,15 @@ int PIOc_def_var(int ncid, const char *name, nc_type xtype, int ndims,
     /* Broadcast results. */
     /* FIXME: varidp should be valid, no need to check it here */
     if (varidp)
+    {
         if ((mpierr = MPI_Bcast(varidp, 1, MPI_INT, ios->ioroot, ios->my_comm)))
             check_mpi(NULL, file, mpierr, __FILE__, __LINE__);
 
+        /* The error is recorded on the IO root */
+        if (*varidp < 0)
+            return pio_check_deferred_errors(file);
+    }
+
     strncpy(file->varlist[*varidp].vname, name, PIO_MAX_NAME);
     if(file->num_unlim_dimids > 0)
     {
@@ -2885,13 +3056,19 @@ int PIOc_def_var_fill(int ncid, int varid, int fill_mode, const void *fill_value
             ierr = ncmpi_def_var_fill(file->fh, varid, fill_mode, (void *)fill_valuep);
 #endif /* _PNETCDF */
         }
-        else if (file->iotype == PIO_IOTYPE_NETCDF)
+        else if (PIO_IOTYPE_IS_NC_CLASSIC(file->iotype))
         {
 #ifdef _NETCDF
             LOG((2, "defining fill value attribute for netCDF classic file"));
             if (file->do_io)            
                 ierr = nc_put_att(file->fh, varid, _FillValue, xtype, 1, fill_valuep);
 #endif /* _NETCDF */
+        }
+        else if (file->iotype == PIO_IOTYPE_HDF5)
+        {
+#ifdef _HDF5
+            ierr = pio_hdf5_def_var_fill(file, varid, fill_mode, fill_valuep);
+#endif /* _HDF5 */
         }
         else
         {
@@ -2912,7 +3089,7 @@ int PIOc_def_var_fill(int ncid, int varid, int fill_mode, const void *fill_value
     }
 #endif
 
-    ierr = check_netcdf(NULL, file, ierr, __FILE__, __LINE__);
+    ierr = check_netcdf_defer(file, ierr, __FILE__, __LINE__);
     if(ierr != PIO_NOERR){
         LOG((1, "nc*_def_var_fill failed, ierr = %d", ierr));
         return ierr;
@@ -3012,7 +3189,7 @@ int PIOc_inq_var_fill(int ncid, int varid, int *no_fill, void *fill_valuep)
             ierr = ncmpi_inq_var_fill(file->fh, varid, no_fill, fill_valuep);
 #endif /* _PNETCDF */
         }
-        else if (file->iotype == PIO_IOTYPE_NETCDF && file->do_io)
+        else if (PIO_IOTYPE_IS_NC_CLASSIC(file->iotype) && file->do_io)
         {
 #ifdef _NETCDF
             /* Get the file-level fill mode. */
@@ -3064,6 +3241,12 @@ int PIOc_inq_var_fill(int ncid, int varid, int *no_fill, void *fill_valuep)
                 }
             }
 #endif /* _NETCDF */
+        }
+        else if (file->iotype == PIO_IOTYPE_HDF5)
+        {
+#ifdef _HDF5
+            ierr = pio_hdf5_inq_var_fill(file, varid, no_fill, fill_valuep);
+#endif /* _HDF5 */
         }
         else
         {
@@ -3786,6 +3969,8 @@ int PIOc_copy_att(int incid, int ivarid, const char *name,
     case PIO_IOTYPE_NETCDF:
     case PIO_IOTYPE_NETCDF4C:
     case PIO_IOTYPE_NETCDF4P:
+    case PIO_IOTYPE_MEMORY:
+    case PIO_IOTYPE_NULL:
           if(ios->ioproc && ifile->do_io){
             ierr = nc_copy_att(ifile->fh, ivarid, name,
                     ofile->fh, ovarid);
@@ -85,7 +85,7 @@ int PIOc_def_var_deflate(int ncid, int varid, int shuffle, int deflate,
 #endif
     }
 
-    ierr = check_netcdf(NULL, file, ierr, __FILE__, __LINE__);
+    ierr = check_netcdf_defer(file, ierr, __FILE__, __LINE__);
     if(ierr != PIO_NOERR){
         LOG((1, "nc_def_var_deflate failed, ierr = %d", ierr));
         return ierr;
@@ -308,7 +308,7 @@ int PIOc_def_var_chunking(int ncid, int varid, int storage, const PIO_Offset *ch
 #endif
     }
 
-    ierr = check_netcdf(NULL, file, ierr, __FILE__, __LINE__);
+    ierr = check_netcdf_defer(file, ierr, __FILE__, __LINE__);
     if(ierr != PIO_NOERR){
         LOG((1, "nc_def_var_chunking failed, ierr = %d", ierr));
         return ierr;
@@ -317,6 +317,279 @@ int PIOc_def_var_chunking(int ncid, int varid, int storage, const PIO_Offset *ch
     return PIO_NOERR;
 }
 
+/**
+ * Greatest common divisor of two non-negative offsets, gcd(0, b) is
+ * b.
+ *
+ * @param a the first offset.
+ * @param b the second offset.
+ * @return the greatest common divisor of a and b.
+ */
+static PIO_Offset pio_offset_gcd(PIO_Offset a, PIO_Offset b)
+{
+    while (b)
+    {
+        PIO_Offset t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/**
+ * Find the chunksizes, along the dimensions of a decomposition, of
+ * the largest chunks that tile the I/O regions of all the IO tasks,
+ * i.e. the chunks whose boundaries include all the region boundaries
+ * in the interior of the array. Each chunk is then written by a
+ * single IO task. This function is collective across the IO tasks.
+ *
+ * Uneven splits of the array between the IO tasks (and the many small
+ * regions of the subset rearranger) can make these chunks tiny, down
+ * to a single element. If the chunks are smaller than
+ * PIO_MIN_CHUNK_BYTES, and than the data of an IO task, no chunksizes
+ * are chosen (all the chunksizes are 0).
+ *
+ * @param ios pointer to the IO system info.
+ * @param iodesc pointer to the decomposition info.
+ * @param type_size the size of the type of the variable in bytes.
+ * @param chunksizes array (of length iodesc->ndims) that gets the
+ * chunksizes.
+ * @return PIO_NOERR for success, otherwise an error code.
+ */
+static int pio_decomp_chunksizes(iosystem_desc_t *ios, io_desc_t *iodesc,
+                                 PIO_Offset type_size, PIO_Offset *chunksizes)
+{
+    /* HDF5 limits the size of a chunk to 4 GiB. */
+    const PIO_Offset max_chunk_bytes = ((PIO_Offset)1 << 32) - 1;
+    int ndims = iodesc->ndims;
+    PIO_Offset *all_gcds;
+    PIO_Offset nbytes;
+    PIO_Offset iotask_bytes;
+    int mpierr;
+
+    assert(ios && ios->ioproc && iodesc && chunksizes);
+
+    for (int d = 0; d < ndims; d++)
+        chunksizes[d] = 0;
+
+    for (int r = 0; r < iodesc->regions->nregions; r++)
+    {
+        const PIO_Offset *start = REGION_START(iodesc->regions, r);
+        const PIO_Offset *count = REGION_COUNT(iodesc->regions, r);
+        int empty = 0;
+
+        for (int d = 0; d < ndims; d++)
+            if (count[d] == 0)
+                empty = 1;
+        if (empty)
+            continue;
+
+        for (int d = 0; d < ndims; d++)
+        {
+            PIO_Offset end = start[d] + count[d];
+
+            chunksizes[d] = pio_offset_gcd(chunksizes[d], start[d]);
+            if (end < iodesc->dimlen[d])
+                chunksizes[d] = pio_offset_gcd(chunksizes[d], end);
+        }
+    }
+
+    if (!(all_gcds = malloc(ios->num_iotasks * ndims * sizeof(PIO_Offset))))
+        return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
+                        "Finding the chunksizes of the decomposition (ioid=%d) failed. Out of memory allocating %lld bytes for the region boundaries", iodesc->ioid, (long long)(ios->num_iotasks * ndims * sizeof(PIO_Offset)));
+
+    if ((mpierr = MPI_Allgather(chunksizes, ndims, MPI_OFFSET, all_gcds, ndims, MPI_OFFSET,
+                                ios->io_comm)))
+    {
+        free(all_gcds);
+        return check_mpi(ios, NULL, mpierr, __FILE__, __LINE__);
+    }
+
+    /* Dimensions without boundaries in the interior of the array
+     * are not split. */
+    for (int d = 0; d < ndims; d++)
+    {
+        chunksizes[d] = 0;
+        for (int i = 0; i < ios->num_iotasks; i++)
+            chunksizes[d] = pio_offset_gcd(chunksizes[d], all_gcds[i * ndims + d]);
+        if (chunksizes[d] == 0)
+            chunksizes[d] = iodesc->dimlen[d];
+    }
+    free(all_gcds);
+
+    /* Give up on chunks that are too small. */
+    nbytes = type_size;
+    iotask_bytes = type_size;
+    for (int d = 0; d < ndims; d++)
+    {
+        nbytes *= chunksizes[d];
+        iotask_bytes *= iodesc->dimlen[d];
+    }
+    iotask_bytes /= ios->num_iotasks;
+    if (nbytes < PIO_MIN_CHUNK_BYTES && nbytes < iotask_bytes)
+    {
+        LOG((2, "pio_decomp_chunksizes ioid = %d chunk bytes = %lld too small", iodesc->ioid,
+             (long long)nbytes));
+        for (int d = 0; d < ndims; d++)
+            chunksizes[d] = 0;
+        return PIO_NOERR;
+    }
+
+    /* Split the chunks that are too large by divisors of the
+     * chunksizes, starting with the slowest varying dimension, so the
+     * chunks still tile the regions. */
+    for (int d = 0; d < ndims && nbytes > max_chunk_bytes; d++)
+    {
+        while (nbytes > max_chunk_bytes && chunksizes[d] > 1)
+        {
+            PIO_Offset p = 2;
+
+            while (chunksizes[d] % p)
+                p++;
+            nbytes /= p;
+            chunksizes[d] /= p;
+        }
+    }
+
+    LOG((2, "pio_decomp_chunksizes ioid = %d chunk bytes = %lld", iodesc->ioid,
+         (long long)nbytes));
+
+    return PIO_NOERR;
+}
+
+/**
+ * @ingroup PIO_def_var
+ * Set the chunksizes of a variable from the decomposition it will be
+ * written with.
+ *
+ * This function only applies to netCDF-4 files. When used with netCDF
+ * classic files, the error PIO_ENOTNC4 will be returned.
+ *
+ * The chunks are the largest chunks that tile the I/O regions (the
+ * boxes written by each IO task) of the decomposition, one record
+ * long for record variables. Each chunk is then written by a single
+ * IO task, so parallel writes (and compression) do not contend on
+ * the same chunks. If these chunks are too small, which happens
+ * with uneven splits of the array between the IO tasks and with the
+ * many small I/O regions of the subset rearranger, the variable keeps
+ * the default netCDF-4 storage (contiguous for fixed size variables,
+ * and the default chunksizes of the netCDF library for record
+ * variables).
+ *
+ * NetCDF-4 does not allow changing the chunking of a variable after
+ * enddef, so this function is called in define mode instead of when
+ * the variable is first written.
+ *
+ * @param ncid the ncid of the open file.
+ * @param varid the ID of the variable to set chunksizes for.
+ * @param ioid the ID of the decomposition the variable is written
+ * with. The variable must have the dimensions of the decomposition,
+ * preceded by the unlimited dimension for record variables.
+ * @return PIO_NOERR for success, otherwise an error code.
+ */
+int PIOc_def_var_chunking_auto(int ncid, int varid, int ioid)
+{
+    iosystem_desc_t *ios;  /* Pointer to io system information. */
+    file_desc_t *file;     /* Pointer to file information. */
+    io_desc_t *iodesc;     /* Pointer to decomposition information. */
+    int ndims;             /* The number of dimensions for this var. */
+    int dimids[PIO_MAX_DIMS];
+    int nrecdims;          /* 1 for record vars, 0 otherwise. */
+    nc_type xtype;
+    PIO_Offset type_size;
+    int ierr = PIO_NOERR;  /* Return code from function calls. */
+    int mpierr = MPI_SUCCESS;  /* Return code from MPI function codes. */
+
+    LOG((1, "PIOc_def_var_chunking_auto ncid = %d varid = %d ioid = %d", ncid,
+         varid, ioid));
+
+    /* Find the info about this file. */
+    if ((ierr = pio_get_file(ncid, &file)))
+    {
+        return pio_err(NULL, NULL, ierr, __FILE__, __LINE__,
+                        "Defining variable chunking parameters for variable (varid=%d) failed on file (ncid=%d). Unable to query the internal file structure associated with the file", varid, ncid);
+    }
+    ios = file->iosystem;
+
+    /* Only netCDF-4 files can use this feature. */
+    if (file->iotype != PIO_IOTYPE_NETCDF4P && file->iotype != PIO_IOTYPE_NETCDF4C)
+    {
+        return pio_err(ios, file, PIO_ENOTNC4, __FILE__, __LINE__,
+                        "Defining variable chunking parameters for variable %s (varid=%d) failed on file %s (ncid=%d). Unable to define variable chunking parameters on a non-NetCDF file. This option is only available for NetCDF4 files", pio_get_vname_from_file(file, varid), varid, pio_get_fname_from_file(file), ncid);
+    }
+
+    /* The I/O regions of the decomposition are only known on the
+     * IO tasks. */
+    if (ios->async)
+    {
+        return pio_err(ios, file, PIO_EINVAL, __FILE__, __LINE__,
+                        "Defining variable chunking parameters for variable %s (varid=%d) failed on file %s (ncid=%d). Choosing the chunksizes from the decomposition is not supported with asynchronous I/O", pio_get_vname_from_file(file, varid), varid, pio_get_fname_from_file(file), ncid);
+    }
+
+    if (!(iodesc = pio_get_iodesc_from_id(ioid)))
+    {
+        return pio_err(ios, file, PIO_EBADID, __FILE__, __LINE__,
+                        "Defining variable chunking parameters for variable %s (varid=%d) failed on file %s (ncid=%d). Invalid I/O descriptor id (ioid=%d) provided", pio_get_vname_from_file(file, varid), varid, pio_get_fname_from_file(file), ncid, ioid);
+    }
+
+    if ((ierr = PIOc_inq_varndims(ncid, varid, &ndims)))
+        return ierr;
+    if ((ierr = PIOc_inq_vardimid(ncid, varid, dimids)))
+        return ierr;
+    if ((ierr = PIOc_inq_vartype(ncid, varid, &xtype)))
+        return ierr;
+    if ((ierr = PIOc_inq_type(ncid, xtype, NULL, &type_size)))
+        return ierr;
+
+    /* Check that the var has the dimensions of the decomposition. */
+    nrecdims = ndims - iodesc->ndims;
+    if (nrecdims == 1)
+    {
+        int unlimdimid;
+
+        if ((ierr = PIOc_inq_unlimdim(ncid, &unlimdimid)))
+            return ierr;
+        if (dimids[0] != unlimdimid)
+            nrecdims = -1;
+    }
+    for (int d = 0; nrecdims >= 0 && nrecdims <= 1 && d < iodesc->ndims; d++)
+    {
+        PIO_Offset dimlen;
+
+        if ((ierr = PIOc_inq_dimlen(ncid, dimids[nrecdims + d], &dimlen)))
+            return ierr;
+        if (dimlen != iodesc->dimlen[d])
+            nrecdims = -1;
+    }
+    if (nrecdims < 0 || nrecdims > 1)
+    {
+        return pio_err(ios, file, PIO_EINVAL, __FILE__, __LINE__,
+                        "Defining variable chunking parameters for variable %s (varid=%d) failed on file %s (ncid=%d). The dimensions of the variable do not match the dimensions of the decomposition (ioid=%d)", pio_get_vname_from_file(file, varid), varid, pio_get_fname_from_file(file), ncid, ioid);
+    }
+
+    {
+        PIO_Offset chunksizes[ndims];
+
+        chunksizes[0] = 1;
+        if (ios->ioproc)
+            ierr = pio_decomp_chunksizes(ios, iodesc, type_size, chunksizes + nrecdims);
+
+        if ((mpierr = MPI_Bcast(&ierr, 1, MPI_INT, ios->ioroot, ios->my_comm)))
+            return check_mpi(NULL, file, mpierr, __FILE__, __LINE__);
+        if (ierr)
+            return pio_err(ios, file, ierr, __FILE__, __LINE__,
+                            "Defining variable chunking parameters for variable %s (varid=%d) failed on file %s (ncid=%d). Finding the chunksizes from the decomposition (ioid=%d) failed", pio_get_vname_from_file(file, varid), varid, pio_get_fname_from_file(file), ncid, ioid);
+        if ((mpierr = MPI_Bcast(chunksizes, ndims, MPI_OFFSET, ios->ioroot, ios->my_comm)))
+            return check_mpi(NULL, file, mpierr, __FILE__, __LINE__);
+
+        /* Keep the default storage if the chunks are too small. */
+        if (chunksizes[nrecdims] == 0)
+            return PIO_NOERR;
+
+        return PIOc_def_var_chunking(ncid, varid, NC_CHUNKED, chunksizes);
+    }
+}
+
 /**
  * Inquire about chunksizes for a variable.
  *
@@ -505,7 +778,7 @@ int PIOc_def_var_endian(int ncid, int varid, int endian)
 #endif
     }
 
-    ierr = check_netcdf(NULL, file, ierr, __FILE__, __LINE__);
+    ierr = check_netcdf_defer(file, ierr, __FILE__, __LINE__);
     if(ierr != PIO_NOERR){
         LOG((1, "nc_def_var_endian failed, ierr = %d", ierr));
         return ierr;
@@ -597,8 +870,9 @@ int PIOc_inq_var_endian(int ncid, int varid, int *endianp)
 /**
  * Set chunk cache netCDF files to be opened/created.
  *
- * This function only applies to netCDF-4 files. When used with netCDF
- * classic files, the error PIO_ENOTNC4 will be returned.
+ * This function only applies to netCDF-4 files (and files created
+ * with PIO_IOTYPE_HDF5). When used with netCDF classic files, the
+ * error PIO_ENOTNC4 will be returned.
  *
  * The file chunk cache for HDF5 can be set, and will apply for any
  * files opened or created until the program ends, or the settings are
@@ -636,7 +910,8 @@ int PIOc_set_chunk_cache(int iosysid, int iotype, PIO_Offset size, PIO_Offset ne
     }
 
     /* Only netCDF-4 files can use this feature. */
-    if (iotype != PIO_IOTYPE_NETCDF4P && iotype != PIO_IOTYPE_NETCDF4C)
+    if (iotype != PIO_IOTYPE_NETCDF4P && iotype != PIO_IOTYPE_NETCDF4C &&
+        iotype != PIO_IOTYPE_HDF5)
     {
         return pio_err(ios, NULL, PIO_ENOTNC4, __FILE__, __LINE__,
                         "Setting cache chunk parameters failed. Unable to set cache chunk parameters on a non-NetCDF4 iotype. The usage is only supported for NetCDF4 iotypes");
@@ -656,8 +931,16 @@ int PIOc_set_chunk_cache(int iosysid, int iotype, PIO_Offset size, PIO_Offset ne
         }
     }
 
-    /* If this is an IO task, then call the netCDF function. */
-    if (ios->ioproc)
+    /* If this is an IO task, then call the netCDF function. The
+     * chunk cache of files created with PIO_IOTYPE_HDF5 is set when
+     * the files are created. */
+    if (ios->ioproc && iotype == PIO_IOTYPE_HDF5)
+    {
+        ios->hdf5_chunk_cache_size = size;
+        ios->hdf5_chunk_cache_nelems = nelems;
+        ios->hdf5_chunk_cache_preemption = preemption;
+    }
+    else if (ios->ioproc)
     {
 #ifdef _NETCDF4
         LOG((2, "calling nc_chunk_cache"));
@@ -859,7 +1142,7 @@ int PIOc_set_var_chunk_cache(int ncid, int varid, PIO_Offset size, PIO_Offset ne
 #endif
     }
 
-    ierr = check_netcdf(NULL, file, ierr, __FILE__, __LINE__);
+    ierr = check_netcdf_defer(file, ierr, __FILE__, __LINE__);
     if(ierr != PIO_NOERR){
         LOG((1, "nc_set_var_chunk_cache failed, ierr = %d", ierr));
         return ierr;
@@ -962,3 +1245,62 @@ int PIOc_get_var_chunk_cache(int ncid, int varid, PIO_Offset *sizep, PIO_Offset
 
     return PIO_NOERR;
 }
+
+/**
+ * Set the HDF5 file properties used for files created with
+ * PIO_IOTYPE_HDF5 in an IO system.
+ *
+ * Objects (e.g. the datasets of variables) larger than
+ * align_threshold bytes are aligned to alignment bytes in the file,
+ * aligning them to the stripe size of parallel file systems avoids
+ * writes that span two stripes. The metadata of the files is
+ * aggregated into blocks of meta_block_size bytes. Use 0 to keep the
+ * HDF5 defaults. The chunk cache of the files is set with
+ * PIOc_set_chunk_cache().
+ *
+ * The properties apply to the files created after the call. This
+ * function is not supported with asynchronous I/O.
+ *
+ * @param iosysid the IO system ID.
+ * @param align_threshold the minimum size, in bytes, of aligned
+ * objects.
+ * @param alignment the alignment in bytes, 0 to not align objects.
+ * @param meta_block_size the size, in bytes, of the metadata blocks,
+ * 0 for the HDF5 default.
+ * @return PIO_NOERR for success, otherwise an error code.
+ * @ingroup PIO_createfile
+ */
+int PIOc_set_hdf5_props(int iosysid, PIO_Offset align_threshold, PIO_Offset alignment,
+                        PIO_Offset meta_block_size)
+{
+    iosystem_desc_t *ios;  /* Pointer to io system information. */
+
+    LOG((1, "PIOc_set_hdf5_props iosysid = %d align_threshold = %lld alignment = %lld "
+         "meta_block_size = %lld", iosysid, (long long)align_threshold, (long long)alignment,
+         (long long)meta_block_size));
+
+    /* Get the IO system info. */
+    if (!(ios = pio_get_iosystem_from_id(iosysid)))
+    {
+        return pio_err(NULL, NULL, PIO_EBADID, __FILE__, __LINE__,
+                        "Setting HDF5 file properties failed. Invalid iosystem (iosysid=%d) provided", iosysid);
+    }
+
+    if (align_threshold < 0 || alignment < 0 || meta_block_size < 0)
+    {
+        return pio_err(ios, NULL, PIO_EINVAL, __FILE__, __LINE__,
+                        "Setting HDF5 file properties failed. Invalid (negative) alignment threshold (%lld), alignment (%lld) or metadata block size (%lld) provided", (long long)align_threshold, (long long)alignment, (long long)meta_block_size);
+    }
+
+    if (ios->async)
+    {
+        return pio_err(ios, NULL, PIO_EINVAL, __FILE__, __LINE__,
+                        "Setting HDF5 file properties failed. Setting the properties is not supported with asynchronous I/O");
+    }
+
+    ios->hdf5_align_threshold = align_threshold;
+    ios->hdf5_alignment = alignment;
+    ios->hdf5_meta_block_size = meta_block_size;
+
+    return PIO_NOERR;
+}
@@ -0,0 +1,608 @@
+/**
+ * @file
+ * Packed messages for the rearrangers.
+ *
+ * By default the data exchanged between the compute and IO tasks is
+ * described by MPI derived datatypes (see create_mpi_datatypes()),
+ * which many MPI libraries pack one element at a time. When packed
+ * messages are enabled for an IO system (PIOc_set_rearr_pack()) the
+ * indexes of each message are instead turned, once, into a list of
+ * runs of consecutive elements (a pack list). The sender gathers the
+ * runs of each message into a contiguous buffer, the messages are
+ * exchanged as plain bytes with pio_swapm(), and the receiver
+ * scatters each message along its own runs.
+ *
+ * The gather and scatter kernels are specialized for elements of 1,
+ * 2, 4 and 8 bytes, so that the compiler can vectorize the copy of
+ * each run. The data of the variables of a multi-variable message is
+ * stored one variable after another.
+ *
+ * When the library is built with OpenMP, the IO tasks pack and unpack
+ * their messages concurrently with the threads set with
+ * PIOc_set_io_nthreads().
+ */
+#include <pio_config.h>
+#include <pio.h>
+#include <pio_internal.h>
+
+#include <stdint.h>
+
+/**
+ * Define the kernels that gather (pack) and scatter (unpack) runs of
+ * elements of type T.
+ *
+ * @param suffix suffix of the kernel names.
+ * @param T the type of the elements.
+ */
+#define PIO_PACK_KERNELS(suffix, T)                                     \
+    static void pack_##suffix(void *dst, const void *src, int nruns,    \
+                              const int *start, const int *len)         \
+    {                                                                   \
+        T *restrict d = dst;                                            \
+        const T *restrict s = src;                                      \
+                                                                        \
+        for (int r = 0; r < nruns; r++)                                 \
+        {                                                               \
+            const T *restrict p = s + start[r];                         \
+            int n = len[r];                                             \
+                                                                        \
+            for (int k = 0; k < n; k++)                                 \
+                d[k] = p[k];                                            \
+            d += n;                                                     \
+        }                                                               \
+    }                                                                   \
+                                                                        \
+    static void unpack_##suffix(void *dst, const void *src, int nruns,  \
+                                const int *start, const int *len)       \
+    {                                                                   \
+        T *restrict d = dst;                                            \
+        const T *restrict s = src;                                      \
+                                                                        \
+        for (int r = 0; r < nruns; r++)                                 \
+        {                                                               \
+            T *restrict p = d + start[r];                               \
+            int n = len[r];                                             \
+                                                                        \
+            for (int k = 0; k < n; k++)                                 \
+                p[k] = s[k];                                            \
+            s += n;                                                     \
+        }                                                               \
+    }
+
+PIO_PACK_KERNELS(1, uint8_t)
+PIO_PACK_KERNELS(2, uint16_t)
+PIO_PACK_KERNELS(4, uint32_t)
+PIO_PACK_KERNELS(8, uint64_t)
+
+/**
+ * Gather runs of elements of any size into a contiguous buffer.
+ *
+ * @param dst pointer to the contiguous buffer.
+ * @param src pointer to the buffer the runs are in.
+ * @param elsize size of one element in bytes.
+ * @param nruns number of runs.
+ * @param start array (length nruns) of the first element of each run.
+ * @param len array (length nruns) of the number of elements in each run.
+ */
+static void pack_any(void *dst, const void *src, int elsize, int nruns,
+                     const int *start, const int *len)
+{
+    char *d = dst;
+
+    for (int r = 0; r < nruns; r++)
+    {
+        memcpy(d, (const char *)src + (size_t)start[r] * elsize, (size_t)len[r] * elsize);
+        d += (size_t)len[r] * elsize;
+    }
+}
+
+/**
+ * Scatter a contiguous buffer into runs of elements of any size.
+ *
+ * @param dst pointer to the buffer the runs are in.
+ * @param src pointer to the contiguous buffer.
+ * @param elsize size of one element in bytes.
+ * @param nruns number of runs.
+ * @param start array (length nruns) of the first element of each run.
+ * @param len array (length nruns) of the number of elements in each run.
+ */
+static void unpack_any(void *dst, const void *src, int elsize, int nruns,
+                       const int *start, const int *len)
+{
+    const char *s = src;
+
+    for (int r = 0; r < nruns; r++)
+    {
+        memcpy((char *)dst + (size_t)start[r] * elsize, s, (size_t)len[r] * elsize);
+        s += (size_t)len[r] * elsize;
+    }
+}
+
+/**
+ * Create the pack list of the messages of a decomposition. The
+ * messages are described the same way as for create_mpi_datatypes().
+ *
+ * @param msgcnt the number of messages.
+ * @param mindex an array of the indexes of all the messages. May be
+ * NULL when all the counts are zero.
+ * @param mcount an array (length msgcnt) with the number of indexes
+ * in each message.
+ * @param mfrom an array with the message of each index, or NULL if
+ * the indexes of each message are contiguous in mindex (BOX
+ * rearranger).
+ * @param listp pointer that gets the pack list.
+ * @returns 0 on success, error code otherwise.
+ */
+int create_pack_list(int msgcnt, const int *mindex, const int *mcount,
+                     const int *mfrom, pio_pack_list **listp)
+{
+    pio_pack_list *list;
+    int numinds = 0;
+    int nruns = 0;
+    int pos = 0;
+
+    pioassert(msgcnt > 0 && mcount && listp, "invalid input", __FILE__, __LINE__);
+
+    for (int i = 0; i < msgcnt; i++)
+        numinds += mcount[i];
+    LOG((1, "create_pack_list msgcnt = %d numinds = %d", msgcnt, numinds));
+
+    if (!(list = calloc(1, sizeof(pio_pack_list))))
+        return pio_err(NULL, NULL, PIO_ENOMEM, __FILE__, __LINE__,
+                        "Creating pack list for rearranging data failed. Out of memory allocating %lld bytes for the pack list", (unsigned long long) sizeof(pio_pack_list));
+    list->nmsgs = msgcnt;
+
+    /* There are at most as many runs as indexes. */
+    if (!(list->first = malloc((msgcnt + 1) * sizeof(int))) ||
+        !(list->start = malloc((numinds ? numinds : 1) * sizeof(int))) ||
+        !(list->len = malloc((numinds ? numinds : 1) * sizeof(int))))
+    {
+        free_pack_list(list);
+        return pio_err(NULL, NULL, PIO_ENOMEM, __FILE__, __LINE__,
+                        "Creating pack list for rearranging data failed. Out of memory allocating %lld bytes for the runs of %d indexes", (unsigned long long) (2 * numinds * sizeof(int)), numinds);
+    }
+
+    for (int i = 0; i < msgcnt; i++)
+    {
+        list->first[i] = nruns;
+        if (mcount[i] > 0)
+        {
+            nruns += find_index_runs(i, numinds, pos, mindex, mcount[i], mfrom,
+                                     list->start + nruns, list->len + nruns);
+            pos += mcount[i];
+        }
+    }
+    list->first[msgcnt] = nruns;
+    LOG((2, "create_pack_list nruns = %d", nruns));
+
+    /* Give back the memory of the merged indexes. */
+    if (nruns && nruns < numinds)
+    {
+        int *start, *len;
+
+        if ((start = realloc(list->start, nruns * sizeof(int))))
+            list->start = start;
+        if ((len = realloc(list->len, nruns * sizeof(int))))
+            list->len = len;
+    }
+
+    *listp = list;
+
+    return PIO_NOERR;
+}
+
+/**
+ * Free a pack list.
+ *
+ * @param list pointer to the pack list. May be NULL.
+ */
+void free_pack_list(pio_pack_list *list)
+{
+    if (!list)
+        return;
+
+    free(list->first);
+    free(list->start);
+    free(list->len);
+    free(list);
+}
+
+/**
+ * Gather the data of one message into a contiguous buffer. The data
+ * of each variable is stored after the data of the previous one.
+ *
+ * @param list pointer to the pack list.
+ * @param msg the message.
+ * @param elsize size of one element in bytes.
+ * @param nvars number of variables.
+ * @param stride number of bytes between the data of consecutive
+ * variables in src.
+ * @param src pointer to the data.
+ * @param dst pointer to the contiguous buffer.
+ */
+void pack_data(const pio_pack_list *list, int msg, int elsize, int nvars,
+               PIO_Offset stride, const void *src, void *dst)
+{
+    int nruns = list->first[msg + 1] - list->first[msg];
+    const int *start = list->start + list->first[msg];
+    const int *len = list->len + list->first[msg];
+    size_t nbytes = 0;
+
+    for (int r = 0; r < nruns; r++)
+        nbytes += (size_t)len[r] * elsize;
+
+    for (int v = 0; v < nvars; v++)
+    {
+        const char *s = (const char *)src + v * stride;
+        char *d = (char *)dst + v * nbytes;
+
+        switch (elsize)
+        {
+        case 1:
+            pack_1(d, s, nruns, start, len);
+            break;
+        case 2:
+            pack_2(d, s, nruns, start, len);
+            break;
+        case 4:
+            pack_4(d, s, nruns, start, len);
+            break;
+        case 8:
+            pack_8(d, s, nruns, start, len);
+            break;
+        default:
+            pack_any(d, s, elsize, nruns, start, len);
+        }
+    }
+}
+
+/**
+ * Scatter the contiguous data of one message. This is the reverse of
+ * pack_data().
+ *
+ * @param list pointer to the pack list.
+ * @param msg the message.
+ * @param elsize size of one element in bytes.
+ * @param nvars number of variables.
+ * @param stride number of bytes between the data of consecutive
+ * variables in dst.
+ * @param src pointer to the contiguous buffer.
+ * @param dst pointer to the data.
+ */
+void unpack_data(const pio_pack_list *list, int msg, int elsize, int nvars,
+                 PIO_Offset stride, const void *src, void *dst)
+{
+    int nruns = list->first[msg + 1] - list->first[msg];
+    const int *start = list->start + list->first[msg];
+    const int *len = list->len + list->first[msg];
+    size_t nbytes = 0;
+
+    for (int r = 0; r < nruns; r++)
+        nbytes += (size_t)len[r] * elsize;
+
+    for (int v = 0; v < nvars; v++)
+    {
+        const char *s = (const char *)src + v * nbytes;
+        char *d = (char *)dst + v * stride;
+
+        switch (elsize)
+        {
+        case 1:
+            unpack_1(d, s, nruns, start, len);
+            break;
+        case 2:
+            unpack_2(d, s, nruns, start, len);
+            break;
+        case 4:
+            unpack_4(d, s, nruns, start, len);
+            break;
+        case 8:
+            unpack_8(d, s, nruns, start, len);
+            break;
+        default:
+            unpack_any(d, s, elsize, nruns, start, len);
+        }
+    }
+}
+
+/**
+ * Check that the packed messages of all tasks fit in the int byte
+ * displacements of pio_swapm(). This is collective over comm, so
+ * that all tasks return the error instead of some of them waiting
+ * in pio_swapm().
+ *
+ * @param ios pointer to the iosystem_desc_t struct.
+ * @param sbytes the total number of bytes of the messages sent.
+ * @param rbytes the total number of bytes of the messages received.
+ * @param comm communicator the data is transferred over.
+ * @returns 0 on success, error code otherwise.
+ */
+static int check_packed_size(iosystem_desc_t *ios, PIO_Offset sbytes, PIO_Offset rbytes,
+                             MPI_Comm comm)
+{
+    PIO_Offset nbytes = sbytes > rbytes ? sbytes : rbytes;
+    int mpierr;
+
+    if ((mpierr = MPI_Allreduce(MPI_IN_PLACE, &nbytes, 1, MPI_OFFSET, MPI_MAX, comm)))
+        return check_mpi(ios, NULL, mpierr, __FILE__, __LINE__);
+
+    if (nbytes > INT_MAX)
+        return pio_err(ios, NULL, PIO_EINVAL, __FILE__, __LINE__,
+                        "Rearranging data with packed messages failed. The messages of a task (%lld bytes) are larger than the maximum size (%d bytes) supported, disable packed messages (PIOc_set_rearr_pack()) for this decomposition", (long long)nbytes, INT_MAX);
+
+    return PIO_NOERR;
+}
+
+/**
+ * Moves data from compute tasks to IO tasks with packed messages.
+ * This is called from rearrange_comp2io() after the pack lists of
+ * the decomposition have been created.
+ *
+ * @param ios pointer to the iosystem_desc_t struct.
+ * @param iodesc a pointer to the io_desc_t struct.
+ * @param sbuf send buffer. May be NULL.
+ * @param rbuf receive buffer. May be NULL.
+ * @param nvars number of variables.
+ * @param mycomm communicator the data is transferred over.
+ * @param ntasks number of tasks in mycomm.
+ * @param niotasks number of IO tasks the compute tasks send to.
+ * @returns 0 on success, error code otherwise.
+ */
+int rearrange_comp2io_packed(iosystem_desc_t *ios, io_desc_t *iodesc, void *sbuf,
+                             void *rbuf, int nvars, MPI_Comm mycomm, int ntasks,
+                             int niotasks)
+{
+    int elsize = iodesc->mpitype_size;
+    int sendcounts[ntasks];
+    int recvcounts[ntasks];
+    int sdispls[ntasks];
+    int rdispls[ntasks];
+    MPI_Datatype types[ntasks];
+    int rdispl[iodesc->nrecvs > 0 ? iodesc->nrecvs : 1];
+    PIO_Offset sbytes = 0;
+    PIO_Offset rbytes = 0;
+    char *sendbuf = NULL;
+    char *recvbuf = NULL;
+    int ret;
+
+    pioassert(ios && iodesc && nvars > 0, "invalid input", __FILE__, __LINE__);
+    LOG((1, "rearrange_comp2io_packed nvars = %d ntasks = %d niotasks = %d", nvars,
+         ntasks, niotasks));
+
+    for (int i = 0; i < ntasks; i++)
+    {
+        sendcounts[i] = 0;
+        recvcounts[i] = 0;
+        sdispls[i] = 0;
+        rdispls[i] = 0;
+        types[i] = MPI_BYTE;
+    }
+
+    /* The IO tasks receive each message into its own part of the
+     * receive buffer. */
+    if (ios->ioproc)
+    {
+        for (int i = 0; i < iodesc->nrecvs; i++)
+        {
+            int from = iodesc->rearranger == PIO_REARR_SUBSET ? i : iodesc->rfrom[i];
+
+            rdispl[i] = (int)rbytes;
+            if (iodesc->rcount[i] > 0)
+            {
+                recvcounts[from] = iodesc->rcount[i] * nvars * elsize;
+                rdispls[from] = (int)rbytes;
+                rbytes += (PIO_Offset)iodesc->rcount[i] * nvars * elsize;
+            }
+        }
+    }
+
+    /* The compute tasks send each message from its own part of the
+     * send buffer. */
+    if (!ios->async || ios->compproc)
+    {
+        for (int i = 0; i < niotasks; i++)
+        {
+            int io_comprank = iodesc->rearranger == PIO_REARR_SUBSET ? 0 : ios->ioranks[i];
+
+            if (iodesc->scount[i] > 0 && sbuf)
+            {
+                sendcounts[io_comprank] = iodesc->scount[i] * nvars * elsize;
+                sdispls[io_comprank] = (int)sbytes;
+                sbytes += (PIO_Offset)iodesc->scount[i] * nvars * elsize;
+            }
+        }
+    }
+
+    if ((ret = check_packed_size(ios, sbytes, rbytes, mycomm)))
+        return ret;
+
+    if (ios->ioproc && rbytes > 0 && !(recvbuf = malloc(rbytes)))
+        return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
+                        "Rearranging data from compute to I/O processes failed. Out of memory allocating %lld bytes for packed messages", (long long)rbytes);
+
+    /* The compute tasks pack the data sent to each IO task. */
+    if ((!ios->async || ios->compproc) && sbytes > 0)
+    {
+        if (!(sendbuf = malloc(sbytes)))
+        {
+            free(recvbuf);
+            return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
+                            "Rearranging data from compute to I/O processes failed. Out of memory allocating %lld bytes for packed messages", (long long)sbytes);
+        }
+
+        for (int i = 0; i < niotasks; i++)
+        {
+            int io_comprank = iodesc->rearranger == PIO_REARR_SUBSET ? 0 : ios->ioranks[i];
+
+            if (sendcounts[io_comprank] > 0)
+                pack_data(iodesc->spack, i, elsize, nvars,
+                          (PIO_Offset)iodesc->ndof * elsize, sbuf,
+                          sendbuf + sdispls[io_comprank]);
+        }
+    }
+
+    /* Exchange the packed messages. */
+    LOG((2, "about to call pio_swapm for %lld bytes sent %lld bytes received",
+         (long long)sbytes, (long long)rbytes));
+    if ((ret = pio_swapm(sendbuf, sendcounts, sdispls, types, recvbuf, recvcounts,
+                         rdispls, types, mycomm, &iodesc->rearr_opts.comp2io)))
+    {
+        free(sendbuf);
+        free(recvbuf);
+        return pio_err(ios, NULL, ret, __FILE__, __LINE__,
+                        "Rearranging data from compute to I/O processes failed. pio_swapm() call failed to exchange packed data");
+    }
+    free(sendbuf);
+
+    /* The IO tasks scatter the messages into the IO buffer. The
+     * messages fill disjoint parts of the buffer, so they can be
+     * scattered concurrently. */
+    if (ios->ioproc)
+    {
+#if PIO_USE_OPENMP
+        int nthreads = pio_io_nthreads(ios);
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic) if (nthreads > 1)
+#endif
+        for (int i = 0; i < iodesc->nrecvs; i++)
+            if (iodesc->rcount[i] > 0)
+                unpack_data(iodesc->rpack, i, elsize, nvars,
+                            (PIO_Offset)iodesc->llen * elsize, recvbuf + rdispl[i], rbuf);
+    }
+    free(recvbuf);
+
+    return PIO_NOERR;
+}
+
+/**
+ * Moves data from IO tasks to compute tasks with packed messages.
+ * This is called from rearrange_io2comp() after the pack lists of
+ * the decomposition have been created.
+ *
+ * @param ios pointer to the iosystem_desc_t struct.
+ * @param iodesc a pointer to the io_desc_t struct.
+ * @param sbuf send buffer. May be NULL.
+ * @param rbuf receive buffer. May be NULL.
+ * @param mycomm communicator the data is transferred over.
+ * @param ntasks number of tasks in mycomm.
+ * @param niotasks number of IO tasks the compute tasks receive from.
+ * @returns 0 on success, error code otherwise.
+ */
+int rearrange_io2comp_packed(iosystem_desc_t *ios, io_desc_t *iodesc, void *sbuf,
+                             void *rbuf, MPI_Comm mycomm, int ntasks, int niotasks)
+{
+    int elsize = iodesc->mpitype_size;
+    int sendcounts[ntasks];
+    int recvcounts[ntasks];
+    int sdispls[ntasks];
+    int rdispls[ntasks];
+    MPI_Datatype types[ntasks];
+    PIO_Offset sbytes = 0;
+    PIO_Offset rbytes = 0;
+    char *sendbuf = NULL;
+    char *recvbuf = NULL;
+    int ret;
+
+    pioassert(ios && iodesc, "invalid input", __FILE__, __LINE__);
+    LOG((1, "rearrange_io2comp_packed ntasks = %d niotasks = %d", ntasks, niotasks));
+
+    for (int i = 0; i < ntasks; i++)
+    {
+        sendcounts[i] = 0;
+        recvcounts[i] = 0;
+        sdispls[i] = 0;
+        rdispls[i] = 0;
+        types[i] = MPI_BYTE;
+    }
+
+    /* The IO tasks send each message from its own part of the send
+     * buffer. */
+    if (ios->ioproc && sbuf)
+    {
+        for (int i = 0; i < iodesc->nrecvs; i++)
+        {
+            int to = iodesc->rearranger == PIO_REARR_SUBSET ? i : iodesc->rfrom[i];
+
+            if (iodesc->rcount[i] > 0)
+            {
+                sendcounts[to] = iodesc->rcount[i] * elsize;
+                sdispls[to] = (int)sbytes;
+                sbytes += (PIO_Offset)iodesc->rcount[i] * elsize;
+            }
+        }
+    }
+
+    /* The compute tasks receive each message into its own part of
+     * the receive buffer. */
+    if (!ios->async || ios->compproc)
+    {
+        for (int i = 0; i < niotasks; i++)
+        {
+            int io_comprank = iodesc->rearranger == PIO_REARR_SUBSET ? 0 : ios->ioranks[i];
+
+            if (iodesc->scount[i] > 0)
+            {
+                recvcounts[io_comprank] = iodesc->scount[i] * elsize;
+                rdispls[io_comprank] = (int)rbytes;
+                rbytes += (PIO_Offset)iodesc->scount[i] * elsize;
+            }
+        }
+    }
+
+    if ((ret = check_packed_size(ios, sbytes, rbytes, mycomm)))
+        return ret;
+
+    /* The IO tasks pack the data sent to each compute task. */
+    if (sbytes > 0)
+    {
+        if (!(sendbuf = malloc(sbytes)))
+            return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
+                            "Rearranging data from I/O to compute processes failed. Out of memory allocating %lld bytes for packed messages", (long long)sbytes);
+
+#if PIO_USE_OPENMP
+        int nthreads = pio_io_nthreads(ios);
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic) if (nthreads > 1)
+#endif
+        for (int i = 0; i < iodesc->nrecvs; i++)
+        {
+            int to = iodesc->rearranger == PIO_REARR_SUBSET ? i : iodesc->rfrom[i];
+
+            if (iodesc->rcount[i] > 0)
+                pack_data(iodesc->rpack, i, elsize, 1, 0, sbuf, sendbuf + sdispls[to]);
+        }
+    }
+
+    if ((!ios->async || ios->compproc) && rbytes > 0 && !(recvbuf = malloc(rbytes)))
+    {
+        free(sendbuf);
+        return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
+                        "Rearranging data from I/O to compute processes failed. Out of memory allocating %lld bytes for packed messages", (long long)rbytes);
+    }
+
+    /* Exchange the packed messages. */
+    LOG((2, "about to call pio_swapm for %lld bytes sent %lld bytes received",
+         (long long)sbytes, (long long)rbytes));
+    if ((ret = pio_swapm(sendbuf, sendcounts, sdispls, types, recvbuf, recvcounts,
+                         rdispls, types, mycomm, &iodesc->rearr_opts.io2comp)))
+    {
+        free(sendbuf);
+        free(recvbuf);
+        return pio_err(ios, NULL, ret, __FILE__, __LINE__,
+                        "Rearranging data from I/O to compute processes failed. pio_swapm() call failed to exchange packed data");
+    }
+    free(sendbuf);
+
+    /* The compute tasks scatter the messages into the user buffer. */
+    if (rbytes > 0)
+    {
+        for (int i = 0; i < niotasks; i++)
+        {
+            int io_comprank = iodesc->rearranger == PIO_REARR_SUBSET ? 0 : ios->ioranks[i];
+
+            if (iodesc->scount[i] > 0)
+                unpack_data(iodesc->spack, i, elsize, 1, 0, recvbuf + rdispls[io_comprank], rbuf);
+        }
+    }
+    free(recvbuf);
+
+    return PIO_NOERR;
+}
@@ -15,6 +15,12 @@ const char *pio_iotype_to_string(int iotype)
                               return "PIO_IOTYPE_NETCDF4P";
     case PIO_IOTYPE_ADIOS:
                               return "PIO_IOTYPE_ADIOS";
+    case PIO_IOTYPE_MEMORY:
+                              return "PIO_IOTYPE_MEMORY";
+    case PIO_IOTYPE_NULL:
+                              return "PIO_IOTYPE_NULL";
+    case PIO_IOTYPE_HDF5:
+                              return "PIO_IOTYPE_HDF5";
     default:
                               return "UNKNOWN";
   }
@@ -31,6 +37,8 @@ const char *pio_eh_to_string(int eh)
                               return "PIO_REDUCE_ERROR";
     case PIO_RETURN_ERROR:
                               return "PIO_RETURN_ERROR";
+    case PIO_DEFER_ERROR:
+                              return "PIO_DEFER_ERROR";
     default:
                               return "UNKNOWN";
   }
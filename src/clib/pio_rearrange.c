@@ -252,13 +252,15 @@ int compute_maxIObuffersize(MPI_Comm io_comm, io_desc_t *iodesc)
 
     /*  compute the max io buffer size, for conveneance it is the
      *  combined size of all regions */
-    for (io_region *region = iodesc->firstregion; region; region = region->next)
+    for (int r = 0; r < iodesc->regions->nregions; r++)
     {
-        if (region->count[0] > 0)
+        PIO_Offset *count = REGION_COUNT(iodesc->regions, r);
+
+        if (count[0] > 0)
         {
             PIO_Offset iosize = 1;
             for (int i = 0; i < iodesc->ndims; i++)
-                iosize *= region->count[i];
+                iosize *= count[i];
             totiosize += iosize;
         }
     }
@@ -276,10 +278,57 @@ int compute_maxIObuffersize(MPI_Comm io_comm, io_desc_t *iodesc)
     return PIO_NOERR;
 }
 
+/**
+ * Find the runs of consecutive indexes of one rearranger message. The
+ * indexes of a box rearranger message are contiguous in mindex, the
+ * indexes of a subset rearranger message are those with mfrom equal
+ * to the message.
+ *
+ * @param msg the message.
+ * @param numinds the number of indexes in mindex.
+ * @param pos the position of the first index of the message in
+ * mindex. Only used when mfrom is NULL.
+ * @param mindex an array (length numinds) of indexes.
+ * @param mcount the number of indexes in the message.
+ * @param mfrom an array (length numinds) with the message of each
+ * index, or NULL for the box rearranger.
+ * @param displace array (length mcount) that gets the first index of
+ * each run.
+ * @param blocklen array (length mcount) that gets the length of each
+ * run.
+ * @returns the number of runs.
+ */
+int find_index_runs(int msg, int numinds, int pos, const int *mindex,
+                    int mcount, const int *mfrom, int *displace, int *blocklen)
+{
+    int nruns = 0;
+    int prev = 0;
+
+    for (int j = mfrom ? 0 : pos; j < (mfrom ? numinds : pos + mcount); j++)
+    {
+        if (mfrom && mfrom[j] != msg)
+            continue;
+        if (nruns && mindex[j] == prev + 1)
+            blocklen[nruns - 1]++;
+        else
+        {
+            displace[nruns] = mindex[j];
+            blocklen[nruns++] = 1;
+        }
+        prev = mindex[j];
+    }
+
+    return nruns;
+}
+
 /**
  * Create the derived MPI datatypes used for comp2io and io2comp
  * transfers. Used in define_iodesc_datatypes().
  *
+ * The indexes of each message are described by their ranges of
+ * consecutive indexes, so the datatypes scale with the number of
+ * ranges instead of the number of indexes.
+ *
  * @param mpitype The MPI type of data (MPI_INT, etc.).
  * @param msgcnt This is the number of MPI types that are created.
  * @param mindex An array (length numinds) of indexes into the data
@@ -294,19 +343,15 @@ int compute_maxIObuffersize(MPI_Comm io_comm, io_desc_t *iodesc)
  * @author Jim Edwards
  */
 int create_mpi_datatypes(MPI_Datatype mpitype, int msgcnt,
-                         const PIO_Offset *mindex, const int *mcount, int *mfrom,
+                         const int *mindex, const int *mcount, int *mfrom,
                          MPI_Datatype *mtype)
 {
-    int blocksize;
     int numinds = 0;
-    PIO_Offset *lindex = NULL;
     int mpierr; /* Return code from MPI functions. */
 
     /* Check inputs. */
     pioassert(msgcnt > 0 && mcount, "invalid input", __FILE__, __LINE__);
 
-    PIO_Offset bsizeT[msgcnt];
-
     LOG((1, "create_mpi_datatypes mpitype = %d msgcnt = %d", mpitype, msgcnt));
     LOG((2, "MPI_BYTE = %d MPI_CHAR = %d MPI_SHORT = %d MPI_INT = %d MPI_FLOAT = %d MPI_DOUBLE = %d",
          MPI_BYTE, MPI_CHAR, MPI_SHORT, MPI_INT, MPI_FLOAT, MPI_DOUBLE));
@@ -316,108 +361,57 @@ int create_mpi_datatypes(MPI_Datatype mpitype, int msgcnt,
         numinds += mcount[j];
     LOG((2, "numinds = %d", numinds));
 
-    if (mindex)
-    {
-        if (!(lindex = malloc(numinds * sizeof(PIO_Offset))))
-        {
-            return pio_err(NULL, NULL, PIO_ENOMEM, __FILE__, __LINE__,
-                            "Creating MPI datatypes to rearrange data from/to compute processes to/from io processes failed. Out of memory allocating %lld bytes to store local indices", (unsigned long long) (numinds * sizeof(PIO_Offset)));
-        }
-        memcpy(lindex, mindex, (size_t)(numinds * sizeof(PIO_Offset)));
-        LOG((3, "allocated lindex, copied mindex"));
-    }
-
-    bsizeT[0] = 0;
     mtype[0] = PIO_DATATYPE_NULL;
-    int pos = 0;
-    int ii = 0;
-
-    /* Determine the blocksize. This is done differently for the
-     * rearrangers. (If mfrom is NULL, this is the box rearranger.) */
-    if (mfrom == NULL)
-    {
-        LOG((3, "mfrom is NULL"));
-        for (int i = 0; i < msgcnt; i++)
-        {
-            if (mcount[i] > 0)
-            {
-                /* Look for the largest block of data for io which
-                 * can be expressed in terms of start and
-                 * count. */
-                bsizeT[ii] = GCDblocksize(mcount[i], lindex + pos);
-                ii++;
-                pos += mcount[i];
-            }
-        }
-        blocksize = (int)lgcd_array(ii, bsizeT);
-    }
-    else
-    {
-        blocksize = 1;
-    }
-    LOG((3, "blocksize = %d", blocksize));
 
     /* pos is an index to the start of each message block. */
-    pos = 0;
+    int pos = 0;
     for (int i = 0; i < msgcnt; i++)
     {
         if (mcount[i] > 0)
         {
-            int len = mcount[i] / blocksize;
             int *displace = NULL;
-            LOG((3, "blocksize = %d i = %d mcount[%d] = %d len = %d", blocksize, i, i,
-                 mcount[i], len));
+            int *blocklen = NULL;
+            int nruns;
+            bool same_len = true;
 
-            if (len > 0)
+            if (!(displace = malloc(mcount[i] * sizeof(int))) ||
+                !(blocklen = malloc(mcount[i] * sizeof(int))))
             {
-                if (!(displace = calloc(len, sizeof(int))))
-                {
-                    return pio_err(NULL, NULL, PIO_ENOMEM, __FILE__, __LINE__,
-                                    "Creating MPI datatypes to rearrange data from/to compute processes to/from io processes failed. Out of memory allocating %lld bytes to store displacements", (unsigned long long) (len * sizeof(int)));
-                }
+                return pio_err(NULL, NULL, PIO_ENOMEM, __FILE__, __LINE__,
+                                "Creating MPI datatypes to rearrange data from/to compute processes to/from io processes failed. Out of memory allocating %lld bytes to store displacements", (unsigned long long) (2 * mcount[i] * sizeof(int)));
             }
 
-            if (blocksize == 1)
-            {
-                if (!mfrom)
-                {
-                    /* Box rearranger. */
-                    for (int j = 0; j < len; j++)
-                        displace[j] = (int)(lindex[pos + j]);
-                }
-                else
-                {
-                    /* Subset rearranger. */
-                    int k = 0;
-                    for (int j = 0; j < numinds; j++)
-                        if (mfrom[j] == i)
-                            displace[k++] = (int)(lindex[j]);
-                }
+            /* Find the ranges of consecutive indexes of this
+             * message. */
+            nruns = find_index_runs(i, numinds, pos, mindex, mcount[i], mfrom,
+                                    displace, blocklen);
+            for (int r = 1; r < nruns; r++)
+                if (blocklen[r] != blocklen[0])
+                    same_len = false;
+
+#if PIO_ENABLE_LOGGING
+            for (int r = 0; r < nruns; r++)
+                LOG((3, "displace[%d] = %d blocklen[%d] = %d", r, displace[r], r, blocklen[r]));
+#endif /* PIO_ENABLE_LOGGING */
 
+            LOG((3, "i = %d mcount[%d] = %d nruns = %d same_len = %d", i, i, mcount[i],
+                 nruns, same_len));
+            /* Create an indexed datatype, with constant-sized blocks
+             * if all the ranges are the same length. */
+            if (same_len)
+            {
+                if ((mpierr = MPI_Type_create_indexed_block(nruns, nruns ? blocklen[0] : 1, displace,
+                                                            mpitype, &mtype[i])))
+                    return check_mpi(NULL, NULL, mpierr, __FILE__, __LINE__);
             }
             else
             {
-                for (int j = 0; j < mcount[i]; j++)
-                    (lindex + pos)[j]++;
-
-                for (int j = 0; j < len; j++)
-                    displace[j] = ((lindex + pos)[j * blocksize] - 1);
+                if ((mpierr = MPI_Type_indexed(nruns, blocklen, displace, mpitype, &mtype[i])))
+                    return check_mpi(NULL, NULL, mpierr, __FILE__, __LINE__);
             }
 
-#if PIO_ENABLE_LOGGING
-            for (int j = 0; j < len; j++)
-                LOG((3, "displace[%d] = %d", j, displace[j]));
-#endif /* PIO_ENABLE_LOGGING */
-
-            LOG((3, "calling MPI_Type_create_indexed_block len = %d blocksize = %d "
-                 "mpitype = %d", len, blocksize, mpitype));
-            /* Create an indexed datatype with constant-sized blocks. */
-            if ((mpierr = MPI_Type_create_indexed_block(len, blocksize, displace,
-                                                        mpitype, &mtype[i])))
-                return check_mpi(NULL, NULL, mpierr, __FILE__, __LINE__);
-
             free(displace);
-            displace = NULL;
+            free(blocklen);
 
             if (mtype[i] == PIO_DATATYPE_NULL)
             {
@@ -433,21 +427,198 @@ int create_mpi_datatypes(MPI_Datatype mpitype, int msgcnt,
         }
     }
 
-    /* Free resources. */
-    if (lindex)
-        free(lindex);
-
     LOG((3, "done with create_mpi_datatypes()"));
     return PIO_NOERR;
 }
 
+/**
+ * Count the elements and the blocks of consecutive elements of the
+ * messages of one side of a rearranger.
+ *
+ * @param nmsgs the number of messages.
+ * @param mcount array (length nmsgs) with the number of elements of
+ * each message.
+ * @param mtype array (length nmsgs) with the MPI datatype of each
+ * message, or NULL.
+ * @param pack the pack list of the messages, or NULL.
+ * @param nelems pointer that gets the number of elements added.
+ * @param nblocks pointer that gets the number of blocks added.
+ * @returns 0 for success, error code otherwise.
+ */
+static int count_rearr_blocks(int nmsgs, const int *mcount, const MPI_Datatype *mtype,
+                              const pio_pack_list *pack, double *nelems, double *nblocks)
+{
+    int mpierr;
+
+    for (int m = 0; m < nmsgs; m++)
+        *nelems += mcount[m];
+
+    if (pack)
+        *nblocks += pack->first[pack->nmsgs];
+    else if (mtype)
+    {
+        for (int m = 0; m < nmsgs; m++)
+        {
+            int nints, naddrs, ntypes, combiner;
+
+            if (mtype[m] == PIO_DATATYPE_NULL)
+                continue;
+
+            /* The datatypes are created by create_mpi_datatypes(),
+             * the integers of their envelope are the number of
+             * blocks, followed by the lengths and displacements of
+             * the blocks. */
+            if ((mpierr = MPI_Type_get_envelope(mtype[m], &nints, &naddrs, &ntypes, &combiner)))
+                return check_mpi(NULL, NULL, mpierr, __FILE__, __LINE__);
+            if (combiner == MPI_COMBINER_INDEXED_BLOCK)
+                *nblocks += nints - 2;
+            else if (combiner == MPI_COMBINER_INDEXED)
+                *nblocks += (nints - 1) / 2;
+            else
+                *nblocks += 1;
+        }
+    }
+
+    return PIO_NOERR;
+}
+
+/**
+ * Get the number of bytes of memory held by a region table.
+ *
+ * @param regions pointer to the region table, may be NULL.
+ * @returns the number of bytes.
+ */
+static PIO_Offset region_table_mem(const io_region_table *regions)
+{
+    if (!regions)
+        return 0;
+
+    return sizeof(io_region_table) +
+        regions->size * ((2 * (regions->ndims + 1) + 1) * sizeof(PIO_Offset) +
+                         2 * sizeof(PIO_Offset *));
+}
+
+/**
+ * Get the number of bytes of memory held by a pack list.
+ *
+ * @param list pointer to the pack list, may be NULL.
+ * @returns the number of bytes.
+ */
+static PIO_Offset pack_list_mem(const pio_pack_list *list)
+{
+    if (!list)
+        return 0;
+
+    return sizeof(pio_pack_list) +
+        (list->nmsgs + 1 + 2 * list->first[list->nmsgs]) * sizeof(int);
+}
+
+/**
+ * Get the memory held by the rearranger of a decomposition on this
+ * task, and count the elements and blocks of consecutive elements of
+ * its messages. The memory of the MPI datatypes is estimated as the
+ * lengths and displacements of their blocks.
+ *
+ * @param ios pointer to the iosystem_desc_t struct.
+ * @param iodesc a pointer to the io_desc_t struct.
+ * @param nelems pointer that gets the number of elements of the
+ * messages added.
+ * @param nblocks pointer that gets the number of blocks of the
+ * messages added.
+ * @param mem pointer that gets the number of bytes.
+ * @returns 0 on success, error code otherwise.
+ */
+int get_rearr_mem(iosystem_desc_t *ios, io_desc_t *iodesc, double *nelems,
+                  double *nblocks, PIO_Offset *mem)
+{
+    double nb = 0;
+    int ret;
+
+    pioassert(ios && iodesc && nelems && nblocks && mem, "invalid input", __FILE__, __LINE__);
+
+    *mem = 0;
+
+    /* The send side of a write. */
+    if (ios->compproc && iodesc->scount)
+    {
+        int nmsgs = iodesc->rearranger == PIO_REARR_SUBSET ? 1 : ios->num_iotasks;
+
+        if ((ret = count_rearr_blocks(nmsgs, iodesc->scount, iodesc->stype, iodesc->spack,
+                                      nelems, &nb)))
+            return ret;
+
+        *mem += nmsgs * sizeof(int);
+        if (iodesc->sindex)
+            *mem += iodesc->ndof * sizeof(int);
+        *mem += iodesc->num_stypes * sizeof(MPI_Datatype);
+        *mem += pack_list_mem(iodesc->spack);
+    }
+
+    /* The receive side of a write. */
+    if (ios->ioproc && iodesc->rcount)
+    {
+        if ((ret = count_rearr_blocks(iodesc->nrecvs, iodesc->rcount, iodesc->rtype,
+                                      iodesc->rpack, nelems, &nb)))
+            return ret;
+
+        *mem += max(1, iodesc->nrecvs) * sizeof(int);
+        if (iodesc->rearranger == PIO_REARR_SUBSET)
+            *mem += iodesc->llen * sizeof(int);
+        else
+            *mem += max(1, iodesc->nrecvs) * sizeof(int);
+        if (iodesc->rindex)
+            *mem += iodesc->llen * sizeof(int);
+        if (iodesc->rtype)
+            *mem += iodesc->nrecvs * sizeof(MPI_Datatype);
+        *mem += pack_list_mem(iodesc->rpack);
+        *mem += region_table_mem(iodesc->regions);
+        *mem += region_table_mem(iodesc->fillregions);
+    }
+
+    /* Estimate the memory of the MPI datatypes with the length and
+     * displacement of each of their blocks. */
+    if (!iodesc->packed)
+        *mem += 2 * nb * sizeof(int);
+    *nblocks += nb;
+
+    return PIO_NOERR;
+}
+
+/**
+ * Update the memory held by the rearranger of a decomposition in the
+ * memory statistics of the IO system (see PIOc_get_mem_stats()).
+ *
+ * @param ios pointer to the iosystem_desc_t struct.
+ * @param iodesc a pointer to the io_desc_t struct.
+ * @returns 0 on success, error code otherwise.
+ */
+int update_rearr_mem(iosystem_desc_t *ios, io_desc_t *iodesc)
+{
+    double nelems = 0, nblocks = 0;
+    PIO_Offset mem;
+    int ret;
+
+    if ((ret = get_rearr_mem(ios, iodesc, &nelems, &nblocks, &mem)))
+        return ret;
+
+    pio_mem_account(ios, NULL, PIO_MEM_REARR, mem - iodesc->rearr_mem);
+    iodesc->rearr_mem = mem;
+
+    return PIO_NOERR;
+}
+
 /**
  * If needed, create the derived MPI datatypes used for comp2io and
  * io2comp transfers.
  *
  * If iodesc->stype and iodesc->rtype arrays already exist, this
  * function does nothing. This function is called from
- * rearrange_io2comp() and rearrange_comp2io().
+ * rearrange_io2comp() and rearrange_comp2io(). Once the datatypes are
+ * created, iodesc->rindex and iodesc->sindex are freed.
+ *
+ * For decompositions rearranged with packed messages
+ * (iodesc->packed), the pack lists iodesc->rpack and iodesc->spack are
+ * created instead of the datatypes.
  *
  * NOTE from Jim: I am always oriented toward write so recieve
  * always means io tasks and send always means comp tasks. The
@@ -464,6 +635,7 @@ int create_mpi_datatypes(MPI_Datatype mpitype, int msgcnt,
  */
 int define_iodesc_datatypes(iosystem_desc_t *ios, io_desc_t *iodesc)
 {
+    bool created = false; /* True if datatypes or pack lists were created. */
     int ret; /* Return value. */
 
     pioassert(ios && iodesc, "invalid input", __FILE__, __LINE__);
@@ -475,9 +647,25 @@ int define_iodesc_datatypes(iosystem_desc_t *ios, io_desc_t *iodesc)
     {
         /* If the types for the IO tasks have not been created, then
          * create them. */
-        if (!iodesc->rtype)
+        if (!iodesc->rtype && !iodesc->rpack)
         {
-            if (iodesc->nrecvs > 0)
+            if (iodesc->nrecvs > 0 && iodesc->packed)
+            {
+                /* Describe the messages with runs of indexes. */
+                int *mfrom = iodesc->rearranger == PIO_REARR_SUBSET ? iodesc->rfrom : NULL;
+
+                if ((ret = create_pack_list(iodesc->nrecvs, iodesc->rindex, iodesc->rcount,
+                                            mfrom, &iodesc->rpack)))
+                {
+                    return pio_err(ios, NULL, ret, __FILE__, __LINE__,
+                                    "Defining MPI datatypes for I/O decomposition failed. Unable to create the pack list for receiving data from compute processes.");
+                }
+
+                free(iodesc->rindex);
+                iodesc->rindex = NULL;
+                created = true;
+            }
+            else if (iodesc->nrecvs > 0)
             {
                 /* Allocate memory for array of MPI types for the IO tasks. */
                 if (!(iodesc->rtype = malloc(iodesc->nrecvs * sizeof(MPI_Datatype))))
@@ -502,6 +690,11 @@ int define_iodesc_datatypes(iosystem_desc_t *ios, io_desc_t *iodesc)
                     return pio_err(ios, NULL, ret, __FILE__, __LINE__,
                                     "Defining MPI datatypes for I/O decomposition failed. Unable to create MPI datatypes for receiving data from compute processes.");
                 }
+
+                /* The datatypes describe the indexes from now on. */
+                free(iodesc->rindex);
+                iodesc->rindex = NULL;
+                created = true;
             }
         }
     }
@@ -511,13 +704,29 @@ int define_iodesc_datatypes(iosystem_desc_t *ios, io_desc_t *iodesc)
      * operation.) */
     if (ios->compproc)
     {
-        if (!iodesc->stype)
+        if (!iodesc->stype && !iodesc->spack)
         {
             int ntypes;
             
             /* Subset rearranger gets one type; box rearranger gets one
              * type per IO task. */
             ntypes = iodesc->rearranger == PIO_REARR_SUBSET ? 1 : ios->num_iotasks;
+
+            if (iodesc->packed)
+            {
+                /* Describe the messages with runs of indexes. */
+                if ((ret = create_pack_list(ntypes, iodesc->sindex, iodesc->scount, NULL,
+                                            &iodesc->spack)))
+                {
+                    return pio_err(ios, NULL, ret, __FILE__, __LINE__,
+                                    "Defining MPI datatypes for I/O decomposition failed. Unable to create the pack list for data sent from each compute process");
+                }
+
+                free(iodesc->sindex);
+                iodesc->sindex = NULL;
+
+                return update_rearr_mem(ios, iodesc);
+            }
             
             /* Allocate memory for array of MPI types for the computation tasks. */
             if (!(iodesc->stype = malloc(ntypes * sizeof(MPI_Datatype))))
@@ -542,9 +751,20 @@ int define_iodesc_datatypes(iosystem_desc_t *ios, io_desc_t *iodesc)
                 return pio_err(ios, NULL, ret, __FILE__, __LINE__,
                                 "Defining MPI datatypes for I/O decomposition failed. Unable to create MPI datatypes for data sent from each compute process");
             }
+
+            /* The datatypes describe the indexes from now on. */
+            free(iodesc->sindex);
+            iodesc->sindex = NULL;
+            created = true;
         }
     }
 
+    /* The datatypes replace the indexes in the memory of the
+     * rearranger. */
+    if (created)
+        if ((ret = update_rearr_mem(ios, iodesc)))
+            return ret;
+
     LOG((3, "done with define_iodesc_datatypes()"));
     return PIO_NOERR;
 }
@@ -603,13 +823,13 @@ int compute_counts(iosystem_desc_t *ios, io_desc_t *iodesc,
     int recv_displs[ios->num_uniontasks];
 
     /* The list of indeces on each compute task */
-    PIO_Offset *s2rindex = NULL;
+    int *s2rindex = NULL;
     if (iodesc->ndof > 0)
     {
-        if (!(s2rindex = malloc(iodesc->ndof * sizeof(PIO_Offset))))
+        if (!(s2rindex = malloc(iodesc->ndof * sizeof(int))))
         {
           return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
-                          "Calculating the amount/offset of data transferred between compute and I/O processes failed. Out of memory allocating %lld bytes to store index mapping between compute and I/O processes", (unsigned long long) (iodesc->ndof * sizeof(PIO_Offset)));
+                          "Calculating the amount/offset of data transferred between compute and I/O processes failed. Out of memory allocating %lld bytes to store index mapping between compute and I/O processes", (unsigned long long) (iodesc->ndof * sizeof(int)));
         }
     }
 
@@ -736,10 +956,10 @@ int compute_counts(iosystem_desc_t *ios, io_desc_t *iodesc,
     /* Allocate an array for indicies on the computation tasks (the
      * send side when writing). */
     if (iodesc->sindex == NULL && iodesc->ndof > 0)
-        if (!(iodesc->sindex = malloc(iodesc->ndof * sizeof(PIO_Offset))))
+        if (!(iodesc->sindex = malloc(iodesc->ndof * sizeof(int))))
         {
             return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
-                            "Calculating the amount/offset of data transferred between compute and I/O processes failed. Out of memory allocating %lld bytes to store offset/index of data", (unsigned long long) (iodesc->ndof * sizeof(PIO_Offset)));
+                            "Calculating the amount/offset of data transferred between compute and I/O processes failed. Out of memory allocating %lld bytes to store offset/index of data", (unsigned long long) (iodesc->ndof * sizeof(int)));
         }
     LOG((2, "iodesc->ndof = %d ios->num_iotasks = %d", iodesc->ndof, ios->num_iotasks));
 
@@ -794,7 +1014,7 @@ int compute_counts(iosystem_desc_t *ios, io_desc_t *iodesc,
          * each IO task. */
         send_counts[ios->ioranks[i]] = iodesc->scount[i];
         if (send_counts[ios->ioranks[i]] > 0)
-            send_displs[ios->ioranks[i]] = spos[i] * SIZEOF_MPI_OFFSET;
+            send_displs[ios->ioranks[i]] = spos[i] * sizeof(int);
         LOG((3, "ios->ioranks[i] = %d iodesc->scount[%d] = %d spos[%d] = %d",
              ios->ioranks[i], i, iodesc->scount[i], i, spos[i]));
     }
@@ -813,7 +1033,7 @@ int compute_counts(iosystem_desc_t *ios, io_desc_t *iodesc,
         for (int i = 1; i < nrecvs; i++)
         {
             recv_displs[iodesc->rfrom[i]] = recv_displs[iodesc->rfrom[i - 1]] +
-                iodesc->rcount[i - 1] * SIZEOF_MPI_OFFSET;
+                iodesc->rcount[i - 1] * sizeof(int);
             LOG((3, "iodesc->rfrom[%d] = %d recv_displs[iodesc->rfrom[i]] = %d", i,
                  iodesc->rfrom[i], recv_displs[iodesc->rfrom[i]]));
         }
@@ -824,18 +1044,18 @@ int compute_counts(iosystem_desc_t *ios, io_desc_t *iodesc,
         if (totalrecv > 0)
         {
             totalrecv = iodesc->llen;  /* can reduce memory usage here */
-            if (!(iodesc->rindex = calloc(totalrecv, sizeof(PIO_Offset))))
+            if (!(iodesc->rindex = calloc(totalrecv, sizeof(int))))
             {
                 return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
-                            "Calculating the amount/offset of data transferred between compute and I/O processes failed. Out of memory allocating %lld bytes to store receive index/offset of data", (unsigned long long) (totalrecv * sizeof(PIO_Offset)));
+                            "Calculating the amount/offset of data transferred between compute and I/O processes failed. Out of memory allocating %lld bytes to store receive index/offset of data", (unsigned long long) (totalrecv * sizeof(int)));
             }
             LOG((3, "allocated totalrecv elements in rindex array"));
         }
     }
 
-    /* For the swapm call below, init the types to MPI_OFFSET. */
+    /* For the swapm call below, init the types to MPI_INT. */
     for (int i = 0; i < ios->num_uniontasks; i++)
-        sr_types[i] = MPI_OFFSET;
+        sr_types[i] = MPI_INT;
 
     /* Here we are sending the mapping from the index on the compute
      * task to the index on the io task. */
@@ -932,6 +1152,19 @@ int rearrange_comp2io(iosystem_desc_t *ios, io_desc_t *iodesc, void *sbuf,
                         "Rearranging data from compute to I/O processes failed. Defining MPI datatypes for rearranging data failed");
     }
 
+    /* Packed messages don't use the MPI data types. */
+    if (iodesc->packed)
+    {
+        if ((ret = rearrange_comp2io_packed(ios, iodesc, sbuf, rbuf, nvars, mycomm, ntasks,
+                                            niotasks)))
+            return pio_err(ios, NULL, ret, __FILE__, __LINE__,
+                            "Rearranging data from compute to I/O processes failed. Exchanging packed data failed");
+#ifdef TIMING
+        GPTLstop("PIO:rearrange_comp2io");
+#endif
+        return PIO_NOERR;
+    }
+
     /* If this io proc, we need to exchange data with compute
      * tasks. Create a MPI DataType for that exchange. */
     LOG((2, "ios->ioproc %d iodesc->nrecvs = %d", ios->ioproc, iodesc->nrecvs));
@@ -1114,6 +1347,18 @@ int rearrange_io2comp(iosystem_desc_t *ios, io_desc_t *iodesc, void *sbuf,
                         "Rearranging data from I/O to compute processes failed. Defining MPI datatypes for transferring data failed");
     }
 
+    /* Packed messages don't use the MPI data types. */
+    if (iodesc->packed)
+    {
+        if ((ret = rearrange_io2comp_packed(ios, iodesc, sbuf, rbuf, mycomm, ntasks, niotasks)))
+            return pio_err(ios, NULL, ret, __FILE__, __LINE__,
+                            "Rearranging data from I/O to compute processes failed. Exchanging packed data failed");
+#ifdef TIMING
+        GPTLstop("PIO:rearrange_io2comp");
+#endif
+        return PIO_NOERR;
+    }
+
     /* Allocate arrays needed by the pio_swapm() function. */
     int sendcounts[ntasks];
     int recvcounts[ntasks];
@@ -1202,32 +1447,31 @@ int rearrange_io2comp(iosystem_desc_t *ios, io_desc_t *iodesc, void *sbuf,
  * @param gdimlen pointer to an array length iodesc->ndims with the
  * global array sizes for one record (for record vars) or for the
  * entire var (for non-record vars).
- * @param compmap only used for the box communicator.
  * @returns 0 on success, error code otherwise.
  * @author Jim Edwards
  */
-int determine_fill(iosystem_desc_t *ios, io_desc_t *iodesc, const int *gdimlen,
-                   const PIO_Offset *compmap)
+int determine_fill(iosystem_desc_t *ios, io_desc_t *iodesc, const int *gdimlen)
 {
     PIO_Offset totalllen = 0;
     PIO_Offset totalgridsize = 1;
     int mpierr; /* Return code from MPI calls. */
 
     /* Check inputs. */
-    pioassert(ios && iodesc && gdimlen && compmap, "invalid input",
-              __FILE__, __LINE__);
+    pioassert(ios && iodesc && gdimlen, "invalid input", __FILE__, __LINE__);
 
     /* Determine size of data space. */
     for (int i = 0; i < iodesc->ndims; i++)
         totalgridsize *= gdimlen[i];
 
-    /* Determine how many values we have locally. */
+    /* Determine how many values we have locally. For the box
+     * rearranger these are the elements of the ranges of the map that
+     * are not holes. */
     if (iodesc->rearranger == PIO_REARR_SUBSET)
         totalllen = iodesc->llen;
     else
-        for (int i = 0; i < iodesc->ndof; i++)
-            if (compmap[i] > 0)
-                totalllen++;
+        for (int r = 0; r < iodesc->map_nranges; r++)
+            if (iodesc->map_start[r] > 0)
+                totalllen += iodesc->map_count[r];
 
     /* Add results accross communicator. */
     LOG((2, "determine_fill before allreduce totalllen = %d totalgridsize = %d",
@@ -1247,6 +1491,149 @@ int determine_fill(iosystem_desc_t *ios, io_desc_t *iodesc, const int *gdimlen,
     return PIO_NOERR;
 }
 
+/**
+ * Check that the IO buffers of all IO tasks fit in the int offsets
+ * (rindex) of the rearranger. This is collective over the union
+ * communicator, so that all tasks return the error instead of some
+ * of them waiting in the collective calls that set up the
+ * rearranger.
+ *
+ * @param ios pointer to the iosystem_desc_t struct.
+ * @param iodesc a pointer to the io_desc_t struct, with the llen of
+ * the IO buffer set on the IO tasks.
+ * @param rearr the name of the rearranger, for the error message.
+ * @returns 0 on success, error code otherwise.
+ */
+static int check_iobuf_len(iosystem_desc_t *ios, io_desc_t *iodesc, const char *rearr)
+{
+    PIO_Offset maxllen = iodesc->llen;
+    int mpierr;
+
+    if ((mpierr = MPI_Allreduce(MPI_IN_PLACE, &maxllen, 1, MPI_OFFSET, MPI_MAX,
+                                ios->union_comm)))
+        return check_mpi(ios, NULL, mpierr, __FILE__, __LINE__);
+
+    if (maxllen > INT_MAX)
+        return pio_err(ios, NULL, PIO_EINVAL, __FILE__, __LINE__,
+                        "Creating %s rearranger failed for I/O decomposition (ioid=%d) on iosystem (iosysid=%d). The IO buffer of an IO task has %lld elements (expected <= %d), use more IO tasks", rearr, iodesc->ioid, ios->iosysid, (long long)maxllen, INT_MAX);
+
+    return PIO_NOERR;
+}
+
+/**
+ * Find the destination of the elements of the map of a compute task
+ * that are inside the box of an IO task, for the box rearranger. The
+ * ranges of the map (iodesc->map_start, iodesc->map_count) are walked
+ * one row of the fastest varying dimension at a time, so the cost
+ * scales with the number of rows of the ranges instead of the number
+ * of elements. Elements that already have a destination are left
+ * alone, so the box of the first IO task holding an element wins.
+ *
+ * @param iodesc a pointer to the io_desc_t struct.
+ * @param gdimlen an array length ndims with the sizes of the global
+ * dimensions.
+ * @param ndims the number of dimensions.
+ * @param ioproc the IO task.
+ * @param start array (length ndims) with the start of the box of the
+ * IO task.
+ * @param count array (length ndims) with the count of the box of the
+ * IO task.
+ * @param dest_ioproc array (length iodesc->maplen) that gets the IO
+ * task of each element in the box, -1 for no destination.
+ * @param dest_ioindex array (length iodesc->maplen) that gets the
+ * offset into the IO buffer of each element in the box.
+ */
+static void find_box_dests(const io_desc_t *iodesc, const int *gdimlen, int ndims,
+                           int ioproc, const PIO_Offset *start, const PIO_Offset *count,
+                           int *dest_ioproc, PIO_Offset *dest_ioindex)
+{
+    PIO_Offset coord[ndims];  /* Global coordinates of the start of a row. */
+    PIO_Offset lcoord[ndims]; /* Coordinates in the box. */
+    int last = ndims - 1;     /* The fastest varying dimension. */
+    int pos = 0;              /* Position of the range in the map. */
+
+    for (int r = 0; r < iodesc->map_nranges; r++)
+    {
+        /* Holes have no destination. */
+        for (int k = 0; iodesc->map_start[r] > 0 && k < iodesc->map_count[r]; )
+        {
+            PIO_Offset len;
+            bool found = true;
+
+            /* The map is 1 based but calculations are 0 based. */
+            idx_to_dim_list(ndims, gdimlen, iodesc->map_start[r] - 1 + k, coord);
+            len = min((PIO_Offset)iodesc->map_count[r] - k, gdimlen[last] - coord[last]);
+
+            /* Is the row inside the box in the other dimensions? */
+            for (int d = 0; d < last && found; d++)
+            {
+                if (coord[d] >= start[d] && coord[d] < start[d] + count[d])
+                    lcoord[d] = coord[d] - start[d];
+                else
+                    found = false;
+            }
+
+            /* The part of the row inside the box is consecutive in the
+             * IO buffer. */
+            if (found)
+            {
+                PIO_Offset lo = max(coord[last], start[last]);
+                PIO_Offset hi = min(coord[last] + len, start[last] + count[last]);
+                PIO_Offset ioindex;
+
+                if (lo < hi)
+                {
+                    lcoord[last] = lo - start[last];
+                    ioindex = coord_to_lindex(ndims, lcoord, count);
+                    for (PIO_Offset c = lo; c < hi; c++, ioindex++)
+                    {
+                        int e = pos + k + (c - coord[last]);
+
+                        if (dest_ioproc[e] < 0)
+                        {
+                            dest_ioproc[e] = ioproc;
+                            dest_ioindex[e] = ioindex;
+                        }
+                    }
+                }
+            }
+            k += len;
+        }
+        pos += iodesc->map_count[r];
+    }
+}
+
+/**
+ * Check that a destination IO task was found for each element of the
+ * map of a compute task that is not a hole, for the box rearranger.
+ *
+ * @param ios pointer to the iosystem_desc_t struct.
+ * @param iodesc a pointer to the io_desc_t struct.
+ * @param dest_ioproc array (length iodesc->maplen) with the IO task
+ * of each element, -1 for no destination.
+ * @returns 0 on success, error code otherwise.
+ */
+static int check_box_dests(iosystem_desc_t *ios, io_desc_t *iodesc, const int *dest_ioproc)
+{
+    int pos = 0;
+
+    for (int r = 0; r < iodesc->map_nranges; r++)
+    {
+        if (iodesc->map_start[r] > 0)
+            for (int k = 0; k < iodesc->map_count[r]; k++)
+                if (dest_ioproc[pos + k] < 0)
+                {
+                    LOG((1, "Error: Found dest_ioproc[%d] = %d and map %lld", pos + k,
+                         dest_ioproc[pos + k], iodesc->map_start[r] + k));
+                    return pio_err(ios, NULL, PIO_EINVAL, __FILE__, __LINE__,
+                                    "Creating BOX rearranger failed for I/O decomposition (ioid=%d) on iosystem (iosysid=%d). Unable to find a destination I/O process for data (compmap[%d]=%lld)", iodesc->ioid, ios->iosysid, pos + k, (unsigned long long)(iodesc->map_start[r] + k));
+                }
+        pos += iodesc->map_count[r];
+    }
+
+    return PIO_NOERR;
+}
+
 /**
  * The box rearranger computes a mapping between IO tasks and compute
  * tasks such that the data on IO tasks can be written with a single
@@ -1255,8 +1642,9 @@ int determine_fill(iosystem_desc_t *ios, io_desc_t *iodesc, const int *gdimlen,
  * in lower level libraries.
  *
  * On each compute task the application program passes a compmap array
- * of length ndof. This array describes the arrangement of data in
- * memory on that compute task.
+ * of length ndof, kept in iodesc as ranges of consecutive mappings
+ * (see set_iodesc_map()). This array describes the arrangement of
+ * data in memory on that compute task.
  *
  * These arrays are gathered and rearranged to the IO-tasks (which are
  * sometimes collocated with compute tasks), each IO task contains
@@ -1276,28 +1664,25 @@ int determine_fill(iosystem_desc_t *ios, io_desc_t *iodesc, const int *gdimlen,
  * </ul>
  *
  * @param ios pointer to the iosystem_desc_t struct.
- * @param maplen the length of the map. This is the number of data
- * elements on the compute task.
- * @param compmap a 1 based array of offsets into the global space. A
- * 0 in this array indicates a value which should not be transfered.
  * @param gdimlen an array length ndims with the sizes of the global
  * dimensions.
  * @param ndims the number of dimensions.
  * @param iodesc a pointer to the io_desc_t struct, which must be
- * allocated before this function is called.
+ * allocated, with the map set, before this function is called.
  * @returns 0 on success, error code otherwise.
  * @author Jim Edwards
  */
-int box_rearrange_create(iosystem_desc_t *ios, int maplen, const PIO_Offset *compmap,
-                         const int *gdimlen, int ndims, io_desc_t *iodesc)
+int box_rearrange_create(iosystem_desc_t *ios, const int *gdimlen, int ndims,
+                         io_desc_t *iodesc)
 {
+    int maplen = iodesc->maplen; /* Number of data elements on the compute task. */
     int ret;
 
 #ifdef TIMING
     GPTLstart("PIO:box_rearrange_create");
 #endif
     /* Check inputs. */
-    pioassert(ios && maplen >= 0 && compmap && gdimlen && ndims > 0 && iodesc,
+    pioassert(ios && maplen >= 0 && gdimlen && ndims > 0 && iodesc,
               "invalid input", __FILE__, __LINE__);
     LOG((1, "box_rearrange_create maplen = %d ndims = %d ios->num_comptasks = %d "
          "ios->num_iotasks = %d", maplen, ndims, ios->num_comptasks, ios->num_iotasks));
@@ -1305,7 +1690,6 @@ int box_rearrange_create(iosystem_desc_t *ios, int maplen, const PIO_Offset *com
     /* Allocate arrays needed for this function. */
     int *dest_ioproc = NULL; /* Destination IO task for each data element on compute task. */
     PIO_Offset *dest_ioindex = NULL;    /* Offset into IO task array for each data element. */
-    PIO_Offset **gcoord_map = NULL; /* Global coordinate value for each data element. */
     int sendcounts[ios->num_uniontasks]; /* Send counts for swapm call. */
     int sdispls[ios->num_uniontasks];    /* Send displacements for swapm. */
     int recvcounts[ios->num_uniontasks]; /* Receive counts for swapm. */
@@ -1339,21 +1723,6 @@ int box_rearrange_create(iosystem_desc_t *ios, int maplen, const PIO_Offset *com
             return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
                             "Creating BOX rearranger failed for I/O decomposition (ioid=%d) on iosystem (iosysid=%d). Out of memory allocating %lld bytes to store destination I/O indices while setting up the rearranger", iodesc->ioid, ios->iosysid, (unsigned long long) (maplen * sizeof(PIO_Offset)));
         }
-
-        if (!(gcoord_map = malloc(maplen * sizeof(PIO_Offset*))))
-        {
-            return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
-                            "Creating BOX rearranger failed for I/O decomposition (ioid=%d) on iosystem (iosysid=%d). Out of memory allocating %lld bytes to store global coordinate map while setting up the rearranger", iodesc->ioid, ios->iosysid, (unsigned long long) (maplen * sizeof(PIO_Offset)));
-        }
-
-        for (int i = 0; i < maplen; i++)
-        {
-            if (!(gcoord_map[i] = calloc(ndims, sizeof(PIO_Offset))))
-            {
-                return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
-                                "Creating BOX rearranger failed for I/O decomposition (ioid=%d) on iosystem (iosysid=%d). Out of memory allocating %lld bytes to store dim array global coordinate map (gcoord_map[%d]) while setting up the rearranger", iodesc->ioid, ios->iosysid, (unsigned long long) (ndims * sizeof(PIO_Offset)), i);
-            }
-        }
     }
 
     /* Initialize the sc_info send and recv messages */
@@ -1398,20 +1767,24 @@ int box_rearrange_create(iosystem_desc_t *ios, int maplen, const PIO_Offset *com
     if (ios->ioproc)
     {
         /* Determine llen, the lenght of the data array on this IO
-         * node, by multipliying the counts in the
-         * iodesc->firstregion. */
+         * node, by multipliying the counts in the first region of
+         * iodesc->regions. */
         iodesc->llen = 1;
         for (int i = 0; i < ndims; i++)
         {
-            iodesc->llen *= iodesc->firstregion->count[i];
-            LOG((3, "iodesc->firstregion->start[%d] = %d iodesc->firstregion->count[%d] = %d",
-                 i, iodesc->firstregion->start[i], i, iodesc->firstregion->count[i]));
+            iodesc->llen *= REGION_COUNT(iodesc->regions, 0)[i];
+            LOG((3, "region start[%d] = %d region count[%d] = %d",
+                 i, REGION_START(iodesc->regions, 0)[i], i, REGION_COUNT(iodesc->regions, 0)[i]));
         }
         LOG((2, "iodesc->llen = %d", iodesc->llen));
     }
 
+    /* The offsets in the IO buffer (rindex) are stored as int. */
+    if ((ret = check_iobuf_len(ios, iodesc, "BOX")))
+        return ret;
+
     /* Determine whether fill values will be needed. */
-    if ((ret = determine_fill(ios, iodesc, gdimlen, compmap)))
+    if ((ret = determine_fill(ios, iodesc, gdimlen)))
     {
         return pio_err(ios, NULL, ret, __FILE__, __LINE__,
                         "Creating BOX rearranger failed for I/O decomposition (iodi=%d) on iosystem (iosysid=%d). Unable to determine fillvalue to use", iodesc->ioid, ios->iosysid);
@@ -1426,8 +1799,8 @@ int box_rearrange_create(iosystem_desc_t *ios, int maplen, const PIO_Offset *com
     for (int j = 0; j < ndims; j++)
     {
         /* The first data in sc_info_msg_send[] is the iomaplen */
-        sc_info_msg_send[j + 1] = iodesc->firstregion->start[j];
-        sc_info_msg_send[ndims + j + 1] = iodesc->firstregion->count[j];
+        sc_info_msg_send[j + 1] = REGION_START(iodesc->regions, 0)[j];
+        sc_info_msg_send[ndims + j + 1] = REGION_COUNT(iodesc->regions, 0)[j];
     }
 
     /* Set the recvcounts/recv displs for the sc_info msg from each io task */
@@ -1482,18 +1855,6 @@ int box_rearrange_create(iosystem_desc_t *ios, int maplen, const PIO_Offset *com
         LOG((3, "iomaplen[%d] = %d", i, sc_info_msg_recv[i * sc_info_msg_sz]));
 #endif /* PIO_ENABLE_LOGGING */
 
-    /* Convert a 1-D index into a global coordinate value for each data element */
-    for (int k = 0; k < maplen; k++)
-    {
-        /* The compmap array is 1 based but calculations are 0 based */
-        LOG((3, "about to call idx_to_dim_list ndims = %d ", ndims));
-        idx_to_dim_list(ndims, gdimlen, compmap[k] - 1, gcoord_map[k]);
-#if PIO_ENABLE_LOGGING
-        for (int d = 0; d < ndims; d++)
-            LOG((3, "gcoord_map[%d][%d] = %lld", k, d, gcoord_map[k][d]));
-#endif /* PIO_ENABLE_LOGGING */
-    }
-
     for (int i = 0; i < ios->num_iotasks; i++)
     {
         /* First entry in the sc_info msg is the iomaplen */
@@ -1514,57 +1875,14 @@ int box_rearrange_create(iosystem_desc_t *ios, int maplen, const PIO_Offset *com
             /* For each element of the data array on the compute task,
              * find the IO task to send the data element to, and its
              * offset into the global data array. */
-            for (int k = 0; k < maplen; k++)
-            {
-                /* An IO task has already been found for this element */
-                if (dest_ioproc[k] >= 0)
-                    continue;
-
-                PIO_Offset lcoord[ndims];
-                bool found = true;
-
-                /* Find a destination for each entry in the compmap. */
-                for (int j = 0; j < ndims; j++)
-                {
-                    if (gcoord_map[k][j] >= start[j] && gcoord_map[k][j] < start[j] + count[j])
-                    {
-                        lcoord[j] = gcoord_map[k][j] - start[j];
-                    }
-                    else
-                    {
-                        found = false;
-                        break;
-                    }
-                }
-
-                /* Did we find a destination IO task for this element
-                 * of the computation task data array? If so, remember
-                 * the destination IO task, and determine the index
-                 * for that element in the IO task data. */
-                if (found)
-                {
-                    dest_ioindex[k] = coord_to_lindex(ndims, lcoord, count);
-                    dest_ioproc[k] = i;
-                    LOG((3, "found dest_ioindex[%d] = %d dest_ioproc[%d] = %d", k, dest_ioindex[k],
-                         k, dest_ioproc[k]));
-                }
-            }
+            find_box_dests(iodesc, gdimlen, ndims, i, start, count, dest_ioproc,
+                           dest_ioindex);
         }
     }
 
-    for (int i = 0; i < maplen; i++)
-        free(gcoord_map[i]);
-    free(gcoord_map);
-    gcoord_map = NULL;
-
     /* Check that a destination is found for each compmap entry. */
-    for (int k = 0; k < maplen; k++)
-        if (dest_ioproc[k] < 0 && compmap[k] > 0)
-        {
-            LOG((1, "Error: Found dest_ioproc[%d] = %d and compmap[%d] = %lld", k, dest_ioproc[k], k, compmap[k]));
-            return pio_err(ios, NULL, PIO_EINVAL, __FILE__, __LINE__,
-                            "Creating BOX rearranger failed for I/O decomposition (ioid=%d) on iosystem (iosysid=%d). Unable to find a destination I/O process for data (compmap[%d]=%lld)", iodesc->ioid, ios->iosysid, k, (unsigned long long)(compmap[k]));
-        }
+    if ((ret = check_box_dests(ios, iodesc, dest_ioproc)))
+        return ret;
 
     /* Completes the mapping for the box rearranger. */
     LOG((2, "calling compute_counts maplen = %d", maplen));
@@ -1608,16 +1926,17 @@ int box_rearrange_create(iosystem_desc_t *ios, int maplen, const PIO_Offset *com
 /* The box_rearrange_create algorithm optimized for the case where many
  * iotasks have iomaplen == 0 (holes)
  */
-int box_rearrange_create_with_holes(iosystem_desc_t *ios, int maplen, const PIO_Offset *compmap,
-                         const int *gdimlen, int ndims, io_desc_t *iodesc)
+int box_rearrange_create_with_holes(iosystem_desc_t *ios, const int *gdimlen, int ndims,
+                                    io_desc_t *iodesc)
 {
+    int maplen = iodesc->maplen; /* Number of data elements on the compute task. */
     int ret;
 
 #ifdef TIMING
     GPTLstart("PIO:box_rearrange_create_with_holes");
 #endif
     /* Check inputs. */
-    pioassert(ios && maplen >= 0 && compmap && gdimlen && ndims > 0 && iodesc,
+    pioassert(ios && maplen >= 0 && gdimlen && ndims > 0 && iodesc,
               "invalid input", __FILE__, __LINE__);
     LOG((1, "box_rearrange_create maplen = %d ndims = %d ios->num_comptasks = %d "
          "ios->num_iotasks = %d", maplen, ndims, ios->num_comptasks, ios->num_iotasks));
@@ -1625,7 +1944,6 @@ int box_rearrange_create_with_holes(iosystem_desc_t *ios, int maplen, const PIO_
     /* Allocate arrays needed for this function. */
     int *dest_ioproc = NULL; /* Destination IO task for each data element on compute task. */
     PIO_Offset *dest_ioindex = NULL;    /* Offset into IO task array for each data element. */
-    PIO_Offset **gcoord_map = NULL; /* Global coordinate value for each data element. */
     int sendcounts[ios->num_uniontasks]; /* Send counts for swapm call. */
     int sdispls[ios->num_uniontasks];    /* Send displacements for swapm. */
     int recvcounts[ios->num_uniontasks]; /* Receive counts for swapm. */
@@ -1652,21 +1970,6 @@ int box_rearrange_create_with_holes(iosystem_desc_t *ios, int maplen, const PIO_
             return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
                             "Creating BOX rearranger failed for I/O decomposition (ioid=%d) on iosystem (iosysid=%d). Out of memory allocating %lld bytes to store destination I/O indices while setting up the rearranger", iodesc->ioid, ios->iosysid, (unsigned long long) (maplen * sizeof(PIO_Offset)));
         }
-
-        if (!(gcoord_map = malloc(maplen * sizeof(PIO_Offset*))))
-        {
-            return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
-                            "Creating BOX rearranger failed for I/O decomposition (ioid=%d) on iosystem (iosysid=%d). Out of memory allocating %lld bytes to store global coordinate map while setting up the rearranger", iodesc->ioid, ios->iosysid, (unsigned long long) (maplen * sizeof(PIO_Offset)));
-        }
-
-        for (int i = 0; i < maplen; i++)
-        {
-            if (!(gcoord_map[i] = calloc(ndims, sizeof(PIO_Offset))))
-            {
-                return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
-                                "Creating BOX rearranger failed for I/O decomposition (ioid=%d) on iosystem (iosysid=%d). Out of memory allocating %lld bytes to store dimension info in global coordinate map (gcoord_map[%d]) while setting up the rearranger", iodesc->ioid, ios->iosysid, (unsigned long long) (ndims * sizeof(PIO_Offset)), i);
-            }
-        }
     }
 
     /* Initialize array values. */
@@ -1703,20 +2006,24 @@ int box_rearrange_create_with_holes(iosystem_desc_t *ios, int maplen, const PIO_
             sendcounts[ios->ioranks[i]] = 1;
 
         /* Determine llen, the lenght of the data array on this IO
-         * node, by multipliying the counts in the
-         * iodesc->firstregion. */
+         * node, by multipliying the counts in the first region of
+         * iodesc->regions. */
         iodesc->llen = 1;
         for (int i = 0; i < ndims; i++)
         {
-            iodesc->llen *= iodesc->firstregion->count[i];
-            LOG((3, "iodesc->firstregion->start[%d] = %d iodesc->firstregion->count[%d] = %d",
-                 i, iodesc->firstregion->start[i], i, iodesc->firstregion->count[i]));
+            iodesc->llen *= REGION_COUNT(iodesc->regions, 0)[i];
+            LOG((3, "region start[%d] = %d region count[%d] = %d",
+                 i, REGION_START(iodesc->regions, 0)[i], i, REGION_COUNT(iodesc->regions, 0)[i]));
         }
         LOG((2, "iodesc->llen = %d", iodesc->llen));
     }
 
+    /* The offsets in the IO buffer (rindex) are stored as int. */
+    if ((ret = check_iobuf_len(ios, iodesc, "BOX")))
+        return ret;
+
     /* Determine whether fill values will be needed. */
-    if ((ret = determine_fill(ios, iodesc, gdimlen, compmap)))
+    if ((ret = determine_fill(ios, iodesc, gdimlen)))
     {
         return pio_err(ios, NULL, ret, __FILE__, __LINE__,
                         "Creating BOX rearranger failed for I/O decomposition (ioid=%d) on iosystem (iosysid=%d). Unable to determine fillvalue to use", iodesc->ioid, ios->iosysid);
@@ -1750,18 +2057,6 @@ int box_rearrange_create_with_holes(iosystem_desc_t *ios, int maplen, const PIO_
         LOG((3, "iomaplen[%d] = %d", i, iomaplen[i]));
 #endif /* PIO_ENABLE_LOGGING */
 
-    /* Convert a 1-D index into a global coordinate value for each data element */
-    for (int k = 0; k < maplen; k++)
-    {
-        /* The compmap array is 1 based but calculations are 0 based */
-        LOG((3, "about to call idx_to_dim_list ndims = %d ", ndims));
-        idx_to_dim_list(ndims, gdimlen, compmap[k] - 1, gcoord_map[k]);
-#if PIO_ENABLE_LOGGING
-        for (int d = 0; d < ndims; d++)
-            LOG((3, "gcoord_map[%d][%d] = %lld", k, d, gcoord_map[k][d]));
-#endif /* PIO_ENABLE_LOGGING */
-    }
-
     /* For each IO task send starts/counts to all compute tasks. */
     for (int i = 0; i < ios->num_iotasks; i++)
     {
@@ -1779,8 +2074,8 @@ int box_rearrange_create_with_holes(iosystem_desc_t *ios, int maplen, const PIO_
             /* start/count array to be sent: 1st half for start, 2nd half for count */
             for (int j = 0; j < ndims; j++)
             {
-                start_count_send[j] = iodesc->firstregion->start[j];
-                start_count_send[ndims + j] = iodesc->firstregion->count[j];
+                start_count_send[j] = REGION_START(iodesc->regions, 0)[j];
+                start_count_send[ndims + j] = REGION_COUNT(iodesc->regions, 0)[j];
             }
 
             /* Set up send/recv parameters for all to all gather of
@@ -1819,56 +2114,14 @@ int box_rearrange_create_with_holes(iosystem_desc_t *ios, int maplen, const PIO_
             /* For each element of the data array on the compute task,
              * find the IO task to send the data element to, and its
              * offset into the global data array. */
-            for (int k = 0; k < maplen; k++)
-            {
-                /* An IO task has already been found for this element */
-                if (dest_ioproc[k] >= 0)
-                    continue;
-
-                PIO_Offset lcoord[ndims];
-                bool found = true;
-
-                /* Find a destination for each entry in the compmap. */
-                for (int j = 0; j < ndims; j++)
-                {
-                    if (gcoord_map[k][j] >= start[j] && gcoord_map[k][j] < start[j] + count[j])
-                    {
-                        lcoord[j] = gcoord_map[k][j] - start[j];
-                    }
-                    else
-                    {
-                        found = false;
-                        break;
-                    }
-                }
-
-                /* Did we find a destination IO task for this element
-                 * of the computation task data array? If so, remember
-                 * the destination IO task, and determine the index
-                 * for that element in the IO task data. */
-                if (found)
-                {
-                    dest_ioindex[k] = coord_to_lindex(ndims, lcoord, count);
-                    dest_ioproc[k] = i;
-                    LOG((3, "found dest_ioindex[%d] = %d dest_ioproc[%d] = %d", k, dest_ioindex[k],
-                         k, dest_ioproc[k]));
-                }
-            }
+            find_box_dests(iodesc, gdimlen, ndims, i, start, count, dest_ioproc,
+                           dest_ioindex);
         }
     }
 
-    for (int i = 0; i < maplen; i++)
-        free(gcoord_map[i]);
-    free(gcoord_map);
-    gcoord_map = NULL;
-
     /* Check that a destination is found for each compmap entry. */
-    for (int k = 0; k < maplen; k++)
-        if (dest_ioproc[k] < 0 && compmap[k] > 0)
-        {
-            return pio_err(ios, NULL, PIO_EINVAL, __FILE__, __LINE__,
-                            "Creating BOX rearranger failed for I/O decomposition (ioid=%d) on iosystem (iosysid=%d). Unable to find a destination I/O process for data (compmap[%d]=%lld)", iodesc->ioid, ios->iosysid, k, (unsigned long long)(compmap[k]));
-        }
+    if ((ret = check_box_dests(ios, iodesc, dest_ioproc)))
+        return ret;
 
     /* Completes the mapping for the box rearranger. */
     LOG((2, "calling compute_counts maplen = %d", maplen));
@@ -1925,7 +2178,7 @@ int compare_offsets(const void *a, const void *b)
     mapsort *y = (mapsort *)b;
     if (!x || !y)
         return 0;
-    return (int)(x->iomap - y->iomap);
+    return (x->iomap > y->iomap) - (x->iomap < y->iomap);
 }
 
 /**
@@ -1942,76 +2195,348 @@ int compare_offsets(const void *a, const void *b)
  * dimensions.
  * @param maplen the length of the map
  * @param map may be NULL (when ???).
- * @param maxregions
- * @param firstregion pointer to the first region.
+ * @param maxregions pointer that gets the number of regions found.
+ * @param regions pointer to the region table that gets the
+ * regions. On return it holds at least one (possibly empty) region.
  * @returns 0 on success, error code otherwise.
  * @author Jim Edwards
  */
 int get_regions(int ndims, const int *gdimlen, int maplen, const PIO_Offset *map,
-                int *maxregions, io_region *firstregion)
+                int *maxregions, io_region_table *regions)
 {
     int nmaplen = 0;
     int regionlen;
-    io_region *region;
+    int nregions = 0;
     int ret;
 
     /* Check inputs. */
-    pioassert(ndims >= 0 && gdimlen && maplen >= 0 && maxregions && firstregion,
-              "invalid input", __FILE__, __LINE__);
+    pioassert(ndims >= 0 && gdimlen && maplen >= 0 && maxregions && regions &&
+              regions->ndims == ndims, "invalid input", __FILE__, __LINE__);
     LOG((1, "get_regions ndims = %d maplen = %d", ndims, maplen));
 
-    region = firstregion;
+    /* Skip the holes at the start of the map. */
     if (map)
-    {
-        while (map[nmaplen++] <= 0)
-        {
-            LOG((3, "map[%d] = %d", nmaplen, map[nmaplen]));
-            ;
-        }
-        nmaplen--;
-    }
-    region->loffset = nmaplen;
-    LOG((2, "region->loffset = %d", region->loffset));
+        while (nmaplen < maplen && map[nmaplen] <= 0)
+            nmaplen++;
 
-    *maxregions = 1;
+    /* The first region always exists, it is empty if there is no
+     * data. */
+    memset(REGION_START(regions, 0), 0, ndims * sizeof(PIO_Offset));
+    memset(REGION_COUNT(regions, 0), 0, ndims * sizeof(PIO_Offset));
+    regions->loffset[0] = nmaplen;
+    LOG((2, "regions->loffset[0] = %d", regions->loffset[0]));
 
     while (nmaplen < maplen)
     {
+        PIO_Offset *start, *count;
+
+        /* Make room for the next region. */
+        if ((ret = grow_region_table(NULL, regions, nregions + 1)))
+            return ret;
+        start = REGION_START(regions, nregions);
+        count = REGION_COUNT(regions, nregions);
+
+        /* The offset into the local array buffer is the sum of the
+         * sizes of all of the previous regions (loffset). */
+        regions->loffset[nregions] = nmaplen;
+
         /* Here we find the largest region from the current offset
            into the iomap. regionlen is the size of that region and we
            step to that point in the map array until we reach the
            end. */
         for (int i = 0; i < ndims; i++)
-            region->count[i] = 1;
+            count[i] = 1;
 
         /* Set start/count to describe first region in map. */
         regionlen = find_region(ndims, gdimlen, maplen-nmaplen,
-                                &map[nmaplen], region->start, region->count);
-        pioassert(region->start[0] >= 0, "failed to find region", __FILE__, __LINE__);
+                                &map[nmaplen], start, count);
+        pioassert(start[0] >= 0, "failed to find region", __FILE__, __LINE__);
 
         nmaplen = nmaplen + regionlen;
+        nregions++;
         LOG((2, "regionlen = %d nmaplen = %d", regionlen, nmaplen));
+    }
+
+    /* The calls to the io library are collective and so we must have
+       the same number of regions on each io task maxregions will be
+       the total number of regions on this task. */
+    regions->nregions = nregions ? nregions : 1;
+    *maxregions = regions->nregions;
+    LOG((2, "*maxregions = %d", *maxregions));
+
+    return PIO_NOERR;
+}
+
+/*
+ * The boxes of coalesce_regions() are stored in rows of 2 + 2 *
+ * ndims PIO_Offsets: the number of dimensions, the dimension being
+ * merged (-1 to sort by start only), the start and the count.
+ */
+#define BOX_NDIMS(b) ((int)(b)[0])
+#define BOX_DIM(b) ((int)(b)[1])
+#define BOX_START(b) ((b) + 2)
+#define BOX_COUNT(b) ((b) + 2 + BOX_NDIMS(b))
+
+/**
+ * Compare two boxes of coalesce_regions() in all the dimensions but
+ * the merge dimension. In the other dimensions boxes that can be
+ * merged must have the same start and count.
+ *
+ * @param x pointer to a box.
+ * @param y pointer to another box.
+ * @returns <0, 0 or >0 as x sorts before, with or after y.
+ */
+static int compare_box_rows(const PIO_Offset *x, const PIO_Offset *y)
+{
+    int dim = BOX_DIM(x);
+
+    for (int d = 0; d < BOX_NDIMS(x); d++)
+    {
+        if (d == dim)
+            continue;
+        if (BOX_START(x)[d] != BOX_START(y)[d])
+            return BOX_START(x)[d] < BOX_START(y)[d] ? -1 : 1;
+        if (dim >= 0 && BOX_COUNT(x)[d] != BOX_COUNT(y)[d])
+            return BOX_COUNT(x)[d] < BOX_COUNT(y)[d] ? -1 : 1;
+    }
+
+    return 0;
+}
+
+/**
+ * Compare two boxes of coalesce_regions(). Passed to qsort. Boxes
+ * that only differ in the merge dimension sort next to each other, in
+ * the order of their start in that dimension. With a merge dimension
+ * of -1 boxes sort by their start.
+ *
+ * @param a pointer to a box.
+ * @param b pointer to another box.
+ * @returns <0, 0 or >0 as a sorts before, with or after b.
+ */
+static int compare_boxes(const void *a, const void *b)
+{
+    const PIO_Offset *x = a;
+    const PIO_Offset *y = b;
+    int dim = BOX_DIM(x);
+    int cmp;
+
+    if ((cmp = compare_box_rows(x, y)))
+        return cmp;
+    if (dim >= 0 && BOX_START(x)[dim] != BOX_START(y)[dim])
+        return BOX_START(x)[dim] < BOX_START(y)[dim] ? -1 : 1;
+
+    return 0;
+}
+
+/**
+ * Compare two offsets of a map. Passed to bsearch.
+ *
+ * @param a pointer to an offset.
+ * @param b pointer to another offset.
+ * @returns <0, 0 or >0 as a is less than, equal to or greater than b.
+ */
+static int compare_map_offsets(const void *a, const void *b)
+{
+    PIO_Offset x = *(const PIO_Offset *)a;
+    PIO_Offset y = *(const PIO_Offset *)b;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ * Reduce the number of regions of the IO buffer of a subset
+ * rearranger decomposition. This is an internal function called by
+ * subset_rearrange_create() on the IO tasks, after get_regions().
+ *
+ * The IO buffer is laid out in the order of the sorted iomap, and
+ * get_regions() cuts it greedily into boxes. When an IO task holds
+ * several boxes that overlap in the outer dimensions, their rows
+ * alternate in the sorted map and each row becomes a region. This
+ * function finds the boxes instead: it splits the map into runs
+ * along the fastest varying dimension, and merges the runs that are
+ * identical but for the start in one dimension, from the innermost
+ * dimension outwards. If this gives fewer boxes than get_regions()
+ * found, the IO buffer is laid out box by box (iodesc->rindex and
+ * iomap are permuted) and the regions are found again. If the boxes
+ * overlap in the outer dimensions, the union of the regions is then
+ * no longer in the order of the IO buffer, and
+ * iodesc->regions_unordered is set (on this IO task).
+ *
+ * @param ios pointer to the iosystem_desc_t struct.
+ * @param iodesc a pointer to the io_desc_t struct. The rindex array
+ * and regions table are changed if the regions can be reduced.
+ * @param gdimlen an array length ndims with the sizes of the global
+ * dimensions.
+ * @param iomap the sorted 1-based map (length iodesc->llen) of the
+ * IO buffer. It gets the new order of the IO buffer.
+ * @returns 0 on success, error code otherwise.
+ */
+int coalesce_regions(iosystem_desc_t *ios, io_desc_t *iodesc, const int *gdimlen,
+                     PIO_Offset *iomap)
+{
+    int ndims = iodesc->ndims;
+    size_t esize = 2 + 2 * ndims;
+    PIO_Offset *boxes;
+    PIO_Offset *newmap;
+    PIO_Offset stride[ndims];
+    int nruns = 0;
+    int nboxes = 0;
+    int nregions = iodesc->regions->nregions;
+    int pos = 0;
+    int ret;
 
-        /* If we need to, allocate the next region. */
-        if (region->next == NULL && nmaplen < maplen)
+    pioassert(ios && iodesc && gdimlen, "invalid input", __FILE__, __LINE__);
+
+    /* The runs of a one-dimensional map are already the largest
+     * regions. */
+    if (ndims < 2 || iodesc->llen <= 0 || nregions < 2)
+        return PIO_NOERR;
+
+    stride[ndims - 1] = 1;
+    for (int d = ndims - 2; d >= 0; d--)
+        stride[d] = stride[d + 1] * gdimlen[d + 1];
+
+    /* Count the runs along the fastest varying dimension first, there
+     * is one box for each of them, rather than one for each element
+     * of the IO buffer. */
+    for (int i = 0; i < iodesc->llen; i++)
+        if (!(i > 0 && iomap[i] == iomap[i - 1] + 1 && (iomap[i] - 1) % gdimlen[ndims - 1]))
+            nruns++;
+
+    if (!(boxes = malloc(nruns * esize * sizeof(PIO_Offset))))
+        return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
+                        "Coalescing the regions of I/O decomposition (ioid=%d) failed. Out of memory allocating %lld bytes for the boxes", iodesc->ioid, (unsigned long long)(nruns * esize * sizeof(PIO_Offset)));
+
+    /* Split the map into runs along the fastest varying dimension. */
+    for (int i = 0; i < iodesc->llen; i++)
+    {
+        PIO_Offset off = iomap[i] - 1;
+        PIO_Offset *box;
+
+        if (i > 0 && iomap[i] == iomap[i - 1] + 1 && off % gdimlen[ndims - 1])
+        {
+            BOX_COUNT(boxes + (nboxes - 1) * esize)[ndims - 1]++;
+            continue;
+        }
+
+        box = boxes + nboxes++ * esize;
+        box[0] = ndims;
+        for (int d = 0; d < ndims; d++)
+        {
+            BOX_START(box)[d] = off / stride[d];
+            off %= stride[d];
+            BOX_COUNT(box)[d] = 1;
+        }
+    }
+    LOG((2, "coalesce_regions ioid = %d llen = %d runs = %d regions = %d", iodesc->ioid,
+         iodesc->llen, nboxes, nregions));
+
+    /* Merge the boxes along each of the other dimensions. */
+    for (int dim = ndims - 2; dim >= 0; dim--)
+    {
+        int n = 0;
+
+        for (int b = 0; b < nboxes; b++)
+            boxes[b * esize + 1] = dim;
+        qsort(boxes, nboxes, esize * sizeof(PIO_Offset), compare_boxes);
+
+        for (int b = 1; b < nboxes; b++)
+        {
+            PIO_Offset *last = boxes + n * esize;
+            PIO_Offset *box = boxes + b * esize;
+
+            if (!compare_box_rows(last, box) &&
+                BOX_START(box)[dim] == BOX_START(last)[dim] + BOX_COUNT(last)[dim])
+                BOX_COUNT(last)[dim] += BOX_COUNT(box)[dim];
+            else if (++n != b)
+                memcpy(boxes + n * esize, box, esize * sizeof(PIO_Offset));
+        }
+        nboxes = n + 1;
+    }
+    LOG((2, "coalesce_regions ioid = %d boxes = %d", iodesc->ioid, nboxes));
+
+    /* Keep the layout of the sorted map, unless the boxes reduce the
+     * regions. */
+    if (nboxes >= nregions)
+    {
+        free(boxes);
+        return PIO_NOERR;
+    }
+
+    /* Lay the IO buffer out box by box, in the order of the box
+     * starts. */
+    for (int b = 0; b < nboxes; b++)
+        boxes[b * esize + 1] = -1;
+    qsort(boxes, nboxes, esize * sizeof(PIO_Offset), compare_boxes);
+
+    /* The union of the boxes is in the order of the buffer if each
+     * box ends before the next one starts. */
+    for (int b = 1; b < nboxes && !iodesc->regions_unordered; b++)
+    {
+        PIO_Offset *prev = boxes + (b - 1) * esize;
+        PIO_Offset *box = boxes + b * esize;
+        PIO_Offset prev_end = 0, box_start = 0;
+
+        for (int d = 0; d < ndims; d++)
         {
-            LOG((2, "allocating next region"));
-            if ((ret = alloc_region2(NULL, ndims, &region->next)))
-                return ret;
+            prev_end += (BOX_START(prev)[d] + BOX_COUNT(prev)[d] - 1) * stride[d];
+            box_start += BOX_START(box)[d] * stride[d];
+        }
+        if (prev_end > box_start)
+            iodesc->regions_unordered = true;
+    }
 
-            /* The offset into the local array buffer is the sum of
-             * the sizes of all of the previous regions (loffset) */
-            region = region->next;
-            region->loffset = nmaplen;
+    if (!(newmap = malloc(iodesc->llen * sizeof(PIO_Offset))))
+    {
+        free(boxes);
+        return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
+                        "Coalescing the regions of I/O decomposition (ioid=%d) failed. Out of memory allocating %lld bytes for the I/O map", iodesc->ioid, (unsigned long long)(iodesc->llen * sizeof(PIO_Offset)));
+    }
+
+    for (int b = 0; b < nboxes; b++)
+    {
+        PIO_Offset *box = boxes + b * esize;
+        PIO_Offset idx[ndims];
+        PIO_Offset nelems = 1;
+
+        for (int d = 0; d < ndims; d++)
+        {
+            idx[d] = 0;
+            nelems *= BOX_COUNT(box)[d];
+        }
+
+        /* Visit the elements of the box in row-major order. */
+        for (PIO_Offset e = 0; e < nelems; e++)
+        {
+            PIO_Offset value = 1;
+            PIO_Offset *found;
+
+            for (int d = 0; d < ndims; d++)
+                value += (BOX_START(box)[d] + idx[d]) * stride[d];
+            for (int d = ndims - 1; d >= 0 && ++idx[d] == BOX_COUNT(box)[d]; d--)
+                idx[d] = 0;
 
-            /* The calls to the io library are collective and so we
-               must have the same number of regions on each io task
-               maxregions will be the total number of regions on this
-               task. */
-            (*maxregions)++;
-            LOG((2, "*maxregions = %d", *maxregions));
+            /* The data received for this element of the sorted map
+             * goes to the next position of the IO buffer. */
+            found = bsearch(&value, iomap, iodesc->llen, sizeof(PIO_Offset), compare_map_offsets);
+            pioassert(found && pos < iodesc->llen, "box element not in map", __FILE__, __LINE__);
+            iodesc->rindex[found - iomap] = pos;
+            newmap[pos++] = value;
         }
     }
+    pioassert(pos == iodesc->llen, "boxes do not cover the map", __FILE__, __LINE__);
+    free(boxes);
+
+    memcpy(iomap, newmap, iodesc->llen * sizeof(PIO_Offset));
+    free(newmap);
+
+    /* Find the regions of the new layout. */
+    if ((ret = get_regions(ndims, gdimlen, iodesc->llen, iomap, &iodesc->maxregions,
+                           iodesc->regions)))
+        return pio_err(ios, NULL, ret, __FILE__, __LINE__,
+                        "Coalescing the regions of I/O decomposition (ioid=%d) failed. Getting the data regions of the new I/O buffer layout failed", iodesc->ioid);
+    LOG((2, "coalesce_regions ioid = %d reduced the regions from %d to %d", iodesc->ioid,
+         nregions, iodesc->maxregions));
 
     return PIO_NOERR;
 }
@@ -2125,48 +2650,49 @@ int default_subset_partition(iosystem_desc_t *ios, io_desc_t *iodesc)
  * <li>Allocates iodesc->scount array (length 1)
  * <li>Determins value of iodesc->scount[0], the number of data
  * elements on this compute task which are read/written.
- * <li>Allocated and inits iodesc->sindex (length iodesc->scount[0]),
- * init it to contain indicies to data.
- * <li>Pass the reduced maplen (without holes) from each compute task
- * to its associated IO task.
+ * <li>Allocates iodesc->sindex (length iodesc->scount[0]).
+ * <li>Pass the reduced maplen (without holes) and the number of
+ * ranges of the map from each compute task to its associated IO
+ * task.
  * <li>On IO tasks, determine llen.
  * <li>Determine whether fill values will be needed.
- * <li>Pass iodesc->sindex from each compute task to its associated IO
- * task.
- * <li>Create shrtmap, which is compmap without the holes.
- * <li>Gather shrtmaps from each task into iomap.
- * <li>On IO tasks, sort the mapping, this will transpose the data
+ * <li>Gather the ranges of the map without the holes (their first
+ * mapping, length and position in the map) from each task.
+ * <li>On IO tasks, sort the ranges, this will transpose the data
  * into IO order.
  * <li>On IO tasks, allocate and init iodesc->rindex and iodesc->rfrom
- * (length iodesc->llen).
+ * (length iodesc->llen), the iomap, and the indices of the data
+ * elements on each compute task in IO order (srcindex).
  * <li>On IO tasks, handle fill values, if needed.
  * <li>On IO tasks, scatter values of srcindex to subset communicator.
- * <li>On IO tasks, call get_regions() and distribute the max
- * maxregions to all tasks in IO communicator.
+ * <li>On IO tasks, call get_regions() and coalesce_regions(), and
+ * distribute the max maxregions to all tasks in IO communicator.
  * <li>On IO tasks, call compute_maxIObuffersize().
  * <li>Call compute_maxaggregate_bytes().
  * </ul>
  *
  * @param ios pointer to the iosystem_desc_t struct.
- * @param maplen the length of the map.
- * @param compmap a 1 based array of offsets into the array record on
- * file. A 0 in this array indicates a value which should not be
- * transfered.
  * @param gdimlen an array length ndims with the sizes of the global
  * dimensions.
  * @param ndims the number of dimensions.
- * @param iodesc a pointer to the io_desc_t struct.
+ * @param iodesc a pointer to the io_desc_t struct, with the map set.
  * @returns 0 on success, error code otherwise.
  * @author Jim Edwards
  */
-int subset_rearrange_create(iosystem_desc_t *ios, int maplen, PIO_Offset *compmap,
-                            const int *gdimlen, int ndims, io_desc_t *iodesc)
+int subset_rearrange_create(iosystem_desc_t *ios, const int *gdimlen, int ndims,
+                            io_desc_t *iodesc)
 {
     int i, j;
+    int maplen = iodesc->maplen;
     PIO_Offset *iomap = NULL;
     mapsort *map = NULL;
+    PIO_Offset *runs = NULL;    /* Ranges of the map without the holes. */
+    PIO_Offset *allruns = NULL; /* Ranges of the maps of the subset. */
+    int nruns = 0;
+    int totruns = 0;
+    int pos;
     PIO_Offset totalgridsize;
-    PIO_Offset *srcindex = NULL;
+    int *srcindex = NULL;
     PIO_Offset *myfillgrid = NULL;
     int maxregions;
     int rank, ntasks;
@@ -2178,9 +2704,8 @@ int subset_rearrange_create(iosystem_desc_t *ios, int maplen, PIO_Offset *compma
     GPTLstart("PIO:subset_rearrange_create");
 #endif
     /* Check inputs. */
-    pioassert(ios && maplen >= 0 && compmap && gdimlen && ndims >= 0 && iodesc,
+    pioassert(ios && maplen >= 0 && gdimlen && ndims >= 0 && iodesc,
               "invalid input", __FILE__, __LINE__);
-
     LOG((2, "subset_rearrange_create maplen = %d ndims = %d", maplen, ndims));
 
     /* subset partitions each have exactly 1 io task which is task 0
@@ -2237,30 +2762,46 @@ int subset_rearrange_create(iosystem_desc_t *ios, int maplen, PIO_Offset *compma
         totalgridsize *= gdimlen[i];
 
     /* Determine scount[0], the number of data elements in the
-     * computation task that are to be written, by looking at
-     * compmap. */
-    for (i = 0; i < maplen; i++)
+     * computation task that are to be written, and the number of
+     * ranges of the map they are in, by looking at the ranges of the
+     * map that are not holes. */
+    for (i = 0; i < iodesc->map_nranges; i++)
     {
-        /*  turns out this can be allowed in some cases
-            pioassert(compmap[i]>=0 && compmap[i]<=totalgridsize, "Compmap value out of bounds",
-            __FILE__,__LINE__); */
-        if (compmap[i] > 0)
-            (iodesc->scount[0])++;
+        if (iodesc->map_start[i] > 0)
+        {
+            iodesc->scount[0] += iodesc->map_count[i];
+            nruns++;
+        }
     }
 
     /* Allocate an array for indicies on the computation tasks (the
-     * send side when writing). */
+     * send side when writing). It gets the order of the data elements
+     * in the IO buffer from the IO task. */
     if (iodesc->scount[0] > 0)
-        if (!(iodesc->sindex = calloc(iodesc->scount[0], sizeof(PIO_Offset))))
+        if (!(iodesc->sindex = calloc(iodesc->scount[0], sizeof(int))))
         {
             return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
-                            "Creating SUBSET rearranger failed for I/O decomposition (ioid=%d) on iosystem (iosysid=%d). Out of memory allocating %lld bytes for storing send indices while setting up the rearranger", iodesc->ioid, ios->iosysid, (unsigned long long) (iodesc->scount[0] * sizeof(PIO_Offset)));
+                            "Creating SUBSET rearranger failed for I/O decomposition (ioid=%d) on iosystem (iosysid=%d). Out of memory allocating %lld bytes for storing send indices while setting up the rearranger", iodesc->ioid, ios->iosysid, (unsigned long long) (iodesc->scount[0] * sizeof(int)));
         }
 
-    j = 0;
-    for (i = 0; i < maplen; i++)
-        if (compmap[i] > 0)
-            iodesc->sindex[j++] = i;
+    /* Describe each range of the map that is not a hole by its first
+     * mapping, its length and its position in the map. */
+    if (!(runs = malloc(3 * max(nruns, 1) * sizeof(PIO_Offset))))
+    {
+        return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
+                        "Creating SUBSET rearranger failed for I/O decomposition (ioid=%d) on iosystem (iosysid=%d). Out of memory allocating %lld bytes for storing the ranges of the map while setting up the rearranger", iodesc->ioid, ios->iosysid, (unsigned long long) (3 * nruns * sizeof(PIO_Offset)));
+    }
+    for (i = 0, j = 0, pos = 0; i < iodesc->map_nranges; i++)
+    {
+        if (iodesc->map_start[i] > 0)
+        {
+            runs[3 * j] = iodesc->map_start[i];
+            runs[3 * j + 1] = iodesc->map_count[i];
+            runs[3 * j + 2] = pos;
+            j++;
+        }
+        pos += iodesc->map_count[i];
+    }
 
     /* Pass the reduced maplen (without holes) from each compute task
      * to its associated IO task. */
@@ -2272,6 +2813,14 @@ int subset_rearrange_create(iosystem_desc_t *ios, int maplen, PIO_Offset *compma
 
     int rdispls[ntasks];
     int recvcounts[ntasks];
+    int runcounts[ntasks];
+    int rundispls[ntasks];
+
+    /* Pass the number of ranges from each compute task to its
+     * associated IO task. */
+    if ((mpierr = MPI_Gather(&nruns, 1, MPI_INT, runcounts, rcnt, MPI_INT, 0,
+                             iodesc->subset_comm)))
+        return check_mpi(NULL, NULL, mpierr, __FILE__, __LINE__);
 
     /* On IO tasks determine llen. */
     if (ios->ioproc)
@@ -2283,19 +2832,11 @@ int subset_rearrange_create(iosystem_desc_t *ios, int maplen, PIO_Offset *compma
             recvcounts[i] = iodesc->rcount[i];
             if (i > 0)
                 rdispls[i] = rdispls[i - 1] + iodesc->rcount[i - 1];
+            totruns += runcounts[i];
+            runcounts[i] *= 3;
+            rundispls[i] = i ? rundispls[i - 1] + runcounts[i - 1] : 0;
         }
 
-        if (iodesc->llen > 0)
-        {
-            if (!(srcindex = calloc(iodesc->llen, sizeof(PIO_Offset))))
-            {
-                return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
-                                "Creating SUBSET rearranger failed for I/O decomposition (ioid=%d) on iosystem (iosysid=%d). Out of memory allocating %lld bytes for storing source indices while setting up the rearranger", iodesc->ioid, ios->iosysid, (unsigned long long) (iodesc->llen * sizeof(PIO_Offset)));
-            }
-
-            for (i = 0; i < iodesc->llen; i++)
-                srcindex[i] = 0;
-        }
     }
     else
     {
@@ -2303,94 +2844,113 @@ int subset_rearrange_create(iosystem_desc_t *ios, int maplen, PIO_Offset *compma
         {
             recvcounts[i] = 0;
             rdispls[i] = 0;
+            runcounts[i] = 0;
+            rundispls[i] = 0;
         }
     }
 
-    /* Determine whether fill values will be needed. */
-    if ((ret = determine_fill(ios, iodesc, gdimlen, compmap)))
-    {
-        return pio_err(ios, NULL, ret, __FILE__, __LINE__,
-                        "Creating SUBSET rearranger failed for I/O decomposition (ioid=%d) on iosystem (iosysid=%d). Unable to determine the fillvalue to be used", iodesc->ioid, ios->iosysid);
-    }
+    /* The offsets in the IO buffer (rindex) are stored as int. */
+    if ((ret = check_iobuf_len(ios, iodesc, "SUBSET")))
+        return ret;
 
-    /* Pass the sindex from each compute task to its associated IO task. */
-    if ((mpierr = MPI_Gatherv(iodesc->sindex, iodesc->scount[0], PIO_OFFSET,
-                              srcindex, recvcounts, rdispls, PIO_OFFSET, 0,
-                              iodesc->subset_comm)))
-        return check_mpi(NULL, NULL, mpierr, __FILE__, __LINE__);
-
-    /* On IO tasks which need it, allocate memory for the map and the
-     * iomap. */
     if (ios->ioproc && iodesc->llen > 0)
     {
-        if (!(map = calloc(iodesc->llen, sizeof(mapsort))))
+        if (!(srcindex = calloc(iodesc->llen, sizeof(int))))
         {
             return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
-                            "Creating SUBSET rearranger failed for I/O decomposition (ioid=%d) on iosystem (iosysid=%d). Out of memory allocating %lld bytes for storing internal map while setting up the rearranger", iodesc->ioid, ios->iosysid, (unsigned long long) (iodesc->llen * sizeof(mapsort)));
+                            "Creating SUBSET rearranger failed for I/O decomposition (ioid=%d) on iosystem (iosysid=%d). Out of memory allocating %lld bytes for storing source indices while setting up the rearranger", iodesc->ioid, ios->iosysid, (unsigned long long) (iodesc->llen * sizeof(int)));
         }
 
-        if (!(iomap = calloc(iodesc->llen, sizeof(PIO_Offset))))
+        if (!(allruns = malloc(3 * totruns * sizeof(PIO_Offset))))
         {
             return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
-                            "Creating SUBSET rearranger failed for I/O decomposition (ioid=%d) on iosystem (iosysid=%d). Out of memory allocating %lld bytes for storing internal I/O map while setting up the rearranger", iodesc->ioid, ios->iosysid, (unsigned long long) (iodesc->llen * sizeof(PIO_Offset)));
+                            "Creating SUBSET rearranger failed for I/O decomposition (ioid=%d) on iosystem (iosysid=%d). Out of memory allocating %lld bytes for storing the ranges of the maps while setting up the rearranger", iodesc->ioid, ios->iosysid, (unsigned long long) (3 * totruns * sizeof(PIO_Offset)));
         }
     }
 
-    /* Now pass the compmap, skipping the holes. */
-    PIO_Offset *shrtmap;
-    if (maplen > iodesc->scount[0] && iodesc->scount[0] > 0)
-    {
-        if (!(shrtmap = calloc(iodesc->scount[0], sizeof(PIO_Offset))))
-        {
-            return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
-                            "Creating SUBSET rearranger failed for I/O decomposition (ioid=%d) on iosystem (iosysid=%d). Out of memory allocating %lld bytes for storing internal comp map while setting up the rearranger", iodesc->ioid, ios->iosysid, (unsigned long long) (iodesc->scount[0] * sizeof(PIO_Offset)));
-        }
-
-        j = 0;
-        for (int i = 0; i < maplen; i++)
-            if (compmap[i] > 0)
-                shrtmap[j++] = compmap[i];
-    }
-    else
+    /* Determine whether fill values will be needed. */
+    if ((ret = determine_fill(ios, iodesc, gdimlen)))
     {
-        shrtmap = compmap;
+        return pio_err(ios, NULL, ret, __FILE__, __LINE__,
+                        "Creating SUBSET rearranger failed for I/O decomposition (ioid=%d) on iosystem (iosysid=%d). Unable to determine the fillvalue to be used", iodesc->ioid, ios->iosysid);
     }
 
-    /* Gather shrtmap from each task in the subset communicator, and
-     * put gathered results into iomap. */
-    if ((mpierr = MPI_Gatherv(shrtmap, iodesc->scount[0], PIO_OFFSET, iomap, recvcounts,
-                              rdispls, PIO_OFFSET, 0, iodesc->subset_comm)))
+    /* Gather the ranges of the maps from each task in the subset
+     * communicator. */
+    if ((mpierr = MPI_Gatherv(runs, 3 * nruns, PIO_OFFSET, allruns, runcounts, rundispls,
+                              PIO_OFFSET, 0, iodesc->subset_comm)))
         return check_mpi(NULL, NULL, mpierr, __FILE__, __LINE__);
+    free(runs);
 
-    if (shrtmap != compmap)
-        free(shrtmap);
-
-    /* On IO tasks that have data in the local array ??? */
+    /* On IO tasks that have data in the local array, sort the ranges
+     * of the maps, this will transpose the data into IO order. */
     if (ios->ioproc && iodesc->llen > 0)
     {
-        int pos = 0;
         int k = 0;
-        mapsort *mptr;
+        bool overlap = false;
+
+        if (!(map = malloc(totruns * sizeof(mapsort))))
+        {
+            return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
+                            "Creating SUBSET rearranger failed for I/O decomposition (ioid=%d) on iosystem (iosysid=%d). Out of memory allocating %lld bytes for storing internal map while setting up the rearranger", iodesc->ioid, ios->iosysid, (unsigned long long) (totruns * sizeof(mapsort)));
+        }
+
         for (i = 0; i < ntasks; i++)
         {
-            for (j = 0; j < iodesc->rcount[i]; j++)
+            for (j = 0; j < runcounts[i] / 3; j++)
             {
-                mptr = &map[k];
-                mptr->rfrom = i;
-                mptr->soffset = srcindex[pos + j];
-                mptr->iomap = iomap[pos + j];
+                PIO_Offset *run = &allruns[rundispls[i] + 3 * j];
+
+                map[k].rfrom = i;
+                map[k].iomap = run[0];
+                map[k].count = run[1];
+                map[k].soffset = run[2];
                 k++;
             }
-            pos += iodesc->rcount[i];
         }
+        free(allruns);
+        qsort(map, totruns, sizeof(mapsort), compare_offsets);
+
+        /* With repeated mappings the sorted ranges overlap. Sort the
+         * data elements instead. */
+        for (k = 1; k < totruns && !overlap; k++)
+            if (map[k].iomap < map[k - 1].iomap + map[k - 1].count)
+                overlap = true;
+        if (overlap)
+        {
+            mapsort *emap;
 
-        /* sort the mapping, this will transpose the data into IO order */
-        qsort(map, iodesc->llen, sizeof(mapsort), compare_offsets);
+            if (!(emap = malloc(iodesc->llen * sizeof(mapsort))))
+            {
+                return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
+                                "Creating SUBSET rearranger failed for I/O decomposition (ioid=%d) on iosystem (iosysid=%d). Out of memory allocating %lld bytes for storing internal map while setting up the rearranger", iodesc->ioid, ios->iosysid, (unsigned long long) (iodesc->llen * sizeof(mapsort)));
+            }
+            for (k = 0, j = 0; k < totruns; k++)
+            {
+                for (int e = 0; e < map[k].count; e++, j++)
+                {
+                    emap[j].rfrom = map[k].rfrom;
+                    emap[j].soffset = map[k].soffset + e;
+                    emap[j].count = 1;
+                    emap[j].iomap = map[k].iomap + e;
+                }
+            }
+            free(map);
+            map = emap;
+            totruns = iodesc->llen;
+            qsort(map, totruns, sizeof(mapsort), compare_offsets);
+        }
+
+        if (!(iomap = calloc(iodesc->llen, sizeof(PIO_Offset))))
+        {
+            return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
+                            "Creating SUBSET rearranger failed for I/O decomposition (ioid=%d) on iosystem (iosysid=%d). Out of memory allocating %lld bytes for storing internal I/O map while setting up the rearranger", iodesc->ioid, ios->iosysid, (unsigned long long) (iodesc->llen * sizeof(PIO_Offset)));
+        }
 
-        if (!(iodesc->rindex = calloc(1, iodesc->llen * sizeof(PIO_Offset))))
+        if (!(iodesc->rindex = calloc(1, iodesc->llen * sizeof(int))))
         {
             return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
-                            "Creating SUBSET rearranger failed for I/O decomposition (ioid=%d) on iosystem (iosysid=%d). Out of memory allocating %lld bytes for storing receive indices while setting up the rearranger", iodesc->ioid, ios->iosysid, (unsigned long long) (iodesc->llen * sizeof(PIO_Offset)));
+                            "Creating SUBSET rearranger failed for I/O decomposition (ioid=%d) on iosystem (iosysid=%d). Out of memory allocating %lld bytes for storing receive indices while setting up the rearranger", iodesc->ioid, ios->iosysid, (unsigned long long) (iodesc->llen * sizeof(int)));
         }
 
         if (!(iodesc->rfrom = calloc(1, iodesc->llen * sizeof(int))))
@@ -2398,24 +2958,27 @@ int subset_rearrange_create(iosystem_desc_t *ios, int maplen, PIO_Offset *compma
             return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
                             "Creating SUBSET rearranger failed for I/O decomposition (ioid=%d) on iosystem (iosysid=%d). Out of memory allocating %lld bytes for storing ranks to receive data from while setting up the rearranger", iodesc->ioid, ios->iosysid, (unsigned long long) (iodesc->llen * sizeof(int)));
         }
-    }
 
-    int cnt[ntasks];
-    for (i = 0; i < ntasks; i++)
-    {
-        cnt[i] = rdispls[i];
-    }
+        /* Init the rfrom and rindex arrays and the iomap in IO order,
+         * and the indices of the data elements of each compute task
+         * in IO order. */
+        int cnt[ntasks];
+        for (i = 0; i < ntasks; i++)
+            cnt[i] = rdispls[i];
 
-    /* For IO tasks init rfrom and rindex arrays (compute tasks have
-     * llen of 0). */
-    for (i = 0; i < iodesc->llen; i++)
-    {
-        mapsort *mptr = &map[i];
-        iodesc->rfrom[i] = mptr->rfrom;
-        iodesc->rindex[i] = i;
-        iomap[i] = mptr->iomap;
-        srcindex[(cnt[iodesc->rfrom[i]])++] = mptr->soffset;
+        for (k = 0, i = 0; k < totruns; k++)
+        {
+            for (int e = 0; e < map[k].count; e++, i++)
+            {
+                iodesc->rfrom[i] = map[k].rfrom;
+                iodesc->rindex[i] = i;
+                iomap[i] = map[k].iomap + e;
+                srcindex[(cnt[map[k].rfrom])++] = map[k].soffset + e;
+            }
+        }
     }
+    else
+        free(allruns);
 
     /* Handle fill values if needed. */
     if (ios->ioproc && iodesc->needsfill)
@@ -2546,14 +3109,14 @@ int subset_rearrange_create(iosystem_desc_t *ios, int maplen, PIO_Offset *compma
         iodesc->maxfillregions = 0;
         if (myfillgrid)
         {
-            /* Allocate a data region to hold fill values. */
-            if ((ret = alloc_region2(ios, iodesc->ndims, &iodesc->fillregion)))
+            /* Allocate a region table to hold fill values. */
+            if ((ret = alloc_region_table(ios, iodesc->ndims, &iodesc->fillregions)))
             {
                 return pio_err(ios, NULL, ret, __FILE__, __LINE__,
                                 "Creating SUBSET rearranger failed for I/O decomposition (ioid=%d) on iosystem (iosysid=%d). Allocating a data region to hold fillvalues failed", iodesc->ioid, ios->iosysid);
             }
             if ((ret = get_regions(iodesc->ndims, gdimlen, iodesc->holegridsize, myfillgrid,
-                                   &iodesc->maxfillregions, iodesc->fillregion)))
+                                   &iodesc->maxfillregions, iodesc->fillregions)))
             {
                 return pio_err(ios, NULL, ret, __FILE__, __LINE__,
                                 "Creating SUBSET rearranger failed for I/O decomposition (ioid=%d) on iosystem (iosysid=%d). Getting data regions with fillvalues failed", iodesc->ioid, ios->iosysid);
@@ -2578,8 +3141,8 @@ int subset_rearrange_create(iosystem_desc_t *ios, int maplen, PIO_Offset *compma
     }
 
     /* Scatter values of srcindex to subset communicator. ??? */
-    if ((mpierr = MPI_Scatterv((void *)srcindex, recvcounts, rdispls, PIO_OFFSET,
-                               (void *)iodesc->sindex, iodesc->scount[0],  PIO_OFFSET,
+    if ((mpierr = MPI_Scatterv((void *)srcindex, recvcounts, rdispls, MPI_INT,
+                               (void *)iodesc->sindex, iodesc->scount[0],  MPI_INT,
                                0, iodesc->subset_comm)))
         return check_mpi(NULL, NULL, mpierr, __FILE__, __LINE__);
 
@@ -2587,18 +3150,30 @@ int subset_rearrange_create(iosystem_desc_t *ios, int maplen, PIO_Offset *compma
     {
         iodesc->maxregions = 0;
         if ((ret = get_regions(iodesc->ndims, gdimlen, iodesc->llen, iomap,
-                               &iodesc->maxregions, iodesc->firstregion)))
+                               &iodesc->maxregions, iodesc->regions)))
         {
             return pio_err(ios, NULL, ret, __FILE__, __LINE__,
                             "Creating SUBSET rearranger failed for I/O decomposition (ioid=%d) on iosystem (iosysid=%d). Getting data regions with fillvalues failed", iodesc->ioid, ios->iosysid);
         }
-        maxregions = iodesc->maxregions;
 
-        /* Get the max maxregions, and distribute it to all tasks in
+        /* Lay the IO buffer out so that it has fewer regions, if
+         * possible. */
+        if ((ret = coalesce_regions(ios, iodesc, gdimlen, iomap)))
+        {
+            return pio_err(ios, NULL, ret, __FILE__, __LINE__,
+                            "Creating SUBSET rearranger failed for I/O decomposition (ioid=%d) on iosystem (iosysid=%d). Coalescing the data regions failed", iodesc->ioid, ios->iosysid);
+        }
+        /* Get the max maxregions, and whether the regions of any IO
+         * task are out of order, and distribute them to all tasks in
          * the IO communicator. */
-        if ((mpierr = MPI_Allreduce(MPI_IN_PLACE, &maxregions, 1, MPI_INT, MPI_MAX, ios->io_comm)))
-            return check_mpi(NULL, NULL, mpierr, __FILE__, __LINE__);
-        iodesc->maxregions = maxregions;
+        {
+            int maxr[2] = {iodesc->maxregions, iodesc->regions_unordered};
+
+            if ((mpierr = MPI_Allreduce(MPI_IN_PLACE, maxr, 2, MPI_INT, MPI_MAX, ios->io_comm)))
+                return check_mpi(NULL, NULL, mpierr, __FILE__, __LINE__);
+            iodesc->maxregions = maxr[0];
+            iodesc->regions_unordered = maxr[1];
+        }
 
         /* Free resources. */
         if (iomap)
@@ -2635,132 +3210,429 @@ int subset_rearrange_create(iosystem_desc_t *ios, int maplen, PIO_Offset *compma
 }
 
 /**
- * Performance tuning rearranger.
+ * Choose the rearranger of a decomposition initialized with
+ * PIO_REARR_AUTO. The costs of both rearrangers are estimated
+ * collectively from the map, without creating them:
+ * <ul>
+ * <li>BOX: the maximum number of IO tasks a compute task sends data
+ * to, plus the maximum number of compute tasks an IO task receives
+ * data from, plus the single region of each IO task.
+ * <li>SUBSET: the single IO task each compute task sends data to,
+ * plus the compute tasks in each subset, plus the estimated number
+ * of regions of each IO task (the contiguous runs in the maps of its
+ * compute tasks).
+ * </ul>
+ * The IO buffer of the box rearranger includes the holes in the map,
+ * so SUBSET is chosen if the BOX IO buffers are more than
+ * PIO_REARR_AUTO_MEM_RATIO times larger than the SUBSET ones.
+ * Otherwise the rearranger with the lower cost is chosen, BOX for
+ * equal costs. This function is collective across the compute and
+ * IO tasks.
  *
- * @param ios pointer to the iosystem description struct.
- * @param iodesc pointer to the IO description struct.
+ * @param ios pointer to the iosystem_desc_t struct.
+ * @param pio_type the PIO type of the data.
+ * @param ndims the number of dimensions.
+ * @param gdimlen an array length ndims with the sizes of the global
+ * dimensions.
+ * @param nranges the number of ranges of the map.
+ * @param rstart array (length nranges) with the 1-based first
+ * mapping of each range of the map, or 0 for a range of holes.
+ * @param rcount array (length nranges) with the length of each range
+ * of the map.
+ * @param iostart the start of the data of this IO task, if
+ * provided by the user (NULL otherwise).
+ * @param iocount the count of the data of this IO task, if provided
+ * by the user (NULL otherwise).
+ * @param rearrp pointer that gets PIO_REARR_BOX or PIO_REARR_SUBSET.
  * @returns 0 on success, error code otherwise.
- * @author Jim Edwards
  */
-void performance_tune_rearranger(iosystem_desc_t *ios, io_desc_t *iodesc)
+int choose_rearranger(iosystem_desc_t *ios, int pio_type, int ndims, const int *gdimlen,
+                      int nranges, const PIO_Offset *rstart, const int *rcount,
+                      const PIO_Offset *iostart, const PIO_Offset *iocount, int *rearrp)
 {
-#ifdef TIMING
-#ifdef PERFTUNE
-    double *wall, usr[2], sys[2];
-    void *cbuf, *ibuf;
-    int tsize;
-    int myrank;
-    int mpierr; /* Return code for MPI calls. */
+    int nio = ios->num_iotasks;
+    PIO_Offset *boxes;      /* Start and count of the box of each IO task. */
+    PIO_Offset coord[ndims];
+    int *recvs;             /* Compute tasks sending data to each IO task. */
+    int box = 0;            /* Box of the last row of the map. */
+    PIO_Offset prev = -1;   /* Last map element. */
+    PIO_Offset box_mem = 0;
+    /* Max fan-out, max map length and number of runs of the map. */
+    long long stats[3] = {0, 0, 0};
+    int maxrecvs = 0;
+    int box_cost, subset_cost;
+    PIO_Offset subset_regions, subset_mem;
+    int tasks_per_io;
+    int mpierr;
+    int ret = PIO_NOERR;
+
+    pioassert(ios && ndims > 0 && gdimlen && nranges >= 0 && (!nranges || (rstart && rcount)) &&
+              rearrp, "invalid input", __FILE__, __LINE__);
+
+    /* The tasks do not all have the maps with async I/O. */
+    if (ios->async)
+    {
+        LOG((1, "choose_rearranger using the box rearranger with async I/O"));
+        *rearrp = PIO_REARR_BOX;
+        return PIO_NOERR;
+    }
+
+    if (!(boxes = calloc(nio * 2 * ndims, sizeof(PIO_Offset))))
+        return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
+                        "Choosing the rearranger of the decomposition failed. Out of memory allocating %lld bytes for the IO task boxes", (unsigned long long)(nio * 2 * ndims * sizeof(PIO_Offset)));
+    if (!(recvs = calloc(nio, sizeof(int))))
+    {
+        free(boxes);
+        return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
+                        "Choosing the rearranger of the decomposition failed. Out of memory allocating %lld bytes for the IO task receive counts", (unsigned long long)(nio * sizeof(int)));
+    }
 
-    assert(iodesc);
+    /* Get the boxes the box rearranger would use on all tasks. */
+    if (ios->ioproc)
+    {
+        PIO_Offset *mybox = boxes + ios->io_rank * 2 * ndims;
 
-    if ((mpierr = MPI_Type_size(iodesc->mpitype, &tsize)))
-        return check_mpi(NULL, NULL, mpierr, __FILE__, __LINE__);
-    cbuf = NULL;
-    ibuf = NULL;
-    if (iodesc->ndof > 0)
-        if (!(cbuf = bget(iodesc->ndof * tsize)))
+        if (iostart && iocount)
+        {
+            for (int d = 0; d < ndims; d++)
+            {
+                mybox[d] = iostart[d];
+                mybox[ndims + d] = iocount[d];
+            }
+        }
+        else
         {
-            return pio_err(ios, file, PIO_ENOMEM, __FILE__, __LINE__,
-                            "Performance tuning of the rearranger failed for I/O decomposition (ioid=%d) on iosystem (iosysid=%d). Out of memory allocating %lld bytes for buffer on compute processes", iodesc->ioid, ios->iosysid, (unsigned long long) (iodesc->ndof * tsize));
+            PIO_Offset stripe_size;
+            int num_aiotasks;
+
+            if (!(ret = get_box_stripe_size(ios, &stripe_size)))
+                ret = CalcStartandCount(pio_type, ndims, gdimlen, nio, ios->io_rank,
+                                        stripe_size, mybox, mybox + ndims, &num_aiotasks);
         }
 
-    if (iodesc->llen > 0)
-        if (!(ibuf = bget(iodesc->llen * tsize)))
+        /* The IO tasks gather the boxes only if all of them have one. */
+        if ((mpierr = MPI_Allreduce(MPI_IN_PLACE, &ret, 1, MPI_INT, MPI_MIN, ios->io_comm)))
+            ret = check_mpi(ios, NULL, mpierr, __FILE__, __LINE__);
+        if (!ret && (mpierr = MPI_Allgather(MPI_IN_PLACE, 2 * ndims, MPI_OFFSET, boxes,
+                                            2 * ndims, MPI_OFFSET, ios->io_comm)))
+            ret = check_mpi(ios, NULL, mpierr, __FILE__, __LINE__);
+    }
+    if ((mpierr = MPI_Allreduce(MPI_IN_PLACE, &ret, 1, MPI_INT, MPI_MIN, ios->my_comm)))
+        ret = check_mpi(ios, NULL, mpierr, __FILE__, __LINE__);
+    if (!ret && (mpierr = MPI_Bcast(boxes, nio * 2 * ndims, MPI_OFFSET, ios->ioroot,
+                                    ios->my_comm)))
+        ret = check_mpi(ios, NULL, mpierr, __FILE__, __LINE__);
+    if (ret)
+    {
+        free(boxes);
+        free(recvs);
+        return pio_err(ios, NULL, ret, __FILE__, __LINE__,
+                        "Choosing the rearranger of the decomposition failed. Computing the boxes of the IO tasks failed");
+    }
+
+    for (int i = 0; i < nio; i++)
+    {
+        PIO_Offset size = 1;
+
+        for (int d = 0; d < ndims; d++)
+            size *= boxes[i * 2 * ndims + ndims + d];
+        box_mem = max(box_mem, size);
+    }
+
+    /* Find the IO tasks this task would send data to with the box
+     * rearranger, and count the contiguous runs in the map. The
+     * ranges of the map are walked one row of the fastest varying
+     * dimension at a time. The box of the previous row is checked
+     * first, since maps are mostly ordered, and the boxes are checked
+     * until the whole row is covered. */
+    for (int r = 0; r < nranges; r++)
+    {
+        int last = ndims - 1;
+
+        if (rstart[r] <= 0 || !rcount[r])
+            continue;
+
+        stats[1] += rcount[r];
+        if (rstart[r] != prev + 1)
+            stats[2]++;
+        prev = rstart[r] + rcount[r] - 1;
+
+        for (PIO_Offset k = 0; k < rcount[r]; )
         {
-            return pio_err(ios, file, PIO_ENOMEM, __FILE__, __LINE__,
-                            "Performance tuning of the rearranger failed for I/O decomposition (ioid=%d) on iosystem (iosysid=%d). Out of memory allocating %lld bytes for buffer on I/O processes", iodesc->ioid, ios->iosysid, (unsigned long long) (iodesc->llen * tsize));
+            PIO_Offset len;
+            PIO_Offset covered = 0;
+
+            idx_to_dim_list(ndims, gdimlen, rstart[r] - 1 + k, coord);
+            len = min((PIO_Offset)rcount[r] - k, gdimlen[last] - coord[last]);
+            for (int i = 0; i < nio && covered < len; i++)
+            {
+                PIO_Offset *b = boxes + ((box + i) % nio) * 2 * ndims;
+                PIO_Offset lo = max(coord[last], b[last]);
+                PIO_Offset hi = min(coord[last] + len, b[last] + b[ndims + last]);
+                int in_box = lo < hi;
+
+                for (int d = 0; d < last && in_box; d++)
+                    if (coord[d] < b[d] || coord[d] >= b[d] + b[ndims + d])
+                        in_box = 0;
+                if (in_box)
+                {
+                    recvs[(box + i) % nio] = 1;
+                    covered += hi - lo;
+                    if (covered == len)
+                    {
+                        box = (box + i) % nio;
+                        break;
+                    }
+                }
+            }
+            k += len;
         }
+    }
+    for (int i = 0; i < nio; i++)
+        stats[0] += recvs[i];
+    free(boxes);
 
-    if (iodesc->rearranger == PIO_REARR_BOX)
-        mycomm = ios->union_comm;
+    /* Reduce the estimates over all tasks. */
+    if ((mpierr = MPI_Allreduce(MPI_IN_PLACE, recvs, nio, MPI_INT, MPI_SUM, ios->my_comm)))
+    {
+        free(recvs);
+        return check_mpi(ios, NULL, mpierr, __FILE__, __LINE__);
+    }
+    {
+        long long maxstats[2] = {stats[0], stats[1]};
+
+        if ((mpierr = MPI_Allreduce(MPI_IN_PLACE, maxstats, 2, MPI_LONG_LONG, MPI_MAX,
+                                    ios->my_comm)))
+        {
+            free(recvs);
+            return check_mpi(ios, NULL, mpierr, __FILE__, __LINE__);
+        }
+        if ((mpierr = MPI_Allreduce(MPI_IN_PLACE, &stats[2], 1, MPI_LONG_LONG, MPI_SUM,
+                                    ios->my_comm)))
+        {
+            free(recvs);
+            return check_mpi(ios, NULL, mpierr, __FILE__, __LINE__);
+        }
+        stats[0] = maxstats[0];
+        stats[1] = maxstats[1];
+    }
+
+    for (int i = 0; i < nio; i++)
+        maxrecvs = max(maxrecvs, recvs[i]);
+    box_cost = stats[0] + maxrecvs + 1;
+    free(recvs);
+
+    tasks_per_io = (ios->num_comptasks + nio - 1) / nio;
+    subset_regions = (stats[2] + nio - 1) / nio;
+    subset_mem = stats[1] * tasks_per_io;
+    subset_cost = 1 + tasks_per_io + subset_regions;
+
+    if (subset_mem > 0 && box_mem > PIO_REARR_AUTO_MEM_RATIO * subset_mem)
+        *rearrp = PIO_REARR_SUBSET;
     else
-        mycomm = iodesc->subset_comm;
+        *rearrp = (subset_cost < box_cost) ? PIO_REARR_SUBSET : PIO_REARR_BOX;
 
-    if ((mpierr = MPI_Comm_size(mycomm, &nprocs)))
-        return check_mpi(NULL, NULL, mpierr, __FILE__, __LINE__);
-    if ((mpierr = MPI_Comm_rank(mycomm, &myrank)))
-        return check_mpi(NULL, NULL, mpierr, __FILE__, __LINE__);
+    LOG((1, "choose_rearranger rearranger = %d box cost = %d (max fan-out = %lld) "
+         "box IO buffer = %lld subset cost = %d (regions = %lld) subset IO buffer = %lld",
+         *rearrp, box_cost, stats[0], (long long)box_mem, subset_cost,
+         (long long)subset_regions, (long long)subset_mem));
+
+    return PIO_NOERR;
+}
+
+/**
+ * Time the data exchanges of a rearranger with a set of flow control
+ * options. The fastest of PIO_REARR_TUNE_NTRIALS exchanges, in the
+ * direction of the options, is timed on each task, and the maximum
+ * over all tasks is returned on all tasks. An error in an exchange on
+ * any task is returned on all tasks.
+ *
+ * @param ios pointer to the iosystem description struct.
+ * @param iodesc pointer to the IO description struct.
+ * @param fc pointer to the flow control options in iodesc to time.
+ * @param opts the flow control options.
+ * @param cbuf buffer on the compute tasks.
+ * @param ibuf buffer on the IO tasks.
+ * @param timep pointer that gets the time in seconds.
+ * @returns 0 on success, error code otherwise.
+ */
+static int time_rearranger(iosystem_desc_t *ios, io_desc_t *iodesc,
+                           rearr_comm_fc_opt_t *fc, rearr_comm_fc_opt_t opts,
+                           void *cbuf, void *ibuf, double *timep)
+{
+    double mintime = -1;
+    int mpierr; /* Return code for MPI calls. */
+    int ret;
 
-    int log2 = log(nprocs) / log(2) + 1;
-    if (!(wall = bget(2 * 4 * log2 * sizeof(double))))
+    *fc = opts;
+    for (int t = 0; t < PIO_REARR_TUNE_NTRIALS; t++)
     {
-        return pio_err(ios, file, PIO_ENOMEM, __FILE__, __LINE__,
-                        "Performance tuning of the rearranger failed for I/O decomposition (ioid=%d) on iosystem (iosysid=%d). Out of memory allocating %lld bytes for timers", iodesc->ioid, ios->iosysid, (unsigned long long) (i2 * 4 * log2 * sizeof(double)));
+        double start, time;
+
+        if ((mpierr = MPI_Barrier(ios->union_comm)))
+            return check_mpi(ios, NULL, mpierr, __FILE__, __LINE__);
+        start = MPI_Wtime();
+        if (fc == &iodesc->rearr_opts.comp2io)
+            ret = rearrange_comp2io(ios, iodesc, cbuf, ibuf, 1);
+        else
+            ret = rearrange_io2comp(ios, iodesc, ibuf, cbuf);
+        time = MPI_Wtime() - start;
+
+        /* Stop timing on all tasks if the exchange failed on any. */
+        if ((mpierr = MPI_Allreduce(MPI_IN_PLACE, &ret, 1, MPI_INT, MPI_MIN, ios->union_comm)))
+            return check_mpi(ios, NULL, mpierr, __FILE__, __LINE__);
+        if (ret)
+            return ret;
+        if (mintime < 0 || time < mintime)
+            mintime = time;
     }
-    double mintime;
-    int k = 0;
 
-    if ((mpierr = MPI_Barrier(mycomm)))
-        return check_mpi(NULL, NULL, mpierr, __FILE__, __LINE__);
-    GPTLstamp(&wall[0], &usr[0], &sys[0]);
-    rearrange_comp2io(ios, iodesc, cbuf, ibuf, 1);
-    rearrange_io2comp(ios, iodesc, ibuf, cbuf);
-    GPTLstamp(&wall[1], &usr[1], &sys[1]);
-    mintime = wall[1]-wall[0];
-    if ((mpierr = MPI_Allreduce(MPI_IN_PLACE, &mintime, 1, MPI_DOUBLE, MPI_MAX, mycomm)))
-        return check_mpi(NULL, NULL, mpierr, __FILE__, __LINE__);
+    if ((mpierr = MPI_Allreduce(&mintime, timep, 1, MPI_DOUBLE, MPI_MAX, ios->union_comm)))
+        return check_mpi(ios, NULL, mpierr, __FILE__, __LINE__);
 
-    handshake = iodesc->rearr_opts.comp2io.hs;
-    isend = iodesc->isend;
-    maxreqs = iodesc->max_requests;
+    return PIO_NOERR;
+}
 
-    for (int i = 0; i < 2; i++)
+/**
+ * Tune the rearranger options of a decomposition (see
+ * PIOc_set_rearr_autotune()). The data exchanges between the compute
+ * and IO tasks are timed with MPI_Alltoallw (PIO_REARR_COMM_COLL),
+ * and with point-to-point messages (PIO_REARR_COMM_P2P) with and
+ * without handshakes and isends, and with unlimited or limited
+ * pending requests in each direction. The fastest options are
+ * cached in iodesc->rearr_opts and logged, so they can be set with
+ * PIOc_set_rearr_opts() in later runs. The options of the IO system
+ * are kept unless other options are at least 5% faster.
+ *
+ * @param ios pointer to the iosystem description struct.
+ * @param iodesc pointer to the IO description struct.
+ * @returns 0 on success, error code otherwise.
+ */
+int performance_tune_rearranger(iosystem_desc_t *ios, io_desc_t *iodesc)
+{
+    const rearr_comm_fc_opt_t coll_opts = {false, false, 0};
+    const int pend_reqs[2] = {PIO_REARR_COMM_UNLIMITED_PEND_REQ, PIO_REARR_TUNE_MAX_PEND_REQ};
+    rearr_comm_fc_opt_t best[2];
+    double best_time[2];
+    double coll_time[2];
+    double user_time = 0;
+    rearr_opt_t user_opts;
+    void *cbuf = NULL, *ibuf = NULL;
+    int mpierr; /* Return code for MPI calls. */
+    int ret = PIO_NOERR;
+
+    pioassert(ios && iodesc, "invalid input", __FILE__, __LINE__);
+
+    if (!ios->rearr_autotune || ios->async)
+        return PIO_NOERR;
+
+#ifdef TIMING
+    GPTLstart("PIO:performance_tune_rearranger");
+#endif
+
+    if (iodesc->ndof > 0 && !(cbuf = calloc(iodesc->ndof, iodesc->mpitype_size)))
+        ret = pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
+                      "Performance tuning of the rearranger failed for I/O decomposition (ioid=%d) on iosystem (iosysid=%d). Out of memory allocating %lld bytes for buffer on compute processes", iodesc->ioid, ios->iosysid, (unsigned long long) (iodesc->ndof * iodesc->mpitype_size));
+    else if (iodesc->llen > 0 && !(ibuf = calloc(iodesc->llen, iodesc->mpitype_size)))
+        ret = pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
+                      "Performance tuning of the rearranger failed for I/O decomposition (ioid=%d) on iosystem (iosysid=%d). Out of memory allocating %lld bytes for buffer on I/O processes", iodesc->ioid, ios->iosysid, (unsigned long long) (iodesc->llen * iodesc->mpitype_size));
+
+    /* All the tasks take part in the timed exchanges. */
+    if ((mpierr = MPI_Allreduce(MPI_IN_PLACE, &ret, 1, MPI_INT, MPI_MIN, ios->union_comm)))
+        ret = check_mpi(ios, NULL, mpierr, __FILE__, __LINE__);
+    if (ret)
     {
-        if (i == 0)
-            iodesc->rearr_opts.comp2io.hs = false;
-        else
-            iodesc->rearr_opts.comp2io.hs = true;
+        free(cbuf);
+        free(ibuf);
+#ifdef TIMING
+        GPTLstop("PIO:performance_tune_rearranger");
+#endif
+        return ret;
+    }
 
-        for (int j = 0; j < 2; j++)
-        {
-            if (j == 0)
-                iodesc->isend = false;
-            else
-                iodesc->isend = true;
+    user_opts = iodesc->rearr_opts;
 
-            iodesc->max_requests = 0;
+    /* Time the options of the IO system, MPI_Alltoallw and the
+     * point-to-point options in each direction. */
+    for (int dir = 0; dir < 2 && !ret; dir++)
+    {
+        rearr_comm_fc_opt_t *fc = dir ? &iodesc->rearr_opts.io2comp : &iodesc->rearr_opts.comp2io;
+        rearr_comm_fc_opt_t opts = *fc;
+        double time;
 
-            for (nreqs = nprocs; nreqs >= 2; nreqs /= 2)
-            {
-                iodesc->max_requests = nreqs;
-                if ((mpierr = MPI_Barrier(mycomm)))
-                    return check_mpi(NULL, NULL, mpierr, __FILE__, __LINE__);
-                GPTLstamp(wall, usr, sys);
-                rearrange_comp2io(ios, iodesc, cbuf, ibuf, 1);
-                rearrange_io2comp(ios, iodesc, ibuf, cbuf);
-                GPTLstamp(wall+1, usr, sys);
-                wall[1] -= wall[0];
-                if ((mpierr = MPI_Allreduce(MPI_IN_PLACE, wall + 1, 1, MPI_DOUBLE, MPI_MAX,
-                                            mycomm)))
-                    return check_mpi(NULL, NULL, mpierr, __FILE__, __LINE__);
+        if ((ret = time_rearranger(ios, iodesc, fc, opts, cbuf, ibuf, &time)))
+            break;
+        user_time += time;
 
-                if (wall[1] < mintime * 0.95)
-                {
-                    handshake = iodesc->rearr_opts.comp2io.hs;
-                    isend = iodesc->isend;
-                    maxreqs = nreqs;
-                    mintime = wall[1];
-                }
-                else if (wall[1] > mintime * 1.05)
+        if ((ret = time_rearranger(ios, iodesc, fc, coll_opts, cbuf, ibuf, &coll_time[dir])))
+            break;
+
+        best_time[dir] = -1;
+        for (int p = 0; p < 2 && !ret; p++)
+            for (int hs = 0; hs < 2 && !ret; hs++)
+                for (int isend = 0; isend < 2 && !ret; isend++)
                 {
-                    exit;
+                    opts.hs = hs;
+                    opts.isend = isend;
+                    opts.max_pend_req = pend_reqs[p];
+                    if ((ret = time_rearranger(ios, iodesc, fc, opts, cbuf, ibuf, &time)))
+                        break;
+                    LOG((2, "performance_tune_rearranger ioid = %d dir = %d hs = %d isend = %d "
+                         "max_pend_req = %d time = %f", iodesc->ioid, dir, hs, isend,
+                         pend_reqs[p], time));
+                    if (best_time[dir] < 0 || time < best_time[dir])
+                    {
+                        best[dir] = opts;
+                        best_time[dir] = time;
+                    }
                 }
-            }
-        }
     }
 
-    iodesc->rearr_opts.comp2io.hs = handshake;
-    iodesc->isend = isend;
-    iodesc->max_requests = maxreqs;
+    free(cbuf);
+    free(ibuf);
+    iodesc->rearr_opts = user_opts;
+    if (ret)
+    {
+#ifdef TIMING
+        GPTLstop("PIO:performance_tune_rearranger");
+#endif
+        return pio_err(ios, NULL, ret, __FILE__, __LINE__,
+                        "Performance tuning of the rearranger failed for I/O decomposition (ioid=%d) on iosystem (iosysid=%d). Exchanging data between compute and I/O processes failed", iodesc->ioid, ios->iosysid);
+    }
+
+    /* Pick the fastest options. The times are the same on all tasks,
+     * so all tasks pick the same options. */
+    if (coll_time[0] + coll_time[1] <= best_time[0] + best_time[1])
+    {
+        if (coll_time[0] + coll_time[1] < 0.95 * user_time)
+        {
+            iodesc->rearr_opts.comm_type = PIO_REARR_COMM_COLL;
+            iodesc->rearr_opts.fcd = PIO_REARR_COMM_FC_2D_DISABLE;
+            iodesc->rearr_opts.comp2io = coll_opts;
+            iodesc->rearr_opts.io2comp = coll_opts;
+        }
+    }
+    else if (best_time[0] + best_time[1] < 0.95 * user_time)
+    {
+        iodesc->rearr_opts.comm_type = PIO_REARR_COMM_P2P;
+        iodesc->rearr_opts.fcd = PIO_REARR_COMM_FC_2D_ENABLE;
+        iodesc->rearr_opts.comp2io = best[0];
+        iodesc->rearr_opts.io2comp = best[1];
+    }
 
-    LOG((1, "spmd optimization: maxreqs: %d handshake:%d isend:%d mintime=%f\n",
-         maxreqs,handshake,isend,mintime));
+    LOG((1, "performance_tune_rearranger ioid = %d comm_type = %d fcd = %d "
+         "comp2io hs = %d isend = %d max_pend_req = %d "
+         "io2comp hs = %d isend = %d max_pend_req = %d "
+         "time = %f (coll = %f, p2p = %f, iosystem options = %f)",
+         iodesc->ioid, iodesc->rearr_opts.comm_type, iodesc->rearr_opts.fcd,
+         iodesc->rearr_opts.comp2io.hs, iodesc->rearr_opts.comp2io.isend,
+         iodesc->rearr_opts.comp2io.max_pend_req, iodesc->rearr_opts.io2comp.hs,
+         iodesc->rearr_opts.io2comp.isend, iodesc->rearr_opts.io2comp.max_pend_req,
+         min(min(coll_time[0] + coll_time[1], best_time[0] + best_time[1]), user_time),
+         coll_time[0] + coll_time[1], best_time[0] + best_time[1], user_time));
 
-    /* Free memory. */
-    brel(wall);
-    brel(cbuf);
-    brel(ibuf);
-#endif
+#ifdef TIMING
+    GPTLstop("PIO:performance_tune_rearranger");
 #endif
+    return PIO_NOERR;
 }
@@ -514,3 +514,29 @@ int pio_fc_gatherv(const void *sendbuf, int sendcnt, MPI_Datatype sendtype,
 
     return PIO_NOERR;
 }
+
+/**
+ * Like MPI_Bcast() of nbytes bytes, but the data is broadcast in
+ * chunks of at most PIO_BCAST_MAX_CHUNK_SIZE bytes, so that buffers
+ * larger than INT_MAX bytes can be broadcast.
+ *
+ * @param buf starting address of the buffer.
+ * @param nbytes number of bytes in the buffer.
+ * @param root rank of the broadcast root.
+ * @param comm communicator.
+ * @returns MPI_SUCCESS for success, MPI error code otherwise.
+ */
+int pio_bcast_large(void *buf, PIO_Offset nbytes, int root, MPI_Comm comm)
+{
+    int mpierr = MPI_SUCCESS;
+
+    for (PIO_Offset off = 0; off < nbytes; off += PIO_BCAST_MAX_CHUNK_SIZE)
+    {
+        int chunk_sz = (int)((nbytes - off < PIO_BCAST_MAX_CHUNK_SIZE) ? (nbytes - off) : PIO_BCAST_MAX_CHUNK_SIZE);
+
+        if ((mpierr = MPI_Bcast((char *)buf + off, chunk_sz, MPI_BYTE, root, comm)))
+            return mpierr;
+    }
+
+    return mpierr;
+}
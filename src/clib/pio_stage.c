@@ -0,0 +1,558 @@
+/**
+ * @file
+ * Staging of data written to files in node-local storage.
+ *
+ * Parallel file systems handle bursts of writes from many tasks (for
+ * example when all the components of a model write restart files)
+ * poorly, while the node-local storage (NVMe, tmpfs) on the compute
+ * nodes is fast. When a staging directory is set for an IO system
+ * (PIOc_set_staging_dir()) the IO tasks append the rearranged data
+ * written to PnetCDF files (the data in each I/O region, along with
+ * the start/count of the region) to a log file in the staging
+ * directory instead of writing it to the file.
+ *
+ * The logs are later drained (replayed into the files),
+ * - PIOc_closefile() only makes the log of the file durable, the IO
+ *   tasks keep the file open until the log is drained.
+ * - The logs of closed files are drained by the next PIOc_sync(),
+ *   PIOc_closefile() or PIOc_openfile() on the IO system, and by
+ *   PIOc_wait_staged() and PIOc_finalize().
+ * - The log of an open file is drained before reading data from it.
+ *
+ * The logs are drained during these collective calls, rather than in
+ * a helper thread, since the underlying I/O libraries are not thread
+ * safe.
+ *
+ * Each record in a log contains the variable id, the PIO type of the
+ * data, the number of dimensions and the size of the data in bytes
+ * followed by the start and count arrays of the region and the data.
+ * The header, start and count are stored as PIO_Offset values.
+ */
+#include <pio_config.h>
+#include <pio.h>
+#include <pio_internal.h>
+
+/** Number of PIO_Offset values in the header of a log record. */
+#define PIO_STAGE_REC_HDR_LEN 4
+
+/** Maximum number of bytes written to/read from a log in one call. */
+#define PIO_STAGE_MAX_IO_SIZE ((PIO_Offset)1 << 30)
+
+/**
+ * Write to a staging log.
+ *
+ * @param fh the MPI file handle of the log.
+ * @param off the offset, in bytes, to write to.
+ * @param buf pointer to the data to write.
+ * @param nbytes the number of bytes to write.
+ * @returns 0 for success, error code otherwise.
+ */
+static int stage_write_at(MPI_File fh, PIO_Offset off, const void *buf, PIO_Offset nbytes)
+{
+    int mpierr = MPI_SUCCESS;
+
+    for (PIO_Offset i = 0; i < nbytes; i += PIO_STAGE_MAX_IO_SIZE)
+    {
+        int sz = (int)((nbytes - i < PIO_STAGE_MAX_IO_SIZE) ? (nbytes - i) : PIO_STAGE_MAX_IO_SIZE);
+
+        if ((mpierr = MPI_File_write_at(fh, (MPI_Offset)(off + i), (void *)((const char *)buf + i),
+                                        sz, MPI_BYTE, MPI_STATUS_IGNORE)))
+            return check_mpi(NULL, NULL, mpierr, __FILE__, __LINE__);
+    }
+
+    return PIO_NOERR;
+}
+
+/**
+ * Read from a staging log.
+ *
+ * @param fh the MPI file handle of the log.
+ * @param off the offset, in bytes, to read from.
+ * @param buf pointer to the buffer that gets the data.
+ * @param nbytes the number of bytes to read.
+ * @returns 0 for success, error code otherwise.
+ */
+static int stage_read_at(MPI_File fh, PIO_Offset off, void *buf, PIO_Offset nbytes)
+{
+    int mpierr = MPI_SUCCESS;
+
+    for (PIO_Offset i = 0; i < nbytes; i += PIO_STAGE_MAX_IO_SIZE)
+    {
+        int sz = (int)((nbytes - i < PIO_STAGE_MAX_IO_SIZE) ? (nbytes - i) : PIO_STAGE_MAX_IO_SIZE);
+
+        if ((mpierr = MPI_File_read_at(fh, (MPI_Offset)(off + i), (char *)buf + i,
+                                       sz, MPI_BYTE, MPI_STATUS_IGNORE)))
+            return check_mpi(NULL, NULL, mpierr, __FILE__, __LINE__);
+    }
+
+    return PIO_NOERR;
+}
+
+/**
+ * Replay the records in a staging log into the file, and empty the
+ * log. The records are written using independent I/O, so that the IO
+ * tasks can replay different numbers of records.
+ *
+ * This function is collective on the IO tasks.
+ *
+ * @param ios pointer to the IO system.
+ * @param slog pointer to the staging log.
+ * @returns 0 for success, error code otherwise.
+ */
+static int stage_replay(iosystem_desc_t *ios, pio_stage_log_t *slog)
+{
+    int ierr = PIO_NOERR;
+
+#ifdef _PNETCDF
+    PIO_Offset off = 0;
+    int ret;
+
+    LOG((2, "stage_replay log = %s size = %lld", slog->path, (long long)slog->size));
+
+    if ((ret = ncmpi_begin_indep_data(slog->ncfh)))
+        return pio_err(ios, NULL, ret, __FILE__, __LINE__,
+                        "Draining staged data failed. Starting independent (across processes) access failed on the file");
+
+    while (off < slog->size)
+    {
+        PIO_Offset hdr[PIO_STAGE_REC_HDR_LEN];
+        MPI_Datatype mpitype;
+        int type_size;
+        void *buf;
+
+        if ((ierr = stage_read_at(slog->fh, off, hdr, sizeof(hdr))))
+            break;
+        off += sizeof(hdr);
+
+        PIO_Offset ndims = hdr[2];
+        PIO_Offset nbytes = hdr[3];
+        PIO_Offset dims[2 * ndims]; /* start and count of the region */
+
+        if ((ierr = stage_read_at(slog->fh, off, dims, sizeof(dims))))
+            break;
+        off += sizeof(dims);
+
+        if ((ierr = find_mpi_type((int)hdr[1], &mpitype, &type_size)))
+            break;
+
+        if (!(buf = malloc(nbytes)))
+        {
+            ierr = pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
+                            "Draining staged data from log %s failed. Out of memory allocating %lld bytes for the data in a log record", slog->path, (long long)nbytes);
+            break;
+        }
+        if ((ierr = stage_read_at(slog->fh, off, buf, nbytes)))
+        {
+            free(buf);
+            break;
+        }
+        off += nbytes;
+
+        ierr = ncmpi_put_vara(slog->ncfh, (int)hdr[0], dims, dims + ndims, buf,
+                              nbytes / type_size, mpitype);
+        free(buf);
+        if (ierr != PIO_NOERR)
+        {
+            ierr = pio_err(ios, NULL, ierr, __FILE__, __LINE__,
+                            "Draining staged data from log %s failed. Writing data for variable (varid=%d) failed", slog->path, (int)hdr[0]);
+            break;
+        }
+    }
+
+    /* Leaving independent mode is collective, so is done even if
+     * replaying the log failed on this task. */
+    if ((ret = ncmpi_end_indep_data(slog->ncfh)) && (ierr == PIO_NOERR))
+        ierr = pio_err(ios, NULL, ret, __FILE__, __LINE__,
+                        "Draining staged data failed. Ending independent (across processes) access failed on the file");
+
+    if ((ierr == PIO_NOERR) && (slog->fh != MPI_FILE_NULL))
+    {
+        int mpierr;
+
+        if ((mpierr = MPI_File_set_size(slog->fh, 0)))
+            return check_mpi(NULL, NULL, mpierr, __FILE__, __LINE__);
+        slog->size = 0;
+    }
+#endif /* _PNETCDF */
+
+    return ierr;
+}
+
+/**
+ * Set the node-local directory used to stage data written to files
+ * created later in an IO system.
+ *
+ * The data written (using PIOc_write_darray() or
+ * PIOc_write_darray_multi()) to PnetCDF files created with staging
+ * enabled is written by the IO tasks to log files in the staging
+ * directory. The logs are replayed into the files later, by
+ * PIOc_sync(), PIOc_closefile(), PIOc_openfile(), PIOc_wait_staged()
+ * or PIOc_finalize() calls on the IO system. Closing a staged file
+ * returns once the staged data is durable in the node-local storage,
+ * use PIOc_wait_staged() to wait until the data is in the file.
+ *
+ * Data written using the other functions (e.g. PIOc_put_vara()) is
+ * written directly to the file, so it should not overlap with the
+ * staged data. Only files with PIO_IOTYPE_PNETCDF are staged, and
+ * staging is not supported with asynchronous I/O.
+ *
+ * This function is collective on the IO system.
+ *
+ * @param iosysid the IO system ID.
+ * @param dir the path of the staging directory, must be a directory
+ * on storage local to the compute node (or at least local to each
+ * IO task). NULL or an empty string disables staging.
+ * @returns 0 for success, error code otherwise.
+ * @ingroup PIO_createfile
+ */
+int PIOc_set_staging_dir(int iosysid, const char *dir)
+{
+    iosystem_desc_t *ios;
+
+    if (!(ios = pio_get_iosystem_from_id(iosysid)))
+    {
+        return pio_err(NULL, NULL, PIO_EBADID, __FILE__, __LINE__,
+                        "Setting the staging directory failed. Invalid io system id (%d) provided", iosysid);
+    }
+
+    if (ios->async)
+    {
+        return pio_err(ios, NULL, PIO_EINVAL, __FILE__, __LINE__,
+                        "Setting the staging directory failed. Staging is not supported with asynchronous I/O");
+    }
+
+    /* Leave space in the log file names for the file name. */
+    if (dir && strlen(dir) > PIO_MAX_NAME / 2)
+    {
+        return pio_err(ios, NULL, PIO_EINVAL, __FILE__, __LINE__,
+                        "Setting the staging directory failed. The length of the path of the directory (%lld) is larger than the maximum (%d)", (long long)strlen(dir), PIO_MAX_NAME / 2);
+    }
+
+    LOG((1, "PIOc_set_staging_dir iosysid = %d dir = %s", iosysid, dir ? dir : "NULL"));
+
+    free(ios->stage_dir);
+    ios->stage_dir = NULL;
+    if (dir && strlen(dir) > 0)
+    {
+        if (!(ios->stage_dir = malloc(strlen(dir) + 1)))
+        {
+            return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
+                            "Setting the staging directory failed. Out of memory allocating %lld bytes for the path", (long long)(strlen(dir) + 1));
+        }
+        strcpy(ios->stage_dir, dir);
+    }
+
+    return PIO_NOERR;
+}
+
+/**
+ * Wait until the data staged for the closed files of an IO system is
+ * written to the files.
+ *
+ * This function is collective on the IO system.
+ *
+ * @param iosysid the IO system ID.
+ * @returns 0 for success, error code otherwise.
+ * @ingroup PIO_closefile
+ */
+int PIOc_wait_staged(int iosysid)
+{
+    iosystem_desc_t *ios;
+    int ierr = PIO_NOERR;
+
+    if (!(ios = pio_get_iosystem_from_id(iosysid)))
+    {
+        return pio_err(NULL, NULL, PIO_EBADID, __FILE__, __LINE__,
+                        "Waiting for staged data failed. Invalid io system id (%d) provided", iosysid);
+    }
+
+    LOG((1, "PIOc_wait_staged iosysid = %d", iosysid));
+
+    /* Nothing to wait for if no files were staged. */
+    if (ios->stage_nfiles == 0)
+        return PIO_NOERR;
+
+    if (ios->ioproc)
+        ierr = pio_stage_drain_pending(ios);
+
+    ierr = check_netcdf(ios, NULL, ierr, __FILE__, __LINE__);
+    if (ierr != PIO_NOERR)
+    {
+        return pio_err(ios, NULL, ierr, __FILE__, __LINE__,
+                        "Waiting for staged data failed on io system (iosysid=%d). Draining the staged data to the files failed", iosysid);
+    }
+
+    return PIO_NOERR;
+}
+
+/**
+ * Start staging the data written to a file. Called on the IO tasks
+ * after creating the file.
+ *
+ * @param file pointer to the file descriptor.
+ * @param filename the name of the file.
+ * @returns 0 for success, error code otherwise.
+ */
+int pio_stage_create(file_desc_t *file, const char *filename)
+{
+    iosystem_desc_t *ios;
+    pio_stage_log_t *slog;
+    const char *base;
+    int mpierr = MPI_SUCCESS;
+
+    pioassert(file && file->iosystem && file->iosystem->stage_dir && filename,
+              "invalid input", __FILE__, __LINE__);
+    ios = file->iosystem;
+
+    if (!(slog = calloc(1, sizeof(pio_stage_log_t))))
+    {
+        return pio_err(ios, file, PIO_ENOMEM, __FILE__, __LINE__,
+                        "Staging file (%s) failed. Out of memory allocating %lld bytes for the staging log", filename, (long long)sizeof(pio_stage_log_t));
+    }
+
+    /* The log is named after the file, the IO system, the number of
+     * files staged in the IO system and the IO task. */
+    base = strrchr(filename, '/');
+    base = base ? base + 1 : filename;
+    if (snprintf(slog->path, sizeof(slog->path), "%s/%s.%d.%d.%d.piostage", ios->stage_dir,
+                 base, ios->iosysid, ios->stage_nfiles, ios->io_rank) >= (int)sizeof(slog->path))
+    {
+        free(slog);
+        return pio_err(ios, file, PIO_EINVAL, __FILE__, __LINE__,
+                        "Staging file (%s) failed. The path of the staging log is too long", filename);
+    }
+    LOG((2, "pio_stage_create log = %s", slog->path));
+
+    if ((mpierr = MPI_File_open(MPI_COMM_SELF, slog->path, MPI_MODE_CREATE | MPI_MODE_RDWR,
+                                MPI_INFO_NULL, &slog->fh)))
+    {
+        free(slog);
+        return check_mpi(NULL, file, mpierr, __FILE__, __LINE__);
+    }
+
+    /* Discard any stale log with the same name. */
+    if ((mpierr = MPI_File_set_size(slog->fh, 0)))
+    {
+        MPI_File_close(&slog->fh);
+        free(slog);
+        return check_mpi(NULL, file, mpierr, __FILE__, __LINE__);
+    }
+
+    slog->size = 0;
+    slog->ncfh = file->fh;
+    file->stage = slog;
+
+    return PIO_NOERR;
+}
+
+/**
+ * Write the data in the I/O regions of an IO task to the staging log
+ * of a file. This is the staged version of write_darray_multi_par().
+ *
+ * @param file pointer to the file descriptor.
+ * @param nvars the number of variables to be written with this
+ * decomposition.
+ * @param fndims the number of dimensions of the variables in the file.
+ * @param varids an array of the variable ids to be written.
+ * @param iodesc pointer to the io_desc_t info.
+ * @param fill Non-zero if this write is fill data.
+ * @param frame the record dimension for each of the nvars variables
+ * in iobuf. NULL if this iodesc contains non-record vars.
+ * @returns 0 for success, error code otherwise.
+ */
+int pio_stage_write(file_desc_t *file, int nvars, int fndims, const int *varids,
+                    io_desc_t *iodesc, int fill, const int *frame)
+{
+    iosystem_desc_t *ios;
+    pio_stage_log_t *slog;
+    var_desc_t *vdesc;
+    size_t start[fndims];
+    size_t count[fndims];
+    PIO_Offset rec[PIO_STAGE_REC_HDR_LEN + 2 * fndims];
+    int ierr = PIO_NOERR;
+
+    pioassert(file && file->iosystem && file->stage && varids && iodesc,
+              "invalid input", __FILE__, __LINE__);
+    ios = file->iosystem;
+    slog = file->stage;
+    vdesc = file->varlist + varids[0];
+
+    /* Set these differently for data and fill writing. */
+    int num_regions = fill ? iodesc->maxfillregions: iodesc->maxregions;
+    io_region_table *regions = fill ? iodesc->fillregions : iodesc->regions;
+    PIO_Offset llen = fill ? iodesc->holegridsize : iodesc->llen;
+    void *iobuf = fill ? vdesc->fillbuf : file->iobuf[iodesc->ioid - PIO_IODESC_START_ID];
+
+    for (int regioncnt = 0; regions && regioncnt < num_regions && regioncnt < regions->nregions;
+         regioncnt++)
+    {
+        PIO_Offset nelems = 1;
+
+        if ((ierr = find_start_count(iodesc->ndims, iodesc->dimlen, fndims, vdesc, regions,
+                                     regioncnt, start, count)))
+        {
+            return pio_err(ios, file, ierr, __FILE__, __LINE__,
+                            "Staging data written to file (%s, ncid=%d) failed. Internal error, finding start/count for the I/O regions failed", pio_get_fname_from_file(file), file->pio_ncid);
+        }
+        for (int i = 0; i < fndims; i++)
+            nelems *= count[i];
+
+        for (int nv = 0; (nelems > 0) && (nv < nvars); nv++)
+        {
+            void *bufptr = (char *)iobuf + iodesc->mpitype_size * (nv * llen + regions->loffset[regioncnt]);
+
+            /* Set the start of the record dimension. */
+            if (vdesc->record >= 0 && fndims > 1)
+                start[0] = frame[nv];
+
+            rec[0] = varids[nv];
+            rec[1] = iodesc->piotype;
+            rec[2] = fndims;
+            rec[3] = nelems * iodesc->mpitype_size;
+            for (int i = 0; i < fndims; i++)
+            {
+                rec[PIO_STAGE_REC_HDR_LEN + i] = start[i];
+                rec[PIO_STAGE_REC_HDR_LEN + fndims + i] = count[i];
+            }
+
+            if ((ierr = stage_write_at(slog->fh, slog->size, rec, sizeof(rec))))
+                return pio_err(ios, file, ierr, __FILE__, __LINE__,
+                                "Staging data written to file (%s, ncid=%d) failed. Writing to the staging log %s failed", pio_get_fname_from_file(file), file->pio_ncid, slog->path);
+            slog->size += sizeof(rec);
+            if ((ierr = stage_write_at(slog->fh, slog->size, bufptr, rec[3])))
+                return pio_err(ios, file, ierr, __FILE__, __LINE__,
+                                "Staging data written to file (%s, ncid=%d) failed. Writing to the staging log %s failed", pio_get_fname_from_file(file), file->pio_ncid, slog->path);
+            slog->size += rec[3];
+        }
+    }
+
+    return PIO_NOERR;
+}
+
+/**
+ * Make the data in the staging log of a file durable. Called on the
+ * IO tasks.
+ *
+ * @param file pointer to the file descriptor.
+ * @returns 0 for success, error code otherwise.
+ */
+int pio_stage_sync(file_desc_t *file)
+{
+    int mpierr = MPI_SUCCESS;
+
+    pioassert(file, "invalid input", __FILE__, __LINE__);
+
+    if (file->stage && (file->stage->fh != MPI_FILE_NULL))
+        if ((mpierr = MPI_File_sync(file->stage->fh)))
+            return check_mpi(NULL, file, mpierr, __FILE__, __LINE__);
+
+    return PIO_NOERR;
+}
+
+/**
+ * Drain the staging log of an open file into the file. Called on the
+ * IO tasks, collective on the IO tasks.
+ *
+ * @param file pointer to the file descriptor.
+ * @returns 0 for success, error code otherwise.
+ */
+int pio_stage_drain_file(file_desc_t *file)
+{
+    pioassert(file && file->iosystem, "invalid input", __FILE__, __LINE__);
+
+    if (!file->stage)
+        return PIO_NOERR;
+
+    return stage_replay(file->iosystem, file->stage);
+}
+
+/**
+ * Close the staging log of a file. The log is made durable and queued
+ * to be drained later, the file is kept open until then. Called on
+ * the IO tasks when closing the file.
+ *
+ * @param file pointer to the file descriptor.
+ * @returns 0 for success, error code otherwise.
+ */
+int pio_stage_close(file_desc_t *file)
+{
+    iosystem_desc_t *ios;
+    pio_stage_log_t *slog;
+    pio_stage_log_t **lastp;
+    int mpierr = MPI_SUCCESS;
+    int ierr = PIO_NOERR;
+
+    pioassert(file && file->iosystem && file->stage, "invalid input", __FILE__, __LINE__);
+    ios = file->iosystem;
+    slog = file->stage;
+
+    if ((mpierr = MPI_File_sync(slog->fh)))
+        ierr = check_mpi(NULL, file, mpierr, __FILE__, __LINE__);
+    if ((mpierr = MPI_File_close(&slog->fh)) && (ierr == PIO_NOERR))
+        ierr = check_mpi(NULL, file, mpierr, __FILE__, __LINE__);
+    slog->fh = MPI_FILE_NULL;
+
+    /* Queue the log (in the order the files are closed, so that all IO
+     * tasks drain the logs in the same order) */
+    slog->next = NULL;
+    for (lastp = &ios->stage_pending; *lastp; lastp = &(*lastp)->next)
+        ;
+    *lastp = slog;
+    file->stage = NULL;
+
+    LOG((2, "pio_stage_close queued log = %s size = %lld", slog->path, (long long)slog->size));
+
+    return ierr;
+}
+
+/**
+ * Drain the staging logs of closed files into the files, and close
+ * the files. Called on the IO tasks, collective on the IO tasks.
+ *
+ * @param ios pointer to the IO system.
+ * @returns 0 for success, error code otherwise.
+ */
+int pio_stage_drain_pending(iosystem_desc_t *ios)
+{
+    pio_stage_log_t *slog;
+    int mpierr = MPI_SUCCESS;
+    int ierr = PIO_NOERR;
+    int ret;
+
+    pioassert(ios, "invalid input", __FILE__, __LINE__);
+
+    /* All the IO tasks have the same list of logs, continue with the
+     * (collective) draining and closing of the files on errors. */
+    while ((slog = ios->stage_pending))
+    {
+        LOG((2, "pio_stage_drain_pending log = %s", slog->path));
+
+        if ((mpierr = MPI_File_open(MPI_COMM_SELF, slog->path,
+                                    MPI_MODE_RDWR | MPI_MODE_DELETE_ON_CLOSE,
+                                    MPI_INFO_NULL, &slog->fh)))
+        {
+            if (ierr == PIO_NOERR)
+                ierr = check_mpi(NULL, NULL, mpierr, __FILE__, __LINE__);
+            slog->fh = MPI_FILE_NULL;
+            slog->size = 0;
+        }
+
+        if ((ret = stage_replay(ios, slog)) && (ierr == PIO_NOERR))
+            ierr = ret;
+
+        if (slog->fh != MPI_FILE_NULL)
+            MPI_File_close(&slog->fh);
+
+#ifdef _PNETCDF
+        ncmpi_buffer_detach(slog->ncfh);
+        if ((ret = ncmpi_close(slog->ncfh)) && (ierr == PIO_NOERR))
+            ierr = pio_err(ios, NULL, ret, __FILE__, __LINE__,
+                            "Draining staged data failed. Closing the file failed after draining the staging log %s", slog->path);
+#endif
+
+        ios->stage_pending = slog->next;
+        free(slog);
+    }
+
+    return ierr;
+}
@@ -0,0 +1,1447 @@
+/**
+ * @file
+ * Subfiled datasets.
+ *
+ * When thousands of IO tasks write a single shared PnetCDF file, the
+ * file system locks and the conflicts between the tasks writing to
+ * the same stripes limit the write bandwidth. When subfiling is
+ * enabled for an IO system (PIOc_set_subfiling()) the IO tasks are
+ * split into groups of consecutive IO tasks and each group writes its
+ * own PnetCDF subfile, filename.NNNN. Each subfile has the metadata
+ * (dims, vars, atts) of the whole dataset, the data of the
+ * distributed arrays (PIOc_write_darray()) written to a subfile is
+ * the data in the I/O regions of the IO tasks in its group. The data
+ * written using the other functions (e.g. PIOc_put_vara()) is
+ * written to all the subfiles.
+ *
+ * A small index, filename.idx (a netCDF file), records the boxes
+ * (the start/count of the I/O regions, along the non-record
+ * dimensions) written to each subfile and the variables written with
+ * each set of boxes (one set per decomposition). The index is written
+ * by PIOc_sync() and PIOc_closefile().
+ *
+ * PIOc_openfile(), with PIO_IOTYPE_PNETCDF, opens a subfiled dataset
+ * (for reading) if filename does not exist and the index of the
+ * dataset does. The distributed arrays are read from the subfiles
+ * containing the requested boxes. PIOc_merge_subfiles() merges the
+ * subfiles into a single file.
+ *
+ * All the records of a variable should be written with the same
+ * decomposition, the index does not record the frames written with
+ * each set of boxes.
+ */
+#include <pio_config.h>
+#include <pio.h>
+#include <pio_internal.h>
+#include <unistd.h>
+
+/** Suffix of the name of the index of a subfiled dataset. */
+#define PIO_SUBFILE_INDEX_SUFFIX ".idx"
+
+/** Maximum length of the names of the subfiles and the index. */
+#define PIO_SUBFILE_MAX_NAME (PIO_MAX_NAME + 16)
+
+/**
+ * Set the number of subfiles that the PnetCDF files created in an IO
+ * system are written to. Each group of (num_iotasks / nsubfiles)
+ * consecutive IO tasks writes one subfile, filename.NNNN, with the
+ * data in the I/O regions of the tasks in the group. An index of the
+ * data in each subfile, filename.idx, is written when the file is
+ * synced or closed.
+ *
+ * Subfiled datasets are opened (read only) with PIOc_openfile() and
+ * PIO_IOTYPE_PNETCDF, or merged into a single file with
+ * PIOc_merge_subfiles(). Subfiled files are not staged (see
+ * PIOc_set_staging_dir()), and subfiling is not supported with
+ * asynchronous I/O.
+ *
+ * This function is collective on the IO system.
+ *
+ * @param iosysid the IO system ID.
+ * @param nsubfiles the number of subfiles, limited to the number of
+ * IO tasks. 0 or 1 writes a single file.
+ * @returns 0 for success, error code otherwise.
+ * @ingroup PIO_createfile
+ */
+int PIOc_set_subfiling(int iosysid, int nsubfiles)
+{
+    iosystem_desc_t *ios;
+
+    if (!(ios = pio_get_iosystem_from_id(iosysid)))
+    {
+        return pio_err(NULL, NULL, PIO_EBADID, __FILE__, __LINE__,
+                        "Setting the number of subfiles failed. Invalid io system id (%d) provided", iosysid);
+    }
+
+    if (ios->async)
+    {
+        return pio_err(ios, NULL, PIO_EINVAL, __FILE__, __LINE__,
+                        "Setting the number of subfiles failed. Subfiling is not supported with asynchronous I/O");
+    }
+
+    if (nsubfiles < 0)
+    {
+        return pio_err(ios, NULL, PIO_EINVAL, __FILE__, __LINE__,
+                        "Setting the number of subfiles failed. Invalid number of subfiles (%d) provided", nsubfiles);
+    }
+
+    LOG((1, "PIOc_set_subfiling iosysid = %d nsubfiles = %d", iosysid, nsubfiles));
+
+    ios->num_subfiles = nsubfiles;
+
+    return PIO_NOERR;
+}
+
+#ifdef _PNETCDF
+/**
+ * Get the name of a subfile of a dataset.
+ *
+ * @param filename the name of the dataset.
+ * @param subfile the index of the subfile.
+ * @param name array of at least PIO_SUBFILE_MAX_NAME + 1 chars that
+ * gets the name.
+ */
+static void subfile_name(const char *filename, int subfile, char *name)
+{
+    snprintf(name, PIO_SUBFILE_MAX_NAME + 1, "%s.%04d", filename, subfile);
+}
+
+/**
+ * Get the name of the index of a dataset.
+ *
+ * @param filename the name of the dataset.
+ * @param name array of at least PIO_SUBFILE_MAX_NAME + 1 chars that
+ * gets the name.
+ */
+static void subfile_index_name(const char *filename, char *name)
+{
+    snprintf(name, PIO_SUBFILE_MAX_NAME + 1, "%s%s", filename, PIO_SUBFILE_INDEX_SUFFIX);
+}
+
+/**
+ * Get the subfile written by an IO task.
+ *
+ * @param io_rank the rank of the task in the IO communicator.
+ * @param num_iotasks the number of IO tasks.
+ * @param nsubfiles the number of subfiles.
+ * @returns the index of the subfile.
+ */
+static int subfile_of_rank(int io_rank, int num_iotasks, int nsubfiles)
+{
+    return (int)(((long long)io_rank * nsubfiles) / num_iotasks);
+}
+
+/**
+ * Close the subfiles opened to read a dataset and free the info
+ * about the subfiles.
+ *
+ * @param sub pointer to the subfile info, may be NULL.
+ * @returns 0 for success, error code otherwise.
+ */
+static int subfile_free(pio_subfile_t *sub)
+{
+    int ierr = PIO_NOERR;
+
+    if (!sub)
+        return PIO_NOERR;
+
+    if (sub->fh)
+    {
+        for (int s = 0; s < sub->nsubfiles; s++)
+        {
+            if (sub->fh[s] >= 0)
+            {
+                int ret = ncmpi_close(sub->fh[s]);
+                if (ret != PIO_NOERR && ierr == PIO_NOERR)
+                    ierr = ret;
+            }
+        }
+        free(sub->fh);
+    }
+
+    for (int s = 0; s < sub->nsets; s++)
+    {
+        free(sub->sets[s].subfile);
+        free(sub->sets[s].start);
+        free(sub->sets[s].count);
+    }
+    free(sub->sets);
+    free(sub->var_id);
+    free(sub->var_set);
+    if (sub->comm != MPI_COMM_NULL)
+        MPI_Comm_free(&sub->comm);
+    free(sub);
+
+    return ierr;
+}
+
+/**
+ * Create the subfile written by this IO task. Called, instead of
+ * ncmpi_create(), on the IO tasks when creating a PnetCDF file in an
+ * IO system with subfiling enabled.
+ *
+ * @param file pointer to the file info, file->mode is the mode used
+ * to create the subfiles. file->fh gets the handle of the subfile.
+ * @param filename the name of the dataset.
+ * @returns 0 for success, error code otherwise.
+ */
+int pio_subfile_create(file_desc_t *file, const char *filename)
+{
+    iosystem_desc_t *ios = file->iosystem;
+    pio_subfile_t *sub;
+    char name[PIO_SUBFILE_MAX_NAME + 1];
+    int mpierr = MPI_SUCCESS;
+    int ierr = PIO_NOERR;
+
+    pioassert(ios->ioproc && ios->num_subfiles > 1, "invalid input", __FILE__, __LINE__);
+
+    if (!(sub = calloc(1, sizeof(pio_subfile_t))))
+        return PIO_ENOMEM;
+    sub->comm = MPI_COMM_NULL;
+    sub->nsubfiles = (ios->num_subfiles < ios->num_iotasks) ? ios->num_subfiles : ios->num_iotasks;
+    sub->subfile = subfile_of_rank(ios->io_rank, ios->num_iotasks, sub->nsubfiles);
+
+    LOG((2, "pio_subfile_create filename = %s nsubfiles = %d subfile = %d", filename,
+         sub->nsubfiles, sub->subfile));
+
+    /* The dataset replaces a single file with the same name. */
+    if (ios->io_rank == 0 && !access(filename, F_OK))
+    {
+        if (file->mode & NC_NOCLOBBER)
+            ierr = PIO_EEXIST;
+        else if (remove(filename))
+            ierr = PIO_EPERM;
+    }
+    if ((mpierr = MPI_Bcast(&ierr, 1, MPI_INT, 0, ios->io_comm)))
+    {
+        subfile_free(sub);
+        return check_mpi(NULL, NULL, mpierr, __FILE__, __LINE__);
+    }
+
+    if (ierr == PIO_NOERR)
+    {
+        if ((mpierr = MPI_Comm_split(ios->io_comm, sub->subfile, ios->io_rank, &sub->comm)))
+        {
+            subfile_free(sub);
+            return check_mpi(NULL, NULL, mpierr, __FILE__, __LINE__);
+        }
+        if ((mpierr = MPI_Comm_rank(sub->comm, &sub->rank)))
+        {
+            subfile_free(sub);
+            return check_mpi(NULL, NULL, mpierr, __FILE__, __LINE__);
+        }
+
+        subfile_name(filename, sub->subfile, name);
+        ierr = ncmpi_create(sub->comm, name, file->mode, ios->info, &file->fh);
+    }
+
+    if (ierr != PIO_NOERR)
+    {
+        subfile_free(sub);
+        return ierr;
+    }
+    file->subfile = sub;
+
+    return PIO_NOERR;
+}
+
+/**
+ * Record the boxes of the I/O regions written, by this IO task, to a
+ * subfiled file. Called on the IO tasks for each write of
+ * distributed arrays.
+ *
+ * @param file pointer to the file info.
+ * @param iodesc pointer to the decomposition info.
+ * @param nvars the number of variables written.
+ * @param varids the ids of the variables written.
+ * @param fill non-zero if the fill regions of the decomposition are
+ * written.
+ * @returns 0 for success, error code otherwise.
+ */
+int pio_subfile_add_regions(file_desc_t *file, io_desc_t *iodesc, int nvars,
+                            const int *varids, int fill)
+{
+    pio_subfile_t *sub = file->subfile;
+    int key = 2 * iodesc->ioid + (fill ? 1 : 0);
+    int set;
+
+    pioassert(sub && iodesc && varids, "invalid input", __FILE__, __LINE__);
+
+    for (set = 0; set < sub->nsets; set++)
+        if (sub->sets[set].key == key)
+            break;
+
+    /* Copy the boxes of the regions, on the first write with this
+     * decomposition. */
+    if (set == sub->nsets)
+    {
+        int num_regions = fill ? iodesc->maxfillregions : iodesc->maxregions;
+        io_region_table *regions = fill ? iodesc->fillregions : iodesc->regions;
+        pio_subfile_set_t *sets;
+        pio_subfile_set_t *s;
+
+        if (!(sets = realloc(sub->sets, (sub->nsets + 1) * sizeof(pio_subfile_set_t))))
+            return pio_err(NULL, file, PIO_ENOMEM, __FILE__, __LINE__,
+                            "Recording the I/O regions written to the subfile of file (%s, ncid=%d) failed. Out of memory reallocating the box sets", pio_get_fname_from_file(file), file->pio_ncid);
+        sub->sets = sets;
+        s = &sub->sets[set];
+        memset(s, 0, sizeof(pio_subfile_set_t));
+        s->key = key;
+        s->ndims = iodesc->ndims;
+
+        if (num_regions > 0 && s->ndims > 0)
+        {
+            if (!(s->subfile = malloc(num_regions * sizeof(int))) ||
+                !(s->start = malloc(num_regions * s->ndims * sizeof(PIO_Offset))) ||
+                !(s->count = malloc(num_regions * s->ndims * sizeof(PIO_Offset))))
+            {
+                free(s->subfile);
+                free(s->start);
+                return pio_err(NULL, file, PIO_ENOMEM, __FILE__, __LINE__,
+                                "Recording the I/O regions written to the subfile of file (%s, ncid=%d) failed. Out of memory allocating the boxes of %d regions", pio_get_fname_from_file(file), file->pio_ncid, num_regions);
+            }
+        }
+
+        for (int r = 0; regions && r < num_regions && r < regions->nregions && s->ndims > 0; r++)
+        {
+            PIO_Offset nelems = 1;
+
+            for (int d = 0; d < s->ndims; d++)
+                nelems *= REGION_COUNT(regions, r)[d];
+            if (nelems == 0)
+                continue;
+
+            s->subfile[s->nboxes] = sub->subfile;
+            memcpy(s->start + s->nboxes * s->ndims, REGION_START(regions, r), s->ndims * sizeof(PIO_Offset));
+            memcpy(s->count + s->nboxes * s->ndims, REGION_COUNT(regions, r), s->ndims * sizeof(PIO_Offset));
+            s->nboxes++;
+        }
+        sub->nsets++;
+        LOG((3, "pio_subfile_add_regions new set %d key = %d nboxes = %d", set, key, s->nboxes));
+    }
+
+    /* Record the variables written with the set. */
+    for (int nv = 0; nv < nvars; nv++)
+    {
+        int p;
+
+        for (p = sub->nvarsets - 1; p >= 0; p--)
+            if (sub->var_id[p] == varids[nv] && sub->var_set[p] == set)
+                break;
+        if (p >= 0)
+            continue;
+
+        if (!(sub->var_id = realloc(sub->var_id, (sub->nvarsets + 1) * sizeof(int))) ||
+            !(sub->var_set = realloc(sub->var_set, (sub->nvarsets + 1) * sizeof(int))))
+            return pio_err(NULL, file, PIO_ENOMEM, __FILE__, __LINE__,
+                            "Recording the I/O regions written to the subfile of file (%s, ncid=%d) failed. Out of memory reallocating the variable list", pio_get_fname_from_file(file), file->pio_ncid);
+        sub->var_id[sub->nvarsets] = varids[nv];
+        sub->var_set[sub->nvarsets] = set;
+        sub->nvarsets++;
+    }
+
+    return PIO_NOERR;
+}
+
+/**
+ * Write the index of a subfiled dataset. Called on IO task 0 only.
+ *
+ * @param filename the name of the dataset.
+ * @param sub pointer to the subfile info, with the variables written.
+ * @param sets the box sets, with the boxes written by all the IO
+ * tasks.
+ * @returns 0 for success, error code otherwise.
+ */
+static int subfile_write_index_file(const char *filename, const pio_subfile_t *sub,
+                                    const pio_subfile_set_t *sets)
+{
+    char name[PIO_SUBFILE_MAX_NAME + 1];
+    int nboxes = 0;
+    int max_ndims = 1;
+    int ncid;
+    int dimids[4];
+    int varids[7];
+    int *set_ndims = NULL, *box_set = NULL, *box_subfile = NULL;
+    long long *box_start = NULL, *box_count = NULL;
+    int ierr;
+
+    for (int s = 0; s < sub->nsets; s++)
+    {
+        nboxes += sets[s].nboxes;
+        if (sets[s].ndims > max_ndims)
+            max_ndims = sets[s].ndims;
+    }
+
+    subfile_index_name(filename, name);
+    LOG((2, "subfile_write_index_file name = %s nsets = %d nboxes = %d nvarsets = %d", name,
+         sub->nsets, nboxes, sub->nvarsets));
+    if ((ierr = ncmpi_create(MPI_COMM_SELF, name, NC_CLOBBER | NC_64BIT_DATA, MPI_INFO_NULL, &ncid)))
+        return ierr;
+
+    ierr = ncmpi_put_att_int(ncid, NC_GLOBAL, "num_subfiles", NC_INT, 1, &sub->nsubfiles);
+
+    /* Dimensions can not have zero length, the tables are only
+     * written if some boxes were written. */
+    if (ierr == PIO_NOERR && nboxes > 0)
+    {
+        int ids2[2];
+
+        if (!ierr)
+            ierr = ncmpi_def_dim(ncid, "nsets", sub->nsets, &dimids[0]);
+        if (!ierr)
+            ierr = ncmpi_def_dim(ncid, "nboxes", nboxes, &dimids[1]);
+        if (!ierr)
+            ierr = ncmpi_def_dim(ncid, "max_ndims", max_ndims, &dimids[2]);
+        if (!ierr)
+            ierr = ncmpi_def_dim(ncid, "nvarsets", sub->nvarsets, &dimids[3]);
+        if (!ierr)
+            ierr = ncmpi_def_var(ncid, "set_ndims", NC_INT, 1, &dimids[0], &varids[0]);
+        if (!ierr)
+            ierr = ncmpi_def_var(ncid, "box_set", NC_INT, 1, &dimids[1], &varids[1]);
+        if (!ierr)
+            ierr = ncmpi_def_var(ncid, "box_subfile", NC_INT, 1, &dimids[1], &varids[2]);
+        ids2[0] = dimids[1];
+        ids2[1] = dimids[2];
+        if (!ierr)
+            ierr = ncmpi_def_var(ncid, "box_start", NC_INT64, 2, ids2, &varids[3]);
+        if (!ierr)
+            ierr = ncmpi_def_var(ncid, "box_count", NC_INT64, 2, ids2, &varids[4]);
+        if (!ierr)
+            ierr = ncmpi_def_var(ncid, "var_id", NC_INT, 1, &dimids[3], &varids[5]);
+        if (!ierr)
+            ierr = ncmpi_def_var(ncid, "var_set", NC_INT, 1, &dimids[3], &varids[6]);
+    }
+    if (ierr == PIO_NOERR)
+        ierr = ncmpi_enddef(ncid);
+
+    if (ierr == PIO_NOERR && nboxes > 0)
+    {
+        if (!(set_ndims = malloc(sub->nsets * sizeof(int))) ||
+            !(box_set = malloc(nboxes * sizeof(int))) ||
+            !(box_subfile = malloc(nboxes * sizeof(int))) ||
+            !(box_start = calloc((size_t)nboxes * max_ndims, sizeof(long long))) ||
+            !(box_count = calloc((size_t)nboxes * max_ndims, sizeof(long long))))
+            ierr = PIO_ENOMEM;
+    }
+
+    if (ierr == PIO_NOERR && nboxes > 0)
+    {
+        int b = 0;
+
+        /* The start/count of the boxes are padded with zeros to
+         * max_ndims values. */
+        for (int s = 0; s < sub->nsets; s++)
+        {
+            set_ndims[s] = sets[s].ndims;
+            for (int i = 0; i < sets[s].nboxes; i++, b++)
+            {
+                box_set[b] = s;
+                box_subfile[b] = sets[s].subfile[i];
+                for (int d = 0; d < sets[s].ndims; d++)
+                {
+                    box_start[b * max_ndims + d] = sets[s].start[i * sets[s].ndims + d];
+                    box_count[b * max_ndims + d] = sets[s].count[i * sets[s].ndims + d];
+                }
+            }
+        }
+
+        if (!ierr)
+            ierr = ncmpi_put_var_int_all(ncid, varids[0], set_ndims);
+        if (!ierr)
+            ierr = ncmpi_put_var_int_all(ncid, varids[1], box_set);
+        if (!ierr)
+            ierr = ncmpi_put_var_int_all(ncid, varids[2], box_subfile);
+        if (!ierr)
+            ierr = ncmpi_put_var_longlong_all(ncid, varids[3], box_start);
+        if (!ierr)
+            ierr = ncmpi_put_var_longlong_all(ncid, varids[4], box_count);
+        if (!ierr)
+            ierr = ncmpi_put_var_int_all(ncid, varids[5], sub->var_id);
+        if (!ierr)
+            ierr = ncmpi_put_var_int_all(ncid, varids[6], sub->var_set);
+    }
+
+    free(set_ndims);
+    free(box_set);
+    free(box_subfile);
+    free(box_start);
+    free(box_count);
+
+    if (ierr == PIO_NOERR)
+        ierr = ncmpi_close(ncid);
+    else
+        ncmpi_close(ncid);
+
+    return ierr;
+}
+
+/**
+ * Write the index of a subfiled file. The boxes written by all the
+ * IO tasks are gathered on IO task 0, which writes the index.
+ *
+ * This function is collective on the IO tasks.
+ *
+ * @param file pointer to the file info.
+ * @returns 0 for success, error code otherwise (on IO task 0 only).
+ */
+int pio_subfile_write_index(file_desc_t *file)
+{
+    iosystem_desc_t *ios = file->iosystem;
+    pio_subfile_t *sub = file->subfile;
+    pio_subfile_set_t *sets = NULL;
+    int *nboxes = NULL;
+    int *counts = NULL;
+    int *displs = NULL;
+    int mpierr = MPI_SUCCESS;
+    int ierr = PIO_NOERR;
+
+    pioassert(ios->ioproc && sub && !sub->fh, "invalid input", __FILE__, __LINE__);
+
+    if (ios->io_rank == 0)
+    {
+        if (!(sets = calloc(sub->nsets ? sub->nsets : 1, sizeof(pio_subfile_set_t))) ||
+            !(nboxes = malloc(ios->num_iotasks * sizeof(int))) ||
+            !(counts = malloc(ios->num_iotasks * sizeof(int))) ||
+            !(displs = malloc(ios->num_iotasks * sizeof(int))))
+        {
+            return pio_err(ios, file, PIO_ENOMEM, __FILE__, __LINE__,
+                            "Writing the index of the subfiled file (%s, ncid=%d) failed. Out of memory allocating buffers to gather the boxes of %d IO tasks", pio_get_fname_from_file(file), file->pio_ncid, ios->num_iotasks);
+        }
+    }
+
+    /* Gather the boxes of each set on IO task 0. */
+    for (int s = 0; s < sub->nsets; s++)
+    {
+        pio_subfile_set_t *set = &sub->sets[s];
+        int ncount = set->nboxes * set->ndims;
+
+        if ((mpierr = MPI_Gather(&set->nboxes, 1, MPI_INT, nboxes, 1, MPI_INT, 0, ios->io_comm)))
+            return check_mpi(NULL, file, mpierr, __FILE__, __LINE__);
+
+        if (ios->io_rank == 0)
+        {
+            int total = 0;
+
+            for (int t = 0; t < ios->num_iotasks; t++)
+            {
+                counts[t] = nboxes[t] * set->ndims;
+                displs[t] = total * set->ndims;
+                total += nboxes[t];
+            }
+
+            sets[s].ndims = set->ndims;
+            sets[s].nboxes = total;
+            if (!(sets[s].subfile = malloc((total ? total : 1) * sizeof(int))) ||
+                !(sets[s].start = malloc((total ? total * set->ndims : 1) * sizeof(PIO_Offset))) ||
+                !(sets[s].count = malloc((total ? total * set->ndims : 1) * sizeof(PIO_Offset))))
+            {
+                return pio_err(ios, file, PIO_ENOMEM, __FILE__, __LINE__,
+                                "Writing the index of the subfiled file (%s, ncid=%d) failed. Out of memory allocating buffers for %d boxes", pio_get_fname_from_file(file), file->pio_ncid, total);
+            }
+
+            for (int t = 0, b = 0; t < ios->num_iotasks; t++)
+                for (int i = 0; i < nboxes[t]; i++, b++)
+                    sets[s].subfile[b] = subfile_of_rank(t, ios->num_iotasks, sub->nsubfiles);
+        }
+
+        if ((mpierr = MPI_Gatherv(set->start, ncount, MPI_OFFSET, sets ? sets[s].start : NULL,
+                                  counts, displs, MPI_OFFSET, 0, ios->io_comm)))
+            return check_mpi(NULL, file, mpierr, __FILE__, __LINE__);
+        if ((mpierr = MPI_Gatherv(set->count, ncount, MPI_OFFSET, sets ? sets[s].count : NULL,
+                                  counts, displs, MPI_OFFSET, 0, ios->io_comm)))
+            return check_mpi(NULL, file, mpierr, __FILE__, __LINE__);
+    }
+
+    /* The variables are written collectively, all the IO tasks have
+     * the same list of (variable, set) pairs. */
+    if (ios->io_rank == 0)
+    {
+        ierr = subfile_write_index_file(pio_get_fname_from_file(file), sub, sets);
+
+        for (int s = 0; s < sub->nsets; s++)
+        {
+            free(sets[s].subfile);
+            free(sets[s].start);
+            free(sets[s].count);
+        }
+        free(sets);
+        free(nboxes);
+        free(counts);
+        free(displs);
+    }
+
+    return ierr;
+}
+
+/**
+ * Read the index of a subfiled dataset on IO task 0 and broadcast it
+ * to the other IO tasks.
+ *
+ * This function is collective on the IO tasks.
+ *
+ * @param ios pointer to the IO system info.
+ * @param filename the name of the dataset.
+ * @param sub pointer to the subfile info that gets the number of
+ * subfiles, the box sets and the variables written with them.
+ * @returns 0 for success, error code otherwise.
+ */
+static int subfile_read_index(iosystem_desc_t *ios, const char *filename, pio_subfile_t *sub)
+{
+    char name[PIO_SUBFILE_MAX_NAME + 1];
+    /* Error code, number of subfiles, sets, boxes, max dims and (var, set) pairs. */
+    int hdr[6] = {PIO_NOERR, 0, 0, 0, 1, 0};
+    int *set_ndims = NULL, *box_set = NULL, *box_subfile = NULL;
+    long long *box_start = NULL, *box_count = NULL;
+    int mpierr = MPI_SUCCESS;
+    int ierr = PIO_NOERR;
+
+    if (ios->io_rank == 0)
+    {
+        int ncid;
+        int dimid;
+        int varid;
+        MPI_Offset len;
+
+        subfile_index_name(filename, name);
+        if (!(ierr = ncmpi_open(MPI_COMM_SELF, name, NC_NOWRITE, MPI_INFO_NULL, &ncid)))
+        {
+            ierr = ncmpi_get_att_int(ncid, NC_GLOBAL, "num_subfiles", &hdr[1]);
+
+            /* The tables are only written if some boxes were written. */
+            if (!ierr && !ncmpi_inq_dimid(ncid, "nboxes", &dimid))
+            {
+                const char *dim_names[4] = {"nsets", "nboxes", "max_ndims", "nvarsets"};
+
+                for (int d = 0; d < 4 && !ierr; d++)
+                {
+                    if (!(ierr = ncmpi_inq_dimid(ncid, dim_names[d], &dimid)) &&
+                        !(ierr = ncmpi_inq_dimlen(ncid, dimid, &len)))
+                        hdr[2 + d] = (int)len;
+                }
+
+                if (!ierr &&
+                    (!(set_ndims = malloc(hdr[2] * sizeof(int))) ||
+                     !(box_set = malloc(hdr[3] * sizeof(int))) ||
+                     !(box_subfile = malloc(hdr[3] * sizeof(int))) ||
+                     !(box_start = malloc((size_t)hdr[3] * hdr[4] * sizeof(long long))) ||
+                     !(box_count = malloc((size_t)hdr[3] * hdr[4] * sizeof(long long))) ||
+                     !(sub->var_id = malloc(hdr[5] * sizeof(int))) ||
+                     !(sub->var_set = malloc(hdr[5] * sizeof(int)))))
+                    ierr = PIO_ENOMEM;
+
+                if (!ierr && !(ierr = ncmpi_inq_varid(ncid, "set_ndims", &varid)))
+                    ierr = ncmpi_get_var_int_all(ncid, varid, set_ndims);
+                if (!ierr && !(ierr = ncmpi_inq_varid(ncid, "box_set", &varid)))
+                    ierr = ncmpi_get_var_int_all(ncid, varid, box_set);
+                if (!ierr && !(ierr = ncmpi_inq_varid(ncid, "box_subfile", &varid)))
+                    ierr = ncmpi_get_var_int_all(ncid, varid, box_subfile);
+                if (!ierr && !(ierr = ncmpi_inq_varid(ncid, "box_start", &varid)))
+                    ierr = ncmpi_get_var_longlong_all(ncid, varid, box_start);
+                if (!ierr && !(ierr = ncmpi_inq_varid(ncid, "box_count", &varid)))
+                    ierr = ncmpi_get_var_longlong_all(ncid, varid, box_count);
+                if (!ierr && !(ierr = ncmpi_inq_varid(ncid, "var_id", &varid)))
+                    ierr = ncmpi_get_var_int_all(ncid, varid, sub->var_id);
+                if (!ierr && !(ierr = ncmpi_inq_varid(ncid, "var_set", &varid)))
+                    ierr = ncmpi_get_var_int_all(ncid, varid, sub->var_set);
+            }
+            ncmpi_close(ncid);
+        }
+        hdr[0] = ierr;
+    }
+
+    if ((mpierr = MPI_Bcast(hdr, 6, MPI_INT, 0, ios->io_comm)))
+        return check_mpi(ios, NULL, mpierr, __FILE__, __LINE__);
+    if ((ierr = hdr[0]) != PIO_NOERR)
+    {
+        free(set_ndims);
+        free(box_set);
+        free(box_subfile);
+        free(box_start);
+        free(box_count);
+        return ierr;
+    }
+    sub->nsubfiles = hdr[1];
+    sub->nsets = hdr[2];
+    sub->nvarsets = hdr[5];
+    LOG((2, "subfile_read_index nsubfiles = %d nsets = %d nboxes = %d nvarsets = %d",
+         sub->nsubfiles, sub->nsets, hdr[3], sub->nvarsets));
+    if (sub->nsubfiles < 1)
+        return PIO_ENOTNC;
+    if (hdr[3] == 0)
+    {
+        sub->nsets = 0;
+        sub->nvarsets = 0;
+        return PIO_NOERR;
+    }
+
+    if (ios->io_rank != 0)
+    {
+        if (!(set_ndims = malloc(hdr[2] * sizeof(int))) ||
+            !(box_set = malloc(hdr[3] * sizeof(int))) ||
+            !(box_subfile = malloc(hdr[3] * sizeof(int))) ||
+            !(box_start = malloc((size_t)hdr[3] * hdr[4] * sizeof(long long))) ||
+            !(box_count = malloc((size_t)hdr[3] * hdr[4] * sizeof(long long))) ||
+            !(sub->var_id = malloc(hdr[5] * sizeof(int))) ||
+            !(sub->var_set = malloc(hdr[5] * sizeof(int))))
+            return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
+                            "Reading the index of the subfiled dataset (%s) failed. Out of memory allocating buffers for %d boxes", filename, hdr[3]);
+    }
+
+    if ((mpierr = MPI_Bcast(set_ndims, hdr[2], MPI_INT, 0, ios->io_comm)) ||
+        (mpierr = MPI_Bcast(box_set, hdr[3], MPI_INT, 0, ios->io_comm)) ||
+        (mpierr = MPI_Bcast(box_subfile, hdr[3], MPI_INT, 0, ios->io_comm)) ||
+        (mpierr = MPI_Bcast(box_start, hdr[3] * hdr[4], MPI_LONG_LONG, 0, ios->io_comm)) ||
+        (mpierr = MPI_Bcast(box_count, hdr[3] * hdr[4], MPI_LONG_LONG, 0, ios->io_comm)) ||
+        (mpierr = MPI_Bcast(sub->var_id, hdr[5], MPI_INT, 0, ios->io_comm)) ||
+        (mpierr = MPI_Bcast(sub->var_set, hdr[5], MPI_INT, 0, ios->io_comm)))
+        return check_mpi(ios, NULL, mpierr, __FILE__, __LINE__);
+
+    /* Sort the boxes into their sets. */
+    if (!(sub->sets = calloc(sub->nsets, sizeof(pio_subfile_set_t))))
+        ierr = PIO_ENOMEM;
+    for (int s = 0; s < sub->nsets && !ierr; s++)
+    {
+        pio_subfile_set_t *set = &sub->sets[s];
+        int n = 0;
+
+        set->ndims = set_ndims[s];
+        for (int b = 0; b < hdr[3]; b++)
+            if (box_set[b] == s)
+                n++;
+        if (!(set->subfile = malloc((n ? n : 1) * sizeof(int))) ||
+            !(set->start = malloc((n ? n * set->ndims : 1) * sizeof(PIO_Offset))) ||
+            !(set->count = malloc((n ? n * set->ndims : 1) * sizeof(PIO_Offset))))
+        {
+            ierr = PIO_ENOMEM;
+            break;
+        }
+
+        for (int b = 0; b < hdr[3]; b++)
+        {
+            if (box_set[b] != s)
+                continue;
+            set->subfile[set->nboxes] = box_subfile[b];
+            for (int d = 0; d < set->ndims; d++)
+            {
+                set->start[set->nboxes * set->ndims + d] = box_start[b * hdr[4] + d];
+                set->count[set->nboxes * set->ndims + d] = box_count[b * hdr[4] + d];
+            }
+            set->nboxes++;
+        }
+    }
+
+    free(set_ndims);
+    free(box_set);
+    free(box_subfile);
+    free(box_start);
+    free(box_count);
+
+    return ierr;
+}
+
+/**
+ * Open a subfiled dataset for reading, if filename is the name of a
+ * subfiled dataset (filename does not exist and the index of the
+ * dataset does). Called on the IO tasks, before ncmpi_open(), when
+ * opening a file with PIO_IOTYPE_PNETCDF.
+ *
+ * All the subfiles are opened, on all the IO tasks, in independent
+ * data mode. file->fh gets a (collective mode) handle of the subfile
+ * with the most records, used for the metadata.
+ *
+ * This function is collective on the IO tasks.
+ *
+ * @param file pointer to the file info.
+ * @param filename the name of the dataset.
+ * @param is_subfiledp pointer that gets 1 if the dataset is subfiled
+ * (and opened), 0 otherwise.
+ * @returns 0 for success, error code otherwise.
+ */
+int pio_subfile_open(file_desc_t *file, const char *filename, int *is_subfiledp)
+{
+    iosystem_desc_t *ios = file->iosystem;
+    pio_subfile_t *sub;
+    char name[PIO_SUBFILE_MAX_NAME + 1];
+    PIO_Offset max_nrecs = -1;
+    int is_subfiled = 0;
+    int mpierr = MPI_SUCCESS;
+    int ierr = PIO_NOERR;
+
+    pioassert(ios->ioproc && is_subfiledp, "invalid input", __FILE__, __LINE__);
+    *is_subfiledp = 0;
+
+    if (ios->io_rank == 0)
+    {
+        subfile_index_name(filename, name);
+        is_subfiled = (access(filename, F_OK) && !access(name, F_OK));
+    }
+    if ((mpierr = MPI_Bcast(&is_subfiled, 1, MPI_INT, 0, ios->io_comm)))
+        return check_mpi(ios, NULL, mpierr, __FILE__, __LINE__);
+    if (!is_subfiled)
+        return PIO_NOERR;
+
+    LOG((2, "pio_subfile_open opening subfiled dataset %s", filename));
+
+    /* Subfiled datasets are merged (PIOc_merge_subfiles()) before
+     * they are modified. */
+    if (file->mode & PIO_WRITE)
+        return PIO_EPERM;
+
+    if (!(sub = calloc(1, sizeof(pio_subfile_t))))
+        return PIO_ENOMEM;
+    sub->comm = MPI_COMM_NULL;
+
+    if ((ierr = subfile_read_index(ios, filename, sub)))
+    {
+        subfile_free(sub);
+        return ierr;
+    }
+
+    if (!(sub->fh = malloc(sub->nsubfiles * sizeof(int))))
+    {
+        subfile_free(sub);
+        return PIO_ENOMEM;
+    }
+    for (int s = 0; s < sub->nsubfiles; s++)
+        sub->fh[s] = -1;
+
+    for (int s = 0; s < sub->nsubfiles && !ierr; s++)
+    {
+        int unlimdimid;
+
+        subfile_name(filename, s, name);
+        if ((ierr = ncmpi_open(ios->io_comm, name, NC_NOWRITE, ios->info, &sub->fh[s])))
+            break;
+        if ((ierr = ncmpi_begin_indep_data(sub->fh[s])))
+            break;
+
+        /* The subfiles written by groups of IO tasks without data in
+         * the last records have less records. */
+        if (!(ierr = ncmpi_inq_unlimdim(sub->fh[s], &unlimdimid)))
+        {
+            PIO_Offset nrecs = 0;
+
+            if (unlimdimid >= 0)
+                ierr = ncmpi_inq_dimlen(sub->fh[s], unlimdimid, &nrecs);
+            if (nrecs > max_nrecs)
+            {
+                max_nrecs = nrecs;
+                sub->meta = s;
+            }
+        }
+    }
+
+    if (!ierr)
+    {
+        subfile_name(filename, sub->meta, name);
+        ierr = ncmpi_open(ios->io_comm, name, file->mode, ios->info, &file->fh);
+    }
+
+    if (ierr != PIO_NOERR)
+    {
+        subfile_free(sub);
+        return ierr;
+    }
+    file->subfile = sub;
+    *is_subfiledp = 1;
+
+    return PIO_NOERR;
+}
+
+/**
+ * Check if a variable of a subfiled dataset was written (as a
+ * distributed array) to several subfiles.
+ *
+ * @param file pointer to the file info.
+ * @param varid the variable id.
+ * @returns 1 if the data of the variable is in the boxes of the
+ * index, 0 if it is in all the subfiles.
+ */
+int pio_subfile_has_var(file_desc_t *file, int varid)
+{
+    pio_subfile_t *sub = file->subfile;
+
+    if (!sub)
+        return 0;
+
+    for (int p = 0; p < sub->nvarsets; p++)
+        if (sub->var_id[p] == varid)
+            return 1;
+
+    return 0;
+}
+
+/**
+ * Get the start/count, in the file, of the intersection of a box of
+ * a set with a request.
+ *
+ * @param set pointer to the box set.
+ * @param b the index of the box in the set.
+ * @param ndims the number of dimensions of the variable.
+ * @param rec 1 if the variable is a record variable, 0 otherwise.
+ * @param start the start of the request (ndims values).
+ * @param count the count of the request (ndims values).
+ * @param istart array of ndims values that gets the start of the
+ * intersection.
+ * @param icount array of ndims values that gets the count of the
+ * intersection.
+ * @returns 1 if the box intersects the request, 0 otherwise.
+ */
+static int subfile_box_intersect(const pio_subfile_set_t *set, int b, int ndims, int rec,
+                                 const PIO_Offset *start, const PIO_Offset *count,
+                                 PIO_Offset *istart, PIO_Offset *icount)
+{
+    /* Decompositions may have extra outermost dimensions (of length
+     * 1), the box dimensions are matched from the innermost. */
+    int nd = ndims - rec;
+    const PIO_Offset *bstart;
+    const PIO_Offset *bcount;
+
+    if (nd < 1 || set->ndims < nd)
+        return 0;
+    bstart = set->start + b * set->ndims + (set->ndims - nd);
+    bcount = set->count + b * set->ndims + (set->ndims - nd);
+
+    if (rec)
+    {
+        istart[0] = start[0];
+        icount[0] = count[0];
+    }
+    for (int i = 0; i < nd; i++)
+    {
+        int d = rec + i;
+        PIO_Offset lo = (start[d] > bstart[i]) ? start[d] : bstart[i];
+        PIO_Offset hi = (start[d] + count[d] < bstart[i] + bcount[i]) ?
+            start[d] + count[d] : bstart[i] + bcount[i];
+
+        if (hi <= lo)
+            return 0;
+        istart[d] = lo;
+        icount[d] = hi - lo;
+    }
+
+    return 1;
+}
+
+/**
+ * Check if a variable of a subfiled dataset is a record variable.
+ *
+ * @param file pointer to the file info.
+ * @param varid the variable id.
+ * @param ndims the number of dimensions of the variable.
+ * @param recp pointer that gets 1 for record variables, 0 otherwise.
+ * @returns 0 for success, error code otherwise.
+ */
+static int subfile_is_rec_var(file_desc_t *file, int varid, int ndims, int *recp)
+{
+    int dimids[ndims > 0 ? ndims : 1];
+    int unlimdimid;
+    int ierr;
+
+    *recp = 0;
+    if (ndims < 1)
+        return PIO_NOERR;
+    if ((ierr = ncmpi_inq_unlimdim(file->fh, &unlimdimid)))
+        return ierr;
+    if ((ierr = ncmpi_inq_vardimid(file->fh, varid, dimids)))
+        return ierr;
+    *recp = (unlimdimid >= 0 && dimids[0] == unlimdimid);
+
+    return PIO_NOERR;
+}
+
+/**
+ * Read a list of subarrays of a variable of a subfiled dataset. The
+ * parts of each subarray in the boxes of the index are read from the
+ * subfiles containing them. Variables not written as distributed
+ * arrays are read from the metadata subfile. The reads are
+ * independent, this function can be called by any IO task.
+ *
+ * @param file pointer to the file info.
+ * @param varid the variable id.
+ * @param ndims the number of dimensions of the variable.
+ * @param nreqs the number of subarrays.
+ * @param starts the starts of the subarrays.
+ * @param counts the counts of the subarrays.
+ * @param buf the buffer that gets the data, the subarrays are
+ * contiguous in the buffer.
+ * @param mtype the MPI type of the data in buf.
+ * @returns 0 for success, error code otherwise.
+ */
+int pio_subfile_get_varn(file_desc_t *file, int varid, int ndims, int nreqs,
+                         PIO_Offset *const *starts, PIO_Offset *const *counts,
+                         void *buf, MPI_Datatype mtype)
+{
+    pio_subfile_t *sub = file->subfile;
+    PIO_Offset istart[ndims > 0 ? ndims : 1];
+    PIO_Offset icount[ndims > 0 ? ndims : 1];
+    PIO_Offset imap[ndims > 0 ? ndims : 1];
+    PIO_Offset off = 0;
+    int has_var = pio_subfile_has_var(file, varid);
+    int tsize;
+    int rec;
+    int mpierr = MPI_SUCCESS;
+    int ierr;
+
+    pioassert(sub && sub->fh, "invalid input", __FILE__, __LINE__);
+
+    if ((mpierr = MPI_Type_size(mtype, &tsize)))
+        return check_mpi(NULL, file, mpierr, __FILE__, __LINE__);
+    if ((ierr = subfile_is_rec_var(file, varid, ndims, &rec)))
+        return ierr;
+
+    for (int r = 0; r < nreqs; r++)
+    {
+        PIO_Offset nelems = 1;
+
+        for (int d = 0; d < ndims; d++)
+            nelems *= counts[r][d];
+        if (nelems == 0)
+            continue;
+
+        if (!has_var)
+        {
+            if ((ierr = ncmpi_get_vara(sub->fh[sub->meta], varid, starts[r], counts[r],
+                                       (char *)buf + off * tsize, nelems, mtype)))
+                return ierr;
+            off += nelems;
+            continue;
+        }
+
+        /* The (row major) layout of the subarray in the buffer. */
+        imap[ndims - 1] = 1;
+        for (int d = ndims - 2; d >= 0; d--)
+            imap[d] = imap[d + 1] * counts[r][d + 1];
+
+        for (int p = 0; p < sub->nvarsets; p++)
+        {
+            const pio_subfile_set_t *set;
+
+            if (sub->var_id[p] != varid)
+                continue;
+            set = &sub->sets[sub->var_set[p]];
+
+            for (int b = 0; b < set->nboxes; b++)
+            {
+                PIO_Offset boff = 0;
+
+                if (!subfile_box_intersect(set, b, ndims, rec, starts[r], counts[r], istart, icount))
+                    continue;
+                for (int d = 0; d < ndims; d++)
+                    boff += (istart[d] - starts[r][d]) * imap[d];
+
+                LOG((3, "pio_subfile_get_varn varid = %d req = %d box = %d subfile = %d", varid, r, b,
+                     set->subfile[b]));
+                if ((ierr = ncmpi_get_varm(sub->fh[set->subfile[b]], varid, istart, icount, NULL, imap,
+                                           (char *)buf + (off + boff) * tsize, -1, mtype)))
+                    return ierr;
+            }
+        }
+        off += nelems;
+    }
+
+    return PIO_NOERR;
+}
+
+/**
+ * Read a subarray of a variable of a subfiled dataset, see
+ * pio_subfile_get_varn(). Strided reads are not supported.
+ *
+ * @param file pointer to the file info.
+ * @param varid the variable id.
+ * @param start the start of the subarray.
+ * @param count the count of the subarray.
+ * @param stride the stride of the subarray, may be NULL.
+ * @param xtype the type of the data in buf.
+ * @param buf the buffer that gets the data.
+ * @returns 0 for success, error code otherwise.
+ */
+int pio_subfile_get_vars(file_desc_t *file, int varid, const PIO_Offset *start,
+                         const PIO_Offset *count, const PIO_Offset *stride,
+                         nc_type xtype, void *buf)
+{
+    PIO_Offset *startp = (PIO_Offset *)start;
+    PIO_Offset *countp = (PIO_Offset *)count;
+    MPI_Datatype mtype;
+    int ndims;
+    int ierr;
+
+    if ((ierr = ncmpi_inq_varndims(file->fh, varid, &ndims)))
+        return ierr;
+
+    for (int d = 0; stride && d < ndims; d++)
+        if (stride[d] != 1)
+            return PIO_ESTRIDE;
+
+    if (xtype == PIO_LONG_INTERNAL)
+        mtype = MPI_LONG;
+    else if ((ierr = find_mpi_type(xtype, &mtype, NULL)))
+        return ierr;
+
+    return pio_subfile_get_varn(file, varid, ndims, 1, &startp, &countp, buf, mtype);
+}
+
+/**
+ * Close a subfiled file. The index of a file that was written is
+ * written, the subfiles of a dataset that was read are closed. Called
+ * on the IO tasks after closing file->fh.
+ *
+ * This function is collective on the IO tasks.
+ *
+ * @param file pointer to the file info.
+ * @param ierr the result of closing file->fh on this IO task. The
+ * index is only written if the file was closed on all the IO tasks.
+ * @returns 0 for success, error code otherwise.
+ */
+int pio_subfile_close(file_desc_t *file, int ierr)
+{
+    int mpierr;
+    int ret;
+
+    pioassert(file->subfile, "invalid input", __FILE__, __LINE__);
+
+    if (!file->subfile->fh)
+    {
+        if ((mpierr = MPI_Allreduce(MPI_IN_PLACE, &ierr, 1, MPI_INT, MPI_MIN,
+                                    file->iosystem->io_comm)))
+            ierr = check_mpi(NULL, file, mpierr, __FILE__, __LINE__);
+        if (ierr == PIO_NOERR)
+            ierr = pio_subfile_write_index(file);
+    }
+
+    ret = subfile_free(file->subfile);
+    file->subfile = NULL;
+
+    return (ierr != PIO_NOERR) ? ierr : ret;
+}
+
+/**
+ * Copy one variable of a subfiled dataset to the merged file. The
+ * boxes of the variable are read by the IO tasks in turn, variables
+ * not written as distributed arrays are copied by IO task 0.
+ *
+ * This function is collective on the IO tasks.
+ *
+ * @param file pointer to the info of the (opened) subfiled dataset.
+ * @param ncid the PnetCDF handle of the merged file.
+ * @param varid the variable id.
+ * @param numrecs the number of records in the dataset.
+ * @returns 0 for success, error code otherwise.
+ */
+static int subfile_merge_var(file_desc_t *file, int ncid, int varid, PIO_Offset numrecs)
+{
+    iosystem_desc_t *ios = file->iosystem;
+    pio_subfile_t *sub = file->subfile;
+    int ndims;
+    nc_type xtype;
+    MPI_Datatype mtype;
+    int tsize;
+    int rec;
+    int has_var = pio_subfile_has_var(file, varid);
+    int ierr;
+
+    if ((ierr = ncmpi_inq_varndims(file->fh, varid, &ndims)) ||
+        (ierr = ncmpi_inq_vartype(file->fh, varid, &xtype)) ||
+        (ierr = find_mpi_type(xtype, &mtype, &tsize)) ||
+        (ierr = subfile_is_rec_var(file, varid, ndims, &rec)))
+        return ierr;
+
+    {
+        int dimids[ndims > 0 ? ndims : 1];
+        PIO_Offset start[ndims > 0 ? ndims : 1];
+        PIO_Offset count[ndims > 0 ? ndims : 1];
+        PIO_Offset istart[ndims > 0 ? ndims : 1];
+        PIO_Offset icount[ndims > 0 ? ndims : 1];
+
+        if (ndims > 0 && (ierr = ncmpi_inq_vardimid(file->fh, varid, dimids)))
+            return ierr;
+        start[0] = 0;
+        count[0] = 1;
+        for (int d = 0; d < ndims; d++)
+        {
+            start[d] = 0;
+            if ((ierr = ncmpi_inq_dimlen(file->fh, dimids[d], &count[d])))
+                return ierr;
+        }
+        if (rec)
+            count[0] = 1;
+
+        /* One record at a time. */
+        for (PIO_Offset r = 0; r < (rec ? numrecs : 1); r++)
+        {
+            void **bufs = NULL;
+            int *reqs = NULL;
+            int *stats = NULL;
+            int nreqs = 0;
+            int nbox = 0;
+
+            if (rec)
+                start[0] = r;
+
+            for (int p = 0; p < sub->nvarsets && has_var && !ierr; p++)
+            {
+                const pio_subfile_set_t *set;
+
+                if (sub->var_id[p] != varid)
+                    continue;
+                set = &sub->sets[sub->var_set[p]];
+                for (int b = 0; b < set->nboxes && !ierr; b++)
+                {
+                    PIO_Offset nelems = 1;
+                    void **new_bufs;
+                    int *new_reqs;
+
+                    if (!subfile_box_intersect(set, b, ndims, rec, start, count, istart, icount))
+                        continue;
+                    if (nbox++ % ios->num_iotasks != ios->io_rank)
+                        continue;
+
+                    for (int d = 0; d < ndims; d++)
+                        nelems *= icount[d];
+                    if (!(new_bufs = realloc(bufs, (nreqs + 1) * sizeof(void *))))
+                    {
+                        ierr = PIO_ENOMEM;
+                        break;
+                    }
+                    bufs = new_bufs;
+                    if (!(new_reqs = realloc(reqs, (nreqs + 1) * sizeof(int))))
+                    {
+                        ierr = PIO_ENOMEM;
+                        break;
+                    }
+                    reqs = new_reqs;
+                    if (!(bufs[nreqs] = malloc(nelems * tsize)))
+                    {
+                        ierr = PIO_ENOMEM;
+                        break;
+                    }
+                    nreqs++;
+
+                    if (!(ierr = ncmpi_get_vara(sub->fh[set->subfile[b]], varid, istart, icount,
+                                                bufs[nreqs - 1], nelems, mtype)))
+                        ierr = ncmpi_iput_vara(ncid, varid, istart, icount, bufs[nreqs - 1],
+                                               nelems, mtype, &reqs[nreqs - 1]);
+                }
+            }
+
+            /* Variables not written as distributed arrays are in all
+             * the subfiles. */
+            if (!has_var && ios->io_rank == 0 && !ierr)
+            {
+                PIO_Offset nelems = 1;
+
+                for (int d = 0; d < ndims; d++)
+                    nelems *= count[d];
+                if (nelems > 0)
+                {
+                    if (!(bufs = malloc(sizeof(void *))) || !(reqs = malloc(sizeof(int))) ||
+                        !(bufs[0] = malloc(nelems * tsize)))
+                        ierr = PIO_ENOMEM;
+                    else
+                    {
+                        nreqs = 1;
+                        if (!(ierr = ncmpi_get_vara(sub->fh[sub->meta], varid, start, count,
+                                                    bufs[0], nelems, mtype)))
+                            ierr = ncmpi_iput_vara(ncid, varid, start, count, bufs[0], nelems,
+                                                   mtype, &reqs[0]);
+                    }
+                }
+            }
+
+            if (nreqs > 0 && !(stats = malloc(nreqs * sizeof(int))))
+                ierr = PIO_ENOMEM;
+
+            /* The wait is collective, all the IO tasks call it even
+             * after an error. */
+            {
+                int ret = ncmpi_wait_all(ncid, ierr ? 0 : nreqs, reqs, stats);
+                if (!ierr)
+                    ierr = ret;
+            }
+
+            for (int i = 0; i < nreqs; i++)
+                free(bufs[i]);
+            free(bufs);
+            free(reqs);
+            free(stats);
+
+            if (ierr)
+                break;
+        }
+    }
+
+    return ierr;
+}
+
+/**
+ * Merge the subfiles of a subfiled dataset into a single file, on
+ * the IO tasks.
+ *
+ * @param file pointer to the file info used to open the dataset.
+ * @param filename the name of the subfiled dataset.
+ * @param outfilename the name of the merged file.
+ * @returns 0 for success, error code otherwise.
+ */
+static int subfile_merge(file_desc_t *file, const char *filename, const char *outfilename)
+{
+    iosystem_desc_t *ios = file->iosystem;
+    int is_subfiled;
+    int ndims, nvars, ngatts, unlimdimid;
+    int format;
+    int cmode = NC_CLOBBER;
+    int ncid;
+    PIO_Offset numrecs = 0;
+    char name[PIO_MAX_NAME + 1];
+    int ierr;
+    int ret;
+
+    if ((ierr = pio_subfile_open(file, filename, &is_subfiled)))
+        return ierr;
+    if (!is_subfiled)
+        return PIO_EINVAL;
+
+    /* Copy the metadata. */
+    if (!(ierr = ncmpi_inq_format(file->fh, &format)))
+    {
+        if (format == NC_FORMAT_CDF5)
+            cmode |= NC_64BIT_DATA;
+        else if (format == NC_FORMAT_CDF2)
+            cmode |= NC_64BIT_OFFSET;
+        ierr = ncmpi_inq(file->fh, &ndims, &nvars, &ngatts, &unlimdimid);
+    }
+    if (!ierr && !(ierr = ncmpi_create(ios->io_comm, outfilename, cmode, ios->info, &ncid)))
+    {
+        ierr = ncmpi_set_fill(ncid, NC_NOFILL, NULL);
+
+        for (int d = 0; d < ndims && !ierr; d++)
+        {
+            PIO_Offset len;
+            int dimid;
+
+            if (!(ierr = ncmpi_inq_dim(file->fh, d, name, &len)))
+                ierr = ncmpi_def_dim(ncid, name, (d == unlimdimid) ? NC_UNLIMITED : len, &dimid);
+            if (d == unlimdimid)
+                numrecs = len;
+        }
+        for (int a = 0; a < ngatts && !ierr; a++)
+            if (!(ierr = ncmpi_inq_attname(file->fh, NC_GLOBAL, a, name)))
+                ierr = ncmpi_copy_att(file->fh, NC_GLOBAL, name, ncid, NC_GLOBAL);
+        for (int v = 0; v < nvars && !ierr; v++)
+        {
+            int dimids[PIO_MAX_DIMS];
+            int vndims, natts, varid;
+            nc_type xtype;
+
+            if ((ierr = ncmpi_inq_var(file->fh, v, name, &xtype, &vndims, dimids, &natts)) ||
+                (ierr = ncmpi_def_var(ncid, name, xtype, vndims, dimids, &varid)))
+                break;
+            for (int a = 0; a < natts && !ierr; a++)
+                if (!(ierr = ncmpi_inq_attname(file->fh, v, a, name)))
+                    ierr = ncmpi_copy_att(file->fh, v, name, ncid, varid);
+        }
+        if (!ierr)
+            ierr = ncmpi_enddef(ncid);
+
+        /* Copy the data. The calls are collective, stop on the
+         * first error on any IO task. */
+        for (int v = 0; v < nvars; v++)
+        {
+            int err = ierr;
+            int mpierr;
+
+            if ((mpierr = MPI_Allreduce(MPI_IN_PLACE, &err, 1, MPI_INT, MPI_MIN, ios->io_comm)))
+                return check_mpi(ios, NULL, mpierr, __FILE__, __LINE__);
+            if (err != PIO_NOERR)
+            {
+                if (!ierr)
+                    ierr = err;
+                break;
+            }
+            LOG((2, "subfile_merge copying variable %d", v));
+            ierr = subfile_merge_var(file, ncid, v, numrecs);
+        }
+
+        ret = ncmpi_close(ncid);
+        if (!ierr)
+            ierr = ret;
+    }
+
+    ret = ncmpi_close(file->fh);
+    ret = pio_subfile_close(file, ret);
+    if (!ierr)
+        ierr = ret;
+
+    return ierr;
+}
+#endif /* _PNETCDF */
+
+/**
+ * Merge the subfiles of a subfiled dataset (see PIOc_set_subfiling())
+ * into a single PnetCDF file, with the same format as the subfiles.
+ *
+ * This function is collective on the IO system.
+ *
+ * @param iosysid the IO system ID. The IO tasks of the IO system read
+ * the subfiles and write the merged file.
+ * @param filename the name of the subfiled dataset.
+ * @param outfilename the name of the merged file, the file is
+ * overwritten if it exists.
+ * @returns 0 for success, error code otherwise.
+ * @ingroup PIO_createfile
+ */
+int PIOc_merge_subfiles(int iosysid, const char *filename, const char *outfilename)
+{
+    iosystem_desc_t *ios;
+    int ierr = PIO_NOERR;
+
+    if (!(ios = pio_get_iosystem_from_id(iosysid)))
+    {
+        return pio_err(NULL, NULL, PIO_EBADID, __FILE__, __LINE__,
+                        "Merging subfiles failed. Invalid io system id (%d) provided", iosysid);
+    }
+
+    if (!filename || !outfilename || strlen(filename) > PIO_MAX_NAME ||
+        strlen(outfilename) > PIO_MAX_NAME)
+    {
+        return pio_err(ios, NULL, PIO_EINVAL, __FILE__, __LINE__,
+                        "Merging subfiles failed. Invalid arguments provided, filename is %s (expected not NULL), outfilename is %s (expected not NULL)", PIO_IS_NULL(filename), PIO_IS_NULL(outfilename));
+    }
+
+    if (ios->async)
+    {
+        return pio_err(ios, NULL, PIO_EINVAL, __FILE__, __LINE__,
+                        "Merging the subfiles of %s failed. Subfiling is not supported with asynchronous I/O", filename);
+    }
+
+    LOG((1, "PIOc_merge_subfiles filename = %s outfilename = %s", filename, outfilename));
+
+#ifdef _PNETCDF
+    file_desc_t *file;
+
+    if (!(file = calloc(1, sizeof(file_desc_t))))
+    {
+        return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
+                        "Merging the subfiles of %s failed. Out of memory allocating %lld bytes for the file structure", filename, (long long)sizeof(file_desc_t));
+    }
+    file->iosystem = ios;
+    file->fh = -1;
+    file->iotype = PIO_IOTYPE_PNETCDF;
+    file->mode = PIO_NOWRITE;
+    strncpy(file->fname, filename, PIO_MAX_NAME);
+
+    if (ios->ioproc)
+        ierr = subfile_merge(file, filename, outfilename);
+    free(file);
+#else
+    ierr = PIO_EBADIOTYPE;
+#endif /* _PNETCDF */
+
+    ierr = check_netcdf(ios, NULL, ierr, __FILE__, __LINE__);
+    if (ierr != PIO_NOERR)
+    {
+        return pio_err(ios, NULL, ierr, __FILE__, __LINE__,
+                        "Merging the subfiles of %s into %s failed", filename, outfilename);
+    }
+
+    return PIO_NOERR;
+}
@@ -1,6 +1,7 @@
 #include "pio_config.h"
 #include "pio_timer.h"
 #include "pio_internal.h"
+#include <float.h>
 
 /* This structure stores information on a timer type
  * init -> The init function for the timer
@@ -23,32 +24,820 @@ static int pio_ntimers = 0;
 /* Timer type chosen by the user - init'ed in mtimer_init() */
 static mtimer_type_t pio_timer_type;
 
-/* Flush timer on the root process */
-static int mtimer_flush_root(mtimer_t mt, const char *log_msg, MPI_Comm comm)
+/* Initial number of entries in a timer log */
+#define PIO_MICRO_TIMER_LOG_INIT_NENTRIES 64
+
+/* Max number of events, per process, stored in the trace ring buffer
+ * of a timer log. Once the buffer is full the oldest events are
+ * overwritten
+ */
+#define PIO_MICRO_TIMER_TRACE_NEVENTS 4096
+
+/* An entry in the timer log. All the timed events with the same
+ * timer name + log message (written to the same log file) are
+ * accumulated into one entry
+ */
+typedef struct mtimer_log_entry{
+    /* Key : log file name + '\n' + timer name/log message */
+    char *key;
+    /* Number of timed events */
+    int count;
+    /* Total time of the timed events */
+    double total_time;
+} mtimer_log_entry_t;
+
+/* A timed event in the trace ring buffer */
+typedef struct mtimer_trace_event{
+    /* Index of the entry in the timer log */
+    int entry;
+    /* Start time and duration of the event */
+    double ts;
+    double dur;
+} mtimer_trace_event_t;
+
+/* In-memory log of all timed events on a comm. The timed events
+ * are accumulated in the log, the log is reduced across all
+ * processes in the comm and written out to the log file(s) by the
+ * root process when the log is flushed (mtimer_flush_logs())
+ */
+typedef struct mtimer_log{
+    /* Comm that the timers using this log operate on */
+    MPI_Comm comm;
+
+    /* Log entries */
+    mtimer_log_entry_t *entries;
+    int nentries;
+    int max_entries;
+
+    /* Open addressing hash table, with nhash (power of 2) slots,
+     * that maps a key to the index of the entry (-1 if empty)
+     */
+    int *hash;
+    int nhash;
+
+    /* Ring buffer of timed events (only used if tracing is enabled) */
+    mtimer_trace_event_t *events;
+    long long nevents;
+
+    /* Number of times this log has been flushed */
+    int nflushes;
+
+    struct mtimer_log *next;
+} mtimer_log_t;
+
+/* List of timer logs, one per comm */
+static mtimer_log_t *mtimer_logs = NULL;
+
+/* Number of times the timer logs on a comm have been flushed, used
+ * to create unique names for the trace files. Since the logs are
+ * deleted after each flush this count is kept separately
+ */
+static int mtimer_nlog_flushes = 0;
+
+/* FNV-1a hash of a string */
+static unsigned long long mtimer_hash_str(const char *str)
+{
+    unsigned long long h = 14695981039346656037ULL;
+    for(; *str; str++)
+    {
+        h ^= (unsigned char) *str;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+/* Find the log corresponding to a comm, create one if it does not exist
+ * Returns NULL on error
+ */
+static mtimer_log_t *mtimer_get_log(MPI_Comm comm)
+{
+    mtimer_log_t *log = NULL;
+    for(log = mtimer_logs; log; log = log->next)
+    {
+        if(log->comm == comm)
+        {
+            return log;
+        }
+    }
+
+    log = (mtimer_log_t *)calloc(1, sizeof(mtimer_log_t));
+    if(!log)
+    {
+        return NULL;
+    }
+    log->comm = comm;
+    log->nflushes = mtimer_nlog_flushes;
+    log->next = mtimer_logs;
+    mtimer_logs = log;
+
+    return log;
+}
+
+/* Free a timer log and remove it from the list of logs */
+static void mtimer_free_log(mtimer_log_t *log)
+{
+    mtimer_log_t **plog = &mtimer_logs;
+    while(*plog && (*plog != log))
+    {
+        plog = &((*plog)->next);
+    }
+    if(*plog)
+    {
+        *plog = log->next;
+    }
+
+    for(int i = 0; i < log->nentries; i++)
+    {
+        free(log->entries[i].key);
+    }
+    free(log->entries);
+    free(log->hash);
+    free(log->events);
+    free(log);
+}
+
+/* Rebuild the hash table for the log entries, with nhash slots */
+static int mtimer_log_rehash(mtimer_log_t *log, int nhash)
+{
+    int *hash = (int *)malloc(nhash * sizeof(int));
+    if(!hash)
+    {
+        return PIO_ENOMEM;
+    }
+    for(int i = 0; i < nhash; i++)
+    {
+        hash[i] = -1;
+    }
+    for(int i = 0; i < log->nentries; i++)
+    {
+        int slot = (int)(mtimer_hash_str(log->entries[i].key) & (nhash - 1));
+        while(hash[slot] != -1)
+        {
+            slot = (slot + 1) & (nhash - 1);
+        }
+        hash[slot] = i;
+    }
+    free(log->hash);
+    log->hash = hash;
+    log->nhash = nhash;
+
+    return PIO_NOERR;
+}
+
+/* Find the entry for a key in the log, add one if it does not exist
+ * Returns the index of the entry or -1 on error
+ */
+static int mtimer_log_find_entry(mtimer_log_t *log, const char *key)
+{
+    int slot;
+
+    /* Keep the hash table at most half full */
+    if(2 * (log->nentries + 1) > log->nhash)
+    {
+        if(mtimer_log_rehash(log, (log->nhash) ? (2 * log->nhash) : (2 * PIO_MICRO_TIMER_LOG_INIT_NENTRIES)) != PIO_NOERR)
+        {
+            return -1;
+        }
+    }
+
+    slot = (int)(mtimer_hash_str(key) & (log->nhash - 1));
+    while(log->hash[slot] != -1)
+    {
+        if(strcmp(log->entries[log->hash[slot]].key, key) == 0)
+        {
+            return log->hash[slot];
+        }
+        slot = (slot + 1) & (log->nhash - 1);
+    }
+
+    if(log->nentries == log->max_entries)
+    {
+        int max_entries = (log->max_entries) ? (2 * log->max_entries) : PIO_MICRO_TIMER_LOG_INIT_NENTRIES;
+        mtimer_log_entry_t *entries = (mtimer_log_entry_t *)realloc(log->entries, max_entries * sizeof(mtimer_log_entry_t));
+        if(!entries)
+        {
+            return -1;
+        }
+        log->entries = entries;
+        log->max_entries = max_entries;
+    }
+
+    log->entries[log->nentries].key = strdup(key);
+    if(!log->entries[log->nentries].key)
+    {
+        return -1;
+    }
+    log->entries[log->nentries].count = 0;
+    log->entries[log->nentries].total_time = 0;
+    log->hash[slot] = log->nentries;
+
+    return log->nentries++;
+}
+
+/* Record a timed event in the in-memory timer log
+ * mt - Handle to the micro timer
+ * log_msg - Log message for the event
+ * time - Time for the event
+ * Only the in-memory log is updated, no file I/O is performed
+ * here. The logs are written out to the log files when they are
+ * flushed (mtimer_flush_logs())
+ */
+static int mtimer_log_event(mtimer_t mt, const char *log_msg, double time)
 {
-    int rank;
-    FILE *fp = NULL;
+    char key[2 * PIO_MAX_NAME + 2];
+    mtimer_log_t *log = NULL;
+    int idx;
 
     assert(mt != NULL);
-    MPI_Comm_rank(comm, &rank);
-    /* We open and close the file for every flush because multiple
-      *timers can potentially flush to the same log file
-      */
-    if(rank == 0)
+    log = mtimer_get_log(mt->comm);
+    if(!log)
     {
-        fp = fopen(mt->log_fname, "a+");
-        if(fp == NULL)
+        LOG((3, "ERROR: Unable to allocate memory for the timer log"));
+        return PIO_ENOMEM;
+    }
+
+    snprintf(key, sizeof(key), "%s\n%s %s", mt->log_fname, mt->name, (log_msg) ? (log_msg) : "");
+    idx = mtimer_log_find_entry(log, key);
+    if(idx < 0)
+    {
+        LOG((3, "ERROR: Unable to add entry to the timer log"));
+        return PIO_ENOMEM;
+    }
+    log->entries[idx].count++;
+    log->entries[idx].total_time += time;
+
+#if PIO_USE_MICRO_TIMING_TRACE
+    if(!log->events)
+    {
+        log->events = (mtimer_trace_event_t *)malloc(PIO_MICRO_TIMER_TRACE_NEVENTS * sizeof(mtimer_trace_event_t));
+        if(!log->events)
         {
-            LOG((3, "ERROR: Opening the log file, %s, failed", mt->log_fname));
-            return PIO_EINTERNAL;
+            LOG((3, "ERROR: Unable to allocate memory for the timer trace"));
+            return PIO_ENOMEM;
         }
-        fprintf(fp, "%s\n", log_msg);
-        fclose(fp);
     }
+    {
+        mtimer_trace_event_t *ev = &(log->events[log->nevents % PIO_MICRO_TIMER_TRACE_NEVENTS]);
+        ev->entry = idx;
+        ev->dur = time;
+        ev->ts = internal_timers[pio_timer_type].get_wtime() - time;
+        log->nevents++;
+    }
+#endif
 
     return PIO_NOERR;
 }
 
+/* Compare function, used to sort the log entries by key */
+static int mtimer_log_entry_cmp(const void *a, const void *b)
+{
+    return strcmp(((const mtimer_log_entry_t *)a)->key, ((const mtimer_log_entry_t *)b)->key);
+}
+
+/* Statistics, across all processes in a comm, for a log entry */
+typedef struct mtimer_log_stats{
+    const char *key;
+    /* Max number of timed events */
+    int count;
+    /* Number of processes that timed the events */
+    int nprocs;
+    /* Min/max/sum of the total times across processes */
+    double min_time;
+    double max_time;
+    double sum_time;
+} mtimer_log_stats_t;
+
+/* Compare function, used to sort the log stats by key */
+static int mtimer_log_stats_cmp(const void *a, const void *b)
+{
+    return strcmp(((const mtimer_log_stats_t *)a)->key, ((const mtimer_log_stats_t *)b)->key);
+}
+
+/* Write out the log stats on the root process
+ * stats - Array of stats (sorted by key, so that all stats written
+ *          to the same log file are contiguous)
+ * nstats - Number of stats
+ * nprocs - Number of processes in the comm
+ */
+static int mtimer_write_log_stats(mtimer_log_stats_t *stats, int nstats, int nprocs)
+{
+    int ret = PIO_NOERR;
+    int i = 0;
+
+    while(i < nstats)
+    {
+        /* All entries with the same log file name */
+        const char *fname_end = strchr(stats[i].key, '\n');
+        size_t fname_len = fname_end - stats[i].key;
+        char fname[PIO_MAX_NAME + 1];
+        FILE *fp = NULL;
+
+        assert(fname_end && (fname_len <= PIO_MAX_NAME));
+        memcpy(fname, stats[i].key, fname_len);
+        fname[fname_len] = '\0';
+
+        fp = fopen(fname, "a+");
+        if(fp == NULL)
+        {
+            LOG((3, "ERROR: Opening the log file, %s, failed", fname));
+            ret = PIO_EINTERNAL;
+        }
+        else
+        {
+            fprintf(fp, "# PIO micro timers : nprocs = %d, time (s) across processes : min max mean imbalance(%%)\n", nprocs);
+        }
+
+        for(; (i < nstats) && (strncmp(stats[i].key, fname, fname_len) == 0) && (stats[i].key[fname_len] == '\n'); i++)
+        {
+            double mean_time = (stats[i].nprocs > 0) ? (stats[i].sum_time / stats[i].nprocs) : 0.0;
+            double imbalance = (mean_time > 0) ? ((stats[i].max_time / mean_time - 1.0) * 100.0) : 0.0;
+            if(fp)
+            {
+                fprintf(fp, "%s count=%d time=%11.8f %11.8f %11.8f %6.2f s\n", stats[i].key + fname_len + 1,
+                        stats[i].count, stats[i].min_time, stats[i].max_time, mean_time, imbalance);
+            }
+        }
+
+        if(fp)
+        {
+            fclose(fp);
+        }
+    }
+
+    return ret;
+}
+
+#if PIO_USE_MICRO_TIMING_TRACE
+/* Gather the trace events from all processes and write them out, in
+ * the Chrome trace event format, on the root process. The log entries
+ * are sorted by key and perm maps the index of an entry before sorting
+ * to its index after sorting
+ * Collective on log->comm, only used when the log entries are consistent
+ * across all processes in the comm
+ */
+static int mtimer_write_log_trace(mtimer_log_t *log, const int *perm, int rank, int nprocs)
+{
+    int nevents = (log->nevents < PIO_MICRO_TIMER_TRACE_NEVENTS) ? (int)log->nevents : PIO_MICRO_TIMER_TRACE_NEVENTS;
+    int *rcounts = NULL, *rdispls = NULL;
+    double *sbuf = NULL, *rbuf = NULL;
+    double tmin = DBL_MAX;
+    int ret = PIO_NOERR;
+
+    /* The event times are written out relative to the first event
+     * across all processes
+     */
+    for(int i = 0; i < nevents; i++)
+    {
+        tmin = (log->events[i].ts < tmin) ? log->events[i].ts : tmin;
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &tmin, 1, MPI_DOUBLE, MPI_MIN, log->comm);
+
+    /* Each event is sent as 3 doubles : entry index, start time, duration
+     * If out of memory, this process still takes part in the collective
+     * calls below (sending no events) so that the other processes do not
+     * hang
+     */
+    sbuf = (double *)malloc((3 * nevents + 1) * sizeof(double));
+    if(!sbuf)
+    {
+        ret = PIO_ENOMEM;
+        nevents = 0;
+    }
+    for(int i = 0; i < nevents; i++)
+    {
+        /* Oldest event first */
+        mtimer_trace_event_t *ev = &(log->events[(log->nevents - nevents + i) % PIO_MICRO_TIMER_TRACE_NEVENTS]);
+        sbuf[3 * i] = perm[ev->entry];
+        sbuf[3 * i + 1] = ev->ts - tmin;
+        sbuf[3 * i + 2] = ev->dur;
+    }
+
+    if(rank == 0)
+    {
+        rcounts = (int *)malloc(nprocs * sizeof(int));
+        rdispls = (int *)malloc(nprocs * sizeof(int));
+        if(!rcounts || !rdispls)
+        {
+            ret = PIO_ENOMEM;
+        }
+    }
+
+    nevents *= 3;
+    MPI_Gather(&nevents, 1, MPI_INT, rcounts, 1, MPI_INT, 0, log->comm);
+    if(rank == 0 && (ret == PIO_NOERR))
+    {
+        int total = 0;
+        for(int i = 0; i < nprocs; i++)
+        {
+            rdispls[i] = total;
+            total += rcounts[i];
+        }
+        rbuf = (double *)malloc((total + 1) * sizeof(double));
+        if(!rbuf)
+        {
+            ret = PIO_ENOMEM;
+        }
+    }
+    /* PIO error codes are negative */
+    MPI_Allreduce(MPI_IN_PLACE, &ret, 1, MPI_INT, MPI_MIN, log->comm);
+    if(ret == PIO_NOERR)
+    {
+        MPI_Gatherv(sbuf, nevents, MPI_DOUBLE, rbuf, rcounts, rdispls, MPI_DOUBLE, 0, log->comm);
+    }
+
+    if((rank == 0) && (ret == PIO_NOERR))
+    {
+        /* One trace file per log file */
+        const char *prev_fname = NULL;
+        size_t prev_fname_len = 0;
+        FILE *fp = NULL;
+        bool first = true;
+
+        for(int e = 0; e < log->nentries; e++)
+        {
+            const char *key = log->entries[e].key;
+            size_t fname_len = strchr(key, '\n') - key;
+            char fname[PIO_MAX_NAME + 32];
+
+            if(prev_fname && (fname_len == prev_fname_len) && !strncmp(key, prev_fname, fname_len))
+            {
+                continue;
+            }
+            if(fp)
+            {
+                fprintf(fp, "\n]}\n");
+                fclose(fp);
+            }
+            prev_fname = key;
+            prev_fname_len = fname_len;
+            first = true;
+
+            snprintf(fname, sizeof(fname), "%.*s.%d.trace.json", (int)fname_len, key, log->nflushes);
+            fp = fopen(fname, "w");
+            if(!fp)
+            {
+                LOG((3, "ERROR: Opening the trace file, %s, failed", fname));
+                ret = PIO_EINTERNAL;
+                continue;
+            }
+            fprintf(fp, "{\"traceEvents\": [\n");
+
+            for(int p = 0; p < nprocs; p++)
+            {
+                for(int i = rdispls[p]; i < rdispls[p] + rcounts[p]; i += 3)
+                {
+                    const char *ekey = log->entries[(int)rbuf[i]].key;
+                    if(strncmp(ekey, key, fname_len + 1))
+                    {
+                        continue;
+                    }
+                    /* Times are in microseconds */
+                    fprintf(fp, "%s{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 0, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+                            (first) ? "" : ",\n", ekey + fname_len + 1, p, rbuf[i + 1] * 1e6, rbuf[i + 2] * 1e6);
+                    first = false;
+                }
+            }
+        }
+        if(fp)
+        {
+            fprintf(fp, "\n]}\n");
+            fclose(fp);
+        }
+    }
+
+    free(rbuf);
+    free(rdispls);
+    free(rcounts);
+    free(sbuf);
+
+    return ret;
+}
+#endif
+
+/* Reduce the log stats across processes when the log entries are
+ * not the same on all processes. The entries (keys + counts + times)
+ * from all processes are gathered on the root process and the stats
+ * are computed on the root process.
+ * Collective on comm
+ */
+static int mtimer_reduce_inconsistent_log(mtimer_log_t *log, MPI_Comm comm, int rank, int nprocs)
+{
+    int nentries = (log) ? log->nentries : 0;
+    int sz = 0, pos = 0;
+    char *sbuf = NULL, *rbuf = NULL;
+    int *rcounts = NULL, *rdispls = NULL;
+    int ret = PIO_NOERR;
+
+    /* Pack entries as : key + '\0' + count (int) + total time (double) */
+    for(int i = 0; i < nentries; i++)
+    {
+        sz += strlen(log->entries[i].key) + 1 + sizeof(int) + sizeof(double);
+    }
+    sbuf = (char *)malloc(sz + 1);
+    if(!sbuf)
+    {
+        /* Take part in the collective calls below, sending no entries */
+        ret = PIO_ENOMEM;
+        sz = 0;
+        nentries = 0;
+    }
+    for(int i = 0; i < nentries; i++)
+    {
+        size_t len = strlen(log->entries[i].key) + 1;
+        memcpy(sbuf + pos, log->entries[i].key, len);
+        pos += len;
+        memcpy(sbuf + pos, &(log->entries[i].count), sizeof(int));
+        pos += sizeof(int);
+        memcpy(sbuf + pos, &(log->entries[i].total_time), sizeof(double));
+        pos += sizeof(double);
+    }
+
+    if(rank == 0)
+    {
+        rcounts = (int *)malloc(nprocs * sizeof(int));
+        rdispls = (int *)malloc(nprocs * sizeof(int));
+        if(!rcounts || !rdispls)
+        {
+            ret = PIO_ENOMEM;
+        }
+    }
+    MPI_Gather(&sz, 1, MPI_INT, rcounts, 1, MPI_INT, 0, comm);
+    if((rank == 0) && (ret == PIO_NOERR))
+    {
+        int total = 0;
+        for(int i = 0; i < nprocs; i++)
+        {
+            rdispls[i] = total;
+            total += rcounts[i];
+        }
+        rbuf = (char *)malloc(total + 1);
+        if(!rbuf)
+        {
+            ret = PIO_ENOMEM;
+        }
+    }
+    /* PIO error codes are negative */
+    MPI_Allreduce(MPI_IN_PLACE, &ret, 1, MPI_INT, MPI_MIN, comm);
+    if(ret == PIO_NOERR)
+    {
+        MPI_Gatherv(sbuf, sz, MPI_CHAR, rbuf, rcounts, rdispls, MPI_CHAR, 0, comm);
+    }
+
+    if((rank == 0) && (ret == PIO_NOERR))
+    {
+        /* Merge the entries from all processes, using a temp log */
+        mtimer_log_t mlog;
+        mtimer_log_stats_t *stats = NULL;
+        int total = rdispls[nprocs - 1] + rcounts[nprocs - 1];
+
+        memset(&mlog, 0, sizeof(mtimer_log_t));
+        for(int p = 0; (p < nprocs) && (ret == PIO_NOERR); p++)
+        {
+            for(pos = rdispls[p]; pos < rdispls[p] + rcounts[p];)
+            {
+                const char *key = rbuf + pos;
+                int count;
+                double time;
+                int idx = mtimer_log_find_entry(&mlog, key);
+                if(idx < 0)
+                {
+                    ret = PIO_ENOMEM;
+                    break;
+                }
+                pos += strlen(key) + 1;
+                memcpy(&count, rbuf + pos, sizeof(int));
+                pos += sizeof(int);
+                memcpy(&time, rbuf + pos, sizeof(double));
+                pos += sizeof(double);
+
+                if(mlog.entries[idx].count == 0)
+                {
+                    /* New entry, the index of the entry in the temp log
+                     * is also the index of its stats
+                     */
+                    stats = (mtimer_log_stats_t *)realloc(stats, (idx + 1) * sizeof(mtimer_log_stats_t));
+                    if(!stats)
+                    {
+                        ret = PIO_ENOMEM;
+                        break;
+                    }
+                    stats[idx] = (mtimer_log_stats_t ){mlog.entries[idx].key, 0, 0, time, time, 0};
+                }
+                mlog.entries[idx].count = 1;
+                if(count > stats[idx].count)
+                {
+                    stats[idx].count = count;
+                }
+                stats[idx].nprocs++;
+                stats[idx].min_time = (time < stats[idx].min_time) ? time : stats[idx].min_time;
+                stats[idx].max_time = (time > stats[idx].max_time) ? time : stats[idx].max_time;
+                stats[idx].sum_time += time;
+            }
+        }
+        assert((ret != PIO_NOERR) || (pos == total) || (nprocs == 0));
+
+        if(ret == PIO_NOERR)
+        {
+            /* Sort stats by key, so that stats for the same log file
+             * are written out together
+             */
+            qsort(stats, mlog.nentries, sizeof(mtimer_log_stats_t), mtimer_log_stats_cmp);
+            ret = mtimer_write_log_stats(stats, mlog.nentries, nprocs);
+        }
+
+        free(stats);
+        for(int i = 0; i < mlog.nentries; i++)
+        {
+            free(mlog.entries[i].key);
+        }
+        free(mlog.entries);
+        free(mlog.hash);
+    }
+
+    free(rbuf);
+    free(rdispls);
+    free(rcounts);
+    free(sbuf);
+
+    return ret;
+}
+
+/* Flush the timer logs on a comm
+ * comm - The comm that the timers operate on
+ * The timed events, recorded in the in-memory log, are reduced across
+ * all processes in the comm and the stats (min/max/mean/imbalance of the
+ * time spent on each event across processes) are written out to the log
+ * files by the root process. The in-memory logs are reset after the flush.
+ * This function is collective on comm and is called when a file is closed
+ * and when the I/O system is finalized
+ */
+int mtimer_flush_logs(MPI_Comm comm)
+{
+    mtimer_log_t *log = NULL;
+    int rank, nprocs;
+    int nentries = 0;
+    long long lchk[5], gchk[5];
+    unsigned long long h = 0;
+    int ret = PIO_NOERR;
+
+    if(comm == MPI_COMM_NULL)
+    {
+        return PIO_NOERR;
+    }
+
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &nprocs);
+
+    for(log = mtimer_logs; log && (log->comm != comm); log = log->next);
+
+    /* Sort the entries so that the entries on all processes are in the
+     * same order (and the entries for a log file are contiguous)
+     */
+    int *perm = NULL;
+    if(log && (log->nentries > 0))
+    {
+        nentries = log->nentries;
+        perm = (int *)malloc(nentries * sizeof(int));
+        /* Sort an array of indices, then reorder the entries */
+        mtimer_log_entry_t *sorted = (mtimer_log_entry_t *)malloc(nentries * sizeof(mtimer_log_entry_t));
+        if(!perm || !sorted)
+        {
+            /* Reported to all processes with the check below */
+            ret = PIO_ENOMEM;
+        }
+        else
+        {
+            memcpy(sorted, log->entries, nentries * sizeof(mtimer_log_entry_t));
+            qsort(sorted, nentries, sizeof(mtimer_log_entry_t), mtimer_log_entry_cmp);
+            /* perm : index before sorting -> index after sorting */
+            for(int i = 0; i < nentries; i++)
+            {
+                int idx = mtimer_log_find_entry(log, sorted[i].key);
+                assert((idx >= 0) && (idx < nentries));
+                perm[idx] = i;
+            }
+            memcpy(log->entries, sorted, nentries * sizeof(mtimer_log_entry_t));
+            /* The hash table is stale after reordering the entries,
+             * failing to rebuild it is reported to all processes with
+             * the check below */
+            ret = mtimer_log_rehash(log, log->nhash);
+        }
+        free(sorted);
+        for(int i = 0; i < nentries; i++)
+        {
+            h = (h * 31) ^ mtimer_hash_str(log->entries[i].key);
+        }
+    }
+
+    /* Check if the entries are the same on all processes, and if
+     * sorting them failed on any process (PIO error codes are negative)
+     */
+    lchk[0] = nentries;
+    lchk[1] = -nentries;
+    lchk[2] = (long long)(h >> 1);
+    lchk[3] = -(long long)(h >> 1);
+    lchk[4] = -ret;
+    MPI_Allreduce(lchk, gchk, 5, MPI_LONG_LONG, MPI_MAX, comm);
+
+    if(gchk[4] != 0)
+    {
+        free(perm);
+        if(log)
+        {
+            mtimer_free_log(log);
+        }
+        return (int)-gchk[4];
+    }
+
+    if(gchk[0] == 0)
+    {
+        /* No timed events on any process */
+        free(perm);
+        if(log)
+        {
+            mtimer_free_log(log);
+        }
+        return PIO_NOERR;
+    }
+
+    if((gchk[0] == -gchk[1]) && (gchk[2] == -gchk[3]))
+    {
+        /* Same entries on all processes, reduce the counts and times */
+        double *sbuf = NULL, *rbuf = NULL, *rsum = NULL;
+        mtimer_log_stats_t *stats = NULL;
+
+        sbuf = (double *)malloc(3 * nentries * sizeof(double));
+        rbuf = (double *)malloc(3 * nentries * sizeof(double));
+        rsum = (double *)malloc(nentries * sizeof(double));
+        stats = (mtimer_log_stats_t *)malloc(nentries * sizeof(mtimer_log_stats_t));
+        if(!sbuf || !rbuf || !rsum || !stats)
+        {
+            ret = PIO_ENOMEM;
+        }
+        /* PIO error codes are negative */
+        MPI_Allreduce(MPI_IN_PLACE, &ret, 1, MPI_INT, MPI_MIN, comm);
+
+        if(ret == PIO_NOERR)
+        {
+            for(int i = 0; i < nentries; i++)
+            {
+                sbuf[3 * i] = log->entries[i].count;
+                sbuf[3 * i + 1] = log->entries[i].total_time;
+                sbuf[3 * i + 2] = -log->entries[i].total_time;
+            }
+            MPI_Reduce(sbuf, rbuf, 3 * nentries, MPI_DOUBLE, MPI_MAX, 0, comm);
+            for(int i = 0; i < nentries; i++)
+            {
+                sbuf[i] = log->entries[i].total_time;
+            }
+            MPI_Reduce(sbuf, rsum, nentries, MPI_DOUBLE, MPI_SUM, 0, comm);
+
+            if(rank == 0)
+            {
+                for(int i = 0; i < nentries; i++)
+                {
+                    stats[i] = (mtimer_log_stats_t ){log->entries[i].key, (int)rbuf[3 * i], nprocs,
+                                                    -rbuf[3 * i + 2], rbuf[3 * i + 1], rsum[i]};
+                }
+                ret = mtimer_write_log_stats(stats, nentries, nprocs);
+            }
+
+            /* Writing the stats, on the root process, can fail. All
+             * processes need to agree on writing the traces, which is
+             * collective
+             */
+            MPI_Allreduce(MPI_IN_PLACE, &ret, 1, MPI_INT, MPI_MIN, comm);
+        }
+
+        free(stats);
+        free(rsum);
+        free(rbuf);
+        free(sbuf);
+
+#if PIO_USE_MICRO_TIMING_TRACE
+        if(ret == PIO_NOERR)
+        {
+            ret = mtimer_write_log_trace(log, perm, rank, nprocs);
+        }
+#endif
+    }
+    else
+    {
+        /* The entries are different on some processes */
+        ret = mtimer_reduce_inconsistent_log(log, comm, rank, nprocs);
+        MPI_Allreduce(MPI_IN_PLACE, &ret, 1, MPI_INT, MPI_MIN, comm);
+    }
+
+    free(perm);
+    if(log)
+    {
+        mtimer_free_log(log);
+    }
+    mtimer_nlog_flushes++;
+
+    return ret;
+}
+
 /* Initialize the micro timing framework
  * type : Type of the timer (all timers used will be of this type)
  */
@@ -129,7 +918,6 @@ int mtimer_stop(mtimer_t mt, const char *log_msg)
 {
     int ret = PIO_NOERR;
     double elapsed_time = 0;
-    char tmp_log_msg[PIO_MAX_NAME];
     if(mt == NULL)
     {
         LOG((3, "ERROR: Micro timer failed to stop, the timer handle is invalid"));
@@ -154,10 +942,9 @@ int mtimer_stop(mtimer_t mt, const char *log_msg)
     /* Flush timer log message if no asynchronous events are pending */
     if(!mt->is_async_event_in_progress)
     {
-        snprintf(tmp_log_msg, PIO_MAX_NAME, "%s %s time=%11.8f s", mt->name, (log_msg)?(log_msg):"", mt->total_time);
         if(pio_timer_type == PIO_MICRO_MPI_WTIME_ROOT)
         {
-            ret = mtimer_flush_root(mt, tmp_log_msg, mt->comm);
+            ret = mtimer_log_event(mt, log_msg, mt->total_time);
             mt->total_time = 0;
         }
         else
@@ -211,13 +998,21 @@ int mtimer_destroy(mtimer_t *pmt)
     return PIO_NOERR;
 }
 
-/* Finalize the timer framework */
+/* Finalize the timer framework
+ * Timer logs need to be flushed (mtimer_flush_logs()) before
+ * finalizing the framework, any unflushed logs are discarded
+ */
 int mtimer_finalize(void )
 {
     if(pio_ntimers != 0){
         LOG((3, "ERROR: Micro timer finalize failed, unflushed timers exist!"));
         return PIO_EINTERNAL;
     }
+    while(mtimer_logs)
+    {
+        LOG((3, "Discarding unflushed micro timer log"));
+        mtimer_free_log(mtimer_logs);
+    }
     return PIO_NOERR;
 }
 
@@ -365,7 +1160,6 @@ int mtimer_update(mtimer_t mt, double time)
 int mtimer_flush(mtimer_t mt, const char *log_msg)
 {
     int ret = PIO_NOERR;
-    char tmp_log_msg[PIO_MAX_NAME];
     if(mt == NULL)
     {
         LOG((3, "ERROR: Flushing timer failed, invalid handle"));
@@ -384,10 +1178,9 @@ int mtimer_flush(mtimer_t mt, const char *log_msg)
       */
     if(!mt->is_async_event_in_progress && (mt->total_time > 0))
     {
-        snprintf(tmp_log_msg, PIO_MAX_NAME, "%s %s time=%11.8f s", mt->name, (log_msg)?(log_msg):"", mt->total_time);
         if(pio_timer_type == PIO_MICRO_MPI_WTIME_ROOT)
         {
-            ret = mtimer_flush_root(mt, tmp_log_msg, mt->comm);
+            ret = mtimer_log_event(mt, log_msg, mt->total_time);
             mt->total_time = 0;
         }
         else
@@ -40,7 +40,8 @@ typedef struct mtimer_info
 
 /* Timer types available,
  * PIO_MICRO_MPI_WTIME_ROOT - Uses MPI_Wtime() to measure time,
- *  outputs timer logs from the root MPI process
+ *  timed events are recorded in memory and the stats across all
+ *  processes are written out from the root MPI process
  */
 typedef enum mtimer_type {
     PIO_MICRO_MPI_WTIME_ROOT = 0,
@@ -70,6 +71,8 @@ int mtimer_get_wtime(mtimer_t mt, double *wtime);
 int mtimer_update(mtimer_t mt, double time);
 /* Manually flush a timer - write timing info to logs */
 int mtimer_flush(mtimer_t mt, const char *log_msg);
+/* Reduce the timer logs across the comm and write them out to the log files */
+int mtimer_flush_logs(MPI_Comm comm);
 /* Specify if an async event is pending on the event being timed */
 int mtimer_async_event_in_progress(mtimer_t mt, bool is_async_event_in_progress);
 /* Returns true if an async event is pending on the event being timed,
@@ -10,6 +10,7 @@
 #include <pio_config.h>
 #include <pio.h>
 #include <pio_internal.h>
+#include <float.h>
 #ifdef PIO_MICRO_TIMING
 #include "pio_timer.h"
 #endif
@@ -24,6 +25,10 @@ int default_error_handler = PIO_INTERNAL_ERROR;
  * used (see pio_sc.c). */
 extern int blocksize;
 
+/** The file system stripe size the IO task data of the box
+ * rearranger is aligned to (see pio_sc.c). */
+extern int stripesize;
+
 /**
  * Check to see if PIO has been initialized.
  *
@@ -83,6 +88,8 @@ static const char *PIO_error_handler_to_string(int eh)
         return "PIO_REDUCE_ERROR";
     } else if(eh == PIO_RETURN_ERROR){
         return "PIO_RETURN_ERROR";
+    } else if(eh == PIO_DEFER_ERROR){
+        return "PIO_DEFER_ERROR";
     } else{
         return "UNKNOWN ERROR";
     }
@@ -117,7 +124,8 @@ int PIOc_Set_File_Error_Handling(int ncid, int method)
 
     /* Check that valid error handler was provided. */
     if (method != PIO_INTERNAL_ERROR && method != PIO_BCAST_ERROR &&
-        method != PIO_RETURN_ERROR && method != PIO_REDUCE_ERROR)
+        method != PIO_RETURN_ERROR && method != PIO_REDUCE_ERROR &&
+        method != PIO_DEFER_ERROR)
         piodie(__FILE__, __LINE__, "Setting file error handler failed on file (%s). Invalid error handler method (%d:%s) provided.", pio_get_fname_from_file(file), method, PIO_error_handler_to_string(method));
 
     /* Get the old method. */
@@ -294,6 +302,292 @@ int PIOc_get_local_array_size(int ioid)
     return iodesc->ndof;
 }
 
+/**
+ * Get communication and layout statistics of a decomposition: the
+ * number of peers each task exchanges data with, the size of the
+ * messages, the balance of the IO buffers between the IO tasks, the
+ * regions of the IO tasks, the size of the blocks of consecutive
+ * elements in the messages, and the memory held by the rearranger.
+ * The statistics help to choose the number of IO tasks and the
+ * rearranger of a grid.
+ *
+ * This is a collective call on all tasks of the IO system. It is not
+ * supported with asynchronous I/O.
+ *
+ * The memory held by the MPI datatypes of the rearranger is
+ * estimated as the lengths and displacements of their blocks.
+ *
+ * @param iosysid the IO system ID.
+ * @param ioid the ID of the decomposition.
+ * @param stats pointer that gets the statistics. Ignored if NULL.
+ * @returns 0 for success, error code otherwise.
+ */
+int PIOc_get_decomp_stats(int iosysid, int ioid, pio_decomp_stats_t *stats)
+{
+    /* The per task values reduced to a minimum, maximum and
+     * average. */
+    enum {NSEND_PEERS, NRECV_PEERS, SEND_BYTES, RECV_BYTES, LLEN, REARR_MEM, NTASK_STATS};
+    /* Additional values only reduced to a maximum. */
+    enum {MAXREGIONS = NTASK_STATS, MAXFILLREGIONS, HOLEGRIDSIZE, NEEDSFILL, NMAX_STATS};
+    /* Additional values only summed. */
+    enum {NELEMS = NTASK_STATS, NBLOCKS, NSUM_STATS};
+    iosystem_desc_t *ios;
+    io_desc_t *iodesc;
+    double lmin[NTASK_STATS];
+    double lmax[NMAX_STATS] = {0};
+    double lsum[NSUM_STATS] = {0};
+    double gmin[NTASK_STATS];
+    double gmax[NMAX_STATS];
+    double gsum[NSUM_STATS];
+    double ntasks[NTASK_STATS];
+    PIO_Offset mem = 0;
+    int mpierr;
+    int ret;
+
+    LOG((1, "PIOc_get_decomp_stats iosysid = %d ioid = %d", iosysid, ioid));
+
+    if (!(ios = pio_get_iosystem_from_id(iosysid)))
+    {
+        return pio_err(NULL, NULL, PIO_EBADID, __FILE__, __LINE__,
+                        "Getting decomposition statistics failed. Invalid iosystem id (%d) provided", iosysid);
+    }
+
+    if (!(iodesc = pio_get_iodesc_from_id(ioid)))
+    {
+        return pio_err(ios, NULL, PIO_EBADID, __FILE__, __LINE__,
+                        "Getting decomposition statistics failed. Invalid io decomposition id (%d) provided", ioid);
+    }
+
+    if (ios->async)
+    {
+        return pio_err(ios, NULL, PIO_EINVAL, __FILE__, __LINE__,
+                        "Getting decomposition statistics failed (iosysid=%d, ioid=%d). Decomposition statistics are not supported with asynchronous I/O", iosysid, ioid);
+    }
+
+    /* The datatypes (or pack lists) are usually defined by the first
+     * rearrangement, define them now to describe the messages. */
+    if ((ret = define_iodesc_datatypes(ios, iodesc)))
+    {
+        return pio_err(ios, NULL, ret, __FILE__, __LINE__,
+                        "Getting decomposition statistics failed (iosysid=%d, ioid=%d). Defining MPI datatypes for rearranging data failed", iosysid, ioid);
+    }
+
+    for (int s = 0; s < NTASK_STATS; s++)
+        lmin[s] = DBL_MAX;
+
+    /* The send side of a write. */
+    if (ios->compproc)
+    {
+        int nmsgs = iodesc->rearranger == PIO_REARR_SUBSET ? 1 : ios->num_iotasks;
+        double nsend_peers = 0;
+        double send_bytes = 0;
+
+        for (int m = 0; m < nmsgs; m++)
+        {
+            if (iodesc->scount[m] > 0)
+                nsend_peers++;
+            send_bytes += (double)iodesc->scount[m] * iodesc->mpitype_size;
+        }
+        lmin[NSEND_PEERS] = lmax[NSEND_PEERS] = lsum[NSEND_PEERS] = nsend_peers;
+        lmin[SEND_BYTES] = lmax[SEND_BYTES] = lsum[SEND_BYTES] = send_bytes;
+    }
+
+    /* The receive side of a write. */
+    if (ios->ioproc)
+    {
+        double nrecv_peers = 0;
+        double recv_bytes = 0;
+
+        for (int m = 0; m < iodesc->nrecvs; m++)
+        {
+            if (iodesc->rcount[m] > 0)
+                nrecv_peers++;
+            recv_bytes += (double)iodesc->rcount[m] * iodesc->mpitype_size;
+        }
+        lmin[NRECV_PEERS] = lmax[NRECV_PEERS] = lsum[NRECV_PEERS] = nrecv_peers;
+        lmin[RECV_BYTES] = lmax[RECV_BYTES] = lsum[RECV_BYTES] = recv_bytes;
+        lmin[LLEN] = lmax[LLEN] = lsum[LLEN] = iodesc->llen;
+
+        lmax[MAXREGIONS] = iodesc->maxregions;
+        lmax[MAXFILLREGIONS] = iodesc->maxfillregions;
+        lmax[HOLEGRIDSIZE] = iodesc->holegridsize;
+    }
+    lmax[NEEDSFILL] = iodesc->needsfill;
+
+    /* The blocks of the messages and the memory of the rearranger. */
+    if ((ret = get_rearr_mem(ios, iodesc, &lsum[NELEMS], &lsum[NBLOCKS], &mem)))
+        return pio_err(ios, NULL, ret, __FILE__, __LINE__,
+                        "Getting decomposition statistics failed (iosysid=%d, ioid=%d). Counting the memory of the rearranger failed", iosysid, ioid);
+    lmin[REARR_MEM] = lmax[REARR_MEM] = lsum[REARR_MEM] = mem;
+
+    /* Reduce the values over all tasks. */
+    if ((mpierr = MPI_Allreduce(lmin, gmin, NTASK_STATS, MPI_DOUBLE, MPI_MIN, ios->union_comm)))
+        return check_mpi(ios, NULL, mpierr, __FILE__, __LINE__);
+    if ((mpierr = MPI_Allreduce(lmax, gmax, NMAX_STATS, MPI_DOUBLE, MPI_MAX, ios->union_comm)))
+        return check_mpi(ios, NULL, mpierr, __FILE__, __LINE__);
+    if ((mpierr = MPI_Allreduce(lsum, gsum, NSUM_STATS, MPI_DOUBLE, MPI_SUM, ios->union_comm)))
+        return check_mpi(ios, NULL, mpierr, __FILE__, __LINE__);
+
+    LOG((1, "decomposition %d: send peers %g-%g recv peers %g-%g llen %g-%g "
+         "maxregions %g blocks %g of %g elements rearranger memory %g-%g bytes",
+         ioid, gmin[NSEND_PEERS], gmax[NSEND_PEERS], gmin[NRECV_PEERS], gmax[NRECV_PEERS],
+         gmin[LLEN], gmax[LLEN], gmax[MAXREGIONS], gsum[NBLOCKS], gsum[NELEMS],
+         gmin[REARR_MEM], gmax[REARR_MEM]));
+
+    if (!stats)
+        return PIO_NOERR;
+
+    /* The number of tasks each value is averaged over. */
+    ntasks[NSEND_PEERS] = ntasks[SEND_BYTES] = ios->num_comptasks;
+    ntasks[NRECV_PEERS] = ntasks[RECV_BYTES] = ntasks[LLEN] = ios->num_iotasks;
+    ntasks[REARR_MEM] = ios->num_uniontasks;
+
+    stats->rearranger = iodesc->rearranger;
+    stats->num_aiotasks = iodesc->num_aiotasks;
+    stats->packed = iodesc->packed;
+    stats->needsfill = gmax[NEEDSFILL] > 0;
+    stats->maxregions = gmax[MAXREGIONS];
+    stats->maxfillregions = gmax[MAXFILLREGIONS];
+    stats->maxholegridsize = gmax[HOLEGRIDSIZE];
+
+    {
+        double *out[NTASK_STATS] = {stats->nsend_peers, stats->nrecv_peers, stats->send_bytes,
+                                    stats->recv_bytes, stats->llen, stats->rearr_mem};
+
+        for (int s = 0; s < NTASK_STATS; s++)
+        {
+            out[s][PIO_STAT_MIN] = gmin[s];
+            out[s][PIO_STAT_MAX] = gmax[s];
+            out[s][PIO_STAT_AVG] = gsum[s] / ntasks[s];
+        }
+    }
+
+    stats->llen_imbalance = stats->llen[PIO_STAT_AVG] > 0 ?
+        stats->llen[PIO_STAT_MAX] / stats->llen[PIO_STAT_AVG] : 1;
+    stats->blocksize = gsum[NBLOCKS] > 0 ? gsum[NELEMS] / gsum[NBLOCKS] : 0;
+
+    return PIO_NOERR;
+}
+
+/**
+ * Get the memory used by the buffers of an IO system, or by the
+ * buffers of one of its files, per category: the write caches of
+ * the compute tasks (PIO_MEM_WMB), the buffers of rearranged data
+ * (PIO_MEM_IOBUF) and of fill values (PIO_MEM_FILLBUF) of the IO
+ * tasks, the buffers attached to PnetCDF files for non-blocking
+ * writes (PIO_MEM_ATTACH), the rearrangers of the decompositions
+ * (PIO_MEM_REARR, only for the IO system), and the released buffers
+ * the IO system keeps for reuse (PIO_MEM_ARENA, only for the IO
+ * system, see PIOc_set_buffer_size_limit()). For each category the
+ * statistics hold the current number of bytes and the highest number
+ * of bytes held since the IO system was initialized (or the file
+ * opened). The peaks help to size the buffer limits (see
+ * PIOc_set_buffer_size_limit()).
+ *
+ * The statistics of this task are returned unless reduce is true,
+ * in which case the minimum, maximum and average over all tasks of
+ * the IO system are returned. The reduction is a collective call,
+ * it is not supported with asynchronous I/O.
+ *
+ * @param iosysid the IO system ID.
+ * @param ncid the ID of a file of the IO system, or PIO_GLOBAL for
+ * all the buffers of the IO system.
+ * @param reduce true to reduce the statistics over all tasks.
+ * @param stats pointer that gets the statistics. Ignored if NULL.
+ * @returns 0 for success, error code otherwise.
+ */
+int PIOc_get_mem_stats(int iosysid, int ncid, bool reduce, pio_mem_stats_t *stats)
+{
+    iosystem_desc_t *ios;
+    file_desc_t *file;
+    PIO_Offset *cur, *peak;
+    double local[2 * PIO_MEM_NCATS];
+    double gmin[2 * PIO_MEM_NCATS];
+    double gmax[2 * PIO_MEM_NCATS];
+    double gsum[2 * PIO_MEM_NCATS];
+    int ntasks = 1;
+    int mpierr;
+    int ret;
+
+    LOG((1, "PIOc_get_mem_stats iosysid = %d ncid = %d reduce = %d", iosysid, ncid, reduce));
+
+    if (!(ios = pio_get_iosystem_from_id(iosysid)))
+    {
+        return pio_err(NULL, NULL, PIO_EBADID, __FILE__, __LINE__,
+                        "Getting memory statistics failed. Invalid iosystem id (%d) provided", iosysid);
+    }
+
+    if (ncid == PIO_GLOBAL)
+    {
+        cur = ios->mem_cur;
+        peak = ios->mem_peak;
+    }
+    else
+    {
+        if ((ret = pio_get_file(ncid, &file)))
+        {
+            return pio_err(ios, NULL, ret, __FILE__, __LINE__,
+                            "Getting memory statistics failed. Invalid file id (ncid=%d) provided", ncid);
+        }
+        if (file->iosystem != ios)
+        {
+            return pio_err(ios, NULL, PIO_EINVAL, __FILE__, __LINE__,
+                            "Getting memory statistics failed. The file (%s, ncid=%d) does not belong to the iosystem (iosysid=%d)", pio_get_fname_from_file(file), ncid, iosysid);
+        }
+        cur = file->mem_cur;
+        peak = file->mem_peak;
+    }
+
+    if (reduce && ios->async)
+    {
+        return pio_err(ios, NULL, PIO_EINVAL, __FILE__, __LINE__,
+                        "Getting memory statistics failed (iosysid=%d). Reducing the statistics over the tasks is not supported with asynchronous I/O", iosysid);
+    }
+
+    for (int c = 0; c < PIO_MEM_NCATS; c++)
+    {
+        local[c] = cur[c];
+        local[PIO_MEM_NCATS + c] = peak[c];
+    }
+
+    if (reduce)
+    {
+        if ((mpierr = MPI_Allreduce(local, gmin, 2 * PIO_MEM_NCATS, MPI_DOUBLE, MPI_MIN,
+                                    ios->union_comm)))
+            return check_mpi(ios, NULL, mpierr, __FILE__, __LINE__);
+        if ((mpierr = MPI_Allreduce(local, gmax, 2 * PIO_MEM_NCATS, MPI_DOUBLE, MPI_MAX,
+                                    ios->union_comm)))
+            return check_mpi(ios, NULL, mpierr, __FILE__, __LINE__);
+        if ((mpierr = MPI_Allreduce(local, gsum, 2 * PIO_MEM_NCATS, MPI_DOUBLE, MPI_SUM,
+                                    ios->union_comm)))
+            return check_mpi(ios, NULL, mpierr, __FILE__, __LINE__);
+        ntasks = ios->num_uniontasks;
+    }
+    else
+    {
+        for (int v = 0; v < 2 * PIO_MEM_NCATS; v++)
+            gmin[v] = gmax[v] = gsum[v] = local[v];
+    }
+
+    LOG((2, "memory held %g bytes (peak %g bytes)", gmax[PIO_MEM_TOTAL],
+         gmax[PIO_MEM_NCATS + PIO_MEM_TOTAL]));
+
+    if (stats)
+    {
+        for (int c = 0; c < PIO_MEM_NCATS; c++)
+        {
+            stats->cur[c][PIO_STAT_MIN] = gmin[c];
+            stats->cur[c][PIO_STAT_MAX] = gmax[c];
+            stats->cur[c][PIO_STAT_AVG] = gsum[c] / ntasks;
+            stats->peak[c][PIO_STAT_MIN] = gmin[PIO_MEM_NCATS + c];
+            stats->peak[c][PIO_STAT_MAX] = gmax[PIO_MEM_NCATS + c];
+            stats->peak[c][PIO_STAT_AVG] = gsum[PIO_MEM_NCATS + c] / ntasks;
+        }
+    }
+
+    return PIO_NOERR;
+}
+
 /**
  * Set the error handling method used for subsequent calls. This
  * function is deprecated. New code should use
@@ -356,7 +650,8 @@ int PIOc_set_iosystem_error_handling(int iosysid, int method, int *old_method)
 
     /* Check that valid error handler was provided. */
     if (method != PIO_INTERNAL_ERROR && method != PIO_BCAST_ERROR &&
-        method != PIO_REDUCE_ERROR && method != PIO_RETURN_ERROR)
+        method != PIO_REDUCE_ERROR && method != PIO_RETURN_ERROR &&
+        method != PIO_DEFER_ERROR)
     {
         return pio_err(ios, NULL, PIO_EINVAL, __FILE__, __LINE__,
                         "Setting error handler for the IO system failed. Invalid error handler method (%d:%s) provided for iosystem (iosysid=%d)", method, PIO_error_handler_to_string(method), iosysid);
@@ -479,146 +774,103 @@ int pio_create_uniq_str(iosystem_desc_t *ios, io_desc_t *iodesc, char *str, int
 }
 
 /**
- * Initialize the decomposition used with distributed arrays. The
- * decomposition describes how the data will be distributed between
- * tasks.
+ * Send the parameters of a decomposition to the IO tasks, when async
+ * is in use. The IO tasks do not have data of their own, so they
+ * ignore the map.
  *
- * Internally, this function will:
- * <ul>
- * <li>Allocate and initialize an iodesc struct for this
- * decomposition. (This also allocates an io_region struct for the
- * first region.)
- * <li>(Box rearranger only) If iostart or iocount are NULL, call
- * CalcStartandCount() to determine starts/counts. Then call
- * compute_maxIObuffersize() to compute the max IO buffer size needed.
- * <li>Create the rearranger.
- * <li>Assign an ioid and add this decomposition to the list of open
- * decompositions.
- * </ul>
- *
- * @param iosysid the IO system ID.
+ * @param ios pointer to the iosystem_desc_t struct.
  * @param pio_type the basic PIO data type used.
- * @param ndims the number of dimensions in the variable, not
- * including the unlimited dimension.
+ * @param ndims the number of dimensions in the variable.
  * @param gdimlen an array length ndims with the sizes of the global
  * dimensions.
  * @param maplen the local length of the compmap array.
  * @param compmap a 1 based array of offsets into the array record on
- * file. A 0 in this array indicates a value which should not be
- * transfered.
- * @param ioidp pointer that will get the io description ID.
- * @param rearranger pointer to the rearranger to be used for this
- * decomp or NULL to use the default.
- * @param iostart An array of start values for block cyclic
- * decompositions for the SUBSET rearranger. Ignored if block
- * rearranger is used. If NULL and SUBSET rearranger is used, the
- * iostarts are generated.
- * @param iocount An array of count values for block cyclic
- * decompositions for the SUBSET rearranger. Ignored if block
- * rearranger is used. If NULL and SUBSET rearranger is used, the
- * iostarts are generated.
+ * file.
+ * @param rearranger pointer to the rearranger, or NULL.
+ * @param iostart An array of start values, or NULL.
+ * @param iocount An array of count values, or NULL.
  * @returns 0 on success, error code otherwise
- * @ingroup PIO_initdecomp
- * @author Jim Edwards, Ed Hartnett
  */
-int PIOc_InitDecomp(int iosysid, int pio_type, int ndims, const int *gdimlen, int maplen,
-                    const PIO_Offset *compmap, int *ioidp, const int *rearranger,
-                    const PIO_Offset *iostart, const PIO_Offset *iocount)
+static int send_initdecomp_msg(iosystem_desc_t *ios, int pio_type, int ndims,
+                               const int *gdimlen, int maplen, const PIO_Offset *compmap,
+                               const int *rearranger, const PIO_Offset *iostart,
+                               const PIO_Offset *iocount)
 {
-    iosystem_desc_t *ios;  /* Pointer to io system information. */
-    io_desc_t *iodesc;     /* The IO description. */
-    int mpierr = MPI_SUCCESS;  /* Return code from MPI function calls. */
-    int ierr;              /* Return code. */
+    int msg = PIO_MSG_INITDECOMP_DOF; /* Message for async notification. */
+    char rearranger_present = rearranger ? true : false;
+    int amsg_rearranger = (rearranger) ? (*rearranger) : 0;
+    char iostart_present = iostart ? true : false;
+    char iocount_present = iocount ? true : false;
+    PIO_Offset *amsg_iostart = NULL, *amsg_iocount = NULL;
+    int ierr;
 
-#ifdef TIMING
-    GPTLstart("PIO:PIOc_initdecomp");
-#endif
-    LOG((1, "PIOc_InitDecomp iosysid = %d pio_type = %d ndims = %d maplen = %d",
-         iosysid, pio_type, ndims, maplen));
-
-    /* Get IO system info. */
-    if (!(ios = pio_get_iosystem_from_id(iosysid)))
+    if(!iostart_present)
     {
-        return pio_err(NULL, NULL, PIO_EBADID, __FILE__, __LINE__,
-                        "Initializing the PIO decomposition failed. Invalid io system id (%d) provided. Could not find an iosystem associated with the id", iosysid);
+        amsg_iostart = calloc(ndims, sizeof(PIO_Offset));
     }
-
-    /* Caller must provide these. */
-    if (!gdimlen || !compmap || !ioidp)
+    if(!iocount_present)
     {
-        return pio_err(ios, NULL, PIO_EINVAL, __FILE__, __LINE__,
-                        "Initializing the PIO decomposition failed. Invalid pointers (NULL) to gdimlen(%s) or compmap(%s) or ioidp (%s) provided", (gdimlen) ? "not NULL" : "NULL", (compmap) ? "not NULL" : "NULL", (ioidp) ? "not NULL" : "NULL");
+        amsg_iocount = calloc(ndims, sizeof(PIO_Offset));
     }
-
-    /* Check the dim lengths. */
-    for (int i = 0; i < ndims; i++)
-        if (gdimlen[i] <= 0)
-        {
-            return pio_err(ios, NULL, PIO_EINVAL, __FILE__, __LINE__,
-                            "Initializing the PIO decomposition failed. Invalid value for global dimension lengths provided. The global length of dimension %d is provided as %d (expected > 0)", i, gdimlen[i]);
-        }
-
-    /* If async is in use, and this is not an IO task, bcast the parameters. */
-    if (ios->async)
+    if((!iostart_present && !amsg_iostart) || (!iocount_present && !amsg_iocount))
     {
-        int msg = PIO_MSG_INITDECOMP_DOF; /* Message for async notification. */
-        char rearranger_present = rearranger ? true : false;
-        int amsg_rearranger = (rearranger) ? (*rearranger) : 0;
-        char iostart_present = iostart ? true : false;
-        char iocount_present = iocount ? true : false;
-        PIO_Offset *amsg_iostart = NULL, *amsg_iocount = NULL;
-
-        if(!iostart_present)
-        {
-            amsg_iostart = calloc(ndims, sizeof(PIO_Offset));
-        }
-        if(!iocount_present)
-        {
-            amsg_iocount = calloc(ndims, sizeof(PIO_Offset));
-        }
-        if(!amsg_iostart || !amsg_iocount)
-        {
-            return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
-                            "Initializing the PIO decomposition failed. Out of memory allocating %lld bytes for start array and %lld bytes for count array for sending asynchronous message, PIO_MSG_INITDECOMP_DOF, on iosystem (iosysid=%d)", (unsigned long long) (ndims * sizeof(PIO_Offset)), (unsigned long long) (ndims * sizeof(PIO_Offset)), ios->iosysid);
-        }
+        return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
+                        "Initializing the PIO decomposition failed. Out of memory allocating %lld bytes for start array and %lld bytes for count array for sending asynchronous message, PIO_MSG_INITDECOMP_DOF, on iosystem (iosysid=%d)", (unsigned long long) (ndims * sizeof(PIO_Offset)), (unsigned long long) (ndims * sizeof(PIO_Offset)), ios->iosysid);
+    }
 
-        PIO_SEND_ASYNC_MSG(ios, msg, &ierr, iosysid, pio_type, ndims,
-            gdimlen, maplen, compmap, rearranger_present, amsg_rearranger,
-            iostart_present, ndims,
-            (iostart_present) ? iostart : amsg_iostart,
-            iocount_present, ndims,
-            (iocount_present) ? iocount : amsg_iocount);
+    PIO_SEND_ASYNC_MSG(ios, msg, &ierr, ios->iosysid, pio_type, ndims,
+        gdimlen, maplen, compmap, rearranger_present, amsg_rearranger,
+        iostart_present, ndims,
+        (iostart_present) ? iostart : amsg_iostart,
+        iocount_present, ndims,
+        (iocount_present) ? iocount : amsg_iocount);
 
-        if(!iostart_present)
-        {
-            free(amsg_iostart);
-        }
-        if(!iocount_present)
-        {
-            free(amsg_iocount);
-        }
+    if(!iostart_present)
+    {
+        free(amsg_iostart);
+    }
+    if(!iocount_present)
+    {
+        free(amsg_iocount);
     }
 
-    /* Allocate space for the iodesc info. This also allocates the
-     * first region and copies the rearranger opts into this
-     * iodesc. */
-    if ((ierr = malloc_iodesc(ios, pio_type, ndims, &iodesc)))
+    if(ierr != PIO_NOERR)
     {
         return pio_err(ios, NULL, ierr, __FILE__, __LINE__,
-                        "Initializing the PIO decomposition failed. Out of memory allocating memory for I/O descriptor");
+                        "Initializing the PIO decomposition failed. Error sending async msg PIO_MSG_INITDECOMP_DOF (iosysid=%d)", ios->iosysid);
     }
 
-    /* Remember the maplen. */
-    iodesc->maplen = maplen;
+    return PIO_NOERR;
+}
 
-    /* Remember the map. */
-    if (!(iodesc->map = malloc(sizeof(PIO_Offset) * maplen)))
-    {
-        return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
-                        "Initializing the PIO decomposition failed. Out of memory allocating %lld bytes to store I/O decomposition map", (unsigned long long) (sizeof(PIO_Offset) * maplen));
-    }
-    for (int m = 0; m < maplen; m++)
-        iodesc->map[m] = compmap[m];
+/**
+ * Set up the rearranger of a decomposition from its map, and add the
+ * decomposition to the list of open decompositions. This is the part
+ * of PIOc_InitDecomp() and PIOc_InitDecomp_ranges() after the map is
+ * stored as ranges in the iodesc; the rearranger setup walks the
+ * ranges of the map.
+ *
+ * @param ios pointer to the iosystem_desc_t struct.
+ * @param iodesc pointer to the io_desc_t struct, with the map set.
+ * @param pio_type the basic PIO data type used.
+ * @param ndims the number of dimensions in the variable, not
+ * including the unlimited dimension.
+ * @param gdimlen an array length ndims with the sizes of the global
+ * dimensions.
+ * @param ioidp pointer that will get the io description ID.
+ * @param rearranger pointer to the rearranger to be used for this
+ * decomp or NULL to use the default.
+ * @param iostart An array of start values, or NULL.
+ * @param iocount An array of count values, or NULL.
+ * @returns 0 on success, error code otherwise
+ */
+static int init_decomp_rearranger(iosystem_desc_t *ios, io_desc_t *iodesc, int pio_type,
+                                  int ndims, const int *gdimlen, int *ioidp,
+                                  const int *rearranger, const PIO_Offset *iostart,
+                                  const PIO_Offset *iocount)
+{
+    int mpierr = MPI_SUCCESS;  /* Return code from MPI function calls. */
+    int ierr;              /* Return code. */
 
     /* Remember the dim sizes. */
     if (!(iodesc->dimlen = malloc(sizeof(int) * ndims)))
@@ -634,6 +886,19 @@ int PIOc_InitDecomp(int iosysid, int pio_type, int ndims, const int *gdimlen, in
         iodesc->rearranger = ios->default_rearranger;
     else
         iodesc->rearranger = *rearranger;
+
+    /* Choose the rearranger from the map. */
+    if (iodesc->rearranger == PIO_REARR_AUTO)
+    {
+        if ((ierr = choose_rearranger(ios, pio_type, ndims, gdimlen, iodesc->map_nranges,
+                                      iodesc->map_start, iodesc->map_count, iostart,
+                                      iocount, &iodesc->rearranger)))
+        {
+            return pio_err(ios, NULL, ierr, __FILE__, __LINE__,
+                            "Initializing the PIO decomposition failed. Choosing the rearranger for the decomposition failed");
+        }
+        iodesc->rearr_auto = true;
+    }
     LOG((2, "iodesc->rearranger = %d", iodesc->rearranger));
 
     /* Is this the subset rearranger? */
@@ -642,8 +907,7 @@ int PIOc_InitDecomp(int iosysid, int pio_type, int ndims, const int *gdimlen, in
         iodesc->num_aiotasks = ios->num_iotasks;
         LOG((2, "creating subset rearranger iodesc->num_aiotasks = %d",
              iodesc->num_aiotasks));
-        if ((ierr = subset_rearrange_create(ios, maplen, (PIO_Offset *)compmap, gdimlen,
-                                            ndims, iodesc)))
+        if ((ierr = subset_rearrange_create(ios, gdimlen, ndims, iodesc)))
         {
             return pio_err(ios, NULL, ierr, __FILE__, __LINE__,
                             "Initializing the PIO decomposition failed. Error creating the SUBSET rearranger");
@@ -660,18 +924,24 @@ int PIOc_InitDecomp(int iosysid, int pio_type, int ndims, const int *gdimlen, in
                 LOG((3, "iostart and iocount provided"));
                 for (int i = 0; i < ndims; i++)
                 {
-                    iodesc->firstregion->start[i] = iostart[i];
-                    iodesc->firstregion->count[i] = iocount[i];
+                    REGION_START(iodesc->regions, 0)[i] = iostart[i];
+                    REGION_COUNT(iodesc->regions, 0)[i] = iocount[i];
                 }
                 iodesc->num_aiotasks = ios->num_iotasks;
             }
             else
             {
+                PIO_Offset stripe_size;
+
+                if ((ierr = get_box_stripe_size(ios, &stripe_size)))
+                    return pio_err(ios, NULL, ierr, __FILE__, __LINE__,
+                                    "Initializing the PIO decomposition failed. Getting the stripe size for the decomposition failed");
+
                 /* Compute start and count values for each io task. */
                 LOG((2, "about to call CalcStartandCount pio_type = %d ndims = %d", pio_type, ndims));
                 if ((ierr = CalcStartandCount(pio_type, ndims, gdimlen, ios->num_iotasks,
-                                             ios->io_rank, iodesc->firstregion->start,
-                                             iodesc->firstregion->count, &iodesc->num_aiotasks)))
+                                             ios->io_rank, stripe_size, REGION_START(iodesc->regions, 0),
+                                             REGION_COUNT(iodesc->regions, 0), &iodesc->num_aiotasks)))
                 {
                     return pio_err(ios, NULL, ierr, __FILE__, __LINE__,
                                     "Initializing the PIO decomposition failed. Internal error calculating start/count for the decomposition");
@@ -697,68 +967,190 @@ int PIOc_InitDecomp(int iosysid, int pio_type, int ndims, const int *gdimlen, in
 
         /* Compute the communications pattern for this decomposition. */
         if (iodesc->rearranger == PIO_REARR_BOX)
-            if ((ierr = box_rearrange_create(ios, maplen, compmap, gdimlen, ndims, iodesc)))
+            if ((ierr = box_rearrange_create(ios, gdimlen, ndims, iodesc)))
             {
                 return pio_err(ios, NULL, ierr, __FILE__, __LINE__,
                                 "Error initializing the PIO decomposition. Error creating the BOX rearranger");
             }
     }
 
-    /* Add this IO description to the list. */
-    MPI_Comm comm = MPI_COMM_NULL;
-#ifdef _ADIOS2
-    comm = ios->union_comm;
+    /* Account the memory of the rearranger. */
+    if ((ierr = update_rearr_mem(ios, iodesc)))
+    {
+        return pio_err(ios, NULL, ierr, __FILE__, __LINE__,
+                        "Initializing the PIO decomposition failed. Internal error counting the memory of the rearranger");
+    }
+
+    /* Add this IO description to the list. */
+    MPI_Comm comm = MPI_COMM_NULL;
+#ifdef _ADIOS2
+    comm = ios->union_comm;
+#endif
+    if(ios->async)
+    {
+        /* For asynchronous I/O service, the iodescs (iodesc ids) need to
+         * be unique across the union_comm (union of I/O and compute comms)
+         */
+        comm = ios->union_comm;
+    }
+    *ioidp = pio_add_to_iodesc_list(iodesc, comm);
+
+    /* Check whether we have exceeded the maximum number of ioids (PIO_IODESC_MAX_IDS).
+     * This limit is necessary since each file uses a sparse pointer array (with a fixed
+     * size of PIO_IODESC_MAX_IDS) to look up a data buffer per ioid.
+     * FIXME: Replace the sparse array with a map or hash map to get rid of this limit
+     */
+    if (*ioidp - PIO_IODESC_START_ID + 1 > PIO_IODESC_MAX_IDS)
+    {
+        return pio_err(ios, NULL, PIO_EINTERNAL, __FILE__, __LINE__,
+                       "Initializing the PIO decomposition failed. Maximum number of ioids (limit = %d) has been reached", PIO_IODESC_MAX_IDS);
+    }
+
+#if PIO_SAVE_DECOMPS
+    if(pio_save_decomps_regex_match(*ioidp, NULL, NULL))
+    {
+        char filename[PIO_MAX_NAME];
+        ierr = pio_create_uniq_str(ios, iodesc, filename, PIO_MAX_NAME, "piodecomp", ".dat");
+        if(ierr != PIO_NOERR)
+        {
+            return pio_err(ios, NULL, ierr, __FILE__, __LINE__,
+                            "Initializing the PIO decomposition failed. Creating a unique file name for saving the decomposition failed");
+        }
+        LOG((2, "Saving decomp map to %s", filename));
+        PIOc_write_decomp(filename, ios->iosysid, *ioidp, ios->my_comm);
+        iodesc->is_saved = true;
+    }
+#endif
+
+#if PIO_ENABLE_LOGGING
+    /* Log results. */
+    LOG((2, "iodesc ioid = %d nrecvs = %d ndof = %d ndims = %d num_aiotasks = %d "
+         "rearranger = %d maxregions = %d needsfill = %d llen = %d maxiobuflen  = %d",
+         iodesc->ioid, iodesc->nrecvs, iodesc->ndof, iodesc->ndims, iodesc->num_aiotasks,
+         iodesc->rearranger, iodesc->maxregions, iodesc->needsfill, iodesc->llen,
+         iodesc->maxiobuflen));
+    for (int j = 0; j < iodesc->llen; j++)
+        LOG((3, "rindex[%d] = %d", j, iodesc->rindex[j]));
+#endif /* PIO_ENABLE_LOGGING */            
+
+    /* Tune the rearranger options, if enabled for the IO system. */
+    if ((ierr = performance_tune_rearranger(ios, iodesc)))
+    {
+        return pio_err(ios, NULL, ierr, __FILE__, __LINE__,
+                        "Initializing the PIO decomposition failed. Tuning the rearranger options of the decomposition failed");
+    }
+
+    return PIO_NOERR;
+}
+
+/**
+ * Initialize the decomposition used with distributed arrays. The
+ * decomposition describes how the data will be distributed between
+ * tasks.
+ *
+ * Internally, this function will:
+ * <ul>
+ * <li>Allocate and initialize an iodesc struct for this
+ * decomposition. (This also allocates the region table, with an empty
+ * first region.)
+ * <li>(Box rearranger only) If iostart or iocount are NULL, call
+ * CalcStartandCount() to determine starts/counts. Then call
+ * compute_maxIObuffersize() to compute the max IO buffer size needed.
+ * <li>Create the rearranger.
+ * <li>Assign an ioid and add this decomposition to the list of open
+ * decompositions.
+ * </ul>
+ *
+ * @param iosysid the IO system ID.
+ * @param pio_type the basic PIO data type used.
+ * @param ndims the number of dimensions in the variable, not
+ * including the unlimited dimension.
+ * @param gdimlen an array length ndims with the sizes of the global
+ * dimensions.
+ * @param maplen the local length of the compmap array.
+ * @param compmap a 1 based array of offsets into the array record on
+ * file. A 0 in this array indicates a value which should not be
+ * transfered.
+ * @param ioidp pointer that will get the io description ID.
+ * @param rearranger pointer to the rearranger to be used for this
+ * decomp or NULL to use the default. With PIO_REARR_AUTO the box or
+ * subset rearranger is chosen from estimates of the costs of both
+ * (see choose_rearranger()).
+ * @param iostart An array of start values for block cyclic
+ * decompositions for the SUBSET rearranger. Ignored if block
+ * rearranger is used. If NULL and SUBSET rearranger is used, the
+ * iostarts are generated.
+ * @param iocount An array of count values for block cyclic
+ * decompositions for the SUBSET rearranger. Ignored if block
+ * rearranger is used. If NULL and SUBSET rearranger is used, the
+ * iostarts are generated.
+ * @returns 0 on success, error code otherwise
+ * @ingroup PIO_initdecomp
+ * @author Jim Edwards, Ed Hartnett
+ */
+int PIOc_InitDecomp(int iosysid, int pio_type, int ndims, const int *gdimlen, int maplen,
+                    const PIO_Offset *compmap, int *ioidp, const int *rearranger,
+                    const PIO_Offset *iostart, const PIO_Offset *iocount)
+{
+    iosystem_desc_t *ios;  /* Pointer to io system information. */
+    io_desc_t *iodesc;     /* The IO description. */
+    int ierr;              /* Return code. */
+
+#ifdef TIMING
+    GPTLstart("PIO:PIOc_initdecomp");
 #endif
-    if(ios->async)
+    LOG((1, "PIOc_InitDecomp iosysid = %d pio_type = %d ndims = %d maplen = %d",
+         iosysid, pio_type, ndims, maplen));
+
+    /* Get IO system info. */
+    if (!(ios = pio_get_iosystem_from_id(iosysid)))
     {
-        /* For asynchronous I/O service, the iodescs (iodesc ids) need to
-         * be unique across the union_comm (union of I/O and compute comms)
-         */
-        comm = ios->union_comm;
+        return pio_err(NULL, NULL, PIO_EBADID, __FILE__, __LINE__,
+                        "Initializing the PIO decomposition failed. Invalid io system id (%d) provided. Could not find an iosystem associated with the id", iosysid);
     }
-    *ioidp = pio_add_to_iodesc_list(iodesc, comm);
 
-    /* Check whether we have exceeded the maximum number of ioids (PIO_IODESC_MAX_IDS).
-     * This limit is necessary since each file uses a sparse pointer array (with a fixed
-     * size of PIO_IODESC_MAX_IDS) to look up a data buffer per ioid.
-     * FIXME: Replace the sparse array with a map or hash map to get rid of this limit
-     */
-    if (*ioidp - PIO_IODESC_START_ID + 1 > PIO_IODESC_MAX_IDS)
+    /* Caller must provide these. */
+    if (!gdimlen || !compmap || !ioidp)
     {
-        return pio_err(ios, NULL, PIO_EINTERNAL, __FILE__, __LINE__,
-                       "Initializing the PIO decomposition failed. Maximum number of ioids (limit = %d) has been reached", PIO_IODESC_MAX_IDS);
+        return pio_err(ios, NULL, PIO_EINVAL, __FILE__, __LINE__,
+                        "Initializing the PIO decomposition failed. Invalid pointers (NULL) to gdimlen(%s) or compmap(%s) or ioidp (%s) provided", (gdimlen) ? "not NULL" : "NULL", (compmap) ? "not NULL" : "NULL", (ioidp) ? "not NULL" : "NULL");
     }
 
-#if PIO_SAVE_DECOMPS
-    if(pio_save_decomps_regex_match(*ioidp, NULL, NULL))
-    {
-        char filename[PIO_MAX_NAME];
-        ierr = pio_create_uniq_str(ios, iodesc, filename, PIO_MAX_NAME, "piodecomp", ".dat");
-        if(ierr != PIO_NOERR)
+    /* Check the dim lengths. */
+    for (int i = 0; i < ndims; i++)
+        if (gdimlen[i] <= 0)
         {
-            return pio_err(ios, NULL, ierr, __FILE__, __LINE__,
-                            "Initializing the PIO decomposition failed. Creating a unique file name for saving the decomposition failed");
+            return pio_err(ios, NULL, PIO_EINVAL, __FILE__, __LINE__,
+                            "Initializing the PIO decomposition failed. Invalid value for global dimension lengths provided. The global length of dimension %d is provided as %d (expected > 0)", i, gdimlen[i]);
         }
-        LOG((2, "Saving decomp map to %s", filename));
-        PIOc_writemap(filename, *ioidp, ndims, gdimlen, maplen, (PIO_Offset *)compmap, ios->my_comm);
-        iodesc->is_saved = true;
+
+    /* If async is in use, and this is not an IO task, bcast the parameters. */
+    if (ios->async)
+        if ((ierr = send_initdecomp_msg(ios, pio_type, ndims, gdimlen, maplen, compmap,
+                                        rearranger, iostart, iocount)))
+            return ierr;
+
+    /* Allocate space for the iodesc info. This also allocates the
+     * first region and copies the rearranger opts into this
+     * iodesc. */
+    if ((ierr = malloc_iodesc(ios, pio_type, ndims, &iodesc)))
+    {
+        return pio_err(ios, NULL, ierr, __FILE__, __LINE__,
+                        "Initializing the PIO decomposition failed. Out of memory allocating memory for I/O descriptor");
     }
-#endif
 
-#if PIO_ENABLE_LOGGING
-    /* Log results. */
-    LOG((2, "iodesc ioid = %d nrecvs = %d ndof = %d ndims = %d num_aiotasks = %d "
-         "rearranger = %d maxregions = %d needsfill = %d llen = %d maxiobuflen  = %d",
-         iodesc->ioid, iodesc->nrecvs, iodesc->ndof, iodesc->ndims, iodesc->num_aiotasks,
-         iodesc->rearranger, iodesc->maxregions, iodesc->needsfill, iodesc->llen,
-         iodesc->maxiobuflen));
-    for (int j = 0; j < iodesc->llen; j++)
-        LOG((3, "rindex[%d] = %lld", j, iodesc->rindex[j]));
-#endif /* PIO_ENABLE_LOGGING */            
+    /* Remember the map, as ranges of consecutive mappings. The
+     * rearranger is set up from the ranges. */
+    if ((ierr = set_iodesc_map(ios, iodesc, maplen, compmap)))
+    {
+        return pio_err(ios, NULL, ierr, __FILE__, __LINE__,
+                        "Initializing the PIO decomposition failed. Storing the I/O decomposition map failed");
+    }
 
-    /* This function only does something if pre-processor macro
-     * PERFTUNE is set. */
-    performance_tune_rearranger(ios, iodesc);
+    /* Create the rearranger and add the decomposition to the list. */
+    if ((ierr = init_decomp_rearranger(ios, iodesc, pio_type, ndims, gdimlen, ioidp,
+                                       rearranger, iostart, iocount)))
+        return ierr;
 
 #ifdef TIMING
     GPTLstop("PIO:PIOc_initdecomp");
@@ -783,8 +1175,8 @@ int PIOc_InitDecomp(int iosysid, int pio_type, int ndims, const int *gdimlen, in
  * transfered.
  * @param ioidp pointer that will get the io description ID.
  * @param rearranger the rearranger to be used for this decomp or 0 to
- * use the default. Valid rearrangers are PIO_REARR_BOX and
- * PIO_REARR_SUBSET.
+ * use the default. Valid rearrangers are PIO_REARR_BOX,
+ * PIO_REARR_SUBSET and PIO_REARR_AUTO.
  * @param iostart An array of start values for block cyclic
  * decompositions. If NULL ???
  * @param iocount An array of count values for block cyclic
@@ -819,10 +1211,229 @@ int PIOc_init_decomp(int iosysid, int pio_type, int ndims, const int *gdimlen, i
                            ioidp, rearrangerp, iostart, iocount);
 }
 
+/**
+ * Initialize the decomposition used with distributed arrays from a
+ * map of int (32-bit) offsets. This is the same as PIOc_InitDecomp(),
+ * for callers (like the Fortran PIO_initdecomp with an integer(i4)
+ * compdof) that keep their map in 32-bit integers. The runs of
+ * consecutive offsets of the map are passed to
+ * PIOc_InitDecomp_ranges(), so no 64-bit copy of the map is made.
+ *
+ * @param iosysid the IO system ID.
+ * @param pio_type the basic PIO data type used.
+ * @param ndims the number of dimensions in the variable, not
+ * including the unlimited dimension.
+ * @param gdimlen an array length ndims with the sizes of the global
+ * dimensions.
+ * @param maplen the local length of the compmap array.
+ * @param compmap a 1 based array of offsets into the array record on
+ * file. A 0 in this array indicates a value which should not be
+ * transfered.
+ * @param ioidp pointer that will get the io description ID.
+ * @param rearranger pointer to the rearranger to be used for this
+ * decomp or NULL to use the default.
+ * @param iostart An array of start values for block cyclic
+ * decompositions for the SUBSET rearranger, or NULL.
+ * @param iocount An array of count values for block cyclic
+ * decompositions for the SUBSET rearranger, or NULL.
+ * @returns 0 on success, error code otherwise
+ * @ingroup PIO_initdecomp
+ */
+int PIOc_InitDecomp_i4(int iosysid, int pio_type, int ndims, const int *gdimlen, int maplen,
+                       const int *compmap, int *ioidp, const int *rearranger,
+                       const PIO_Offset *iostart, const PIO_Offset *iocount)
+{
+    iosystem_desc_t *ios;
+    PIO_Offset *rstart;
+    PIO_Offset *rcount;
+    int nranges = 0;
+    int r = -1;
+    int ierr;
+
+    LOG((1, "PIOc_InitDecomp_i4 iosysid = %d pio_type = %d ndims = %d maplen = %d",
+         iosysid, pio_type, ndims, maplen));
+
+    /* Get the info about the io system. */
+    if (!(ios = pio_get_iosystem_from_id(iosysid)))
+    {
+        return pio_err(NULL, NULL, PIO_EBADID, __FILE__, __LINE__,
+                        "Initializing the PIO decomposition failed. Invalid io system id (%d) provided", iosysid);
+    }
+
+    /* Caller must provide these. */
+    if (!compmap || maplen < 0)
+    {
+        return pio_err(ios, NULL, PIO_EINVAL, __FILE__, __LINE__,
+                        "Initializing the PIO decomposition failed. Invalid arguments provided, compmap is %s (expected not NULL), maplen = %d (expected >= 0)", (compmap) ? "not NULL" : "NULL", maplen);
+    }
+
+    /* Count the runs of consecutive mappings. Holes (mappings <= 0)
+     * form runs of their own. */
+    for (int m = 0; m < maplen; m++)
+        if (!m || (compmap[m - 1] > 0 && compmap[m] != compmap[m - 1] + 1) ||
+            (compmap[m - 1] <= 0 && compmap[m] > 0))
+            nranges++;
+
+    if (!(rstart = malloc(sizeof(PIO_Offset) * max(nranges, 1))) ||
+        !(rcount = malloc(sizeof(PIO_Offset) * max(nranges, 1))))
+    {
+        free(rstart);
+        return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
+                        "Initializing the PIO decomposition failed. Out of memory allocating %lld bytes for %d ranges of the decomposition map", (long long)(2 * sizeof(PIO_Offset) * nranges), nranges);
+    }
+
+    for (int m = 0; m < maplen; m++)
+    {
+        if (!m || (compmap[m - 1] > 0 && compmap[m] != compmap[m - 1] + 1) ||
+            (compmap[m - 1] <= 0 && compmap[m] > 0))
+        {
+            r++;
+            rstart[r] = max(compmap[m], 0);
+            rcount[r] = 0;
+        }
+        rcount[r]++;
+    }
+
+    ierr = PIOc_InitDecomp_ranges(iosysid, pio_type, ndims, gdimlen, nranges, rstart, rcount,
+                                  ioidp, rearranger, iostart, iocount);
+    free(rstart);
+    free(rcount);
+
+    return ierr;
+}
+
+/**
+ * Initialize the decomposition used with distributed arrays from
+ * ranges of consecutive elements of the global array. This is the
+ * same as PIOc_InitDecomp() with a compmap that has rcount[r]
+ * consecutive mappings rstart[r], rstart[r] + 1, ... for each range.
+ * The ranges are kept in the decomposition and the rearranger is set
+ * up from them, without expanding them into a map of one mapping per
+ * element.
+ *
+ * @param iosysid the IO system ID.
+ * @param pio_type the basic PIO data type used.
+ * @param ndims the number of dimensions in the variable, not
+ * including the unlimited dimension.
+ * @param gdimlen an array length ndims with the sizes of the global
+ * dimensions.
+ * @param nranges the number of ranges on this task.
+ * @param rstart an array of length nranges with the 1-based position
+ * in the global array of the first element of each range. A range
+ * with a start of 0 is rcount[r] holes.
+ * @param rcount an array of length nranges with the number of
+ * elements of each range.
+ * @param ioidp pointer that will get the io description ID.
+ * @param rearranger pointer to the rearranger to be used for this
+ * decomp or NULL to use the default.
+ * @param iostart An array of start values for block cyclic
+ * decompositions for the SUBSET rearranger, or NULL.
+ * @param iocount An array of count values for block cyclic
+ * decompositions for the SUBSET rearranger, or NULL.
+ * @returns 0 on success, error code otherwise
+ * @ingroup PIO_initdecomp
+ */
+int PIOc_InitDecomp_ranges(int iosysid, int pio_type, int ndims, const int *gdimlen,
+                           int nranges, const PIO_Offset *rstart, const PIO_Offset *rcount,
+                           int *ioidp, const int *rearranger, const PIO_Offset *iostart,
+                           const PIO_Offset *iocount)
+{
+    iosystem_desc_t *ios;
+    io_desc_t *iodesc;
+    PIO_Offset maplen = 0;
+    PIO_Offset gsize = 1;
+    int ierr;
+
+#ifdef TIMING
+    GPTLstart("PIO:PIOc_initdecomp_ranges");
+#endif
+    LOG((1, "PIOc_InitDecomp_ranges iosysid = %d pio_type = %d ndims = %d nranges = %d",
+         iosysid, pio_type, ndims, nranges));
+
+    /* Get the info about the io system. */
+    if (!(ios = pio_get_iosystem_from_id(iosysid)))
+    {
+        return pio_err(NULL, NULL, PIO_EBADID, __FILE__, __LINE__,
+                        "Initializing the PIO decomposition failed. Invalid io system id (%d) provided", iosysid);
+    }
+
+    /* Check for required inputs. */
+    if (!gdimlen || nranges < 0 || (nranges && (!rstart || !rcount)) || !ioidp)
+    {
+        return pio_err(ios, NULL, PIO_EINVAL, __FILE__, __LINE__,
+                        "Initializing the PIO decomposition failed. Invalid arguments provided, gdimlen is %s (expected not NULL), nranges = %d (expected >= 0), rstart is %s, rcount is %s (expected not NULL), ioidp is %s (expected not NULL)", (gdimlen) ? "not NULL" : "NULL", nranges, (rstart) ? "not NULL" : "NULL", (rcount) ? "not NULL" : "NULL", (ioidp) ? "not NULL" : "NULL");
+    }
+
+    /* Check the dim lengths. */
+    for (int i = 0; i < ndims; i++)
+    {
+        if (gdimlen[i] <= 0)
+        {
+            return pio_err(ios, NULL, PIO_EINVAL, __FILE__, __LINE__,
+                            "Initializing the PIO decomposition failed. Invalid value for global dimension lengths provided. The global length of dimension %d is provided as %d (expected > 0)", i, gdimlen[i]);
+        }
+        gsize *= gdimlen[i];
+    }
+
+    /* The ranges must be inside the global array, and the map must
+     * fit the int maplen of the decomposition. */
+    for (int r = 0; r < nranges; r++)
+    {
+        if (rstart[r] < 0 || rcount[r] < 0 || (rstart[r] > 0 && rstart[r] + rcount[r] - 1 > gsize))
+        {
+            return pio_err(ios, NULL, PIO_EINVAL, __FILE__, __LINE__,
+                            "Initializing the PIO decomposition failed. Invalid range %d provided : rstart = %lld (expected >= 0), rcount = %lld (expected >= 0), last element = %lld (expected <= %lld)", r, (long long)rstart[r], (long long)rcount[r], (long long)(rstart[r] + rcount[r] - 1), (long long)gsize);
+        }
+        maplen += rcount[r];
+    }
+    if (maplen > INT_MAX)
+    {
+        return pio_err(ios, NULL, PIO_EINVAL, __FILE__, __LINE__,
+                        "Initializing the PIO decomposition failed. The ranges have %lld elements (expected <= %d)", (long long)maplen, INT_MAX);
+    }
+
+    /* If async is in use, and this is not an IO task, bcast the
+     * parameters. The IO tasks ignore the map, so a single hole is
+     * sent in place of the map. */
+    if (ios->async)
+    {
+        PIO_Offset hole = 0;
+
+        if ((ierr = send_initdecomp_msg(ios, pio_type, ndims, gdimlen, 1, &hole, rearranger,
+                                        iostart, iocount)))
+            return ierr;
+    }
+
+    /* Allocate space for the iodesc info. */
+    if ((ierr = malloc_iodesc(ios, pio_type, ndims, &iodesc)))
+    {
+        return pio_err(ios, NULL, ierr, __FILE__, __LINE__,
+                        "Initializing the PIO decomposition failed. Out of memory allocating memory for I/O descriptor");
+    }
+
+    /* Remember the ranges as the map. */
+    if ((ierr = set_iodesc_ranges(ios, iodesc, nranges, rstart, rcount)))
+    {
+        return pio_err(ios, NULL, ierr, __FILE__, __LINE__,
+                        "Initializing the PIO decomposition failed. Storing the I/O decomposition map failed");
+    }
+
+    /* Create the rearranger and add the decomposition to the list. */
+    if ((ierr = init_decomp_rearranger(ios, iodesc, pio_type, ndims, gdimlen, ioidp,
+                                       rearranger, iostart, iocount)))
+        return ierr;
+
+#ifdef TIMING
+    GPTLstop("PIO:PIOc_initdecomp_ranges");
+#endif
+    return PIO_NOERR;
+}
+
 /**
  * This is a simplified initdecomp which can be used if the memory
  * order of the data can be expressed in terms of start and count on
- * the file. In this case we compute the compdof.
+ * the file. In this case each row of the fastest varying dimension is
+ * a range of the map (see PIOc_InitDecomp_ranges()).
  *
  * @param iosysid the IO system ID
  * @param pio_type
@@ -841,11 +1452,13 @@ int PIOc_InitDecomp_bc(int iosysid, int pio_type, int ndims, const int *gdimlen,
 
 {
     iosystem_desc_t *ios;
-    int n, i, maplen = 1;
+    int n, i, nranges = 1;
     PIO_Offset prod[ndims], loc[ndims];
+    PIO_Offset *rstart, *rcount;
     int rearr = PIO_REARR_SUBSET;
+    int ierr;
 
-    LOG((1, "PIOc_InitDecomp_bc iosysid = %d pio_type = %d ndims = %d"));
+    LOG((1, "PIOc_InitDecomp_bc iosysid = %d pio_type = %d ndims = %d", iosysid, pio_type, ndims));
 
     /* Get the info about the io system. */
     if (!(ios = pio_get_iosystem_from_id(iosysid)))
@@ -870,14 +1483,22 @@ int PIOc_InitDecomp_bc(int iosysid, int pio_type, int ndims, const int *gdimlen,
                             "Initializing the PIO decomposition failed. Invalid arguments provided : gdimlen[%d]=%d (expected > 0), start[%d]=%ld (expected >= 0), count[%d]=%ld (expected >= 0), start[%d] + count[%d] = %ld (expected <= gdimlen[%d])", i, gdimlen[i], i, start[i], i, count[i], i, i, start[i]+count[i], i);
         }
 
-    /* Find the maplen. */
-    for (i = 0; i < ndims; i++)
-        maplen *= count[i];
+    /* Find the number of ranges, one per row of the fastest varying
+     * dimension. */
+    for (i = 0; i < ndims - 1; i++)
+        nranges *= count[i];
+    if (ndims > 0 && !count[ndims - 1])
+        nranges = 0;
 
-    /* Get storage for the compmap. */
-    PIO_Offset compmap[maplen];
+    if (!(rstart = malloc(sizeof(PIO_Offset) * max(nranges, 1))) ||
+        !(rcount = malloc(sizeof(PIO_Offset) * max(nranges, 1))))
+    {
+        free(rstart);
+        return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
+                        "Initializing the PIO decomposition failed. Out of memory allocating %lld bytes for %d ranges of the decomposition map", (long long)(2 * sizeof(PIO_Offset) * nranges), nranges);
+    }
 
-    /* Find the compmap. */
+    /* Find the ranges. */
     prod[ndims - 1] = 1;
     loc[ndims - 1] = 0;
     for (n = ndims - 2; n >= 0; n--)
@@ -885,23 +1506,29 @@ int PIOc_InitDecomp_bc(int iosysid, int pio_type, int ndims, const int *gdimlen,
         prod[n] = prod[n + 1] * gdimlen[n + 1];
         loc[n] = 0;
     }
-    for (i = 0; i < maplen; i++)
+    for (i = 0; i < nranges; i++)
     {
-        compmap[i] = 1;
+        rstart[i] = 1;
         for (n = ndims - 1; n >= 0; n--)
-            compmap[i] += (start[n] + loc[n]) * prod[n];
+            rstart[i] += (start[n] + loc[n]) * prod[n];
+        rcount[i] = count[ndims - 1];
 
-        n = ndims - 1;
-        loc[n] = (loc[n] + 1) % count[n];
-        while (loc[n] == 0 && n > 0)
+        n = ndims - 2;
+        while (n >= 0)
         {
-            n--;
             loc[n] = (loc[n] + 1) % count[n];
+            if (loc[n])
+                break;
+            n--;
         }
     }
 
-    return PIOc_InitDecomp(iosysid, pio_type, ndims, gdimlen, maplen, compmap, ioidp,
-                           &rearr, NULL, NULL);
+    ierr = PIOc_InitDecomp_ranges(iosysid, pio_type, ndims, gdimlen, nranges, rstart, rcount,
+                                  ioidp, &rearr, NULL, NULL);
+    free(rstart);
+    free(rcount);
+
+    return ierr;
 }
 
 #ifdef _ADIOS2
@@ -939,7 +1566,7 @@ unsigned long get_adios2_io_cnt()
  * <li>On IO tasks, create an IO communicator (ios->io_comm).
  * <li>Assign an iosystemid, and put this iosystem_desc_t into the
  * list of open iosystems.
- * <li>Initialize the bget buffer, unless PIO_USE_MALLOC was used.
+ * <li>Create the arena of the buffers of the IO system.
  * </ul>
  *
  * When complete, there are three MPI communicators (ios->comp_comm,
@@ -954,6 +1581,11 @@ unsigned long get_adios2_io_cnt()
  * overriden in the PIO_init_decomp(). The rearranger is not used
  * until the decomposition is initialized.
  * @param iosysidp index of the defined system descriptor.
+ *
+ * If PIO_IOTASK_PLACEMENT_NODE was set with
+ * PIOc_set_iotask_placement() the base and stride are ignored and the
+ * IO tasks are spread evenly across the compute nodes instead.
+ *
  * @return 0 on success, otherwise a PIO error code.
  * @ingroup PIO_init
  * @author Jim Edwards, Ed Hartnett
@@ -964,6 +1596,8 @@ int PIOc_Init_Intracomm(MPI_Comm comp_comm, int num_iotasks, int stride, int bas
     iosystem_desc_t *ios;
     int ustride;
     int num_comptasks; /* The size of the comp_comm. */
+    int placement;     /* The placement of the IO tasks. */
+    int niotasks_per_node; /* Number of IO tasks per node, for node placement. */
     int mpierr;        /* Return value for MPI calls. */
     int ret;           /* Return code for function calls. */
 
@@ -1016,6 +1650,8 @@ int PIOc_Init_Intracomm(MPI_Comm comp_comm, int num_iotasks, int stride, int bas
 
     ios->io_comm = MPI_COMM_NULL;
     ios->intercomm = MPI_COMM_NULL;
+    ios->node_comm = MPI_COMM_NULL;
+    ios->node_roots_comm = MPI_COMM_NULL;
     ios->error_handler = default_error_handler;
     ios->default_rearranger = rearr;
     ios->num_iotasks = num_iotasks;
@@ -1072,17 +1708,38 @@ int PIOc_Init_Intracomm(MPI_Comm comp_comm, int num_iotasks, int stride, int bas
 
     /* Create an array that holds the ranks of the tasks to be used
      * for IO. */
-    if (!(ios->ioranks = calloc(ios->num_iotasks, sizeof(int))))
-    {
-        return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
-                        "PIO Init failed. Out of memory allocating %lld bytes for array of I/O process ranks in the I/O descriptor", (unsigned long long) (ios->num_iotasks * sizeof(int)));
+    if ((ret = pio_get_iotask_placement(&placement, &niotasks_per_node)))
+        return pio_err(ios, NULL, ret, __FILE__, __LINE__,
+                        "PIO Init failed. Getting the placement of I/O tasks failed");
+    if (placement == PIO_IOTASK_PLACEMENT_NODE)
+    {
+        /* Spread the IO tasks evenly across the compute nodes, the
+         * base and stride are ignored */
+        if ((ret = pio_get_node_ioranks(ios->comp_comm, num_iotasks, niotasks_per_node,
+                                        &ios->num_iotasks, &ios->ioranks)))
+            return pio_err(ios, NULL, ret, __FILE__, __LINE__,
+                            "PIO Init failed. Finding node topology aware I/O tasks failed");
+        for (int i = 0; i < ios->num_iotasks; i++)
+        {
+            if (ios->ioranks[i] == ios->comp_rank)
+                ios->ioproc = true;
+            LOG((3, "ios->ioranks[%d] = %d", i, ios->ioranks[i]));
+        }
     }
-    for (int i = 0; i < ios->num_iotasks; i++)
+    else
     {
-        ios->ioranks[i] = (base + i * ustride) % ios->num_comptasks;
-        if (ios->ioranks[i] == ios->comp_rank)
-            ios->ioproc = true;
-        LOG((3, "ios->ioranks[%d] = %d", i, ios->ioranks[i]));
+        if (!(ios->ioranks = calloc(ios->num_iotasks, sizeof(int))))
+        {
+            return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
+                            "PIO Init failed. Out of memory allocating %lld bytes for array of I/O process ranks in the I/O descriptor", (unsigned long long) (ios->num_iotasks * sizeof(int)));
+        }
+        for (int i = 0; i < ios->num_iotasks; i++)
+        {
+            ios->ioranks[i] = (base + i * ustride) % ios->num_comptasks;
+            if (ios->ioranks[i] == ios->comp_rank)
+                ios->ioproc = true;
+            LOG((3, "ios->ioranks[%d] = %d", i, ios->ioranks[i]));
+        }
     }
     ios->ioroot = ios->ioranks[0];
 
@@ -1292,6 +1949,37 @@ int PIOc_finalize(int iosysid)
         }
     }
 
+#ifdef PIO_MICRO_TIMING
+    /* Write out any micro timer logs not written out when closing files */
+    if (ios->my_comm != MPI_COMM_NULL)
+    {
+        ierr = mtimer_flush_logs(ios->my_comm);
+        if(ierr != PIO_NOERR)
+        {
+            /* log and continue */
+            LOG((1, "Flushing micro timer logs failed"));
+            ierr = PIO_NOERR;
+        }
+    }
+#endif
+
+    /* Drain the data staged for closed files. */
+    if (ios->ioproc && ios->stage_pending)
+    {
+        ierr = pio_stage_drain_pending(ios);
+        if(ierr != PIO_NOERR)
+        {
+            /* log and continue */
+            LOG((1, "Draining the data staged for closed files failed"));
+            ierr = PIO_NOERR;
+        }
+    }
+    free(ios->stage_dir);
+
+    /* Free the buffers of the files of the IO system. */
+    pio_arena_free(ios->arena);
+    ios->arena = NULL;
+
     /* Free this memory that was allocated in init_intracomm. */
     if (ios->ioranks)
         free(ios->ioranks);
@@ -1324,6 +2012,10 @@ int PIOc_finalize(int iosysid)
         MPI_Comm_free(&ios->intercomm);
     if (ios->comp_comm != MPI_COMM_NULL)
         MPI_Comm_free(&ios->comp_comm);
+    if (ios->node_comm != MPI_COMM_NULL)
+        MPI_Comm_free(&ios->node_comm);
+    if (ios->node_roots_comm != MPI_COMM_NULL)
+        MPI_Comm_free(&ios->node_roots_comm);
     if (ios->my_comm != MPI_COMM_NULL)
         ios->my_comm = MPI_COMM_NULL;
 
@@ -1460,11 +2152,17 @@ int PIOc_iotype_available(int iotype)
 #endif
 #ifdef _NETCDF
     case PIO_IOTYPE_NETCDF:
+    case PIO_IOTYPE_MEMORY:
+    case PIO_IOTYPE_NULL:
         return 1;
 #endif
 #ifdef _PNETCDF
     case PIO_IOTYPE_PNETCDF:
         return 1;
+#endif
+#ifdef _HDF5
+    case PIO_IOTYPE_HDF5:
+        return 1;
 #endif
     default:
         return 0;
@@ -1539,8 +2237,10 @@ int PIOc_iotype_available(int iotype)
  * caller.)
  *
  * @param rearranger the default rearranger to use for decompositions
- * in this IO system. Must be either PIO_REARR_BOX or
- * PIO_REARR_SUBSET.
+ * in this IO system. Must be PIO_REARR_BOX, PIO_REARR_SUBSET or
+ * PIO_REARR_AUTO. With async I/O the tasks do not all have the maps
+ * the choice is made from, so PIO_REARR_AUTO uses the box
+ * rearranger.
  *
  * @param iosysidp pointer to array of length component_count that
  * gets the iosysid for each component.
@@ -1571,10 +2271,11 @@ int PIOc_init_async(MPI_Comm world, int num_io_procs, int *io_proc_list,
 #endif
     /* Check input parameters. */
     if (num_io_procs < 1 || component_count < 1 || !num_procs_per_comp || !iosysidp ||
-        (rearranger != PIO_REARR_BOX && rearranger != PIO_REARR_SUBSET))
+        (rearranger != PIO_REARR_BOX && rearranger != PIO_REARR_SUBSET &&
+         rearranger != PIO_REARR_AUTO))
     {
         return pio_err(NULL, NULL, PIO_EINVAL, __FILE__, __LINE__,
-                        "PIO Init (async) failed. Invalid arguments provided, num_io_procs=%d (expected >= 1), component_count=%d (expected >= 1), num_procs_per_comp is %s (expected not NULL), iosysidp is %s (expected not NULL), rearranger=%s (expected PIO_REARR_BOX or PIO_REARR_SUBSET)", num_io_procs, component_count, (num_procs_per_comp) ? "not NULL" : "NULL", (iosysidp) ? "not NULL" : "NULL", (rearranger == PIO_REARR_BOX) ? "PIO_REARR_BOX" : ((rearranger == PIO_REARR_SUBSET) ? "PIO_REARR_SUBSET" : "UNKNOWN REARRANGER"));
+                        "PIO Init (async) failed. Invalid arguments provided, num_io_procs=%d (expected >= 1), component_count=%d (expected >= 1), num_procs_per_comp is %s (expected not NULL), iosysidp is %s (expected not NULL), rearranger=%d (expected PIO_REARR_BOX, PIO_REARR_SUBSET or PIO_REARR_AUTO)", num_io_procs, component_count, (num_procs_per_comp) ? "not NULL" : "NULL", (iosysidp) ? "not NULL" : "NULL", rearranger);
     }
 
     /* Temporarily limit to one computational component. */
@@ -1755,6 +2456,8 @@ int PIOc_init_async(MPI_Comm world, int num_io_procs, int *io_proc_list,
         my_iosys->comp_comm = MPI_COMM_NULL;
         my_iosys->union_comm = MPI_COMM_NULL;
         my_iosys->intercomm = MPI_COMM_NULL;
+        my_iosys->node_comm = MPI_COMM_NULL;
+        my_iosys->node_roots_comm = MPI_COMM_NULL;
         my_iosys->my_comm = MPI_COMM_NULL;
         my_iosys->async = 1;
         my_iosys->error_handler = default_error_handler;
@@ -2034,7 +2737,9 @@ int PIOc_init_async(MPI_Comm world, int num_io_procs, int *io_proc_list,
  * @param uio_comm The communicator representing all I/O processes.
  * This communicator is valid (!= MPI_COMM_NULL) only on the I/O
  * procs
- * @param rearranger The rearranger to use for I/O
+ * @param rearranger The rearranger to use for I/O, PIO_REARR_BOX,
+ * PIO_REARR_SUBSET or PIO_REARR_AUTO (which uses the box rearranger
+ * with async I/O)
  * @param iosysidps An array to store the iosystem ids returned (each
  * iosystem id in the array is for the corresponding comp_comm in the
  * comp_comms array)
@@ -2056,11 +2761,12 @@ int PIOc_init_intercomm(int component_count, const MPI_Comm peer_comm,
 #endif
     assert((component_count > 0) && ucomp_comms && iosysidps);
     if((component_count <= 0) || (ucomp_comms == NULL) ||
-        ((rearranger != PIO_REARR_BOX) && (rearranger != PIO_REARR_SUBSET)) ||
+        ((rearranger != PIO_REARR_BOX) && (rearranger != PIO_REARR_SUBSET) &&
+         (rearranger != PIO_REARR_AUTO)) ||
         (iosysidps == NULL))
     {
         return pio_err(NULL, NULL, PIO_EINVAL, __FILE__, __LINE__,
-                        "PIO Init (async) failed. Invalid arguments provided, component_count=%d (expected > 0), ucomp_comms is %s (expected not NULL), rearranger=%s (expected PIO_REARR_BOX or PIO_REARR_SUBSET), iosysidps is %s (expected not NULL)", component_count, (ucomp_comms) ? "not NULL" : "NULL", (rearranger == PIO_REARR_BOX) ? "PIO_REARR_BOX" : ((rearranger == PIO_REARR_SUBSET) ? "PIO_REARR_SUBSET" : "UNKNOWN REARRANGER"), (iosysidps) ? "not NULL" : "NULL");
+                        "PIO Init (async) failed. Invalid arguments provided, component_count=%d (expected > 0), ucomp_comms is %s (expected not NULL), rearranger=%d (expected PIO_REARR_BOX, PIO_REARR_SUBSET or PIO_REARR_AUTO), iosysidps is %s (expected not NULL)", component_count, (ucomp_comms) ? "not NULL" : "NULL", rearranger, (iosysidps) ? "not NULL" : "NULL");
     }
 
     /* Turn on the logging system for PIO. */
@@ -2120,6 +2826,8 @@ int PIOc_init_intercomm(int component_count, const MPI_Comm peer_comm,
         iosys[i]->io_comm = MPI_COMM_NULL;
         iosys[i]->comp_comm = MPI_COMM_NULL;
         iosys[i]->intercomm = MPI_COMM_NULL;
+        iosys[i]->node_comm = MPI_COMM_NULL;
+        iosys[i]->node_roots_comm = MPI_COMM_NULL;
         iosys[i]->my_comm = MPI_COMM_NULL;
 
         iosys[i]->compgroup = MPI_GROUP_NULL;
@@ -2632,3 +3340,30 @@ int PIOc_set_blocksize(int newblocksize)
     blocksize = newblocksize;
     return PIO_NOERR;
 }
+
+/**
+ * Set the file system stripe size the box rearranger aligns the data
+ * of the IO tasks to. The slowest varying dimension of the
+ * decompositions initialized afterwards is split so that each IO
+ * task writes whole stripes (of a variable starting at a stripe
+ * boundary in the file), and the blocksize only limits the number
+ * of IO tasks used. Arrays with too few stripe aligned slabs for
+ * these IO tasks are split as without a stripe size.
+ *
+ * @param newstripesize the stripe size in bytes, 0 to not align the
+ * data, or PIO_STRIPESIZE_HINT to use the "striping_unit" hint of the
+ * IO system (see PIOc_set_hint).
+ * @returns 0 for success.
+ * @ingroup PIO_set_blocksize
+ */
+int PIOc_set_stripesize(int newstripesize)
+{
+    if (newstripesize < 0 && newstripesize != PIO_STRIPESIZE_HINT)
+    {
+        return pio_err(NULL, NULL, PIO_EINVAL, __FILE__, __LINE__,
+                        "Setting stripe size for the BOX rearranger failed. The new stripe size (%d) needs to be >= 0 or PIO_STRIPESIZE_HINT", newstripesize);
+    }
+
+    stripesize = newstripesize;
+    return PIO_NOERR;
+}
@@ -17,6 +17,12 @@
  * used. */
 int blocksize = DEFAULT_BLOCKSIZE;
 
+/** The file system stripe size, in bytes, the IO task boxes of the
+ * box rearranger are aligned to. 0 to not align the boxes,
+ * PIO_STRIPESIZE_HINT to use the "striping_unit" hint of the IO
+ * system. */
+int stripesize = 0;
+
 /**
  * Recursive Standard C Function: Greatest Common Divisor.
  *
@@ -343,6 +349,113 @@ PIO_Offset GCDblocksize(int arrlen, const PIO_Offset *arr_in)
     return bsize;
 }
 
+/**
+ * Get the stripe size the box rearranger aligns the data of the IO
+ * tasks to (see PIOc_set_stripesize()).
+ *
+ * @param ios pointer to the IO system info.
+ * @param stripe_sizep pointer that gets the stripe size in bytes, 0
+ * if the data is not aligned.
+ * @returns 0 for success, error code otherwise.
+ */
+int get_box_stripe_size(iosystem_desc_t *ios, PIO_Offset *stripe_sizep)
+{
+    pioassert(ios && stripe_sizep, "invalid input", __FILE__, __LINE__);
+
+    *stripe_sizep = stripesize;
+
+    /* Get the stripe size from the MPI info hint. */
+    if (stripesize == PIO_STRIPESIZE_HINT)
+    {
+        char value[MPI_MAX_INFO_VAL + 1];
+        int flag = 0;
+        int mpierr;
+
+        *stripe_sizep = 0;
+        if (ios->info != MPI_INFO_NULL)
+        {
+            if ((mpierr = MPI_Info_get(ios->info, "striping_unit", MPI_MAX_INFO_VAL,
+                                       value, &flag)))
+                return check_mpi(ios, NULL, mpierr, __FILE__, __LINE__);
+            if (flag)
+                *stripe_sizep = max(0, atoll(value));
+        }
+    }
+
+    return PIO_NOERR;
+}
+
+/**
+ * Compute start and count values for each io task so that the data
+ * of each io task, in the (row-major) layout of the variable in the
+ * file, is a whole number of file system stripes. Only the slowest
+ * varying dimension is split, in units of the smallest number of
+ * rows whose size is a multiple of the stripe size, and only the
+ * last box may end with a partial stripe. The boxes are aligned to
+ * the stripes in the file if the variable (or the record) starts at
+ * a stripe boundary. This function is used by CalcStartandCount().
+ *
+ * The units can be larger than the whole dimension (for example,
+ * rows of an odd number of doubles need as many rows as there are
+ * doubles in a stripe). If there are fewer units than IO tasks to
+ * use, the data is not aligned, and the caller splits it as usual.
+ *
+ * @param basesize size in bytes of the data type.
+ * @param ndims the number of dimensions in the variable, not
+ * including the unlimited dimension.
+ * @param gdims an array of global size of each dimension.
+ * @param use_io_procs the maximum number of IO tasks to use.
+ * @param myiorank rank of this task in IO communicator.
+ * @param stripe_size the stripe size in bytes.
+ * @param start array of length ndims with data start values.
+ * @param count array of length ndims with data count values.
+ * @param num_aiotasks pointer that gets the number of IO tasks used.
+ * @returns true if the data was split, false if there are too few
+ * units to use use_io_procs IO tasks.
+ */
+static bool calc_start_count_striped(int basesize, int ndims, const int *gdims,
+                                     int use_io_procs, int myiorank,
+                                     PIO_Offset stripe_size, PIO_Offset *start,
+                                     PIO_Offset *count, int *num_aiotasks)
+{
+    PIO_Offset rowbytes = basesize; /* Size of one index of dimension 0. */
+    PIO_Offset unitrows;            /* Number of rows in a unit. */
+    int nunits;                     /* Number of units in dimension 0. */
+    int nio;
+
+    for (int i = 1; i < ndims; i++)
+        rowbytes *= gdims[i];
+
+    unitrows = stripe_size / lgcd(rowbytes, stripe_size);
+    nunits = (gdims[0] + unitrows - 1) / unitrows;
+
+    LOG((2, "calc_start_count_striped rowbytes = %lld unitrows = %lld nunits = %d "
+         "use_io_procs = %d", (long long)rowbytes, (long long)unitrows, nunits, use_io_procs));
+
+    if (nunits < use_io_procs)
+        return false;
+    nio = use_io_procs;
+
+    for (int i = 0; i < ndims; i++)
+    {
+        start[i] = 0;
+        count[i] = (myiorank < nio) ? gdims[i] : 0;
+    }
+
+    if (myiorank < nio)
+    {
+        PIO_Offset ustart, ucount;
+
+        compute_one_dim(nunits, nio, myiorank, &ustart, &ucount);
+        start[0] = ustart * unitrows;
+        count[0] = min(ucount * unitrows, gdims[0] - start[0]);
+    }
+
+    *num_aiotasks = nio;
+
+    return true;
+}
+
 /**
  * Compute start and count values for each io task. This is used in
  * PIOc_InitDecomp() for the box rearranger only.
@@ -353,13 +466,16 @@ PIO_Offset GCDblocksize(int arrlen, const PIO_Offset *arr_in)
  * @param gdims an array of global size of each dimension.
  * @param num_io_procs the number of IO tasks.
  * @param myiorank rank of this task in IO communicator.
+ * @param stripe_size the file system stripe size in bytes the data
+ * of each IO task is aligned to, 0 to not align the data.
  * @param start array of length ndims with data start values.
  * @param count array of length ndims with data count values.
  * @param num_aiotasks the number of IO tasks used(?)
  * @returns 0 for success, error code otherwise.
  */
 int CalcStartandCount(int pio_type, int ndims, const int *gdims, int num_io_procs,
-                      int myiorank, PIO_Offset *start, PIO_Offset *count, int *num_aiotasks)
+                      int myiorank, PIO_Offset stripe_size, PIO_Offset *start,
+                      PIO_Offset *count, int *num_aiotasks)
 {
     int minbytes; 
     int maxbytes;
@@ -380,10 +496,10 @@ int CalcStartandCount(int pio_type, int ndims, const int *gdims, int num_io_proc
     int ret;
 
     /* Check inputs. */
-    pioassert(pio_type > 0 && ndims > 0 && gdims && num_io_procs > 0 && start && count,
-              "invalid input", __FILE__, __LINE__);
-    LOG((1, "CalcStartandCount pio_type = %d ndims = %d num_io_procs = %d myiorank = %d",
-         pio_type, ndims, num_io_procs, myiorank));
+    pioassert(pio_type > 0 && ndims > 0 && gdims && num_io_procs > 0 && stripe_size >= 0 &&
+              start && count, "invalid input", __FILE__, __LINE__);
+    LOG((1, "CalcStartandCount pio_type = %d ndims = %d num_io_procs = %d myiorank = %d "
+         "stripe_size = %lld", pio_type, ndims, num_io_procs, myiorank, (long long)stripe_size));
 
     /* We are trying to find start and count indices for each iotask
      * such that each task has approximately blocksize data to write
@@ -410,6 +526,13 @@ int CalcStartandCount(int pio_type, int ndims, const int *gdims, int num_io_proc
      * blocksize data on each iotask*/
     use_io_procs = max(1, min((int)((float)pgdims / (float)minblocksize + 0.5), num_io_procs));
 
+    /* Align the data of each iotask to the file system stripes, if
+     * there are enough stripe aligned units for all the iotasks. */
+    if (stripe_size > 0 &&
+        calc_start_count_striped(basesize, ndims, gdims, use_io_procs, myiorank,
+                                 stripe_size, start, count, num_aiotasks))
+        return PIO_NOERR;
+
     maxbytes = max(blocksize, pgdims * basesize / use_io_procs) + 256;
 
     /* Initialize to 0. */
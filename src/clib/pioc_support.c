@@ -151,6 +151,11 @@ int PIOc_strerror(int pioerr, char *errmsg)
         case PIO_EADIOS2ERR:
             strcpy(errmsg, "Some error occurs when calling an ADIOS2 API");
             break;
+#endif
+#ifdef _HDF5
+        case PIO_EHDF5ERR:
+            strcpy(errmsg, "Some error occurs when calling an HDF5 API");
+            break;
 #endif
         default:
             strcpy(errmsg, "Unknown Error: Unrecognized error code");
@@ -493,6 +498,8 @@ int check_mpi(iosystem_desc_t *ios, file_desc_t *file, int mpierr,
  * PIO_REDUCE_ERROR : Reduce error codes across all processes (and log
  * the error codes from each process). This error handler detects error
  * in any process.
+ * PIO_DEFER_ERROR : Same as PIO_REDUCE_ERROR. Calls that do not return
+ * any data use check_netcdf_defer() instead, to avoid the reduction.
  *
  * @param ios pointer to the iosystem description struct. Ignored if NULL.
  * @param file pointer to the PIO structure describing this file. Ignored if NULL.
@@ -534,7 +541,8 @@ int check_netcdf(iosystem_desc_t *ios, file_desc_t *file, int status,
     assert( (eh == PIO_INTERNAL_ERROR) ||
             (eh == PIO_BCAST_ERROR) ||
             (eh == PIO_RETURN_ERROR) ||
-            (eh == PIO_REDUCE_ERROR) );
+            (eh == PIO_REDUCE_ERROR) ||
+            (eh == PIO_DEFER_ERROR) );
     LOG((2, "check_netcdf chose error handler = %d", eh));
 
     /* Get an error message. */
@@ -553,7 +561,7 @@ int check_netcdf(iosystem_desc_t *ios, file_desc_t *file, int status,
             return check_mpi(ios, file, mpierr, __FILE__, __LINE__);
         }
     }
-    else if(eh == PIO_REDUCE_ERROR){
+    else if((eh == PIO_REDUCE_ERROR) || (eh == PIO_DEFER_ERROR)){
         /* We assume that error codes are all negative */
         int lstatus = status;
         mpierr = MPI_Allreduce(&lstatus, &status, 1, MPI_INT, MPI_MIN, comm);
@@ -623,6 +631,92 @@ int check_netcdf(iosystem_desc_t *ios, file_desc_t *file, int status,
     return status;
 }
 
+/**
+ * Check the result of a netCDF API call that does not return any
+ * data (e.g. defining or writing data), the call is not required to
+ * be consistent across processes until the next sync point.
+ *
+ * With the PIO_DEFER_ERROR error handler the first error on each
+ * process is recorded in the file (no communication is required) and
+ * PIO_NOERR is returned. The recorded errors are reduced across all
+ * processes at the next sync point, see pio_check_deferred_errors().
+ * With other error handlers this is the same as check_netcdf().
+ *
+ * @param file pointer to the PIO structure describing this file.
+ * @param status the return value from the netCDF call.
+ * @param fname the name of the code file.
+ * @param line the line number of the netCDF call in the code.
+ * @return the error code
+ */
+int check_netcdf_defer(file_desc_t *file, int status, const char *fname, int line)
+{
+    assert(file && fname);
+
+    if (file->iosystem->error_handler != PIO_DEFER_ERROR)
+        return check_netcdf(NULL, file, status, fname, line);
+
+    /* Only the first error is recorded */
+    if ((status != PIO_NOERR) && (file->deferred_err == PIO_NOERR))
+    {
+        LOG((1, "check_netcdf_defer recording error status = %d fname = %s line = %d",
+             status, fname, line));
+        file->deferred_err = status;
+        file->deferred_err_fname = fname;
+        file->deferred_err_line = line;
+    }
+
+    return PIO_NOERR;
+}
+
+/**
+ * Reduce the errors recorded (on each process) with the
+ * PIO_DEFER_ERROR error handler across all processes, and clear the
+ * recorded errors. This function is a no-op for other error handlers.
+ * (Collective call for file with error handler == PIO_DEFER_ERROR)
+ *
+ * @param file pointer to the PIO structure describing this file.
+ * @return PIO_NOERR if no process recorded an error, otherwise an
+ * error code recorded on one of the processes.
+ */
+int pio_check_deferred_errors(file_desc_t *file)
+{
+    iosystem_desc_t *ios;
+    int lstatus;
+    int status = PIO_NOERR;
+    int mpierr = MPI_SUCCESS;
+
+    assert(file);
+    ios = file->iosystem;
+
+    if (ios->error_handler != PIO_DEFER_ERROR)
+        return PIO_NOERR;
+
+    /* We assume that error codes are all negative */
+    lstatus = file->deferred_err;
+    if ((mpierr = MPI_Allreduce(&lstatus, &status, 1, MPI_INT, MPI_MIN, ios->my_comm)))
+        return check_mpi(NULL, file, mpierr, __FILE__, __LINE__);
+
+    file->deferred_err = PIO_NOERR;
+    if (status != PIO_NOERR)
+    {
+        /* Each process reports its own error */
+        if (lstatus != PIO_NOERR)
+        {
+            char errmsg[PIO_MAX_NAME + 1];
+            int ret = PIOc_strerror(lstatus, errmsg);
+            assert(ret == PIO_NOERR);
+            fprintf(stderr, "PIO: ERROR: Deferred error on file %s (ncid=%d). %s (error num=%d), (%s:%d)\n",
+                    pio_get_fname_from_file(file), file->pio_ncid, errmsg, lstatus,
+                    file->deferred_err_fname, file->deferred_err_line);
+            fflush(stderr);
+        }
+        return pio_err(NULL, file, status, __FILE__, __LINE__,
+                        "Deferred error check on file %s (ncid=%d) failed. An error occurred on one or more processes since the last check", pio_get_fname_from_file(file), file->pio_ncid);
+    }
+
+    return PIO_NOERR;
+}
+
 /**
  * Handle an error in PIO. This will consult the error handler
  * settings and either call MPI_Abort() or return an error code.
@@ -708,48 +802,106 @@ int pio_err(iosystem_desc_t *ios, file_desc_t *file,
 }
 
 /**
- * Allocate a region struct, and initialize it.
+ * Allocate a region table, and initialize it with one empty
+ * region. The start and count of each region are stored in rows of
+ * ndims + 1 elements; the first element of each row is reserved for
+ * the record dimension, so that the rows can be passed directly to
+ * the varn functions of the underlying libraries.
  *
  * @param ios pointer to the IO system info, used for error
  * handling. Ignored if NULL.
- * @param ndims the number of dimensions for the data in this region.
- * @param a pointer that gets a pointer to the newly allocated
- * io_region struct.
+ * @param ndims the number of dimensions for the data in the regions.
+ * @param regionsp a pointer that gets a pointer to the newly
+ * allocated io_region_table struct.
  * @returns 0 for success, error code otherwise.
  */
-int alloc_region2(iosystem_desc_t *ios, int ndims, io_region **regionp)
+int alloc_region_table(iosystem_desc_t *ios, int ndims, io_region_table **regionsp)
 {
-    io_region *region;
+    io_region_table *regions;
 
     /* Check inputs. */
-    pioassert(ndims >= 0 && regionp, "invalid input", __FILE__, __LINE__);
-    LOG((1, "alloc_region2 ndims = %d sizeof(io_region) = %d", ndims,
-         sizeof(io_region)));
-    
-    /* Allocate memory for the io_region struct. */
-    if (!(region = calloc(1, sizeof(io_region))))
+    pioassert(ndims >= 0 && regionsp, "invalid input", __FILE__, __LINE__);
+    LOG((1, "alloc_region_table ndims = %d", ndims));
+
+    /* Allocate memory for the io_region_table struct. */
+    if (!(regions = calloc(1, sizeof(io_region_table))))
     {
         return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
-                        "Internal error while allocating region. Out of memory allocating %lld bytes I/O region", (unsigned long long) sizeof(io_region));
+                        "Internal error while allocating region table. Out of memory allocating %lld bytes I/O region table", (unsigned long long) sizeof(io_region_table));
     }
+    regions->ndims = ndims;
 
-    /* Allocate memory for the array of start indicies. */
-    if (!(region->start = calloc(ndims, sizeof(PIO_Offset))))
+    /* Make room for, and zero, the first region. */
+    if (grow_region_table(ios, regions, 1))
     {
+        free_region_table(regions);
         return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
-                        "Internal error while allocating region. Out of memory allocating %lld bytes  for start array in the I/O region", (unsigned long long) (ndims * sizeof(PIO_Offset)));
+                        "Internal error while allocating region table. Out of memory allocating the first region of the I/O region table");
     }
+    regions->nregions = 1;
 
-    /* Allocate memory for the array of counts. */
-    if (!(region->count = calloc(ndims, sizeof(PIO_Offset))))
-    {
+    /* Return pointer to new table to caller. */
+    *regionsp = regions;
+
+    return PIO_NOERR;
+}
+
+/**
+ * Make room for at least nregions regions in a region table. The
+ * capacity is doubled as needed, and new regions are zeroed. The
+ * number of regions in use (nregions member) is not changed.
+ *
+ * @param ios pointer to the IO system info, used for error
+ * handling. Ignored if NULL.
+ * @param regions pointer to the region table.
+ * @param nregions the number of regions needed.
+ * @returns 0 for success, error code otherwise.
+ */
+int grow_region_table(iosystem_desc_t *ios, io_region_table *regions, int nregions)
+{
+    size_t rowlen;
+    int size;
+    void *tmp;
+
+    pioassert(regions && nregions >= 0, "invalid input", __FILE__, __LINE__);
+
+    if (nregions <= regions->size)
+        return PIO_NOERR;
+
+    rowlen = regions->ndims + 1;
+    for (size = regions->size ? regions->size : 1; size < nregions; size *= 2)
+        ;
+
+    if (!(tmp = realloc(regions->start, size * rowlen * sizeof(PIO_Offset))))
         return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
-                        "Internal error while allocating region. Out of memory allocating %lld bytes  for count array in the I/O region", (unsigned long long) (ndims * sizeof(PIO_Offset)));
-    }
+                       "Internal error while growing region table. Out of memory allocating %lld bytes for start array", (unsigned long long)(size * rowlen * sizeof(PIO_Offset)));
+    regions->start = tmp;
+    if (!(tmp = realloc(regions->count, size * rowlen * sizeof(PIO_Offset))))
+        return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
+                       "Internal error while growing region table. Out of memory allocating %lld bytes for count array", (unsigned long long)(size * rowlen * sizeof(PIO_Offset)));
+    regions->count = tmp;
+    if (!(tmp = realloc(regions->loffset, size * sizeof(PIO_Offset))))
+        return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
+                       "Internal error while growing region table. Out of memory allocating %lld bytes for loffset array", (unsigned long long)(size * sizeof(PIO_Offset)));
+    regions->loffset = tmp;
+    if (!(tmp = realloc(regions->startp, size * sizeof(PIO_Offset *))))
+        return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
+                       "Internal error while growing region table. Out of memory allocating %lld bytes for start list", (unsigned long long)(size * sizeof(PIO_Offset *)));
+    regions->startp = tmp;
+    if (!(tmp = realloc(regions->countp, size * sizeof(PIO_Offset *))))
+        return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
+                       "Internal error while growing region table. Out of memory allocating %lld bytes for count list", (unsigned long long)(size * sizeof(PIO_Offset *)));
+    regions->countp = tmp;
+
+    /* Zero the new regions. */
+    memset(regions->start + regions->size * rowlen, 0,
+           (size - regions->size) * rowlen * sizeof(PIO_Offset));
+    memset(regions->count + regions->size * rowlen, 0,
+           (size - regions->size) * rowlen * sizeof(PIO_Offset));
+    memset(regions->loffset + regions->size, 0,
+           (size - regions->size) * sizeof(PIO_Offset));
+    regions->size = size;
 
-    /* Return pointer to new region to caller. */
-    *regionp = region;
-    
     return PIO_NOERR;
 }
 
@@ -895,18 +1047,22 @@ int malloc_iodesc(iosystem_desc_t *ios, int piotype, int ndims,
     /* Initialize some values in the struct. */
     (*iodesc)->maxregions = 1;
     (*iodesc)->ioid = -1;
+    (*iodesc)->conv_ioid = -1;
     (*iodesc)->ndims = ndims;
 
-    /* Allocate space for, and initialize, the first region. */
-    if ((ret = alloc_region2(ios, ndims, &((*iodesc)->firstregion))))
+    /* Allocate space for, and initialize, the region table. */
+    if ((ret = alloc_region_table(ios, ndims, &((*iodesc)->regions))))
     {
         return pio_err(ios, NULL, ret, __FILE__, __LINE__,
-                        "Internal error while allocating memory for iodesc. Allocating memory for 1st region failed. Out of memory allocating memory for I/O region in the I/O descriptor");
+                        "Internal error while allocating memory for iodesc. Allocating memory for the region table failed. Out of memory allocating memory for I/O regions in the I/O descriptor");
     }
 
     /* Set the swap memory settings to defaults for this IO system. */
     (*iodesc)->rearr_opts = ios->rearr_opts;
 
+    /* Pack the rearranged data if requested for this IO system. */
+    (*iodesc)->packed = ios->rearr_pack ? true : false;
+
 #if PIO_SAVE_DECOMPS
     /* The descriptor is not yet saved to disk */
     (*iodesc)->is_saved = false;
@@ -916,25 +1072,158 @@ int malloc_iodesc(iosystem_desc_t *ios, int piotype, int ndims,
 }
 
 /**
- * Free a region list.
+ * Remember the decomposition map of an io_desc_t as ranges of
+ * consecutive mappings, so the map kept for the life of the
+ * decomposition scales with the number of ranges instead of the
+ * number of elements.
  *
- * top a pointer to the start of the list to free.
+ * @param ios pointer to the iosystem_desc_t struct.
+ * @param iodesc pointer to the io_desc_t struct.
+ * @param maplen the length of the map.
+ * @param compmap the 1-based map.
+ * @returns 0 for success, error code otherwise.
  */
-void free_region_list(io_region *top)
+int set_iodesc_map(iosystem_desc_t *ios, io_desc_t *iodesc, int maplen,
+                   const PIO_Offset *compmap)
 {
-    io_region *ptr, *tptr;
+    int nranges = 0;
+    int r = -1;
+
+    pioassert(ios && iodesc && maplen >= 0 && (compmap || !maplen),
+              "invalid input", __FILE__, __LINE__);
+
+    /* Count the ranges. Holes (mappings <= 0) form ranges of equal
+     * mappings. */
+    for (int m = 0; m < maplen; m++)
+        if (!m || (compmap[m - 1] > 0 && compmap[m] != compmap[m - 1] + 1) ||
+            (compmap[m - 1] <= 0 && compmap[m] != compmap[m - 1]))
+            nranges++;
 
-    ptr = top;
-    while (ptr)
+    if (!(iodesc->map_start = malloc(sizeof(PIO_Offset) * max(nranges, 1))) ||
+        !(iodesc->map_count = malloc(sizeof(int) * max(nranges, 1))))
     {
-        if (ptr->start)
-            free(ptr->start);
-        if (ptr->count)
-            free(ptr->count);
-        tptr = ptr;
-        ptr = ptr->next;
-        free(tptr);
+        return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
+                        "Storing the I/O decomposition map failed. Out of memory allocating %lld bytes for %d ranges of the map", (unsigned long long) ((sizeof(PIO_Offset) + sizeof(int)) * nranges), nranges);
+    }
+
+    for (int m = 0; m < maplen; m++)
+    {
+        if (!m || (compmap[m - 1] > 0 && compmap[m] != compmap[m - 1] + 1) ||
+            (compmap[m - 1] <= 0 && compmap[m] != compmap[m - 1]))
+        {
+            r++;
+            iodesc->map_start[r] = compmap[m];
+            iodesc->map_count[r] = 0;
+        }
+        iodesc->map_count[r]++;
+    }
+    iodesc->map_nranges = nranges;
+    iodesc->maplen = maplen;
+    LOG((2, "set_iodesc_map maplen = %d nranges = %d", maplen, nranges));
+
+    return PIO_NOERR;
+}
+
+/**
+ * Remember the decomposition map of an io_desc_t given as ranges of
+ * consecutive mappings. Empty ranges are dropped, and ranges that
+ * continue the previous one (or holes following holes) are merged,
+ * as set_iodesc_map() does for a map.
+ *
+ * @param ios pointer to the iosystem_desc_t struct.
+ * @param iodesc pointer to the io_desc_t struct.
+ * @param nranges the number of ranges.
+ * @param rstart array (length nranges) with the 1-based mapping of
+ * the first element of each range, or 0 for a range of holes.
+ * @param rcount array (length nranges) with the number of elements
+ * of each range. The sum must fit in an int.
+ * @returns 0 for success, error code otherwise.
+ */
+int set_iodesc_ranges(iosystem_desc_t *ios, io_desc_t *iodesc, int nranges,
+                      const PIO_Offset *rstart, const PIO_Offset *rcount)
+{
+    int maplen = 0;
+    int n = 0;
+
+    pioassert(ios && iodesc && nranges >= 0 && ((rstart && rcount) || !nranges),
+              "invalid input", __FILE__, __LINE__);
+
+    if (!(iodesc->map_start = malloc(sizeof(PIO_Offset) * max(nranges, 1))) ||
+        !(iodesc->map_count = malloc(sizeof(int) * max(nranges, 1))))
+    {
+        return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
+                        "Storing the I/O decomposition map failed. Out of memory allocating %lld bytes for %d ranges of the map", (unsigned long long) ((sizeof(PIO_Offset) + sizeof(int)) * nranges), nranges);
+    }
+
+    for (int r = 0; r < nranges; r++)
+    {
+        PIO_Offset start = rstart[r] > 0 ? rstart[r] : 0;
+
+        if (!rcount[r])
+            continue;
+        if (n && ((start > 0 && iodesc->map_start[n - 1] > 0 &&
+                   start == iodesc->map_start[n - 1] + iodesc->map_count[n - 1]) ||
+                  (!start && iodesc->map_start[n - 1] <= 0)))
+            iodesc->map_count[n - 1] += rcount[r];
+        else
+        {
+            iodesc->map_start[n] = start;
+            iodesc->map_count[n++] = rcount[r];
+        }
+        maplen += rcount[r];
     }
+    iodesc->map_nranges = n;
+    iodesc->maplen = maplen;
+    LOG((2, "set_iodesc_ranges maplen = %d nranges = %d", maplen, n));
+
+    return PIO_NOERR;
+}
+
+/**
+ * Get the decomposition map of an io_desc_t, one mapping per
+ * element, from its ranges.
+ *
+ * @param iodesc pointer to the io_desc_t struct.
+ * @param mapp pointer that gets an array (length max(1,
+ * iodesc->maplen)) with the 1-based map. Must be freed by the
+ * caller.
+ * @returns 0 for success, error code otherwise.
+ */
+int expand_iodesc_map(io_desc_t *iodesc, PIO_Offset **mapp)
+{
+    PIO_Offset *map;
+    int m = 0;
+
+    pioassert(iodesc && mapp, "invalid input", __FILE__, __LINE__);
+
+    if (!(map = calloc(max(iodesc->maplen, 1), sizeof(PIO_Offset))))
+        return PIO_ENOMEM;
+
+    for (int r = 0; r < iodesc->map_nranges; r++)
+        for (int k = 0; k < iodesc->map_count[r]; k++)
+            map[m++] = iodesc->map_start[r] > 0 ? iodesc->map_start[r] + k : iodesc->map_start[r];
+    *mapp = map;
+
+    return PIO_NOERR;
+}
+
+/**
+ * Free a region table.
+ *
+ * @param regions a pointer to the region table to free. Ignored if
+ * NULL.
+ */
+void free_region_table(io_region_table *regions)
+{
+    if (!regions)
+        return;
+
+    free(regions->start);
+    free(regions->count);
+    free(regions->loffset);
+    free(regions->startp);
+    free(regions->countp);
+    free(regions);
 }
 
 /**
@@ -966,6 +1255,18 @@ int PIOc_freedecomp(int iosysid, int ioid)
                         "Freeing PIO decomposition failed. Invalid io decomposition id (%d) provided", ioid);
     }
 
+    /* Free the decomposition used for converting data to a narrower type */
+    if (iodesc->conv_ioid != -1)
+    {
+        ret = PIOc_freedecomp(iosysid, iodesc->conv_ioid);
+        if(ret != PIO_NOERR)
+        {
+            return pio_err(ios, NULL, ret, __FILE__, __LINE__,
+                            "Freeing PIO decomposition failed (iosysid = %d, iodesc id=%d). Error freeing the associated I/O decomposition (ioid=%d) used for data type conversion", iosysid, ioid, iodesc->conv_ioid);
+        }
+        iodesc->conv_ioid = -1;
+    }
+
     /* If async is in use, and this is not an IO task, bcast the parameters. */
     if (ios->async)
     {
@@ -980,7 +1281,8 @@ int PIOc_freedecomp(int iosysid, int ioid)
     }
 
     /* Free the map. */
-    free(iodesc->map);
+    free(iodesc->map_start);
+    free(iodesc->map_count);
 
     /* Free the dimlens. */
     free(iodesc->dimlen);
@@ -1009,6 +1311,10 @@ int PIOc_freedecomp(int iosysid, int ioid)
         free(iodesc->stype);
     }
 
+    free_pack_list(iodesc->rpack);
+    free_pack_list(iodesc->spack);
+    pio_mem_account(ios, NULL, PIO_MEM_REARR, -iodesc->rearr_mem);
+
     if (iodesc->scount)
         free(iodesc->scount);
 
@@ -1021,11 +1327,8 @@ int PIOc_freedecomp(int iosysid, int ioid)
     if (iodesc->rindex)
         free(iodesc->rindex);
 
-    if (iodesc->firstregion)
-        free_region_list(iodesc->firstregion);
-
-    if (iodesc->fillregion)
-        free_region_list(iodesc->fillregion);
+    free_region_table(iodesc->regions);
+    free_region_table(iodesc->fillregions);
 
     if (iodesc->rearranger == PIO_REARR_SUBSET)
         if ((mpierr = MPI_Comm_free(&iodesc->subset_comm)))
@@ -1290,13 +1593,19 @@ int PIOc_write_nc_decomp(int iosysid, const char *filename, int cmode, int ioid,
 
     /* Fill local array with my map. Use the fill value for unused */
     /* elements at the end if max_maplen is longer than maplen. Also
-     * subtract 1 because the iodesc->map is 1-based. */
+     * subtract 1 because the iodesc map is 1-based. */
     int my_map[max_maplen];
-    for (int e = 0; e < max_maplen; e++)
-    {
-        my_map[e] = e < iodesc->maplen ? iodesc->map[e] - 1 : NC_FILL_INT;
+    int e = 0;
+    for (int r = 0; r < iodesc->map_nranges; r++)
+        for (int k = 0; k < iodesc->map_count[r]; k++)
+            my_map[e++] = (iodesc->map_start[r] > 0 ? iodesc->map_start[r] + k :
+                           iodesc->map_start[r]) - 1;
+    for (; e < max_maplen; e++)
+        my_map[e] = NC_FILL_INT;
+#if PIO_ENABLE_LOGGING
+    for (e = 0; e < max_maplen; e++)
         LOG((3, "my_map[%d] = %d", e, my_map[e]));
-    }
+#endif /* PIO_ENABLE_LOGGING */
     
     /* Gather my_map from all computation tasks and fill the full_map array. */
     if ((mpierr = MPI_Allgather(&my_map, max_maplen, MPI_INT, full_map, max_maplen,
@@ -1960,6 +2269,8 @@ int PIOc_write_decomp(const char *file, int iosysid, int ioid, MPI_Comm comm)
 {
     iosystem_desc_t *ios;
     io_desc_t *iodesc;
+    PIO_Offset *map;
+    int ret;
 
     LOG((1, "PIOc_write_decomp file = %s iosysid = %d ioid = %d", file, iosysid, ioid));
 
@@ -1975,8 +2286,16 @@ int PIOc_write_decomp(const char *file, int iosysid, int ioid, MPI_Comm comm)
                         "Write I/O decomposition to file (%s) failed. Invalid io descriptor id (%d) provided (iosysid=%d)", (file) ? file : "UNKNOWN", ioid, iosysid);
     }
 
-    return PIOc_writemap(file, iodesc->ioid, iodesc->ndims, iodesc->dimlen, iodesc->maplen, iodesc->map,
-                         comm);
+    if ((ret = expand_iodesc_map(iodesc, &map)))
+    {
+        return pio_err(ios, NULL, ret, __FILE__, __LINE__,
+                        "Write I/O decomposition to file (%s) failed. Out of memory allocating the decomposition map (ioid=%d)", (file) ? file : "UNKNOWN", ioid);
+    }
+    ret = PIOc_writemap(file, iodesc->ioid, iodesc->ndims, iodesc->dimlen, iodesc->maplen, map,
+                        comm);
+    free(map);
+
+    return ret;
 }
 
 /**
@@ -2133,7 +2452,10 @@ int PIO_get_avail_iotypes(char *buf, size_t sz)
 
     assert(buf && (sz > 0));
 #ifdef _NETCDF
-    snprintf(cbuf, sz, "%s (%d)", pio_iotype_to_string(PIO_IOTYPE_NETCDF), PIO_IOTYPE_NETCDF);
+    snprintf(cbuf, sz, "%s (%d), %s (%d), %s (%d)",
+              pio_iotype_to_string(PIO_IOTYPE_NETCDF), PIO_IOTYPE_NETCDF,
+              pio_iotype_to_string(PIO_IOTYPE_MEMORY), PIO_IOTYPE_MEMORY,
+              pio_iotype_to_string(PIO_IOTYPE_NULL), PIO_IOTYPE_NULL);
     sz = max_sz - strlen(buf);
     cbuf = buf + strlen(buf);
 #endif /* _NETCDF */
@@ -2161,6 +2483,13 @@ int PIO_get_avail_iotypes(char *buf, size_t sz)
     cbuf = buf + strlen(buf);
 #endif
 
+#ifdef _HDF5
+    assert(sz > 0);
+    snprintf(cbuf, sz, ", %s (%d)", pio_iotype_to_string(PIO_IOTYPE_HDF5), PIO_IOTYPE_HDF5);
+    sz = max_sz - strlen(buf);
+    cbuf = buf + strlen(buf);
+#endif
+
     return ret;
 }
 
@@ -2256,6 +2585,7 @@ int PIOc_createfile_int(int iosysid, int *ncidp, int *iotype, const char *filena
     /* Set to true if this task should participate in IO (only true for
      * one task with netcdf serial files. */
     if (file->iotype == PIO_IOTYPE_NETCDF4P || file->iotype == PIO_IOTYPE_PNETCDF ||
+        file->iotype == PIO_IOTYPE_MEMORY || file->iotype == PIO_IOTYPE_HDF5 ||
         ios->io_rank == 0)
         file->do_io = 1;
 
@@ -2412,6 +2742,10 @@ int PIOc_createfile_int(int iosysid, int *ncidp, int *iotype, const char *filena
     }
 #endif
 
+    /* Count the staged files (used to name the staging logs). */
+    if (ios->stage_dir && file->iotype == PIO_IOTYPE_PNETCDF)
+        ios->stage_nfiles++;
+
     /* If this task is in the IO component, do the IO. */
     if (ios->ioproc)
     {
@@ -2458,6 +2792,30 @@ int PIOc_createfile_int(int iosysid, int *ncidp, int *iotype, const char *filena
                 ierr = nc_create(filename, file->mode, &file->fh);
             }
             break;
+        case PIO_IOTYPE_MEMORY:
+            /* Each I/O task keeps the data it writes in a private
+             * diskless netCDF file. Variables are not prefilled, PIO
+             * writes the fillvalues for the holes in the decomposition,
+             * so only the parts of the file written by an I/O task
+             * are touched on that task. */
+            file->mode = file->mode | NC_DISKLESS;
+            LOG((2, "Calling nc_create (diskless) mode = %d", file->mode));
+            ierr = nc_create(filename, file->mode, &file->fh);
+            if (!ierr)
+                ierr = nc_set_fill(file->fh, NC_NOFILL, NULL);
+            break;
+        case PIO_IOTYPE_NULL:
+            /* Only the metadata is kept, in a diskless netCDF file on
+             * the I/O root. The data is discarded after rearrangement. */
+            file->mode = file->mode | NC_DISKLESS;
+            if (!ios->io_rank)
+            {
+                LOG((2, "Calling nc_create (diskless) mode = %d", file->mode));
+                ierr = nc_create(filename, file->mode, &file->fh);
+                if (!ierr)
+                    ierr = nc_set_fill(file->fh, NC_NOFILL, NULL);
+            }
+            break;
 #endif
 #ifdef _PNETCDF
         case PIO_IOTYPE_PNETCDF:
@@ -2562,9 +2920,26 @@ int PIOc_createfile_int(int iosysid, int *ncidp, int *iotype, const char *filena
              */
             MPI_Info_set(ios->info, "nc_ibuf_size", "67108864");
 
-            ierr = ncmpi_create(ios->io_comm, filename, file->mode, ios->info, &file->fh);
+            /* Each group of IO tasks writes its own subfile if
+             * subfiling is enabled. */
+            if (ios->num_subfiles > 1)
+                ierr = pio_subfile_create(file, filename);
+            else
+                ierr = ncmpi_create(ios->io_comm, filename, file->mode, ios->info, &file->fh);
             if (!ierr)
                 ierr = ncmpi_buffer_attach(file->fh, pio_buffer_size_limit);
+            if (!ierr)
+                pio_mem_account(ios, file, PIO_MEM_ATTACH, pio_buffer_size_limit);
+
+            /* Stage the data written to the file in node-local storage. */
+            if (!ierr && ios->stage_dir && !file->subfile)
+                ierr = pio_stage_create(file, filename);
+            break;
+#endif
+#ifdef _HDF5
+        case PIO_IOTYPE_HDF5:
+            LOG((2, "Calling pio_hdf5_create mode = %d", file->mode));
+            ierr = pio_hdf5_create(file, filename);
             break;
 #endif
         }
@@ -2753,6 +3128,14 @@ int PIOc_openfile_retry(int iosysid, int *ncidp, int *iotype, const char *filena
                         "Opening file (%s) failed. Invalid iotype (%s:%d) specified. Available iotypes are : %s", filename, pio_iotype_to_string(*iotype), *iotype, avail_iotypes);
     }
 
+    /* There is no data to read with the null iotype. Files written
+     * with the HDF5 iotype are read with the netCDF-4 iotypes. */
+    if (*iotype == PIO_IOTYPE_NULL || *iotype == PIO_IOTYPE_HDF5)
+    {
+        return pio_err(ios, NULL, PIO_EBADIOTYPE, __FILE__, __LINE__,
+                        "Opening file (%s) failed. Files cannot be opened with iotype %s, the iotype can only be used to create files", filename, pio_iotype_to_string(*iotype));
+    }
+
     LOG((2, "PIOc_openfile_retry iosysid = %d iotype = %d filename = %s mode = %d retry = %d",
          iosysid, *iotype, filename, mode, retry));
 
@@ -2799,7 +3182,7 @@ int PIOc_openfile_retry(int iosysid, int *ncidp, int *iotype, const char *filena
     /* Set to true if this task should participate in IO (only true
      * for one task with netcdf serial files. */
     if (file->iotype == PIO_IOTYPE_NETCDF4P || file->iotype == PIO_IOTYPE_PNETCDF ||
-        ios->io_rank == 0)
+        file->iotype == PIO_IOTYPE_MEMORY || ios->io_rank == 0)
         file->do_io = 1;
 
     for (int i = 0; i < PIO_IODESC_MAX_IDS; i++)
@@ -2817,6 +3200,21 @@ int PIOc_openfile_retry(int iosysid, int *ncidp, int *iotype, const char *filena
         }
     }
 
+    /* The file could be a staged file that was closed, drain the data
+     * staged for closed files before opening it. */
+    if (ios->stage_nfiles > 0)
+    {
+        if (ios->ioproc && ios->stage_pending)
+            ierr = pio_stage_drain_pending(ios);
+        ierr = check_netcdf(ios, NULL, ierr, __FILE__, __LINE__);
+        if (ierr != PIO_NOERR)
+        {
+            free(file);
+            return pio_err(ios, NULL, ierr, __FILE__, __LINE__,
+                            "Opening file (%s) failed. Draining the data staged for closed files failed", filename);
+        }
+    }
+
     /* If this is an IO task, then call the netCDF function. */
     if (ios->ioproc)
     {
@@ -2860,10 +3258,25 @@ int PIOc_openfile_retry(int iosysid, int *ncidp, int *iotype, const char *filena
             if (ios->io_rank == 0)
                 ierr = nc_open(filename, file->mode, &file->fh);
             break;
+
+        case PIO_IOTYPE_MEMORY:
+            /* Each I/O task reads the file into memory, changes to the
+             * file are not written back to disk. */
+            imode = file->mode | NC_DISKLESS;
+            if ((ierr = nc_open(filename, imode, &file->fh)))
+                break;
+            file->mode = imode;
+            break;
 #endif /* _NETCDF */
 
 #ifdef _PNETCDF
         case PIO_IOTYPE_PNETCDF:
+        {
+            int is_subfiled = 0;
+
+            /* Subfiled datasets are read through their index. */
+            if ((ierr = pio_subfile_open(file, filename, &is_subfiled)) || is_subfiled)
+                break;
             ierr = ncmpi_open(ios->io_comm, filename, file->mode, ios->info, &file->fh);
 
             // This should only be done with a file opened to append
@@ -2872,9 +3285,12 @@ int PIOc_openfile_retry(int iosysid, int *ncidp, int *iotype, const char *filena
                 if (ios->iomaster == MPI_ROOT)
                     LOG((2, "%d Setting IO buffer %ld", __LINE__, pio_buffer_size_limit));
                 ierr = ncmpi_buffer_attach(file->fh, pio_buffer_size_limit);
+                if (!ierr)
+                    pio_mem_account(ios, file, PIO_MEM_ATTACH, pio_buffer_size_limit);
             }
             LOG((2, "ncmpi_open(%s) : fd = %d", filename, file->fh));
             break;
+        }
 #endif
 
         default:
@@ -2899,7 +3315,8 @@ int PIOc_openfile_retry(int iosysid, int *ncidp, int *iotype, const char *filena
             if(mpierr != MPI_SUCCESS){
                 return check_mpi(NULL, file, ierr, __FILE__, __LINE__);
             }
-            if ((ierr != NC_NOERR) && (file->iotype != PIO_IOTYPE_NETCDF))
+            if ((ierr != NC_NOERR) && (file->iotype != PIO_IOTYPE_NETCDF) &&
+                (file->iotype != PIO_IOTYPE_MEMORY))
             {
                 /* reset file markers for NETCDF on all tasks */
                 file->iotype = PIO_IOTYPE_NETCDF;
@@ -3144,8 +3561,18 @@ int pioc_change_def(int ncid, int is_enddef)
                 ierr = ncmpi_redef(file->fh);
         }
 #endif /* _PNETCDF */
+#ifdef _HDF5
+        if (file->iotype == PIO_IOTYPE_HDF5)
+        {
+            if (is_enddef)
+                ierr = pio_hdf5_enddef(file);
+            else
+                ierr = pio_hdf5_redef(file);
+        }
+#endif /* _HDF5 */
 #ifdef _NETCDF
-        if (file->iotype != PIO_IOTYPE_PNETCDF && file->iotype != PIO_IOTYPE_ADIOS && file->do_io)
+        if (file->iotype != PIO_IOTYPE_PNETCDF && file->iotype != PIO_IOTYPE_ADIOS &&
+            file->iotype != PIO_IOTYPE_HDF5 && file->do_io)
         {
             if (is_enddef)
             {
@@ -3158,7 +3585,17 @@ int pioc_change_def(int ncid, int is_enddef)
 #endif /* _NETCDF */
     }
 
-    ierr = check_netcdf(NULL, file, ierr, __FILE__, __LINE__);
+    if (is_enddef)
+    {
+        /* With PIO_DEFER_ERROR the errors recorded since the last
+         * sync point (e.g. when defining variables and attributes)
+         * are checked here, using a single collective call */
+        ierr = check_netcdf_defer(file, ierr, __FILE__, __LINE__);
+        if (ierr == PIO_NOERR)
+            ierr = pio_check_deferred_errors(file);
+    }
+    else
+        ierr = check_netcdf(NULL, file, ierr, __FILE__, __LINE__);
     if(ierr != PIO_NOERR){
       return pio_err(ios, file, ierr, __FILE__, __LINE__,
                       "Changing the define mode for file (%s) failed. Low-level I/O library API failed", pio_get_fname_from_file(file));
@@ -3183,6 +3620,10 @@ int iotype_is_valid(int iotype)
 #ifdef _NETCDF
     if (iotype == PIO_IOTYPE_NETCDF)
         ret++;
+
+    /* The in-memory iotypes use diskless netCDF files. */
+    if (iotype == PIO_IOTYPE_MEMORY || iotype == PIO_IOTYPE_NULL)
+        ret++;
 #endif /* _NETCDF */
 
     /* Some builds include netCDF-4. */
@@ -3202,6 +3643,11 @@ int iotype_is_valid(int iotype)
         ret++;
 #endif
 
+#ifdef _HDF5
+    if (iotype == PIO_IOTYPE_HDF5)
+        ret++;
+#endif
+
     return ret;
 }
 
@@ -3437,6 +3883,179 @@ int PIOc_set_rearr_opts(int iosysid, int comm_type, int fcd, bool enable_hs_c2i,
     return ret;
 }
 
+/**
+ * Enable or disable the tuning of the rearranger options of the
+ * decompositions initialized in an IO system. When enabled, the data
+ * exchanges between the compute and IO tasks of each new
+ * decomposition are timed, at the end of PIOc_InitDecomp(), with
+ * collective and point-to-point communication and different flow
+ * control options, and the fastest options are used for the
+ * decomposition. The chosen options are logged, so they can be set
+ * with PIOc_set_rearr_opts() in later runs.
+ *
+ * Tuning is not supported with asynchronous I/O.
+ *
+ * @param iosysid the IO system ID.
+ * @param enable non-zero to tune the rearranger options, 0 to use
+ * the options of the IO system.
+ * @return PIO_NOERR for success, otherwise an error code.
+ */
+int PIOc_set_rearr_autotune(int iosysid, int enable)
+{
+    iosystem_desc_t *ios;
+
+    /* Get the IO system info. */
+    if (!(ios = pio_get_iosystem_from_id(iosysid)))
+    {
+        return pio_err(NULL, NULL, PIO_EBADID, __FILE__, __LINE__,
+                        "Setting rearranger tuning failed. Invalid iosystem id (%d) provided", iosysid);
+    }
+
+    if (ios->async && enable)
+    {
+        return pio_err(ios, NULL, PIO_EINVAL, __FILE__, __LINE__,
+                        "Setting rearranger tuning failed. Tuning the rearranger options is not supported with asynchronous I/O");
+    }
+
+    ios->rearr_autotune = enable ? 1 : 0;
+
+    return PIO_NOERR;
+}
+
+/**
+ * Enable or disable packed messages in the rearrangers of the
+ * decompositions initialized in an IO system. When enabled, the data
+ * sent between the compute and IO tasks is gathered into contiguous
+ * buffers, one per peer, and exchanged as plain bytes, instead of
+ * being described by MPI derived datatypes. The data is scattered
+ * from the receive buffers with the same precomputed runs of
+ * elements. This is often faster with MPI libraries that pack derived
+ * datatypes one element at a time, at the cost of the send and
+ * receive buffers.
+ *
+ * Packed messages are not supported with asynchronous I/O.
+ *
+ * @param iosysid the IO system ID.
+ * @param enable non-zero to pack the rearranged data of new
+ * decompositions, 0 to use MPI derived datatypes.
+ * @return PIO_NOERR for success, otherwise an error code.
+ */
+int PIOc_set_rearr_pack(int iosysid, int enable)
+{
+    iosystem_desc_t *ios;
+
+    /* Get the IO system info. */
+    if (!(ios = pio_get_iosystem_from_id(iosysid)))
+    {
+        return pio_err(NULL, NULL, PIO_EBADID, __FILE__, __LINE__,
+                        "Setting packed rearranger messages failed. Invalid iosystem id (%d) provided", iosysid);
+    }
+
+    if (ios->async && enable)
+    {
+        return pio_err(ios, NULL, PIO_EINVAL, __FILE__, __LINE__,
+                        "Setting packed rearranger messages failed. Packed messages are not supported with asynchronous I/O");
+    }
+
+    ios->rearr_pack = enable ? 1 : 0;
+
+    return PIO_NOERR;
+}
+
+/**
+ * Set the number of OpenMP threads used on the IO tasks of an IO
+ * system. The threads unpack the messages received from the compute
+ * tasks into the IO buffer (and pack the messages sent to them) when
+ * the data is rearranged with packed messages (see
+ * PIOc_set_rearr_pack()), initialize the IO buffers with fill values
+ * and convert the data between the user and variable types.
+ *
+ * The setting has no effect unless the library is built with OpenMP
+ * (PIO_USE_OPENMP). By default the IO tasks use a single thread.
+ *
+ * @param iosysid the IO system ID.
+ * @param nthreads the number of threads, 0 to use the OpenMP default
+ * (for example OMP_NUM_THREADS).
+ * @return PIO_NOERR for success, otherwise an error code.
+ */
+int PIOc_set_io_nthreads(int iosysid, int nthreads)
+{
+    iosystem_desc_t *ios;
+
+    /* Get the IO system info. */
+    if (!(ios = pio_get_iosystem_from_id(iosysid)))
+    {
+        return pio_err(NULL, NULL, PIO_EBADID, __FILE__, __LINE__,
+                        "Setting the number of IO threads failed. Invalid iosystem id (%d) provided", iosysid);
+    }
+
+    if (nthreads < 0)
+    {
+        return pio_err(ios, NULL, PIO_EINVAL, __FILE__, __LINE__,
+                        "Setting the number of IO threads failed. Invalid number of threads (%d) provided", nthreads);
+    }
+
+#if PIO_USE_OPENMP
+    ios->io_nthreads = nthreads ? nthreads : omp_get_max_threads();
+#else
+    LOG((1, "The library is not built with OpenMP, the IO tasks use a single thread"));
+    ios->io_nthreads = 1;
+#endif
+
+    return PIO_NOERR;
+}
+
+/**
+ * Get the number of threads this task uses to rearrange, fill and
+ * convert data (see PIOc_set_io_nthreads()).
+ *
+ * @param ios pointer to the iosystem_desc_t struct.
+ * @returns the number of threads, 1 on compute only tasks.
+ */
+int pio_io_nthreads(const iosystem_desc_t *ios)
+{
+    return (ios->ioproc && ios->io_nthreads > 1) ? ios->io_nthreads : 1;
+}
+
+/**
+ * Enable or disable huge pages for the large buffers (2 MB or more)
+ * of the files of an IO system, such as the buffers caching the data
+ * written with PIOc_write_darray() and the IO buffers. Huge pages
+ * reduce the TLB misses when the buffers are packed and rearranged.
+ * The pages are requested with MAP_HUGETLB, or with
+ * madvise(MADV_HUGEPAGE) if no huge pages are reserved on the
+ * system; they are not used if the library uses malloc
+ * (PIO_USE_MALLOC) or the system does not support them.
+ *
+ * The setting applies to the buffers allocated after the call. By
+ * default huge pages are not used.
+ *
+ * @param iosysid the IO system ID.
+ * @param enable non-zero to use huge pages, 0 otherwise.
+ * @return PIO_NOERR for success, otherwise an error code.
+ */
+int PIOc_set_buffer_hugepages(int iosysid, int enable)
+{
+    iosystem_desc_t *ios;
+
+    /* Get the IO system info. */
+    if (!(ios = pio_get_iosystem_from_id(iosysid)))
+    {
+        return pio_err(NULL, NULL, PIO_EBADID, __FILE__, __LINE__,
+                        "Setting huge pages for the buffers failed. Invalid iosystem id (%d) provided", iosysid);
+    }
+
+    if (!ios->arena && pio_arena_create(&ios->arena))
+    {
+        return pio_err(ios, NULL, PIO_ENOMEM, __FILE__, __LINE__,
+                        "Setting huge pages for the buffers failed. Out of memory allocating the buffer arena");
+    }
+
+    pio_arena_set_hugepages(ios->arena, enable);
+
+    return PIO_NOERR;
+}
+
 /* Calculate and cache the variable record size 
  * for the variable corresponding to varid
  * Note: Since this function calls many PIOc_* functions
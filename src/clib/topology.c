@@ -1,363 +1,258 @@
-#if defined(BGQDONT)
-
+/**
+ * @file
+ * Node topology aware selection of I/O tasks.
+ *
+ * By default the I/O tasks in an I/O system are placed using a base
+ * rank and a stride (see PIOc_Init_Intracomm()). Depending on how the
+ * MPI processes are mapped to the compute nodes this can place
+ * several I/O tasks on one node (sharing the network interface on
+ * that node) while other nodes have no I/O tasks.
+ *
+ * The functions here discover the compute nodes using
+ * MPI_Comm_split_type(MPI_COMM_TYPE_SHARED) and spread the I/O tasks
+ * evenly across the nodes. Within a node the I/O tasks are evenly
+ * spaced across the local ranks, so with the typical (block) mapping
+ * of MPI processes to cores the I/O tasks on a node are also spread
+ * across the sockets in the node.
+ */
+#include <pio_config.h>
 #include <pio.h>
 #include <pio_internal.h>
 
-#include <math.h>
-
-#include <kernel/process.h>
-#include <kernel/location.h>
-#include <firmware/include/personality.h>
-#include <mpix.h>
-
-#define   Personality                    Personality_t
-
-int rank;
-int np;
-int my_name_len;
-char my_name[255];
-
-void identity(const MPI_Comm comm, int *iotask)
+/** The placement of I/O tasks used by PIOc_Init_Intracomm(),
+ * see PIOc_set_iotask_placement(). */
+static int pio_iotask_placement = PIO_IOTASK_PLACEMENT_STRIDE;
+
+/** Number of I/O tasks per node with PIO_IOTASK_PLACEMENT_NODE, if
+ * 0 the number of I/O tasks passed to PIOc_Init_Intracomm() is
+ * spread evenly across the nodes. */
+static int pio_niotasks_per_node = 0;
+
+/**
+ * Set the placement of I/O tasks for I/O systems subsequently
+ * created with PIOc_Init_Intracomm().
+ *
+ * With PIO_IOTASK_PLACEMENT_STRIDE (the default) the I/O tasks are
+ * placed using the base and stride passed to PIOc_Init_Intracomm().
+ *
+ * With PIO_IOTASK_PLACEMENT_NODE the base and stride are ignored and
+ * the I/O tasks are spread evenly across the compute nodes. If
+ * niotasks_per_node > 0, niotasks_per_node I/O tasks are reserved
+ * on each node (or all the tasks on the node, if the node has fewer
+ * tasks) and the number of I/O tasks passed to PIOc_Init_Intracomm()
+ * is ignored. Otherwise the number of I/O tasks passed to
+ * PIOc_Init_Intracomm() is spread evenly across the nodes.
+ *
+ * @param placement the placement of the I/O tasks,
+ * PIO_IOTASK_PLACEMENT_STRIDE or PIO_IOTASK_PLACEMENT_NODE.
+ * @param niotasks_per_node the number of I/O tasks on each node, or
+ * 0 to spread the requested number of I/O tasks across the nodes.
+ * Only used with PIO_IOTASK_PLACEMENT_NODE.
+ * @returns 0 for success, error code otherwise.
+ * @ingroup PIO_init
+ */
+int PIOc_set_iotask_placement(int placement, int niotasks_per_node)
 {
-    MPIX_Hardware_t hw;
-    char message[100];
-    /* Number of MPI tasks per Pset */
-    int coreId;
-    int *TasksPerPset;
-    int *tmp;
-    int i,ierr;
-    Personality_t pers;
-
-    MPI_Comm_rank(comm,&rank);
-    MPI_Comm_size(comm,&np);
-    MPI_Get_processor_name(my_name, &my_name_len);
-
-
-    MPIX_Hardware(&hw);
-
-    Kernel_GetPersonality(&pers, sizeof(pers));
-
-    int numIONodes,numPsets,numNodesInPset,rankInPset;
-    int numpsets, psetID, psetsize, psetrank;
-
-    bgq_pset_info (comm, &numpsets, &psetID, &psetsize, &psetrank);
-
-    numIONodes = numpsets;
-    numNodesInPset = psetsize;
-    rankInPset = rank;
-    numPsets = numpsets;
-
-    if(rank == 0) { printf("number of IO nodes in block: %i \n",numIONodes);}
-    if(rank == 0) { printf("number of Psets in block : %i \n",numPsets);}
-    if(rank == 0) { printf("number of compute nodes in Pset: %i \n",numNodesInPset);}
-
-    int psetNum;
-    psetNum = psetID;
-
-#ifdef DEBUG
-    if((*iotask)>0) {
-        printf( "%04i (%-50s %s) %i yes\n", rank, my_name, message, psetNum );
-    } else {
-        printf( "%04i (%-50s %s) %i --\n", rank, my_name, message, psetNum);
-    }
-    printf("MPI task %6i is rank %3i in Pset: %3i \n",rank, rankInPset,psetNum);
-#endif
-    /* Determine which core on node....  I don't want to put more than one io-task per node */
-    coreId = Kernel_PhysicalProcessorID ();
-
-    TasksPerPset = malloc(numPsets*sizeof(int));
-    tmp = malloc(numPsets*sizeof(int));
-    for(i=0;i<numPsets;i++) tmp[i]=0;
-    if(coreId == 0) {tmp[psetNum]=1;}
-    ierr = MPI_Allreduce(tmp,TasksPerPset,numPsets,MPI_INT,MPI_SUM,comm);
-    if(rank == 0) {
-        for(i=0;i<numPsets;i++) {printf("Pset: %3i has %3i nodes \n",i,TasksPerPset[i]);}
+    if ((placement != PIO_IOTASK_PLACEMENT_STRIDE) && (placement != PIO_IOTASK_PLACEMENT_NODE))
+    {
+        return pio_err(NULL, NULL, PIO_EINVAL, __FILE__, __LINE__,
+                        "Setting the placement of I/O tasks failed. Invalid placement (%d) specified", placement);
     }
-    free(tmp);
-    free(TasksPerPset);
-}
-
-void determineiotasks(const MPI_Comm comm, int *numiotasks,int *base, int *stride, int *rearr,
-                      bool *iamIOtask)
-{
-
-/*
-
-  Returns the correct numiotasks and the flag iamIOtask
-
-  Some concepts:
-
-  processor set:     A group of processors on the Blue Gene system which have
-  one or more IO processor (Pset)
-
-  IO-node:           A special Blue Gene node dedicated to performing IO.  There
-  are one or more per processor set
-
-  IO-client:         This is software concept.  This refers to the MPI task
-  which performs IO for the PIO library
-*/
-    int psetNum;
-    int coreId;
-    int iam;
-    int task_count;
-
-    MPIX_Hardware_t hw;
-    /*  Get the personality  */
-    Personality_t pers;
-
-    MPIX_Hardware(&hw);
-
-    MPI_Comm_rank(comm, &rank);
-
-    MPI_Comm_size(comm, &np);
-
-    MPI_Get_processor_name(my_name, &my_name_len);
-
-
-
-    /* printf("Determine io tasks: proc %i: tasks= %i numiotasks=%i stride= %i \n", rank, np, (*numiotasks), (*stride)); */
-
-    if((*rearr) > 0) {
-
-
-        Kernel_GetPersonality(&pers, sizeof(pers));
-
-        int numIONodes,numPsets,numNodesInPset,rankInPset;
-        int numiotasks_per_node,remainder,numIONodes_per_pset;
-        int lstride;
-
-        /* Number of computational nodes in processor set */
-
-        int numpsets, psetID, psetsize, psetrank;
-        bgq_pset_info (comm,&numpsets, &psetID, &psetsize, &psetrank);
-        numIONodes = numpsets;
-        numNodesInPset = psetsize;
-
-        /*     printf("Determine io tasks: me %i : nodes in pset= %i ionodes = %i\n", rank, numNodesInPset, numIONodes); */
-
-        if((*numiotasks) < 0 ) {
-            /* negative numiotasks value indicates that this is the number per IO-node */
-            (*numiotasks) = - (*numiotasks);
-            if((*numiotasks) > numNodesInPset) {
-                numiotasks_per_node = numNodesInPset;
-            } else  {
-                numiotasks_per_node = (*numiotasks);
-            }
-            remainder = 0;
-        } else if ((*numiotasks) > 0 ) {
-            /* balance the number of iotasks to number of IO nodes */
-            numiotasks_per_node = floor((float)(*numiotasks)/ (float) numIONodes);
-            /* put a minumum here so that we have a chance  - though this may be too low */
-            if (numiotasks_per_node < 1) {
-                numiotasks_per_node = 1;
-                *numiotasks = numIONodes;
-            }
-            remainder = (*numiotasks) - numiotasks_per_node * numIONodes;
-        } else if ((*numiotasks) == 0 ) {
-            if((*stride) > 0) {
-                numiotasks_per_node = numNodesInPset/(*stride);
-                if (numiotasks_per_node < 1) {
-                    numiotasks_per_node = 1;
-                    *numiotasks = numIONodes;
-                }
-            } else {
-                numiotasks_per_node = 8;  /* default number of IO-client per IO-node is not otherwise specificied */
-            }
-            remainder = 0;
-        }
-
-        /* number of IO nodes with a larger number of io-client per io-node */
-        if(remainder > 0) {
-            if(rank ==0) {printf("Unbalanced IO-configuration: %i IO-nodes have %i IO-clients : %i IO-nodes have %i IO-clients \n",
-                                 remainder, numiotasks_per_node+1, numIONodes-remainder,numiotasks_per_node);}
-            lstride = min(np,floor((float)numNodesInPset/(float)(numiotasks_per_node+1)));
-        } else {
-            if(rank == 0) {
-                printf("Balanced IO-configuration: %i IO-nodes have %i IO-clients\n",numIONodes-remainder, numiotasks_per_node);
-            }
-            lstride = min(np,floor((float)numNodesInPset/(float)numiotasks_per_node));
-        }
-
-        /* Number of processor sets */
-        numPsets = numpsets;
-
-        /* number of IO nodes in processor set (I need to add
-           code to deal with the case where numIONodes_per_pset != 1 works
-           correctly) */
-        numIONodes_per_pset = numIONodes/numPsets;
-
-        /* Determine which core on node....  I don't want to put more than one io-task per node */
-        coreId = Kernel_PhysicalProcessorID ();
-
-        /* What is the rank of this node in the processor set */
-
-        psetNum = psetID;
-        rankInPset = psetrank;
-
-        /* printf("Pset #: %i has %i nodes in Pset; base = %i\n",psetNum,numNodesInPset, *base); */
-
-        (*iamIOtask) = false;   /* initialize to zero */
-
-        if (numiotasks_per_node == numNodesInPset)(*base) = 0;  /* Reset the base to 0 if we are using all tasks */
-
-
-        /* start stridding MPI tasks from base task */
-        iam = max(0,rankInPset-(*base));
-        if (iam >= 0)  {
-            /* mark tasks that will be IO-tasks  or IO-clients */
-            /*    printf("iam = %d lstride = %d coreID = %d\n",iam,lstride,coreId); */
-            if((iam % lstride == 0) && (coreId == 0) ) {  /* only io tasks indicated by stride and coreId = 0 */
-                if((iam/lstride) < numiotasks_per_node) {
-                    /* only set the first (numiotasks_per_node - 1) tasks */
-                    (*iamIOtask) = true;
-                } else if ((iam/lstride) == numiotasks_per_node) {
-                    /*  If there is an uneven number of io-clients to io-nodes
-                        allocate the first remainder - 1 processor sets to
-                        have a total of numiotasks_per_node */
-                    if(psetNum < remainder) {(*iamIOtask) = true;
-                    };
-                }
-            }
-            /*       printf("comm = %d iam = %d lstride = %d coreID = %d iamIOtask = %i \n",comm, iam,lstride,coreId,(*iamIOtask)); */
-        }
-    }else{
-        /* We are not doing rearrangement.... so all tasks are io-tasks */
-        (*iamIOtask) = true;
+    if (niotasks_per_node < 0)
+    {
+        return pio_err(NULL, NULL, PIO_EINVAL, __FILE__, __LINE__,
+                        "Setting the placement of I/O tasks failed. Invalid number of I/O tasks per node (%d) specified, expected >= 0", niotasks_per_node);
     }
 
-    /*printf("comm = %d myrank = %i iotask = %i \n", comm, rank, (*iamIOtask));*/
-
-    /* now we need to correctly determine the numiotasks */
-    MPI_Allreduce(iamIOtask, &task_count, 1, MPI_INT, MPI_SUM, comm);
-
-    (*numiotasks) = task_count;
-
+    LOG((1, "PIOc_set_iotask_placement placement = %d niotasks_per_node = %d",
+         placement, niotasks_per_node));
+    pio_iotask_placement = placement;
+    pio_niotasks_per_node = niotasks_per_node;
 
+    return PIO_NOERR;
 }
 
-int bgq_ion_id (void)
-{
-    int iA,  iB,  iC,  iD,  iE;                /* The local node's coordinates  */
-    int nA,  nB,  nC,  nD,  nE;                /* Size of each torus dimension  */
-    int brA, brB, brC, brD, brE;               /* The bridge node's coordinates */
-    int io_node_route_id;
-
-    Personality_t personality;
-
-    Kernel_GetPersonality(&personality, sizeof(personality));
-
-    iA  = personality.Network_Config.Acoord;
-    iB  = personality.Network_Config.Bcoord;
-    iC  = personality.Network_Config.Ccoord;
-    iD  = personality.Network_Config.Dcoord;
-    iE  = personality.Network_Config.Ecoord;
-
-    nA  = personality.Network_Config.Anodes;
-    nB  = personality.Network_Config.Bnodes;
-    nC  = personality.Network_Config.Cnodes;
-    nD  = personality.Network_Config.Dnodes;
-    nE  = personality.Network_Config.Enodes;
-
-    brA = personality.Network_Config.cnBridge_A;
-    brB = personality.Network_Config.cnBridge_B;
-    brC = personality.Network_Config.cnBridge_C;
-    brD = personality.Network_Config.cnBridge_D;
-    brE = personality.Network_Config.cnBridge_E;
-
-/*
- * This is the bridge node, numbered in ABCDE order, E increments first.
- * It is considered the unique "io node route identifer" because each
- * bridge node only has one torus link to one io node.
+/**
+ * Get the placement of I/O tasks, set using PIOc_set_iotask_placement().
+ *
+ * @param placementp pointer that gets the placement of I/O tasks.
+ * Ignored if NULL.
+ * @param niotasks_per_nodep pointer that gets the number of I/O tasks
+ * per node. Ignored if NULL.
+ * @returns 0 for success, error code otherwise.
  */
+int pio_get_iotask_placement(int *placementp, int *niotasks_per_nodep)
+{
+    if (placementp)
+        *placementp = pio_iotask_placement;
+    if (niotasks_per_nodep)
+        *niotasks_per_nodep = pio_niotasks_per_node;
 
-    io_node_route_id = brE + brD*nE + brC*nD*nE + brB*nC*nD*nE + brA*nB*nC*nD*nE;
-
-    return io_node_route_id;
-
+    return PIO_NOERR;
 }
 
-
-
-int bgq_pset_info (MPI_Comm comm, int* tot_pset, int* psetID, int* pset_size, int* rank_in_pset)
+/**
+ * Find the ranks of the I/O tasks, spread evenly across the compute
+ * nodes.
+ *
+ * The nodes are discovered using MPI_Comm_split_type() with
+ * MPI_COMM_TYPE_SHARED. The nodes are ordered by the lowest rank (in
+ * comm) on the node and the I/O tasks are distributed across the
+ * nodes in a round robin manner. Within a node with nlocal tasks and
+ * c I/O tasks, the tasks with local ranks (j * nlocal) / c, j = 0,
+ * ..., c - 1, are chosen as I/O tasks.
+ *
+ * This function is collective on comm.
+ *
+ * @param comm the communicator containing all the tasks (the compute
+ * communicator).
+ * @param num_iotasks the number of I/O tasks requested. Ignored if
+ * niotasks_per_node > 0.
+ * @param niotasks_per_node the number of I/O tasks on each node, if
+ * > 0.
+ * @param num_iotasksp pointer that gets the number of I/O tasks.
+ * @param ioranksp pointer that gets an array (allocated here, freed
+ * by the caller using free()) of ranks, in ascending order, in comm
+ * of the I/O tasks.
+ * @returns 0 for success, error code otherwise.
+ */
+int pio_get_node_ioranks(MPI_Comm comm, int num_iotasks, int niotasks_per_node,
+                         int *num_iotasksp, int **ioranksp)
 {
-    MPI_Comm comp_comm, pset_comm, bridge_comm;
-    int comp_rank, status, key, bridge_root, tot_bridges, cur_pset, itr, t_buf;
-    int temp_id, rem_psets;
-    MPI_Status mpi_status;
-
-    MPI_Comm_rank (comm, &comp_rank);
-
-    status = MPI_Comm_dup ( comm, &comp_comm);
-    if ( MPI_SUCCESS != status)
+    MPI_Comm node_comm = MPI_COMM_NULL;
+    int rank, nprocs;
+    int node_rank, node_root;
+    int info[2];
+    int *all_info = NULL;  /* (node root rank, rank in node) for each task */
+    int *node_nprocs = NULL;  /* Number of tasks in each node */
+    int *node_niotasks = NULL;  /* Number of I/O tasks in each node */
+    int *node_idx = NULL;  /* Index of the node for each node root rank */
+    int nnodes = 0;
+    int niotasks = 0;
+    int mpierr = MPI_SUCCESS;
+    int ret = PIO_NOERR;
+
+    pioassert(num_iotasksp && ioranksp, "invalid input", __FILE__, __LINE__);
+
+    if ((mpierr = MPI_Comm_rank(comm, &rank)))
+        return check_mpi(NULL, NULL, mpierr, __FILE__, __LINE__);
+    if ((mpierr = MPI_Comm_size(comm, &nprocs)))
+        return check_mpi(NULL, NULL, mpierr, __FILE__, __LINE__);
+
+    /* Find the tasks on this node, and the rank (in comm) of the root
+     * of the node */
+    if ((mpierr = MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &node_comm)))
+        return check_mpi(NULL, NULL, mpierr, __FILE__, __LINE__);
+    if ((mpierr = MPI_Comm_rank(node_comm, &node_rank)))
+        return check_mpi(NULL, NULL, mpierr, __FILE__, __LINE__);
+    node_root = rank;
+    if ((mpierr = MPI_Bcast(&node_root, 1, MPI_INT, 0, node_comm)))
+        return check_mpi(NULL, NULL, mpierr, __FILE__, __LINE__);
+    if ((mpierr = MPI_Comm_free(&node_comm)))
+        return check_mpi(NULL, NULL, mpierr, __FILE__, __LINE__);
+
+    /* Share the node info with all tasks, so that all tasks can
+     * compute the ranks of the I/O tasks */
+    all_info = malloc(2 * nprocs * sizeof(int));
+    node_nprocs = calloc(nprocs, sizeof(int));
+    node_niotasks = calloc(nprocs, sizeof(int));
+    node_idx = malloc(nprocs * sizeof(int));
+    if (!all_info || !node_nprocs || !node_niotasks || !node_idx)
     {
-        printf(" Error duplicating communicator \n");
-        MPI_Abort(comm, status);
+        ret = pio_err(NULL, NULL, PIO_ENOMEM, __FILE__, __LINE__,
+                        "Finding node topology aware I/O tasks failed. Out of memory allocating %lld bytes for node info", (unsigned long long) (5 * nprocs * sizeof(int)));
+        free(node_idx);
+        free(node_niotasks);
+        free(node_nprocs);
+        free(all_info);
+        return ret;
     }
-
-    // Compute the ION BridgeNode ID
-    key = bgq_ion_id ();
-
-    // Create the pset_comm per bridge node
-    status = MPI_Comm_split ( comp_comm, key, comp_rank, &pset_comm);
-    if ( MPI_SUCCESS != status)
+    info[0] = node_root;
+    info[1] = node_rank;
+    if ((mpierr = MPI_Allgather(info, 2, MPI_INT, all_info, 2, MPI_INT, comm)))
     {
-        printf(" Error splitting communicator \n");
-        MPI_Abort(comm, status);
+        ret = check_mpi(NULL, NULL, mpierr, __FILE__, __LINE__);
+        free(node_idx);
+        free(node_niotasks);
+        free(node_nprocs);
+        free(all_info);
+        return ret;
     }
 
-    // Calculate the rank in pset and pset size
-    MPI_Comm_rank (pset_comm, rank_in_pset);
-    MPI_Comm_size (pset_comm, pset_size);
-
-    // Create the Bridge root nodes communicator
-    bridge_root = 0;
-    if (0 == *rank_in_pset)
-        bridge_root = 1;
-
-    // Calculate the total number of bridge nodes / psets
-    tot_bridges = 0;
-    MPI_Allreduce (&bridge_root, &tot_bridges, 1, MPI_INT, MPI_SUM, comm);
-
-    *tot_pset = tot_bridges;
-
-    // Calculate the Pset ID
-    cur_pset = 0;
-    rem_psets = tot_bridges;
-    if ((0 == comp_rank) && (bridge_root ==1))
+    /* Number the nodes in the order of the node roots (the root of a
+     * node is the task with the lowest rank in the node) */
+    for (int i = 0; i < nprocs; i++)
+        node_idx[i] = -1;
+    for (int i = 0; i < nprocs; i++)
     {
-        *psetID = 0;
-        rem_psets = tot_bridges-1;
-        cur_pset++;
+        int root = all_info[2 * i];
+        if (node_idx[root] == -1)
+            node_idx[root] = nnodes++;
+        node_nprocs[node_idx[root]]++;
     }
 
-    t_buf = 0; // Dummy value
-    if (0 == comp_rank)
+    /* Number of I/O tasks on each node */
+    if (niotasks_per_node > 0)
     {
-        for (itr = 0; itr < rem_psets; itr++)
+        for (int n = 0; n < nnodes; n++)
         {
-            MPI_Recv (&t_buf,1, MPI_INT,  MPI_ANY_SOURCE, MPI_ANY_TAG,comm, &mpi_status);
-            MPI_Send (&cur_pset, 1, MPI_INT, mpi_status.MPI_SOURCE, 0, comm);
-            cur_pset++;
+            node_niotasks[n] = (niotasks_per_node < node_nprocs[n]) ? niotasks_per_node : node_nprocs[n];
+            niotasks += node_niotasks[n];
         }
     }
-
-    if ((1 == bridge_root) && ( 0 != comp_rank))
+    else
     {
-        MPI_Send (&t_buf, 1, MPI_INT, 0, 0, comm);
-        MPI_Recv (&temp_id,1, MPI_INT, 0, 0, comm, &mpi_status);
+        /* Round robin across the nodes, skipping full nodes */
+        if (num_iotasks > nprocs)
+            num_iotasks = nprocs;
+        for (int n = 0; niotasks < num_iotasks; n = (n + 1) % nnodes)
+        {
+            if (node_niotasks[n] < node_nprocs[n])
+            {
+                node_niotasks[n]++;
+                niotasks++;
+            }
+        }
+    }
+    LOG((2, "pio_get_node_ioranks nnodes = %d niotasks = %d", nnodes, niotasks));
 
-        *psetID = temp_id;
-        /*printf (" Pset ID is %d \n", *psetID);*/
+    if (!(*ioranksp = malloc(niotasks * sizeof(int))))
+    {
+        ret = pio_err(NULL, NULL, PIO_ENOMEM, __FILE__, __LINE__,
+                        "Finding node topology aware I/O tasks failed. Out of memory allocating %lld bytes for I/O task ranks", (unsigned long long) (niotasks * sizeof(int)));
+        free(node_idx);
+        free(node_niotasks);
+        free(node_nprocs);
+        free(all_info);
+        return ret;
     }
-    // Broadcast the PSET ID to all ranks in the psetcomm
-    MPI_Bcast ( psetID, 1, MPI_INT, 0, pset_comm);
 
-    // Free the split comm
-    MPI_Comm_free (&pset_comm);
+    /* Pick evenly spaced local ranks on each node, the ranks are
+     * in ascending order since we loop over the tasks in comm */
+    *num_iotasksp = 0;
+    for (int i = 0; i < nprocs; i++)
+    {
+        int n = node_idx[all_info[2 * i]];
+        int lrank = all_info[2 * i + 1];
+        int c = node_niotasks[n];
+
+        /* Is lrank == (j * node_nprocs[n]) / c for some j < c ? */
+        if (c > 0)
+        {
+            int j = (int)(((long long)lrank * c + node_nprocs[n] - 1) / node_nprocs[n]);
+            if ((j < c) && ((int)(((long long)j * node_nprocs[n]) / c) == lrank))
+            {
+                (*ioranksp)[(*num_iotasksp)++] = i;
+                LOG((3, "I/O task %d : rank = %d node = %d local rank = %d", *num_iotasksp - 1, i, n, lrank));
+            }
+        }
+    }
+    pioassert(*num_iotasksp == niotasks, "Incorrect number of I/O tasks", __FILE__, __LINE__);
 
-    MPI_Barrier (comm);
+    free(node_idx);
+    free(node_niotasks);
+    free(node_nprocs);
+    free(all_info);
 
-    return 0;
+    return ret;
 }
-
-#endif
@@ -0,0 +1,253 @@
+/*
+ * Tests for the size-class arena of the buffers of an IO system
+ * (pio_arena.c).
+ */
+#include <pio.h>
+#include <pio_tests.h>
+#include <pio_internal.h>
+
+/* The number of tasks this test should run on. */
+#define TARGET_NTASKS 4
+
+/* The minimum number of tasks this test should run on. */
+#define MIN_NTASKS 1
+
+/* The name of this test. */
+#define TEST_NAME "test_arena"
+
+/* Bytes in front of each block (ARENA_HDR_SZ of pio_arena.c). */
+#define HDR_SZ 16
+
+/* The largest size class, and the rounding of larger blocks. */
+#define MAX_CLASS_SZ (1 << 20)
+
+/**
+ * Get a block and check the bytes it holds in the arena, including
+ * its header, then release it.
+ *
+ * @param arena pointer to the arena.
+ * @param size the size of the block.
+ * @param expected the bytes held by the block, unless the blocks are
+ * allocated for their exact size (PIO_USE_MALLOC).
+ * @param my_rank rank of this task.
+ * @returns 0 for success, error code otherwise.
+ */
+int check_block_size(pio_arena_t *arena, size_t size, PIO_Offset expected, int my_rank)
+{
+    PIO_Offset curalloc, totfree, maxfree;
+    long nget, nrel;
+    void *buf;
+
+    if (PIO_USE_MALLOC)
+        expected = size + HDR_SZ;
+
+    if (!(buf = pio_arena_alloc(arena, size)))
+        ERR(ERR_AWFUL);
+    memset(buf, 1, size);
+    pio_arena_stats(arena, &curalloc, &totfree, &maxfree, &nget, &nrel);
+    if (curalloc != expected)
+        ERR(ERR_WRONG);
+    pio_arena_release(arena, buf);
+
+    return PIO_NOERR;
+}
+
+/**
+ * Check the rounding of the blocks to the size classes: 64 bytes for
+ * the smallest class, four classes per power of two, and multiples of
+ * MAX_CLASS_SZ for blocks larger than the largest class.
+ *
+ * @param my_rank rank of this task.
+ * @returns 0 for success, error code otherwise.
+ */
+int test_classes(int my_rank)
+{
+    pio_arena_t *arena;
+    int ret;
+
+    if ((ret = pio_arena_create(&arena)))
+        ERR(ret);
+
+    if ((ret = check_block_size(arena, 1, 64, my_rank)))
+        return ret;
+    if ((ret = check_block_size(arena, 64 - HDR_SZ, 64, my_rank)))
+        return ret;
+    if ((ret = check_block_size(arena, 65 - HDR_SZ, 80, my_rank)))
+        return ret;
+    if ((ret = check_block_size(arena, 128 - HDR_SZ, 128, my_rank)))
+        return ret;
+    if ((ret = check_block_size(arena, 129 - HDR_SZ, 160, my_rank)))
+        return ret;
+    if ((ret = check_block_size(arena, MAX_CLASS_SZ - HDR_SZ, MAX_CLASS_SZ, my_rank)))
+        return ret;
+    if ((ret = check_block_size(arena, MAX_CLASS_SZ - HDR_SZ + 1, 2 * MAX_CLASS_SZ, my_rank)))
+        return ret;
+
+    pio_arena_free(arena);
+
+    return PIO_NOERR;
+}
+
+/**
+ * Check that a block is resized in place within its size class, and
+ * that released blocks are reused from the free list of their class
+ * and from the cache of large blocks.
+ *
+ * @param my_rank rank of this task.
+ * @returns 0 for success, error code otherwise.
+ */
+int test_reuse(int my_rank)
+{
+    pio_arena_t *arena;
+    char *buf, *buf2;
+    int ret;
+
+    if ((ret = pio_arena_create(&arena)))
+        ERR(ret);
+
+    /* Resize a block within its class (128 bytes), then beyond. */
+    if (!(buf = pio_arena_alloc(arena, 100)))
+        ERR(ERR_AWFUL);
+    for (int i = 0; i < 100; i++)
+        buf[i] = i;
+    if (!(buf2 = pio_arena_realloc(arena, buf, 128 - HDR_SZ)))
+        ERR(ERR_AWFUL);
+    if (!PIO_USE_MALLOC && buf2 != buf)
+        ERR(ERR_WRONG);
+    if (!(buf = pio_arena_realloc(arena, buf2, 128 - HDR_SZ + 1)))
+        ERR(ERR_AWFUL);
+    if (!PIO_USE_MALLOC && buf == buf2)
+        ERR(ERR_WRONG);
+    for (int i = 0; i < 100; i++)
+        if (buf[i] != i)
+            ERR(ERR_WRONG);
+    pio_arena_release(arena, buf);
+
+    /* A released block is reused by the next block of its class. */
+    if (!(buf = pio_arena_alloc(arena, 1000)))
+        ERR(ERR_AWFUL);
+    pio_arena_release(arena, buf);
+    if (!(buf2 = pio_arena_alloc(arena, 1008)))
+        ERR(ERR_AWFUL);
+    if (!PIO_USE_MALLOC && buf2 != buf)
+        ERR(ERR_WRONG);
+    pio_arena_release(arena, buf2);
+
+    /* A released large block is reused by the next large block that
+     * fits in it. */
+    if (!(buf = pio_arena_alloc(arena, 3 * MAX_CLASS_SZ)))
+        ERR(ERR_AWFUL);
+    memset(buf, 1, 3 * MAX_CLASS_SZ);
+    pio_arena_release(arena, buf);
+    if (!(buf2 = pio_arena_alloc(arena, 2 * MAX_CLASS_SZ)))
+        ERR(ERR_AWFUL);
+    if (!PIO_USE_MALLOC && buf2 != buf)
+        ERR(ERR_WRONG);
+    pio_arena_release(arena, buf2);
+
+    pio_arena_free(arena);
+
+    return PIO_NOERR;
+}
+
+/**
+ * Check the statistics of an arena, and that the bytes kept for reuse
+ * are returned to the system beyond the buffer size limit.
+ *
+ * @param my_rank rank of this task.
+ * @returns 0 for success, error code otherwise.
+ */
+int test_stats(int my_rank)
+{
+    pio_arena_t *arena;
+    PIO_Offset curalloc, totfree, maxfree;
+    PIO_Offset limit;
+    long nget, nrel;
+    void *buf[3];
+    int ret;
+
+    if ((ret = pio_arena_create(&arena)))
+        ERR(ret);
+
+    pio_arena_stats(arena, &curalloc, &totfree, &maxfree, &nget, &nrel);
+    if (curalloc || totfree || maxfree || nget || nrel || pio_arena_retained(arena))
+        ERR(ERR_WRONG);
+
+    /* Two blocks of the 64 byte class and a large block. */
+    for (int i = 0; i < 2; i++)
+        if (!(buf[i] = pio_arena_alloc(arena, 10)))
+            ERR(ERR_AWFUL);
+    if (!(buf[2] = pio_arena_alloc(arena, MAX_CLASS_SZ)))
+        ERR(ERR_AWFUL);
+    pio_arena_stats(arena, &curalloc, &totfree, &maxfree, &nget, &nrel);
+    if (nget != 3 || nrel != 0)
+        ERR(ERR_WRONG);
+    if (curalloc != (PIO_USE_MALLOC ? 2 * (10 + HDR_SZ) + MAX_CLASS_SZ + HDR_SZ :
+                     2 * 64 + 2 * MAX_CLASS_SZ))
+        ERR(ERR_WRONG);
+
+    /* The released blocks are kept for reuse. */
+    for (int i = 0; i < 3; i++)
+        pio_arena_release(arena, buf[i]);
+    pio_arena_stats(arena, &curalloc, &totfree, &maxfree, &nget, &nrel);
+    if (curalloc != 0 || nget != 3 || nrel != 3)
+        ERR(ERR_WRONG);
+    if (!PIO_USE_MALLOC)
+    {
+        if (totfree < 2 * MAX_CLASS_SZ || maxfree != 2 * MAX_CLASS_SZ - HDR_SZ ||
+            pio_arena_retained(arena) < totfree)
+            ERR(ERR_WRONG);
+    }
+    else if (totfree || maxfree || pio_arena_retained(arena))
+        ERR(ERR_WRONG);
+
+    /* Beyond the buffer size limit the blocks kept for reuse are
+     * returned to the system. */
+    limit = PIOc_set_buffer_size_limit(1);
+    if (!(buf[0] = pio_arena_alloc(arena, 10)))
+        ERR(ERR_AWFUL);
+    pio_arena_release(arena, buf[0]);
+    PIOc_set_buffer_size_limit(limit);
+    pio_arena_stats(arena, &curalloc, &totfree, &maxfree, &nget, &nrel);
+    if (curalloc || totfree || maxfree || pio_arena_retained(arena))
+        ERR(ERR_WRONG);
+
+    pio_arena_free(arena);
+
+    return PIO_NOERR;
+}
+
+/* Run tests for the arena. */
+int main(int argc, char **argv)
+{
+    int my_rank;
+    int ntasks;
+    MPI_Comm test_comm; /* A communicator for this test. */
+    int ret;         /* Return code. */
+
+    /* Initialize test. */
+    if ((ret = pio_test_init2(argc, argv, &my_rank, &ntasks, MIN_NTASKS,
+                              TARGET_NTASKS, 3, &test_comm)))
+        ERR(ERR_INIT);
+
+    /* Only do something on max_ntasks tasks. */
+    if (my_rank < TARGET_NTASKS)
+    {
+        if ((ret = test_classes(my_rank)))
+            return ret;
+
+        if ((ret = test_reuse(my_rank)))
+            return ret;
+
+        if ((ret = test_stats(my_rank)))
+            return ret;
+    } /* endif my_rank < TARGET_NTASKS */
+
+    /* Finalize the MPI library. */
+    printf("%d %s Finalizing...\n", my_rank, TEST_NAME);
+    if ((ret = pio_test_finalize(&test_comm)))
+        return ret;
+
+    printf("%d %s SUCCESS!!\n", my_rank, TEST_NAME);
+    return 0;
+}
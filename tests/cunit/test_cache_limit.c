@@ -0,0 +1,367 @@
+/*
+ * Tests for the cache budgets of files and decompositions
+ * (PIOc_set_file_cache_limit() and PIOc_set_decomp_cache_limit()).
+ */
+#include <pio.h>
+#include <pio_tests.h>
+
+/* The number of tasks this test should run on. */
+#define TARGET_NTASKS 4
+
+/* The minimum number of tasks this test should run on. */
+#define MIN_NTASKS 4
+
+/* The name of this test. */
+#define TEST_NAME "test_cache_limit"
+
+/* The number of dimensions in the example data. */
+#define NDIM 1
+
+/* The lengths of our sample data along the two dimensions. */
+#define DIM_LEN_X 4096
+#define DIM_LEN_Y 2048
+
+/* The number of elements of each variable on each task. */
+#define ELEM_X (DIM_LEN_X / TARGET_NTASKS)
+#define ELEM_Y (DIM_LEN_Y / TARGET_NTASKS)
+
+/* The bytes of one variable along x cached on each task. */
+#define ARRAY_SZ ((PIO_Offset)(ELEM_X * sizeof(int)))
+
+/* The limit of the cache shared by the files without a budget, the
+ * size of one variable along x. */
+#define BUFFER_SIZE_LIMIT ARRAY_SZ
+
+/* A budget that is never exceeded in this test. */
+#define LARGE_BUDGET (100 * ARRAY_SZ)
+
+/* The number of variables along each dimension. */
+#define NVARS 2
+
+/* The data written to the variables. */
+int data_x[ELEM_X];
+int data_y[ELEM_Y];
+
+/**
+ * Create a file with NVARS int variables along x and NVARS int
+ * variables along y.
+ *
+ * @param iosysid the IO system ID.
+ * @param iotype the iotype to test.
+ * @param name the name of the file, without iotype and suffix.
+ * @param my_rank rank of this task.
+ * @param ncidp pointer that gets the ncid of the file.
+ * @param varid_x array that gets the IDs of the variables along x.
+ * @param varid_y array that gets the IDs of the variables along y.
+ * @returns 0 for success, error code otherwise.
+ */
+int create_file(int iosysid, int iotype, const char *name, int my_rank,
+                int *ncidp, int *varid_x, int *varid_y)
+{
+    char filename[PIO_MAX_NAME + 1];
+    char varname[PIO_MAX_NAME + 1];
+    int dimid_x, dimid_y;
+    int ret;
+
+    sprintf(filename, "%s_%s_%d.nc", TEST_NAME, name, iotype);
+    if ((ret = PIOc_createfile(iosysid, ncidp, &iotype, filename, PIO_CLOBBER)))
+        ERR(ret);
+    if ((ret = PIOc_def_dim(*ncidp, "x", DIM_LEN_X, &dimid_x)))
+        ERR(ret);
+    if ((ret = PIOc_def_dim(*ncidp, "y", DIM_LEN_Y, &dimid_y)))
+        ERR(ret);
+    for (int v = 0; v < NVARS; v++)
+    {
+        sprintf(varname, "x%d", v);
+        if ((ret = PIOc_def_var(*ncidp, varname, PIO_INT, NDIM, &dimid_x, &varid_x[v])))
+            ERR(ret);
+        sprintf(varname, "y%d", v);
+        if ((ret = PIOc_def_var(*ncidp, varname, PIO_INT, NDIM, &dimid_y, &varid_y[v])))
+            ERR(ret);
+    }
+    if ((ret = PIOc_enddef(*ncidp)))
+        ERR(ret);
+
+    return PIO_NOERR;
+}
+
+/**
+ * Check the bytes cached for a file on this task.
+ *
+ * @param iosysid the IO system ID.
+ * @param ncid the ncid of the file.
+ * @param expected the expected number of bytes.
+ * @param my_rank rank of this task.
+ * @returns 0 for success, error code otherwise.
+ */
+int check_cached(int iosysid, int ncid, PIO_Offset expected, int my_rank)
+{
+    pio_mem_stats_t stats;
+    int ret;
+
+    if ((ret = PIOc_get_mem_stats(iosysid, ncid, false, &stats)))
+        ERR(ret);
+    if (stats.cur[PIO_MEM_WMB][PIO_STAT_AVG] != expected)
+        ERR(ERR_WRONG);
+
+    return PIO_NOERR;
+}
+
+/**
+ * Check that a file with a budget is not flushed for the data cached
+ * for other files, while a file without a budget is.
+ *
+ * @param iosysid the IO system ID.
+ * @param ioid_x the decomposition of the variables along x.
+ * @param iotype the iotype to test.
+ * @param my_rank rank of this task.
+ * @returns 0 for success, error code otherwise.
+ */
+int test_isolation(int iosysid, int ioid_x, int iotype, int my_rank)
+{
+    int ncid_bulk, ncid_budget, ncid_shared;
+    int varid_x[NVARS], varid_y[NVARS];
+    int ret;
+
+    if ((ret = create_file(iosysid, iotype, "bulk", my_rank, &ncid_bulk, varid_x, varid_y)))
+        ERR(ret);
+    if ((ret = create_file(iosysid, iotype, "budget", my_rank, &ncid_budget, varid_x, varid_y)))
+        ERR(ret);
+    if ((ret = create_file(iosysid, iotype, "shared", my_rank, &ncid_shared, varid_x, varid_y)))
+        ERR(ret);
+
+    /* These should not work. */
+    if (PIOc_set_file_cache_limit(ncid_budget + TEST_VAL_42, LARGE_BUDGET,
+                                  PIO_CACHE_EVICT_LARGEST) != PIO_EBADID)
+        ERR(ERR_WRONG);
+    if (PIOc_set_file_cache_limit(ncid_budget, -1, PIO_CACHE_EVICT_LARGEST) != PIO_EINVAL)
+        ERR(ERR_WRONG);
+    if (PIOc_set_file_cache_limit(ncid_budget, LARGE_BUDGET, TEST_VAL_42) != PIO_EINVAL)
+        ERR(ERR_WRONG);
+
+    if ((ret = PIOc_set_file_cache_limit(ncid_budget, LARGE_BUDGET, PIO_CACHE_EVICT_LARGEST)))
+        ERR(ret);
+
+    /* The bulk writer fills the shared cache. */
+    if ((ret = PIOc_write_darray(ncid_bulk, varid_x[0], ioid_x, ELEM_X, data_x, NULL)))
+        ERR(ret);
+    if ((ret = check_cached(iosysid, ncid_bulk, ARRAY_SZ, my_rank)))
+        ERR(ret);
+
+    /* The data of the file with a budget stays cached. */
+    for (int v = 0; v < NVARS; v++)
+        if ((ret = PIOc_write_darray(ncid_budget, varid_x[v], ioid_x, ELEM_X, data_x, NULL)))
+            ERR(ret);
+    if ((ret = check_cached(iosysid, ncid_budget, NVARS * ARRAY_SZ, my_rank)))
+        ERR(ret);
+
+    /* The data of the file without a budget is flushed at each
+     * write, since the shared cache is full. */
+    for (int v = 0; v < NVARS; v++)
+        if ((ret = PIOc_write_darray(ncid_shared, varid_x[v], ioid_x, ELEM_X, data_x, NULL)))
+            ERR(ret);
+    if ((ret = check_cached(iosysid, ncid_shared, ARRAY_SZ, my_rank)))
+        ERR(ret);
+
+    if ((ret = PIOc_closefile(ncid_bulk)))
+        ERR(ret);
+    if ((ret = PIOc_closefile(ncid_budget)))
+        ERR(ret);
+    if ((ret = PIOc_closefile(ncid_shared)))
+        ERR(ret);
+
+    return PIO_NOERR;
+}
+
+/**
+ * Check the buffers flushed when the budget of a file is exceeded.
+ *
+ * @param iosysid the IO system ID.
+ * @param ioid_x the decomposition of the variables along x.
+ * @param ioid_y the decomposition of the variables along y.
+ * @param iotype the iotype to test.
+ * @param policy the eviction policy.
+ * @param my_rank rank of this task.
+ * @returns 0 for success, error code otherwise.
+ */
+int test_eviction(int iosysid, int ioid_x, int ioid_y, int iotype, int policy,
+                  int my_rank)
+{
+    int ncid;
+    int varid_x[NVARS], varid_y[NVARS];
+    char name[PIO_MAX_NAME + 1];
+    int ret;
+
+    sprintf(name, "evict%d", policy);
+    if ((ret = create_file(iosysid, iotype, name, my_rank, &ncid, varid_x, varid_y)))
+        ERR(ret);
+
+    /* The budget holds both variables along x and one along y. */
+    if ((ret = PIOc_set_file_cache_limit(ncid, 5 * ARRAY_SZ / 2, policy)))
+        ERR(ret);
+
+    /* The buffer of y is the oldest, the buffer of x the largest. */
+    if ((ret = PIOc_write_darray(ncid, varid_y[0], ioid_y, ELEM_Y, data_y, NULL)))
+        ERR(ret);
+    for (int v = 0; v < NVARS; v++)
+        if ((ret = PIOc_write_darray(ncid, varid_x[v], ioid_x, ELEM_X, data_x, NULL)))
+            ERR(ret);
+    if ((ret = check_cached(iosysid, ncid, 5 * ARRAY_SZ / 2, my_rank)))
+        ERR(ret);
+
+    /* The next variable along y does not fit in the budget. */
+    if ((ret = PIOc_write_darray(ncid, varid_y[1], ioid_y, ELEM_Y, data_y, NULL)))
+        ERR(ret);
+    if (policy == PIO_CACHE_EVICT_LARGEST)
+    {
+        /* Both variables along y are cached. */
+        if ((ret = check_cached(iosysid, ncid, ARRAY_SZ, my_rank)))
+            ERR(ret);
+    }
+    else
+    {
+        /* Both variables along x, and the second along y, are
+         * cached. */
+        if ((ret = check_cached(iosysid, ncid, 5 * ARRAY_SZ / 2, my_rank)))
+            ERR(ret);
+    }
+
+    if ((ret = PIOc_closefile(ncid)))
+        ERR(ret);
+
+    return PIO_NOERR;
+}
+
+/**
+ * Check that the data cached for a decomposition is flushed when it
+ * exceeds the budget of the decomposition.
+ *
+ * @param iosysid the IO system ID.
+ * @param ioid_x the decomposition of the variables along x.
+ * @param iotype the iotype to test.
+ * @param my_rank rank of this task.
+ * @returns 0 for success, error code otherwise.
+ */
+int test_decomp_budget(int iosysid, int ioid_x, int iotype, int my_rank)
+{
+    int ncid;
+    int varid_x[NVARS], varid_y[NVARS];
+    int ret;
+
+    if ((ret = create_file(iosysid, iotype, "decomp", my_rank, &ncid, varid_x, varid_y)))
+        ERR(ret);
+    if ((ret = PIOc_set_file_cache_limit(ncid, LARGE_BUDGET, PIO_CACHE_EVICT_LARGEST)))
+        ERR(ret);
+
+    /* These should not work. */
+    if (PIOc_set_decomp_cache_limit(iosysid + TEST_VAL_42, ioid_x, ARRAY_SZ) != PIO_EBADID)
+        ERR(ERR_WRONG);
+    if (PIOc_set_decomp_cache_limit(iosysid, ioid_x + TEST_VAL_42, ARRAY_SZ) != PIO_EBADID)
+        ERR(ERR_WRONG);
+    if (PIOc_set_decomp_cache_limit(iosysid, ioid_x, -1) != PIO_EINVAL)
+        ERR(ERR_WRONG);
+
+    /* The budget of the decomposition holds one variable. */
+    if ((ret = PIOc_set_decomp_cache_limit(iosysid, ioid_x, ARRAY_SZ)))
+        ERR(ret);
+    for (int v = 0; v < NVARS; v++)
+        if ((ret = PIOc_write_darray(ncid, varid_x[v], ioid_x, ELEM_X, data_x, NULL)))
+            ERR(ret);
+    if ((ret = check_cached(iosysid, ncid, ARRAY_SZ, my_rank)))
+        ERR(ret);
+    if ((ret = PIOc_set_decomp_cache_limit(iosysid, ioid_x, 0)))
+        ERR(ret);
+
+    if ((ret = PIOc_closefile(ncid)))
+        ERR(ret);
+
+    return PIO_NOERR;
+}
+
+/* Run tests for the cache budgets. */
+int main(int argc, char **argv)
+{
+    int my_rank;
+    int ntasks;
+    int num_flavors;
+    int flavor[NUM_FLAVORS];
+    MPI_Comm test_comm; /* A communicator for this test. */
+    int ret;         /* Return code. */
+
+    /* Initialize test. */
+    if ((ret = pio_test_init2(argc, argv, &my_rank, &ntasks, MIN_NTASKS,
+                              MIN_NTASKS, 3, &test_comm)))
+        ERR(ERR_INIT);
+
+    if ((ret = PIOc_set_iosystem_error_handling(PIO_DEFAULT, PIO_RETURN_ERROR, NULL)))
+        return ret;
+
+    /* Figure out iotypes. */
+    if ((ret = get_iotypes(&num_flavors, flavor)))
+        ERR(ret);
+
+    /* Only do something on max_ntasks tasks. */
+    if (my_rank < TARGET_NTASKS)
+    {
+        int iosysid;  /* The ID for the parallel I/O system. */
+        int ioid_x, ioid_y; /* The decomposition IDs. */
+        int dim_len_x[NDIM] = {DIM_LEN_X};
+        int dim_len_y[NDIM] = {DIM_LEN_Y};
+        PIO_Offset compdof_x[ELEM_X];
+        PIO_Offset compdof_y[ELEM_Y];
+
+        for (int i = 0; i < ELEM_X; i++)
+        {
+            compdof_x[i] = my_rank * ELEM_X + i + 1;
+            data_x[i] = my_rank * ELEM_X + i;
+        }
+        for (int i = 0; i < ELEM_Y; i++)
+        {
+            compdof_y[i] = my_rank * ELEM_Y + i + 1;
+            data_y[i] = my_rank * ELEM_Y + i;
+        }
+
+        /* The shared cache holds one variable along x. */
+        PIOc_set_buffer_size_limit(BUFFER_SIZE_LIMIT);
+
+        if ((ret = PIOc_Init_Intracomm(test_comm, 2, 2, 0, PIO_REARR_BOX, &iosysid)))
+            return ret;
+
+        if ((ret = PIOc_InitDecomp(iosysid, PIO_INT, NDIM, dim_len_x, ELEM_X,
+                                   compdof_x, &ioid_x, NULL, NULL, NULL)))
+            ERR(ret);
+        if ((ret = PIOc_InitDecomp(iosysid, PIO_INT, NDIM, dim_len_y, ELEM_Y,
+                                   compdof_y, &ioid_y, NULL, NULL, NULL)))
+            ERR(ret);
+
+        for (int f = 0; f < num_flavors; f++)
+        {
+            if ((ret = test_isolation(iosysid, ioid_x, flavor[f], my_rank)))
+                return ret;
+            if ((ret = test_eviction(iosysid, ioid_x, ioid_y, flavor[f],
+                                     PIO_CACHE_EVICT_LARGEST, my_rank)))
+                return ret;
+            if ((ret = test_eviction(iosysid, ioid_x, ioid_y, flavor[f],
+                                     PIO_CACHE_EVICT_OLDEST, my_rank)))
+                return ret;
+            if ((ret = test_decomp_budget(iosysid, ioid_x, flavor[f], my_rank)))
+                return ret;
+        }
+
+        if ((ret = PIOc_freedecomp(iosysid, ioid_x)))
+            ERR(ret);
+        if ((ret = PIOc_freedecomp(iosysid, ioid_y)))
+            ERR(ret);
+
+        if ((ret = PIOc_finalize(iosysid)))
+            return ret;
+    } /* endif my_rank < TARGET_NTASKS */
+
+    /* Finalize the MPI library. */
+    printf("%d %s Finalizing...\n", my_rank, TEST_NAME);
+    if ((ret = pio_test_finalize(&test_comm)))
+        return ret;
+
+    printf("%d %s SUCCESS!!\n", my_rank, TEST_NAME);
+    return 0;
+}
@@ -0,0 +1,340 @@
+/*
+ * Tests for choosing the chunksizes of netCDF-4 variables from the
+ * decomposition they are written with (PIOc_def_var_chunking_auto).
+ */
+#include <pio.h>
+#include <pio_tests.h>
+
+/* The number of tasks this test should run on. */
+#define TARGET_NTASKS 4
+
+/* The minimum number of tasks this test should run on. */
+#define MIN_NTASKS 4
+
+/* The name of this test. */
+#define TEST_NAME "test_chunk_auto"
+
+/* The number of dimensions in the example data. */
+#define NDIM 1
+
+/* The length of our sample data along the dimension. */
+#define DIM_LEN 16
+
+/* The number of timesteps of data to write. */
+#define NUM_TIMESTEPS 3
+
+/* The names of the variables in the netCDF output files. */
+#define VAR_NAME "foo"
+#define FIXED_VAR_NAME "bar"
+
+/* The dimension names. */
+#define DIM_NAME "x"
+#define DIM_NAME_UNLIM "time"
+#define DIM_NAME_OTHER "y"
+
+/* The length of the dimension split unevenly between the IO tasks,
+ * and the number of IO tasks. */
+#define UNEVEN_DIM_LEN 1000
+#define UNEVEN_NUM_IOTASKS 3
+
+/* The target blocksize for the box rearranger, small enough for all
+ * the IO tasks to get a part of UNEVEN_DIM_LEN. */
+#define UNEVEN_BLOCKSIZE 1024
+
+/**
+ * Check the chunksizes of a variable. The chunks must tile the
+ * array, and be at least as large as the data of a compute task,
+ * which is contiguous in this test.
+ *
+ * @param ncid the ncid of the open file.
+ * @param varid the ID of the variable.
+ * @param nrecdims 1 for record variables, 0 otherwise.
+ * @param my_rank rank of this task.
+ * @param elements_per_pe number of elements on each task.
+ * @returns 0 for success, error code otherwise.
+ */
+int check_chunksizes(int ncid, int varid, int nrecdims, int my_rank,
+                     PIO_Offset elements_per_pe)
+{
+    int storage;
+    PIO_Offset chunksizes[NDIM + 1];
+    int ret;
+
+    if ((ret = PIOc_inq_var_chunking(ncid, varid, &storage, chunksizes)))
+        ERR(ret);
+    if (storage != NC_CHUNKED)
+        ERR(ERR_WRONG);
+    if (nrecdims && chunksizes[0] != 1)
+        ERR(ERR_WRONG);
+    if (DIM_LEN % chunksizes[nrecdims] || chunksizes[nrecdims] < elements_per_pe)
+        ERR(ERR_WRONG);
+
+    return PIO_NOERR;
+}
+
+/**
+ * Create a file with a record and a fixed size variable chunked
+ * from the decomposition, write them, and check the chunksizes and
+ * the data.
+ *
+ * @param iosysid the IO system ID.
+ * @param ioid the ID of the decomposition.
+ * @param iotype the netCDF-4 iotype to test.
+ * @param my_rank rank of this task.
+ * @param elements_per_pe number of elements on this task.
+ * @returns 0 for success, error code otherwise.
+ */
+int test_chunk_auto(int iosysid, int ioid, int iotype, int my_rank,
+                    PIO_Offset elements_per_pe)
+{
+    char filename[PIO_MAX_NAME + 1];
+    int ncid, varid, fixed_varid, bad_varid;
+    int dimids[NDIM + 1], other_dimid;
+    int test_data[elements_per_pe];
+    int test_data_in[elements_per_pe];
+    int ret;
+
+    sprintf(filename, "%s_%d.nc", TEST_NAME, iotype);
+    if ((ret = PIOc_createfile(iosysid, &ncid, &iotype, filename, PIO_CLOBBER)))
+        ERR(ret);
+    if ((ret = PIOc_def_dim(ncid, DIM_NAME_UNLIM, PIO_UNLIMITED, &dimids[0])))
+        ERR(ret);
+    if ((ret = PIOc_def_dim(ncid, DIM_NAME, DIM_LEN, &dimids[1])))
+        ERR(ret);
+    if ((ret = PIOc_def_dim(ncid, DIM_NAME_OTHER, DIM_LEN + 1, &other_dimid)))
+        ERR(ret);
+    if ((ret = PIOc_def_var(ncid, VAR_NAME, PIO_INT, NDIM + 1, dimids, &varid)))
+        ERR(ret);
+    if ((ret = PIOc_def_var(ncid, FIXED_VAR_NAME, PIO_INT, NDIM, &dimids[1], &fixed_varid)))
+        ERR(ret);
+    if ((ret = PIOc_def_var(ncid, DIM_NAME_OTHER, PIO_INT, NDIM, &other_dimid, &bad_varid)))
+        ERR(ret);
+
+    /* The dimensions of the var must match the decomposition. */
+    if (PIOc_def_var_chunking_auto(ncid, bad_varid, ioid) != PIO_EINVAL)
+        ERR(ERR_WRONG);
+    if (PIOc_def_var_chunking_auto(ncid, varid, ioid + 42) != PIO_EBADID)
+        ERR(ERR_WRONG);
+
+    if ((ret = PIOc_def_var_chunking_auto(ncid, varid, ioid)))
+        ERR(ret);
+    if ((ret = PIOc_def_var_chunking_auto(ncid, fixed_varid, ioid)))
+        ERR(ret);
+    if ((ret = PIOc_enddef(ncid)))
+        ERR(ret);
+
+    for (int t = 0; t < NUM_TIMESTEPS; t++)
+    {
+        for (int i = 0; i < elements_per_pe; i++)
+            test_data[i] = t * DIM_LEN + my_rank * elements_per_pe + i;
+
+        if ((ret = PIOc_setframe(ncid, varid, t)))
+            ERR(ret);
+        if ((ret = PIOc_write_darray(ncid, varid, ioid, elements_per_pe, test_data, NULL)))
+            ERR(ret);
+    }
+    if ((ret = PIOc_write_darray(ncid, fixed_varid, ioid, elements_per_pe, test_data, NULL)))
+        ERR(ret);
+
+    if ((ret = PIOc_closefile(ncid)))
+        ERR(ret);
+
+    /* Check the chunksizes and the data. */
+    if ((ret = PIOc_openfile(iosysid, &ncid, &iotype, filename, PIO_NOWRITE)))
+        ERR(ret);
+    if ((ret = check_chunksizes(ncid, varid, 1, my_rank, elements_per_pe)))
+        return ret;
+    if ((ret = check_chunksizes(ncid, fixed_varid, 0, my_rank, elements_per_pe)))
+        return ret;
+
+    for (int t = 0; t < NUM_TIMESTEPS; t++)
+    {
+        if ((ret = PIOc_setframe(ncid, varid, t)))
+            ERR(ret);
+        if ((ret = PIOc_read_darray(ncid, varid, ioid, elements_per_pe, test_data_in)))
+            ERR(ret);
+        for (int i = 0; i < elements_per_pe; i++)
+            if (test_data_in[i] != t * DIM_LEN + my_rank * elements_per_pe + i)
+                ERR(ERR_WRONG);
+    }
+
+    if ((ret = PIOc_closefile(ncid)))
+        ERR(ret);
+
+    return PIO_NOERR;
+}
+
+/**
+ * Test chunking variables written with a decomposition split unevenly
+ * between UNEVEN_NUM_IOTASKS IO tasks, where the boundaries of the I/O
+ * regions have no large common divisor. The variables keep the
+ * default storage rather than getting tiny chunks.
+ *
+ * @param test_comm the communicator for the IO system.
+ * @param rearranger the rearranger to use.
+ * @param iotype the netCDF-4 iotype to test.
+ * @param my_rank rank of this task.
+ * @returns 0 for success, error code otherwise.
+ */
+int test_chunk_auto_uneven(MPI_Comm test_comm, int rearranger, int iotype, int my_rank)
+{
+    char filename[PIO_MAX_NAME + 1];
+    int iosysid, ioid;
+    int ncid, varid, fixed_varid;
+    int dimids[NDIM + 1];
+    int storage;
+    PIO_Offset chunksizes[NDIM + 1];
+    int dim_len[NDIM] = {UNEVEN_DIM_LEN};
+    PIO_Offset elements_per_pe = UNEVEN_DIM_LEN / TARGET_NTASKS;
+    PIO_Offset compdof[UNEVEN_DIM_LEN / TARGET_NTASKS];
+    int test_data[UNEVEN_DIM_LEN / TARGET_NTASKS];
+    int ret;
+
+    for (int i = 0; i < elements_per_pe; i++)
+        compdof[i] = my_rank * elements_per_pe + i + 1;
+
+    if ((ret = PIOc_set_blocksize(UNEVEN_BLOCKSIZE)))
+        ERR(ret);
+    if ((ret = PIOc_Init_Intracomm(test_comm, UNEVEN_NUM_IOTASKS, 1, 0, rearranger, &iosysid)))
+        ERR(ret);
+    if ((ret = PIOc_InitDecomp(iosysid, PIO_INT, NDIM, dim_len, elements_per_pe,
+                               compdof, &ioid, NULL, NULL, NULL)))
+        ERR(ret);
+
+    sprintf(filename, "%s_uneven_%d.nc", TEST_NAME, iotype);
+    if ((ret = PIOc_createfile(iosysid, &ncid, &iotype, filename, PIO_CLOBBER)))
+        ERR(ret);
+    if ((ret = PIOc_def_dim(ncid, DIM_NAME_UNLIM, PIO_UNLIMITED, &dimids[0])))
+        ERR(ret);
+    if ((ret = PIOc_def_dim(ncid, DIM_NAME, UNEVEN_DIM_LEN, &dimids[1])))
+        ERR(ret);
+    if ((ret = PIOc_def_var(ncid, VAR_NAME, PIO_INT, NDIM + 1, dimids, &varid)))
+        ERR(ret);
+    if ((ret = PIOc_def_var(ncid, FIXED_VAR_NAME, PIO_INT, NDIM, &dimids[1], &fixed_varid)))
+        ERR(ret);
+    if ((ret = PIOc_def_var_chunking_auto(ncid, varid, ioid)))
+        ERR(ret);
+    if ((ret = PIOc_def_var_chunking_auto(ncid, fixed_varid, ioid)))
+        ERR(ret);
+    if ((ret = PIOc_enddef(ncid)))
+        ERR(ret);
+    for (int t = 0; t < NUM_TIMESTEPS; t++)
+    {
+        for (int i = 0; i < elements_per_pe; i++)
+            test_data[i] = t * UNEVEN_DIM_LEN + my_rank * elements_per_pe + i;
+
+        if ((ret = PIOc_setframe(ncid, varid, t)))
+            ERR(ret);
+        if ((ret = PIOc_write_darray(ncid, varid, ioid, elements_per_pe, test_data, NULL)))
+            ERR(ret);
+    }
+    if ((ret = PIOc_closefile(ncid)))
+        ERR(ret);
+
+    /* The chunks are not smaller than the data of a compute task,
+     * whether they were chosen from the decomposition or by the
+     * netCDF library. */
+    if ((ret = PIOc_openfile(iosysid, &ncid, &iotype, filename, PIO_NOWRITE)))
+        ERR(ret);
+    if ((ret = PIOc_inq_var_chunking(ncid, varid, &storage, chunksizes)))
+        ERR(ret);
+    if (storage != NC_CHUNKED || chunksizes[1] < elements_per_pe)
+        ERR(ERR_WRONG);
+    if ((ret = PIOc_inq_var_chunking(ncid, fixed_varid, &storage, chunksizes)))
+        ERR(ret);
+    if (storage == NC_CHUNKED && chunksizes[0] < elements_per_pe)
+        ERR(ERR_WRONG);
+    for (int t = 0; t < NUM_TIMESTEPS; t++)
+    {
+        if ((ret = PIOc_setframe(ncid, varid, t)))
+            ERR(ret);
+        if ((ret = PIOc_read_darray(ncid, varid, ioid, elements_per_pe, test_data)))
+            ERR(ret);
+        for (int i = 0; i < elements_per_pe; i++)
+            if (test_data[i] != t * UNEVEN_DIM_LEN + my_rank * elements_per_pe + i)
+                ERR(ERR_WRONG);
+    }
+    if ((ret = PIOc_closefile(ncid)))
+        ERR(ret);
+
+    if ((ret = PIOc_freedecomp(iosysid, ioid)))
+        ERR(ret);
+    if ((ret = PIOc_finalize(iosysid)))
+        ERR(ret);
+
+    return PIO_NOERR;
+}
+
+/* Run tests for choosing chunksizes from the decomposition. */
+int main(int argc, char **argv)
+{
+#define NUM_REARRANGERS_TO_TEST 2
+    int rearranger[NUM_REARRANGERS_TO_TEST] = {PIO_REARR_BOX, PIO_REARR_SUBSET};
+#define NUM_IOTYPES_TO_TEST 2
+    int iotypes[NUM_IOTYPES_TO_TEST] = {PIO_IOTYPE_NETCDF4P, PIO_IOTYPE_NETCDF4C};
+    int my_rank;
+    int ntasks;
+    MPI_Comm test_comm; /* A communicator for this test. */
+    int ret;         /* Return code. */
+
+    /* Initialize test. */
+    if ((ret = pio_test_init2(argc, argv, &my_rank, &ntasks, MIN_NTASKS,
+                              MIN_NTASKS, 3, &test_comm)))
+        ERR(ERR_INIT);
+
+    if ((ret = PIOc_set_iosystem_error_handling(PIO_DEFAULT, PIO_RETURN_ERROR, NULL)))
+        return ret;
+
+    /* Only do something on max_ntasks tasks. */
+    if (my_rank < TARGET_NTASKS)
+    {
+        int iosysid;  /* The ID for the parallel I/O system. */
+        int ioid;     /* Decomposition ID. */
+        int dim_len[NDIM] = {DIM_LEN};
+        PIO_Offset elements_per_pe = DIM_LEN / TARGET_NTASKS;
+        PIO_Offset compdof[DIM_LEN / TARGET_NTASKS];
+
+        for (int i = 0; i < elements_per_pe; i++)
+            compdof[i] = my_rank * elements_per_pe + i + 1;
+
+        for (int r = 0; r < NUM_REARRANGERS_TO_TEST; r++)
+        {
+            if ((ret = PIOc_Init_Intracomm(test_comm, 2, 2, 0, rearranger[r], &iosysid)))
+                return ret;
+
+            if ((ret = PIOc_InitDecomp(iosysid, PIO_INT, NDIM, dim_len, elements_per_pe,
+                                       compdof, &ioid, NULL, NULL, NULL)))
+                ERR(ret);
+
+            for (int i = 0; i < NUM_IOTYPES_TO_TEST; i++)
+            {
+                if (!PIOc_iotype_available(iotypes[i]))
+                    continue;
+                if ((ret = test_chunk_auto(iosysid, ioid, iotypes[i], my_rank, elements_per_pe)))
+                    return ret;
+            }
+
+            if ((ret = PIOc_freedecomp(iosysid, ioid)))
+                ERR(ret);
+
+            if ((ret = PIOc_finalize(iosysid)))
+                return ret;
+
+            for (int i = 0; i < NUM_IOTYPES_TO_TEST; i++)
+            {
+                if (!PIOc_iotype_available(iotypes[i]))
+                    continue;
+                if ((ret = test_chunk_auto_uneven(test_comm, rearranger[r], iotypes[i], my_rank)))
+                    return ret;
+            }
+        } /* next rearranger */
+    } /* endif my_rank < TARGET_NTASKS */
+
+    /* Finalize the MPI library. */
+    printf("%d %s Finalizing...\n", my_rank, TEST_NAME);
+    if ((ret = pio_test_finalize(&test_comm)))
+        return ret;
+
+    printf("%d %s SUCCESS!!\n", my_rank, TEST_NAME);
+    return 0;
+}
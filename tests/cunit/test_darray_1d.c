@@ -791,7 +791,8 @@ int test_decomp_read_write(int iosysid, int ioid, int num_flavors, int *flavor,
             if (!iodesc->needsfill || iodesc->mpitype != expected_basetype)
                 return ERR_WRONG;
             /* Don't forget to add 1!! */
-            if (iodesc->map[0] != my_rank + 1 || iodesc->map[1] != 0)
+            if (iodesc->map_nranges != 2 || iodesc->map_start[0] != my_rank + 1 ||
+                iodesc->map_start[1] != 0)
                 return ERR_WRONG;
             if (iodesc->dimlen[0] != DIM_LEN)
                 return ERR_WRONG;
@@ -290,9 +290,13 @@ int test_decomp_read_write(int iosysid, int ioid, int num_flavors, int *flavor,
             if (iodesc->rearranger != rearranger || iodesc->maxregions != 1 ||
                 iodesc->needsfill || iodesc->mpitype != MPI_INT)
                 return ERR_WRONG;
+            PIO_Offset *map;
+            if ((ret = expand_iodesc_map(iodesc, &map)))
+                return ret;
             for (int e = 0; e < iodesc->maplen; e++)
-                if (iodesc->map[e] != my_rank * iodesc->maplen + e + 1)
+                if (map[e] != my_rank * iodesc->maplen + e + 1)
                     return ERR_WRONG;
+            free(map);
             if (iodesc->dimlen[0] != X_DIM_LEN || iodesc->dimlen[1] != Y_DIM_LEN ||
                 iodesc->dimlen[2] != Z_DIM_LEN)
                 return ERR_WRONG;
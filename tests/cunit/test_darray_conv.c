@@ -0,0 +1,185 @@
+/*
+ * Tests for PIO distributed arrays with user data that is wider than
+ * the type of the variable in the file (double data written to and
+ * read from a float variable). The data is converted to the variable
+ * type on the compute tasks, before caching and rearranging the data.
+ */
+#include <pio.h>
+#include <pio_internal.h>
+#include <pio_tests.h>
+
+/* The number of tasks this test should run on. */
+#define TARGET_NTASKS 4
+
+/* The minimum number of tasks this test should run on. */
+#define MIN_NTASKS 4
+
+/* The name of this test. */
+#define TEST_NAME "test_darray_conv"
+
+/* The number of dimensions in the example data. */
+#define NDIM 1
+
+/* The length of our sample data along the dimension. */
+#define DIM_LEN 16
+
+/* The number of timesteps of data to write. */
+#define NUM_TIMESTEPS 2
+
+/* The name of the variable in the netCDF output files. */
+#define VAR_NAME "float_var"
+
+/* The dimension names. */
+#define DIM_NAME "x"
+#define DIM_NAME_UNLIM "time"
+
+/**
+ * Write double data to a float variable and read it back into a
+ * double array.
+ *
+ * @param iosysid the IO system ID.
+ * @param ioid the ID of the decomposition (with PIO_DOUBLE type).
+ * @param num_flavors the number of IOTYPES available in this build.
+ * @param flavor array of available iotypes.
+ * @param my_rank rank of this task.
+ * @param elements_per_pe number of elements on this task.
+ * @returns 0 for success, error code otherwise.
+ */
+int test_darray_conv_double_float(int iosysid, int ioid, int num_flavors, int *flavor,
+                                  int my_rank, PIO_Offset elements_per_pe)
+{
+    char filename[PIO_MAX_NAME + 1];
+    int dimids[NDIM + 1];
+    int ncid, varid;
+    double test_data[elements_per_pe];
+    double test_data_in[elements_per_pe];
+    io_desc_t *iodesc;
+    int ret;
+
+    for (int fmt = 0; fmt < num_flavors; fmt++)
+    {
+        sprintf(filename, "%s_%d.nc", TEST_NAME, flavor[fmt]);
+
+        if ((ret = PIOc_createfile(iosysid, &ncid, &flavor[fmt], filename, PIO_CLOBBER)))
+            ERR(ret);
+        if ((ret = PIOc_def_dim(ncid, DIM_NAME_UNLIM, PIO_UNLIMITED, &dimids[0])))
+            ERR(ret);
+        if ((ret = PIOc_def_dim(ncid, DIM_NAME, DIM_LEN, &dimids[1])))
+            ERR(ret);
+        if ((ret = PIOc_def_var(ncid, VAR_NAME, PIO_FLOAT, NDIM + 1, dimids, &varid)))
+            ERR(ret);
+        if ((ret = PIOc_enddef(ncid)))
+            ERR(ret);
+
+        for (int t = 0; t < NUM_TIMESTEPS; t++)
+        {
+            /* Values that are exactly representable as floats */
+            for (int i = 0; i < elements_per_pe; i++)
+                test_data[i] = my_rank * elements_per_pe + i + 0.5 * t;
+
+            if ((ret = PIOc_setframe(ncid, varid, t)))
+                ERR(ret);
+            if ((ret = PIOc_write_darray(ncid, varid, ioid, elements_per_pe, test_data, NULL)))
+                ERR(ret);
+        }
+
+        /* The data is converted using a decomposition with the variable type */
+        if (!(iodesc = pio_get_iodesc_from_id(ioid)))
+            ERR(ERR_WRONG);
+        if (iodesc->conv_ioid == -1)
+            ERR(ERR_WRONG);
+        if (!(iodesc = pio_get_iodesc_from_id(iodesc->conv_ioid)))
+            ERR(ERR_WRONG);
+        if (iodesc->piotype != PIO_FLOAT)
+            ERR(ERR_WRONG);
+
+        if ((ret = PIOc_closefile(ncid)))
+            ERR(ret);
+
+        if ((ret = PIOc_openfile(iosysid, &ncid, &flavor[fmt], filename, PIO_NOWRITE)))
+            ERR(ret);
+
+        for (int t = 0; t < NUM_TIMESTEPS; t++)
+        {
+            if ((ret = PIOc_setframe(ncid, varid, t)))
+                ERR(ret);
+            if ((ret = PIOc_read_darray(ncid, varid, ioid, elements_per_pe, test_data_in)))
+                ERR(ret);
+            for (int i = 0; i < elements_per_pe; i++)
+                if (test_data_in[i] != my_rank * elements_per_pe + i + 0.5 * t)
+                    ERR(ERR_WRONG);
+        }
+
+        if ((ret = PIOc_closefile(ncid)))
+            ERR(ret);
+    }
+
+    return PIO_NOERR;
+}
+
+/* Run tests for distributed arrays with data conversion. */
+int main(int argc, char **argv)
+{
+#define NUM_REARRANGERS_TO_TEST 2
+    int rearranger[NUM_REARRANGERS_TO_TEST] = {PIO_REARR_BOX, PIO_REARR_SUBSET};
+    int my_rank;
+    int ntasks;
+    int num_flavors; /* Number of PIO netCDF flavors in this build. */
+    int flavor[NUM_FLAVORS]; /* iotypes for the supported netCDF IO flavors. */
+    MPI_Comm test_comm; /* A communicator for this test. */
+    int ret;         /* Return code. */
+
+    /* Initialize test. */
+    if ((ret = pio_test_init2(argc, argv, &my_rank, &ntasks, MIN_NTASKS,
+                              MIN_NTASKS, 3, &test_comm)))
+        ERR(ERR_INIT);
+
+    if ((ret = PIOc_set_iosystem_error_handling(PIO_DEFAULT, PIO_RETURN_ERROR, NULL)))
+        return ret;
+
+    /* Only do something on max_ntasks tasks. */
+    if (my_rank < TARGET_NTASKS)
+    {
+        int iosysid;  /* The ID for the parallel I/O system. */
+        int ioid;     /* Decomposition ID. */
+        int dim_len[NDIM] = {DIM_LEN};
+        PIO_Offset elements_per_pe = DIM_LEN / TARGET_NTASKS;
+        PIO_Offset compdof[DIM_LEN / TARGET_NTASKS];
+
+        /* Figure out iotypes. */
+        if ((ret = get_iotypes(&num_flavors, flavor)))
+            ERR(ret);
+
+        for (int i = 0; i < elements_per_pe; i++)
+            compdof[i] = my_rank * elements_per_pe + i + 1;
+
+        for (int r = 0; r < NUM_REARRANGERS_TO_TEST; r++)
+        {
+            if ((ret = PIOc_Init_Intracomm(test_comm, 2, 2, 0, rearranger[r], &iosysid)))
+                return ret;
+
+            if ((ret = PIOc_InitDecomp(iosysid, PIO_DOUBLE, NDIM, dim_len, elements_per_pe,
+                                       compdof, &ioid, NULL, NULL, NULL)))
+                ERR(ret);
+
+            if ((ret = test_darray_conv_double_float(iosysid, ioid, num_flavors, flavor,
+                                                     my_rank, elements_per_pe)))
+                return ret;
+
+            /* Also frees the decomposition used for the conversion */
+            if ((ret = PIOc_freedecomp(iosysid, ioid)))
+                ERR(ret);
+
+            if ((ret = PIOc_finalize(iosysid)))
+                return ret;
+        } /* next rearranger */
+    } /* endif my_rank < TARGET_NTASKS */
+
+    /* Finalize the MPI library. */
+    printf("%d %s Finalizing...\n", my_rank, TEST_NAME);
+    if ((ret = pio_test_finalize(&test_comm)))
+        return ret;
+
+    printf("%d %s SUCCESS!!\n", my_rank, TEST_NAME);
+    return 0;
+}
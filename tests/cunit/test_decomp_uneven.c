@@ -254,13 +254,17 @@ int test_decomp_read_write(int iosysid, int ioid, int num_flavors, int *flavor,
             if (iodesc->needsfill)
                 return ERR_WRONG;
             /* Don't forget to add 1! */
+            PIO_Offset *map;
+            if ((ret = expand_iodesc_map(iodesc, &map)))
+                return ret;
             for (int e = 0; e < iodesc->maplen; e++)
             {
-                printf("%d e = %d max_maplen = %d iodesc->map[e] = %lld expected_map[my_rank * max_maplen + e] = %d\n",
-                       my_rank, e, max_maplen, iodesc->map[e], expected_map[my_rank * max_maplen + e]);
-                if (iodesc->map[e] != expected_map[my_rank * max_maplen + e] + 1)
+                printf("%d e = %d max_maplen = %d map[e] = %lld expected_map[my_rank * max_maplen + e] = %d\n",
+                       my_rank, e, max_maplen, map[e], expected_map[my_rank * max_maplen + e]);
+                if (map[e] != expected_map[my_rank * max_maplen + e] + 1)
                     return ERR_WRONG;
             }
+            free(map);
             for (int d = 0; d < NDIM3; d++)
                 if (iodesc->dimlen[d] != dim_len[d])
                     return ERR_WRONG;
@@ -244,6 +244,151 @@ int test_decomp_bc(int iosysid, int my_rank, MPI_Comm test_comm)
     return 0;
 }
 
+/**
+ * Test PIOc_InitDecomp_ranges().
+ *
+ * @param iosysid the IO system ID.
+ * @param my_rank the 0-based rank of this task.
+ * @param test_comm communicator that includes all tasks paticipating in test.
+ * @returns 0 for success, error code otherwise.
+ */
+int test_decomp_ranges(int iosysid, int my_rank, MPI_Comm test_comm)
+{
+#define NRANGES 3
+    int ioid;                   /* The decomposition ID. */
+    int slice_dimlen[NDIM2] = {X_DIM_LEN, Y_DIM_LEN};
+    PIO_Offset bad_rstart[NRANGES] = {-1, 0, 0};
+    PIO_Offset bad_rcount[NRANGES] = {X_DIM_LEN * Y_DIM_LEN + 1, 0, 0};
+    PIO_Offset rstart[NRANGES];
+    PIO_Offset rcount[NRANGES] = {2, 1, 1};
+    PIO_Offset expected_map[X_DIM_LEN];
+    io_desc_t *iodesc;
+    PIO_Offset *map;
+    int ndims;
+    int *gdims;
+    PIO_Offset fmaplen;
+    int ret;
+
+    /* The first two elements of the row of this task, a hole, and
+     * the last element of the row. This is a 1-based map. */
+    rstart[0] = my_rank * Y_DIM_LEN + 1;
+    rstart[1] = 0;
+    rstart[2] = my_rank * Y_DIM_LEN + 4;
+    expected_map[0] = rstart[0];
+    expected_map[1] = rstart[0] + 1;
+    expected_map[2] = 0;
+    expected_map[3] = rstart[2];
+
+    /* These should not work. */
+    if (PIOc_InitDecomp_ranges(iosysid + TEST_VAL_42, PIO_INT, NDIM2, slice_dimlen, NRANGES,
+                               rstart, rcount, &ioid, NULL, NULL, NULL) != PIO_EBADID)
+        return ERR_WRONG;
+    if (PIOc_InitDecomp_ranges(iosysid, PIO_INT, NDIM2, slice_dimlen, NRANGES, NULL, rcount,
+                               &ioid, NULL, NULL, NULL) != PIO_EINVAL)
+        return ERR_WRONG;
+    if (PIOc_InitDecomp_ranges(iosysid, PIO_INT, NDIM2, slice_dimlen, NRANGES, bad_rstart,
+                               rcount, &ioid, NULL, NULL, NULL) != PIO_EINVAL)
+        return ERR_WRONG;
+    if (PIOc_InitDecomp_ranges(iosysid, PIO_INT, NDIM2, slice_dimlen, NRANGES, rstart,
+                               bad_rcount, &ioid, NULL, NULL, NULL) != PIO_EINVAL)
+        return ERR_WRONG;
+
+    /* Create the PIO decomposition for this test. */
+    if ((ret = PIOc_InitDecomp_ranges(iosysid, PIO_INT, NDIM2, slice_dimlen, NRANGES, rstart,
+                                      rcount, &ioid, NULL, NULL, NULL)))
+        return ret;
+
+    /* The map is kept as the ranges. */
+    if (!(iodesc = pio_get_iodesc_from_id(ioid)))
+        return ERR_WRONG;
+    if (iodesc->maplen != X_DIM_LEN || iodesc->map_nranges != NRANGES)
+        return ERR_WRONG;
+    for (int r = 0; r < NRANGES; r++)
+        if (iodesc->map_start[r] != rstart[r] || iodesc->map_count[r] != rcount[r])
+            return ERR_WRONG;
+    if ((ret = expand_iodesc_map(iodesc, &map)))
+        return ret;
+    for (int m = 0; m < X_DIM_LEN; m++)
+        if (map[m] != expected_map[m])
+            return ERR_WRONG;
+    free(map);
+
+    /* Write the decomp file, read it and check the map. */
+    if ((ret = PIOc_write_decomp(DECOMP_FILE, iosysid, ioid, test_comm)))
+        return ret;
+    if ((ret = PIOc_readmap(DECOMP_FILE, &ndims, (int **)&gdims, &fmaplen, (PIO_Offset **)&map,
+                            test_comm)))
+        return ret;
+    if (ndims != NDIM2 || fmaplen != X_DIM_LEN)
+        return ERR_WRONG;
+    for (int m = 0; m < fmaplen; m++)
+        if (map[m] != expected_map[m])
+            return ERR_WRONG;
+    free(map);
+    free(gdims);
+
+    /* Free the PIO decomposition. */
+    if ((ret = PIOc_freedecomp(iosysid, ioid)))
+        return ret;
+
+    return 0;
+}
+
+/**
+ * Test PIOc_InitDecomp_i4().
+ *
+ * @param iosysid the IO system ID.
+ * @param my_rank the 0-based rank of this task.
+ * @returns 0 for success, error code otherwise.
+ */
+int test_decomp_i4(int iosysid, int my_rank)
+{
+    int ioid;                   /* The decomposition ID. */
+    int slice_dimlen[NDIM2] = {X_DIM_LEN, Y_DIM_LEN};
+    int compmap[X_DIM_LEN];
+    io_desc_t *iodesc;
+    PIO_Offset *map;
+    int ret;
+
+    /* The first two elements of the row of this task, a hole, and
+     * the last element of the row. This is a 1-based map. */
+    compmap[0] = my_rank * Y_DIM_LEN + 1;
+    compmap[1] = my_rank * Y_DIM_LEN + 2;
+    compmap[2] = 0;
+    compmap[3] = my_rank * Y_DIM_LEN + 4;
+
+    /* These should not work. */
+    if (PIOc_InitDecomp_i4(iosysid + TEST_VAL_42, PIO_INT, NDIM2, slice_dimlen, X_DIM_LEN,
+                           compmap, &ioid, NULL, NULL, NULL) != PIO_EBADID)
+        return ERR_WRONG;
+    if (PIOc_InitDecomp_i4(iosysid, PIO_INT, NDIM2, slice_dimlen, X_DIM_LEN, NULL,
+                           &ioid, NULL, NULL, NULL) != PIO_EINVAL)
+        return ERR_WRONG;
+
+    /* Create the PIO decomposition for this test. */
+    if ((ret = PIOc_InitDecomp_i4(iosysid, PIO_INT, NDIM2, slice_dimlen, X_DIM_LEN, compmap,
+                                  &ioid, NULL, NULL, NULL)))
+        return ret;
+
+    /* The map is kept as ranges of 64-bit offsets. */
+    if (!(iodesc = pio_get_iodesc_from_id(ioid)))
+        return ERR_WRONG;
+    if (iodesc->maplen != X_DIM_LEN || iodesc->map_nranges != 3)
+        return ERR_WRONG;
+    if ((ret = expand_iodesc_map(iodesc, &map)))
+        return ret;
+    for (int m = 0; m < X_DIM_LEN; m++)
+        if (map[m] != compmap[m])
+            return ERR_WRONG;
+    free(map);
+
+    /* Free the PIO decomposition. */
+    if ((ret = PIOc_freedecomp(iosysid, ioid)))
+        return ret;
+
+    return 0;
+}
+
 /** 
  * Test the decomp read/write functionality.
  *
@@ -316,9 +461,10 @@ int test_decomp_read_write(int iosysid, int ioid, int num_flavors, int *flavor,
                     || iodesc->rearranger != PIO_REARR_SUBSET || iodesc->maxregions != 1 ||
                     iodesc->needsfill || iodesc->mpitype != MPI_INT)
                     return ERR_WRONG;
-                for (int e = 0; e < iodesc->maplen; e++)
-                    if (iodesc->map[e] != my_rank * iodesc->maplen + e + 1)
-                        return ERR_WRONG;
+                /* The contiguous map is kept as one range. */
+                if (iodesc->map_nranges != 1 || iodesc->map_count[0] != iodesc->maplen ||
+                    iodesc->map_start[0] != my_rank * iodesc->maplen + 1)
+                    return ERR_WRONG;
                 if (iodesc->dimlen[0] != X_DIM_LEN || iodesc->dimlen[1] != Y_DIM_LEN)
                     return ERR_WRONG;
                 printf("%d in my test iodesc->maxiobuflen = %d\n", my_rank, iodesc->maxiobuflen);
@@ -333,6 +479,57 @@ int test_decomp_read_write(int iosysid, int ioid, int num_flavors, int *flavor,
     return PIO_NOERR;
 }
 
+/**
+ * Test PIOc_get_decomp_stats() with a 2D decomposition of the
+ * data over the tasks, in which each task has the same number of
+ * elements.
+ *
+ * @param iosysid the IO system ID.
+ * @param ioid the ID of the decomposition.
+ * @returns 0 for success, error code otherwise.
+ */
+int test_decomp_stats(int iosysid, int ioid)
+{
+    pio_decomp_stats_t stats;
+    double total_len = X_DIM_LEN * Y_DIM_LEN;
+    int numiotasks;
+    int ret;
+
+    /* These should not work. */
+    if (PIOc_get_decomp_stats(iosysid + TEST_VAL_42, ioid, &stats) != PIO_EBADID)
+        return ERR_WRONG;
+    if (PIOc_get_decomp_stats(iosysid, ioid + TEST_VAL_42, &stats) != PIO_EBADID)
+        return ERR_WRONG;
+
+    if ((ret = PIOc_get_numiotasks(iosysid, &numiotasks)))
+        return ret;
+    if ((ret = PIOc_get_decomp_stats(iosysid, ioid, &stats)))
+        return ret;
+
+    /* Check the statistics. */
+    if (stats.rearranger != REARRANGER || stats.needsfill)
+        return ERR_WRONG;
+    if (stats.nsend_peers[PIO_STAT_MIN] < 1 ||
+        stats.nsend_peers[PIO_STAT_MAX] > numiotasks)
+        return ERR_WRONG;
+    if (stats.send_bytes[PIO_STAT_MIN] != stats.send_bytes[PIO_STAT_MAX] ||
+        stats.send_bytes[PIO_STAT_AVG] != total_len * sizeof(int) / TARGET_NTASKS)
+        return ERR_WRONG;
+    if (stats.recv_bytes[PIO_STAT_AVG] * numiotasks != total_len * sizeof(int) ||
+        stats.llen[PIO_STAT_AVG] * numiotasks != total_len)
+        return ERR_WRONG;
+    if (stats.llen[PIO_STAT_MIN] > stats.llen[PIO_STAT_AVG] ||
+        stats.llen[PIO_STAT_MAX] < stats.llen[PIO_STAT_AVG] || stats.llen_imbalance < 1)
+        return ERR_WRONG;
+    if (stats.maxregions < 1 || stats.blocksize < 1)
+        return ERR_WRONG;
+    if (stats.rearr_mem[PIO_STAT_MIN] <= 0 ||
+        stats.rearr_mem[PIO_STAT_MAX] < stats.rearr_mem[PIO_STAT_AVG])
+        return ERR_WRONG;
+
+    return 0;
+}
+
 /* Run decomp tests. */
 int main(int argc, char **argv)
 {
@@ -385,11 +582,23 @@ int main(int argc, char **argv)
         if ((ret = test_decomp_bc(iosysid, my_rank, test_comm)))
             return ret;
 
+        /* Test PIOc_InitDecomp_ranges(). */
+        if ((ret = test_decomp_ranges(iosysid, my_rank, test_comm)))
+            return ret;
+
+        /* Test PIOc_InitDecomp_i4(). */
+        if ((ret = test_decomp_i4(iosysid, my_rank)))
+            return ret;
+
         /* Decompose the data over the tasks. */
         if ((ret = create_decomposition_2d(TARGET_NTASKS, my_rank, iosysid, dim_len_2d, &ioid,
                                            PIO_INT)))
             return ret;
 
+        /* Test the decomposition statistics. */
+        if ((ret = test_decomp_stats(iosysid, ioid)))
+            return ret;
+
         /* Test decomposition read/write. */
         if ((ret = test_decomp_read_write(iosysid, ioid, num_flavors, flavor, my_rank, test_comm)))
             return ret;
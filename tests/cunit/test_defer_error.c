@@ -0,0 +1,128 @@
+/*
+ * Tests for the PIO_DEFER_ERROR error handler. Errors from calls that
+ * do not return any data are recorded and only reported at the next
+ * sync point (enddef, sync, close or PIOc_check_errors()).
+ */
+#include <pio.h>
+#include <pio_tests.h>
+
+/* The number of tasks this test should run on. */
+#define TARGET_NTASKS 4
+
+/* The minimum number of tasks this test should run on. */
+#define MIN_NTASKS 4
+
+/* The name of this test. */
+#define TEST_NAME "test_defer_error"
+
+/* The dimension names and length. */
+#define DIM_NAME "x"
+#define DIM_NAME2 "y"
+#define DIM_LEN 4
+
+/* The name of the variable in the netCDF output files. */
+#define VAR_NAME "var"
+
+/**
+ * Test deferred errors when defining a file.
+ *
+ * @param iosysid the IO system ID.
+ * @param num_flavors the number of IOTYPES available in this build.
+ * @param flavor array of available iotypes.
+ * @param my_rank rank of this task.
+ * @returns 0 for success, error code otherwise.
+ */
+int test_defer_error(int iosysid, int num_flavors, int *flavor, int my_rank)
+{
+    char filename[PIO_MAX_NAME + 1];
+    int dimids[2];
+    int ncid, varid;
+    int ret;
+
+    for (int fmt = 0; fmt < num_flavors; fmt++)
+    {
+        sprintf(filename, "%s_%d.nc", TEST_NAME, flavor[fmt]);
+
+        if ((ret = PIOc_createfile(iosysid, &ncid, &flavor[fmt], filename, PIO_CLOBBER)))
+            ERR(ret);
+        if ((ret = PIOc_def_dim(ncid, DIM_NAME, DIM_LEN, &dimids[0])))
+            ERR(ret);
+        if ((ret = PIOc_def_dim(ncid, DIM_NAME2, DIM_LEN, &dimids[1])))
+            ERR(ret);
+        if ((ret = PIOc_def_var(ncid, VAR_NAME, PIO_INT, 2, dimids, &varid)))
+            ERR(ret);
+
+        /* No errors recorded yet. */
+        if ((ret = PIOc_check_errors(ncid)))
+            ERR(ret);
+
+        /* Renaming a dimension to an existing name fails, but the
+         * error is only reported by the next check. */
+        if ((ret = PIOc_rename_dim(ncid, dimids[1], DIM_NAME)))
+            ERR(ret);
+        if (PIOc_check_errors(ncid) == PIO_NOERR)
+            ERR(ERR_WRONG);
+
+        /* The error was cleared by the check. */
+        if ((ret = PIOc_check_errors(ncid)))
+            ERR(ret);
+
+        /* The error is reported by enddef. */
+        if ((ret = PIOc_rename_dim(ncid, dimids[1], DIM_NAME)))
+            ERR(ret);
+        if (PIOc_enddef(ncid) == PIO_NOERR)
+            ERR(ERR_WRONG);
+
+        if ((ret = PIOc_closefile(ncid)))
+            ERR(ret);
+    }
+
+    return PIO_NOERR;
+}
+
+/* Run tests for the deferred error handler. */
+int main(int argc, char **argv)
+{
+    int my_rank;
+    int ntasks;
+    int num_flavors; /* Number of PIO netCDF flavors in this build. */
+    int flavor[NUM_FLAVORS]; /* iotypes for the supported netCDF IO flavors. */
+    MPI_Comm test_comm; /* A communicator for this test. */
+    int ret;         /* Return code. */
+
+    /* Initialize test. */
+    if ((ret = pio_test_init2(argc, argv, &my_rank, &ntasks, MIN_NTASKS,
+                              MIN_NTASKS, 3, &test_comm)))
+        ERR(ERR_INIT);
+
+    /* Only do something on max_ntasks tasks. */
+    if (my_rank < TARGET_NTASKS)
+    {
+        int iosysid;  /* The ID for the parallel I/O system. */
+        int old_method;
+
+        /* Figure out iotypes. */
+        if ((ret = get_iotypes(&num_flavors, flavor)))
+            ERR(ret);
+
+        if ((ret = PIOc_Init_Intracomm(test_comm, 2, 2, 0, PIO_REARR_BOX, &iosysid)))
+            return ret;
+
+        if ((ret = PIOc_set_iosystem_error_handling(iosysid, PIO_DEFER_ERROR, &old_method)))
+            ERR(ret);
+
+        if ((ret = test_defer_error(iosysid, num_flavors, flavor, my_rank)))
+            return ret;
+
+        if ((ret = PIOc_finalize(iosysid)))
+            return ret;
+    } /* endif my_rank < TARGET_NTASKS */
+
+    /* Finalize the MPI library. */
+    printf("%d %s Finalizing...\n", my_rank, TEST_NAME);
+    if ((ret = pio_test_finalize(&test_comm)))
+        return ret;
+
+    printf("%d %s SUCCESS!!\n", my_rank, TEST_NAME);
+    return 0;
+}
@@ -0,0 +1,147 @@
+/*
+ * Tests for reading data that is replicated on all tasks into node
+ * shared memory (PIOc_get_vars_node_shared()).
+ */
+#include <pio.h>
+#include <pio_tests.h>
+
+/* The number of tasks this test should run on. */
+#define TARGET_NTASKS 4
+
+/* The minimum number of tasks this test should run on. */
+#define MIN_NTASKS 4
+
+/* The name of this test. */
+#define TEST_NAME "test_get_node_shared"
+
+/* The number of dimensions in the example data. */
+#define NDIM 2
+
+/* The lengths of the dimensions. */
+#define X_DIM_LEN 8
+#define Y_DIM_LEN 6
+
+/* The name of the variable in the netCDF output files. */
+#define VAR_NAME "grid"
+
+/**
+ * Write a variable and read it back into node shared memory.
+ *
+ * @param iosysid the IO system ID.
+ * @param num_flavors the number of IOTYPES available in this build.
+ * @param flavor array of available iotypes.
+ * @param my_rank rank of this task.
+ * @returns 0 for success, error code otherwise.
+ */
+int test_get_node_shared(int iosysid, int num_flavors, int *flavor, int my_rank)
+{
+    char filename[PIO_MAX_NAME + 1];
+    char dim_name[NDIM][PIO_MAX_NAME + 1] = {"x", "y"};
+    int dim_len[NDIM] = {X_DIM_LEN, Y_DIM_LEN};
+    int dimids[NDIM];
+    int ncid, varid;
+    double test_data[X_DIM_LEN * Y_DIM_LEN];
+    int ret;
+
+    for (int i = 0; i < X_DIM_LEN * Y_DIM_LEN; i++)
+        test_data[i] = i * 0.5;
+
+    for (int fmt = 0; fmt < num_flavors; fmt++)
+    {
+        double *data_in;
+        MPI_Win win;
+
+        sprintf(filename, "%s_%d.nc", TEST_NAME, flavor[fmt]);
+
+        if ((ret = PIOc_createfile(iosysid, &ncid, &flavor[fmt], filename, PIO_CLOBBER)))
+            ERR(ret);
+        for (int d = 0; d < NDIM; d++)
+            if ((ret = PIOc_def_dim(ncid, dim_name[d], dim_len[d], &dimids[d])))
+                ERR(ret);
+        if ((ret = PIOc_def_var(ncid, VAR_NAME, PIO_DOUBLE, NDIM, dimids, &varid)))
+            ERR(ret);
+        if ((ret = PIOc_enddef(ncid)))
+            ERR(ret);
+        if ((ret = PIOc_put_var_double(ncid, varid, test_data)))
+            ERR(ret);
+        if ((ret = PIOc_closefile(ncid)))
+            ERR(ret);
+
+        if ((ret = PIOc_openfile(iosysid, &ncid, &flavor[fmt], filename, PIO_NOWRITE)))
+            ERR(ret);
+
+        /* Read the whole variable. */
+        if ((ret = PIOc_get_vars_node_shared(ncid, varid, NULL, NULL, NULL, NC_NAT,
+                                             (void **)&data_in, &win)))
+            ERR(ret);
+        for (int i = 0; i < X_DIM_LEN * Y_DIM_LEN; i++)
+            if (data_in[i] != test_data[i])
+                ERR(ERR_WRONG);
+        if ((ret = PIOc_free_node_shared(&win)))
+            ERR(ret);
+
+        /* Read the second row. */
+        PIO_Offset start[NDIM] = {1, 0};
+        PIO_Offset count[NDIM] = {1, Y_DIM_LEN};
+        if ((ret = PIOc_get_vars_node_shared(ncid, varid, start, count, NULL, PIO_DOUBLE,
+                                             (void **)&data_in, &win)))
+            ERR(ret);
+        for (int i = 0; i < Y_DIM_LEN; i++)
+            if (data_in[i] != test_data[Y_DIM_LEN + i])
+                ERR(ERR_WRONG);
+        if ((ret = PIOc_free_node_shared(&win)))
+            ERR(ret);
+
+        if ((ret = PIOc_closefile(ncid)))
+            ERR(ret);
+    }
+
+    return PIO_NOERR;
+}
+
+/* Run tests for reading into node shared memory. */
+int main(int argc, char **argv)
+{
+    int my_rank;
+    int ntasks;
+    int num_flavors; /* Number of PIO netCDF flavors in this build. */
+    int flavor[NUM_FLAVORS]; /* iotypes for the supported netCDF IO flavors. */
+    MPI_Comm test_comm; /* A communicator for this test. */
+    int ret;         /* Return code. */
+
+    /* Initialize test. */
+    if ((ret = pio_test_init2(argc, argv, &my_rank, &ntasks, MIN_NTASKS,
+                              MIN_NTASKS, 3, &test_comm)))
+        ERR(ERR_INIT);
+
+    if ((ret = PIOc_set_iosystem_error_handling(PIO_DEFAULT, PIO_RETURN_ERROR, NULL)))
+        return ret;
+
+    /* Only do something on max_ntasks tasks. */
+    if (my_rank < TARGET_NTASKS)
+    {
+        int iosysid;  /* The ID for the parallel I/O system. */
+
+        /* Figure out iotypes. */
+        if ((ret = get_iotypes(&num_flavors, flavor)))
+            ERR(ret);
+
+        /* Use an IO root that is not the first task. */
+        if ((ret = PIOc_Init_Intracomm(test_comm, 2, 2, 1, PIO_REARR_BOX, &iosysid)))
+            return ret;
+
+        if ((ret = test_get_node_shared(iosysid, num_flavors, flavor, my_rank)))
+            return ret;
+
+        if ((ret = PIOc_finalize(iosysid)))
+            return ret;
+    } /* endif my_rank < TARGET_NTASKS */
+
+    /* Finalize the MPI library. */
+    printf("%d %s Finalizing...\n", my_rank, TEST_NAME);
+    if ((ret = pio_test_finalize(&test_comm)))
+        return ret;
+
+    printf("%d %s SUCCESS!!\n", my_rank, TEST_NAME);
+    return 0;
+}
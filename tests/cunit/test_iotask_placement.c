@@ -0,0 +1,140 @@
+/*
+ * Tests the node topology aware placement of I/O tasks
+ * (PIOc_set_iotask_placement()).
+ */
+#include <pio.h>
+#include <pio_internal.h>
+#include <pio_tests.h>
+
+/* The number of tasks this test should run on. */
+#define TARGET_NTASKS 4
+
+/* The name of this test. */
+#define TEST_NAME "test_iotask_placement"
+
+/* Needed to init intracomm. */
+#define NUM_IOTASKS 2
+#define STRIDE 1
+#define BASE 0
+
+/**
+ * Check the I/O tasks of an I/O system, the I/O task ranks are
+ * expected to be unique and in ascending order.
+ *
+ * @param iosysid the IO system ID.
+ * @param my_rank rank of this task.
+ * @param num_iotasks the expected number of I/O tasks.
+ * @param num_nodes the number of compute nodes.
+ * @returns 0 for success, error code otherwise.
+ */
+int check_ioranks(int iosysid, int my_rank, int num_iotasks, int num_nodes)
+{
+    iosystem_desc_t *ios;
+    int num_ionodes = 0;
+    int ret;
+
+    if (!(ios = pio_get_iosystem_from_id(iosysid)))
+        ERR(ERR_WRONG);
+    if (ios->num_iotasks != num_iotasks)
+        ERR(ERR_WRONG);
+    if (ios->ioroot != ios->ioranks[0])
+        ERR(ERR_WRONG);
+    for (int i = 1; i < ios->num_iotasks; i++)
+        if (ios->ioranks[i] <= ios->ioranks[i - 1])
+            ERR(ERR_WRONG);
+
+    /* The I/O tasks are spread across the nodes */
+    MPI_Comm node_comm;
+    int node_rank, node_ioproc, node_niotasks;
+    if ((ret = MPI_Comm_split_type(ios->comp_comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &node_comm)))
+        MPIERR(ret);
+    if ((ret = MPI_Comm_rank(node_comm, &node_rank)))
+        MPIERR(ret);
+    node_ioproc = ios->ioproc ? 1 : 0;
+    if ((ret = MPI_Allreduce(&node_ioproc, &node_niotasks, 1, MPI_INT, MPI_SUM, node_comm)))
+        MPIERR(ret);
+    if ((ret = MPI_Comm_free(&node_comm)))
+        MPIERR(ret);
+    node_ioproc = (node_rank == 0 && node_niotasks > 0) ? 1 : 0;
+    if ((ret = MPI_Allreduce(&node_ioproc, &num_ionodes, 1, MPI_INT, MPI_SUM, ios->comp_comm)))
+        MPIERR(ret);
+    if (num_ionodes != ((num_iotasks < num_nodes) ? num_iotasks : num_nodes))
+        ERR(ERR_WRONG);
+
+    return PIO_NOERR;
+}
+
+/* Run test. */
+int main(int argc, char **argv)
+{
+    int my_rank; /* Zero-based rank of processor. */
+    int ntasks; /* Number of processors involved in current execution. */
+    int iosysid; /* The ID for the parallel I/O system. */
+    MPI_Comm test_comm;
+    int ret; /* Return code. */
+
+    /* Initialize test. */
+    if ((ret = pio_test_init2(argc, argv, &my_rank, &ntasks, TARGET_NTASKS,
+                              TARGET_NTASKS, 3, &test_comm)))
+        ERR(ERR_INIT);
+
+    if ((ret = PIOc_set_iosystem_error_handling(PIO_DEFAULT, PIO_RETURN_ERROR, NULL)))
+        return ret;
+
+    /* Test code runs on TARGET_NTASKS tasks. The left over tasks do
+     * nothing. */
+    if (my_rank < TARGET_NTASKS)
+    {
+        MPI_Comm node_comm;
+        int node_rank, is_node_root, num_nodes;
+
+        /* Count the compute nodes */
+        if ((ret = MPI_Comm_split_type(test_comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &node_comm)))
+            MPIERR(ret);
+        if ((ret = MPI_Comm_rank(node_comm, &node_rank)))
+            MPIERR(ret);
+        if ((ret = MPI_Comm_free(&node_comm)))
+            MPIERR(ret);
+        is_node_root = (node_rank == 0) ? 1 : 0;
+        if ((ret = MPI_Allreduce(&is_node_root, &num_nodes, 1, MPI_INT, MPI_SUM, test_comm)))
+            MPIERR(ret);
+
+        /* Check that some bad inputs are rejected. */
+        if (PIOc_set_iotask_placement(PIO_IOTASK_PLACEMENT_NODE + TEST_VAL_42, 0) != PIO_EINVAL)
+            ERR(ERR_WRONG);
+        if (PIOc_set_iotask_placement(PIO_IOTASK_PLACEMENT_NODE, -1) != PIO_EINVAL)
+            ERR(ERR_WRONG);
+
+        /* Spread NUM_IOTASKS I/O tasks across the nodes. */
+        if ((ret = PIOc_set_iotask_placement(PIO_IOTASK_PLACEMENT_NODE, 0)))
+            ERR(ret);
+        if ((ret = PIOc_Init_Intracomm(test_comm, NUM_IOTASKS, STRIDE, BASE, PIO_REARR_BOX, &iosysid)))
+            ERR(ret);
+        if ((ret = check_ioranks(iosysid, my_rank, NUM_IOTASKS, num_nodes)))
+            return ret;
+        if ((ret = PIOc_finalize(iosysid)))
+            ERR(ret);
+
+        /* One I/O task per node. */
+        if ((ret = PIOc_set_iotask_placement(PIO_IOTASK_PLACEMENT_NODE, 1)))
+            ERR(ret);
+        if ((ret = PIOc_Init_Intracomm(test_comm, NUM_IOTASKS, STRIDE, BASE, PIO_REARR_BOX, &iosysid)))
+            ERR(ret);
+        if ((ret = check_ioranks(iosysid, my_rank, num_nodes, num_nodes)))
+            return ret;
+        if ((ret = PIOc_finalize(iosysid)))
+            ERR(ret);
+
+        /* Restore the default placement. */
+        if ((ret = PIOc_set_iotask_placement(PIO_IOTASK_PLACEMENT_STRIDE, 0)))
+            ERR(ret);
+    } /* endif my_rank < TARGET_NTASKS */
+
+    /* Finalize the MPI library. */
+    printf("%d %s Finalizing...\n", my_rank, TEST_NAME);
+    if ((ret = pio_test_finalize(&test_comm)))
+        return ret;
+
+    printf("%d %s SUCCESS!!\n", my_rank, TEST_NAME);
+    return 0;
+}
@@ -0,0 +1,367 @@
+/*
+ * Tests for writing netCDF-4 files with the HDF5 library
+ * (PIO_IOTYPE_HDF5). The files are read back with the
+ * PIO_IOTYPE_NETCDF4P iotype.
+ */
+#include <pio.h>
+#include <pio_tests.h>
+
+/* The number of tasks this test should run on. */
+#define TARGET_NTASKS 4
+
+/* The minimum number of tasks this test should run on. */
+#define MIN_NTASKS 4
+
+/* The name of this test. */
+#define TEST_NAME "test_iotype_hdf5"
+
+/* The number of dimensions in the example data. */
+#define NDIM 1
+
+/* The length of our sample data along the dimension. */
+#define DIM_LEN 16
+
+/* The number of timesteps of data to write. */
+#define NUM_TIMESTEPS 3
+
+/* The name of the variable in the netCDF output files. */
+#define VAR_NAME "foo"
+
+/* The dimension names. The fixed dimension has a coordinate
+ * variable. */
+#define DIM_NAME "x"
+#define DIM_NAME_UNLIM "time"
+
+/* The attribute of the variable. */
+#define ATT_NAME "units"
+#define ATT_VAL "m/s"
+
+/* The fill value of the variable. */
+#define FILL_VAL -42
+
+/* The sizes of the 2D variable. Each task writes two blocks of
+ * X_BLOCK columns, X_DIM_LEN / 2 apart, in all the rows. */
+#define Y_DIM_LEN 4
+#define X_DIM_LEN 16
+#define X_BLOCK 2
+#define VAR_NAME_2D "bar"
+
+/**
+ * Create a file with the HDF5 iotype, with a coordinate variable
+ * and one record variable, and write NUM_TIMESTEPS records to it.
+ *
+ * @param iosysid the IO system ID.
+ * @param ioid the ID of the decomposition.
+ * @param filename the name of the file.
+ * @param my_rank rank of this task.
+ * @param elements_per_pe number of elements on this task.
+ * @returns 0 for success, error code otherwise.
+ */
+int create_and_write(int iosysid, int ioid, const char *filename, int my_rank,
+                     PIO_Offset elements_per_pe)
+{
+    int iotype = PIO_IOTYPE_HDF5;
+    int ncid, varid, coord_varid;
+    int dimids[NDIM + 1];
+    int fill_val = FILL_VAL;
+    float coord_data[DIM_LEN];
+    int test_data[elements_per_pe];
+    int ret;
+
+    if ((ret = PIOc_createfile(iosysid, &ncid, &iotype, filename, PIO_CLOBBER)))
+        ERR(ret);
+    if ((ret = PIOc_def_dim(ncid, DIM_NAME_UNLIM, PIO_UNLIMITED, &dimids[0])))
+        ERR(ret);
+    if ((ret = PIOc_def_dim(ncid, DIM_NAME, DIM_LEN, &dimids[1])))
+        ERR(ret);
+    if ((ret = PIOc_def_var(ncid, DIM_NAME, PIO_FLOAT, NDIM, &dimids[1], &coord_varid)))
+        ERR(ret);
+    if ((ret = PIOc_def_var(ncid, VAR_NAME, PIO_INT, NDIM + 1, dimids, &varid)))
+        ERR(ret);
+    if ((ret = PIOc_def_var_fill(ncid, varid, PIO_FILL, &fill_val)))
+        ERR(ret);
+    if ((ret = PIOc_put_att_text(ncid, varid, ATT_NAME, strlen(ATT_VAL), ATT_VAL)))
+        ERR(ret);
+    if ((ret = PIOc_put_att_text(ncid, PIO_GLOBAL, "title", strlen(TEST_NAME), TEST_NAME)))
+        ERR(ret);
+    if ((ret = PIOc_enddef(ncid)))
+        ERR(ret);
+
+    /* Data can not be read from files with the HDF5 iotype. */
+    if (PIOc_get_var_float(ncid, coord_varid, coord_data) != PIO_EBADIOTYPE)
+        ERR(ERR_WRONG);
+
+    for (int i = 0; i < DIM_LEN; i++)
+        coord_data[i] = i * 0.5;
+    if ((ret = PIOc_put_var_float(ncid, coord_varid, coord_data)))
+        ERR(ret);
+
+    for (int t = 0; t < NUM_TIMESTEPS; t++)
+    {
+        for (int i = 0; i < elements_per_pe; i++)
+            test_data[i] = t * DIM_LEN + my_rank * elements_per_pe + i;
+
+        if ((ret = PIOc_setframe(ncid, varid, t)))
+            ERR(ret);
+        if ((ret = PIOc_write_darray(ncid, varid, ioid, elements_per_pe, test_data, NULL)))
+            ERR(ret);
+    }
+
+    if ((ret = PIOc_closefile(ncid)))
+        ERR(ret);
+
+    return PIO_NOERR;
+}
+
+/**
+ * Open the file with the NETCDF4P iotype and check the metadata
+ * and the data.
+ *
+ * @param iosysid the IO system ID.
+ * @param ioid the ID of the decomposition.
+ * @param filename the name of the file.
+ * @param my_rank rank of this task.
+ * @param elements_per_pe number of elements on this task.
+ * @returns 0 for success, error code otherwise.
+ */
+int check_file(int iosysid, int ioid, const char *filename, int my_rank,
+               PIO_Offset elements_per_pe)
+{
+    int iotype = PIO_IOTYPE_NETCDF4P;
+    int ncid, varid, coord_varid;
+    int ndims, nvars, ngatts, unlimdimid;
+    int fill_val, no_fill;
+    PIO_Offset len;
+    char att_val[PIO_MAX_NAME + 1] = "";
+    float coord_data[DIM_LEN];
+    int test_data_in[elements_per_pe];
+    int ret;
+
+    if ((ret = PIOc_openfile(iosysid, &ncid, &iotype, filename, PIO_NOWRITE)))
+        ERR(ret);
+
+    if ((ret = PIOc_inq(ncid, &ndims, &nvars, &ngatts, &unlimdimid)))
+        ERR(ret);
+    if (ndims != NDIM + 1 || nvars != 2 || ngatts != 1 || unlimdimid != 0)
+        ERR(ERR_WRONG);
+    if ((ret = PIOc_inq_dimlen(ncid, 0, &len)))
+        ERR(ret);
+    if (len != NUM_TIMESTEPS)
+        ERR(ERR_WRONG);
+    if ((ret = PIOc_inq_dimlen(ncid, 1, &len)))
+        ERR(ret);
+    if (len != DIM_LEN)
+        ERR(ERR_WRONG);
+
+    if ((ret = PIOc_inq_varid(ncid, DIM_NAME, &coord_varid)))
+        ERR(ret);
+    if ((ret = PIOc_get_var_float(ncid, coord_varid, coord_data)))
+        ERR(ret);
+    for (int i = 0; i < DIM_LEN; i++)
+        if (coord_data[i] != i * 0.5)
+            ERR(ERR_WRONG);
+
+    if ((ret = PIOc_inq_varid(ncid, VAR_NAME, &varid)))
+        ERR(ret);
+    if ((ret = PIOc_get_att_text(ncid, varid, ATT_NAME, att_val)))
+        ERR(ret);
+    if (strcmp(att_val, ATT_VAL))
+        ERR(ERR_WRONG);
+    if ((ret = PIOc_inq_var_fill(ncid, varid, &no_fill, &fill_val)))
+        ERR(ret);
+    if (no_fill || fill_val != FILL_VAL)
+        ERR(ERR_WRONG);
+
+    for (int t = 0; t < NUM_TIMESTEPS; t++)
+    {
+        if ((ret = PIOc_setframe(ncid, varid, t)))
+            ERR(ret);
+        if ((ret = PIOc_read_darray(ncid, varid, ioid, elements_per_pe, test_data_in)))
+            ERR(ret);
+        for (int i = 0; i < elements_per_pe; i++)
+            if (test_data_in[i] != t * DIM_LEN + my_rank * elements_per_pe + i)
+                ERR(ERR_WRONG);
+    }
+
+    if ((ret = PIOc_closefile(ncid)))
+        ERR(ret);
+
+    return PIO_NOERR;
+}
+
+/**
+ * Test the HDF5 iotype.
+ *
+ * @param iosysid the IO system ID.
+ * @param ioid the ID of the decomposition.
+ * @param my_rank rank of this task.
+ * @param elements_per_pe number of elements on this task.
+ * @returns 0 for success, error code otherwise.
+ */
+int test_iotype_hdf5(int iosysid, int ioid, int my_rank, PIO_Offset elements_per_pe)
+{
+    char filename[PIO_MAX_NAME + 1];
+    int iotype = PIO_IOTYPE_HDF5;
+    int ncid;
+    int ret;
+
+    /* Files can not be opened with the HDF5 iotype. */
+    sprintf(filename, "%s.nc", TEST_NAME);
+    if (PIOc_openfile(iosysid, &ncid, &iotype, filename, PIO_NOWRITE) != PIO_EBADIOTYPE)
+        ERR(ERR_WRONG);
+
+    if ((ret = create_and_write(iosysid, ioid, filename, my_rank, elements_per_pe)))
+        return ret;
+    if ((ret = check_file(iosysid, ioid, filename, my_rank, elements_per_pe)))
+        return ret;
+
+    /* The alignment and metadata block size of the files can be set. */
+    if (PIOc_set_hdf5_props(iosysid, -1, 0, 0) != PIO_EINVAL)
+        ERR(ERR_WRONG);
+    if ((ret = PIOc_set_hdf5_props(iosysid, 1024, 4096, 64 * 1024)))
+        ERR(ret);
+    sprintf(filename, "%s_aligned.nc", TEST_NAME);
+    if ((ret = create_and_write(iosysid, ioid, filename, my_rank, elements_per_pe)))
+        return ret;
+    if ((ret = check_file(iosysid, ioid, filename, my_rank, elements_per_pe)))
+        return ret;
+
+    return PIO_NOERR;
+}
+
+/**
+ * Write a 2D variable with the HDF5 iotype, with a decomposition in
+ * which each task has two blocks of columns spanning all the rows.
+ * With the subset rearranger the blocks of an IO task are
+ * boxes that overlap in the rows, and the IO buffer is laid out box
+ * by box. Read the variable back with the NETCDF4P iotype and check
+ * that each element is in its place.
+ *
+ * @param iosysid the IO system ID.
+ * @param my_rank rank of this task.
+ * @returns 0 for success, error code otherwise.
+ */
+int test_write_2d(int iosysid, int my_rank)
+{
+    char filename[PIO_MAX_NAME + 1];
+    int dim_len[2] = {Y_DIM_LEN, X_DIM_LEN};
+    PIO_Offset compdof[Y_DIM_LEN * 2 * X_BLOCK];
+    int test_data[Y_DIM_LEN * 2 * X_BLOCK];
+    int data_in[Y_DIM_LEN * X_DIM_LEN];
+    int iotype = PIO_IOTYPE_HDF5;
+    int ncid, varid, ioid;
+    int dimids[2];
+    int n = 0;
+    int ret;
+
+    /* The value of each element is its index in the variable. */
+    for (int y = 0; y < Y_DIM_LEN; y++)
+        for (int b = 0; b < 2; b++)
+            for (int x = 0; x < X_BLOCK; x++)
+            {
+                int idx = y * X_DIM_LEN + b * X_DIM_LEN / 2 + my_rank * X_BLOCK + x;
+
+                compdof[n] = idx + 1;
+                test_data[n++] = idx;
+            }
+
+    if ((ret = PIOc_InitDecomp(iosysid, PIO_INT, 2, dim_len, n, compdof, &ioid, NULL,
+                               NULL, NULL)))
+        ERR(ret);
+
+    sprintf(filename, "%s_2d.nc", TEST_NAME);
+    if ((ret = PIOc_createfile(iosysid, &ncid, &iotype, filename, PIO_CLOBBER)))
+        ERR(ret);
+    if ((ret = PIOc_def_dim(ncid, "y", Y_DIM_LEN, &dimids[0])))
+        ERR(ret);
+    if ((ret = PIOc_def_dim(ncid, "x", X_DIM_LEN, &dimids[1])))
+        ERR(ret);
+    if ((ret = PIOc_def_var(ncid, VAR_NAME_2D, PIO_INT, 2, dimids, &varid)))
+        ERR(ret);
+    if ((ret = PIOc_enddef(ncid)))
+        ERR(ret);
+    if ((ret = PIOc_write_darray(ncid, varid, ioid, n, test_data, NULL)))
+        ERR(ret);
+    if ((ret = PIOc_closefile(ncid)))
+        ERR(ret);
+
+    iotype = PIO_IOTYPE_NETCDF4P;
+    if ((ret = PIOc_openfile(iosysid, &ncid, &iotype, filename, PIO_NOWRITE)))
+        ERR(ret);
+    if ((ret = PIOc_get_var_int(ncid, varid, data_in)))
+        ERR(ret);
+    for (int i = 0; i < Y_DIM_LEN * X_DIM_LEN; i++)
+        if (data_in[i] != i)
+            ERR(ERR_WRONG);
+    if ((ret = PIOc_closefile(ncid)))
+        ERR(ret);
+
+    if ((ret = PIOc_freedecomp(iosysid, ioid)))
+        ERR(ret);
+
+    return PIO_NOERR;
+}
+
+/* Run tests for the HDF5 iotype. */
+int main(int argc, char **argv)
+{
+#define NUM_REARRANGERS_TO_TEST 2
+    int rearranger[NUM_REARRANGERS_TO_TEST] = {PIO_REARR_BOX, PIO_REARR_SUBSET};
+    int my_rank;
+    int ntasks;
+    MPI_Comm test_comm; /* A communicator for this test. */
+    int ret;         /* Return code. */
+
+    /* Initialize test. */
+    if ((ret = pio_test_init2(argc, argv, &my_rank, &ntasks, MIN_NTASKS,
+                              MIN_NTASKS, 3, &test_comm)))
+        ERR(ERR_INIT);
+
+    if ((ret = PIOc_set_iosystem_error_handling(PIO_DEFAULT, PIO_RETURN_ERROR, NULL)))
+        return ret;
+
+    /* Only do something on max_ntasks tasks. The files are read
+     * back with the NETCDF4P iotype. */
+    if (my_rank < TARGET_NTASKS && PIOc_iotype_available(PIO_IOTYPE_HDF5) &&
+        PIOc_iotype_available(PIO_IOTYPE_NETCDF4P))
+    {
+        int iosysid;  /* The ID for the parallel I/O system. */
+        int ioid;     /* Decomposition ID. */
+        int dim_len[NDIM] = {DIM_LEN};
+        PIO_Offset elements_per_pe = DIM_LEN / TARGET_NTASKS;
+        PIO_Offset compdof[DIM_LEN / TARGET_NTASKS];
+
+        for (int i = 0; i < elements_per_pe; i++)
+            compdof[i] = my_rank * elements_per_pe + i + 1;
+
+        for (int r = 0; r < NUM_REARRANGERS_TO_TEST; r++)
+        {
+            if ((ret = PIOc_Init_Intracomm(test_comm, 2, 2, 0, rearranger[r], &iosysid)))
+                return ret;
+
+            if ((ret = PIOc_InitDecomp(iosysid, PIO_INT, NDIM, dim_len, elements_per_pe,
+                                       compdof, &ioid, NULL, NULL, NULL)))
+                ERR(ret);
+
+            if ((ret = test_iotype_hdf5(iosysid, ioid, my_rank, elements_per_pe)))
+                return ret;
+
+            if ((ret = test_write_2d(iosysid, my_rank)))
+                return ret;
+
+            if ((ret = PIOc_freedecomp(iosysid, ioid)))
+                ERR(ret);
+
+            if ((ret = PIOc_finalize(iosysid)))
+                return ret;
+        } /* next rearranger */
+    } /* endif my_rank < TARGET_NTASKS */
+
+    /* Finalize the MPI library. */
+    printf("%d %s Finalizing...\n", my_rank, TEST_NAME);
+    if ((ret = pio_test_finalize(&test_comm)))
+        return ret;
+
+    printf("%d %s SUCCESS!!\n", my_rank, TEST_NAME);
+    return 0;
+}
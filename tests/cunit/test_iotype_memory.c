@@ -0,0 +1,209 @@
+/*
+ * Tests for the in-memory iotypes, PIO_IOTYPE_MEMORY (data is kept
+ * in memory on the I/O tasks) and PIO_IOTYPE_NULL (data is discarded
+ * after rearrangement).
+ */
+#include <pio.h>
+#include <pio_tests.h>
+
+/* The number of tasks this test should run on. */
+#define TARGET_NTASKS 4
+
+/* The minimum number of tasks this test should run on. */
+#define MIN_NTASKS 4
+
+/* The name of this test. */
+#define TEST_NAME "test_iotype_memory"
+
+/* The number of dimensions in the example data. */
+#define NDIM 1
+
+/* The length of our sample data along the dimension. */
+#define DIM_LEN 16
+
+/* The number of timesteps of data to write. */
+#define NUM_TIMESTEPS 2
+
+/* The name of the variable. */
+#define VAR_NAME "foo"
+
+/* The dimension names. */
+#define DIM_NAME "x"
+#define DIM_NAME_UNLIM "time"
+
+/**
+ * Create a file with one record variable, and write NUM_TIMESTEPS
+ * records to it.
+ *
+ * @param iosysid the IO system ID.
+ * @param ioid the ID of the decomposition.
+ * @param iotype the iotype of the file.
+ * @param my_rank rank of this task.
+ * @param elements_per_pe number of elements on this task.
+ * @param ncidp pointer that gets the ncid of the file.
+ * @param varidp pointer that gets the ID of the variable.
+ * @returns 0 for success, error code otherwise.
+ */
+int create_and_write(int iosysid, int ioid, int iotype, int my_rank,
+                     PIO_Offset elements_per_pe, int *ncidp, int *varidp)
+{
+    char filename[PIO_MAX_NAME + 1];
+    int dimids[NDIM + 1];
+    int test_data[elements_per_pe];
+    int ret;
+
+    sprintf(filename, "%s_%d.nc", TEST_NAME, iotype);
+
+    if ((ret = PIOc_createfile(iosysid, ncidp, &iotype, filename, PIO_CLOBBER)))
+        ERR(ret);
+    if ((ret = PIOc_def_dim(*ncidp, DIM_NAME_UNLIM, PIO_UNLIMITED, &dimids[0])))
+        ERR(ret);
+    if ((ret = PIOc_def_dim(*ncidp, DIM_NAME, DIM_LEN, &dimids[1])))
+        ERR(ret);
+    if ((ret = PIOc_def_var(*ncidp, VAR_NAME, PIO_INT, NDIM + 1, dimids, varidp)))
+        ERR(ret);
+    if ((ret = PIOc_enddef(*ncidp)))
+        ERR(ret);
+
+    for (int t = 0; t < NUM_TIMESTEPS; t++)
+    {
+        for (int i = 0; i < elements_per_pe; i++)
+            test_data[i] = t * DIM_LEN + my_rank * elements_per_pe + i;
+
+        if ((ret = PIOc_setframe(*ncidp, *varidp, t)))
+            ERR(ret);
+        if ((ret = PIOc_write_darray(*ncidp, *varidp, ioid, elements_per_pe, test_data, NULL)))
+            ERR(ret);
+    }
+
+    /* Flush the cached data. */
+    if ((ret = PIOc_sync(*ncidp)))
+        ERR(ret);
+
+    return PIO_NOERR;
+}
+
+/**
+ * Test the in-memory iotypes.
+ *
+ * @param iosysid the IO system ID.
+ * @param ioid the ID of the decomposition.
+ * @param my_rank rank of this task.
+ * @param elements_per_pe number of elements on this task.
+ * @returns 0 for success, error code otherwise.
+ */
+int test_iotype_memory(int iosysid, int ioid, int my_rank, PIO_Offset elements_per_pe)
+{
+    char filename[PIO_MAX_NAME + 1];
+    int test_data_in[elements_per_pe];
+    int ncid, ncid2, varid;
+    int iotype;
+    int nvars;
+    int ret;
+
+    /* The data written to a memory file is read back from memory. */
+    if ((ret = create_and_write(iosysid, ioid, PIO_IOTYPE_MEMORY, my_rank, elements_per_pe,
+                                &ncid, &varid)))
+        return ret;
+    for (int t = 0; t < NUM_TIMESTEPS; t++)
+    {
+        if ((ret = PIOc_setframe(ncid, varid, t)))
+            ERR(ret);
+        if ((ret = PIOc_read_darray(ncid, varid, ioid, elements_per_pe, test_data_in)))
+            ERR(ret);
+        for (int i = 0; i < elements_per_pe; i++)
+            if (test_data_in[i] != t * DIM_LEN + my_rank * elements_per_pe + i)
+                ERR(ERR_WRONG);
+    }
+    if ((ret = PIOc_closefile(ncid)))
+        ERR(ret);
+
+    /* Nothing was written to disk. */
+    iotype = PIO_IOTYPE_NETCDF;
+    sprintf(filename, "%s_%d.nc", TEST_NAME, PIO_IOTYPE_MEMORY);
+    if (PIOc_openfile2(iosysid, &ncid, &iotype, filename, PIO_NOWRITE) == PIO_NOERR)
+        ERR(ERR_WRONG);
+
+    /* With the null iotype the metadata is kept but the data is
+     * discarded. */
+    if ((ret = create_and_write(iosysid, ioid, PIO_IOTYPE_NULL, my_rank, elements_per_pe,
+                                &ncid, &varid)))
+        return ret;
+    if ((ret = PIOc_inq_nvars(ncid, &nvars)))
+        ERR(ret);
+    if (nvars != 1)
+        ERR(ERR_WRONG);
+    if ((ret = PIOc_setframe(ncid, varid, 0)))
+        ERR(ret);
+    if (PIOc_read_darray(ncid, varid, ioid, elements_per_pe, test_data_in) != PIO_EBADIOTYPE)
+        ERR(ERR_WRONG);
+    if ((ret = PIOc_closefile(ncid)))
+        ERR(ret);
+
+    /* Files cannot be opened with the null iotype. */
+    iotype = PIO_IOTYPE_NULL;
+    sprintf(filename, "%s_%d.nc", TEST_NAME, PIO_IOTYPE_NULL);
+    if (PIOc_openfile2(iosysid, &ncid2, &iotype, filename, PIO_NOWRITE) != PIO_EBADIOTYPE)
+        ERR(ERR_WRONG);
+
+    return PIO_NOERR;
+}
+
+/* Run tests for the in-memory iotypes. */
+int main(int argc, char **argv)
+{
+#define NUM_REARRANGERS_TO_TEST 2
+    int rearranger[NUM_REARRANGERS_TO_TEST] = {PIO_REARR_BOX, PIO_REARR_SUBSET};
+    int my_rank;
+    int ntasks;
+    MPI_Comm test_comm; /* A communicator for this test. */
+    int ret;         /* Return code. */
+
+    /* Initialize test. */
+    if ((ret = pio_test_init2(argc, argv, &my_rank, &ntasks, MIN_NTASKS,
+                              MIN_NTASKS, 3, &test_comm)))
+        ERR(ERR_INIT);
+
+    if ((ret = PIOc_set_iosystem_error_handling(PIO_DEFAULT, PIO_RETURN_ERROR, NULL)))
+        return ret;
+
+    /* Only do something on max_ntasks tasks. */
+    if (my_rank < TARGET_NTASKS && PIOc_iotype_available(PIO_IOTYPE_MEMORY))
+    {
+        int iosysid;  /* The ID for the parallel I/O system. */
+        int ioid;     /* Decomposition ID. */
+        int dim_len[NDIM] = {DIM_LEN};
+        PIO_Offset elements_per_pe = DIM_LEN / TARGET_NTASKS;
+        PIO_Offset compdof[DIM_LEN / TARGET_NTASKS];
+
+        for (int i = 0; i < elements_per_pe; i++)
+            compdof[i] = my_rank * elements_per_pe + i + 1;
+
+        for (int r = 0; r < NUM_REARRANGERS_TO_TEST; r++)
+        {
+            if ((ret = PIOc_Init_Intracomm(test_comm, 2, 2, 0, rearranger[r], &iosysid)))
+                return ret;
+
+            if ((ret = PIOc_InitDecomp(iosysid, PIO_INT, NDIM, dim_len, elements_per_pe,
+                                       compdof, &ioid, NULL, NULL, NULL)))
+                ERR(ret);
+
+            if ((ret = test_iotype_memory(iosysid, ioid, my_rank, elements_per_pe)))
+                return ret;
+
+            if ((ret = PIOc_freedecomp(iosysid, ioid)))
+                ERR(ret);
+
+            if ((ret = PIOc_finalize(iosysid)))
+                return ret;
+        } /* next rearranger */
+    } /* endif my_rank < TARGET_NTASKS */
+
+    /* Finalize the MPI library. */
+    printf("%d %s Finalizing...\n", my_rank, TEST_NAME);
+    if ((ret = pio_test_finalize(&test_comm)))
+        return ret;
+
+    printf("%d %s SUCCESS!!\n", my_rank, TEST_NAME);
+    return 0;
+}
@@ -0,0 +1,190 @@
+/*
+ * Tests for the memory statistics of the buffers of an IO system and
+ * of its files (PIOc_get_mem_stats).
+ */
+#include <pio.h>
+#include <pio_tests.h>
+
+/* The number of tasks this test should run on. */
+#define TARGET_NTASKS 4
+
+/* The minimum number of tasks this test should run on. */
+#define MIN_NTASKS 4
+
+/* The name of this test. */
+#define TEST_NAME "test_mem_stats"
+
+/* The number of dimensions in the example data. */
+#define NDIM 1
+
+/* The length of our sample data along the dimension. */
+#define DIM_LEN 16
+
+/* The dimension name. */
+#define DIM_NAME "x"
+
+/* The variable name. */
+#define VAR_NAME "v"
+
+/**
+ * Write an int variable, and check the memory statistics of the
+ * file while the data is cached and after it is written.
+ *
+ * @param iosysid the IO system ID.
+ * @param ioid the ID of the decomposition.
+ * @param iotype the iotype to test.
+ * @param my_rank rank of this task.
+ * @param elements_per_pe number of elements on this task.
+ * @returns 0 for success, error code otherwise.
+ */
+int test_write_mem_stats(int iosysid, int ioid, int iotype, int my_rank,
+                         PIO_Offset elements_per_pe)
+{
+    char filename[PIO_MAX_NAME + 1];
+    pio_mem_stats_t stats;
+    int ncid, dimid, varid;
+    int data[elements_per_pe];
+    int ret;
+
+    sprintf(filename, "%s_%d.nc", TEST_NAME, iotype);
+    if ((ret = PIOc_createfile(iosysid, &ncid, &iotype, filename, PIO_CLOBBER)))
+        ERR(ret);
+    if ((ret = PIOc_def_dim(ncid, DIM_NAME, DIM_LEN, &dimid)))
+        ERR(ret);
+    if ((ret = PIOc_def_var(ncid, VAR_NAME, PIO_INT, NDIM, &dimid, &varid)))
+        ERR(ret);
+    if ((ret = PIOc_enddef(ncid)))
+        ERR(ret);
+
+    /* This should not work. */
+    if (PIOc_get_mem_stats(iosysid, ncid + TEST_VAL_42, false, &stats) != PIO_EBADID)
+        ERR(ERR_WRONG);
+
+    /* No data buffers are held yet. */
+    if ((ret = PIOc_get_mem_stats(iosysid, ncid, false, &stats)))
+        ERR(ret);
+    if (stats.peak[PIO_MEM_WMB][PIO_STAT_MAX] != 0 || stats.peak[PIO_MEM_IOBUF][PIO_STAT_MAX] != 0)
+        ERR(ERR_WRONG);
+
+    /* The data is cached on the compute tasks. */
+    for (int i = 0; i < elements_per_pe; i++)
+        data[i] = my_rank * elements_per_pe + i;
+    if ((ret = PIOc_write_darray(ncid, varid, ioid, elements_per_pe, data, NULL)))
+        ERR(ret);
+    if ((ret = PIOc_get_mem_stats(iosysid, ncid, false, &stats)))
+        ERR(ret);
+    if (stats.cur[PIO_MEM_WMB][PIO_STAT_AVG] != elements_per_pe * sizeof(int) ||
+        stats.cur[PIO_MEM_TOTAL][PIO_STAT_AVG] < stats.cur[PIO_MEM_WMB][PIO_STAT_AVG])
+        ERR(ERR_WRONG);
+
+    /* Writing the data releases the buffers. */
+    if ((ret = PIOc_sync(ncid)))
+        ERR(ret);
+    if ((ret = PIOc_get_mem_stats(iosysid, ncid, true, &stats)))
+        ERR(ret);
+    if (stats.cur[PIO_MEM_WMB][PIO_STAT_MAX] != 0 || stats.cur[PIO_MEM_IOBUF][PIO_STAT_MAX] != 0)
+        ERR(ERR_WRONG);
+    if (stats.peak[PIO_MEM_WMB][PIO_STAT_MIN] != elements_per_pe * sizeof(int) ||
+        stats.peak[PIO_MEM_IOBUF][PIO_STAT_MAX] < elements_per_pe * sizeof(int))
+        ERR(ERR_WRONG);
+    if (stats.peak[PIO_MEM_REARR][PIO_STAT_MAX] != 0)
+        ERR(ERR_WRONG);
+
+    if ((ret = PIOc_closefile(ncid)))
+        ERR(ret);
+
+    return PIO_NOERR;
+}
+
+/* Run tests for the memory statistics. */
+int main(int argc, char **argv)
+{
+    int my_rank;
+    int ntasks;
+    int num_flavors;
+    int flavor[NUM_FLAVORS];
+    MPI_Comm test_comm; /* A communicator for this test. */
+    int ret;         /* Return code. */
+
+    /* Initialize test. */
+    if ((ret = pio_test_init2(argc, argv, &my_rank, &ntasks, MIN_NTASKS,
+                              MIN_NTASKS, 3, &test_comm)))
+        ERR(ERR_INIT);
+
+    if ((ret = PIOc_set_iosystem_error_handling(PIO_DEFAULT, PIO_RETURN_ERROR, NULL)))
+        return ret;
+
+    /* Figure out iotypes. */
+    if ((ret = get_iotypes(&num_flavors, flavor)))
+        ERR(ret);
+
+    /* Only do something on max_ntasks tasks. */
+    if (my_rank < TARGET_NTASKS)
+    {
+        int iosysid;  /* The ID for the parallel I/O system. */
+        int ioid;     /* The decomposition ID. */
+        int dim_len[NDIM] = {DIM_LEN};
+        PIO_Offset elements_per_pe = DIM_LEN / TARGET_NTASKS;
+        PIO_Offset compdof[DIM_LEN / TARGET_NTASKS];
+        pio_mem_stats_t stats;
+
+        for (int i = 0; i < elements_per_pe; i++)
+            compdof[i] = my_rank * elements_per_pe + i + 1;
+
+        if ((ret = PIOc_Init_Intracomm(test_comm, 2, 2, 0, PIO_REARR_BOX, &iosysid)))
+            return ret;
+
+        /* This should not work. */
+        if (PIOc_get_mem_stats(iosysid + TEST_VAL_42, PIO_GLOBAL, false, &stats) != PIO_EBADID)
+            ERR(ERR_WRONG);
+
+        /* The rearranger of the decomposition holds memory on all
+         * tasks. */
+        if ((ret = PIOc_InitDecomp(iosysid, PIO_INT, NDIM, dim_len, elements_per_pe,
+                                   compdof, &ioid, NULL, NULL, NULL)))
+            ERR(ret);
+        if ((ret = PIOc_get_mem_stats(iosysid, PIO_GLOBAL, true, &stats)))
+            ERR(ret);
+        if (stats.cur[PIO_MEM_REARR][PIO_STAT_MIN] <= 0 ||
+            stats.cur[PIO_MEM_TOTAL][PIO_STAT_AVG] != stats.cur[PIO_MEM_REARR][PIO_STAT_AVG])
+            ERR(ERR_WRONG);
+
+        for (int f = 0; f < num_flavors; f++)
+            if ((ret = test_write_mem_stats(iosysid, ioid, flavor[f], my_rank, elements_per_pe)))
+                return ret;
+
+        /* The buffers of the files are in the statistics of the IO
+         * system. */
+        if ((ret = PIOc_get_mem_stats(iosysid, PIO_GLOBAL, false, &stats)))
+            ERR(ret);
+        if (stats.peak[PIO_MEM_WMB][PIO_STAT_MAX] != elements_per_pe * sizeof(int))
+            ERR(ERR_WRONG);
+
+        /* The released buffers are kept for reuse, up to the buffer
+         * size limit, unless they are allocated with malloc(). */
+        if ((!PIO_USE_MALLOC && stats.cur[PIO_MEM_ARENA][PIO_STAT_MAX] <= 0) ||
+            stats.cur[PIO_MEM_ARENA][PIO_STAT_MAX] > PIOc_set_buffer_size_limit(0))
+            ERR(ERR_WRONG);
+
+        /* Freeing the decomposition releases the memory of the
+         * rearranger, only the buffers kept for reuse are held. */
+        if ((ret = PIOc_freedecomp(iosysid, ioid)))
+            ERR(ret);
+        if ((ret = PIOc_get_mem_stats(iosysid, PIO_GLOBAL, false, &stats)))
+            ERR(ret);
+        if (stats.cur[PIO_MEM_TOTAL][PIO_STAT_MAX] != stats.cur[PIO_MEM_ARENA][PIO_STAT_MAX] ||
+            stats.peak[PIO_MEM_REARR][PIO_STAT_MAX] <= 0)
+            ERR(ERR_WRONG);
+
+        if ((ret = PIOc_finalize(iosysid)))
+            return ret;
+    } /* endif my_rank < TARGET_NTASKS */
+
+    /* Finalize the MPI library. */
+    printf("%d %s Finalizing...\n", my_rank, TEST_NAME);
+    if ((ret = pio_test_finalize(&test_comm)))
+        return ret;
+
+    printf("%d %s SUCCESS!!\n", my_rank, TEST_NAME);
+    return 0;
+}
@@ -0,0 +1,207 @@
+/*
+ * Tests for the in-memory logs of the micro timers, and the stats
+ * written out when the logs are flushed (mtimer_flush_logs()).
+ */
+#include <pio.h>
+#include <pio_tests.h>
+#include <pio_timer.h>
+
+/* The number of tasks this test should run on. */
+#define TARGET_NTASKS 4
+
+/* The minimum number of tasks this test should run on. */
+#define MIN_NTASKS 4
+
+/* The name of this test. */
+#define TEST_NAME "test_mtimer_logs"
+
+/* The timer log file. */
+#define LOG_FNAME TEST_NAME "_log.txt"
+
+/* A log file that cannot be opened. */
+#define BAD_LOG_FNAME TEST_NAME "_no_such_dir/log.txt"
+
+/**
+ * Look for a line starting with prefix in the timer log file, and
+ * read the count and the min/max times of the event.
+ *
+ * @param prefix the timer name and the log message of the event.
+ * @param count pointer that gets the number of events.
+ * @param min_time pointer that gets the min time across tasks.
+ * @param max_time pointer that gets the max time across tasks.
+ * @returns 0 if the line is found, ERR_WRONG otherwise.
+ */
+int find_log_line(const char *prefix, int *count, double *min_time, double *max_time)
+{
+    char line[PIO_MAX_NAME * 2 + 1];
+    size_t len = strlen(prefix);
+    FILE *fp;
+    int ret = ERR_WRONG;
+
+    if (!(fp = fopen(LOG_FNAME, "r")))
+        return ERR_WRONG;
+    while (fgets(line, sizeof(line), fp))
+    {
+        if (!strncmp(line, prefix, len) &&
+            sscanf(line + len, " count=%d time=%lf %lf", count, min_time, max_time) == 3)
+            ret = PIO_NOERR;
+    }
+    fclose(fp);
+
+    return ret;
+}
+
+/**
+ * Time events and check the stats written out when the logs are
+ * flushed, for logs with the same entries on all tasks and for logs
+ * with different entries.
+ *
+ * @param my_rank rank of this task.
+ * @param ntasks number of tasks in test_comm.
+ * @param test_comm the communicator the timers operate on.
+ * @returns 0 for success, error code otherwise.
+ */
+int test_flush_logs(int my_rank, int ntasks, MPI_Comm test_comm)
+{
+    mtimer_t mt;
+    char msg[PIO_MAX_NAME + 1];
+    int count;
+    double min_time, max_time;
+    int ret;
+
+    if (!(mt = mtimer_create("tm", test_comm, LOG_FNAME)))
+        ERR(ERR_WRONG);
+
+    /* The same events on all tasks, each task spends (rank + 1)
+     * seconds on each event. */
+    for (int e = 0; e < 2; e++)
+    {
+        if ((ret = mtimer_start(mt)))
+            ERR(ret);
+        if ((ret = mtimer_update(mt, my_rank + 1)))
+            ERR(ret);
+        if ((ret = mtimer_stop(mt, "same")))
+            ERR(ret);
+    }
+    if ((ret = mtimer_flush_logs(test_comm)))
+        ERR(ret);
+
+    if (!my_rank)
+    {
+        if ((ret = find_log_line("tm same", &count, &min_time, &max_time)))
+            ERR(ret);
+        if (count != 2 || min_time < 2 || min_time > 3 || max_time < 2 * ntasks)
+            ERR(ERR_WRONG);
+    }
+
+    /* An event only timed on this task. */
+    if ((ret = mtimer_start(mt)))
+        ERR(ret);
+    sprintf(msg, "rank%d", my_rank);
+    if ((ret = mtimer_stop(mt, msg)))
+        ERR(ret);
+    if ((ret = mtimer_flush_logs(test_comm)))
+        ERR(ret);
+
+    if (!my_rank)
+    {
+        for (int r = 0; r < ntasks; r++)
+        {
+            char prefix[PIO_MAX_NAME + 1];
+
+            sprintf(prefix, "tm rank%d", r);
+            if ((ret = find_log_line(prefix, &count, &min_time, &max_time)))
+                ERR(ret);
+            if (count != 1)
+                ERR(ERR_WRONG);
+        }
+    }
+
+    if ((ret = mtimer_destroy(&mt)))
+        ERR(ret);
+
+    return PIO_NOERR;
+}
+
+/**
+ * Check that failing to write out the stats, which is done on the
+ * root task only, is returned on all tasks (and that the tasks do
+ * not hang).
+ *
+ * @param my_rank rank of this task.
+ * @param test_comm the communicator the timers operate on.
+ * @returns 0 for success, error code otherwise.
+ */
+int test_flush_logs_error(int my_rank, MPI_Comm test_comm)
+{
+    mtimer_t mt;
+    char msg[PIO_MAX_NAME + 1];
+    int ret;
+
+    if (!(mt = mtimer_create("tm", test_comm, BAD_LOG_FNAME)))
+        ERR(ERR_WRONG);
+
+    /* The same entries on all tasks. */
+    if ((ret = mtimer_start(mt)))
+        ERR(ret);
+    if ((ret = mtimer_stop(mt, "same")))
+        ERR(ret);
+    if (mtimer_flush_logs(test_comm) == PIO_NOERR)
+        ERR(ERR_WRONG);
+
+    /* Different entries on the tasks. */
+    if ((ret = mtimer_start(mt)))
+        ERR(ret);
+    sprintf(msg, "rank%d", my_rank);
+    if ((ret = mtimer_stop(mt, msg)))
+        ERR(ret);
+    if (mtimer_flush_logs(test_comm) == PIO_NOERR)
+        ERR(ERR_WRONG);
+
+    if ((ret = mtimer_destroy(&mt)))
+        ERR(ret);
+
+    return PIO_NOERR;
+}
+
+/* Run tests for the micro timer logs. */
+int main(int argc, char **argv)
+{
+    int my_rank;
+    int ntasks;
+    MPI_Comm test_comm; /* A communicator for this test. */
+    int ret;         /* Return code. */
+
+    /* Initialize test. */
+    if ((ret = pio_test_init2(argc, argv, &my_rank, &ntasks, MIN_NTASKS,
+                              MIN_NTASKS, 3, &test_comm)))
+        ERR(ERR_INIT);
+
+    /* Only do something on max_ntasks tasks. */
+    if (my_rank < TARGET_NTASKS)
+    {
+        /* The stats are appended to the log file. */
+        if (!my_rank)
+            remove(LOG_FNAME);
+
+        if ((ret = mtimer_init(PIO_MICRO_MPI_WTIME_ROOT)))
+            ERR(ret);
+
+        if ((ret = test_flush_logs(my_rank, TARGET_NTASKS, test_comm)))
+            return ret;
+
+        if ((ret = test_flush_logs_error(my_rank, test_comm)))
+            return ret;
+
+        if ((ret = mtimer_finalize()))
+            ERR(ret);
+    } /* endif my_rank < TARGET_NTASKS */
+
+    /* Finalize the MPI library. */
+    printf("%d %s Finalizing...\n", my_rank, TEST_NAME);
+    if ((ret = pio_test_finalize(&test_comm)))
+        return ret;
+
+    printf("%d %s SUCCESS!!\n", my_rank, TEST_NAME);
+    return 0;
+}
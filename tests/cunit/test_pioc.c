@@ -1646,8 +1646,7 @@ int test_malloc_iodesc2(int iosysid, int my_rank)
         if (iodesc->ndims != 1)
             return ERR_WRONG;
         ioid = pio_add_to_iodesc_list(iodesc, MPI_COMM_NULL);
-        if (iodesc->firstregion)
-            free_region_list(iodesc->firstregion);
+        free_region_table(iodesc->regions);
         if ((ret = pio_delete_iodesc_from_list(ioid)))
             return ret;
     }
@@ -142,7 +142,7 @@ int test_create_mpi_datatypes()
 
     {
         int msgcnt = 1;
-        PIO_Offset mindex[1] = {0};
+        int mindex[1] = {0};
         int mcount[1] = {1};
         MPI_Datatype mtype;
 
@@ -157,7 +157,7 @@ int test_create_mpi_datatypes()
 
     {
         int msgcnt = 4;
-        PIO_Offset mindex[4] = {0, 0, 0, 0};
+        int mindex[4] = {0, 0, 0, 0};
         int mcount[4] = {1, 1, 1, 1};
         MPI_Datatype mtype2[4];
 
@@ -261,16 +261,15 @@ int test_compute_maxIObuffersize(MPI_Comm test_comm, int my_rank)
         /* This is a simple test with one region containing 1 data
          * element. */
         io_desc_t iodesc;
-        io_region *ior1;
+        io_region_table *regions;
         int ndims = 1;
 
-        /* This is how we allocate a region. */
-        if ((ret = alloc_region2(NULL, ndims, &ior1)))
+        /* This is how we allocate a region table. */
+        if ((ret = alloc_region_table(NULL, ndims, &regions)))
             return ret;
-        ior1->next = NULL;
-        ior1->count[0] = 1;
+        REGION_COUNT(regions, 0)[0] = 1;
 
-        iodesc.firstregion = ior1;
+        iodesc.regions = regions;
         iodesc.ndims = 1;
 
         /* Run the function. Simplest possible case. */
@@ -279,34 +278,32 @@ int test_compute_maxIObuffersize(MPI_Comm test_comm, int my_rank)
         if (iodesc.maxiobuflen != 1)
             return ERR_WRONG;
 
-        /* Free resources for the region. */
-        free(ior1->start);
-        free(ior1->count);
-        free(ior1);
-
+        /* Free resources for the region table. */
+        free_region_table(regions);
     }
 
     {
         /* This also has a single region, but with 2 dims and count
          * values > 1. */
         io_desc_t iodesc;
-        io_region *ior2;
+        io_region_table *regions;
         int ndims = 2;
 
-        /* This is how we allocate a region. */
-        if ((ret = alloc_region2(NULL, ndims, &ior2)))
+        /* This is how we allocate a region table. */
+        if ((ret = alloc_region_table(NULL, ndims, &regions)))
             return ret;
 
-        /* These should be 0. */
+        /* There is one region, and these should be 0. */
+        if (regions->nregions != 1 || regions->ndims != ndims)
+            return ERR_WRONG;
         for (int i = 0; i < ndims; i++)
-            if (ior2->start[i] != 0 || ior2->count[i] != 0)
+            if (REGION_START(regions, 0)[i] != 0 || REGION_COUNT(regions, 0)[i] != 0)
                 return ERR_WRONG;
 
-        ior2->next = NULL;
-        ior2->count[0] = 10;
-        ior2->count[1] = 2;
+        REGION_COUNT(regions, 0)[0] = 10;
+        REGION_COUNT(regions, 0)[1] = 2;
 
-        iodesc.firstregion = ior2;
+        iodesc.regions = regions;
         iodesc.ndims = 2;
 
         /* Run the function. */
@@ -315,33 +312,30 @@ int test_compute_maxIObuffersize(MPI_Comm test_comm, int my_rank)
         if (iodesc.maxiobuflen != 20)
             return ERR_WRONG;
 
-        /* Free resources for the region. */
-        free(ior2->start);
-        free(ior2->count);
-        free(ior2);
+        /* Free resources for the region table. */
+        free_region_table(regions);
     }
 
     {
         /* This test has two regions of different sizes. */
         io_desc_t iodesc;
-        io_region *ior3;
-        io_region *ior4;
+        io_region_table *regions;
         int ndims = 2;
 
-        /* This is how we allocate a region. */
-        if ((ret = alloc_region2(NULL, ndims, &ior4)))
+        /* This is how we allocate a region table. */
+        if ((ret = alloc_region_table(NULL, ndims, &regions)))
             return ret;
-        ior4->next = NULL;
-        ior4->count[0] = 10;
-        ior4->count[1] = 2;
-
-        if ((ret = alloc_region2(NULL, ndims, &ior3)))
+        if ((ret = grow_region_table(NULL, regions, 2)))
             return ret;
-        ior3->next = ior4;
-        ior3->count[0] = 100;
-        ior3->count[1] = 5;
+        if (regions->size < 2)
+            return ERR_WRONG;
+        regions->nregions = 2;
+        REGION_COUNT(regions, 0)[0] = 100;
+        REGION_COUNT(regions, 0)[1] = 5;
+        REGION_COUNT(regions, 1)[0] = 10;
+        REGION_COUNT(regions, 1)[1] = 2;
 
-        iodesc.firstregion = ior3;
+        iodesc.regions = regions;
         iodesc.ndims = 2;
 
         /* Run the function. */
@@ -351,13 +345,8 @@ int test_compute_maxIObuffersize(MPI_Comm test_comm, int my_rank)
         if (iodesc.maxiobuflen != 520)
             return ERR_WRONG;
 
-        /* Free resources for the region. */
-        free(ior4->start);
-        free(ior4->count);
-        free(ior4);
-        free(ior3->start);
-        free(ior3->count);
-        free(ior3);
+        /* Free resources for the region table. */
+        free_region_table(regions);
     }
 
     return 0;
@@ -369,7 +358,6 @@ int test_determine_fill(MPI_Comm test_comm)
     iosystem_desc_t *ios;
     io_desc_t *iodesc;
     int gsize[1] = {4};
-    PIO_Offset compmap[1] = {1};
     int ret;
 
     /* Initialize ios. */
@@ -385,14 +373,14 @@ int test_determine_fill(MPI_Comm test_comm)
     iodesc->llen = 1;
 
     /* We don't need fill. */
-    if ((ret = determine_fill(ios, iodesc, gsize, compmap)))
+    if ((ret = determine_fill(ios, iodesc, gsize)))
         return ret;
     if (iodesc->needsfill)
         return ERR_WRONG;
 
     /* Change settings, so now we do need fill. */
     iodesc->llen = 0;
-    if ((ret = determine_fill(ios, iodesc, gsize, compmap)))
+    if ((ret = determine_fill(ios, iodesc, gsize)))
         return ret;
     if (!iodesc->needsfill)
         return ERR_WRONG;
@@ -409,32 +397,115 @@ int test_get_regions(int my_rank)
 {
 #define MAPLEN 2
     int ndims = NDIM1;
-    const int gdimlen[NDIM1] = {8};
+    const int gdimlen[NDIM1] = {10};
     /* Don't forget map is 1-based!! */
     PIO_Offset map[MAPLEN] = {(my_rank * 2) + 1, ((my_rank + 1) * 2) + 1};
     int maxregions;
-    io_region *ior1;
+    io_region_table *regions;
     int ret;
 
-    /* This is how we allocate a region. */
-    if ((ret = alloc_region2(NULL, NDIM1, &ior1)))
+    /* This is how we allocate a region table. */
+    if ((ret = alloc_region_table(NULL, NDIM1, &regions)))
         return ret;
-    ior1->next = NULL;
-    ior1->count[0] = 1;
 
     /* Call the function we are testing. */
-    if ((ret = get_regions(ndims, gdimlen, MAPLEN, map, &maxregions, ior1)))
+    if ((ret = get_regions(ndims, gdimlen, MAPLEN, map, &maxregions, regions)))
+        return ret;
+    if (maxregions != 2 || regions->nregions != 2)
+        return ERR_WRONG;
+
+    /* The two elements of the map are not contiguous. */
+    for (int r = 0; r < 2; r++)
+        if (REGION_START(regions, r)[0] != map[r] - 1 || REGION_COUNT(regions, r)[0] != 1 ||
+            regions->loffset[r] != r)
+            return ERR_WRONG;
+
+    /* Find the regions again, with a contiguous map. */
+    map[1] = map[0] + 1;
+    if ((ret = get_regions(ndims, gdimlen, MAPLEN, map, &maxregions, regions)))
+        return ret;
+    if (maxregions != 1 || REGION_START(regions, 0)[0] != map[0] - 1 ||
+        REGION_COUNT(regions, 0)[0] != 2)
+        return ERR_WRONG;
+
+    /* With no data there is one empty region. */
+    if ((ret = get_regions(ndims, gdimlen, 0, NULL, &maxregions, regions)))
+        return ret;
+    if (maxregions != 1 || REGION_COUNT(regions, 0)[0] != 0)
+        return ERR_WRONG;
+
+    /* Free resources for the region table. */
+    free_region_table(regions);
+
+    return 0;
+}
+
+/* Run tests for coalesce_regions() function. */
+int test_coalesce_regions(int my_rank)
+{
+#define NDIM2 2
+#define NROWS 4
+#define COALESCE_MAPLEN (NROWS * 5)
+    int ndims = NDIM2;
+    const int gdimlen[NDIM2] = {8, 8};
+    PIO_Offset map[COALESCE_MAPLEN];
+    PIO_Offset sorted_map[COALESCE_MAPLEN];
+    iosystem_desc_t ios;
+    io_desc_t iodesc;
+    int n = 0;
+    int ret;
+
+    /* Two boxes next to each other, columns 0-2 and 5-6 of the first
+     * rows. In the sorted map their rows alternate. Don't forget map
+     * is 1-based!! */
+    for (int r = 0; r < NROWS; r++)
+    {
+        for (int c = 0; c < 3; c++)
+            map[n++] = r * gdimlen[1] + c + 1;
+        for (int c = 5; c < 7; c++)
+            map[n++] = r * gdimlen[1] + c + 1;
+    }
+    memcpy(sorted_map, map, sizeof(map));
+
+    memset(&iodesc, 0, sizeof(io_desc_t));
+    iodesc.ndims = ndims;
+    iodesc.llen = COALESCE_MAPLEN;
+    if (!(iodesc.rindex = malloc(COALESCE_MAPLEN * sizeof(int))))
+        return PIO_ENOMEM;
+    for (int i = 0; i < COALESCE_MAPLEN; i++)
+        iodesc.rindex[i] = i;
+    if ((ret = alloc_region_table(NULL, ndims, &iodesc.regions)))
         return ret;
-    if (maxregions != 2)
+
+    /* Each row of each box is a region. */
+    if ((ret = get_regions(ndims, gdimlen, COALESCE_MAPLEN, map, &iodesc.maxregions,
+                           iodesc.regions)))
+        return ret;
+    if (iodesc.maxregions != 2 * NROWS)
         return ERR_WRONG;
 
-    /* Free resources for the region. */
-    free(ior1->next->start);
-    free(ior1->next->count);
-    free(ior1->next);
-    free(ior1->start);
-    free(ior1->count);
-    free(ior1);
+    /* After coalescing each box is a region. */
+    if ((ret = coalesce_regions(&ios, &iodesc, gdimlen, map)))
+        return ret;
+    if (iodesc.maxregions != 2 || iodesc.regions->nregions != 2)
+        return ERR_WRONG;
+    if (REGION_START(iodesc.regions, 0)[0] != 0 || REGION_START(iodesc.regions, 0)[1] != 0 ||
+        REGION_COUNT(iodesc.regions, 0)[0] != NROWS || REGION_COUNT(iodesc.regions, 0)[1] != 3)
+        return ERR_WRONG;
+    if (REGION_START(iodesc.regions, 1)[0] != 0 || REGION_START(iodesc.regions, 1)[1] != 5 ||
+        REGION_COUNT(iodesc.regions, 1)[0] != NROWS || REGION_COUNT(iodesc.regions, 1)[1] != 2 ||
+        iodesc.regions->loffset[1] != NROWS * 3)
+        return ERR_WRONG;
+
+    /* The data of each element of the sorted map goes where the new
+     * map has it. */
+    for (int i = 0; i < COALESCE_MAPLEN; i++)
+        if (map[iodesc.rindex[i]] != sorted_map[i])
+            return ERR_WRONG;
+
+    /* Free resources. */
+    free(iodesc.rindex);
+    free_region_table(iodesc.regions);
 
     return 0;
 }
@@ -496,6 +567,8 @@ int test_define_iodesc_datatypes()
         io_desc_t iodesc;
 
         /* Set up test for IO task with BOX rearranger to create one type. */
+        memset(&ios, 0, sizeof(iosystem_desc_t));
+        memset(&iodesc, 0, sizeof(io_desc_t));
         ios.ioproc = 1; /* this is IO proc. */
         ios.compproc = 1; /* this is also compute proc. */
         ios.num_iotasks = 4; /* The number of IO tasks. */
@@ -510,7 +583,7 @@ int test_define_iodesc_datatypes()
             return PIO_ENOMEM;
         if (!(iodesc.rfrom = malloc(iodesc.nrecvs * sizeof(int))))
             return PIO_ENOMEM;
-        if (!(iodesc.rindex = malloc(1 * sizeof(PIO_Offset))))
+        if (!(iodesc.rindex = malloc(1 * sizeof(int))))
             return PIO_ENOMEM;
         iodesc.rindex[0] = 0;
         iodesc.rcount[0] = 1;
@@ -520,7 +593,7 @@ int test_define_iodesc_datatypes()
         /* The two rearrangers create a different number of send types. */
         int num_send_types = iodesc.rearranger == PIO_REARR_BOX ? ios.num_iotasks : 1;
 
-        if (!(iodesc.sindex = malloc(num_send_types * sizeof(PIO_Offset))))
+        if (!(iodesc.sindex = malloc(num_send_types * sizeof(int))))
             return PIO_ENOMEM;
         if (!(iodesc.scount = malloc(num_send_types * sizeof(int))))
             return PIO_ENOMEM;
@@ -650,7 +723,7 @@ int test_box_rearrange_create(MPI_Comm test_comm, int my_rank)
 {
     iosystem_desc_t *ios;
     io_desc_t *iodesc;
-    io_region *ior1;
+    io_region_table *regions;
     int maplen = MAPLEN2;
     PIO_Offset compmap[MAPLEN2] = {(my_rank * 2) + 1, ((my_rank + 1) * 2) + 1};
     const int gdimlen[NDIM1] = {8};
@@ -691,16 +764,18 @@ int test_box_rearrange_create(MPI_Comm test_comm, int my_rank)
     for (int i = 0; i < TARGET_NTASKS; i++)
         ios->compranks[i] = i;
 
-    /* This is how we allocate a region. */
-    if ((ret = alloc_region2(NULL, NDIM1, &ior1)))
+    /* This is how we allocate a region table. */
+    if ((ret = alloc_region_table(NULL, NDIM1, &regions)))
         return ret;
     if (my_rank == 0)
-        ior1->count[0] = 8;
+        REGION_COUNT(regions, 0)[0] = 8;
 
-    iodesc->firstregion = ior1;
+    iodesc->regions = regions;
 
     /* We are finally ready to run the code under test. */
-    if ((ret = box_rearrange_create(ios, maplen, compmap, gdimlen, ndims, iodesc)))
+    if ((ret = set_iodesc_map(ios, iodesc, maplen, compmap)))
+        return ret;
+    if ((ret = box_rearrange_create(ios, gdimlen, ndims, iodesc)))
         return ret;
 
     /* Check some results. */
@@ -746,11 +821,11 @@ int test_box_rearrange_create(MPI_Comm test_comm, int my_rank)
     free(iodesc->rcount);
     free(iodesc->rfrom);
     free(iodesc->rindex);
+    free(iodesc->map_start);
+    free(iodesc->map_count);
 
     /* Free resources from test. */
-    free(ior1->start);
-    free(ior1->count);
-    free(ior1);
+    free_region_table(regions);
     free(ios->ioranks);
     free(ios->compranks);
     free(iodesc);
@@ -765,7 +840,7 @@ int test_box_rearrange_create_2(MPI_Comm test_comm, int my_rank)
 #define MAPLEN2 2
     iosystem_desc_t *ios;
     io_desc_t *iodesc;
-    io_region *ior1;
+    io_region_table *regions;
     int maplen = MAPLEN2;
     PIO_Offset compmap[MAPLEN2] = {1, 0};
     const int gdimlen[NDIM1] = {8};
@@ -809,17 +884,18 @@ int test_box_rearrange_create_2(MPI_Comm test_comm, int my_rank)
     for (int i = 0; i < TARGET_NTASKS; i++)
         ios->compranks[i] = i;
 
-    /* This is how we allocate a region. */
-    if ((ret = alloc_region2(NULL, NDIM1, &ior1)))
+    /* This is how we allocate a region table. */
+    if ((ret = alloc_region_table(NULL, NDIM1, &regions)))
         return ret;
-    ior1->next = NULL;
     if (my_rank == 0)
-        ior1->count[0] = 8;
+        REGION_COUNT(regions, 0)[0] = 8;
 
-    iodesc->firstregion = ior1;
+    iodesc->regions = regions;
 
     /* We are finally ready to run the code under test. */
-    if ((ret = box_rearrange_create(ios, maplen, compmap, gdimlen, ndims, iodesc)))
+    if ((ret = set_iodesc_map(ios, iodesc, maplen, compmap)))
+        return ret;
+    if ((ret = box_rearrange_create(ios, gdimlen, ndims, iodesc)))
         return ret;
 
     /* Check some results. */
@@ -861,11 +937,11 @@ int test_box_rearrange_create_2(MPI_Comm test_comm, int my_rank)
     free(iodesc->rcount);
     free(iodesc->rfrom);
     free(iodesc->rindex);
+    free(iodesc->map_start);
+    free(iodesc->map_count);
 
     /* Free resources from test. */
-    free(ior1->start);
-    free(ior1->count);
-    free(ior1);
+    free_region_table(regions);
     free(ios->ioranks);
     free(ios->compranks);
     free(iodesc);
@@ -921,7 +997,7 @@ int test_rearrange_comp2io(MPI_Comm test_comm, int my_rank)
     void *sbuf = NULL;
     void *rbuf = NULL;
     int nvars = 1;
-    io_region *ior1;
+    io_region_table *regions;
     int maplen = 2;
     PIO_Offset compmap[2] = {1, 0};
     const int gdimlen[NDIM1] = {8};
@@ -985,17 +1061,18 @@ int test_rearrange_comp2io(MPI_Comm test_comm, int my_rank)
     for (int i = 0; i < TARGET_NTASKS; i++)
         ios->compranks[i] = i;
 
-    /* This is how we allocate a region. */
-    if ((ret = alloc_region2(NULL, NDIM1, &ior1)))
+    /* This is how we allocate a region table. */
+    if ((ret = alloc_region_table(NULL, NDIM1, &regions)))
         return ret;
-    ior1->next = NULL;
     if (my_rank == 0)
-        ior1->count[0] = 8;
+        REGION_COUNT(regions, 0)[0] = 8;
 
-    iodesc->firstregion = ior1;
+    iodesc->regions = regions;
 
     /* Create the box rearranger. */
-    if ((ret = box_rearrange_create(ios, maplen, compmap, gdimlen, ndims, iodesc)))
+    if ((ret = set_iodesc_map(ios, iodesc, maplen, compmap)))
+        return ret;
+    if ((ret = box_rearrange_create(ios, gdimlen, ndims, iodesc)))
         return ret;
 
     /* Run the function to test. */
@@ -1024,11 +1101,11 @@ int test_rearrange_comp2io(MPI_Comm test_comm, int my_rank)
     free(iodesc->rcount);
     free(iodesc->rfrom);
     free(iodesc->rindex);
+    free(iodesc->map_start);
+    free(iodesc->map_count);
 
     /* Free resources from test. */
-    free(ior1->start);
-    free(ior1->count);
-    free(ior1);
+    free_region_table(regions);
     free(ios->ioranks);
     free(ios->compranks);
     free(iodesc);
@@ -1046,7 +1123,7 @@ int test_rearrange_io2comp(MPI_Comm test_comm, int my_rank)
     io_desc_t *iodesc;
     void *sbuf = NULL;
     void *rbuf = NULL;
-    io_region *ior1;
+    io_region_table *regions;
     int maplen = 2;
     PIO_Offset compmap[2] = {1, 0};
     const int gdimlen[NDIM1] = {8};
@@ -1114,17 +1191,18 @@ int test_rearrange_io2comp(MPI_Comm test_comm, int my_rank)
     for (int i = 0; i < TARGET_NTASKS; i++)
         ios->compranks[i] = i;
 
-    /* This is how we allocate a region. */
-    if ((ret = alloc_region2(NULL, NDIM1, &ior1)))
+    /* This is how we allocate a region table. */
+    if ((ret = alloc_region_table(NULL, NDIM1, &regions)))
         return ret;
-    ior1->next = NULL;
     if (my_rank == 0)
-        ior1->count[0] = 8;
+        REGION_COUNT(regions, 0)[0] = 8;
 
-    iodesc->firstregion = ior1;
+    iodesc->regions = regions;
 
     /* Create the box rearranger. */
-    if ((ret = box_rearrange_create(ios, maplen, compmap, gdimlen, ndims, iodesc)))
+    if ((ret = set_iodesc_map(ios, iodesc, maplen, compmap)))
+        return ret;
+    if ((ret = box_rearrange_create(ios, gdimlen, ndims, iodesc)))
         return ret;
 
     /* Run the function to test. */
@@ -1153,11 +1231,11 @@ int test_rearrange_io2comp(MPI_Comm test_comm, int my_rank)
     free(iodesc->rcount);
     free(iodesc->rfrom);
     free(iodesc->rindex);
+    free(iodesc->map_start);
+    free(iodesc->map_count);
 
     /* Free resources from test. */
-    free(ior1->start);
-    free(ior1->count);
-    free(ior1);
+    free_region_table(regions);
     free(ios->ioranks);
     free(ios->compranks);
     free(iodesc);
@@ -1201,6 +1279,10 @@ int run_no_iosys_tests(int my_rank, MPI_Comm test_comm)
     if ((ret = test_get_regions(my_rank)))
         return ret;
 
+    printf("%d running tests for coalesce_regions()\n", my_rank);
+    if ((ret = test_coalesce_regions(my_rank)))
+        return ret;
+
     printf("%d running create_mpi_datatypes tests\n", my_rank);
     if ((ret = test_create_mpi_datatypes()))
         return ret;
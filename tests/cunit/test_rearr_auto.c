@@ -0,0 +1,185 @@
+/*
+ * Tests for choosing the rearranger of decompositions from their
+ * maps (PIO_REARR_AUTO).
+ */
+#include <pio.h>
+#include <pio_internal.h>
+#include <pio_tests.h>
+
+/* The number of tasks this test should run on. */
+#define TARGET_NTASKS 4
+
+/* The minimum number of tasks this test should run on. */
+#define MIN_NTASKS 4
+
+/* The name of this test. */
+#define TEST_NAME "test_rearr_auto"
+
+/* The number of dimensions in the example data. */
+#define NDIM 1
+
+/* The length of our sample data along the dimension. This is large
+ * enough for the box rearranger to use both IO tasks. */
+#define DIM_LEN 1024
+
+/* The number of elements of each task in the sparse map. */
+#define SPARSE_LEN 2
+
+/* The name of the variable in the netCDF output files. */
+#define VAR_NAME "foo"
+
+/* The dimension name. */
+#define DIM_NAME "x"
+
+/**
+ * Write and read back a variable with a decomposition.
+ *
+ * @param iosysid the IO system ID.
+ * @param ioid the ID of the decomposition.
+ * @param iotype the iotype to test.
+ * @param my_rank rank of this task.
+ * @param maplen number of elements on this task.
+ * @param compdof the map of this task.
+ * @returns 0 for success, error code otherwise.
+ */
+int test_write_read(int iosysid, int ioid, int iotype, int my_rank,
+                    PIO_Offset maplen, PIO_Offset *compdof)
+{
+    char filename[PIO_MAX_NAME + 1];
+    int ncid, varid, dimid;
+    int test_data[maplen];
+    int test_data_in[maplen];
+    int ret;
+
+    sprintf(filename, "%s_%d_%lld.nc", TEST_NAME, iotype, (long long)maplen);
+    if ((ret = PIOc_createfile(iosysid, &ncid, &iotype, filename, PIO_CLOBBER)))
+        ERR(ret);
+    if ((ret = PIOc_def_dim(ncid, DIM_NAME, DIM_LEN, &dimid)))
+        ERR(ret);
+    if ((ret = PIOc_def_var(ncid, VAR_NAME, PIO_INT, NDIM, &dimid, &varid)))
+        ERR(ret);
+    if ((ret = PIOc_enddef(ncid)))
+        ERR(ret);
+
+    for (int i = 0; i < maplen; i++)
+        test_data[i] = compdof[i];
+    if ((ret = PIOc_write_darray(ncid, varid, ioid, maplen, test_data, NULL)))
+        ERR(ret);
+    if ((ret = PIOc_sync(ncid)))
+        ERR(ret);
+
+    if ((ret = PIOc_read_darray(ncid, varid, ioid, maplen, test_data_in)))
+        ERR(ret);
+    for (int i = 0; i < maplen; i++)
+        if (test_data_in[i] != test_data[i])
+            ERR(ERR_WRONG);
+
+    if ((ret = PIOc_closefile(ncid)))
+        ERR(ret);
+
+    return PIO_NOERR;
+}
+
+/**
+ * Create a decomposition with PIO_REARR_AUTO, check the rearranger
+ * chosen for it and write and read data with it.
+ *
+ * @param iosysid the IO system ID.
+ * @param num_flavors the number of iotypes available.
+ * @param flavor the iotypes available.
+ * @param my_rank rank of this task.
+ * @param maplen number of elements on this task.
+ * @param compdof the map of this task.
+ * @param expected the rearranger expected to be chosen.
+ * @returns 0 for success, error code otherwise.
+ */
+int test_auto(int iosysid, int num_flavors, int *flavor, int my_rank,
+              PIO_Offset maplen, PIO_Offset *compdof, int expected)
+{
+    int rearranger = PIO_REARR_AUTO;
+    int dim_len[NDIM] = {DIM_LEN};
+    io_desc_t *iodesc;
+    int ioid;
+    int ret;
+
+    if ((ret = PIOc_InitDecomp(iosysid, PIO_INT, NDIM, dim_len, maplen, compdof,
+                               &ioid, &rearranger, NULL, NULL)))
+        ERR(ret);
+
+    if (!(iodesc = pio_get_iodesc_from_id(ioid)))
+        ERR(ERR_WRONG);
+    if (iodesc->rearranger != expected || !iodesc->rearr_auto)
+        ERR(ERR_WRONG);
+
+    for (int f = 0; f < num_flavors; f++)
+        if ((ret = test_write_read(iosysid, ioid, flavor[f], my_rank, maplen, compdof)))
+            return ret;
+
+    if ((ret = PIOc_freedecomp(iosysid, ioid)))
+        ERR(ret);
+
+    return PIO_NOERR;
+}
+
+/* Run tests for choosing the rearranger. */
+int main(int argc, char **argv)
+{
+    int my_rank;
+    int ntasks;
+    int num_flavors;
+    int flavor[NUM_FLAVORS];
+    MPI_Comm test_comm; /* A communicator for this test. */
+    int ret;         /* Return code. */
+
+    /* Initialize test. */
+    if ((ret = pio_test_init2(argc, argv, &my_rank, &ntasks, MIN_NTASKS,
+                              MIN_NTASKS, 3, &test_comm)))
+        ERR(ERR_INIT);
+
+    if ((ret = PIOc_set_iosystem_error_handling(PIO_DEFAULT, PIO_RETURN_ERROR, NULL)))
+        return ret;
+
+    /* Figure out iotypes. */
+    if ((ret = get_iotypes(&num_flavors, flavor)))
+        ERR(ret);
+
+    /* Only do something on max_ntasks tasks. */
+    if (my_rank < TARGET_NTASKS)
+    {
+        int iosysid;  /* The ID for the parallel I/O system. */
+        PIO_Offset elements_per_pe = DIM_LEN / TARGET_NTASKS;
+        PIO_Offset compdof[DIM_LEN / TARGET_NTASKS];
+
+        /* The IO system default rearranger is also accepted. */
+        if ((ret = PIOc_Init_Intracomm(test_comm, 2, 2, 0, PIO_REARR_AUTO, &iosysid)))
+            return ret;
+
+        /* A contiguous block on each task is written with the box
+         * rearranger, each compute task sends to one IO task. */
+        for (int i = 0; i < elements_per_pe; i++)
+            compdof[i] = my_rank * elements_per_pe + i + 1;
+        if ((ret = test_auto(iosysid, num_flavors, flavor, my_rank, elements_per_pe,
+                             compdof, PIO_REARR_BOX)))
+            return ret;
+
+        /* A few scattered elements on each task would leave the
+         * boxes of the IO tasks mostly empty, so the subset
+         * rearranger is chosen. */
+        for (int i = 0; i < SPARSE_LEN; i++)
+            compdof[i] = my_rank * elements_per_pe + i * (elements_per_pe / SPARSE_LEN) + 1;
+        if ((ret = test_auto(iosysid, num_flavors, flavor, my_rank, SPARSE_LEN,
+                             compdof, PIO_REARR_SUBSET)))
+            return ret;
+
+        if ((ret = PIOc_finalize(iosysid)))
+            return ret;
+    } /* endif my_rank < TARGET_NTASKS */
+
+    /* Finalize the MPI library. */
+    printf("%d %s Finalizing...\n", my_rank, TEST_NAME);
+    if ((ret = pio_test_finalize(&test_comm)))
+        return ret;
+
+    printf("%d %s SUCCESS!!\n", my_rank, TEST_NAME);
+    return 0;
+}
@@ -0,0 +1,148 @@
+/*
+ * Tests for tuning the rearranger options of decompositions
+ * (PIOc_set_rearr_autotune).
+ */
+#include <pio.h>
+#include <pio_tests.h>
+
+/* The number of tasks this test should run on. */
+#define TARGET_NTASKS 4
+
+/* The minimum number of tasks this test should run on. */
+#define MIN_NTASKS 4
+
+/* The name of this test. */
+#define TEST_NAME "test_rearr_autotune"
+
+/* The number of dimensions in the example data. */
+#define NDIM 1
+
+/* The length of our sample data along the dimension. */
+#define DIM_LEN 16
+
+/* The name of the variable in the netCDF output files. */
+#define VAR_NAME "foo"
+
+/* The dimension name. */
+#define DIM_NAME "x"
+
+/**
+ * Write and read back a variable with a decomposition whose
+ * rearranger options were tuned.
+ *
+ * @param iosysid the IO system ID.
+ * @param ioid the ID of the decomposition.
+ * @param iotype the iotype to test.
+ * @param my_rank rank of this task.
+ * @param elements_per_pe number of elements on this task.
+ * @returns 0 for success, error code otherwise.
+ */
+int test_write_read(int iosysid, int ioid, int iotype, int my_rank,
+                    PIO_Offset elements_per_pe)
+{
+    char filename[PIO_MAX_NAME + 1];
+    int ncid, varid, dimid;
+    int test_data[elements_per_pe];
+    int test_data_in[elements_per_pe];
+    int ret;
+
+    sprintf(filename, "%s_%d.nc", TEST_NAME, iotype);
+    if ((ret = PIOc_createfile(iosysid, &ncid, &iotype, filename, PIO_CLOBBER)))
+        ERR(ret);
+    if ((ret = PIOc_def_dim(ncid, DIM_NAME, DIM_LEN, &dimid)))
+        ERR(ret);
+    if ((ret = PIOc_def_var(ncid, VAR_NAME, PIO_INT, NDIM, &dimid, &varid)))
+        ERR(ret);
+    if ((ret = PIOc_enddef(ncid)))
+        ERR(ret);
+
+    for (int i = 0; i < elements_per_pe; i++)
+        test_data[i] = my_rank * elements_per_pe + i;
+    if ((ret = PIOc_write_darray(ncid, varid, ioid, elements_per_pe, test_data, NULL)))
+        ERR(ret);
+    if ((ret = PIOc_sync(ncid)))
+        ERR(ret);
+
+    if ((ret = PIOc_read_darray(ncid, varid, ioid, elements_per_pe, test_data_in)))
+        ERR(ret);
+    for (int i = 0; i < elements_per_pe; i++)
+        if (test_data_in[i] != test_data[i])
+            ERR(ERR_WRONG);
+
+    if ((ret = PIOc_closefile(ncid)))
+        ERR(ret);
+
+    return PIO_NOERR;
+}
+
+/* Run tests for tuning the rearranger options. */
+int main(int argc, char **argv)
+{
+#define NUM_REARRANGERS_TO_TEST 2
+    int rearranger[NUM_REARRANGERS_TO_TEST] = {PIO_REARR_BOX, PIO_REARR_SUBSET};
+    int my_rank;
+    int ntasks;
+    int num_flavors;
+    int flavor[NUM_FLAVORS];
+    MPI_Comm test_comm; /* A communicator for this test. */
+    int ret;         /* Return code. */
+
+    /* Initialize test. */
+    if ((ret = pio_test_init2(argc, argv, &my_rank, &ntasks, MIN_NTASKS,
+                              MIN_NTASKS, 3, &test_comm)))
+        ERR(ERR_INIT);
+
+    if ((ret = PIOc_set_iosystem_error_handling(PIO_DEFAULT, PIO_RETURN_ERROR, NULL)))
+        return ret;
+
+    /* Figure out iotypes. */
+    if ((ret = get_iotypes(&num_flavors, flavor)))
+        ERR(ret);
+
+    /* Only do something on max_ntasks tasks. */
+    if (my_rank < TARGET_NTASKS)
+    {
+        int iosysid;  /* The ID for the parallel I/O system. */
+        int ioid;     /* Decomposition ID. */
+        int dim_len[NDIM] = {DIM_LEN};
+        PIO_Offset elements_per_pe = DIM_LEN / TARGET_NTASKS;
+        PIO_Offset compdof[DIM_LEN / TARGET_NTASKS];
+
+        /* Use a map with holes in the data of each IO task. */
+        for (int i = 0; i < elements_per_pe; i++)
+            compdof[i] = i * TARGET_NTASKS + my_rank + 1;
+
+        for (int r = 0; r < NUM_REARRANGERS_TO_TEST; r++)
+        {
+            if ((ret = PIOc_Init_Intracomm(test_comm, 2, 2, 0, rearranger[r], &iosysid)))
+                return ret;
+
+            if (PIOc_set_rearr_autotune(iosysid + 42, 1) != PIO_EBADID)
+                ERR(ERR_WRONG);
+            if ((ret = PIOc_set_rearr_autotune(iosysid, 1)))
+                ERR(ret);
+
+            if ((ret = PIOc_InitDecomp(iosysid, PIO_INT, NDIM, dim_len, elements_per_pe,
+                                       compdof, &ioid, NULL, NULL, NULL)))
+                ERR(ret);
+
+            for (int f = 0; f < num_flavors; f++)
+                if ((ret = test_write_read(iosysid, ioid, flavor[f], my_rank, elements_per_pe)))
+                    return ret;
+
+            if ((ret = PIOc_freedecomp(iosysid, ioid)))
+                ERR(ret);
+
+            if ((ret = PIOc_finalize(iosysid)))
+                return ret;
+        } /* next rearranger */
+    } /* endif my_rank < TARGET_NTASKS */
+
+    /* Finalize the MPI library. */
+    printf("%d %s Finalizing...\n", my_rank, TEST_NAME);
+    if ((ret = pio_test_finalize(&test_comm)))
+        return ret;
+
+    printf("%d %s SUCCESS!!\n", my_rank, TEST_NAME);
+    return 0;
+}
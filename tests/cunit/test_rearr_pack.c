@@ -0,0 +1,207 @@
+/*
+ * Tests for rearranging data with packed messages
+ * (PIOc_set_rearr_pack), with one or more threads on the IO tasks
+ * (PIOc_set_io_nthreads).
+ */
+#include <pio.h>
+#include <pio_tests.h>
+
+/* The number of tasks this test should run on. */
+#define TARGET_NTASKS 4
+
+/* The minimum number of tasks this test should run on. */
+#define MIN_NTASKS 4
+
+/* The name of this test. */
+#define TEST_NAME "test_rearr_pack"
+
+/* The number of dimensions in the example data. */
+#define NDIM 1
+
+/* The length of our sample data along the dimension. */
+#define DIM_LEN 16
+
+/* The number of variables written with each decomposition. */
+#define NVARS 2
+
+/* The numbers of IO threads to test. */
+#define NUM_NTHREADS_TO_TEST 2
+
+/* The dimension name. */
+#define DIM_NAME "x"
+
+/**
+ * Write and read back NVARS int and NVARS double variables with
+ * decompositions rearranged with packed messages. The variables of
+ * each type are flushed together, so the messages hold the data of
+ * several variables.
+ *
+ * @param iosysid the IO system ID.
+ * @param ioid_int the ID of the decomposition of the int variables.
+ * @param ioid_double the ID of the decomposition of the double
+ * variables.
+ * @param iotype the iotype to test.
+ * @param my_rank rank of this task.
+ * @param elements_per_pe number of elements on this task.
+ * @returns 0 for success, error code otherwise.
+ */
+int test_write_read(int iosysid, int ioid_int, int ioid_double, int iotype, int my_rank,
+                    PIO_Offset elements_per_pe)
+{
+    char filename[PIO_MAX_NAME + 1];
+    char var_name[PIO_MAX_NAME + 1];
+    int ncid, dimid;
+    int varid_int[NVARS], varid_double[NVARS];
+    int int_data[elements_per_pe];
+    int int_data_in[elements_per_pe];
+    double double_data[elements_per_pe];
+    double double_data_in[elements_per_pe];
+    int ret;
+
+    sprintf(filename, "%s_%d.nc", TEST_NAME, iotype);
+    if ((ret = PIOc_createfile(iosysid, &ncid, &iotype, filename, PIO_CLOBBER)))
+        ERR(ret);
+    if ((ret = PIOc_def_dim(ncid, DIM_NAME, DIM_LEN, &dimid)))
+        ERR(ret);
+    for (int v = 0; v < NVARS; v++)
+    {
+        sprintf(var_name, "int_%d", v);
+        if ((ret = PIOc_def_var(ncid, var_name, PIO_INT, NDIM, &dimid, &varid_int[v])))
+            ERR(ret);
+        sprintf(var_name, "double_%d", v);
+        if ((ret = PIOc_def_var(ncid, var_name, PIO_DOUBLE, NDIM, &dimid, &varid_double[v])))
+            ERR(ret);
+    }
+    if ((ret = PIOc_enddef(ncid)))
+        ERR(ret);
+
+    for (int v = 0; v < NVARS; v++)
+    {
+        for (int i = 0; i < elements_per_pe; i++)
+        {
+            int_data[i] = v * DIM_LEN + my_rank * elements_per_pe + i;
+            double_data[i] = int_data[i] + 0.5;
+        }
+        if ((ret = PIOc_write_darray(ncid, varid_int[v], ioid_int, elements_per_pe,
+                                     int_data, NULL)))
+            ERR(ret);
+        if ((ret = PIOc_write_darray(ncid, varid_double[v], ioid_double, elements_per_pe,
+                                     double_data, NULL)))
+            ERR(ret);
+    }
+    if ((ret = PIOc_sync(ncid)))
+        ERR(ret);
+
+    for (int v = 0; v < NVARS; v++)
+    {
+        if ((ret = PIOc_read_darray(ncid, varid_int[v], ioid_int, elements_per_pe,
+                                    int_data_in)))
+            ERR(ret);
+        if ((ret = PIOc_read_darray(ncid, varid_double[v], ioid_double, elements_per_pe,
+                                    double_data_in)))
+            ERR(ret);
+        for (int i = 0; i < elements_per_pe; i++)
+        {
+            if (int_data_in[i] != v * DIM_LEN + my_rank * elements_per_pe + i)
+                ERR(ERR_WRONG);
+            if (double_data_in[i] != int_data_in[i] + 0.5)
+                ERR(ERR_WRONG);
+        }
+    }
+
+    if ((ret = PIOc_closefile(ncid)))
+        ERR(ret);
+
+    return PIO_NOERR;
+}
+
+/* Run tests for rearranging data with packed messages. */
+int main(int argc, char **argv)
+{
+#define NUM_REARRANGERS_TO_TEST 2
+    int rearranger[NUM_REARRANGERS_TO_TEST] = {PIO_REARR_BOX, PIO_REARR_SUBSET};
+    int nthreads[NUM_NTHREADS_TO_TEST] = {1, 4};
+    int my_rank;
+    int ntasks;
+    int num_flavors;
+    int flavor[NUM_FLAVORS];
+    MPI_Comm test_comm; /* A communicator for this test. */
+    int ret;         /* Return code. */
+
+    /* Initialize test. */
+    if ((ret = pio_test_init2(argc, argv, &my_rank, &ntasks, MIN_NTASKS,
+                              MIN_NTASKS, 3, &test_comm)))
+        ERR(ERR_INIT);
+
+    if ((ret = PIOc_set_iosystem_error_handling(PIO_DEFAULT, PIO_RETURN_ERROR, NULL)))
+        return ret;
+
+    /* Figure out iotypes. */
+    if ((ret = get_iotypes(&num_flavors, flavor)))
+        ERR(ret);
+
+    /* Only do something on max_ntasks tasks. */
+    if (my_rank < TARGET_NTASKS)
+    {
+        int iosysid;  /* The ID for the parallel I/O system. */
+        int ioid_int, ioid_double; /* Decomposition IDs. */
+        int dim_len[NDIM] = {DIM_LEN};
+        PIO_Offset elements_per_pe = DIM_LEN / TARGET_NTASKS;
+        PIO_Offset compdof[DIM_LEN / TARGET_NTASKS];
+
+        /* Use a map with holes in the data of each IO task, and with
+         * runs of two consecutive elements. */
+        for (int i = 0; i < elements_per_pe; i++)
+            compdof[i] = (i / 2) * 2 * TARGET_NTASKS + my_rank * 2 + i % 2 + 1;
+
+        for (int r = 0; r < NUM_REARRANGERS_TO_TEST; r++)
+        {
+            if ((ret = PIOc_Init_Intracomm(test_comm, 2, 2, 0, rearranger[r], &iosysid)))
+                return ret;
+
+            if (PIOc_set_rearr_pack(iosysid + 42, 1) != PIO_EBADID)
+                ERR(ERR_WRONG);
+            if ((ret = PIOc_set_rearr_pack(iosysid, 1)))
+                ERR(ret);
+
+            if ((ret = PIOc_InitDecomp(iosysid, PIO_INT, NDIM, dim_len, elements_per_pe,
+                                       compdof, &ioid_int, NULL, NULL, NULL)))
+                ERR(ret);
+            if ((ret = PIOc_InitDecomp(iosysid, PIO_DOUBLE, NDIM, dim_len, elements_per_pe,
+                                       compdof, &ioid_double, NULL, NULL, NULL)))
+                ERR(ret);
+
+            if (PIOc_set_io_nthreads(iosysid + 42, 1) != PIO_EBADID)
+                ERR(ERR_WRONG);
+            if (PIOc_set_io_nthreads(iosysid, -1) != PIO_EINVAL)
+                ERR(ERR_WRONG);
+
+            for (int t = 0; t < NUM_NTHREADS_TO_TEST; t++)
+            {
+                if ((ret = PIOc_set_io_nthreads(iosysid, nthreads[t])))
+                    ERR(ret);
+
+                for (int f = 0; f < num_flavors; f++)
+                    if ((ret = test_write_read(iosysid, ioid_int, ioid_double, flavor[f], my_rank,
+                                               elements_per_pe)))
+                        return ret;
+            }
+
+            if ((ret = PIOc_freedecomp(iosysid, ioid_int)))
+                ERR(ret);
+            if ((ret = PIOc_freedecomp(iosysid, ioid_double)))
+                ERR(ret);
+
+            if ((ret = PIOc_finalize(iosysid)))
+                return ret;
+        } /* next rearranger */
+    } /* endif my_rank < TARGET_NTASKS */
+
+    /* Finalize the MPI library. */
+    printf("%d %s Finalizing...\n", my_rank, TEST_NAME);
+    if ((ret = pio_test_finalize(&test_comm)))
+        return ret;
+
+    printf("%d %s SUCCESS!!\n", my_rank, TEST_NAME);
+    return 0;
+}
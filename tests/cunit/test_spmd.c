@@ -371,7 +371,7 @@ int test_CalcStartandCount()
     {
         for (iorank = 0; iorank < num_io_procs; iorank++)
         {
-            if ((ret = CalcStartandCount(PIO_DOUBLE, ndims, gdims, num_io_procs, iorank,
+            if ((ret = CalcStartandCount(PIO_DOUBLE, ndims, gdims, num_io_procs, iorank, 0,
                                          start, kount, &numaiotasks)))
                 return ret;
             if (iorank < numaiotasks)
@@ -404,6 +404,89 @@ int test_CalcStartandCount()
     return 0;
 }
 
+/* Test CalcStartandCount() aligning the data of the IO tasks to
+ * stripes. Arrays with too few stripe aligned slabs for the IO tasks
+ * are split as without a stripe size. */
+int test_CalcStartandCount_striped()
+{
+#define NUM_STRIPE_TESTS 4
+    int ndims[NUM_STRIPE_TESTS] = {1, 2, 2, 2};
+    int gdims[NUM_STRIPE_TESTS][2] = {{1000000, 0}, {1000, 8192}, {100, 3000}, {31, 777602}};
+    int striped[NUM_STRIPE_TESTS] = {1, 1, 0, 0};
+    PIO_Offset stripe_size = 65536;
+    int num_io_procs = 24;
+    int ret;
+
+    for (int t = 0; t < NUM_STRIPE_TESTS; t++)
+    {
+        PIO_Offset start[2], kount[2];
+        PIO_Offset rowbytes = sizeof(double);
+        PIO_Offset next_start = 0;
+        PIO_Offset nelems = 0;
+        PIO_Offset gsize = 1;
+        int numaiotasks = 0;
+
+        for (int i = 1; i < ndims[t]; i++)
+            rowbytes *= gdims[t][i];
+        for (int i = 0; i < ndims[t]; i++)
+            gsize *= gdims[t][i];
+
+        for (int iorank = 0; iorank < num_io_procs; iorank++)
+        {
+            PIO_Offset boxsize = 1;
+
+            if ((ret = CalcStartandCount(PIO_DOUBLE, ndims[t], gdims[t], num_io_procs, iorank,
+                                         stripe_size, start, kount, &numaiotasks)))
+                return ret;
+
+            /* The data is spread over the IO tasks, not written by a
+             * single one. */
+            if (numaiotasks < 2 || numaiotasks > num_io_procs)
+                return ERR_WRONG;
+
+            if (iorank >= numaiotasks)
+            {
+                if (kount[0])
+                    return ERR_WRONG;
+                continue;
+            }
+
+            for (int i = 0; i < ndims[t]; i++)
+                boxsize *= kount[i];
+            if (boxsize <= 0)
+                return ERR_WRONG;
+            nelems += boxsize;
+
+            if (!striped[t])
+                continue;
+
+            /* The boxes are contiguous slabs of the slowest varying
+             * dimension. */
+            if (start[0] != next_start)
+                return ERR_WRONG;
+            for (int i = 1; i < ndims[t]; i++)
+                if (start[i] != 0 || kount[i] != gdims[t][i])
+                    return ERR_WRONG;
+            next_start += kount[0];
+
+            /* Each box starts at a stripe boundary, and all but the
+             * last box are whole stripes. */
+            if ((start[0] * rowbytes) % stripe_size)
+                return ERR_WRONG;
+            if (iorank < numaiotasks - 1 && (kount[0] * rowbytes) % stripe_size)
+                return ERR_WRONG;
+        }
+
+        /* The boxes cover the array. */
+        if (nelems != gsize)
+            return ERR_WRONG;
+        if (striped[t] && next_start != gdims[t][0])
+            return ERR_WRONG;
+    }
+
+    return 0;
+}
+
 /* Test the GCDblocksize() function (ignoring gaps). */
 int run_GCDblocksize_tests(MPI_Comm test_comm)
 {
@@ -690,6 +773,8 @@ int main(int argc, char **argv)
         printf("%d running CalcStartandCount test code\n", my_rank);
         if ((ret = test_CalcStartandCount()))
             return ret;
+        if ((ret = test_CalcStartandCount_striped()))
+            return ret;
 
         printf("%d running list tests\n", my_rank);
         if ((ret = test_lists()))
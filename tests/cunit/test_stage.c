@@ -0,0 +1,242 @@
+/*
+ * Tests for staging the data written to files in node-local storage
+ * (PIOc_set_staging_dir()).
+ */
+#include <pio.h>
+#include <pio_tests.h>
+
+/* The number of tasks this test should run on. */
+#define TARGET_NTASKS 4
+
+/* The minimum number of tasks this test should run on. */
+#define MIN_NTASKS 4
+
+/* The name of this test. */
+#define TEST_NAME "test_stage"
+
+/* The staging directory, the current directory for this test. */
+#define STAGE_DIR "."
+
+/* The number of dimensions in the example data. */
+#define NDIM 1
+
+/* The length of our sample data along the dimension. */
+#define DIM_LEN 16
+
+/* The number of timesteps of data to write. */
+#define NUM_TIMESTEPS 2
+
+/* The name of the variable in the netCDF output files. */
+#define VAR_NAME "foo"
+
+/* The dimension names. */
+#define DIM_NAME "x"
+#define DIM_NAME_UNLIM "time"
+
+/**
+ * Create a staged file with one record variable and write
+ * NUM_TIMESTEPS records to it.
+ *
+ * @param iosysid the IO system ID.
+ * @param ioid the ID of the decomposition.
+ * @param filename the name of the file.
+ * @param my_rank rank of this task.
+ * @param elements_per_pe number of elements on this task.
+ * @param ncidp pointer that gets the ncid of the file.
+ * @param varidp pointer that gets the ID of the variable.
+ * @returns 0 for success, error code otherwise.
+ */
+int create_and_write(int iosysid, int ioid, const char *filename, int my_rank,
+                     PIO_Offset elements_per_pe, int *ncidp, int *varidp)
+{
+    int iotype = PIO_IOTYPE_PNETCDF;
+    int dimids[NDIM + 1];
+    int test_data[elements_per_pe];
+    int ret;
+
+    if ((ret = PIOc_createfile(iosysid, ncidp, &iotype, filename, PIO_CLOBBER)))
+        ERR(ret);
+    if ((ret = PIOc_def_dim(*ncidp, DIM_NAME_UNLIM, PIO_UNLIMITED, &dimids[0])))
+        ERR(ret);
+    if ((ret = PIOc_def_dim(*ncidp, DIM_NAME, DIM_LEN, &dimids[1])))
+        ERR(ret);
+    if ((ret = PIOc_def_var(*ncidp, VAR_NAME, PIO_INT, NDIM + 1, dimids, varidp)))
+        ERR(ret);
+    if ((ret = PIOc_enddef(*ncidp)))
+        ERR(ret);
+
+    for (int t = 0; t < NUM_TIMESTEPS; t++)
+    {
+        for (int i = 0; i < elements_per_pe; i++)
+            test_data[i] = t * DIM_LEN + my_rank * elements_per_pe + i;
+
+        if ((ret = PIOc_setframe(*ncidp, *varidp, t)))
+            ERR(ret);
+        if ((ret = PIOc_write_darray(*ncidp, *varidp, ioid, elements_per_pe, test_data, NULL)))
+            ERR(ret);
+    }
+
+    return PIO_NOERR;
+}
+
+/**
+ * Read the records of the variable and check the data.
+ *
+ * @param ncid the ncid of the file.
+ * @param varid the ID of the variable.
+ * @param ioid the ID of the decomposition.
+ * @param my_rank rank of this task.
+ * @param elements_per_pe number of elements on this task.
+ * @returns 0 for success, error code otherwise.
+ */
+int check_data(int ncid, int varid, int ioid, int my_rank, PIO_Offset elements_per_pe)
+{
+    int test_data_in[elements_per_pe];
+    PIO_Offset nrecs;
+    int ret;
+
+    if ((ret = PIOc_inq_dimlen(ncid, 0, &nrecs)))
+        ERR(ret);
+    if (nrecs != NUM_TIMESTEPS)
+        ERR(ERR_WRONG);
+
+    for (int t = 0; t < NUM_TIMESTEPS; t++)
+    {
+        if ((ret = PIOc_setframe(ncid, varid, t)))
+            ERR(ret);
+        if ((ret = PIOc_read_darray(ncid, varid, ioid, elements_per_pe, test_data_in)))
+            ERR(ret);
+        for (int i = 0; i < elements_per_pe; i++)
+            if (test_data_in[i] != t * DIM_LEN + my_rank * elements_per_pe + i)
+                ERR(ERR_WRONG);
+    }
+
+    return PIO_NOERR;
+}
+
+/**
+ * Test staging files.
+ *
+ * @param iosysid the IO system ID.
+ * @param ioid the ID of the decomposition.
+ * @param my_rank rank of this task.
+ * @param elements_per_pe number of elements on this task.
+ * @returns 0 for success, error code otherwise.
+ */
+int test_stage(int iosysid, int ioid, int my_rank, PIO_Offset elements_per_pe)
+{
+    char filename[PIO_MAX_NAME + 1];
+    int iotype = PIO_IOTYPE_PNETCDF;
+    int ncid, varid;
+    int ret;
+
+    if ((ret = PIOc_set_staging_dir(iosysid, STAGE_DIR)))
+        ERR(ret);
+
+    /* The staged data is drained before reading from the file. */
+    sprintf(filename, "%s_read.nc", TEST_NAME);
+    if ((ret = create_and_write(iosysid, ioid, filename, my_rank, elements_per_pe, &ncid, &varid)))
+        return ret;
+    if ((ret = PIOc_sync(ncid)))
+        ERR(ret);
+    if ((ret = check_data(ncid, varid, ioid, my_rank, elements_per_pe)))
+        return ret;
+    if ((ret = PIOc_closefile(ncid)))
+        ERR(ret);
+
+    /* Wait for the data staged for closed files. */
+    sprintf(filename, "%s_wait.nc", TEST_NAME);
+    if ((ret = create_and_write(iosysid, ioid, filename, my_rank, elements_per_pe, &ncid, &varid)))
+        return ret;
+    if ((ret = PIOc_closefile(ncid)))
+        ERR(ret);
+    if ((ret = PIOc_wait_staged(iosysid)))
+        ERR(ret);
+
+    /* Staging is disabled, this file is written directly. */
+    if ((ret = PIOc_set_staging_dir(iosysid, NULL)))
+        ERR(ret);
+    if ((ret = PIOc_openfile(iosysid, &ncid, &iotype, filename, PIO_NOWRITE)))
+        ERR(ret);
+    if ((ret = check_data(ncid, varid, ioid, my_rank, elements_per_pe)))
+        return ret;
+    if ((ret = PIOc_closefile(ncid)))
+        ERR(ret);
+
+    /* Opening a closed file drains the data staged for it. */
+    if ((ret = PIOc_set_staging_dir(iosysid, STAGE_DIR)))
+        ERR(ret);
+    sprintf(filename, "%s_open.nc", TEST_NAME);
+    if ((ret = create_and_write(iosysid, ioid, filename, my_rank, elements_per_pe, &ncid, &varid)))
+        return ret;
+    if ((ret = PIOc_closefile(ncid)))
+        ERR(ret);
+    if ((ret = PIOc_openfile(iosysid, &ncid, &iotype, filename, PIO_NOWRITE)))
+        ERR(ret);
+    if ((ret = check_data(ncid, varid, ioid, my_rank, elements_per_pe)))
+        return ret;
+    if ((ret = PIOc_closefile(ncid)))
+        ERR(ret);
+
+    return PIO_NOERR;
+}
+
+/* Run tests for staging files. */
+int main(int argc, char **argv)
+{
+#define NUM_REARRANGERS_TO_TEST 2
+    int rearranger[NUM_REARRANGERS_TO_TEST] = {PIO_REARR_BOX, PIO_REARR_SUBSET};
+    int my_rank;
+    int ntasks;
+    MPI_Comm test_comm; /* A communicator for this test. */
+    int ret;         /* Return code. */
+
+    /* Initialize test. */
+    if ((ret = pio_test_init2(argc, argv, &my_rank, &ntasks, MIN_NTASKS,
+                              MIN_NTASKS, 3, &test_comm)))
+        ERR(ERR_INIT);
+
+    if ((ret = PIOc_set_iosystem_error_handling(PIO_DEFAULT, PIO_RETURN_ERROR, NULL)))
+        return ret;
+
+    /* Only do something on max_ntasks tasks. Only PnetCDF files are
+     * staged. */
+    if (my_rank < TARGET_NTASKS && PIOc_iotype_available(PIO_IOTYPE_PNETCDF))
+    {
+        int iosysid;  /* The ID for the parallel I/O system. */
+        int ioid;     /* Decomposition ID. */
+        int dim_len[NDIM] = {DIM_LEN};
+        PIO_Offset elements_per_pe = DIM_LEN / TARGET_NTASKS;
+        PIO_Offset compdof[DIM_LEN / TARGET_NTASKS];
+
+        for (int i = 0; i < elements_per_pe; i++)
+            compdof[i] = my_rank * elements_per_pe + i + 1;
+
+        for (int r = 0; r < NUM_REARRANGERS_TO_TEST; r++)
+        {
+            if ((ret = PIOc_Init_Intracomm(test_comm, 2, 2, 0, rearranger[r], &iosysid)))
+                return ret;
+
+            if ((ret = PIOc_InitDecomp(iosysid, PIO_INT, NDIM, dim_len, elements_per_pe,
+                                       compdof, &ioid, NULL, NULL, NULL)))
+                ERR(ret);
+
+            if ((ret = test_stage(iosysid, ioid, my_rank, elements_per_pe)))
+                return ret;
+
+            if ((ret = PIOc_freedecomp(iosysid, ioid)))
+                ERR(ret);
+
+            if ((ret = PIOc_finalize(iosysid)))
+                return ret;
+        } /* next rearranger */
+    } /* endif my_rank < TARGET_NTASKS */
+
+    /* Finalize the MPI library. */
+    printf("%d %s Finalizing...\n", my_rank, TEST_NAME);
+    if ((ret = pio_test_finalize(&test_comm)))
+        return ret;
+
+    printf("%d %s SUCCESS!!\n", my_rank, TEST_NAME);
+    return 0;
+}
@@ -0,0 +1,272 @@
+/*
+ * Tests for subfiling of files written with the PnetCDF iotype. The
+ * subfiled dataset is read back transparently and merged into a
+ * single file with PIOc_merge_subfiles().
+ */
+#include <pio.h>
+#include <pio_tests.h>
+
+/* The number of tasks this test should run on. */
+#define TARGET_NTASKS 4
+
+/* The minimum number of tasks this test should run on. */
+#define MIN_NTASKS 4
+
+/* The name of this test. */
+#define TEST_NAME "test_subfile"
+
+/* The number of subfiles to write. */
+#define NUM_SUBFILES 2
+
+/* The number of dimensions in the example data. */
+#define NDIM 1
+
+/* The length of our sample data along the dimension. */
+#define DIM_LEN 16
+
+/* The number of timesteps of data to write. */
+#define NUM_TIMESTEPS 3
+
+/* The name of the variable in the netCDF output files. */
+#define VAR_NAME "foo"
+
+/* The dimension names. The fixed dimension has a coordinate
+ * variable. */
+#define DIM_NAME "x"
+#define DIM_NAME_UNLIM "time"
+
+/* The attribute of the variable. */
+#define ATT_NAME "units"
+#define ATT_VAL "m/s"
+
+/**
+ * Create a file with a coordinate variable and one record variable,
+ * and write NUM_TIMESTEPS records to it.
+ *
+ * @param iosysid the IO system ID.
+ * @param ioid the ID of the decomposition.
+ * @param filename the name of the file.
+ * @param my_rank rank of this task.
+ * @param elements_per_pe number of elements on this task.
+ * @returns 0 for success, error code otherwise.
+ */
+int create_and_write(int iosysid, int ioid, const char *filename, int my_rank,
+                     PIO_Offset elements_per_pe)
+{
+    int iotype = PIO_IOTYPE_PNETCDF;
+    int ncid, varid, coord_varid;
+    int dimids[NDIM + 1];
+    float coord_data[DIM_LEN];
+    int test_data[elements_per_pe];
+    int ret;
+
+    if ((ret = PIOc_createfile(iosysid, &ncid, &iotype, filename, PIO_CLOBBER)))
+        ERR(ret);
+    if ((ret = PIOc_def_dim(ncid, DIM_NAME_UNLIM, PIO_UNLIMITED, &dimids[0])))
+        ERR(ret);
+    if ((ret = PIOc_def_dim(ncid, DIM_NAME, DIM_LEN, &dimids[1])))
+        ERR(ret);
+    if ((ret = PIOc_def_var(ncid, DIM_NAME, PIO_FLOAT, NDIM, &dimids[1], &coord_varid)))
+        ERR(ret);
+    if ((ret = PIOc_def_var(ncid, VAR_NAME, PIO_INT, NDIM + 1, dimids, &varid)))
+        ERR(ret);
+    if ((ret = PIOc_put_att_text(ncid, varid, ATT_NAME, strlen(ATT_VAL), ATT_VAL)))
+        ERR(ret);
+    if ((ret = PIOc_enddef(ncid)))
+        ERR(ret);
+
+    for (int i = 0; i < DIM_LEN; i++)
+        coord_data[i] = i * 0.5;
+    if ((ret = PIOc_put_var_float(ncid, coord_varid, coord_data)))
+        ERR(ret);
+
+    for (int t = 0; t < NUM_TIMESTEPS; t++)
+    {
+        for (int i = 0; i < elements_per_pe; i++)
+            test_data[i] = t * DIM_LEN + my_rank * elements_per_pe + i;
+
+        if ((ret = PIOc_setframe(ncid, varid, t)))
+            ERR(ret);
+        if ((ret = PIOc_write_darray(ncid, varid, ioid, elements_per_pe, test_data, NULL)))
+            ERR(ret);
+    }
+
+    if ((ret = PIOc_closefile(ncid)))
+        ERR(ret);
+
+    return PIO_NOERR;
+}
+
+/**
+ * Open the file and check the metadata and the data.
+ *
+ * @param iosysid the IO system ID.
+ * @param ioid the ID of the decomposition.
+ * @param filename the name of the file.
+ * @param my_rank rank of this task.
+ * @param elements_per_pe number of elements on this task.
+ * @returns 0 for success, error code otherwise.
+ */
+int check_file(int iosysid, int ioid, const char *filename, int my_rank,
+               PIO_Offset elements_per_pe)
+{
+    int iotype = PIO_IOTYPE_PNETCDF;
+    int ncid, varid, coord_varid;
+    PIO_Offset len;
+    char att_val[PIO_MAX_NAME + 1] = "";
+    float coord_data[DIM_LEN];
+    int test_data_in[elements_per_pe];
+    int ret;
+
+    if ((ret = PIOc_openfile(iosysid, &ncid, &iotype, filename, PIO_NOWRITE)))
+        ERR(ret);
+
+    if ((ret = PIOc_inq_dimlen(ncid, 0, &len)))
+        ERR(ret);
+    if (len != NUM_TIMESTEPS)
+        ERR(ERR_WRONG);
+
+    if ((ret = PIOc_inq_varid(ncid, DIM_NAME, &coord_varid)))
+        ERR(ret);
+    if ((ret = PIOc_get_var_float(ncid, coord_varid, coord_data)))
+        ERR(ret);
+    for (int i = 0; i < DIM_LEN; i++)
+        if (coord_data[i] != i * 0.5)
+            ERR(ERR_WRONG);
+
+    if ((ret = PIOc_inq_varid(ncid, VAR_NAME, &varid)))
+        ERR(ret);
+    if ((ret = PIOc_get_att_text(ncid, varid, ATT_NAME, att_val)))
+        ERR(ret);
+    if (strcmp(att_val, ATT_VAL))
+        ERR(ERR_WRONG);
+
+    for (int t = 0; t < NUM_TIMESTEPS; t++)
+    {
+        if ((ret = PIOc_setframe(ncid, varid, t)))
+            ERR(ret);
+        if ((ret = PIOc_read_darray(ncid, varid, ioid, elements_per_pe, test_data_in)))
+            ERR(ret);
+        for (int i = 0; i < elements_per_pe; i++)
+            if (test_data_in[i] != t * DIM_LEN + my_rank * elements_per_pe + i)
+                ERR(ERR_WRONG);
+    }
+
+    if ((ret = PIOc_closefile(ncid)))
+        ERR(ret);
+
+    return PIO_NOERR;
+}
+
+/**
+ * Test subfiling.
+ *
+ * @param iosysid the IO system ID.
+ * @param ioid the ID of the decomposition.
+ * @param my_rank rank of this task.
+ * @param elements_per_pe number of elements on this task.
+ * @returns 0 for success, error code otherwise.
+ */
+int test_subfile(int iosysid, int ioid, int my_rank, PIO_Offset elements_per_pe)
+{
+    char filename[PIO_MAX_NAME + 1];
+    char merged_filename[PIO_MAX_NAME + 1];
+    int iotype = PIO_IOTYPE_PNETCDF;
+    int ncid;
+    int ret;
+
+    /* Invalid numbers of subfiles are rejected. */
+    if (PIOc_set_subfiling(iosysid, -1) != PIO_EINVAL)
+        ERR(ERR_WRONG);
+    if (PIOc_set_subfiling(iosysid + 42, NUM_SUBFILES) != PIO_EBADID)
+        ERR(ERR_WRONG);
+
+    sprintf(filename, "%s.nc", TEST_NAME);
+    sprintf(merged_filename, "%s_merged.nc", TEST_NAME);
+
+    if ((ret = PIOc_set_subfiling(iosysid, NUM_SUBFILES)))
+        ERR(ret);
+    if ((ret = create_and_write(iosysid, ioid, filename, my_rank, elements_per_pe)))
+        return ret;
+
+    /* The subfiled dataset is read transparently. */
+    if ((ret = check_file(iosysid, ioid, filename, my_rank, elements_per_pe)))
+        return ret;
+
+    /* Subfiled datasets can not be opened for writing. */
+    if (PIOc_openfile(iosysid, &ncid, &iotype, filename, PIO_WRITE) != PIO_EPERM)
+        ERR(ERR_WRONG);
+
+    /* Merge the subfiles and check the merged file. */
+    if (PIOc_merge_subfiles(iosysid, NULL, merged_filename) != PIO_EINVAL)
+        ERR(ERR_WRONG);
+    if ((ret = PIOc_merge_subfiles(iosysid, filename, merged_filename)))
+        ERR(ret);
+    if ((ret = PIOc_set_subfiling(iosysid, 0)))
+        ERR(ret);
+    if ((ret = check_file(iosysid, ioid, merged_filename, my_rank, elements_per_pe)))
+        return ret;
+
+    return PIO_NOERR;
+}
+
+/* Run tests for subfiling. */
+int main(int argc, char **argv)
+{
+#define NUM_REARRANGERS_TO_TEST 2
+    int rearranger[NUM_REARRANGERS_TO_TEST] = {PIO_REARR_BOX, PIO_REARR_SUBSET};
+    int my_rank;
+    int ntasks;
+    MPI_Comm test_comm; /* A communicator for this test. */
+    int ret;         /* Return code. */
+
+    /* Initialize test. */
+    if ((ret = pio_test_init2(argc, argv, &my_rank, &ntasks, MIN_NTASKS,
+                              MIN_NTASKS, 3, &test_comm)))
+        ERR(ERR_INIT);
+
+    if ((ret = PIOc_set_iosystem_error_handling(PIO_DEFAULT, PIO_RETURN_ERROR, NULL)))
+        return ret;
+
+    /* Only do something on max_ntasks tasks. Subfiling requires
+     * PnetCDF. */
+    if (my_rank < TARGET_NTASKS && PIOc_iotype_available(PIO_IOTYPE_PNETCDF))
+    {
+        int iosysid;  /* The ID for the parallel I/O system. */
+        int ioid;     /* Decomposition ID. */
+        int dim_len[NDIM] = {DIM_LEN};
+        PIO_Offset elements_per_pe = DIM_LEN / TARGET_NTASKS;
+        PIO_Offset compdof[DIM_LEN / TARGET_NTASKS];
+
+        for (int i = 0; i < elements_per_pe; i++)
+            compdof[i] = my_rank * elements_per_pe + i + 1;
+
+        for (int r = 0; r < NUM_REARRANGERS_TO_TEST; r++)
+        {
+            if ((ret = PIOc_Init_Intracomm(test_comm, TARGET_NTASKS, 1, 0, rearranger[r],
+                                           &iosysid)))
+                return ret;
+
+            if ((ret = PIOc_InitDecomp(iosysid, PIO_INT, NDIM, dim_len, elements_per_pe,
+                                       compdof, &ioid, NULL, NULL, NULL)))
+                ERR(ret);
+
+            if ((ret = test_subfile(iosysid, ioid, my_rank, elements_per_pe)))
+                return ret;
+
+            if ((ret = PIOc_freedecomp(iosysid, ioid)))
+                ERR(ret);
+
+            if ((ret = PIOc_finalize(iosysid)))
+                return ret;
+        } /* next rearranger */
+    } /* endif my_rank < TARGET_NTASKS */
+
+    /* Finalize the MPI library. */
+    printf("%d %s Finalizing...\n", my_rank, TEST_NAME);
+    if ((ret = pio_test_finalize(&test_comm)))
+        return ret;
+
+    printf("%d %s SUCCESS!!\n", my_rank, TEST_NAME);
+    return 0;
+}
@@ -0,0 +1,468 @@
+/*
+ * Microbenchmark of the allocators of the buffers of PIO, the bget
+ * buffer pool and the size-class arena (pio_arena.c), on the
+ * allocation pattern of PIOc_write_darray():
+ *
+ * - The write multi buffer (wmb) of each file grows by one array
+ *   (bgetr/pio_arena_realloc) for each variable written.
+ * - On a flush an IO buffer holding all the cached arrays is
+ *   allocated and released, then the wmb is released.
+ *
+ * Several files, with different array lengths, cache data at the same
+ * time, a file is flushed when the data cached by all the files
+ * exceeds the buffer size limit (--buf-limit). For bget the benchmark also counts the early flushes that the
+ * library triggered when the largest free block of the pool was
+ * close to the cached data (maxfree <= 1.1 * cached bytes). The
+ * results (max across all processes) are written out by the root
+ * process in JSON or CSV format.
+ *
+ * Usage:
+ *   mpiexec -n 4 ./pioperf_alloc [OPTIONS]
+ *
+ * Run with --help for the list of options.
+ */
+#include <pio.h>
+#include <pio_internal.h>
+
+/* Max number of values in an option list */
+#define PERF_MAX_OPT_VALS 64
+
+/* Bytes in a megabyte */
+#define PERF_MB (1024.0 * 1024.0)
+
+/* Max number of files caching data at the same time */
+#define PERF_MAX_FILES 16
+
+/* Output formats */
+enum PERF_OUT_FMT
+{
+    PERF_OUT_JSON = 0,
+    PERF_OUT_CSV
+};
+
+/* Allocators */
+enum PERF_ALLOC
+{
+    PERF_ALLOC_BGET = 0,
+    PERF_ALLOC_ARENA
+};
+
+/* User options */
+typedef struct perf_opts
+{
+    int arraylens[PERF_MAX_OPT_VALS];
+    int narraylens;
+    int hugepages[PERF_MAX_OPT_VALS];
+    int nhugepages;
+    int nvars;
+    int nfiles;
+    int nflushes;
+    long long buf_limit;
+    int out_fmt;
+    char out_fname[PIO_MAX_NAME + 1];
+} perf_opts_t;
+
+/* Result (max across all processes) of one benchmark run */
+typedef struct perf_result
+{
+    double t_alloc;
+
+    /* Total bytes cached */
+    double nbytes;
+
+    /* Flushes forced by the maxfree test of bget */
+    long long early_flushes;
+
+    /* Number of allocations */
+    long long nget;
+} perf_result_t;
+
+static const char *alloc_names[] = {"bget", "arena"};
+
+/* Parse a comma separated list of integers into vals. Returns the
+ * number of values parsed, or -1 on error */
+static int perf_parse_list(const char *str, int *vals)
+{
+    char buf[PIO_MAX_NAME + 1];
+    int nvals = 0;
+
+    strncpy(buf, str, PIO_MAX_NAME);
+    buf[PIO_MAX_NAME] = '\0';
+    for (char *tok = strtok(buf, ","); tok; tok = strtok(NULL, ","))
+    {
+        char *endp = NULL;
+
+        if (nvals == PERF_MAX_OPT_VALS)
+            return -1;
+        vals[nvals++] = (int)strtol(tok, &endp, 10);
+        if (endp == tok)
+            return -1;
+    }
+
+    return nvals;
+}
+
+static void perf_usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [OPTIONS]\n", prog);
+    fprintf(stderr, "  --arraylens=LIST    : Bytes in an array of a variable, per process\n"
+            "                        (default: 4096,65536,1048576)\n");
+    fprintf(stderr, "  --hugepages=LIST    : Use huge pages in the arena, 0,1 (default: 0)\n");
+    fprintf(stderr, "  --nvars=N           : Number of variables written per flush (default: 16)\n");
+    fprintf(stderr, "  --nfiles=N          : Number of files caching data (default: 2)\n");
+    fprintf(stderr, "  --nflushes=N        : Number of flushes per file (default: 100)\n");
+    fprintf(stderr, "  --buf-limit=N       : Buffer size limit, and block increment of the bget\n"
+            "                        pool, in bytes (default: library default)\n");
+    fprintf(stderr, "  --format=FMT        : json,csv (default: json)\n");
+    fprintf(stderr, "  --out=FILE          : Output file (default: stdout)\n");
+}
+
+/* Parse the command line arguments. Returns 0 on success */
+static int perf_parse_opts(int argc, char *argv[], perf_opts_t *opts)
+{
+    /* Defaults */
+    memset(opts, 0, sizeof(perf_opts_t));
+    opts->arraylens[0] = 4096;
+    opts->arraylens[1] = 65536;
+    opts->arraylens[2] = 1048576;
+    opts->narraylens = 3;
+    opts->hugepages[0] = 0;
+    opts->nhugepages = 1;
+    opts->nvars = 16;
+    opts->nfiles = 2;
+    opts->nflushes = 100;
+    opts->buf_limit = PIOc_set_buffer_size_limit(0);
+    opts->out_fmt = PERF_OUT_JSON;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const char *val = strchr(arg, '=');
+        int nvals = 0;
+
+        if (!val)
+            return -1;
+        val++;
+
+#define PERF_OPT_IS(name) (!strncmp(arg, name "=", strlen(name "=")))
+        if (PERF_OPT_IS("--arraylens"))
+            nvals = opts->narraylens = perf_parse_list(val, opts->arraylens);
+        else if (PERF_OPT_IS("--hugepages"))
+            nvals = opts->nhugepages = perf_parse_list(val, opts->hugepages);
+        else if (PERF_OPT_IS("--nvars"))
+            nvals = (opts->nvars = atoi(val)) > 0;
+        else if (PERF_OPT_IS("--nfiles"))
+            nvals = ((opts->nfiles = atoi(val)) > 0) && (opts->nfiles <= PERF_MAX_FILES);
+        else if (PERF_OPT_IS("--nflushes"))
+            nvals = (opts->nflushes = atoi(val)) > 0;
+        else if (PERF_OPT_IS("--buf-limit"))
+            nvals = (opts->buf_limit = atoll(val)) > 0;
+        else if (PERF_OPT_IS("--format"))
+        {
+            if (!strcmp(val, "json"))
+                opts->out_fmt = PERF_OUT_JSON;
+            else if (!strcmp(val, "csv"))
+                opts->out_fmt = PERF_OUT_CSV;
+            else
+                return -1;
+            nvals = 1;
+        }
+        else if (PERF_OPT_IS("--out"))
+        {
+            strncpy(opts->out_fname, val, PIO_MAX_NAME);
+            opts->out_fname[PIO_MAX_NAME] = '\0';
+            nvals = 1;
+        }
+#undef PERF_OPT_IS
+
+        if (nvals <= 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+/* Handler for allocating more memory for the bget buffer pool */
+static void *perf_bpool_alloc(bufsize sz)
+{
+    return malloc((size_t)sz);
+}
+
+/* Handler for freeing the memory of the bget buffer pool */
+static void perf_bpool_free(void *p)
+{
+    free(p);
+}
+
+/* Get, resize and release a buffer with an allocator */
+static void *perf_get(int alloc, pio_arena_t *arena, size_t size)
+{
+    return (alloc == PERF_ALLOC_BGET) ? bget((bufsize)size) : pio_arena_alloc(arena, size);
+}
+
+static void *perf_getr(int alloc, pio_arena_t *arena, void *buf, size_t size)
+{
+    return (alloc == PERF_ALLOC_BGET) ? bgetr(buf, (bufsize)size) :
+        pio_arena_realloc(arena, buf, size);
+}
+
+static void perf_rel(int alloc, pio_arena_t *arena, void *buf)
+{
+    if (alloc == PERF_ALLOC_BGET)
+        brel(buf);
+    else
+        pio_arena_release(arena, buf);
+}
+
+/* Flush the data cached in a wmb, the data is copied to an IO buffer
+ * as the rearranger does */
+static int perf_flush(int alloc, pio_arena_t *arena, char **wmb, size_t cached)
+{
+    char *iobuf;
+
+    if (!(iobuf = perf_get(alloc, arena, cached)))
+        return PIO_ENOMEM;
+    memcpy(iobuf, *wmb, cached);
+    perf_rel(alloc, arena, iobuf);
+    perf_rel(alloc, arena, *wmb);
+    *wmb = NULL;
+
+    return PIO_NOERR;
+}
+
+/* Run the benchmark for one allocator and array length */
+static int perf_run(const perf_opts_t *opts, int alloc, int arraylen, int hugepages,
+                    MPI_Comm comm, perf_result_t *res)
+{
+    pio_arena_t *arena = NULL;
+    char *wmb[PERF_MAX_FILES] = {NULL};
+    int nvars[PERF_MAX_FILES] = {0};
+    long long early_flushes = 0;
+    long long nget = 0;
+    long long tot_cached = 0;
+    double nbytes = 0;
+    double t_start, t_alloc;
+    int ret = PIO_NOERR;
+
+    if (alloc == PERF_ALLOC_BGET)
+        bectl(NULL, perf_bpool_alloc, perf_bpool_free, (bufsize)opts->buf_limit);
+    else
+    {
+        if ((ret = pio_arena_create(&arena)))
+            return ret;
+        pio_arena_set_hugepages(arena, hugepages);
+    }
+
+    MPI_Barrier(comm);
+    t_start = MPI_Wtime();
+    for (int fl = 0; (ret == PIO_NOERR) && (fl < opts->nflushes); fl++)
+    {
+        /* The variables of the files are written in turn, the arrays
+         * of file f are (f + 1) times longer than those of file 0 */
+        for (int v = 0; (ret == PIO_NOERR) && (v < opts->nvars); v++)
+        {
+            for (int f = 0; (ret == PIO_NOERR) && (f < opts->nfiles); f++)
+            {
+                size_t len = (size_t)arraylen * (f + 1);
+                size_t cached = nvars[f] * len;
+                char *buf;
+
+                /* The data cached by the files exceeds the buffer size
+                 * limit, the file is flushed as by write_darray */
+                if (nvars[f] > 0 && tot_cached >= opts->buf_limit)
+                {
+                    if ((ret = perf_flush(alloc, arena, &wmb[f], cached)))
+                        break;
+                    nget++;
+                    nvars[f] = 0;
+                    tot_cached -= cached;
+                    cached = 0;
+                }
+
+                if (alloc == PERF_ALLOC_BGET && nvars[f] > 0)
+                {
+                    bufsize curalloc, totfree, maxfree;
+                    long bnget, bnrel;
+
+                    bstats(&curalloc, &totfree, &maxfree, &bnget, &bnrel);
+                    if (maxfree <= 1.1 * (cached + len))
+                    {
+                        if ((ret = perf_flush(alloc, arena, &wmb[f], cached)))
+                            break;
+                        nget++;
+                        nvars[f] = 0;
+                        tot_cached -= cached;
+                        cached = 0;
+                        early_flushes++;
+                    }
+                }
+
+                if (!(buf = perf_getr(alloc, arena, wmb[f], cached + len)))
+                {
+                    ret = PIO_ENOMEM;
+                    break;
+                }
+                wmb[f] = buf;
+                memset(wmb[f] + cached, v, len);
+                nvars[f]++;
+                nget++;
+                nbytes += len;
+                tot_cached += len;
+            }
+        }
+
+        for (int f = 0; (ret == PIO_NOERR) && (f < opts->nfiles); f++)
+        {
+            if (nvars[f] > 0 &&
+                (ret = perf_flush(alloc, arena, &wmb[f], nvars[f] * (size_t)arraylen * (f + 1))))
+                break;
+            nget++;
+            nvars[f] = 0;
+        }
+        tot_cached = 0;
+    }
+    t_alloc = MPI_Wtime() - t_start;
+
+    for (int f = 0; f < opts->nfiles; f++)
+    {
+        if (wmb[f])
+            perf_rel(alloc, arena, wmb[f]);
+    }
+    pio_arena_free(arena);
+
+    /* An allocation failure on any process fails the run */
+    MPI_Allreduce(MPI_IN_PLACE, &ret, 1, MPI_INT, MPI_MAX, comm);
+    if (ret != PIO_NOERR)
+        return ret;
+
+    MPI_Reduce(&t_alloc, &res->t_alloc, 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+    MPI_Reduce(&nbytes, &res->nbytes, 1, MPI_DOUBLE, MPI_SUM, 0, comm);
+    MPI_Reduce(&early_flushes, &res->early_flushes, 1, MPI_LONG_LONG, MPI_MAX, 0, comm);
+    MPI_Reduce(&nget, &res->nget, 1, MPI_LONG_LONG, MPI_MAX, 0, comm);
+
+    return PIO_NOERR;
+}
+
+/* Bandwidth in MB/s */
+static double perf_bw(double nbytes, double t)
+{
+    return (t > 0) ? (nbytes / PERF_MB / t) : 0.0;
+}
+
+static void perf_write_header(FILE *fp, int out_fmt)
+{
+    if (out_fmt == PERF_OUT_CSV)
+        fprintf(fp, "alloc,hugepages,nprocs,arraylen,nvars,nfiles,nflushes,buf_limit,data_mb,"
+                "t_alloc,bw_alloc,ns_per_get,early_flushes\n");
+    else
+        fprintf(fp, "[\n");
+}
+
+static void perf_write_footer(FILE *fp, int out_fmt)
+{
+    if (out_fmt == PERF_OUT_JSON)
+        fprintf(fp, "\n]\n");
+}
+
+/* Write out the results of one run */
+static void perf_write_result(FILE *fp, const perf_opts_t *opts, int first, int alloc,
+                              int hugepages, int nprocs, int arraylen,
+                              const perf_result_t *res)
+{
+    double ns_per_get = (res->nget > 0) ? (res->t_alloc * 1e9 / res->nget) : 0.0;
+
+    if (opts->out_fmt == PERF_OUT_CSV)
+    {
+        fprintf(fp, "%s,%d,%d,%d,%d,%d,%d,%lld,%.3f,%.6f,%.3f,%.1f,%lld\n",
+                alloc_names[alloc], hugepages, nprocs, arraylen, opts->nvars, opts->nfiles,
+                opts->nflushes, opts->buf_limit, res->nbytes / PERF_MB, res->t_alloc,
+                perf_bw(res->nbytes, res->t_alloc), ns_per_get, res->early_flushes);
+    }
+    else
+    {
+        fprintf(fp, "%s  {\"alloc\": \"%s\", \"hugepages\": %d, \"nprocs\": %d, "
+                "\"arraylen\": %d, \"nvars\": %d, \"nfiles\": %d, \"nflushes\": %d, "
+                "\"buf_limit\": %lld, \"data_mb\": %.3f,\n"
+                "   \"time\": {\"alloc\": %.6f}, \"bw_mbps\": {\"alloc\": %.3f}, "
+                "\"ns_per_get\": %.1f, \"early_flushes\": %lld}",
+                first ? "" : ",\n",
+                alloc_names[alloc], hugepages, nprocs, arraylen, opts->nvars, opts->nfiles,
+                opts->nflushes, opts->buf_limit, res->nbytes / PERF_MB, res->t_alloc,
+                perf_bw(res->nbytes, res->t_alloc), ns_per_get, res->early_flushes);
+    }
+    fflush(fp);
+}
+
+int main(int argc, char *argv[])
+{
+    perf_opts_t opts;
+    MPI_Comm comm = MPI_COMM_WORLD;
+    int rank, nprocs;
+    FILE *fp = NULL;
+    int first = 1;
+    int ret = PIO_NOERR;
+
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &nprocs);
+
+    if (perf_parse_opts(argc, argv, &opts))
+    {
+        if (!rank)
+            perf_usage(argv[0]);
+        MPI_Finalize();
+        return 1;
+    }
+
+    if (!rank)
+    {
+        fp = (strlen(opts.out_fname) > 0) ? fopen(opts.out_fname, "w") : stdout;
+        if (!fp)
+        {
+            fprintf(stderr, "Unable to open output file, %s\n", opts.out_fname);
+            MPI_Abort(comm, 1);
+        }
+        perf_write_header(fp, opts.out_fmt);
+    }
+
+    for (int al = 0; (ret == PIO_NOERR) && (al < opts.narraylens); al++)
+    {
+        for (int alloc = PERF_ALLOC_BGET; (ret == PIO_NOERR) && (alloc <= PERF_ALLOC_ARENA); alloc++)
+        {
+            /* Huge pages are only used by the arena */
+            int nhp = (alloc == PERF_ALLOC_ARENA) ? opts.nhugepages : 1;
+
+            for (int hp = 0; (ret == PIO_NOERR) && (hp < nhp); hp++)
+            {
+                int hugepages = (alloc == PERF_ALLOC_ARENA) ? opts.hugepages[hp] : 0;
+                perf_result_t res;
+
+                if ((ret = perf_run(&opts, alloc, opts.arraylens[al], hugepages, comm, &res)))
+                {
+                    if (!rank)
+                        fprintf(stderr, "Benchmark failed for allocator %s, array length %d"
+                                " (ret = %d)\n", alloc_names[alloc], opts.arraylens[al], ret);
+                    break;
+                }
+
+                if (!rank)
+                {
+                    perf_write_result(fp, &opts, first, alloc, hugepages, nprocs,
+                                      opts.arraylens[al], &res);
+                    first = 0;
+                }
+            }
+        }
+    }
+
+    if (!rank)
+    {
+        perf_write_footer(fp, opts.out_fmt);
+        if (fp != stdout)
+            fclose(fp);
+    }
+
+    MPI_Finalize();
+
+    return (ret == PIO_NOERR) ? 0 : 1;
+}
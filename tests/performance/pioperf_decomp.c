@@ -0,0 +1,808 @@
+/*
+ * Benchmark driver that replays I/O decompositions saved by PIO
+ * (PIO_SAVE_DECOMPS, "piodecomp*.dat" files written by
+ * PIOc_writemap(), or NetCDF decomposition files written by
+ * PIOc_write_nc_decomp()) and reports the time and bandwidth of each
+ * stage of the PIO write/read pipeline:
+ *
+ * - decomp    : Creating the I/O decomposition (PIOc_InitDecomp)
+ * - rearr_c2i : Rearranging data from compute to I/O tasks
+ * - write     : Writing data (PIOc_write_darray + PIOc_sync)
+ * - disk_write: Estimated time spent writing to disk (write - rearr_c2i)
+ * - rearr_i2c : Rearranging data from I/O to compute tasks
+ * - read      : Reading data (PIOc_read_darray)
+ *
+ * for every combination of the iotypes, rearrangers, number of I/O
+ * tasks, rearranger options and buffer size limits specified by the
+ * user. The results are written out by the root process in JSON or
+ * CSV format.
+ *
+ * Usage:
+ *   mpiexec -n 4 ./pioperf_decomp [OPTIONS] DECOMP_FILE [DECOMP_FILE ...]
+ *
+ * All options that accept a list of values expect a comma separated
+ * list (e.g. --iotypes=pnetcdf,netcdf4p), run with --help for the
+ * list of options.
+ */
+#include <pio.h>
+#include <pio_internal.h>
+
+/* Max number of values in an option list */
+#define PERF_MAX_OPT_VALS 64
+
+/* Max number of decomposition files */
+#define PERF_MAX_DECOMP_FILES 256
+
+/* Name of the file used for benchmarking */
+#define PERF_FNAME_PREFIX "pioperf_decomp"
+
+/* Bytes in a megabyte */
+#define PERF_MB (1024.0 * 1024.0)
+
+/* Output formats */
+enum PERF_OUT_FMT
+{
+    PERF_OUT_JSON = 0,
+    PERF_OUT_CSV
+};
+
+/* User options */
+typedef struct perf_opts
+{
+    int iotypes[PERF_MAX_OPT_VALS];
+    int niotypes;
+    int rearrs[PERF_MAX_OPT_VALS];
+    int nrearrs;
+    int niotasks[PERF_MAX_OPT_VALS];
+    int nniotasks;
+    int comm_types[PERF_MAX_OPT_VALS];
+    int ncomm_types;
+    int fcds[PERF_MAX_OPT_VALS];
+    int nfcds;
+    int hs[PERF_MAX_OPT_VALS];
+    int nhs;
+    int isends[PERF_MAX_OPT_VALS];
+    int nisends;
+    int max_pend_reqs[PERF_MAX_OPT_VALS];
+    int nmax_pend_reqs;
+    long long buf_limits[PERF_MAX_OPT_VALS];
+    int nbuf_limits;
+    int nvars;
+    int nframes;
+    int piotype;
+    int out_fmt;
+    int keep_files;
+    char out_fname[PIO_MAX_NAME + 1];
+    const char *decomp_files[PERF_MAX_DECOMP_FILES];
+    int ndecomp_files;
+} perf_opts_t;
+
+/* Timing (max across all processes) and size of one benchmark run */
+typedef struct perf_result
+{
+    double t_decomp;
+    double t_rearr_c2i;
+    double t_write;
+    double t_rearr_i2c;
+    double t_read;
+
+    /* Total size of data written/read, in bytes */
+    double nbytes;
+} perf_result_t;
+
+/* Mapping between names used in options and PIO values */
+typedef struct perf_name_val
+{
+    const char *name;
+    int val;
+} perf_name_val_t;
+
+static const perf_name_val_t iotype_names[] = {
+    {"pnetcdf", PIO_IOTYPE_PNETCDF}, {"netcdf", PIO_IOTYPE_NETCDF},
+    {"netcdf4c", PIO_IOTYPE_NETCDF4C}, {"netcdf4p", PIO_IOTYPE_NETCDF4P},
+    {NULL, 0}};
+static const perf_name_val_t rearr_names[] = {
+    {"box", PIO_REARR_BOX}, {"subset", PIO_REARR_SUBSET}, {NULL, 0}};
+static const perf_name_val_t comm_type_names[] = {
+    {"p2p", PIO_REARR_COMM_P2P}, {"coll", PIO_REARR_COMM_COLL}, {NULL, 0}};
+static const perf_name_val_t fcd_names[] = {
+    {"2denable", PIO_REARR_COMM_FC_2D_ENABLE}, {"1dcomp2io", PIO_REARR_COMM_FC_1D_COMP2IO},
+    {"1dio2comp", PIO_REARR_COMM_FC_1D_IO2COMP}, {"2ddisable", PIO_REARR_COMM_FC_2D_DISABLE},
+    {NULL, 0}};
+static const perf_name_val_t piotype_names[] = {
+    {"double", PIO_DOUBLE}, {"float", PIO_FLOAT}, {"int", PIO_INT}, {NULL, 0}};
+
+/* Get the name corresponding to a PIO value */
+static const char *perf_val2name(const perf_name_val_t *nv, int val)
+{
+    for (int i = 0; nv[i].name; i++)
+    {
+        if (nv[i].val == val)
+            return nv[i].name;
+    }
+
+    return "unknown";
+}
+
+/* Parse a comma separated list of names (nv != NULL) or integers
+ * (nv == NULL) into vals. Returns the number of values parsed, or
+ * -1 on error */
+static int perf_parse_list(const char *str, const perf_name_val_t *nv, int *vals)
+{
+    char buf[PIO_MAX_NAME + 1];
+    int nvals = 0;
+
+    strncpy(buf, str, PIO_MAX_NAME);
+    buf[PIO_MAX_NAME] = '\0';
+    for (char *tok = strtok(buf, ","); tok; tok = strtok(NULL, ","))
+    {
+        if (nvals == PERF_MAX_OPT_VALS)
+            return -1;
+
+        if (nv)
+        {
+            int i;
+            for (i = 0; nv[i].name && strcmp(nv[i].name, tok); i++);
+            if (!nv[i].name)
+                return -1;
+            vals[nvals++] = nv[i].val;
+        }
+        else
+        {
+            char *endp = NULL;
+            vals[nvals++] = (int)strtol(tok, &endp, 10);
+            if (endp == tok)
+                return -1;
+        }
+    }
+
+    return nvals;
+}
+
+/* Parse a comma separated list of integers, that may not fit in an
+ * int, into vals. Returns the number of values parsed, or -1 on
+ * error */
+static int perf_parse_llist(const char *str, long long *vals)
+{
+    char buf[PIO_MAX_NAME + 1];
+    int nvals = 0;
+
+    strncpy(buf, str, PIO_MAX_NAME);
+    buf[PIO_MAX_NAME] = '\0';
+    for (char *tok = strtok(buf, ","); tok; tok = strtok(NULL, ","))
+    {
+        char *endp = NULL;
+
+        if (nvals == PERF_MAX_OPT_VALS)
+            return -1;
+        vals[nvals++] = strtoll(tok, &endp, 10);
+        if (endp == tok)
+            return -1;
+    }
+
+    return nvals;
+}
+
+static void perf_usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [OPTIONS] DECOMP_FILE [DECOMP_FILE ...]\n", prog);
+    fprintf(stderr, "  DECOMP_FILE : Decomposition saved by PIO (piodecomp*.dat, or *.nc)\n");
+    fprintf(stderr, "  --iotypes=LIST      : pnetcdf,netcdf,netcdf4c,netcdf4p (default: all available)\n");
+    fprintf(stderr, "  --rearrs=LIST       : box,subset (default: box,subset)\n");
+    fprintf(stderr, "  --niotasks=LIST     : Number of I/O tasks (default: number of processes)\n");
+    fprintf(stderr, "  --comm-types=LIST   : p2p,coll (default: p2p)\n");
+    fprintf(stderr, "  --fcds=LIST         : 2denable,1dcomp2io,1dio2comp,2ddisable (default: 2denable)\n");
+    fprintf(stderr, "  --hs=LIST           : Enable handshake, 0,1 (default: 0)\n");
+    fprintf(stderr, "  --isend=LIST        : Enable isends, 0,1 (default: 1)\n");
+    fprintf(stderr, "  --max-pend-req=LIST : Max pending requests, -1 is unlimited (default: 64)\n");
+    fprintf(stderr, "  --buf-limits=LIST   : Buffer size limits in bytes (default: library default)\n");
+    fprintf(stderr, "  --nvars=N           : Number of variables (default: 1)\n");
+    fprintf(stderr, "  --nframes=N         : Number of frames/records (default: 1)\n");
+    fprintf(stderr, "  --type=TYPE         : double,float,int (default: double)\n");
+    fprintf(stderr, "  --format=FMT        : json,csv (default: json)\n");
+    fprintf(stderr, "  --out=FILE          : Output file (default: stdout)\n");
+    fprintf(stderr, "  --keep              : Do not delete the output data files\n");
+}
+
+/* Parse the command line arguments. Returns 0 on success */
+static int perf_parse_opts(int argc, char *argv[], perf_opts_t *opts)
+{
+    /* Defaults */
+    memset(opts, 0, sizeof(perf_opts_t));
+    for (int i = 0; iotype_names[i].name; i++)
+    {
+        if (PIOc_iotype_available(iotype_names[i].val))
+            opts->iotypes[opts->niotypes++] = iotype_names[i].val;
+    }
+    opts->rearrs[0] = PIO_REARR_BOX;
+    opts->rearrs[1] = PIO_REARR_SUBSET;
+    opts->nrearrs = 2;
+    opts->nniotasks = 0;
+    opts->comm_types[0] = PIO_REARR_COMM_P2P;
+    opts->ncomm_types = 1;
+    opts->fcds[0] = PIO_REARR_COMM_FC_2D_ENABLE;
+    opts->nfcds = 1;
+    opts->hs[0] = 0;
+    opts->nhs = 1;
+    opts->isends[0] = 1;
+    opts->nisends = 1;
+    opts->max_pend_reqs[0] = 64;
+    opts->nmax_pend_reqs = 1;
+    opts->nbuf_limits = 0;
+    opts->nvars = 1;
+    opts->nframes = 1;
+    opts->piotype = PIO_DOUBLE;
+    opts->out_fmt = PERF_OUT_JSON;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const char *val = strchr(arg, '=');
+        int nvals = 0;
+        int tmp[PERF_MAX_OPT_VALS];
+
+        if (strncmp(arg, "--", 2))
+        {
+            if (opts->ndecomp_files == PERF_MAX_DECOMP_FILES)
+                return -1;
+            opts->decomp_files[opts->ndecomp_files++] = arg;
+            continue;
+        }
+
+        if (!strcmp(arg, "--keep"))
+        {
+            opts->keep_files = 1;
+            continue;
+        }
+
+        if (!val)
+            return -1;
+        val++;
+
+#define PERF_OPT_IS(name) (!strncmp(arg, name "=", strlen(name "=")))
+        if (PERF_OPT_IS("--iotypes"))
+            nvals = opts->niotypes = perf_parse_list(val, iotype_names, opts->iotypes);
+        else if (PERF_OPT_IS("--rearrs"))
+            nvals = opts->nrearrs = perf_parse_list(val, rearr_names, opts->rearrs);
+        else if (PERF_OPT_IS("--niotasks"))
+            nvals = opts->nniotasks = perf_parse_list(val, NULL, opts->niotasks);
+        else if (PERF_OPT_IS("--comm-types"))
+            nvals = opts->ncomm_types = perf_parse_list(val, comm_type_names, opts->comm_types);
+        else if (PERF_OPT_IS("--fcds"))
+            nvals = opts->nfcds = perf_parse_list(val, fcd_names, opts->fcds);
+        else if (PERF_OPT_IS("--hs"))
+            nvals = opts->nhs = perf_parse_list(val, NULL, opts->hs);
+        else if (PERF_OPT_IS("--isend"))
+            nvals = opts->nisends = perf_parse_list(val, NULL, opts->isends);
+        else if (PERF_OPT_IS("--max-pend-req"))
+            nvals = opts->nmax_pend_reqs = perf_parse_list(val, NULL, opts->max_pend_reqs);
+        else if (PERF_OPT_IS("--buf-limits"))
+            nvals = opts->nbuf_limits = perf_parse_llist(val, opts->buf_limits);
+        else if (PERF_OPT_IS("--nvars"))
+            nvals = (opts->nvars = atoi(val)) > 0;
+        else if (PERF_OPT_IS("--nframes"))
+            nvals = (opts->nframes = atoi(val)) > 0;
+        else if (PERF_OPT_IS("--type"))
+        {
+            nvals = perf_parse_list(val, piotype_names, tmp);
+            opts->piotype = tmp[0];
+        }
+        else if (PERF_OPT_IS("--format"))
+        {
+            nvals = 1;
+            if (!strcmp(val, "json"))
+                opts->out_fmt = PERF_OUT_JSON;
+            else if (!strcmp(val, "csv"))
+                opts->out_fmt = PERF_OUT_CSV;
+            else
+                nvals = -1;
+        }
+        else if (PERF_OPT_IS("--out"))
+        {
+            nvals = 1;
+            strncpy(opts->out_fname, val, PIO_MAX_NAME);
+        }
+        else
+            nvals = -1;
+#undef PERF_OPT_IS
+
+        if (nvals <= 0)
+            return -1;
+    }
+
+    return (opts->ndecomp_files > 0 && opts->niotypes > 0) ? 0 : -1;
+}
+
+/* Read the decomposition map, for this process, from a decomposition
+ * file. NetCDF decomposition files (*.nc) need an I/O system to read
+ * the file. The 1-based map is returned in *mapp (free with free())
+ */
+static int perf_read_decomp(int iosysid, const char *fname, MPI_Comm comm,
+                            int *ndims, int **gdims, PIO_Offset *maplen,
+                            PIO_Offset **mapp)
+{
+    size_t len = strlen(fname);
+    int ret;
+
+    if ((len > 3) && !strcmp(fname + len - 3, ".nc"))
+    {
+        int num_tasks, max_maplen, rank;
+        int *task_maplen = NULL, *full_map = NULL;
+
+        if ((ret = pioc_read_nc_decomp_int(iosysid, fname, ndims, gdims, &num_tasks,
+                                           &task_maplen, &max_maplen, &full_map,
+                                           NULL, NULL, NULL, NULL, NULL)))
+            return ret;
+
+        MPI_Comm_rank(comm, &rank);
+        *maplen = (rank < num_tasks) ? task_maplen[rank] : 0;
+        if (!(*mapp = malloc((*maplen + 1) * sizeof(PIO_Offset))))
+            return PIO_ENOMEM;
+
+        /* Convert the 0-based map in the file to a 1-based map */
+        for (PIO_Offset i = 0; i < *maplen; i++)
+            (*mapp)[i] = full_map[rank * max_maplen + i] + 1;
+
+        free(task_maplen);
+        free(full_map);
+        return PIO_NOERR;
+    }
+
+    *mapp = NULL;
+    ret = PIOc_readmap(fname, ndims, gdims, maplen, mapp, comm);
+    if ((ret == PIO_NOERR) && !(*mapp))
+    {
+        /* Process not included in the decomposition */
+        if (!(*mapp = malloc(sizeof(PIO_Offset))))
+            return PIO_ENOMEM;
+    }
+
+    return ret;
+}
+
+/* Max of a local time across all processes */
+static double perf_max_time(double t, MPI_Comm comm)
+{
+    double tmax = 0;
+
+    MPI_Allreduce(&t, &tmax, 1, MPI_DOUBLE, MPI_MAX, comm);
+
+    return tmax;
+}
+
+/* Rearrange, write and read the data of a decomposition, with the
+ * buffers allocated by perf_run() */
+static int perf_run_decomp(const perf_opts_t *opts, int iosysid, int iotype, int rearr,
+                           int ndims, const int *gdims, PIO_Offset maplen,
+                           PIO_Offset *map, int ioid, int typesize, void *buf,
+                           void *iobuf, int *varids, MPI_Comm comm, perf_result_t *res)
+{
+    iosystem_desc_t *ios;
+    io_desc_t *iodesc;
+    int ncid, dimids[PIO_MAX_DIMS + 1];
+    char fname[PIO_MAX_NAME + 1];
+    double t;
+    int ret;
+
+    if (!(ios = pio_get_iosystem_from_id(iosysid)) || !(iodesc = pio_get_iodesc_from_id(ioid)))
+        return PIO_EBADID;
+
+    /* Data for all variables (one variable after another), the value
+     * of each element is its global index */
+    for (PIO_Offset i = 0; i < maplen * opts->nvars; i++)
+    {
+        PIO_Offset v = map[i % maplen];
+        if (opts->piotype == PIO_DOUBLE)
+            ((double *)buf)[i] = (double)v;
+        else if (opts->piotype == PIO_FLOAT)
+            ((float *)buf)[i] = (float)v;
+        else
+            ((int *)buf)[i] = (int)v;
+    }
+
+    /* Rearrange, compute to I/O tasks, of all variables in a frame */
+    MPI_Barrier(comm);
+    t = MPI_Wtime();
+    for (int f = 0; f < opts->nframes; f++)
+    {
+        if ((ret = rearrange_comp2io(ios, iodesc, buf, iobuf, opts->nvars)))
+            return ret;
+    }
+    res->t_rearr_c2i = perf_max_time(MPI_Wtime() - t, comm);
+
+    /* Rearrange, I/O to compute tasks, one variable at a time */
+    MPI_Barrier(comm);
+    t = MPI_Wtime();
+    for (int f = 0; f < opts->nframes; f++)
+    {
+        for (int v = 0; v < opts->nvars; v++)
+        {
+            if ((ret = rearrange_io2comp(ios, iodesc, iobuf, buf)))
+                return ret;
+        }
+    }
+    res->t_rearr_i2c = perf_max_time(MPI_Wtime() - t, comm);
+
+    /* Write */
+    snprintf(fname, PIO_MAX_NAME, "%s_%s_%s.nc", PERF_FNAME_PREFIX,
+             perf_val2name(iotype_names, iotype), perf_val2name(rearr_names, rearr));
+    if ((ret = PIOc_createfile(iosysid, &ncid, &iotype, fname, PIO_CLOBBER | PIO_64BIT_DATA)))
+        return ret;
+    if ((ret = PIOc_def_dim(ncid, "time", PIO_UNLIMITED, &dimids[0])))
+        goto exit;
+    for (int d = 0; d < ndims; d++)
+    {
+        char dname[PIO_MAX_NAME + 1];
+        snprintf(dname, PIO_MAX_NAME, "dim%d", d);
+        if ((ret = PIOc_def_dim(ncid, dname, gdims[d], &dimids[d + 1])))
+            goto exit;
+    }
+    for (int v = 0; v < opts->nvars; v++)
+    {
+        char vname[PIO_MAX_NAME + 1];
+        snprintf(vname, PIO_MAX_NAME, "var%d", v);
+        if ((ret = PIOc_def_var(ncid, vname, opts->piotype, ndims + 1, dimids, &varids[v])))
+            goto exit;
+    }
+    if ((ret = PIOc_enddef(ncid)))
+        goto exit;
+
+    MPI_Barrier(comm);
+    t = MPI_Wtime();
+    for (int f = 0; f < opts->nframes; f++)
+    {
+        for (int v = 0; v < opts->nvars; v++)
+        {
+            if ((ret = PIOc_setframe(ncid, varids[v], f)))
+                goto exit;
+            if ((ret = PIOc_write_darray(ncid, varids[v], ioid, maplen,
+                                         (char *)buf + v * maplen * typesize, NULL)))
+                goto exit;
+        }
+    }
+    if ((ret = PIOc_sync(ncid)))
+        goto exit;
+    res->t_write = perf_max_time(MPI_Wtime() - t, comm);
+
+    if ((ret = PIOc_closefile(ncid)))
+        return ret;
+
+    /* Read */
+    if ((ret = PIOc_openfile(iosysid, &ncid, &iotype, fname, PIO_NOWRITE)))
+        return ret;
+
+    MPI_Barrier(comm);
+    t = MPI_Wtime();
+    for (int f = 0; f < opts->nframes; f++)
+    {
+        for (int v = 0; v < opts->nvars; v++)
+        {
+            if ((ret = PIOc_setframe(ncid, varids[v], f)))
+                goto exit;
+            if ((ret = PIOc_read_darray(ncid, varids[v], ioid, maplen,
+                                        (char *)buf + v * maplen * typesize)))
+                goto exit;
+        }
+    }
+    res->t_read = perf_max_time(MPI_Wtime() - t, comm);
+
+    if ((ret = PIOc_closefile(ncid)))
+        return ret;
+    if (!opts->keep_files)
+    {
+        if ((ret = PIOc_deletefile(iosysid, fname)))
+            return ret;
+    }
+
+    /* Total size of data written/read */
+    {
+        double lbytes = 0;
+        for (PIO_Offset i = 0; i < maplen; i++)
+        {
+            if (map[i] > 0)
+                lbytes += typesize;
+        }
+        lbytes *= (double)opts->nvars * opts->nframes;
+        MPI_Allreduce(&lbytes, &res->nbytes, 1, MPI_DOUBLE, MPI_SUM, comm);
+    }
+
+    return PIO_NOERR;
+
+exit:
+    /* Close the file on errors while it is open, the decomposition is
+     * freed by perf_run() */
+    PIOc_closefile(ncid);
+
+    return ret;
+}
+
+/* Run the benchmark for one decomposition and one configuration
+ * (iotype, rearranger, I/O system with rearranger options already set) */
+static int perf_run(const perf_opts_t *opts, int iosysid, int iotype, int rearr,
+                    int ndims, const int *gdims, PIO_Offset maplen,
+                    PIO_Offset *map, MPI_Comm comm, perf_result_t *res)
+{
+    io_desc_t *iodesc;
+    int ioid, *varids;
+    int typesize;
+    void *buf, *iobuf;
+    double t;
+    int ret, fret;
+
+    memset(res, 0, sizeof(perf_result_t));
+
+    typesize = (opts->piotype == PIO_DOUBLE) ? sizeof(double) :
+        ((opts->piotype == PIO_FLOAT) ? sizeof(float) : sizeof(int));
+
+    /* Decomposition creation */
+    MPI_Barrier(comm);
+    t = MPI_Wtime();
+    if ((ret = PIOc_InitDecomp(iosysid, opts->piotype, ndims, gdims, (int)maplen, map,
+                               &ioid, &rearr, NULL, NULL)))
+        return ret;
+    res->t_decomp = perf_max_time(MPI_Wtime() - t, comm);
+
+    if (!(iodesc = pio_get_iodesc_from_id(ioid)))
+        return PIO_EBADID;
+
+    /* The buffers are freed, and the decomposition too, whether the
+     * benchmark succeeds or not */
+    buf = malloc((maplen * opts->nvars + 1) * typesize);
+    iobuf = malloc((iodesc->maxiobuflen * opts->nvars + 1) * typesize);
+    varids = malloc(opts->nvars * sizeof(int));
+    if (buf && iobuf && varids)
+        ret = perf_run_decomp(opts, iosysid, iotype, rearr, ndims, gdims, maplen, map,
+                              ioid, typesize, buf, iobuf, varids, comm, res);
+    else
+        ret = PIO_ENOMEM;
+
+    free(varids);
+    free(iobuf);
+    free(buf);
+
+    fret = PIOc_freedecomp(iosysid, ioid);
+
+    return (ret != PIO_NOERR) ? ret : fret;
+}
+
+/* Bandwidth in MB/s */
+static double perf_bw(double nbytes, double t)
+{
+    return (t > 0) ? (nbytes / PERF_MB / t) : 0.0;
+}
+
+static void perf_write_header(FILE *fp, int out_fmt)
+{
+    if (out_fmt == PERF_OUT_CSV)
+    {
+        fprintf(fp, "decomp,iotype,rearr,nprocs,niotasks,comm_type,fcd,hs,isend,max_pend_req,"
+                "buf_limit,type,nvars,nframes,data_mb,"
+                "t_decomp,t_rearr_c2i,t_write,t_disk_write,t_rearr_i2c,t_read,"
+                "bw_rearr_c2i,bw_write,bw_disk_write,bw_rearr_i2c,bw_read\n");
+    }
+    else
+        fprintf(fp, "[\n");
+}
+
+static void perf_write_footer(FILE *fp, int out_fmt)
+{
+    if (out_fmt == PERF_OUT_JSON)
+        fprintf(fp, "\n]\n");
+}
+
+/* Write a JSON string member, "key": "val", with the quotes,
+ * backslashes and control characters of val escaped */
+static void perf_write_json_str(FILE *fp, const char *key, const char *val)
+{
+    fprintf(fp, "\"%s\": \"", key);
+    for (const unsigned char *c = (const unsigned char *)val; *c; c++)
+    {
+        if (*c == '"' || *c == '\\')
+            fprintf(fp, "\\%c", *c);
+        else if (*c < 0x20)
+            fprintf(fp, "\\u%04x", *c);
+        else
+            fputc(*c, fp);
+    }
+    fprintf(fp, "\", ");
+}
+
+/* Write out the results of one run */
+static void perf_write_result(FILE *fp, const perf_opts_t *opts, int first,
+                              const char *decomp, int iotype, int rearr,
+                              int nprocs, int niotasks, const rearr_opt_t *ropts,
+                              long long buf_limit, const perf_result_t *res)
+{
+    /* The rearrangement is part of the write, the rest is an estimate
+     * of the time spent writing out data to disk */
+    double t_disk_write = (res->t_write > res->t_rearr_c2i) ? (res->t_write - res->t_rearr_c2i) : 0.0;
+
+    if (opts->out_fmt == PERF_OUT_CSV)
+    {
+        fprintf(fp, "%s,%s,%s,%d,%d,%s,%s,%d,%d,%d,%lld,%s,%d,%d,%.3f,"
+                "%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+                decomp, perf_val2name(iotype_names, iotype), perf_val2name(rearr_names, rearr),
+                nprocs, niotasks, perf_val2name(comm_type_names, ropts->comm_type),
+                perf_val2name(fcd_names, ropts->fcd), (int)ropts->comp2io.hs,
+                (int)ropts->comp2io.isend, ropts->comp2io.max_pend_req, buf_limit,
+                perf_val2name(piotype_names, opts->piotype), opts->nvars, opts->nframes,
+                res->nbytes / PERF_MB,
+                res->t_decomp, res->t_rearr_c2i, res->t_write, t_disk_write,
+                res->t_rearr_i2c, res->t_read,
+                perf_bw(res->nbytes, res->t_rearr_c2i), perf_bw(res->nbytes, res->t_write),
+                perf_bw(res->nbytes, t_disk_write), perf_bw(res->nbytes, res->t_rearr_i2c),
+                perf_bw(res->nbytes, res->t_read));
+    }
+    else
+    {
+        fprintf(fp, "%s  {", first ? "" : ",\n");
+        perf_write_json_str(fp, "decomp", decomp);
+        perf_write_json_str(fp, "iotype", perf_val2name(iotype_names, iotype));
+        perf_write_json_str(fp, "rearr", perf_val2name(rearr_names, rearr));
+        fprintf(fp, "\"nprocs\": %d, \"niotasks\": %d, ", nprocs, niotasks);
+        perf_write_json_str(fp, "comm_type", perf_val2name(comm_type_names, ropts->comm_type));
+        perf_write_json_str(fp, "fcd", perf_val2name(fcd_names, ropts->fcd));
+        fprintf(fp, "\"hs\": %d, \"isend\": %d, \"max_pend_req\": %d, \"buf_limit\": %lld, ",
+                (int)ropts->comp2io.hs, (int)ropts->comp2io.isend,
+                ropts->comp2io.max_pend_req, buf_limit);
+        perf_write_json_str(fp, "type", perf_val2name(piotype_names, opts->piotype));
+        fprintf(fp, "\"nvars\": %d, \"nframes\": %d, \"data_mb\": %.3f,\n"
+                "   \"time\": {\"decomp\": %.6f, \"rearr_c2i\": %.6f, \"write\": %.6f, "
+                "\"disk_write\": %.6f, \"rearr_i2c\": %.6f, \"read\": %.6f},\n"
+                "   \"bw_mbps\": {\"rearr_c2i\": %.3f, \"write\": %.3f, \"disk_write\": %.3f, "
+                "\"rearr_i2c\": %.3f, \"read\": %.3f}}",
+                opts->nvars, opts->nframes, res->nbytes / PERF_MB,
+                res->t_decomp, res->t_rearr_c2i, res->t_write, t_disk_write,
+                res->t_rearr_i2c, res->t_read,
+                perf_bw(res->nbytes, res->t_rearr_c2i), perf_bw(res->nbytes, res->t_write),
+                perf_bw(res->nbytes, t_disk_write), perf_bw(res->nbytes, res->t_rearr_i2c),
+                perf_bw(res->nbytes, res->t_read));
+    }
+    fflush(fp);
+}
+
+int main(int argc, char *argv[])
+{
+    perf_opts_t opts;
+    MPI_Comm comm = MPI_COMM_WORLD;
+    int rank, nprocs;
+    FILE *fp = NULL;
+    int first = 1;
+    int ret = PIO_NOERR;
+
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &nprocs);
+
+    if (perf_parse_opts(argc, argv, &opts))
+    {
+        if (!rank)
+            perf_usage(argv[0]);
+        MPI_Finalize();
+        return 1;
+    }
+
+    if (opts.nniotasks == 0)
+    {
+        opts.niotasks[0] = nprocs;
+        opts.nniotasks = 1;
+    }
+
+    if (!rank)
+    {
+        fp = (strlen(opts.out_fname) > 0) ? fopen(opts.out_fname, "w") : stdout;
+        if (!fp)
+        {
+            fprintf(stderr, "Unable to open output file, %s\n", opts.out_fname);
+            MPI_Abort(comm, 1);
+        }
+        perf_write_header(fp, opts.out_fmt);
+    }
+
+    /* Default buffer size limit */
+    if (opts.nbuf_limits == 0)
+    {
+        PIO_Offset def_limit = PIOc_set_buffer_size_limit(0);
+        opts.buf_limits[0] = (long long)def_limit;
+        opts.nbuf_limits = 1;
+    }
+
+    for (int ni = 0; (ret == PIO_NOERR) && (ni < opts.nniotasks); ni++)
+    {
+        int niotasks = opts.niotasks[ni];
+        int stride;
+
+        if ((niotasks < 1) || (niotasks > nprocs))
+            continue;
+        stride = nprocs / niotasks;
+
+        for (int ir = 0; (ret == PIO_NOERR) && (ir < opts.nrearrs); ir++)
+        {
+            int rearr = opts.rearrs[ir];
+            int iosysid;
+
+            if ((ret = PIOc_Init_Intracomm(comm, niotasks, stride, 0, rearr, &iosysid)))
+                break;
+            PIOc_Set_IOSystem_Error_Handling(iosysid, PIO_RETURN_ERROR);
+
+            for (int df = 0; (ret == PIO_NOERR) && (df < opts.ndecomp_files); df++)
+            {
+                int ndims, *gdims = NULL;
+                PIO_Offset maplen = 0, *map = NULL;
+
+                if ((ret = perf_read_decomp(iosysid, opts.decomp_files[df], comm,
+                                            &ndims, &gdims, &maplen, &map)))
+                {
+                    if (!rank)
+                        fprintf(stderr, "Reading decomposition file, %s, failed (ret = %d)\n",
+                                opts.decomp_files[df], ret);
+                    break;
+                }
+
+                /* Sweep over all combinations of rearranger options,
+                 * buffer size limits and iotypes */
+                int ncombs = opts.ncomm_types * opts.nfcds * opts.nhs * opts.nisends *
+                             opts.nmax_pend_reqs * opts.nbuf_limits * opts.niotypes;
+                for (int c = 0; (ret == PIO_NOERR) && (c < ncombs); c++)
+                {
+                    int idx = c;
+                    int it = idx % opts.niotypes; idx /= opts.niotypes;
+                    int bl = idx % opts.nbuf_limits; idx /= opts.nbuf_limits;
+                    int mp = idx % opts.nmax_pend_reqs; idx /= opts.nmax_pend_reqs;
+                    int is = idx % opts.nisends; idx /= opts.nisends;
+                    int hs = idx % opts.nhs; idx /= opts.nhs;
+                    int fc = idx % opts.nfcds; idx /= opts.nfcds;
+                    int ct = idx;
+                    rearr_opt_t ropts = {
+                        opts.comm_types[ct], opts.fcds[fc],
+                        {opts.hs[hs], opts.isends[is], opts.max_pend_reqs[mp]},
+                        {opts.hs[hs], opts.isends[is], opts.max_pend_reqs[mp]}};
+                    perf_result_t res;
+
+                    if ((ret = PIOc_set_rearr_opts(iosysid, ropts.comm_type, ropts.fcd,
+                                                   ropts.comp2io.hs, ropts.comp2io.isend,
+                                                   ropts.comp2io.max_pend_req,
+                                                   ropts.io2comp.hs, ropts.io2comp.isend,
+                                                   ropts.io2comp.max_pend_req)))
+                        break;
+                    PIOc_set_buffer_size_limit(opts.buf_limits[bl]);
+
+                    if ((ret = perf_run(&opts, iosysid, opts.iotypes[it], rearr, ndims, gdims,
+                                        maplen, map, comm, &res)))
+                    {
+                        if (!rank)
+                            fprintf(stderr, "Benchmark failed for decomposition %s, iotype %s,"
+                                    " rearranger %s (ret = %d)\n", opts.decomp_files[df],
+                                    perf_val2name(iotype_names, opts.iotypes[it]),
+                                    perf_val2name(rearr_names, rearr), ret);
+                        break;
+                    }
+
+                    if (!rank)
+                    {
+                        perf_write_result(fp, &opts, first, opts.decomp_files[df],
+                                          opts.iotypes[it], rearr, nprocs, niotasks, &ropts,
+                                          opts.buf_limits[bl], &res);
+                        first = 0;
+                    }
+                }
+
+                free(gdims);
+                free(map);
+            }
+
+            PIOc_finalize(iosysid);
+        }
+    }
+
+    if (!rank)
+    {
+        perf_write_footer(fp, opts.out_fmt);
+        if (fp != stdout)
+            fclose(fp);
+    }
+
+    MPI_Finalize();
+
+    return (ret == PIO_NOERR) ? 0 : 1;
+}
@@ -7,6 +7,8 @@
 #include <map>
 #include <stdexcept>
 #include <regex>
+#include <future>
+#include <climits>
 #include <unistd.h> // usleep
 #include <mpi.h>
 #include <sys/types.h>
@@ -216,36 +218,50 @@ int adios_get_attr_a2(adios2::IO &bpIO, char *aname, std::string &atype, Attribu
 #ifdef ADIOS_TIMING
 static double time_read, time_write;
 static double time_temp_read, time_temp_write;
+static double bytes_read, bytes_write;
 
 void TimerInitialize_nm()
 {
     time_read = 0.0;
     time_write = 0.0;
+    bytes_read = 0.0;
+    bytes_write = 0.0;
 }
 
 #define TimerStart(x) { time_temp_##x = MPI_Wtime(); }
 #define TimerStop(x) { time_##x += (MPI_Wtime() - time_temp_##x); }
+#define TimerAddBytes(x, n) { bytes_##x += (double)(n); }
 
 void TimerReport_nm(MPI_Comm comm)
 {
     int nproc, rank;
     double tr_sum, tr_max;
     double tw_sum, tw_max;
+    double br_sum, bw_sum;
     MPI_Comm_size(comm, &nproc);
     MPI_Comm_rank(comm, &rank);
     MPI_Reduce(&time_read, &tr_max, 1, MPI_DOUBLE, MPI_MAX, 0, comm);
     MPI_Reduce(&time_read, &tr_sum, 1, MPI_DOUBLE, MPI_SUM, 0, comm);
     MPI_Reduce(&time_write, &tw_max, 1, MPI_DOUBLE, MPI_MAX, 0, comm);
     MPI_Reduce(&time_write, &tw_sum, 1, MPI_DOUBLE, MPI_SUM, 0, comm);
+    MPI_Reduce(&bytes_read, &br_sum, 1, MPI_DOUBLE, MPI_SUM, 0, comm);
+    MPI_Reduce(&bytes_write, &bw_sum, 1, MPI_DOUBLE, MPI_SUM, 0, comm);
 
     if (!rank && debug_out)
     {
-        cout << "Timing information:     Max     Sum of all\n";
+        /* Reads of step N+1 overlap the writes of step N, so the
+         * read and write times can add up to more than the elapsed time */
+        const double MB = 1024.0 * 1024.0;
+        cout << "Timing information:     Max     Sum of all    Data (MB)  Throughput (MB/s)\n";
         cout.precision(2);
         cout << "ADIOS read time   = " << std::fixed << std::setw(8) << tr_max << "s "
-             << std::setw(8) << tr_sum << "s\n";
+             << std::setw(8) << tr_sum << "s "
+             << std::setw(12) << br_sum / MB << " "
+             << std::setw(12) << ((tr_max > 0) ? (br_sum / MB / tr_max) : 0.0) << "\n";
         cout << "PIO  write time   = " << std::fixed << std::setw(8) << tw_max << "s "
-             << std::setw(8) << tw_sum << "s\n";
+             << std::setw(8) << tw_sum << "s "
+             << std::setw(12) << bw_sum / MB << " "
+             << std::setw(12) << ((tw_max > 0) ? (bw_sum / MB / tw_max) : 0.0) << "\n";
     }
 }
 
@@ -255,6 +271,7 @@ void TimerInitialize_nm() {}
 
 #define TimerStart(x) {}
 #define TimerStop(x) {}
+#define TimerAddBytes(x, n) {}
 
 void TimerReport_nm(MPI_Comm comm) {}
 
@@ -263,6 +280,18 @@ void TimerFinalize_nm() {}
 
 void SetDebugOutput(int val) { debug_out = val; }
 
+/* Read the next step of a darray variable in a helper thread, while the
+ * current step is written out with PIO. The helper thread only makes
+ * ADIOS calls (on engines opened on MPI_COMM_SELF), so MPI needs to be
+ * initialized with at least MPI_THREAD_FUNNELED */
+static bool UseReadThread_nm()
+{
+    int provided = MPI_THREAD_SINGLE;
+    MPI_Query_thread(&provided);
+
+    return (provided >= MPI_THREAD_FUNNELED);
+}
+
 struct Dimension
 {
     int dimid;
@@ -723,37 +752,6 @@ Decomposition ProcessOneDecomposition(IOVector &bpIO, EngineVector &bpReader, in
     return Decomposition{BP2PIO_ERROR, BP2PIO_ERROR};
 }
 
-DecompositionMap ProcessDecompositions(IOVector &bpIO, EngineVector &bpReader, int ncid,
-                                       const std::vector<int>& wfiles,
-                                       int iosysid, MPI_Comm comm,
-                                       int mpirank, int nproc)
-{
-    DecompositionMap decomp_map;
-    std::map<std::string, adios2::Params> a2_vi = bpIO[0].AvailableVariables();
-
-    for (std::map<std::string, adios2::Params>::iterator a2_iter = a2_vi.begin(); a2_iter != a2_vi.end(); ++a2_iter)
-    {
-        string v = a2_iter->first;
-        if (v.find("/__pio__/decomp/") != string::npos)
-        {
-            string decompname = v.substr(16); // Skip by strlen("/__pio__/decomp/")
-            if (!mpirank && debug_out)
-                cout << "Process decomposition " << decompname << endl;
-
-            Decomposition d = ProcessOneDecomposition(bpIO, bpReader, ncid, (char*)a2_iter->first.c_str(),
-                                                      wfiles, iosysid, mpirank, nproc, comm);
-            if (d.ioid == BP2PIO_ERROR)
-            {
-                throw std::runtime_error("ProcessDecompositions failed.");
-            }
-            decomp_map[decompname] = d;
-        }
-        FlushStdout_nm(comm);
-    }
-
-    return decomp_map;
-}
-
 Decomposition GetNewDecomposition(DecompositionMap& decompmap,
                                   const string &decompname,
                                   IOVector &bpIO, EngineVector &bpReader, int ncid,
@@ -1606,49 +1604,178 @@ int ConvertVariableTimedPutVar(IOVector &bpIO, EngineVector &bpReader,
     return BP2PIO_ERROR;
 }
 
+/* Data of one step (frame) of a darray variable, read from the BP
+ * files assigned to this process */
 template <class T>
-int adios2_ConvertVariableDarray(adios2::Variable<T> *v_base, std::vector<T> v_value,
-                                 IOVector &bpIO, EngineVector &bpReader, std::string varname,
-                                 int ncid, Variable& var,
-                                 const std::vector<int>& wfiles,
-                                 DecompositionMap& decomp_map,
-                                 int nblocks_per_step, int iosysid,
-                                 MPI_Comm comm, int mpirank, int nproc, int mem_opt)
+struct DarrayStep
 {
-    int ierr = BP2PIO_NOERR, err_val = 0, err_cnt = 0;
-    int ret = PIO_NOERR;
+    /* The step (frame) index */
+    int ts;
 
-    /* Calculate how many records/steps we have for this variable */
-    int nsteps = 1;
-    int ts = 0; /* Loop from ts to nsteps, below ts may become the last step */
+    /* Number of elements read by this process for this step */
+    uint64_t nelems;
 
-    /* Compute the total number of blocks */
-    int l_nblocks = 0;
-    int g_nblocks = 0;
-    for (size_t i = 1; i <= wfiles.size(); i++)
+    /* Contiguous data buffer passed to PIOc_write_darray(). The blocks
+     * are read directly into this buffer (no per-block copies) */
+    std::vector<T> data;
+
+    /* Fill value for this step (empty if no fill value was written) */
+    std::vector<T> fillval;
+
+    /* BP2PIO_NOERR if all reads for this step succeeded */
+    int ierr;
+};
+
+/* Issue deferred Gets for all blocks of step "step.ts" of varname in the
+ * BP files assigned to this process, and complete them with one
+ * PerformGets() per file. This function only makes ADIOS calls, so it can
+ * run in a helper thread while the main thread writes the previous step
+ * with PIO.
+ * blocks_info: BlocksInfo() of varname for each file (index 0 is unused)
+ * has_fillval: true if a fill value was written for this step
+ */
+template <class T>
+void adios2_ReadDarrayStep(IOVector &bpIO, EngineVector &bpReader,
+                           const std::string &varname,
+                           const std::vector<std::vector<typename adios2::Variable<T>::Info> > &blocks_info,
+                           int nsteps, bool has_fillval, DarrayStep<T> &step)
+{
+    char fillval_varname[PIO_MAX_NAME];
+    sprintf(fillval_varname, "fillval_id/%s", varname.c_str());
+
+    step.ierr = BP2PIO_NOERR;
+    step.nelems = 0;
+    step.fillval.clear();
+
+    try
     {
-        try
+        TimerStart(read);
+
+        /* Size the contiguous buffer for this step */
+        for (size_t i = 1; i < blocks_info.size(); i++)
         {
-            *v_base = bpIO[i].InquireVariable<T>(varname);
-            const auto vb_blocks = bpReader[i].BlocksInfo(*v_base, 0);
-            l_nblocks += vb_blocks.size();
+            size_t l_nwriters = blocks_info[i].size() / nsteps;
+            for (size_t j = 0; j < l_nwriters; j++)
+            {
+                size_t blockid = j * nsteps + step.ts;
+                if (blockid < blocks_info[i].size())
+                    step.nelems += blocks_info[i][blockid].Count[0];
+            }
         }
-        catch (const std::exception &e)
+
+        /* Allocate +1 to prevent data() from returning NULL. Otherwise, read/write operations fail */
+        /* nelems may be 0, when some processes do not have any data */
+        step.data.resize(step.nelems + 1);
+
+        uint64_t offset = 0;
+        for (size_t i = 1; i < blocks_info.size(); i++)
         {
-            ierr = BP2PIO_ERROR;
-            break;
+            size_t l_nwriters = blocks_info[i].size() / nsteps;
+            if (l_nwriters == 0)
+                continue;
+
+            adios2::Variable<T> v_var = bpIO[i].InquireVariable<T>(varname);
+            for (size_t j = 0; j < l_nwriters; j++)
+            {
+                size_t blockid = j * nsteps + step.ts;
+                if (blockid >= blocks_info[i].size())
+                    continue;
+
+                v_var.SetBlockSelection(blockid);
+                v_var.SetSelection({blocks_info[i][blockid].Start, blocks_info[i][blockid].Count});
+                bpReader[i].Get(v_var, step.data.data() + offset, adios2::Mode::Deferred);
+
+                if (has_fillval && step.fillval.empty())
+                {
+                    adios2::Variable<T> f_var = bpIO[i].InquireVariable<T>(fillval_varname);
+                    f_var.SetBlockSelection(blockid);
+                    step.fillval.resize(1);
+                    bpReader[i].Get(f_var, step.fillval.data(), adios2::Mode::Deferred);
+                }
+
+                offset += blocks_info[i][blockid].Count[0];
+            }
+
+            bpReader[i].PerformGets();
         }
-        catch (...)
+
+        /* No local blocks for this step: all writers write the fill value
+         * for every step, so read it from the first BP file */
+        if (has_fillval && step.fillval.empty())
         {
-            ierr = BP2PIO_ERROR;
-            break;
+            adios2::Variable<T> f_var = bpIO[0].InquireVariable<T>(fillval_varname);
+            if (f_var && (size_t)step.ts < bpReader[0].BlocksInfo(f_var, 0).size())
+            {
+                f_var.SetBlockSelection(step.ts);
+                step.fillval.resize(1);
+                bpReader[0].Get(f_var, step.fillval.data(), adios2::Mode::Sync);
+            }
         }
+
+        TimerStop(read);
+        TimerAddBytes(read, step.nelems * sizeof(T));
     }
-    ERROR_CHECK_RETURN(ierr, err_val, err_cnt, comm)
+    catch (const std::exception &e)
+    {
+        step.ierr = BP2PIO_ERROR;
+    }
+    catch (...)
+    {
+        step.ierr = BP2PIO_ERROR;
+    }
+}
 
-    MPI_Allreduce(&l_nblocks, &g_nblocks, 1, MPI_INT, MPI_SUM, comm);
+/* Get the decomposition for decomp_id with PIO type nctype, creating it
+ * (collectively) on first use. Decompositions are cached in decomp_map
+ * and reused across steps and variables */
+Decomposition GetDecomposition(DecompositionMap& decomp_map, int decomp_id, int nctype,
+                               IOVector &bpIO, EngineVector &bpReader, int ncid,
+                               const std::vector<int>& wfiles, int iosysid,
+                               int mpirank, int nproc, MPI_Comm comm)
+{
+    char decompname[PIO_MAX_NAME];
+    sprintf(decompname, "%d", decomp_id);
 
-    nsteps = g_nblocks / nblocks_per_step;
+    Decomposition decomp;
+    auto it = decomp_map.find(decompname);
+    if (it == decomp_map.end())
+    {
+        char decomp_varname[PIO_MAX_NAME];
+        sprintf(decomp_varname, "/__pio__/decomp/%d", decomp_id);
+        decomp = ProcessOneDecomposition(bpIO, bpReader, ncid, decomp_varname, wfiles,
+                                         iosysid, mpirank, nproc, comm);
+        if (decomp.ioid == BP2PIO_ERROR)
+            return decomp;
+        decomp_map[decompname] = decomp;
+    }
+    else
+    {
+        decomp = it->second;
+    }
+
+    if (decomp.piotype != nctype)
+    {
+        /* Type conversion may happened at writing. Now we make a new decomposition for this nctype */
+        decomp = GetNewDecomposition(decomp_map, decompname, bpIO, bpReader,
+                                     ncid, wfiles, nctype, iosysid, mpirank, nproc, comm);
+    }
+
+    return decomp;
+}
+
+template <class T>
+int adios2_ConvertVariableDarray(IOVector &bpIO, EngineVector &bpReader, std::string varname,
+                                 int ncid, Variable& var,
+                                 const std::vector<int>& wfiles,
+                                 DecompositionMap& decomp_map,
+                                 int nblocks_per_step, int g_nblocks, int iosysid,
+                                 MPI_Comm comm, int mpirank, int nproc)
+{
+    int ierr = BP2PIO_NOERR, err_val = 0, err_cnt = 0;
+    int ret = PIO_NOERR;
+
+    /* Calculate how many records/steps we have for this variable */
+    int nsteps = g_nblocks / nblocks_per_step;
     if (g_nblocks != nsteps * nblocks_per_step)
     {
         if (debug_out)
@@ -1659,213 +1786,191 @@ int adios2_ConvertVariableDarray(adios2::Variable<T> *v_base, std::vector<T> v_v
                  << endl;
     }
 
-    /* Different decompositions at different frames */
+    if (nsteps == 0)
+        return BP2PIO_NOERR;
+
     char decomp_varname[PIO_MAX_NAME];
     char frame_varname[PIO_MAX_NAME];
-    char fillval_varname[PIO_MAX_NAME];
-    char decompname[PIO_MAX_NAME];
     sprintf(decomp_varname, "decomp_id/%s", varname.c_str());
     sprintf(frame_varname, "frame_id/%s", varname.c_str());
-    sprintf(fillval_varname, "fillval_id/%s", varname.c_str());
-    int decomp_id, frame_id, fillval_exist;
-    char fillval_id[PIO_MAX_NAME];
 
-    // TAHSIN -- THIS IS GETTING CONFUSING. NEED TO THINK ABOUT time steps.
-    for (; ts < nsteps; ++ts)
+    /* Different decompositions at different frames: read the (tiny)
+     * decomp/frame ids of all steps with deferred Gets and agree on them
+     * with a single reduction, INT_MIN marks steps with no local blocks.
+     * l_ids[ts] is the decomp id and l_ids[nsteps + ts] the frame id */
+    std::vector<std::vector<typename adios2::Variable<T>::Info> > blocks_info(wfiles.size() + 1);
+    std::vector<int> l_ids(2 * nsteps, INT_MIN), g_ids(2 * nsteps);
+    std::vector<int> b_decomp_ids, b_frame_ids;
+    std::vector<int> b_steps;
+    try
     {
-        try
+        TimerStart(read);
+
+        for (size_t i = 1; i <= wfiles.size(); i++)
         {
-            /* Sum the sizes of blocks assigned to this process */
-            /* Compute the number of writers for each file from nsteps */
-            uint64_t nelems = 0;
-            int l_nwriters  = 0;
-            for (size_t i = 1; i <= wfiles.size(); i++)
-            {
-                *v_base = bpIO[i].InquireVariable<T>(varname);
-                const auto vb_blocks = bpReader[i].BlocksInfo(*v_base, 0);
-                l_nwriters = vb_blocks.size() / nsteps;
-                for (int j = 0; j < l_nwriters; j++)
-                {
-                    size_t blockid = j*nsteps + ts;
-                    if (blockid < vb_blocks.size())
-                        nelems += vb_blocks[blockid].Count[0];
-                }
-            }
+            adios2::Variable<T> v_var = bpIO[i].InquireVariable<T>(varname);
+            blocks_info[i] = bpReader[i].BlocksInfo(v_var, 0);
+        }
 
-            TimerStart(read);
+        size_t nlblocks = 0;
+        for (size_t i = 1; i <= wfiles.size(); i++)
+            nlblocks += blocks_info[i].size();
+
+        /* Reserve, the deferred Gets below hold pointers into these buffers */
+        b_decomp_ids.resize(nlblocks);
+        b_frame_ids.resize(nlblocks);
+        b_steps.resize(nlblocks);
 
-            /* Read local data for each file */
-            int elemsize = adios2_type_size_a2(v_base->Type());
-            assert(elemsize > 0);
-            /* Allocate +1 to prevent d.data() from returning NULL. Otherwise, read/write operations fail */
-            /* nelems may be 0, when some processes do not have any data */
-            std::vector<char> d((nelems + 1) * elemsize);
-            uint64_t offset = 0;
-            for (size_t i = 1; i <= wfiles.size(); i++)
+        size_t k = 0;
+        for (size_t i = 1; i <= wfiles.size(); i++)
+        {
+            size_t l_nwriters = blocks_info[i].size() / nsteps;
+            if (l_nwriters == 0)
+                continue;
+
+            adios2::Variable<int> d_var = bpIO[i].InquireVariable<int>(decomp_varname);
+            adios2::Variable<int> f_var = bpIO[i].InquireVariable<int>(frame_varname);
+            for (size_t j = 0; j < l_nwriters; j++)
             {
-                *v_base = bpIO[i].InquireVariable<T>(varname);
-                const auto vb_blocks = bpReader[i].BlocksInfo(*v_base, 0);
-                l_nwriters = vb_blocks.size() / nsteps;
-                for (int j = 0; j < l_nwriters; j++)
+                for (int ts = 0; ts < nsteps; ts++)
                 {
-                    size_t blockid = j*nsteps + ts;
-                    if (blockid < vb_blocks.size())
-                    {
-                        v_base->SetBlockSelection(blockid);
-                        v_base->SetSelection({vb_blocks[blockid].Start, vb_blocks[blockid].Count});
-                        bpReader[i].Get(*v_base, v_value, adios2::Mode::Sync);
-                        memcpy(d.data() + offset, v_value.data(), v_value.size()*elemsize);
-
-                        std::vector<int> v_tmp;
-                        adios2::Variable<int> v_var;
-                        v_var = bpIO[i].InquireVariable<int>(decomp_varname);
-                        v_var.SetBlockSelection(blockid);
-                        bpReader[i].Get(v_var, v_tmp, adios2::Mode::Sync);
-                        memcpy(&decomp_id, v_tmp.data(), sizeof(int));
-
-                        v_var = bpIO[i].InquireVariable<int>(frame_varname);
-                        v_var.SetBlockSelection(blockid);
-                        bpReader[i].Get(v_var, v_tmp, adios2::Mode::Sync);
-                        memcpy(&frame_id, v_tmp.data(), sizeof(int));
-
-                        /* Fix for NUM_FRAMES */
-                        if (!var.is_timed && frame_id >= 0)
-                            var.is_timed = true;
-
-                        if (decomp_id > 0)
-                        {
-                            adios2::Variable<T> v1_var = bpIO[i].InquireVariable<T>(fillval_varname);
-                            std::vector<T> v1_tmp;
-                            v1_var.SetBlockSelection(blockid);
-                            bpReader[i].Get(v1_var, v1_tmp, adios2::Mode::Sync);
-                            memcpy(fillval_id, v1_tmp.data(), v1_tmp.size()*sizeof(T));
-                            fillval_exist = 1;
-                        }
-                        else
-                        {
-                            decomp_id = -decomp_id;
-                            fillval_exist = 0;
-                        }
-                        offset += vb_blocks[blockid].Count[0] * elemsize;
-                    }
+                    size_t blockid = j * nsteps + ts;
+                    if (blockid >= blocks_info[i].size())
+                        continue;
+
+                    d_var.SetBlockSelection(blockid);
+                    bpReader[i].Get(d_var, &b_decomp_ids[k], adios2::Mode::Deferred);
+                    f_var.SetBlockSelection(blockid);
+                    bpReader[i].Get(f_var, &b_frame_ids[k], adios2::Mode::Deferred);
+                    b_steps[k++] = ts;
                 }
             }
+            bpReader[i].PerformGets();
+        }
 
-            TimerStop(read);
+        for (size_t b = 0; b < k; b++)
+        {
+            l_ids[b_steps[b]] = b_decomp_ids[b];
+            l_ids[nsteps + b_steps[b]] = b_frame_ids[b];
+        }
 
-            TimerStart(write);
+        TimerStop(read);
+    }
+    catch (const std::exception &e)
+    {
+        ierr = BP2PIO_ERROR;
+    }
+    catch (...)
+    {
+        ierr = BP2PIO_ERROR;
+    }
+    ERROR_CHECK_RETURN(ierr, err_val, err_cnt, comm)
 
-            Decomposition decomp;
-            if (mem_opt)
-            {
-                sprintf(decompname, "/__pio__/decomp/%d", decomp_id);
-                decomp = ProcessOneDecomposition(bpIO, bpReader, ncid, decompname, wfiles,
-                                                 iosysid, mpirank, nproc, comm);
-            }
-            else
-            {
-                sprintf(decompname, "%d", decomp_id);
-                decomp = decomp_map[decompname];
-            }
+    MPI_Allreduce(l_ids.data(), g_ids.data(), 2 * nsteps, MPI_INT, MPI_MAX, comm);
 
-            if (decomp.ioid == BP2PIO_ERROR)
-            {
-                ierr = BP2PIO_ERROR;
-                break;
-            }
+    /* Fix for NUM_FRAMES */
+    for (int ts = 0; ts < nsteps; ts++)
+    {
+        if (!var.is_timed && g_ids[nsteps + ts] >= 0)
+            var.is_timed = true;
+    }
 
-            if (decomp.piotype != var.nctype)
-            {
-                /* Type conversion may happened at writing. Now we make a new decomposition for this nctype */
-                if (mem_opt)
-                {
-                    ret = PIOc_freedecomp(iosysid, decomp.ioid);
-                    if (ret != PIO_NOERR)
-                    {
-                        ierr = BP2PIO_ERROR;
-                        break;
-                    }
+    /* Read step ts + 1 (deferred Gets, in a helper thread if MPI allows
+     * it) while step ts is being written out with PIO */
+    bool use_thread = UseReadThread_nm();
+    DarrayStep<T> steps[2];
+    std::future<void> prefetch;
 
-                    decomp = ProcessOneDecomposition(bpIO, bpReader, ncid, decompname, wfiles,
-                                                     iosysid, mpirank, nproc, comm, var.nctype);
-                }
-                else
-                {
-                    decomp = GetNewDecomposition(decomp_map, decompname, bpIO, bpReader,
-                                                 ncid, wfiles, var.nctype, iosysid, mpirank, nproc, comm);
-                }
-            }
+    steps[0].ts = 0;
+    adios2_ReadDarrayStep(bpIO, bpReader, varname, blocks_info, nsteps, (g_ids[0] > 0), steps[0]);
+
+    for (int ts = 0; ts < nsteps; ++ts)
+    {
+        DarrayStep<T> &cur = steps[ts % 2];
+        DarrayStep<T> &next = steps[(ts + 1) % 2];
 
-            if (decomp.ioid == BP2PIO_ERROR)
+        /* No process has any blocks for this step */
+        if (g_ids[ts] == INT_MIN)
+        {
+            if (ts + 1 < nsteps)
             {
-                ierr = BP2PIO_ERROR;
-                break;
+                next.ts = ts + 1;
+                adios2_ReadDarrayStep(bpIO, bpReader, varname, blocks_info, nsteps,
+                                      (g_ids[ts + 1] > 0), next);
             }
+            continue;
+        }
 
-            if (frame_id < 0)
-                frame_id = 0;
+        /* Decompositions are read from the BP files, so get (or create)
+         * it before the prefetch of the next step starts using the ADIOS
+         * engines */
+        TimerStart(write);
 
-            if (wfiles[0] < nblocks_per_step)
-            {
-                /* Different decompositions at different frames */
-                /* Note: this variable can have an unlimited or limited time dimension */
-                if (var.is_timed)
-                {
-                    ret = PIOc_setframe(ncid, var.nc_varid, frame_id);
-                    if (ret != PIO_NOERR)
-                    {
-                        ierr = BP2PIO_ERROR;
-                        break;
-                    }
-                }
+        int decomp_id = (g_ids[ts] > 0) ? g_ids[ts] : -g_ids[ts];
+        Decomposition decomp = GetDecomposition(decomp_map, decomp_id, var.nctype,
+                                                bpIO, bpReader, ncid, wfiles, iosysid,
+                                                mpirank, nproc, comm);
+        if (decomp.ioid == BP2PIO_ERROR)
+            ierr = BP2PIO_ERROR;
 
-                if (fillval_exist)
-                {
-                    ret = PIOc_write_darray(ncid, var.nc_varid, decomp.ioid, (PIO_Offset)nelems,
-                                            d.data(), fillval_id);
-                }
-                else
-                {
-                    ret = PIOc_write_darray(ncid, var.nc_varid, decomp.ioid, (PIO_Offset)nelems,
-                                            d.data(), NULL);
-                }
-            }
+        TimerStop(write);
 
-            if (ret != PIO_NOERR)
+        if (ts + 1 < nsteps)
+        {
+            next.ts = ts + 1;
+            if (use_thread)
             {
-                ierr = BP2PIO_ERROR;
-                break;
+                prefetch = std::async(std::launch::async,
+                                      adios2_ReadDarrayStep<T>, std::ref(bpIO), std::ref(bpReader),
+                                      std::cref(varname), std::cref(blocks_info), nsteps,
+                                      (g_ids[ts + 1] > 0), std::ref(next));
             }
+        }
 
-            if (mem_opt)
+        if (ierr == BP2PIO_NOERR)
+            ierr = cur.ierr;
+
+        int frame_id = g_ids[nsteps + ts];
+        if (frame_id < 0)
+            frame_id = 0;
+
+        if ((ierr == BP2PIO_NOERR) && (wfiles[0] < nblocks_per_step))
+        {
+            TimerStart(write);
+
+            /* Different decompositions at different frames */
+            /* Note: this variable can have an unlimited or limited time dimension */
+            if (var.is_timed)
             {
-                ret = PIOc_sync(ncid);
+                ret = PIOc_setframe(ncid, var.nc_varid, frame_id);
                 if (ret != PIO_NOERR)
-                {
                     ierr = BP2PIO_ERROR;
-                    break;
-                }
+            }
 
-                ret = PIOc_freedecomp(iosysid, decomp.ioid);
+            if (ierr == BP2PIO_NOERR)
+            {
+                ret = PIOc_write_darray(ncid, var.nc_varid, decomp.ioid, (PIO_Offset)cur.nelems,
+                                        cur.data.data(),
+                                        cur.fillval.empty() ? NULL : cur.fillval.data());
                 if (ret != PIO_NOERR)
-                {
                     ierr = BP2PIO_ERROR;
-                    break;
-                }
             }
 
             TimerStop(write);
+            TimerAddBytes(write, cur.nelems * sizeof(T));
         }
-        catch (const std::exception &e)
+
+        if (ts + 1 < nsteps)
         {
-            ierr = BP2PIO_ERROR;
-            break;
+            if (use_thread)
+                prefetch.get();
+            else
+                adios2_ReadDarrayStep(bpIO, bpReader, varname, blocks_info, nsteps,
+                                      (g_ids[ts + 1] > 0), next);
         }
-        catch (...)
-        {
-            ierr = BP2PIO_ERROR;
+
+        if (ierr != BP2PIO_NOERR)
             break;
-        }
     }
     ERROR_CHECK_RETURN(ierr, err_val, err_cnt, comm)
 
@@ -1877,8 +1982,8 @@ int ConvertVariableDarray(IOVector &bpIO, EngineVector &bpReader,
                           int ncid, Variable& var,
                           const std::vector<int>& wfiles,
                           DecompositionMap& decomp_map,
-                          int nblocks_per_step, int iosysid,
-                          MPI_Comm comm, int mpirank, int nproc, int mem_opt)
+                          int nblocks_per_step, int g_nblocks, int iosysid,
+                          MPI_Comm comm, int mpirank, int nproc)
 {
     std::string v_type = bpIO[0].VariableType(varname);
     if (v_type.empty())
@@ -1889,12 +1994,9 @@ int ConvertVariableDarray(IOVector &bpIO, EngineVector &bpReader,
 #define declare_template_instantiation(T) \
     else if (v_type == adios2::GetType<T>()) \
     { \
-        adios2::Variable<T> v_base; \
-        std::vector<T> v_value; \
-        return adios2_ConvertVariableDarray(&v_base, v_value, \
-                                            bpIO, bpReader, varname, ncid, var, \
-                                            wfiles, decomp_map, nblocks_per_step, iosysid, \
-                                            comm, mpirank, nproc, mem_opt); \
+        return adios2_ConvertVariableDarray<T>(bpIO, bpReader, varname, ncid, var, \
+                                               wfiles, decomp_map, nblocks_per_step, g_nblocks, \
+                                               iosysid, comm, mpirank, nproc); \
     }
 
     ADIOS2_FOREACH_ATTRIBUTE_TYPE_1ARG(declare_template_instantiation)
@@ -1904,6 +2006,71 @@ int ConvertVariableDarray(IOVector &bpIO, EngineVector &bpReader,
     return BP2PIO_ERROR;
 }
 
+/* Get the number of blocks of varname in the BP files assigned to this process */
+template <class T>
+int adios2_GetNumBlocks(IOVector &bpIO, EngineVector &bpReader,
+                        const std::vector<int>& wfiles, const std::string &varname)
+{
+    int l_nblocks = 0;
+    for (size_t i = 1; i <= wfiles.size(); i++)
+    {
+        adios2::Variable<T> v_var = bpIO[i].InquireVariable<T>(varname);
+        l_nblocks += bpReader[i].BlocksInfo(v_var, 0).size();
+    }
+
+    return l_nblocks;
+}
+
+/* Count the total number of blocks (across all BP files) of each of the
+ * darray variables in varnames, using a single reduction for all the
+ * variables (instead of one reduction per variable) */
+int GetGlobalNumBlocks(IOVector &bpIO, EngineVector &bpReader,
+                       const std::vector<int>& wfiles,
+                       const std::vector<std::string> &varnames,
+                       std::vector<int> &g_nblocks, MPI_Comm comm)
+{
+    int ierr = BP2PIO_NOERR, err_val = 0, err_cnt = 0;
+    std::vector<int> l_nblocks(varnames.size(), 0);
+
+    try
+    {
+        for (size_t v = 0; v < varnames.size(); v++)
+        {
+            std::string v_type = bpIO[0].VariableType(varnames[v]);
+            if (v_type.empty())
+            {
+                ierr = BP2PIO_ERROR;
+                break;
+            }
+
+#define declare_template_instantiation(T) \
+            else if (v_type == adios2::GetType<T>()) \
+            { \
+                l_nblocks[v] = adios2_GetNumBlocks<T>(bpIO, bpReader, wfiles, varnames[v]); \
+            }
+
+            ADIOS2_FOREACH_ATTRIBUTE_TYPE_1ARG(declare_template_instantiation)
+
+#undef declare_template_instantiation
+        }
+    }
+    catch (const std::exception &e)
+    {
+        ierr = BP2PIO_ERROR;
+    }
+    catch (...)
+    {
+        ierr = BP2PIO_ERROR;
+    }
+    ERROR_CHECK_RETURN(ierr, err_val, err_cnt, comm)
+
+    g_nblocks.resize(varnames.size());
+    if (!varnames.empty())
+        MPI_Allreduce(l_nblocks.data(), g_nblocks.data(), (int)varnames.size(), MPI_INT, MPI_SUM, comm);
+
+    return BP2PIO_NOERR;
+}
+
 /*
  * Assumes a BP folder with name "infilename.dir" and
  * all the files in the folder are bp files. It also
@@ -1960,13 +2127,223 @@ std::string ExtractPathname(const std::string &pathname)
     }
 }
 
+/* Open the BP files in wfiles (and the first BP file, at index 0, that
+ * contains all the variable and attribute definitions) for reading.
+ * io_tag is used to create unique ADIOS IO names for these files */
+int OpenBPFiles(adios2::ADIOS &adios, const string &infilepath,
+                const std::vector<int>& wfiles, const string &io_tag,
+                IOVector &bpIO, EngineVector &bpReader,
+                string &err_msg, int mpirank)
+{
+    std::string basefilename = ExtractFilename(infilepath);
+
+    bpIO.resize(wfiles.size() + 1);
+    bpReader.resize(wfiles.size() + 1);
+
+    for (size_t i = 0; i <= wfiles.size(); i++)
+    {
+        string fileid_str = (i == 0) ? string("0") : std::to_string(wfiles[i - 1]);
+        string filei = infilepath + ".dir/" + basefilename + "." + fileid_str;
+        if (i > 0 && debug_out)
+            cout << "myrank " << mpirank << " file: " << filei << endl;
+
+        try
+        {
+            bpIO[i] = adios.DeclareIO(filei + io_tag + "_" + std::to_string(i));
+            bpReader[i] = bpIO[i].Open(filei, adios2::Mode::Read, MPI_COMM_SELF);
+        }
+        catch (const std::exception &e)
+        {
+            err_msg = e.what();
+            return BP2PIO_ERROR;
+        }
+        catch (...)
+        {
+            err_msg = "Unknown exception.";
+            return BP2PIO_ERROR;
+        }
+    }
+
+    return BP2PIO_NOERR;
+}
+
+/* Free all decompositions in decomp_map */
+int FreeDecompositions(DecompositionMap& decomp_map, int iosysid)
+{
+    int ierr = BP2PIO_NOERR;
+    for (std::map<std::string, Decomposition>::iterator it = decomp_map.begin();
+         it != decomp_map.end(); ++it)
+    {
+        if (PIOc_freedecomp(iosysid, it->second.ioid) != PIO_NOERR)
+            ierr = BP2PIO_ERROR;
+    }
+    decomp_map.clear();
+
+    return ierr;
+}
+
+/* Convert the darray variables, darray_vars, to the (open) output file,
+ * ncid. Decompositions are created on first use and cached in decomp_map
+ * across variables, unless mem_opt is set (then they are only cached
+ * across the steps of a variable) */
+int ConvertDarrayVariables(IOVector &bpIO, EngineVector &bpReader,
+                           const std::vector<std::string> &darray_vars,
+                           int ncid, VariableMap &vars_map,
+                           const std::vector<int>& wfiles,
+                           DecompositionMap& decomp_map,
+                           int nblocks_per_step, int iosysid,
+                           MPI_Comm comm, int mpirank, int nproc, int mem_opt)
+{
+    int ierr = BP2PIO_NOERR, err_val = 0, err_cnt = 0;
+    int ret = PIO_NOERR;
+
+    std::vector<int> g_nblocks;
+    ierr = GetGlobalNumBlocks(bpIO, bpReader, wfiles, darray_vars, g_nblocks, comm);
+    ERROR_CHECK_THROW(ierr, err_val, err_cnt, comm, "GetGlobalNumBlocks failed.")
+
+    for (size_t v = 0; v < darray_vars.size(); v++)
+    {
+        /* Variable was written with pio_write_darray() with a decomposition */
+        if (!mpirank && debug_out)
+            cout << "Convert variable: " << darray_vars[v] << endl;
+
+        if (debug_out)
+        {
+            printf("ConvertVariableDarray: %d\n", mpirank);
+            fflush(stdout);
+        }
+
+        DecompositionMap var_decomp_map;
+        ierr = ConvertVariableDarray(bpIO, bpReader, darray_vars[v], ncid, vars_map[darray_vars[v]],
+                                     wfiles, mem_opt ? var_decomp_map : decomp_map,
+                                     nblocks_per_step, g_nblocks[v], iosysid, comm, mpirank, nproc);
+        ERROR_CHECK_SINGLE_THROW(ierr, "ConvertVariableDarray failed.")
+
+        if (mem_opt)
+        {
+            TimerStart(write);
+
+            ret = PIOc_sync(ncid);
+            if (ret != PIO_NOERR)
+                ierr = BP2PIO_ERROR;
+            ERROR_CHECK_THROW(ierr, err_val, err_cnt, comm, "PIOc_sync failed.");
+
+            ierr = FreeDecompositions(var_decomp_map, iosysid);
+            ERROR_CHECK_THROW(ierr, err_val, err_cnt, comm, "PIOc_freedecomp failed.");
+
+            TimerStop(write);
+        }
+
+        FlushStdout_nm(comm);
+    }
+
+    return BP2PIO_NOERR;
+}
+
+/* Split comm into nvar_groups groups and convert the darray variables
+ * round-robin across the groups. Each group initializes its own I/O
+ * system, reads all the BP files (distributed across the processes in
+ * the group) and reopens the (already defined) output file to write
+ * its variables, so that the groups convert variables concurrently.
+ * Only used with PnetCDF, where the groups can write disjoint variables
+ * of the same file without any header changes.
+ */
+int ConvertDarrayVariablesInGroups(adios2::ADIOS &adios, const string &infilepath,
+                                   const string &outfilename, int pio_iotype,
+                                   const std::vector<std::string> &darray_vars,
+                                   VariableMap &vars_map, int n_bp_files,
+                                   int nblocks_per_step, int nvar_groups,
+                                   MPI_Comm comm, int mpirank, int nproc, int mem_opt)
+{
+    int ierr = BP2PIO_NOERR, err_val = 0, err_cnt = 0;
+    int ret = PIO_NOERR;
+    string err_msg = "No errors";
+
+    /* Contiguous ranks in comm form a group */
+    int group = (int)(((long long)mpirank * nvar_groups) / nproc);
+    MPI_Comm gcomm;
+    int grank, gnproc;
+    MPI_Comm_split(comm, group, mpirank, &gcomm);
+    MPI_Comm_rank(gcomm, &grank);
+    MPI_Comm_size(gcomm, &gnproc);
+
+    if (!mpirank && debug_out)
+        cout << "Converting darray variables using " << nvar_groups << " groups of processes\n";
+
+    int giosysid = InitPIO(gcomm, grank, gnproc);
+    if (giosysid == BP2PIO_ERROR)
+        ierr = BP2PIO_ERROR;
+    ERROR_CHECK_THROW(ierr, err_val, err_cnt, comm, "InitPIO error.")
+
+    std::vector<int> wfiles = AssignWriteRanks(n_bp_files, gcomm, grank, gnproc);
+
+    IOVector bpIO;
+    EngineVector bpReader;
+    ierr = OpenBPFiles(adios, infilepath, wfiles, "_g" + std::to_string(group),
+                       bpIO, bpReader, err_msg, grank);
+    ERROR_CHECK_THROW(ierr, err_val, err_cnt, comm, err_msg)
+
+    int ncid = -1;
+    ret = PIOc_openfile(giosysid, &ncid, &pio_iotype, outfilename.c_str(), PIO_WRITE);
+    if (ret != PIO_NOERR)
+        ierr = BP2PIO_ERROR;
+    ERROR_CHECK_THROW(ierr, err_val, err_cnt, comm, "Could not open output file.");
+
+    std::vector<std::string> group_vars;
+    for (size_t v = group; v < darray_vars.size(); v += nvar_groups)
+        group_vars.push_back(darray_vars[v]);
+
+    DecompositionMap decomp_map;
+    try
+    {
+        ierr = ConvertDarrayVariables(bpIO, bpReader, group_vars, ncid, vars_map, wfiles,
+                                      decomp_map, nblocks_per_step, giosysid,
+                                      gcomm, grank, gnproc, mem_opt);
+    }
+    catch (const std::exception &e)
+    {
+        err_msg = e.what();
+        ierr = BP2PIO_ERROR;
+    }
+    catch (...)
+    {
+        err_msg = "Unknown exception.";
+        ierr = BP2PIO_ERROR;
+    }
+    ERROR_CHECK_THROW(ierr, err_val, err_cnt, comm, err_msg)
+
+    TimerStart(write);
+
+    ierr = FreeDecompositions(decomp_map, giosysid);
+    ERROR_CHECK_THROW(ierr, err_val, err_cnt, comm, "PIOc_freedecomp failed.");
+
+    ret = PIOc_closefile(ncid);
+    if (ret != PIO_NOERR)
+        ierr = BP2PIO_ERROR;
+    ERROR_CHECK_THROW(ierr, err_val, err_cnt, comm, "PIOc_closefile failed.");
+
+    ret = PIOc_finalize(giosysid);
+    if (ret != PIO_NOERR)
+        ierr = BP2PIO_ERROR;
+    ERROR_CHECK_THROW(ierr, err_val, err_cnt, comm, "PIOc_finalize failed.");
+
+    TimerStop(write);
+
+    for (size_t i = 0; i < bpReader.size(); i++)
+        bpReader[i].Close();
+
+    MPI_Comm_free(&gcomm);
+
+    return BP2PIO_NOERR;
+}
+
 int ConvertBPFile(const string &infilepath, const string &outfilename,
                     int pio_iotype, int iosysid,
-                    MPI_Comm comm, int mpirank, int nproc, int mem_opt)
+                    MPI_Comm comm, int mpirank, int nproc, int mem_opt,
+                    int nvar_groups)
 {
     int ierr = BP2PIO_NOERR, err_val = 0, err_cnt = 0;
     string err_msg = "No errors";
-    int num_infiles = 0;
     int ncid = -1;
     int n_bp_writers;
     int ret = PIO_NOERR;
@@ -1976,14 +2353,6 @@ int ConvertBPFile(const string &infilepath, const string &outfilename,
 
     try
     {
-        /*
-         * This assumes we are running the program in the same folder where
-         * the BP folder exists.
-         *
-         */
-        std::string foldername   = ExtractPathname(infilepath);
-        std::string basefilename = ExtractFilename(infilepath);
-
         /*
          * Get the number of files in BP folder.
          * This operation assumes that the BP folder contains only the
@@ -2007,6 +2376,20 @@ int ConvertBPFile(const string &infilepath, const string &outfilename,
         }
         ERROR_CHECK_THROW(ierr, err_val, err_cnt, comm, err_msg)
 
+        /* Concurrent writes, to the same file, from multiple groups is
+         * only supported with PnetCDF */
+        if (nvar_groups > nproc)
+            nvar_groups = nproc;
+        if ((nvar_groups > 1) && (pio_iotype != PIO_IOTYPE_PNETCDF))
+        {
+            if (!mpirank)
+                cout << "WARNING: Converting variables in multiple groups is only supported "
+                     << "with the PnetCDF iotype, using a single group\n";
+            nvar_groups = 1;
+        }
+        if (nvar_groups < 1)
+            nvar_groups = 1;
+
         /* Number of BP file writers != number of converter processes here */
         std::vector<int> wfiles;
         wfiles = AssignWriteRanks(n_bp_files, comm, mpirank, nproc);
@@ -2016,29 +2399,14 @@ int ConvertBPFile(const string &infilepath, const string &outfilename,
                 printf("Myrank: %d File id: %d\n", mpirank, nb);
         }
 
-        num_infiles = wfiles.size() + 1; // infile[0] is opened by all processors
-
-        /* Now allocate IO and Engine for each file */
-        std::vector<adios2::IO> bpIO(num_infiles);
-        std::vector<adios2::Engine> bpReader(num_infiles);
-
-        string file0 = infilepath + ".dir/" + basefilename + ".0";
-
-        try
-        {
-            bpIO[0] = adios.DeclareIO(file0 + "_0");
-            bpReader[0] = bpIO[0].Open(file0, adios2::Mode::Read, MPI_COMM_SELF);
-        }
-        catch (const std::exception &e)
-        {
-            err_msg =  e.what();
-            ierr = BP2PIO_ERROR;
-        }
-        catch (...)
-        {
-            err_msg = "Unknown exception.";
-            ierr = BP2PIO_ERROR;
-        }
+        /*
+         * Open the BP files.
+         * basefilename.bp.0 is opened by all the nodes. It contains all of the variables
+         * and attributes. Each node then opens the files assigned to that node.
+         */
+        IOVector bpIO;
+        EngineVector bpReader;
+        ierr = OpenBPFiles(adios, infilepath, wfiles, "", bpIO, bpReader, err_msg, mpirank);
         ERROR_CHECK_THROW(ierr, err_val, err_cnt, comm, err_msg)
 
         try
@@ -2072,41 +2440,6 @@ int ConvertBPFile(const string &infilepath, const string &outfilename,
                      << " n_bp_files: " << n_bp_files << endl;
         }
 
-        /*
-         * Open the BP files.
-         * basefilename.bp.0 is opened by all the nodes. It contains all of the variables
-         * and attributes. Each node then opens the files assigned to that node.
-         */
-        for (size_t i = 1; i <= wfiles.size(); i++)
-        {
-            char ss[PIO_MAX_NAME];
-            sprintf(ss, "%d", wfiles[i - 1]);
-            string fileid_str(ss);
-
-            string filei = infilepath + ".dir/" + basefilename + "." + fileid_str;
-            if (debug_out)
-                cout << "myrank " << mpirank << " file: " << filei << endl;
-
-            try
-            {
-                bpIO[i] = adios.DeclareIO(filei + "_" + std::to_string(i));
-                bpReader[i] = bpIO[i].Open(filei, adios2::Mode::Read, MPI_COMM_SELF);
-            }
-            catch (const std::exception &e)
-            {
-                err_msg = e.what();
-                ierr = BP2PIO_ERROR;
-                break;
-            }
-            catch (...)
-            {
-                err_msg = "Unknown exception.";
-                ierr = BP2PIO_ERROR;
-                break;
-            }
-        }
-        ERROR_CHECK_THROW(ierr, err_val, err_cnt, comm, err_msg)
-
         TimerStart(write);
 
         /* Create output file */
@@ -2121,10 +2454,8 @@ int ConvertBPFile(const string &infilepath, const string &outfilename,
 
         TimerStop(write);
 
-        /* First process decompositions */
+        /* Decompositions are created when first used by a variable */
         DecompositionMap decomp_map;
-        if (!mem_opt)
-            decomp_map = ProcessDecompositions(bpIO, bpReader, ncid, wfiles, iosysid, comm, mpirank, nproc);
 
         /* Process the global fillmode */
         ierr = ProcessGlobalFillmode(bpIO, bpReader, ncid, comm);
@@ -2146,18 +2477,18 @@ int ConvertBPFile(const string &infilepath, const string &outfilename,
         ERROR_CHECK_THROW(ierr, err_val, err_cnt, comm, "PIOc_enddef failed.");
 
         /* For each variable, read in the data
-         * with ADIOS then write it out with PIO
+         * with ADIOS then write it out with PIO.
+         * Variables written with PIOc_put_var* are converted first, and
+         * the darray variables are then converted together (sharing the
+         * cached decompositions)
          */
+        std::vector<std::string> darray_vars;
         std::map<std::string, adios2::Params> a2_vi = bpIO[0].AvailableVariables();
         for (std::map<std::string, adios2::Params>::iterator a2_iter = a2_vi.begin(); a2_iter != a2_vi.end(); ++a2_iter)
         {
             string v = a2_iter->first;
             if (v.find("/__") == string::npos)
             {
-                /* For each variable, read with ADIOS then write with PIO */
-                if (!mpirank && debug_out)
-                    cout << "Convert variable: " << v << endl;
-
                 if (v.find("decomp_id/") == string::npos &&
                     v.find("frame_id/") == string::npos &&
                     v.find("fillval_id/") == string::npos)
@@ -2177,6 +2508,10 @@ int ConvertBPFile(const string &infilepath, const string &outfilename,
                     std::string op(adata[0].data());
                     if (op == "put_var")
                     {
+                        /* For each variable, read with ADIOS then write with PIO */
+                        if (!mpirank && debug_out)
+                            cout << "Convert variable: " << v << endl;
+
                         if (var.is_timed)
                         {
                             if (debug_out)
@@ -2201,15 +2536,7 @@ int ConvertBPFile(const string &infilepath, const string &outfilename,
                     }
                     else if (op == "darray")
                     {
-                        /* Variable was written with pio_write_darray() with a decomposition */
-                        if (debug_out)
-                        {
-                            printf("ConvertVariableDarray: %d\n", mpirank);
-                            fflush(stdout);
-                        }
-                        ierr = ConvertVariableDarray(bpIO, bpReader, v, ncid, var, wfiles, decomp_map,
-                                                     n_bp_writers, iosysid, comm, mpirank, nproc, mem_opt);
-                        ERROR_CHECK_SINGLE_THROW(ierr, "ConvertVariableDarray failed.")
+                        darray_vars.push_back(v);
                     }
                     else
                     {
@@ -2221,24 +2548,20 @@ int ConvertBPFile(const string &infilepath, const string &outfilename,
             }
 
             FlushStdout_nm(comm);
+        }
 
-            ret = PIOc_sync(ncid); /* FIXME: flush after each variable until development is done. Remove for efficiency */
-            if (ret != PIO_NOERR)
-                ierr = BP2PIO_ERROR;
-            ERROR_CHECK_THROW(ierr, err_val, err_cnt, comm, "PIOc_sync failed.");
+        if (nvar_groups == 1)
+        {
+            ierr = ConvertDarrayVariables(bpIO, bpReader, darray_vars, ncid, vars_map, wfiles,
+                                          decomp_map, n_bp_writers, iosysid,
+                                          comm, mpirank, nproc, mem_opt);
+            ERROR_CHECK_SINGLE_THROW(ierr, "ConvertDarrayVariables failed.")
         }
 
         TimerStart(write);
 
-        for (std::map<std::string, Decomposition>::iterator it = decomp_map.begin();
-             it != decomp_map.end(); ++it)
-        {
-            Decomposition d = it->second;
-            ret = PIOc_freedecomp(iosysid, d.ioid);
-            if (ret != PIO_NOERR)
-                ierr = BP2PIO_ERROR;
-            ERROR_CHECK_THROW(ierr, err_val, err_cnt, comm, "PIOc_freedecomp failed.");
-        }
+        ierr = FreeDecompositions(decomp_map, iosysid);
+        ERROR_CHECK_THROW(ierr, err_val, err_cnt, comm, "PIOc_freedecomp failed.");
 
         ret = PIOc_sync(ncid);
         if (ret != PIO_NOERR)
@@ -2251,6 +2574,15 @@ int ConvertBPFile(const string &infilepath, const string &outfilename,
         ERROR_CHECK_THROW(ierr, err_val, err_cnt, comm, "PIOc_closefile failed.");
 
         TimerStop(write);
+
+        if (nvar_groups > 1)
+        {
+            ierr = ConvertDarrayVariablesInGroups(adios, infilepath, outfilename, pio_iotype,
+                                                  darray_vars, vars_map, n_bp_files,
+                                                  n_bp_writers, nvar_groups,
+                                                  comm, mpirank, nproc, mem_opt);
+            ERROR_CHECK_SINGLE_THROW(ierr, "ConvertDarrayVariablesInGroups failed.")
+        }
     }
     catch (const std::exception &e)
     {
@@ -2295,7 +2627,8 @@ enum PIO_IOTYPE GetIOType_nm(const string &t)
 }
 
 int ConvertBPToNC(const string &infilepath, const string &outfilename,
-                  const string &piotype, int mem_opt, MPI_Comm comm_in)
+                  const string &piotype, int mem_opt, MPI_Comm comm_in,
+                  int nvar_groups)
 {
     int ierr = BP2PIO_NOERR, err_val = 0, err_cnt = 0;
     int ret = PIO_NOERR;
@@ -2355,7 +2688,8 @@ int ConvertBPToNC(const string &infilepath, const string &outfilename,
             }
 
             enum PIO_IOTYPE pio_iotype = GetIOType_nm(piotype);
-            ierr = ConvertBPFile(infilepath, outfilename, pio_iotype, iosysid, comm, mpirank, nproc, mem_opt);
+            ierr = ConvertBPFile(infilepath, outfilename, pio_iotype, iosysid, comm, mpirank, nproc, mem_opt,
+                                 nvar_groups);
             if (ierr != BP2PIO_NOERR)
             {
                 throw std::runtime_error("ConvertBPFile error.");
@@ -2438,12 +2772,14 @@ static int FindBPDirs(const string &bppdir,
  *          file. This is the "BP Parent Directory".
  * piotype: The PIO IO type used for converting BP files to NetCDF using PIO
  * comm:    The MPI communicator to be used for conversion
+ * nvar_groups: Number of groups of processes in comm that convert
+ *          darray variables concurrently
  *
  * The function looks for all directories in bppdir named "*.bp.dir"
  * and converts them, one at a time, to NetCDF files
  */
 int MConvertBPToNC(const string &bppdir, const string &piotype, int mem_opt,
-                    MPI_Comm comm)
+                    MPI_Comm comm, int nvar_groups)
 {
     int ierr = BP2PIO_NOERR;
     vector<string> bpdirs;
@@ -2463,7 +2799,7 @@ int MConvertBPToNC(const string &bppdir, const string &piotype, int mem_opt,
         MPI_Barrier(comm);
         ierr = ConvertBPToNC(bpdirs[i],
                 conv_fname_prefixes[i] + CONV_FNAME_SUFFIX,
-                piotype, mem_opt, comm);
+                piotype, mem_opt, comm, nvar_groups);
         MPI_Barrier(comm);
         if (ierr != BP2PIO_NOERR)
         {
@@ -8,9 +8,10 @@ using namespace std;
 
 int ConvertBPToNC(const string &infilepath,
                   const string &outfilename,
-                  const string &piotype, int mem_opt, MPI_Comm comm_in);
+                  const string &piotype, int mem_opt, MPI_Comm comm_in,
+                  int nvar_groups = 1);
 int MConvertBPToNC(const string &bppdir, const string &piotype, int mem_opt,
-                    MPI_Comm comm);
+                    MPI_Comm comm, int nvar_groups = 1);
 void SetDebugOutput(int val);
 
 #endif /* #ifndef _ADIOS2PIO_NM_LIB_H_ */
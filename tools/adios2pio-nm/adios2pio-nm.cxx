@@ -14,6 +14,7 @@ static void init_user_options(spio_tool_utils::ArgParser &ap)
       .add_opt("nc-file", "output file name after conversion")
       .add_opt("pio-format", "output PIO_IO_TYPE. Supported parameters: \"pnetcdf\",  \"netcdf\",  \"netcdf4c\",  \"netcdf4p\"")
       .add_opt("reduce-memory-usage", "Reduce memory usage (execution time will likely increase)")
+      .add_opt("var-groups", "Number of groups of processes converting variables concurrently (PnetCDF only)")
       .add_opt("verbose", "Turn on verbose info messages");
 }
 
@@ -24,10 +25,12 @@ static int get_user_options(
               std::string &ifile, std::string &ofile,
               std::string &otype,
               int &mem_opt,
+              int &nvar_groups,
               int &debug_lvl)
 {
     const std::string DEFAULT_PIO_FORMAT("pnetcdf");
     mem_opt = 0;
+    nvar_groups = 1;
     debug_lvl = 0;
 
     ap.parse(argc, argv);
@@ -80,6 +83,11 @@ static int get_user_options(
         mem_opt = 1;
     }
 
+    if (ap.has_arg("var-groups"))
+    {
+        nvar_groups = ap.get_arg<int>("var-groups");
+    }
+
     if (ap.has_arg("verbose"))
     {
         debug_lvl = 1;
@@ -92,7 +100,10 @@ int main(int argc, char *argv[])
 {
     int ret = 0;
 
-    MPI_Init(&argc, &argv);
+    /* The converter reads the next step of a variable in a helper
+     * thread (no MPI calls) while the current step is written */
+    int mpi_thread_level;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &mpi_thread_level);
 
     MPI_Comm comm_in = MPI_COMM_WORLD;
 
@@ -104,10 +115,11 @@ int main(int argc, char *argv[])
     /* Parse the user options */
     string idir, infilepath, outfilename, piotype;
     int mem_opt = 0;
+    int nvar_groups = 1;
     int debug_lvl = 0;
     ret = get_user_options(ap, argc, argv,
                             idir, infilepath, outfilename,
-                            piotype, mem_opt, debug_lvl);
+                            piotype, mem_opt, nvar_groups, debug_lvl);
 
     if (ret != 0)
     {
@@ -124,11 +136,11 @@ int main(int argc, char *argv[])
     MPI_Barrier(comm_in);
     if (idir.size() == 0)
     {
-        ret = ConvertBPToNC(infilepath, outfilename, piotype, mem_opt, comm_in);
+        ret = ConvertBPToNC(infilepath, outfilename, piotype, mem_opt, comm_in, nvar_groups);
     }
     else
     {
-        ret = MConvertBPToNC(idir, piotype, mem_opt, comm_in);
+        ret = MConvertBPToNC(idir, piotype, mem_opt, comm_in, nvar_groups);
     }
     MPI_Barrier(comm_in);
 
@@ -0,0 +1,62 @@
+/**
+ * @file
+ * SCORPIO subfile merge tool.
+ *
+ * Merges a subfiled dataset (written with PIOc_set_subfiling) into a
+ * single netCDF file using all the MPI processes as I/O processes.
+ *
+ * Usage: mpiexec -n <nprocs> spio_subfile_merge.exe <dataset> <output file>
+ *
+ * where <dataset> is the name the files were created with, i.e. the
+ * name without the ".NNNN" subfile suffix.
+ */
+#include <stdio.h>
+#include <mpi.h>
+#include <pio.h>
+
+int main(int argc, char *argv[])
+{
+    int rank, ntasks;
+    int iosysid;
+    int ret;
+
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ntasks);
+
+    if (argc != 3)
+    {
+        if (rank == 0)
+            fprintf(stderr, "Usage: %s <subfiled dataset> <output file>\n", argv[0]);
+        MPI_Finalize();
+        return 1;
+    }
+
+    if ((ret = PIOc_set_iosystem_error_handling(PIO_DEFAULT, PIO_RETURN_ERROR, NULL)))
+    {
+        MPI_Finalize();
+        return ret;
+    }
+
+    if ((ret = PIOc_Init_Intracomm(MPI_COMM_WORLD, ntasks, 1, 0, PIO_REARR_BOX, &iosysid)))
+    {
+        if (rank == 0)
+            fprintf(stderr, "Initializing the I/O system failed (ret = %d)\n", ret);
+        MPI_Finalize();
+        return ret;
+    }
+
+    if ((ret = PIOc_merge_subfiles(iosysid, argv[1], argv[2])))
+    {
+        if (rank == 0)
+            fprintf(stderr, "Merging the subfiles of %s into %s failed (ret = %d)\n",
+                    argv[1], argv[2], ret);
+    }
+    else if (rank == 0)
+        printf("Merged the subfiles of %s into %s\n", argv[1], argv[2]);
+
+    PIOc_finalize(iosysid);
+    MPI_Finalize();
+
+    return ret;
+}